@@ -0,0 +1,110 @@
+// alloc-audit.cc
+// Code for `alloc-audit` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "alloc-audit.h"               // this module
+
+#if GPV_ALLOC_AUDIT
+  #include <cstdlib>                   // std::{malloc, free}
+  #include <new>                       // std::{bad_alloc, nothrow_t}
+#endif
+
+
+#if GPV_ALLOC_AUDIT
+
+// Calls made by this thread.  This is a plain integer, so accessing it
+// does not itself allocate.
+static thread_local std::uint64_t t_allocCount = 0;
+
+
+std::uint64_t allocAuditThreadCount()
+{
+  return t_allocCount;
+}
+
+
+// Allocate `size` bytes, counting the call.  Return null on failure.
+static void *countedMalloc(std::size_t size)
+{
+  ++t_allocCount;
+
+  // `malloc(0)` may return null, but `new` must not.
+  return std::malloc(size? size : 1);
+}
+
+
+void *operator new(std::size_t size)
+{
+  if (void *p = countedMalloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+  return countedMalloc(size);
+}
+
+
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+  return countedMalloc(size);
+}
+
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+
+void operator delete[](void *p) noexcept
+{
+  std::free(p);
+}
+
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+
+void operator delete(void *p, std::nothrow_t const &) noexcept
+{
+  std::free(p);
+}
+
+
+void operator delete[](void *p, std::nothrow_t const &) noexcept
+{
+  std::free(p);
+}
+
+
+#else // !GPV_ALLOC_AUDIT
+
+std::uint64_t allocAuditThreadCount()
+{
+  return 0;
+}
+
+#endif // !GPV_ALLOC_AUDIT
+
+
+// EOF
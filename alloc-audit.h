@@ -0,0 +1,59 @@
+// alloc-audit.h
+// Counting heap allocations, to find them on paths that should not
+// have any.
+
+// See license.txt for copyright and terms of use.
+
+// Polling and painting run many times a second for as long as the
+// viewer is open, so once they have warmed up they should not allocate
+// at all.  When built with `GPV_ALLOC_AUDIT` defined as 1 (`make
+// ALLOC_AUDIT=1`), alloc-audit.cc replaces the global `operator new`
+// with one that counts the calls made by each thread, so that callers
+// can measure what a piece of code allocates.  Otherwise the counts
+// are always 0 and nothing is replaced.
+//
+// The replacement is only linked into programs that call
+// `allocAuditThreadCount`, since that is what pulls alloc-audit.o out
+// of libgpvcore.a.  `gpv-test` instead links a counting copy built
+// from the same source, so the tests always count.
+
+#ifndef ALLOC_AUDIT_H
+#define ALLOC_AUDIT_H
+
+#include <cstdint>                     // std::uint64_t
+
+
+#ifndef GPV_ALLOC_AUDIT
+  #define GPV_ALLOC_AUDIT 0
+#endif
+
+
+// True if built to count allocations.
+inline bool allocAuditCompiledIn()
+{
+  return GPV_ALLOC_AUDIT != 0;
+}
+
+// Number of times this thread has called `operator new` (in any of its
+// forms) so far.
+std::uint64_t allocAuditThreadCount();
+
+
+// Measures the allocations made by this thread while it exists.
+class AllocAuditScope {
+private:     // data
+  // `allocAuditThreadCount()` at construction.
+  std::uint64_t m_start;
+
+public:      // methods
+  AllocAuditScope()
+    : m_start(allocAuditThreadCount())
+  {}
+
+  // Allocations so far.
+  std::uint64_t count() const
+    { return allocAuditThreadCount() - m_start; }
+};
+
+
+#endif // ALLOC_AUDIT_H
@@ -0,0 +1,101 @@
+// atomic-file-test.cc
+// Tests for `atomic-file` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "atomic-file.h"               // module under test
+
+#include "gpv-config.h"                // GPVConfig
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <filesystem>                  // std::filesystem
+#include <fstream>                     // std::ifstream
+#include <sstream>                     // std::ostringstream
+
+#ifdef __linux__
+  #include <signal.h>                  // kill, SIGKILL
+  #include <sys/wait.h>                // waitpid
+  #include <time.h>                    // nanosleep
+  #include <unistd.h>                  // fork, _exit
+#endif
+
+namespace fs = std::filesystem;
+
+
+// Contents of `fname`.
+static std::string readTextFile(std::string const &fname)
+{
+  std::ostringstream oss;
+  oss << std::ifstream(fname, std::ios::binary).rdbuf();
+  return oss.str();
+}
+
+
+UNIT_TEST(atomicWriteReplacesFile)
+{
+  std::string fname = unitTestTempDir() + "/replaced.txt";
+  EXPECT_EQ(writeFileAtomically(fname, "old"), "");
+  EXPECT_EQ(writeFileAtomically(fname, "new contents"), "");
+  EXPECT_EQ(readTextFile(fname), "new contents");
+  EXPECT(!fs::exists(atomicWriteTempName(fname)));
+}
+
+
+UNIT_TEST(atomicWriteFailureRemovesTempFile)
+{
+  // Renaming a file over a directory fails.
+  std::string fname = unitTestTempDir() + "/occupied";
+  fs::create_directory(fname);
+
+  EXPECT(!writeFileAtomically(fname, "contents").empty());
+  EXPECT(fs::is_directory(fname));
+  EXPECT(!fs::exists(atomicWriteTempName(fname)));
+}
+
+
+#ifdef __linux__
+// A child process saves two configurations alternately as fast as it
+// can until it is killed at an arbitrary moment, typically in the
+// middle of a write.  The file must then load cleanly as one of them.
+UNIT_TEST(atomicWriteSurvivesKill)
+{
+  std::string fname = unitTestTempDir() + "/killed.json";
+
+  // Big enough that each write takes a while.
+  GPVConfig configs[2];
+  for (int i = 0; i < 100; ++i) {
+    configs[0].m_profiles.push_back(TimingProfile());
+    configs[0].m_profiles.back().m_name = "profile " + std::to_string(i);
+  }
+  configs[1] = configs[0];
+  configs[1].m_controllerID = 3;
+  EXPECT_EQ(configs[0].saveToFile(fname), "");
+
+  for (int round = 0; round < 40; ++round) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      for (int i = 0; ; ++i) {
+        configs[i % 2].saveToFile(fname);
+      }
+    }
+    EXPECT(pid > 0);
+    if (pid < 0) {
+      return;
+    }
+
+    // Vary the moment of the kill across rounds.
+    struct timespec delay = { 0, 250000L * (round % 16 + 1) };
+    nanosleep(&delay, nullptr);
+    kill(pid, SIGKILL);
+    int status;
+    waitpid(pid, &status, 0);
+
+    GPVConfig loaded;
+    EXPECT_EQ(loaded.loadFromFile(fname), "");
+    EXPECT(loaded == configs[0] || loaded == configs[1]);
+  }
+}
+#endif // __linux__
+
+
+// EOF
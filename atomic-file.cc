@@ -0,0 +1,162 @@
+// atomic-file.cc
+// Code for `atomic-file` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "atomic-file.h"               // this module
+
+#include <cerrno>                      // errno, EINTR
+#include <cstring>                     // std::strerror
+#include <filesystem>                  // std::filesystem::path
+
+#ifdef _WIN32
+  #include <windows.h>                 // CreateFileW, MoveFileExW, etc.
+#else
+  #include <fcntl.h>                   // open, O_*
+  #include <unistd.h>                  // write, fsync, close, unlink
+  #include <cstdio>                    // std::rename
+#endif
+
+
+std::string atomicWriteTempName(std::string const &fname)
+{
+  return fname + ".tmp";
+}
+
+
+#ifdef _WIN32
+
+// Return a message describing `GetLastError()`.
+static std::string lastErrorString(char const *what)
+{
+  return std::string(what) + " failed with code " +
+         std::to_string(GetLastError());
+}
+
+
+std::string writeFileAtomically(std::string const &fname,
+                                std::string const &contents)
+{
+  std::filesystem::path path(fname);
+  std::filesystem::path tempPath(atomicWriteTempName(fname));
+
+  HANDLE h = CreateFileW(tempPath.wstring().c_str(), GENERIC_WRITE,
+                         0 /*share*/, nullptr, CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE) {
+    return lastErrorString("CreateFile");
+  }
+
+  char const *p = contents.data();
+  std::size_t remaining = contents.size();
+  while (remaining > 0) {
+    DWORD written = 0;
+    if (!WriteFile(h, p, (DWORD)remaining, &written, nullptr)) {
+      std::string error = lastErrorString("WriteFile");
+      CloseHandle(h);
+      DeleteFileW(tempPath.wstring().c_str());
+      return error;
+    }
+    p += written;
+    remaining -= written;
+  }
+
+  // Make sure the data is on the disk before the rename makes it
+  // visible under the real name.
+  if (!FlushFileBuffers(h)) {
+    std::string error = lastErrorString("FlushFileBuffers");
+    CloseHandle(h);
+    DeleteFileW(tempPath.wstring().c_str());
+    return error;
+  }
+  CloseHandle(h);
+
+  // WRITE_THROUGH makes the call return only after the rename itself
+  // has been flushed.
+  if (!MoveFileExW(tempPath.wstring().c_str(), path.wstring().c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    std::string error = lastErrorString("MoveFileEx");
+    DeleteFileW(tempPath.wstring().c_str());
+    return error;
+  }
+
+  return "";
+}
+
+#else // !_WIN32
+
+// Return a message for `errno` after `what` failed.
+static std::string errnoString(char const *what)
+{
+  return std::string(what) + ": " + std::strerror(errno);
+}
+
+
+std::string writeFileAtomically(std::string const &fname,
+                                std::string const &contents)
+{
+  std::string tempName = atomicWriteTempName(fname);
+
+  int fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0666);
+  if (fd < 0) {
+    return errnoString("open");
+  }
+
+  char const *p = contents.data();
+  std::size_t remaining = contents.size();
+  while (remaining > 0) {
+    ssize_t written = write(fd, p, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::string error = errnoString("write");
+      close(fd);
+      unlink(tempName.c_str());
+      return error;
+    }
+    p += written;
+    remaining -= written;
+  }
+
+  // Without this, a crash shortly after the rename can leave the new
+  // name pointing at an empty file on some file systems.
+  if (fsync(fd) != 0) {
+    std::string error = errnoString("fsync");
+    close(fd);
+    unlink(tempName.c_str());
+    return error;
+  }
+  if (close(fd) != 0) {
+    std::string error = errnoString("close");
+    unlink(tempName.c_str());
+    return error;
+  }
+
+  if (std::rename(tempName.c_str(), fname.c_str()) != 0) {
+    std::string error = errnoString("rename");
+    unlink(tempName.c_str());
+    return error;
+  }
+
+  // Flush the directory entry too, so the rename survives a power
+  // failure.  Failure here is not reported since the file itself is
+  // intact either way.
+  std::filesystem::path dir = std::filesystem::path(fname).parent_path();
+  if (dir.empty()) {
+    dir = ".";
+  }
+  int dirFD = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirFD >= 0) {
+    fsync(dirFD);
+    close(dirFD);
+  }
+
+  return "";
+}
+
+#endif // !_WIN32
+
+
+// EOF
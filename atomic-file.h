@@ -0,0 +1,32 @@
+// atomic-file.h
+// `writeFileAtomically`, which replaces a file without ever leaving a
+// partial copy behind.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <string>                      // std::string
+
+
+// Replace the contents of `fname` with `contents`.
+//
+// The data is written to a temporary file next to `fname`, flushed to
+// the disk, and then renamed over `fname`.  If the process or machine
+// dies at any point, `fname` has either its old contents or the new
+// ones, never a mixture or a truncated file.  A temporary file may then
+// be left behind; it is overwritten by the next call.  If a step fails
+// instead, the temporary file is removed.
+//
+// Return an empty string on success or an error message on failure.
+std::string writeFileAtomically(std::string const &fname,
+                                std::string const &contents);
+
+
+// Name of the temporary file that `writeFileAtomically` uses for
+// `fname`.
+std::string atomicWriteTempName(std::string const &fname);
+
+
+#endif // ATOMIC_FILE_H
@@ -0,0 +1,135 @@
+// bench.cc
+// Code for `bench` module, including `main` for `gpv-bench`.
+
+// See license.txt for copyright and terms of use.
+
+#include "bench.h"                     // this module
+
+#include "synthetic-input.h"           // SyntheticInput
+
+#include <chrono>                      // std::chrono
+#include <cstdio>                      // std::printf
+#include <cstring>                     // std::strstr
+#include <filesystem>                  // std::filesystem
+#include <iostream>                    // std::cout
+#include <random>                      // std::random_device
+#include <system_error>                // std::error_code
+
+namespace fs = std::filesystem;
+
+
+// A registered benchmark.
+class Bench {
+public:      // data
+  char const *m_name;
+  char const *m_file;
+  BenchFunction m_func;
+};
+
+
+// All benchmarks, in registration order.
+static std::vector<Bench> &allBenches()
+{
+  static std::vector<Bench> benches;
+  return benches;
+}
+
+
+// Scratch directory, or empty if not made yet.
+static std::string s_tempDir;
+
+
+BenchRegistration::BenchRegistration(char const *name, char const *file,
+                                     BenchFunction func)
+{
+  allBenches().push_back(Bench{name, file, func});
+}
+
+
+std::uint64_t benchNowNS()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void benchReport(std::string const &what, double ns,
+                 std::string const &note)
+{
+  char buf[40];
+  if (ns < 1e4) {
+    std::snprintf(buf, sizeof(buf), "%8.1f ns", ns);
+  }
+  else if (ns < 1e7) {
+    std::snprintf(buf, sizeof(buf), "%8.1f us", ns / 1e3);
+  }
+  else {
+    std::snprintf(buf, sizeof(buf), "%8.1f ms", ns / 1e6);
+  }
+  benchReportValue(what, note.empty()? buf : buf + ("  " + note));
+}
+
+
+void benchReportValue(std::string const &what, std::string const &value)
+{
+  std::printf("  %-46s %s\n", what.c_str(), value.c_str());
+  std::fflush(stdout);
+}
+
+
+std::string benchTempDir()
+{
+  if (s_tempDir.empty()) {
+    fs::path dir = fs::temp_directory_path() /
+                   ("gpv-bench-" + std::to_string(std::random_device()()));
+    fs::create_directories(dir);
+    s_tempDir = dir.string();
+  }
+  return s_tempDir;
+}
+
+
+std::vector<InputModel> benchFrameModels(GPVConfig const *config,
+                                         int frames)
+{
+  std::vector<InputModel> models;
+  InputModel model(config);
+  SyntheticInput input;
+  ControllerState state;
+  for (int ms = 0; (int)models.size() < frames; ++ms) {
+    input.next(state, 1000 + ms);
+    model.update(state);
+    if (ms % 16 == 0) {
+      models.push_back(model);
+    }
+  }
+  return models;
+}
+
+
+int main(int argc, char **argv)
+{
+  for (Bench const &b : allBenches()) {
+    bool selected = argc <= 1;
+    for (int i=1; i < argc; ++i) {
+      if (std::strstr(b.m_name, argv[i]) || std::strstr(b.m_file, argv[i])) {
+        selected = true;
+      }
+    }
+    if (!selected) {
+      continue;
+    }
+
+    std::printf("%s (%s):\n", b.m_name, b.m_file);
+    b.m_func();
+  }
+
+  if (!s_tempDir.empty()) {
+    std::error_code ec;
+    fs::remove_all(s_tempDir, ec);
+  }
+  return 0;
+}
+
+
+// EOF
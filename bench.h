@@ -0,0 +1,127 @@
+// bench.h
+// Minimal framework for the benchmarks that `make bench` runs.
+
+// See license.txt for copyright and terms of use.
+
+// Each `*-bench.cc` file defines benchmarks for one module:
+//
+//   BENCHMARK(inputModelUpdate)
+//   {
+//     ...
+//     benchReport("InputModel::update", benchTimeNS([&] {
+//       model.update(states[i++ % n]);
+//     }));
+//   }
+//
+// They are linked together into `gpv-bench`, whose `main`, in
+// bench.cc, runs every benchmark, or with arguments, those whose names
+// contain one of them.  Each reports one or more lines of results.
+//
+// Like the tests, the benchmarks mostly use the portable modules, so
+// they run on Linux.  Those that need Windows are only built there.
+// Build with -O2, as the Makefile does, for meaningful numbers.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+
+#include <algorithm>                   // std::sort
+#include <cstdint>                     // std::uint64_t
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Signature of a benchmark.
+typedef void (*BenchFunction)();
+
+
+// Adds a benchmark to the list `main` runs.
+class BenchRegistration {
+public:      // methods
+  BenchRegistration(char const *name, char const *file,
+                    BenchFunction func);
+};
+
+
+// Nanoseconds on `std::chrono::steady_clock`.
+std::uint64_t benchNowNS();
+
+// Print a result line for `what`, which took `ns` nanoseconds, with
+// optional `note` after it.
+void benchReport(std::string const &what, double ns,
+                 std::string const &note = "");
+
+// Print a result line for `what` that is not a time, like a count.
+void benchReportValue(std::string const &what, std::string const &value);
+
+// Directory, created on first use, where benchmarks can make scratch
+// files.  It is removed when `gpv-bench` exits.
+std::string benchTempDir();
+
+// Snapshots of a model of `config`, one per 60 Hz frame, for `frames`
+// frames of input from `SyntheticInput` polled every millisecond.
+std::vector<InputModel> benchFrameModels(GPVConfig const *config,
+                                         int frames);
+
+
+// Keep the compiler from optimizing away the computation of `value`.
+template <class T>
+inline void benchKeep(T const &value)
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+// Median of `v`, which must not be empty.
+inline double benchMedian(std::vector<double> v)
+{
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+
+// Return the median time, in nanoseconds, of one call of `f()`.
+//
+// The calls are made in batches large enough to take at least
+// `minBatchNS`, so that clock resolution does not matter, and the
+// median of `runs` batches is used, so that an interruption in one of
+// them does not.
+template <class F>
+double benchTimeNS(F const &f, double minBatchNS = 5e6, int runs = 9)
+{
+  long batch = 1;
+  while (true) {
+    std::uint64_t start = benchNowNS();
+    for (long i=0; i < batch; ++i) {
+      f();
+    }
+    std::uint64_t elapsed = benchNowNS() - start;
+    if (elapsed >= minBatchNS || batch >= (1L << 30)) {
+      break;
+    }
+    batch *= 2;
+  }
+
+  std::vector<double> perCall;
+  for (int r=0; r < runs; ++r) {
+    std::uint64_t start = benchNowNS();
+    for (long i=0; i < batch; ++i) {
+      f();
+    }
+    perCall.push_back((double)(benchNowNS() - start) / batch);
+  }
+  return benchMedian(perCall);
+}
+
+
+// Define a benchmark called `name`.
+#define BENCHMARK(name)                                        \
+  static void name();                                          \
+  static BenchRegistration name##_registration(                \
+    #name, __FILE__, &name);                                   \
+  static void name()
+
+
+#endif // BENCH_H
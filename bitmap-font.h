@@ -0,0 +1,26 @@
+// bitmap-font.h
+// Tiny built-in 5x7 bitmap font used by the CPU rasterizer.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef BITMAP_FONT_H
+#define BITMAP_FONT_H
+
+#include <cstdint>                     // std::uint8_t
+
+
+// Glyph cell geometry, in font pixels.  The cell includes one column
+// and one row of spacing beyond the 5x7 glyph itself.
+int const c_bitmapFontGlyphWidth = 5;
+int const c_bitmapFontGlyphHeight = 7;
+int const c_bitmapFontCellWidth = 6;
+int const c_bitmapFontCellHeight = 9;
+
+
+// Return the 7 rows of the glyph for `c`, top first.  Within a row, bit
+// 4 is the leftmost pixel.  Characters outside printable ASCII map to
+// '?'.
+std::uint8_t const *bitmapFontGlyph(wchar_t c);
+
+
+#endif // BITMAP_FONT_H
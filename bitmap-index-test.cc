@@ -0,0 +1,234 @@
+// bitmap-index-test.cc
+// Tests for `bitmap-index` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "bitmap-index.h"              // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <functional>                  // std::function
+#include <random>                      // std::mt19937
+#include <set>                         // std::set
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Terms of `count` synthetic samples.  Each term is held for a while,
+// then released for a while, as buttons are, so the bitmaps have runs
+// as well as scattered members.
+static std::vector<std::uint32_t> syntheticTerms(int count)
+{
+  std::mt19937 rng(5);
+  std::vector<std::uint32_t> samples;
+  std::uint32_t terms = 0;
+  for (int i=0; i < count; ++i) {
+    for (int t=0; t < NUM_SAMPLE_TERMS; ++t) {
+      // Term `t` changes every 8 << (t % 5) samples, on average.
+      if (rng() % (8u << (t % 5)) == 0) {
+        terms ^= (std::uint32_t)1 << t;
+      }
+    }
+    samples.push_back(terms);
+  }
+  return samples;
+}
+
+
+// The index of `samples`.
+static BitmapIndex indexOf(std::vector<std::uint32_t> const &samples)
+{
+  BitmapIndex index;
+  for (std::uint32_t terms : samples) {
+    index.add(terms);
+  }
+  index.optimize();
+  return index;
+}
+
+
+// The members of `bitmap`.
+static std::set<std::uint32_t> setOf(SampleBitmap const &bitmap)
+{
+  std::vector<std::uint32_t> members;
+  bitmap.toVector(members);
+  return std::set<std::uint32_t>(members.begin(), members.end());
+}
+
+
+// Bit for the term called `name`.
+static std::uint32_t bit(char const *name)
+{
+  int term = sampleTermFromName(name);
+  EXPECT(term >= 0);
+  return (std::uint32_t)1 << term;
+}
+
+
+UNIT_TEST(sampleTermNames)
+{
+  for (int t=0; t < NUM_SAMPLE_TERMS; ++t) {
+    EXPECT_EQ(sampleTermFromName(sampleTermName(t)), t);
+  }
+  EXPECT_EQ(sampleTermFromName("a"), 12);
+  EXPECT_EQ(sampleTermFromName("connected"), (int)SFL_CONNECTED);
+  EXPECT_EQ(sampleTermFromName("right_stick"), (int)SFL_RIGHT_STICK);
+  EXPECT_EQ(sampleTermFromName("all"), -1);
+  EXPECT_EQ(sampleTermFromName("bogus"), -1);
+  EXPECT_EQ(std::string(sampleTermName(NUM_SAMPLE_TERMS)), "unknown");
+}
+
+
+// Each query's bitmap matches the samples that satisfy the predicate
+// written out in C++, and `matches` agrees with it sample by sample.
+UNIT_TEST(bitmapQueryEvaluate)
+{
+  std::vector<std::uint32_t> samples = syntheticTerms(150000);
+  BitmapIndex index = indexOf(samples);
+  EXPECT_EQ(index.m_sampleCount, (std::uint32_t)samples.size());
+
+  std::uint32_t const a = bit("a");
+  std::uint32_t const b = bit("b");
+  std::uint32_t const x = bit("x");
+  std::uint32_t const conn = bit("connected");
+  std::uint32_t const ls = bit("left_stick");
+
+  struct Case {
+    char const *m_query;
+    std::function<bool(std::uint32_t)> m_expect;
+  };
+  Case const cases[] = {
+    { "a",                [&](std::uint32_t t) { return (t&a) != 0; } },
+    { "all",              [&](std::uint32_t)   { return true; } },
+    { "a & b",            [&](std::uint32_t t) { return (t&a) && (t&b); } },
+    { "a | b",            [&](std::uint32_t t) { return (t&a) || (t&b); } },
+    { "a - b",            [&](std::uint32_t t) { return (t&a) && !(t&b); } },
+    { "!a",               [&](std::uint32_t t) { return !(t&a); } },
+    { "!!a",              [&](std::uint32_t t) { return (t&a) != 0; } },
+    { "all - a",          [&](std::uint32_t t) { return !(t&a); } },
+
+    // "&" binds tighter than "|".
+    { "a | b & x",
+      [&](std::uint32_t t) { return (t&a) || ((t&b) && (t&x)); } },
+    { "a & b | x",
+      [&](std::uint32_t t) { return ((t&a) && (t&b)) || (t&x); } },
+    { "(a | b) & x",
+      [&](std::uint32_t t) { return ((t&a) || (t&b)) && (t&x); } },
+
+    // "-" is "&" with the complement, and associates to the left.
+    { "a - b - x",
+      [&](std::uint32_t t) { return (t&a) && !(t&b) && !(t&x); } },
+    { "a - (b - x)",
+      [&](std::uint32_t t) { return (t&a) && !((t&b) && !(t&x)); } },
+    { "a | b - x",
+      [&](std::uint32_t t) { return (t&a) || ((t&b) && !(t&x)); } },
+
+    // "!" binds tightest.
+    { "!a & b",           [&](std::uint32_t t) { return !(t&a) && (t&b); } },
+    { "!(a & b)",         [&](std::uint32_t t) { return !((t&a) && (t&b)); } },
+    { " connected&!left_stick ",
+      [&](std::uint32_t t) { return (t&conn) && !(t&ls); } },
+    { "!(a | b | x) & connected",
+      [&](std::uint32_t t) { return !(t & (a|b|x)) && (t&conn); } },
+  };
+
+  for (Case const &c : cases) {
+    BitmapQuery query;
+    EXPECT_EQ(query.parse(c.m_query), "");
+
+    std::set<std::uint32_t> expect;
+    for (std::uint32_t i=0; i < samples.size(); ++i) {
+      if (c.m_expect(samples[i])) {
+        expect.insert(i);
+      }
+      if (query.matches(samples[i]) != c.m_expect(samples[i])) {
+        unitTestFail(__FILE__, __LINE__,
+                     std::string("matches disagrees for ") + c.m_query);
+        break;
+      }
+    }
+    if (setOf(query.evaluate(index)) != expect) {
+      unitTestFail(__FILE__, __LINE__,
+                   std::string("evaluate disagrees for ") + c.m_query);
+    }
+  }
+}
+
+
+UNIT_TEST(bitmapQueryParseErrors)
+{
+  struct Case {
+    char const *m_query;
+    char const *m_error;
+  };
+  Case const cases[] = {
+    { "",                 "column 1: unexpected end of query" },
+    { "a &",              "column 4: unexpected end of query" },
+    { "a & & b",          "column 5: expected a term" },
+    { "(a | b",           "column 7: expected \")\"" },
+    { "a)",               "column 2: unexpected \")\"" },
+    { "a b",              "column 3: unexpected \"b\"" },
+    { "a & bogus",        "column 5: unknown term \"bogus\"" },
+    { "A",                "column 1: expected a term" },
+    { "!",                "column 2: unexpected end of query" },
+  };
+
+  BitmapIndex index = indexOf(syntheticTerms(100));
+  for (Case const &c : cases) {
+    BitmapQuery query;
+    EXPECT_EQ(query.parse(c.m_query), c.m_error);
+
+    // A failed parse matches nothing.
+    EXPECT(!query.matches(~(std::uint32_t)0));
+    EXPECT_EQ(query.evaluate(index).cardinality(), (std::uint64_t)0);
+  }
+
+  // A query object can be reused after an error.
+  BitmapQuery query;
+  EXPECT(!query.parse("a |").empty());
+  EXPECT_EQ(query.parse("all"), "");
+  EXPECT_EQ(query.evaluate(index).cardinality(), (std::uint64_t)100);
+}
+
+
+UNIT_TEST(bitmapIndexEncodeDecode)
+{
+  std::vector<std::uint32_t> samples = syntheticTerms(20000);
+  BitmapIndex index = indexOf(samples);
+  std::string data;
+  index.encode(data);
+
+  BitmapIndex decoded;
+  EXPECT_EQ(decoded.decode(data), "");
+  EXPECT_EQ(decoded.m_sampleCount, index.m_sampleCount);
+  for (int t=0; t < NUM_SAMPLE_TERMS; ++t) {
+    EXPECT(setOf(decoded.m_terms[t]) == setOf(index.m_terms[t]));
+  }
+
+  BitmapQuery query;
+  EXPECT_EQ(query.parse("a | b - connected"), "");
+  EXPECT(setOf(query.evaluate(decoded)) == setOf(query.evaluate(index)));
+
+  // Anything short of the whole encoding is rejected.
+  for (std::size_t len=0; len < data.size(); ++len) {
+    if (decoded.decode(data.substr(0, len)).empty()) {
+      unitTestFail(__FILE__, __LINE__,
+                   "accepted a prefix of length " + std::to_string(len));
+      break;
+    }
+  }
+
+  EXPECT_EQ(decoded.decode(data + "x"), "extra data after the last bitmap");
+
+  std::string bad = data;
+  bad[0] = 'X';
+  EXPECT_EQ(decoded.decode(bad), "not a bitmap index (bad magic number)");
+
+  // The version follows the magic number.
+  bad = data;
+  bad[8]++;
+  EXPECT(decoded.decode(bad).find("unsupported bitmap index version") == 0);
+}
+
+
+// EOF
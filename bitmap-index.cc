@@ -0,0 +1,417 @@
+// bitmap-index.cc
+// Code for `bitmap-index` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "bitmap-index.h"              // this module
+
+#include "stick-kernel.h"              // processStick, StickParams
+#include "varint.h"                    // appendVarint, readVarint
+
+#include <cstring>                     // std::{memcmp, strcmp}
+#include <sstream>                     // std::ostringstream
+
+
+// First bytes of every index file.
+static char const s_magic[8] = { 'G','P','V','B','I','T','S','\n' };
+
+
+// Names of the terms after the buttons.
+static char const * const s_flagNames[NUM_SAMPLE_TERMS - SFL_CONNECTED] = {
+  "connected",
+  "left_trigger",
+  "right_trigger",
+  "left_stick",
+  "left_run",
+  "left_sprint",
+  "right_stick",
+};
+
+
+char const *sampleTermName(int term)
+{
+  if (0 <= term && term < SFL_CONNECTED) {
+    return xinputButtonName(1 << term);
+  }
+  if (SFL_CONNECTED <= term && term < NUM_SAMPLE_TERMS) {
+    return s_flagNames[term - SFL_CONNECTED];
+  }
+  return "unknown";
+}
+
+
+int sampleTermFromName(char const *name)
+{
+  if (int button = xinputButtonFromName(name)) {
+    return __builtin_ctz(button);
+  }
+  for (int t = SFL_CONNECTED; t < NUM_SAMPLE_TERMS; ++t) {
+    if (0==std::strcmp(name, s_flagNames[t - SFL_CONNECTED])) {
+      return t;
+    }
+  }
+  return -1;
+}
+
+
+std::uint32_t sampleTerms(ControllerState const &state,
+                          AnalogThresholdConfig const &thresholds)
+{
+  if (!state.m_hasInputState) {
+    return 0;
+  }
+
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  std::uint32_t terms = g.wButtons | (1u << SFL_CONNECTED);
+
+  if (state.isTriggerPressed(thresholds, true /*left*/)) {
+    terms |= 1u << SFL_LEFT_TRIGGER;
+  }
+  if (state.isTriggerPressed(thresholds, false /*left*/)) {
+    terms |= 1u << SFL_RIGHT_TRIGGER;
+  }
+
+  StickResult left = processStick(g.sThumbLX, g.sThumbLY,
+    StickParams::forStick(thresholds, true /*left*/));
+  if (left.m_beyondDeadZone) {
+    terms |= 1u << SFL_LEFT_STICK;
+  }
+  if (left.m_speed >= 2) {
+    terms |= 1u << SFL_LEFT_RUN;
+  }
+  if (left.m_speed >= 3) {
+    terms |= 1u << SFL_LEFT_SPRINT;
+  }
+
+  StickResult right = processStick(g.sThumbRX, g.sThumbRY,
+    StickParams::forStick(thresholds, false /*left*/));
+  if (right.m_beyondDeadZone) {
+    terms |= 1u << SFL_RIGHT_STICK;
+  }
+
+  return terms;
+}
+
+
+// ---------------------------- BitmapIndex ----------------------------
+BitmapIndex::BitmapIndex()
+  : m_sampleCount(0),
+    m_terms()
+{}
+
+
+void BitmapIndex::add(std::uint32_t terms)
+{
+  for (std::uint32_t t = terms; t; t &= t-1) {
+    m_terms[__builtin_ctz(t)].append(m_sampleCount);
+  }
+  m_sampleCount++;
+}
+
+
+void BitmapIndex::optimize()
+{
+  for (SampleBitmap &bitmap : m_terms) {
+    bitmap.optimize();
+  }
+}
+
+
+std::size_t BitmapIndex::sizeBytes() const
+{
+  std::size_t n = 0;
+  for (SampleBitmap const &bitmap : m_terms) {
+    n += bitmap.sizeBytes();
+  }
+  return n;
+}
+
+
+void BitmapIndex::encode(std::string &dest) const
+{
+  dest.append(s_magic, sizeof(s_magic));
+  appendVarint(dest, BITMAP_INDEX_VERSION);
+  appendVarint(dest, m_sampleCount);
+  appendVarint(dest, NUM_SAMPLE_TERMS);
+  for (SampleBitmap const &bitmap : m_terms) {
+    bitmap.encode(dest);
+  }
+}
+
+
+std::string BitmapIndex::decode(std::string const &data)
+{
+  char const *p = data.data();
+  char const *end = p + data.size();
+  if (data.size() < sizeof(s_magic) ||
+      0 != std::memcmp(p, s_magic, sizeof(s_magic))) {
+    return "not a bitmap index (bad magic number)";
+  }
+  p += sizeof(s_magic);
+
+  std::uint64_t version, sampleCount, numTerms;
+  if (!readVarint(p, end, version)) {
+    return "truncated header";
+  }
+  if (version != (std::uint64_t)BITMAP_INDEX_VERSION) {
+    std::ostringstream oss;
+    oss << "unsupported bitmap index version " << version;
+    return oss.str();
+  }
+  if (!readVarint(p, end, sampleCount) ||
+      !readVarint(p, end, numTerms) ||
+      sampleCount > 0xFFFFFFFFu) {
+    return "truncated header";
+  }
+  if (numTerms != NUM_SAMPLE_TERMS) {
+    std::ostringstream oss;
+    oss << "expected " << NUM_SAMPLE_TERMS << " terms, not " << numTerms;
+    return oss.str();
+  }
+
+  m_sampleCount = (std::uint32_t)sampleCount;
+  for (int t=0; t < NUM_SAMPLE_TERMS; ++t) {
+    if (!m_terms[t].decode(p, end)) {
+      std::ostringstream oss;
+      oss << "malformed bitmap for " << sampleTermName(t);
+      return oss.str();
+    }
+  }
+  if (p != end) {
+    return "extra data after the last bitmap";
+  }
+
+  return "";
+}
+
+
+// ---------------------------- BitmapQuery ----------------------------
+BitmapQuery::Node::Node(NodeKind kind, int term, int left, int right)
+  : m_kind(kind),
+    m_term(term),
+    m_left(left),
+    m_right(right)
+{}
+
+
+BitmapQuery::BitmapQuery()
+  : m_nodes(),
+    m_text(),
+    m_pos(0),
+    m_error()
+{}
+
+
+std::string BitmapQuery::parse(std::string const &text)
+{
+  m_nodes.clear();
+  m_text = text;
+  m_pos = 0;
+  m_error.clear();
+
+  if (parseOr() >= 0 && peek() != 0) {
+    m_error = std::string("unexpected \"") + peek() + "\"";
+  }
+  if (!m_error.empty()) {
+    std::ostringstream oss;
+    oss << "column " << (m_pos+1) << ": " << m_error;
+    m_nodes.clear();
+    return oss.str();
+  }
+  return "";
+}
+
+
+char BitmapQuery::peek()
+{
+  while (m_pos < m_text.size() && m_text[m_pos] == ' ') {
+    m_pos++;
+  }
+  return m_pos < m_text.size()? m_text[m_pos] : 0;
+}
+
+
+int BitmapQuery::parseOr()
+{
+  int left = parseAnd();
+  while (left >= 0 && peek() == '|') {
+    m_pos++;
+    int right = parseAnd();
+    if (right < 0) {
+      return -1;
+    }
+    m_nodes.push_back(Node(BQN_OR, -1, left, right));
+    left = (int)m_nodes.size() - 1;
+  }
+  return left;
+}
+
+
+int BitmapQuery::parseAnd()
+{
+  int left = parseUnary();
+  while (left >= 0 && (peek() == '&' || peek() == '-')) {
+    NodeKind kind = m_text[m_pos] == '&'? BQN_AND : BQN_ANDNOT;
+    m_pos++;
+    int right = parseUnary();
+    if (right < 0) {
+      return -1;
+    }
+    m_nodes.push_back(Node(kind, -1, left, right));
+    left = (int)m_nodes.size() - 1;
+  }
+  return left;
+}
+
+
+int BitmapQuery::parseUnary()
+{
+  char c = peek();
+
+  if (c == '!') {
+    m_pos++;
+    int operand = parseUnary();
+    if (operand < 0) {
+      return -1;
+    }
+    m_nodes.push_back(Node(BQN_NOT, -1, operand, -1));
+    return (int)m_nodes.size() - 1;
+  }
+
+  if (c == '(') {
+    m_pos++;
+    int inner = parseOr();
+    if (inner < 0) {
+      return -1;
+    }
+    if (peek() != ')') {
+      m_error = "expected \")\"";
+      return -1;
+    }
+    m_pos++;
+    return inner;
+  }
+
+  std::size_t start = m_pos;
+  while (m_pos < m_text.size() &&
+         (('a' <= m_text[m_pos] && m_text[m_pos] <= 'z') ||
+          ('0' <= m_text[m_pos] && m_text[m_pos] <= '9') ||
+          m_text[m_pos] == '_')) {
+    m_pos++;
+  }
+  if (m_pos == start) {
+    m_error = c? "expected a term" : "unexpected end of query";
+    return -1;
+  }
+
+  std::string name = m_text.substr(start, m_pos - start);
+  if (name == "all") {
+    m_nodes.push_back(Node(BQN_ALL, -1, -1, -1));
+  }
+  else {
+    int term = sampleTermFromName(name.c_str());
+    if (term < 0) {
+      m_pos = start;
+      m_error = "unknown term \"" + name + "\"";
+      return -1;
+    }
+    m_nodes.push_back(Node(BQN_TERM, term, -1, -1));
+  }
+  return (int)m_nodes.size() - 1;
+}
+
+
+SampleBitmap BitmapQuery::evaluate(BitmapIndex const &index) const
+{
+  if (m_nodes.empty()) {
+    return SampleBitmap();
+  }
+  return evaluateNode((int)m_nodes.size() - 1, index);
+}
+
+
+SampleBitmap const &BitmapQuery::operand(int node,
+                                         BitmapIndex const &index,
+                                         SampleBitmap &storage) const
+{
+  Node const &n = m_nodes[node];
+  if (n.m_kind == BQN_TERM) {
+    return index.m_terms[n.m_term];
+  }
+  storage = evaluateNode(node, index);
+  return storage;
+}
+
+
+SampleBitmap BitmapQuery::evaluateNode(int node,
+                                       BitmapIndex const &index) const
+{
+  Node const &n = m_nodes[node];
+  SampleBitmap left, right;
+  switch (n.m_kind) {
+    case BQN_TERM:
+      return index.m_terms[n.m_term];
+
+    case BQN_ALL:
+      return SampleBitmap::range(index.m_sampleCount);
+
+    case BQN_NOT:
+      return SampleBitmap::combine(
+        SampleBitmap::range(index.m_sampleCount),
+        operand(n.m_left, index, left), SBO_ANDNOT);
+
+    case BQN_AND:
+      return SampleBitmap::combine(operand(n.m_left, index, left),
+                                   operand(n.m_right, index, right),
+                                   SBO_AND);
+
+    case BQN_OR:
+      return SampleBitmap::combine(operand(n.m_left, index, left),
+                                   operand(n.m_right, index, right),
+                                   SBO_OR);
+
+    case BQN_ANDNOT:
+      return SampleBitmap::combine(operand(n.m_left, index, left),
+                                   operand(n.m_right, index, right),
+                                   SBO_ANDNOT);
+  }
+  return SampleBitmap();
+}
+
+
+bool BitmapQuery::matches(std::uint32_t terms) const
+{
+  return !m_nodes.empty() && matchesNode((int)m_nodes.size() - 1, terms);
+}
+
+
+bool BitmapQuery::matchesNode(int node, std::uint32_t terms) const
+{
+  Node const &n = m_nodes[node];
+  switch (n.m_kind) {
+    case BQN_TERM:
+      return (terms >> n.m_term) & 1;
+
+    case BQN_ALL:
+      return true;
+
+    case BQN_NOT:
+      return !matchesNode(n.m_left, terms);
+
+    case BQN_AND:
+      return matchesNode(n.m_left, terms) &&
+             matchesNode(n.m_right, terms);
+
+    case BQN_OR:
+      return matchesNode(n.m_left, terms) ||
+             matchesNode(n.m_right, terms);
+
+    case BQN_ANDNOT:
+      return matchesNode(n.m_left, terms) &&
+             !matchesNode(n.m_right, terms);
+  }
+  return false;
+}
+
+
+// EOF
@@ -0,0 +1,180 @@
+// bitmap-index.h
+// `BitmapIndex`, which records, for each button and threshold flag,
+// the samples of a recording in which it is set, and `BitmapQuery`, a
+// boolean expression over those.
+
+// See license.txt for copyright and terms of use.
+
+// A "term" is a boolean property of a sample: one of the sixteen
+// `XINPUT_GAMEPAD_*` bits, numbered by bit position, or one of the
+// `SampleFlag`s, which say whether an analog input is past one of the
+// thresholds in `AnalogThresholdConfig`, as in effect when the sample
+// was recorded.  For each term, the index holds a `SampleBitmap` of the
+// numbers (counting from 0) of the samples in which it is true.
+//
+// A query like "R1 held while B is released" is then
+//
+//   right_shoulder - b
+//
+// which is answered with bitmap operations, without looking at any
+// sample.  The syntax, loosest binding first, is:
+//
+//   a | b      either
+//   a & b      both
+//   a - b      a but not b
+//   !a         not a
+//   (a)
+//
+// with `&` and `-` at the same level, grouping left to right.  The
+// operands are term names and `all`, meaning every sample.
+//
+// The file layout, using the varints of varint.h, is:
+//
+//   8 bytes    magic: "GPVBITS" LF
+//   varint     format version, currently 1
+//   varint     number of samples
+//   varint     number of terms
+//   for each term: its bitmap, see `SampleBitmap::encode`
+
+#ifndef BITMAP_INDEX_H
+#define BITMAP_INDEX_H
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // AnalogThresholdConfig
+#include "sample-bitmap.h"             // SampleBitmap
+
+#include <cstdint>                     // std::uint32_t
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Current format version.
+int const BITMAP_INDEX_VERSION = 1;
+
+
+// Terms after the button bits.
+enum SampleFlag {
+  SFL_CONNECTED = 16,        // The controller is connected.
+  SFL_LEFT_TRIGGER,          // Left trigger past `m_triggerDeadZone`.
+  SFL_RIGHT_TRIGGER,         // Right trigger, likewise.
+  SFL_LEFT_STICK,            // Left stick outside its dead zone.
+  SFL_LEFT_RUN,              // Left stick at running speed or more.
+  SFL_LEFT_SPRINT,           // Left stick at sprinting speed.
+  SFL_RIGHT_STICK,           // Right stick outside its dead zone.
+
+  NUM_SAMPLE_TERMS
+};
+
+// Name of `term`, like "a" or "left_trigger".
+char const *sampleTermName(int term);
+
+// Return the term named `name`, or -1 if there is none.
+int sampleTermFromName(char const *name);
+
+// Return the terms true of `state` under `thresholds`, as a mask with
+// bit `term` set for each.  Like the viewer, a disconnected controller
+// has nothing pressed.
+std::uint32_t sampleTerms(ControllerState const &state,
+                          AnalogThresholdConfig const &thresholds);
+
+
+class BitmapIndex {
+public:      // data
+  // Number of samples added.
+  std::uint32_t m_sampleCount;
+
+  // For each term, the samples for which it is true.
+  SampleBitmap m_terms[NUM_SAMPLE_TERMS];
+
+public:      // methods
+  BitmapIndex();
+
+  // Add the next sample, with `terms` as returned by `sampleTerms`.
+  void add(std::uint32_t terms);
+
+  // Compress the bitmaps.  Call this once all samples are added.
+  void optimize();
+
+  // Bytes used by the bitmaps.
+  std::size_t sizeBytes() const;
+
+  // Append the file form to `dest`.
+  void encode(std::string &dest) const;
+
+  // Replace the contents with the file form in `data`.  Return an
+  // empty string on success, and an error message otherwise.
+  std::string decode(std::string const &data);
+};
+
+
+class BitmapQuery {
+private:     // types
+  enum NodeKind {
+    BQN_TERM,
+    BQN_ALL,
+    BQN_NOT,
+    BQN_AND,
+    BQN_OR,
+    BQN_ANDNOT,
+  };
+
+  // One node of the parsed expression.
+  class Node {
+  public:    // data
+    NodeKind m_kind;
+
+    // For `BQN_TERM`, the term.
+    int m_term;
+
+    // Indices in `m_nodes` of the operands, if any.
+    int m_left;
+    int m_right;
+
+  public:    // methods
+    Node(NodeKind kind, int term, int left, int right);
+  };
+
+private:     // data
+  // The nodes, each after its operands, so the last is the root.
+  std::vector<Node> m_nodes;
+
+  // Text being parsed, the position in it, and the first error found.
+  std::string m_text;
+  std::size_t m_pos;
+  std::string m_error;
+
+private:     // methods
+  // Parsing, one level of the grammar each.  They return the index of
+  // the node parsed, or -1 after setting `m_error`.
+  int parseOr();
+  int parseAnd();
+  int parseUnary();
+
+  // Skip spaces, and return the next character, or 0 at the end.
+  char peek();
+
+  SampleBitmap evaluateNode(int node, BitmapIndex const &index) const;
+
+  // The value of operand `node`: the index's own bitmap if it is a
+  // term, and otherwise `storage`, set to `evaluateNode`.
+  SampleBitmap const &operand(int node, BitmapIndex const &index,
+                              SampleBitmap &storage /*OUT*/) const;
+
+  bool matchesNode(int node, std::uint32_t terms) const;
+
+public:      // methods
+  BitmapQuery();
+
+  // Parse `text`.  Return an empty string on success, and an error
+  // message otherwise.
+  std::string parse(std::string const &text);
+
+  // The samples of `index` that satisfy the query.
+  SampleBitmap evaluate(BitmapIndex const &index) const;
+
+  // True if a sample with `terms` satisfies the query.
+  bool matches(std::uint32_t terms) const;
+};
+
+
+#endif // BITMAP_INDEX_H
@@ -0,0 +1,115 @@
+// bounded-queue.h
+// `BoundedQueue`, a blocking FIFO for passing work between threads.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>          // std::condition_variable
+#include <cstddef>                     // std::size_t
+#include <deque>                       // std::deque
+#include <mutex>                       // std::{mutex, unique_lock}
+#include <utility>                     // std::move
+
+
+// FIFO queue with a maximum size.  `push` blocks while the queue is
+// full and `pop` blocks while it is empty, so a fast producer cannot
+// get arbitrarily far ahead of a slow consumer.
+//
+// Once `close` has been called, `pop` drains the remaining items and
+// then returns false.
+//
+template <class T>
+class BoundedQueue {
+private:     // data
+  // Protects the other members.
+  std::mutex m_mutex;
+
+  // Signaled when an item is added or the queue is closed.
+  std::condition_variable m_notEmpty;
+
+  // Signaled when an item is removed.
+  std::condition_variable m_notFull;
+
+  // Items in FIFO order.
+  std::deque<T> m_items;
+
+  // Maximum number of items.
+  std::size_t m_capacity;
+
+  // True once `close` has been called.
+  bool m_closed;
+
+public:      // methods
+  explicit BoundedQueue(std::size_t capacity)
+    : m_mutex(),
+      m_notEmpty(),
+      m_notFull(),
+      m_items(),
+      m_capacity(capacity),
+      m_closed(false)
+  {}
+
+  // Add `item`, waiting for space if necessary.
+  void push(T item)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+    m_items.push_back(std::move(item));
+    m_notEmpty.notify_one();
+  }
+
+  // Like `push`, but return false immediately, leaving `item` alone,
+  // if the queue is full.
+  bool tryPush(T &item)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_items.size() >= m_capacity) {
+      return false;
+    }
+    m_items.push_back(std::move(item));
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  // Remove the oldest item into `item`, waiting for one if necessary.
+  // Return false if the queue is closed and empty.
+  bool pop(T &item /*OUT*/)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+    if (m_items.empty()) {
+      return false;
+    }
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  // Like `pop`, but return false immediately if the queue is empty.
+  bool tryPop(T &item /*OUT*/)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_items.empty()) {
+      return false;
+    }
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  // Indicate that no more items will be pushed, waking any consumers
+  // that are waiting.
+  void close()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_notEmpty.notify_all();
+  }
+};
+
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,100 @@
+// canvas.h
+// `Canvas`, abstract interface to the drawing primitives the viewer uses.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include "geometry.h"                  // Matrix3x2, Point2F, RectF
+
+#include <string>                      // std::wstring
+
+
+// A UI element role that corresponds to a color.
+enum GVColorRole {
+  // No color; used to indicate, e.g., an unfilled interior.
+  GVCR_NONE,
+
+  // The normal color used for most lines.
+  GVCR_NORMAL,
+
+  // The highlight color for chevrons.
+  GVCR_HIGHLIGHT,
+
+  // Color to indicate parry is active.
+  GVCR_PARRY_ACTIVE,
+
+  // Color to indicate parry is inactive.
+  GVCR_PARRY_INACTIVE,
+
+  // Background color behind the text that shows the milliseconds on
+  // the parry timer.
+  GVCR_TEXT_BACKGROUND,
+
+  // Text background colors for dodge invulnerability timer, depending
+  // on whether it is active (invulnerable).
+  GVCR_DODGE_ACTIVE,
+  GVCR_DODGE_INACTIVE,
+
+  NUM_GV_COLOR_ROLES
+};
+
+
+// Something the controller display can be drawn on.  There is one
+// implementation that forwards to Direct2D (`D2DCanvas`) and one that
+// rasterizes in memory (`RasterCanvas`).
+//
+// Shape coordinates are interpreted relative to the current transform.
+// Stroke widths are always in pixels, regardless of the transform.
+// Text ignores the transform; callers set the identity before drawing
+// it so that is evident at the call site.
+//
+class Canvas {
+public:      // data
+  // Number of primitives drawn since the last `resetPrimitiveCount`.
+  // Implementations increment this once per call of the drawing
+  // methods below.
+  int m_primitiveCount;
+
+public:      // methods
+  Canvas()
+    : m_primitiveCount(0)
+  {}
+
+  virtual ~Canvas() {}
+
+  void resetPrimitiveCount() { m_primitiveCount = 0; }
+
+  // Set the transform applied to subsequent shapes.
+  virtual void setTransform(Matrix3x2 const &transform) = 0;
+
+  // Outline or fill the ellipse centered at `center` with radii `rx`
+  // and `ry`.  `GVCR_NONE` draws nothing.
+  virtual void drawEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color, float strokeWidth) = 0;
+  virtual void fillEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color) = 0;
+
+  // Outline or fill a rectangle.
+  virtual void drawRectangle(RectF const &rect,
+                             GVColorRole color, float strokeWidth) = 0;
+  virtual void fillRectangle(RectF const &rect, GVColorRole color) = 0;
+
+  // Draw a line segment with flat caps.
+  virtual void drawLine(Point2F p1, Point2F p2,
+                        GVColorRole color, float strokeWidth) = 0;
+
+  // Return the rectangle that `str` would actually occupy if drawn in
+  // `layoutRect` by `drawText`.
+  virtual RectF measureText(std::wstring const &str,
+                            RectF const &layoutRect) = 0;
+
+  // Draw `str` in the text color, laid out within `layoutRect`.  Line
+  // breaks in `str` start new lines.
+  virtual void drawText(std::wstring const &str,
+                        RectF const &layoutRect) = 0;
+};
+
+
+#endif // CANVAS_H
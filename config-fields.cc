@@ -0,0 +1,66 @@
+// config-fields.cc
+// Code for `config-fields` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "config-fields.h"             // this module
+
+
+void readConfigJSONValue(JSONReader &reader, COLORREF &value)
+{
+  int rgb[3] = { 0, 0, 0 };
+  int count = 0;
+  reader.readArray([&reader, &rgb, &count]() {
+    if (count < 3) {
+      int c = -1;
+      reader.readInt(c);
+      if (c >= 0) {
+        rgb[count++] = c;
+      }
+      else {
+        // Not a color component; poison the result.
+        count = 4;
+      }
+    }
+    else {
+      reader.skipValue();
+    }
+  });
+
+  if (count == 3) {
+    value = RGB(rgb[0], rgb[1], rgb[2]);
+  }
+}
+
+
+bool skipConfigValue(char const *&p, char const *end, int wireType)
+{
+  switch (wireType) {
+    case CWT_VARINT: {
+      std::uint64_t v;
+      return readVarint(p, end, v);
+    }
+
+    case CWT_FIXED32:
+      if (end - p < 4) {
+        return false;
+      }
+      p += 4;
+      return true;
+
+    case CWT_BYTES: {
+      std::uint64_t len;
+      if (!readVarint(p, end, len) || len > (std::uint64_t)(end - p)) {
+        return false;
+      }
+      p += len;
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+
+// EOF
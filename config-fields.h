@@ -0,0 +1,585 @@
+// config-fields.h
+// Field descriptor tables for the configuration classes.
+
+// See license.txt for copyright and terms of use.
+
+// Each configuration class `C` describes its fields once, in a
+// specialization of `ConfigFieldTable<C>` whose `c_fields` is a tuple
+// of descriptors, each giving a binary ID, the JSON key, the member
+// pointer, and (for scalars) the default value.  The function templates
+// here walk that tuple to set defaults, compare, diff, read from a
+// `JSONReader`, and encode and decode a compact binary form.  The
+// `json::JSON` tree conversions are in gpv-config.cc, which keeps
+// json.hpp out of the headers.
+//
+// The member type selects how a field is handled: `bool`, `int`,
+// `float`, `COLORREF` (an "[r,g,b]" array in JSON), `std::string`,
+// another class with its own table (a nested object), or a
+// `std::vector` of such objects (an array).
+//
+// Binary encoding: a sequence of fields, each a varint key of
+// (ID << 3) | wire type, followed by the value:
+//
+//   CWT_VARINT   varint: bool as 0/1, int zigzagged, COLORREF
+//   CWT_FIXED32  4 bytes, little endian: float bits
+//   CWT_BYTES    varint length, then that many bytes: string bytes,
+//                nested object, or for a vector, each element as a
+//                varint length and nested object
+//
+// Decoding skips fields whose ID is unknown or whose wire type does not
+// match, so encodings stay readable after fields are added or removed,
+// provided an ID is never reused for a different field.
+
+#ifndef CONFIG_FIELDS_H
+#define CONFIG_FIELDS_H
+
+#include "json-reader.h"               // JSONReader
+#include "varint.h"                    // appendVarint, readVarint
+#include "windows-compat.h"            // COLORREF
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::uint32_t, std::uint64_t
+#include <cstring>                     // std::memcpy
+#include <string>                      // std::string
+#include <string_view>                 // std::string_view
+#include <tuple>                       // std::apply, std::tuple_size
+#include <vector>                      // std::vector
+
+
+// Lets a function template parameter's type be determined by the other
+// parameters, so that, e.g., a `double` literal can be the default of a
+// `float` field.
+template <class T>
+struct ConfigNonDeduced {
+  typedef T type;
+};
+
+
+// A scalar field of `C` whose type is `T`.
+template <class C, class T>
+class ConfigField {
+public:      // data
+  // Identifier in the binary encoding.  Unique within `C`.
+  int m_id;
+
+  // Key in JSON.
+  char const *m_name;
+
+  // The field.
+  T C::*m_member;
+
+  // Its value in a default-constructed `C`.
+  T m_default;
+
+public:      // methods
+  constexpr ConfigField(int id, char const *name, T C::*member, T dflt)
+    : m_id(id),
+      m_name(name),
+      m_member(member),
+      m_default(dflt)
+  {}
+};
+
+
+// A field of `C` whose default is a default-constructed `T`: a nested
+// object whose class has its own table, a string, or a vector.
+template <class C, class T>
+class ConfigObjectField {
+public:      // data
+  // As for `ConfigField`.
+  int m_id;
+  char const *m_name;
+  T C::*m_member;
+
+public:      // methods
+  constexpr ConfigObjectField(int id, char const *name, T C::*member)
+    : m_id(id),
+      m_name(name),
+      m_member(member)
+  {}
+};
+
+
+// Make a descriptor for a field of `C`.  The member may belong to a base
+// class `B` of `C`.
+template <class C, class B, class T>
+constexpr ConfigField<C, T> configField(
+  int id, char const *name, T B::*member,
+  typename ConfigNonDeduced<T>::type dflt)
+{
+  return ConfigField<C, T>(id, name, member, dflt);
+}
+
+template <class C, class B, class T>
+constexpr ConfigObjectField<C, T> configObjectField(
+  int id, char const *name, T B::*member)
+{
+  return ConfigObjectField<C, T>(id, name, member);
+}
+
+
+// Specialized for each configuration class to have:
+//
+//   static constexpr auto c_fields = std::make_tuple(...);
+//
+template <class C>
+struct ConfigFieldTable;
+
+
+// Call `func(field)` for each descriptor of `C`, in table order.
+template <class C, class FUNC>
+void forEachConfigField(FUNC &&func)
+{
+  std::apply([&func](auto const &...field) {
+    (func(field), ...);
+  }, ConfigFieldTable<C>::c_fields);
+}
+
+
+// ---------------------------- table checks ---------------------------
+// True if no two fields of `C` have the same binary ID and all IDs are
+// positive.
+template <class C>
+constexpr bool configFieldIDsAreUnique()
+{
+  constexpr std::size_t n = std::tuple_size<
+    decltype(ConfigFieldTable<C>::c_fields)>::value;
+  int ids[n > 0? n : 1] = {};
+  std::size_t i = 0;
+  std::apply([&ids, &i](auto const &...field) {
+    ((ids[i++] = field.m_id), ...);
+  }, ConfigFieldTable<C>::c_fields);
+
+  for (std::size_t a=0; a < n; ++a) {
+    if (ids[a] <= 0) {
+      return false;
+    }
+    for (std::size_t b=a+1; b < n; ++b) {
+      if (ids[a] == ids[b]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// True if the table of `C` has an entry for each of its
+// `C::NUM_FIELDS` data members.  This does not depend on the layout of
+// `C`, so unlike comparing sizes it also catches a small member that
+// fits in padding, but it relies on the count being updated along with
+// the class.
+template <class C>
+constexpr bool configFieldsCoverClass()
+{
+  return std::tuple_size<decltype(ConfigFieldTable<C>::c_fields)>::value
+         == C::NUM_FIELDS;
+}
+
+
+// ----------------------------- defaults ------------------------------
+template <class C, class T>
+void setConfigFieldDefault(C &obj, ConfigField<C, T> const &field)
+{
+  obj.*(field.m_member) = field.m_default;
+}
+
+template <class C, class T>
+void setConfigFieldDefault(C &obj, ConfigObjectField<C, T> const &field)
+{
+  obj.*(field.m_member) = T();
+}
+
+
+// Set every field of `obj` to its default.
+template <class C>
+void setConfigDefaults(C &obj)
+{
+  forEachConfigField<C>([&obj](auto const &field) {
+    setConfigFieldDefault(obj, field);
+  });
+}
+
+
+// ----------------------------- equality ------------------------------
+// True if all fields of `a` and `b` are equal.  Nested objects are
+// compared with their `operator==`.
+template <class C>
+bool configEquals(C const &a, C const &b)
+{
+  return std::apply([&a, &b](auto const &...field) {
+    return ((a.*(field.m_member) == b.*(field.m_member)) && ...);
+  }, ConfigFieldTable<C>::c_fields);
+}
+
+
+// ------------------------------- diff --------------------------------
+template <class C>
+void diffConfig(C const &a, C const &b, std::string const &prefix,
+                std::vector<std::string> &names);
+
+template <class C, class T>
+void diffConfigField(C const &a, C const &b, std::string const &prefix,
+                     std::vector<std::string> &names,
+                     ConfigField<C, T> const &field)
+{
+  if (!( a.*(field.m_member) == b.*(field.m_member) )) {
+    names.push_back(prefix + field.m_name);
+  }
+}
+
+// Compare the values of a field named `name`.  Nested objects are
+// compared field by field; strings and vectors as a whole.
+template <class T>
+void diffConfigValue(T const &a, T const &b, std::string const &name,
+                     std::vector<std::string> &names)
+{
+  diffConfig(a, b, name + ".", names);
+}
+
+inline void diffConfigValue(std::string const &a, std::string const &b,
+                            std::string const &name,
+                            std::vector<std::string> &names)
+{
+  if (a != b) {
+    names.push_back(name);
+  }
+}
+
+template <class T>
+void diffConfigValue(std::vector<T> const &a, std::vector<T> const &b,
+                     std::string const &name,
+                     std::vector<std::string> &names)
+{
+  if (a != b) {
+    names.push_back(name);
+  }
+}
+
+template <class C, class T>
+void diffConfigField(C const &a, C const &b, std::string const &prefix,
+                     std::vector<std::string> &names,
+                     ConfigObjectField<C, T> const &field)
+{
+  diffConfigValue(a.*(field.m_member), b.*(field.m_member),
+                  prefix + field.m_name, names);
+}
+
+
+// Append to `names` the key of every field that differs between `a`
+// and `b`, with nested keys joined by "." and prefixed by `prefix`.
+template <class C>
+void diffConfig(C const &a, C const &b, std::string const &prefix,
+                std::vector<std::string> &names)
+{
+  forEachConfigField<C>([&](auto const &field) {
+    diffConfigField(a, b, prefix, names, field);
+  });
+}
+
+
+// -------------------------- reading JSON text ------------------------
+template <class C>
+bool readConfigJSONMember(C &obj, std::string_view key, JSONReader &reader);
+
+
+inline void readConfigJSONValue(JSONReader &reader, bool &value)
+{
+  reader.readBool(value);
+}
+
+inline void readConfigJSONValue(JSONReader &reader, int &value)
+{
+  reader.readInt(value);
+}
+
+inline void readConfigJSONValue(JSONReader &reader, float &value)
+{
+  reader.readFloat(value);
+}
+
+// Read an "[r,g,b]" array.  If the value is not an array of at least
+// three non-negative integers, leave `value` alone.
+void readConfigJSONValue(JSONReader &reader, COLORREF &value);
+
+inline void readConfigJSONValue(JSONReader &reader, std::string &value)
+{
+  reader.readString(value);
+}
+
+// Read a nested object.
+template <class T>
+void readConfigJSONValue(JSONReader &reader, T &obj)
+{
+  reader.readObject([&obj, &reader](std::string_view key) {
+    return readConfigJSONMember(obj, key, reader);
+  });
+}
+
+// Read an array of objects, replacing the contents of `vec`.  Each
+// element starts from the defaults.
+template <class T>
+void readConfigJSONValue(JSONReader &reader, std::vector<T> &vec)
+{
+  vec.clear();
+  reader.readArray([&vec, &reader]() {
+    vec.emplace_back();
+    readConfigJSONValue(reader, vec.back());
+  });
+}
+
+
+// If `key` names a field of `C`, read the value from `reader` into it
+// and return true.  Otherwise consume nothing and return false.
+template <class C>
+bool readConfigJSONMember(C &obj, std::string_view key, JSONReader &reader)
+{
+  bool found = false;
+  forEachConfigField<C>([&](auto const &field) {
+    if (!found && key == field.m_name) {
+      readConfigJSONValue(reader, obj.*(field.m_member));
+      found = true;
+    }
+  });
+  return found;
+}
+
+
+// -------------------------- binary encoding --------------------------
+// How a field value is laid out in the binary encoding.
+enum ConfigWireType {
+  CWT_VARINT  = 0,
+  CWT_FIXED32 = 1,
+  CWT_BYTES   = 2,
+};
+
+
+template <class C>
+void encodeConfigBinary(C const &obj, std::string &dest);
+
+template <class C>
+bool decodeConfigBinary(C &obj, char const *p, char const *end);
+
+
+inline ConfigWireType configWireType(bool const *)     { return CWT_VARINT; }
+inline ConfigWireType configWireType(int const *)      { return CWT_VARINT; }
+inline ConfigWireType configWireType(COLORREF const *) { return CWT_VARINT; }
+inline ConfigWireType configWireType(float const *)    { return CWT_FIXED32; }
+template <class T>
+ConfigWireType configWireType(T const *)               { return CWT_BYTES; }
+
+
+inline void encodeConfigValue(std::string &dest, bool value)
+{
+  appendVarint(dest, value? 1 : 0);
+}
+
+inline void encodeConfigValue(std::string &dest, int value)
+{
+  appendSignedVarint(dest, value);
+}
+
+inline void encodeConfigValue(std::string &dest, COLORREF value)
+{
+  appendVarint(dest, value);
+}
+
+inline void encodeConfigValue(std::string &dest, float value)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, 4);
+  for (int i=0; i < 4; ++i) {
+    dest.push_back((char)(bits >> (i*8)));
+  }
+}
+
+inline void encodeConfigValue(std::string &dest, std::string const &value)
+{
+  appendVarint(dest, value.size());
+  dest += value;
+}
+
+template <class T>
+void encodeConfigValue(std::string &dest, T const &obj)
+{
+  std::string nested;
+  encodeConfigBinary(obj, nested);
+  appendVarint(dest, nested.size());
+  dest += nested;
+}
+
+// The elements are nested objects, so each one is length-prefixed just
+// as a single nested object would be.
+template <class T>
+void encodeConfigValue(std::string &dest, std::vector<T> const &vec)
+{
+  std::string elements;
+  for (T const &elt : vec) {
+    encodeConfigValue(elements, elt);
+  }
+  appendVarint(dest, elements.size());
+  dest += elements;
+}
+
+
+// Decode a value of the wire type for `value` at `p`, advancing `p`.
+// Return false if it runs past `end`.
+inline bool decodeConfigValue(char const *&p, char const *end, bool &value)
+{
+  std::uint64_t v;
+  if (!readVarint(p, end, v)) {
+    return false;
+  }
+  value = (v != 0);
+  return true;
+}
+
+inline bool decodeConfigValue(char const *&p, char const *end, int &value)
+{
+  std::int64_t v;
+  if (!readSignedVarint(p, end, v)) {
+    return false;
+  }
+  value = (int)v;
+  return true;
+}
+
+inline bool decodeConfigValue(char const *&p, char const *end,
+                              COLORREF &value)
+{
+  std::uint64_t v;
+  if (!readVarint(p, end, v)) {
+    return false;
+  }
+  value = (COLORREF)v;
+  return true;
+}
+
+inline bool decodeConfigValue(char const *&p, char const *end, float &value)
+{
+  if (end - p < 4) {
+    return false;
+  }
+  std::uint32_t bits = 0;
+  for (int i=0; i < 4; ++i) {
+    bits |= (std::uint32_t)(unsigned char)p[i] << (i*8);
+  }
+  std::memcpy(&value, &bits, 4);
+  p += 4;
+  return true;
+}
+
+// Read the varint length that starts a CWT_BYTES value and set
+// `valueEnd` to the end of the value.  Return false if it runs past
+// `end`.
+inline bool decodeConfigLength(char const *&p, char const *end,
+                               char const *&valueEnd /*OUT*/)
+{
+  std::uint64_t len;
+  if (!readVarint(p, end, len) || len > (std::uint64_t)(end - p)) {
+    return false;
+  }
+  valueEnd = p + len;
+  return true;
+}
+
+inline bool decodeConfigValue(char const *&p, char const *end,
+                              std::string &value)
+{
+  char const *valueEnd;
+  if (!decodeConfigLength(p, end, valueEnd)) {
+    return false;
+  }
+  value.assign(p, valueEnd);
+  p = valueEnd;
+  return true;
+}
+
+template <class T>
+bool decodeConfigValue(char const *&p, char const *end, T &obj)
+{
+  char const *nestedEnd;
+  if (!decodeConfigLength(p, end, nestedEnd)) {
+    return false;
+  }
+  bool ok = decodeConfigBinary(obj, p, nestedEnd);
+  p = nestedEnd;
+  return ok;
+}
+
+// Replaces the contents of `vec`.
+template <class T>
+bool decodeConfigValue(char const *&p, char const *end, std::vector<T> &vec)
+{
+  char const *elementsEnd;
+  if (!decodeConfigLength(p, end, elementsEnd)) {
+    return false;
+  }
+
+  vec.clear();
+  while (p < elementsEnd) {
+    vec.emplace_back();
+    if (!decodeConfigValue(p, elementsEnd, vec.back())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// Skip a value of `wireType` at `p`.  Return false if it runs past
+// `end` or the wire type is unknown.
+bool skipConfigValue(char const *&p, char const *end, int wireType);
+
+
+// Append the binary encoding of `obj` to `dest`.
+template <class C>
+void encodeConfigBinary(C const &obj, std::string &dest)
+{
+  forEachConfigField<C>([&obj, &dest](auto const &field) {
+    auto const &value = obj.*(field.m_member);
+    appendVarint(dest,
+      ((std::uint64_t)field.m_id << 3) | configWireType(&value));
+    encodeConfigValue(dest, value);
+  });
+}
+
+
+// Decode [p,end) into `obj`.  Fields not present keep their current
+// values.  Return false if the data is malformed, in which case `obj`
+// may be partially updated.
+template <class C>
+bool decodeConfigBinary(C &obj, char const *p, char const *end)
+{
+  while (p < end) {
+    std::uint64_t key;
+    if (!readVarint(p, end, key)) {
+      return false;
+    }
+    std::uint64_t id = key >> 3;
+    int wireType = (int)(key & 7);
+
+    bool found = false;
+    bool ok = true;
+    forEachConfigField<C>([&](auto const &field) {
+      auto &value = obj.*(field.m_member);
+      if (!found &&
+          id == (std::uint64_t)field.m_id &&
+          wireType == configWireType(&value)) {
+        found = true;
+        ok = decodeConfigValue(p, end, value);
+      }
+    });
+
+    if (!found) {
+      ok = skipConfigValue(p, end, wireType);
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+#endif // CONFIG_FIELDS_H
@@ -0,0 +1,105 @@
+// config-persister-test.cc
+// Tests for `config-persister` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "config-persister.h"          // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <chrono>                      // std::chrono
+#include <filesystem>                  // std::filesystem
+#include <fstream>                     // std::ifstream
+#include <sstream>                     // std::ostringstream
+#include <thread>                      // std::this_thread
+
+namespace fs = std::filesystem;
+
+
+// Wait up to a few seconds for `cond` to become true.
+template <class F>
+static bool waitFor(F const &cond)
+{
+  for (int i = 0; i < 500; ++i) {
+    if (cond()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return cond();
+}
+
+
+UNIT_TEST(configPersisterWritesSubmitted)
+{
+  std::string fname = unitTestTempDir() + "/persisted.json";
+  ConfigPersister persister(fname, nullptr, 10 /*debounceMS*/);
+  persister.start();
+
+  GPVConfig config;
+  config.m_controllerID = 2;
+  persister.submit(config);
+  persister.stop();
+
+  EXPECT_EQ(persister.numWrites(), 1);
+  GPVConfig loaded;
+  EXPECT_EQ(loaded.loadFromFile(fname), "");
+  EXPECT(loaded == config);
+}
+
+
+UNIT_TEST(configPersisterRetriesFailedWrite)
+{
+  // While a directory is in the way, the write fails.
+  std::string fname = unitTestTempDir() + "/blocked.json";
+  fs::create_directory(fname);
+
+  ConfigPersister persister(fname, nullptr, 10 /*debounceMS*/);
+  persister.start();
+
+  GPVConfig config;
+  config.m_controllerID = 1;
+  persister.submit(config);
+  EXPECT(waitFor([&] { return !persister.lastError().empty(); }));
+  EXPECT_EQ(persister.numWrites(), 0);
+
+  // Once it is gone, the same configuration is written without being
+  // submitted again.
+  fs::remove(fname);
+  EXPECT(waitFor([&] { return persister.numWrites() == 1; }));
+  EXPECT_EQ(persister.lastError(), "");
+  EXPECT(persister.isLastWritten(config));
+  persister.stop();
+}
+
+
+UNIT_TEST(configPersisterAppendsLogs)
+{
+  std::string fname = unitTestTempDir() + "/unused.json";
+  std::string logName = unitTestTempDir() + "/appended.log";
+
+  // Logs do not wait for the debounce interval.
+  ConfigPersister persister(fname, nullptr, 60000 /*debounceMS*/);
+  persister.start();
+  persister.submit(GPVConfig());
+  persister.appendLog(logName, "one\n");
+  persister.appendLog(logName, "two\n");
+
+  auto contents = [&] {
+    std::ostringstream oss;
+    oss << std::ifstream(logName).rdbuf();
+    return oss.str();
+  };
+  EXPECT(waitFor([&] { return contents() == "one\ntwo\n"; }));
+  EXPECT_EQ(persister.numWrites(), 0);
+
+  // The rest are written by `stop`.
+  persister.appendLog(logName, "three\n");
+  persister.stop();
+  EXPECT_EQ(contents(), "one\ntwo\nthree\n");
+  EXPECT_EQ(persister.lastLogError(), "");
+  EXPECT_EQ(persister.numWrites(), 1);
+}
+
+
+// EOF
@@ -0,0 +1,244 @@
+// config-persister.cc
+// Code for `config-persister` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "config-persister.h"          // this module
+
+#include "atomic-file.h"               // writeFileAtomically
+#include "trace-ring.h"                // traceEvent, traceSetThreadName
+
+#include <algorithm>                   // std::max
+#include <fstream>                     // std::ofstream
+#include <utility>                     // std::move
+
+
+ConfigPersister::ConfigPersister(std::string const &fname,
+                                 GPVConfig const *saved,
+                                 int debounceMS)
+  : m_fname(fname),
+    m_debounce(std::chrono::milliseconds(debounceMS)),
+    m_mutex(),
+    m_changed(),
+    m_pending(),
+    m_pendingSince(),
+    m_lastWritten(saved? new GPVConfig(*saved) : nullptr),
+    m_lastWriteTime(),
+    m_stopRequested(false),
+    m_numWrites(0),
+    m_numSkipped(0),
+    m_lastError(),
+    m_logAppends(),
+    m_lastLogError(),
+    m_thread()
+{}
+
+
+ConfigPersister::~ConfigPersister()
+{
+  stop();
+}
+
+
+void ConfigPersister::start()
+{
+  if (!m_thread.joinable()) {
+    m_thread = std::thread(&ConfigPersister::run, this);
+  }
+}
+
+
+void ConfigPersister::submit(GPVConfig const &config)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopRequested) {
+      return;
+    }
+
+    if (m_pending) {
+      *m_pending = config;
+    }
+    else {
+      m_pending.reset(new GPVConfig(config));
+      m_pendingSince = Clock::now();
+    }
+  }
+  m_changed.notify_one();
+}
+
+
+void ConfigPersister::appendLog(std::string const &fname,
+                                std::string const &text)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopRequested) {
+      return;
+    }
+    m_logAppends.emplace_back(fname, text);
+  }
+  m_changed.notify_one();
+}
+
+
+void ConfigPersister::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopRequested = true;
+  }
+  m_changed.notify_one();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  else {
+    // Never started, so do the final writes here.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    writeLogsLocked(lock);
+    if (m_pending) {
+      writeLocked(lock, std::move(m_pending));
+    }
+  }
+}
+
+
+bool ConfigPersister::isLastWritten(GPVConfig const &config) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_lastWritten && *m_lastWritten == config;
+}
+
+
+int ConfigPersister::numWrites() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_numWrites;
+}
+
+
+int ConfigPersister::numSkipped() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_numSkipped;
+}
+
+
+std::string ConfigPersister::lastError() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_lastError;
+}
+
+
+std::string ConfigPersister::lastLogError() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_lastLogError;
+}
+
+
+void ConfigPersister::writeLocked(std::unique_lock<std::mutex> &lock,
+                                  std::unique_ptr<GPVConfig> config)
+{
+  if (m_lastWritten && *m_lastWritten == *config) {
+    // Changed and then changed back, or only touched.
+    ++m_numSkipped;
+    return;
+  }
+
+  // Serialize and write without holding the lock so `submit` never
+  // waits for the disk.  Only this thread (or `stop`, after it) gets
+  // here, so there is no concurrent write to the same file.
+  lock.unlock();
+  auto start = Clock::now();
+  std::string error = config->saveToFile(m_fname);
+  traceEvent(TE_CONFIG_WRITE,
+    (std::int32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start).count(),
+    error.empty());
+  lock.lock();
+
+  m_lastWriteTime = Clock::now();
+  m_lastError = error;
+  if (error.empty()) {
+    ++m_numWrites;
+    m_lastWritten = std::move(config);
+  }
+  else if (!m_pending) {
+    // Try again after the debounce interval, unless something newer
+    // has been submitted meanwhile, in which case that is written
+    // instead.
+    m_pending = std::move(config);
+    m_pendingSince = m_lastWriteTime;
+  }
+}
+
+
+void ConfigPersister::writeLogsLocked(std::unique_lock<std::mutex> &lock)
+{
+  if (m_logAppends.empty()) {
+    return;
+  }
+
+  std::vector<std::pair<std::string, std::string>> appends;
+  appends.swap(m_logAppends);
+
+  lock.unlock();
+  std::string error;
+  for (auto const &append : appends) {
+    std::ofstream out(append.first, std::ios::app);
+    out << append.second;
+    if (!out) {
+      error = append.first + ": write failed";
+    }
+  }
+  lock.lock();
+
+  if (!error.empty()) {
+    m_lastLogError = error;
+  }
+}
+
+
+void ConfigPersister::run()
+{
+  traceSetThreadName("configSave");
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (true) {
+    m_changed.wait(lock, [this] {
+      return m_pending || !m_logAppends.empty() || m_stopRequested;
+    });
+
+    writeLogsLocked(lock);
+
+    if (m_pending && !m_stopRequested) {
+      // Wait one interval after the first change to collect any that
+      // follow it, and in any case one interval after the last write.
+      // Logs that arrive meanwhile are written without waiting.
+      Clock::time_point deadline =
+        std::max(m_pendingSince, m_lastWriteTime) + m_debounce;
+      if (Clock::now() < deadline) {
+        m_changed.wait_until(lock, deadline, [this] {
+          return m_stopRequested || !m_logAppends.empty();
+        });
+        continue;
+      }
+    }
+
+    if (m_pending) {
+      writeLocked(lock, std::move(m_pending));
+    }
+
+    if (m_stopRequested) {
+      // Anything appended during the final write.
+      writeLogsLocked(lock);
+      break;
+    }
+  }
+}
+
+
+// EOF
@@ -0,0 +1,142 @@
+// config-persister.h
+// `ConfigPersister`, which saves the configuration in the background.
+
+// See license.txt for copyright and terms of use.
+
+// The viewer hands the persister a copy of its configuration whenever
+// it changes, which during a window drag is dozens of times a second.
+// A background thread coalesces those into at most one write per
+// debounce interval, skips writes that would not change the file, and
+// writes with `writeFileAtomically`, so the file on disk is always a
+// complete configuration even if the viewer is killed.
+//
+// The same thread appends to the viewer's log files, so that the UI
+// thread does not wait for those writes either.
+
+#ifndef CONFIG_PERSISTER_H
+#define CONFIG_PERSISTER_H
+
+#include "gpv-config.h"                // GPVConfig
+
+#include <chrono>                      // std::chrono::steady_clock
+#include <condition_variable>          // std::condition_variable
+#include <memory>                      // std::unique_ptr
+#include <mutex>                       // std::mutex
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <utility>                     // std::pair
+#include <vector>                      // std::vector
+
+
+class ConfigPersister {
+public:      // types
+  typedef std::chrono::steady_clock Clock;
+
+public:      // data
+  // File to write.
+  std::string const m_fname;
+
+  // Minimum time between writes.
+  Clock::duration const m_debounce;
+
+private:     // data
+  // Protects the fields below it.
+  mutable std::mutex m_mutex;
+
+  // Signaled when `m_pending`, `m_logAppends`, or `m_stopRequested`
+  // changes.
+  std::condition_variable m_changed;
+
+  // Latest configuration submitted but not yet written, or null.
+  std::unique_ptr<GPVConfig> m_pending;
+
+  // When `m_pending` went from null to non-null.
+  Clock::time_point m_pendingSince;
+
+  // What the file is known to contain, or null if that is unknown.
+  std::unique_ptr<GPVConfig> m_lastWritten;
+
+  // When the last write finished.
+  Clock::time_point m_lastWriteTime;
+
+  // Set by `stop`.
+  bool m_stopRequested;
+
+  // Number of times the file was written.
+  int m_numWrites;
+
+  // Number of snapshots not written because they matched
+  // `m_lastWritten`.
+  int m_numSkipped;
+
+  // Error from the most recent write, or empty.
+  std::string m_lastError;
+
+  // Text to append to log files, in order, as (file name, text).
+  std::vector<std::pair<std::string, std::string>> m_logAppends;
+
+  // Error from the most recent failed log append, or empty.
+  std::string m_lastLogError;
+
+  // Background thread, if started.
+  std::thread m_thread;
+
+private:     // methods
+  // Background thread body.
+  void run();
+
+  // Write `config` unless it matches `m_lastWritten`.  If the write
+  // fails, `config` becomes pending again, so it is retried.  `lock`
+  // holds `m_mutex` on entry and exit, but is released during the
+  // write.
+  void writeLocked(std::unique_lock<std::mutex> &lock,
+                   std::unique_ptr<GPVConfig> config);
+
+  // Write and clear `m_logAppends`, releasing `lock` meanwhile.
+  void writeLogsLocked(std::unique_lock<std::mutex> &lock);
+
+public:      // methods
+  // `saved`, if not null, is what the file currently contains, so
+  // that submitting an equal configuration does not rewrite it.  This
+  // does not start the thread; call `start` for that.
+  ConfigPersister(std::string const &fname,
+                  GPVConfig const *saved,
+                  int debounceMS = 1000);
+
+  // Stops the thread, writing any pending configuration first.
+  ~ConfigPersister();
+
+  ConfigPersister(ConfigPersister const &obj) = delete;
+  ConfigPersister &operator=(ConfigPersister const &obj) = delete;
+
+  // Start the background thread.
+  void start();
+
+  // Schedule `config` to be written.  This replaces any earlier
+  // snapshot that has not been written yet.  It only copies `config`
+  // and never waits for I/O.
+  void submit(GPVConfig const &config);
+
+  // Schedule `text` to be appended to the file `fname`.  Unlike
+  // configurations, these are written as soon as possible, and all of
+  // them are.  This never waits for I/O.  After `stop`, it has no
+  // effect.
+  void appendLog(std::string const &fname, std::string const &text);
+
+  // Write any pending configuration and logs now, then stop the thread
+  // and wait for it to finish.  After this, `submit` has no effect.
+  void stop();
+
+  // True if `config` is what the persister last wrote (or was told
+  // the file contains).  The viewer uses this to recognize its own
+  // writes when the config watcher reports them.
+  bool isLastWritten(GPVConfig const &config) const;
+
+  int numWrites() const;
+  int numSkipped() const;
+  std::string lastError() const;
+  std::string lastLogError() const;
+};
+
+
+#endif // CONFIG_PERSISTER_H
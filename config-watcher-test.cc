@@ -0,0 +1,79 @@
+// config-watcher-test.cc
+// Tests for `config-watcher` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "config-watcher.h"            // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <chrono>                      // std::chrono
+#include <thread>                      // std::this_thread
+
+#ifndef _WIN32
+  #include <sys/resource.h>            // getrlimit, setrlimit
+  #include <unistd.h>                  // dup, close
+  #include <vector>                    // std::vector
+#endif
+
+
+UNIT_TEST(configWatcherReloadsChangedFile)
+{
+  std::string fname = unitTestTempDir() + "/watched.json";
+  GPVConfig config;
+  EXPECT_EQ(config.saveToFile(fname), "");
+
+  ConfigWatcher watcher(fname, CWM_POLL, 10 /*pollIntervalMS*/);
+  EXPECT_EQ(watcher.start(), "");
+
+  // Change the size so the signature differs even if the time
+  // resolution is coarse.
+  config.m_controllerID = 3;
+  config.m_profiles.push_back(TimingProfile());
+  EXPECT_EQ(config.saveToFile(fname), "");
+
+  std::unique_ptr<ConfigUpdate> update;
+  for (int i = 0; i < 500 && !update; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    update = watcher.takeUpdate();
+  }
+  EXPECT(update != nullptr);
+  if (update) {
+    EXPECT_EQ(update->m_error, "");
+    EXPECT_EQ(update->m_config.m_controllerID, 3);
+  }
+  watcher.stop();
+}
+
+
+#ifndef _WIN32
+UNIT_TEST(configWatcherStartFailsWithoutPipe)
+{
+  // Use up every descriptor the limit allows so that `pipe` fails.
+  struct rlimit saved;
+  EXPECT_EQ(getrlimit(RLIMIT_NOFILE, &saved), 0);
+  struct rlimit lowered = saved;
+  lowered.rlim_cur = 64;
+  EXPECT_EQ(setrlimit(RLIMIT_NOFILE, &lowered), 0);
+
+  std::vector<int> fds;
+  for (int fd; (fd = dup(0)) >= 0; ) {
+    fds.push_back(fd);
+  }
+
+  {
+    ConfigWatcher watcher(unitTestTempDir() + "/unused.json");
+    EXPECT(!watcher.start().empty());
+
+    // The destructor must not wait for a thread that was not started.
+  }
+
+  for (int fd : fds) {
+    close(fd);
+  }
+  setrlimit(RLIMIT_NOFILE, &saved);
+}
+#endif // !_WIN32
+
+
+// EOF
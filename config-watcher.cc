@@ -0,0 +1,475 @@
+// config-watcher.cc
+// Code for `config-watcher` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "config-watcher.h"            // this module
+
+#include <cerrno>                      // errno, EINTR
+#include <cstdint>                     // std::uintmax_t
+#include <cstring>                     // std::strerror
+#include <filesystem>                  // std::filesystem
+#include <system_error>                // std::error_code
+
+#ifdef _WIN32
+  #include <windows.h>                 // FindFirstChangeNotification, etc.
+#else
+  #include <poll.h>                    // poll
+  #include <unistd.h>                  // pipe, read, write, close
+  #ifdef __linux__
+    #include <fcntl.h>                 // O_NONBLOCK
+    #include <sys/inotify.h>           // inotify_*
+  #endif
+#endif
+
+namespace fs = std::filesystem;
+
+
+// After being notified of a change, how long to wait for further
+// changes before reading the file.  Editors often save in several
+// steps (truncate, write, close, or write-then-rename), and Windows
+// notifies at the first of them.
+static int const c_settleMS = 50;
+
+
+// ---------------------------- ConfigUpdate ---------------------------
+ConfigUpdate::ConfigUpdate()
+  : m_config(),
+    m_error()
+{}
+
+
+char const *toString(ConfigWatchMethod method)
+{
+  switch (method) {
+    case CWM_NOTIFY:     return "notify";
+    case CWM_POLL:       return "poll";
+    default:             return "unknown";
+  }
+}
+
+
+// --------------------------- FileSignature ---------------------------
+// What we check to decide whether the file has changed.
+class FileSignature {
+public:      // data
+  bool m_exists;
+  fs::file_time_type m_modifiedTime;
+  std::uintmax_t m_size;
+
+public:      // methods
+  // Signature of `fname` now.
+  explicit FileSignature(std::string const &fname)
+    : m_exists(false),
+      m_modifiedTime(),
+      m_size(0)
+  {
+    std::error_code ec;
+    m_modifiedTime = fs::last_write_time(fname, ec);
+    if (!ec) {
+      m_size = fs::file_size(fname, ec);
+      m_exists = !ec;
+    }
+  }
+
+  bool operator==(FileSignature const &obj) const
+  {
+    return m_exists       == obj.m_exists &&
+           m_modifiedTime == obj.m_modifiedTime &&
+           m_size         == obj.m_size;
+  }
+
+  bool operator!=(FileSignature const &obj) const
+    { return !operator==(obj); }
+};
+
+
+// Directory containing `fname`, suitable for watching.
+static fs::path directoryOf(std::string const &fname)
+{
+  fs::path dir = fs::path(fname).parent_path();
+  if (dir.empty()) {
+    dir = ".";
+  }
+  return dir;
+}
+
+
+// ------------------------- DirectoryNotifier -------------------------
+// Outcome of `DirectoryNotifier::wait`.
+enum NotifyWaitResult {
+  NWR_CHANGED,                         // Something in the directory changed.
+  NWR_STOPPED,                         // The stop handle was signaled.
+  NWR_FAILED,                          // The OS reported an error.
+};
+
+
+// Wrapper for the OS facility that reports changes in a directory.
+class DirectoryNotifier {
+public:      // data
+#ifdef _WIN32
+  // Change notification handle, or INVALID_HANDLE_VALUE.
+  HANDLE m_handle;
+#else
+  // inotify descriptor, or -1.
+  int m_fd;
+#endif
+
+public:      // methods
+  DirectoryNotifier();
+  ~DirectoryNotifier();
+
+  // Start watching `dir`.  Return false if that is not possible.
+  bool open(fs::path const &dir);
+
+  // Stop watching.
+  void close();
+
+  bool isOpen() const;
+
+  // Wait for a change or for the stop handle to be signaled.
+#ifdef _WIN32
+  NotifyWaitResult wait(HANDLE stopEvent);
+#else
+  NotifyWaitResult wait(int stopFD);
+#endif
+
+  // Discard notifications that have accumulated.
+  void drain();
+};
+
+
+#ifdef _WIN32
+
+DirectoryNotifier::DirectoryNotifier()
+  : m_handle(INVALID_HANDLE_VALUE)
+{}
+
+
+bool DirectoryNotifier::open(fs::path const &dir)
+{
+  m_handle = FindFirstChangeNotificationW(
+    dir.wstring().c_str(),
+    FALSE,                             // bWatchSubtree
+    FILE_NOTIFY_CHANGE_FILE_NAME |
+      FILE_NOTIFY_CHANGE_SIZE |
+      FILE_NOTIFY_CHANGE_LAST_WRITE);
+  return isOpen();
+}
+
+
+void DirectoryNotifier::close()
+{
+  if (isOpen()) {
+    FindCloseChangeNotification(m_handle);
+    m_handle = INVALID_HANDLE_VALUE;
+  }
+}
+
+
+bool DirectoryNotifier::isOpen() const
+{
+  return m_handle != INVALID_HANDLE_VALUE;
+}
+
+
+NotifyWaitResult DirectoryNotifier::wait(HANDLE stopEvent)
+{
+  HANDLE handles[2] = { m_handle, stopEvent };
+  DWORD res = WaitForMultipleObjects(2, handles, FALSE /*waitAll*/,
+                                     INFINITE);
+  if (res == WAIT_OBJECT_0) {
+    // Re-arm for the next change.
+    if (!FindNextChangeNotification(m_handle)) {
+      return NWR_FAILED;
+    }
+    return NWR_CHANGED;
+  }
+  else if (res == WAIT_OBJECT_0 + 1) {
+    return NWR_STOPPED;
+  }
+  else {
+    return NWR_FAILED;
+  }
+}
+
+
+void DirectoryNotifier::drain()
+{
+  // Nothing to do; `FindNextChangeNotification` already reset it.
+}
+
+#else // !_WIN32
+
+DirectoryNotifier::DirectoryNotifier()
+  : m_fd(-1)
+{}
+
+
+bool DirectoryNotifier::open(fs::path const &dir)
+{
+#ifdef __linux__
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  // Watch the directory rather than the file so that saves that
+  // replace the file by renaming another over it are seen.
+  if (inotify_add_watch(m_fd, dir.c_str(),
+                        IN_MODIFY | IN_CLOSE_WRITE |
+                        IN_CREATE | IN_MOVED_TO) < 0) {
+    close();
+  }
+#else
+  (void)dir;
+#endif
+
+  return isOpen();
+}
+
+
+void DirectoryNotifier::close()
+{
+  if (isOpen()) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+
+bool DirectoryNotifier::isOpen() const
+{
+  return m_fd >= 0;
+}
+
+
+NotifyWaitResult DirectoryNotifier::wait(int stopFD)
+{
+  struct pollfd fds[2] = {
+    { m_fd,   POLLIN, 0 },
+    { stopFD, POLLIN, 0 },
+  };
+
+  while (true) {
+    int res = poll(fds, 2, -1 /*timeout*/);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return NWR_FAILED;
+    }
+
+    if (fds[1].revents) {
+      return NWR_STOPPED;
+    }
+    if (fds[0].revents & POLLIN) {
+      return NWR_CHANGED;
+    }
+    if (fds[0].revents) {
+      return NWR_FAILED;
+    }
+  }
+}
+
+
+void DirectoryNotifier::drain()
+{
+  // The events themselves do not matter, as the file signature is
+  // what decides whether to reload.
+  alignas(8) char buf[4096];
+  while (read(m_fd, buf, sizeof(buf)) > 0)
+    {}
+}
+
+#endif // !_WIN32
+
+
+DirectoryNotifier::~DirectoryNotifier()
+{
+  close();
+}
+
+
+// --------------------------- ConfigWatcher ---------------------------
+ConfigWatcher::ConfigWatcher(std::string const &fname,
+                             ConfigWatchMethod method,
+                             int pollIntervalMS)
+  : m_fname(fname),
+    m_method(method),
+    m_pollIntervalMS(pollIntervalMS),
+    m_pending(nullptr),
+    m_numUpdates(0),
+    m_activeMethod(method),
+#ifdef _WIN32
+    m_stopEvent(nullptr),
+#else
+    m_stopPipe{-1, -1},
+#endif
+    m_thread()
+{}
+
+
+ConfigWatcher::~ConfigWatcher()
+{
+  stop();
+
+#ifdef _WIN32
+  if (m_stopEvent) {
+    CloseHandle(m_stopEvent);
+  }
+#else
+  for (int fd : m_stopPipe) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+#endif
+
+  delete m_pending.exchange(nullptr);
+}
+
+
+std::string ConfigWatcher::start()
+{
+  if (m_thread.joinable()) {
+    return "";
+  }
+
+  // Without this, `stop` could not wake the thread, and would wait
+  // for it forever.
+#ifdef _WIN32
+  if (!m_stopEvent) {
+    m_stopEvent = CreateEventW(nullptr, TRUE /*manualReset*/,
+                               FALSE /*initialState*/, nullptr);
+    if (!m_stopEvent) {
+      return "CreateEvent failed";
+    }
+  }
+#else
+  if (m_stopPipe[0] < 0 && pipe(m_stopPipe) != 0) {
+    int error = errno;
+    m_stopPipe[0] = m_stopPipe[1] = -1;
+    return std::string("pipe: ") + std::strerror(error);
+  }
+#endif
+
+  m_thread = std::thread(&ConfigWatcher::run, this);
+  return "";
+}
+
+
+void ConfigWatcher::stop()
+{
+  if (m_thread.joinable()) {
+#ifdef _WIN32
+    SetEvent(m_stopEvent);
+#else
+    char c = 0;
+    while (write(m_stopPipe[1], &c, 1) < 0 && errno == EINTR)
+      {}
+#endif
+    m_thread.join();
+  }
+}
+
+
+bool ConfigWatcher::waitForStop(int ms)
+{
+#ifdef _WIN32
+  return WaitForSingleObject(m_stopEvent,
+                             ms < 0? INFINITE : (DWORD)ms) == WAIT_OBJECT_0;
+#else
+  struct pollfd fds[1] = {
+    { m_stopPipe[0], POLLIN, 0 },
+  };
+  int res;
+  while ((res = poll(fds, 1, ms)) < 0 && errno == EINTR)
+    {}
+
+  // If `poll` itself fails, treat that as a stop request rather than
+  // spinning.
+  return res != 0;
+#endif
+}
+
+
+void ConfigWatcher::publish(ConfigUpdate *update)
+{
+  // If the consumer has not taken the previous update, it never will
+  // now, so it is ours to delete.
+  delete m_pending.exchange(update, std::memory_order_acq_rel);
+  m_numUpdates.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+std::unique_ptr<ConfigUpdate> ConfigWatcher::takeUpdate()
+{
+  // Cheap check first, since usually there is nothing.
+  if (!m_pending.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return std::unique_ptr<ConfigUpdate>(
+    m_pending.exchange(nullptr, std::memory_order_acq_rel));
+}
+
+
+void ConfigWatcher::run()
+{
+  FileSignature signature(m_fname);
+
+  DirectoryNotifier notifier;
+  if (m_method == CWM_NOTIFY) {
+    notifier.open(directoryOf(m_fname));
+  }
+  m_activeMethod = notifier.isOpen()? CWM_NOTIFY : CWM_POLL;
+
+  while (true) {
+    if (notifier.isOpen()) {
+#ifdef _WIN32
+      NotifyWaitResult res = notifier.wait(m_stopEvent);
+#else
+      NotifyWaitResult res = notifier.wait(m_stopPipe[0]);
+#endif
+      if (res == NWR_STOPPED) {
+        break;
+      }
+      if (res == NWR_FAILED) {
+        // Keep going the slow way.
+        notifier.close();
+        m_activeMethod = CWM_POLL;
+        continue;
+      }
+
+      if (waitForStop(c_settleMS)) {
+        break;
+      }
+      notifier.drain();
+    }
+    else {
+      if (waitForStop(m_pollIntervalMS)) {
+        break;
+      }
+    }
+
+    FileSignature newSignature(m_fname);
+    if (newSignature == signature) {
+      // Some other file in the directory changed, or nothing did.
+      continue;
+    }
+    signature = newSignature;
+
+    if (!signature.m_exists) {
+      // Deleted, perhaps only for a moment during a save.  Keep the
+      // current settings.
+      continue;
+    }
+
+    std::unique_ptr<ConfigUpdate> update(new ConfigUpdate);
+    update->m_error = update->m_config.loadFromFile(m_fname);
+    publish(update.release());
+  }
+}
+
+
+// EOF
@@ -0,0 +1,145 @@
+// config-watcher.h
+// `ConfigWatcher`, which reloads the configuration file when it changes.
+
+// See license.txt for copyright and terms of use.
+
+// The watcher runs a background thread that waits for the file to
+// change, loads it into a fresh `GPVConfig`, and publishes the result
+// by swapping a pointer into an atomic slot.  The consumer, typically
+// the viewer's UI thread between polls, takes whatever is there with
+// another atomic swap, so neither side ever blocks the other, and a
+// published snapshot is never modified afterward.
+//
+// If several changes are published before the consumer looks, only the
+// latest is kept.
+
+#ifndef CONFIG_WATCHER_H
+#define CONFIG_WATCHER_H
+
+#include "gpv-config.h"                // GPVConfig
+
+#include "windows-compat.h"            // HANDLE (on Windows)
+
+#include <atomic>                      // std::atomic
+#include <memory>                      // std::unique_ptr
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+
+
+// Result of reloading the configuration file.
+class ConfigUpdate {
+public:      // data
+  // What was loaded.  If `m_error` is not empty, this may reflect only
+  // part of the file.
+  GPVConfig m_config;
+
+  // Error message from `GPVConfig::loadFromFile`, or empty.
+  std::string m_error;
+
+public:      // methods
+  ConfigUpdate();
+};
+
+
+// How the watcher learns that the file may have changed.
+enum ConfigWatchMethod {
+  // Ask the OS to report changes in the file's directory: inotify on
+  // Linux, `FindFirstChangeNotification` on Windows.  If that is not
+  // available, or fails, fall back to CWM_POLL.
+  CWM_NOTIFY,
+
+  // Check the file's modification time and size periodically.
+  CWM_POLL,
+
+  NUM_CONFIG_WATCH_METHODS
+};
+
+
+// Return a short name for `method`, like "notify".
+char const *toString(ConfigWatchMethod method);
+
+
+class ConfigWatcher {
+public:      // data
+  // File to watch.
+  std::string const m_fname;
+
+  // Requested method.
+  ConfigWatchMethod const m_method;
+
+  // For CWM_POLL, milliseconds between checks.
+  int const m_pollIntervalMS;
+
+private:     // data
+  // Latest update not yet taken by `takeUpdate`, or null.  Owned.
+  std::atomic<ConfigUpdate*> m_pending;
+
+  // Number of updates published so far.
+  std::atomic<int> m_numUpdates;
+
+  // Method actually in use, which differs from `m_method` if the
+  // notification setup failed.
+  std::atomic<ConfigWatchMethod> m_activeMethod;
+
+#ifdef _WIN32
+  // Manual-reset event signaled by `stop`, or null until `start`.
+  HANDLE m_stopEvent;
+#else
+  // Pipe that `stop` writes to, or -1s until `start`.  [0] is the
+  // read end.
+  int m_stopPipe[2];
+#endif
+
+  // Background thread, if started.
+  std::thread m_thread;
+
+private:     // methods
+  // Background thread body.
+  void run();
+
+  // Wait up to `ms` milliseconds, or indefinitely if negative, for
+  // `stop`.  Return true if it was called.
+  bool waitForStop(int ms);
+
+  // Make `update` the pending one, discarding any older one.
+  void publish(ConfigUpdate *update);
+
+public:      // methods
+  // This does not start watching; call `start` for that.
+  ConfigWatcher(std::string const &fname,
+                ConfigWatchMethod method = CWM_NOTIFY,
+                int pollIntervalMS = 500);
+
+  // Stops the thread if it is running.
+  ~ConfigWatcher();
+
+  ConfigWatcher(ConfigWatcher const &obj) = delete;
+  ConfigWatcher &operator=(ConfigWatcher const &obj) = delete;
+
+  // Start the background thread.  The file as it is now is taken to
+  // be already loaded, so only subsequent changes produce updates.
+  // Return an empty string on success, and an error message if the
+  // means to stop the thread could not be created, in which case it
+  // is not started.
+  std::string start();
+
+  // Stop the background thread and wait for it to finish.  After
+  // this, the watcher cannot be restarted.
+  void stop();
+
+  // If there is an update that has not been taken, return it, passing
+  // ownership to the caller.  Otherwise return null.  This is
+  // lock-free and can be called from any thread.
+  std::unique_ptr<ConfigUpdate> takeUpdate();
+
+  // Number of updates published so far.
+  int numUpdates() const
+    { return m_numUpdates.load(std::memory_order_relaxed); }
+
+  // Method in use.
+  ConfigWatchMethod activeMethod() const
+    { return m_activeMethod.load(std::memory_order_relaxed); }
+};
+
+
+#endif // CONFIG_WATCHER_H
@@ -0,0 +1,797 @@
+// controller-painter.cc
+// Code for `controller-painter` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "controller-painter.h"        // this module
+
+#include "stick-kernel.h"              // processStick, StickParams
+#include "text-format.h"               // appendFormat
+
+#include <algorithm>                   // std::{max, min}
+
+
+// -------------------------- StaticLayerKey ---------------------------
+StaticLayerKey::StaticLayerKey()
+  : m_width(0),
+    m_height(0),
+    m_linesColorref(0),
+    m_layoutParams()
+{}
+
+
+StaticLayerKey::StaticLayerKey(int width, int height,
+                               GPVConfig const &config)
+  : m_width(width),
+    m_height(height),
+    m_linesColorref(config.m_linesColorref),
+    m_layoutParams(config.m_layoutParams)
+{}
+
+
+bool StaticLayerKey::operator==(StaticLayerKey const &obj) const
+{
+  return m_width         == obj.m_width &&
+         m_height        == obj.m_height &&
+         m_linesColorref == obj.m_linesColorref &&
+         m_layoutParams  == obj.m_layoutParams;
+}
+
+
+COLORREF colorrefForColorRole(GPVConfig const &config, GVColorRole color)
+{
+  switch (color) {
+    default:
+    case GVCR_NONE:                    return RGB(0,0,0);
+    case GVCR_NORMAL:                  return config.m_linesColorref;
+    case GVCR_HIGHLIGHT:               return config.m_highlightColorref;
+    case GVCR_PARRY_ACTIVE:            return config.m_parryActiveColorref;
+    case GVCR_PARRY_INACTIVE:          return config.m_parryInactiveColorref;
+    case GVCR_TEXT_BACKGROUND:         return config.m_textBackgroundColorref;
+    case GVCR_DODGE_ACTIVE:            return config.m_dodgeActiveColorref;
+    case GVCR_DODGE_INACTIVE:          return config.m_dodgeInactiveColorref;
+  }
+}
+
+
+// ------------------------- ControllerPainter -------------------------
+ControllerPainter::ControllerPainter(
+  GPVConfig const *config,
+  InputModel const *inputModel)
+  : m_config(config),
+    m_inputModel(inputModel),
+    m_canvas(nullptr),
+    m_paintPass(PP_ALL),
+    m_profiler(nullptr),
+    m_extraDebugText(),
+    m_debugText(),
+    m_labelText()
+{
+  // Enough that the text drawn each frame never has to grow them.
+  m_debugText.reserve(2048);
+  m_labelText.reserve(64);
+}
+
+
+// Create a transformation matrix so that (0,0) is mapped to
+// (left,top) and (1,1) is mapped to (right,bottom).
+static Matrix3x2 focusArea(
+  float left,
+  float top,
+  float right,
+  float bottom)
+{
+  return
+    Matrix3x2::scale(right-left, bottom-top) *
+    Matrix3x2::translation(left, top);
+}
+
+
+// Create a transformation matrix centered on (x,y) with horizontal
+// radius `hr` and vertical radius `vr`.
+static Matrix3x2 focusPtHVR(
+  float x,
+  float y,
+  float hr,
+  float vr)
+{
+  return focusArea(x - hr, y - vr,
+                   x + hr, y + vr);
+}
+
+// Create a transformation matrix centered on (x,y) with square radius
+// `r`.
+static Matrix3x2 focusPtR(
+  float x,
+  float y,
+  float r)
+{
+  return focusPtHVR(x, y, r, r);
+}
+
+
+// Given a point (x,y) meant to be relative to `transform`, transform it
+// into screen pixel coordinates.
+static Point2F transformPoint(
+  Matrix3x2 const &transform,
+  float x, float y)
+{
+  return transform.transformPoint(Point2F(x, y));
+}
+
+
+void ControllerPainter::drawControllerState(PaintPass pass, Point2F size)
+{
+  m_paintPass = pass;
+
+  // True if we are drawing the parts that depend on the input.
+  bool const dynamic = (pass != PP_STATIC);
+
+  if (dynamic && m_config->m_showText) {
+    FRAME_PROFILE_SCOPE(m_profiler, FPP_DEBUG_TEXT);
+
+    XINPUT_STATE const &i = m_inputModel->inputState();
+    XINPUT_GAMEPAD const &g = i.Gamepad;
+
+    std::wstring &s = m_debugText;
+    s.clear();
+    appendFormat(s, "controllerID: %d\n", m_config->m_controllerID);
+    appendFormat(s, "hasState: %d\n",
+      (int)m_inputModel->m_controllerState.m_hasInputState);
+    appendFormat(s, "packet: %lu\n", (unsigned long)i.dwPacketNumber);
+    appendFormat(s, "buttons: %x\n", (unsigned)g.wButtons);
+    appendFormat(s, "leftTrigger: %d\n", (int)g.bLeftTrigger);
+    appendFormat(s, "rightTrigger: %d\n", (int)g.bRightTrigger);
+    appendFormat(s, "thumbLX: %d\n", (int)g.sThumbLX);
+    appendFormat(s, "thumbLY: %d\n", (int)g.sThumbLY);
+    appendFormat(s, "thumbRX: %d\n", (int)g.sThumbRX);
+    appendFormat(s, "thumbRY: %d\n", (int)g.sThumbRY);
+    appendFormat(s, "parryElapsedMS: %lu\n",
+      (unsigned long)m_inputModel->parryTimerElapsedMS());
+    appendFormat(s, "dodgeElapsedMS: %lu\n",
+      (unsigned long)m_inputModel->dodgeInvulnerabilityTimerElapsedMS());
+
+    // Whatever the client wants to add.
+    s += m_extraDebugText;
+
+    m_canvas->setTransform(Matrix3x2::identity());
+    m_canvas->drawText(s, RectF(150, 10, size.m_x, size.m_y));
+  }
+
+  if (!( size.m_x > 0 && size.m_y > 0 )) {
+    // Bail if the sizes are zero.
+    return;
+  }
+
+  // Create a coordinate system where the upper-left is (0,0) and the
+  // lower-right is (1,1).
+  Matrix3x2 baseTransform = Matrix3x2::scale(size.m_x, size.m_y);
+
+  // Draw the round buttons.
+  drawRoundButtons(
+    focusPtR(1.0 - lp().m_faceButtonsR, lp().m_faceButtonsY, lp().m_faceButtonsR) *
+    baseTransform);
+
+  // Draw the dpad.
+  drawDPadButtons(
+    focusPtR(lp().m_faceButtonsR, lp().m_faceButtonsY, lp().m_faceButtonsR) *
+    baseTransform);
+
+  // Draw the shoulder buttons.
+  drawShoulderButtons(
+    focusPtR(lp().m_shoulderButtonsX, lp().m_shoulderButtonsR, lp().m_shoulderButtonsR) * baseTransform,
+    true /*left*/);
+  drawShoulderButtons(
+    focusPtR(1.0 - lp().m_shoulderButtonsX, lp().m_shoulderButtonsR, lp().m_shoulderButtonsR) * baseTransform,
+    false /*left*/);
+
+  // Draw the parry timer.
+  if (dynamic && m_inputModel->m_parryTimer.isRunning()) {
+    // Compute a transform for the region of the timer.
+    Matrix3x2 parryTimerRegion =
+      focusPtHVR(lp().m_parryTimerX,  lp().m_parryTimerY,
+                 lp().m_parryTimerHR, lp().m_parryTimerVR) * baseTransform;
+
+    // Draw the main timer.
+    drawParryTimer(parryTimerRegion);
+
+    // Point to act as the upper-left corner of the next line of text to
+    // draw.  We start at the bottom-left corner of the parry timer
+    // region.  (We have to compute this manually because drawing text
+    // really only works with an identity transform active.)
+    Point2F textCursor = transformPoint(
+      parryTimerRegion,
+      lp().m_parryElapsedTimeX,
+      lp().m_parryElapsedTimeY);
+
+    // With `TimeY` at 1.0, the meter and text overlap slightly, so push
+    // the text down slightly.
+    textCursor.m_y += 2;
+
+    if (m_config->m_parryTimer.m_showAccuracy) {
+      // Paint a background beneath the text to ensure it can be
+      // reliably read.  (Prior to adding the background, I've had cases
+      // where I could not read it in a game play recording due to the
+      // combination of low-contrast background and video compression
+      // effects.)
+      m_inputModel->parryAccuracyString(m_labelText);
+      drawTextWithBackground(m_labelText, textCursor,
+                             GVCR_TEXT_BACKGROUND);
+
+      // Move the cursor down before drawing the next line.
+      textCursor.m_y += 22;
+    }
+
+    if (m_config->m_parryTimer.m_showElapsedTime) {
+      // Elapsed time as a string.
+      m_labelText.clear();
+      appendFormat(m_labelText, "%lu",
+                   (unsigned long)m_inputModel->parryTimerElapsedMS());
+
+      drawTextWithBackground(m_labelText, textCursor,
+                             GVCR_TEXT_BACKGROUND);
+    }
+  }
+
+  // Draw the sticks.
+  drawStick(
+    focusPtR(lp().m_stickR, 1.0 - lp().m_stickR, lp().m_stickR) * baseTransform,
+    true /*left*/);
+  drawStick(
+    focusPtR(1.0 - lp().m_stickR, 1.0 - lp().m_stickR, lp().m_stickR) * baseTransform,
+    false /*left*/);
+
+  // Draw the select and start buttons.
+  drawSelStartButton(
+    focusPtHVR(0.5 - lp().m_selStartX, lp().m_faceButtonsY,
+               lp().m_selStartHR,      lp().m_selStartVR)   * baseTransform,
+    true /*left*/);
+  drawSelStartButton(
+    focusPtHVR(0.5 + lp().m_selStartX, lp().m_faceButtonsY,
+               lp().m_selStartHR,      lp().m_selStartVR)   * baseTransform,
+    false /*left*/);
+
+  // Draw a central circle that could be considered to mimic the
+  // Playstation button, but in this app mostly functions as a larger
+  // place for the mouse to be clicked since the rest of the UI consists
+  // of thin lines that are hard to click.
+  drawCentralCircle(
+    focusPtR(0.5, lp().m_centralCircleY, lp().m_centralCircleR) * baseTransform);
+
+  if (dynamic &&
+      m_config->m_showDodgeInvulnerabilityTimer &&
+      m_inputModel->m_dodgeInvulnerabilityTimer.isRunning()) {
+    Point2F textCursor = transformPoint(
+      baseTransform,
+      lp().m_dodgeInvulnerabilityTimeX,
+      lp().m_dodgeInvulnerabilityTimeY);
+
+    bool active;
+    m_inputModel->dodgeAccuracyString(m_labelText, active /*OUT*/);
+
+    drawTextWithBackground(m_labelText, textCursor,
+      active? GVCR_DODGE_ACTIVE : GVCR_DODGE_INACTIVE);
+  }
+
+  if (dynamic && m_profiler && m_profiler->m_enabled) {
+    drawFrameProfile(size);
+  }
+}
+
+
+bool ControllerPainter::paintingOutline(ElementKind kind) const
+{
+  if (kind == EK_DYNAMIC) {
+    return m_paintPass != PP_STATIC;
+  }
+  else {
+    return m_paintPass != PP_DYNAMIC;
+  }
+}
+
+
+bool ControllerPainter::paintingFill(ElementKind kind) const
+{
+  if (kind == EK_STATIC) {
+    return m_paintPass != PP_DYNAMIC;
+  }
+  else {
+    return m_paintPass != PP_STATIC;
+  }
+}
+
+
+void ControllerPainter::drawCircle(
+  Matrix3x2 transform,
+  bool fill,
+  ElementKind kind)
+{
+  m_canvas->setTransform(transform);
+
+  Point2F center(0.5, 0.5);
+  float r = 0.5 - lp().m_circleMargin;
+
+  // Draw the outline always since the stroke width means the outer
+  // edge is a bit larger than the filled ellipse.
+  if (paintingOutline(kind)) {
+    m_canvas->drawEllipse(
+      center, r, r,
+      GVCR_NORMAL,
+      lp().m_lineWidthPixels);         // strokeWidth in pixels
+  }
+
+  if (fill && paintingFill(kind)) {
+    m_canvas->fillEllipse(center, r, r, GVCR_NORMAL);
+  }
+}
+
+
+void ControllerPainter::drawCircleAt(
+  Matrix3x2 transform,
+  float x,
+  float y,
+  float r,
+  bool fill,
+  ElementKind kind)
+{
+  drawCircle(focusArea(x-r, y-r, x+r, y+r) * transform, fill, kind);
+}
+
+
+void ControllerPainter::drawSquare(
+  Matrix3x2 transform,
+  GVColorRole color,
+  float margin,
+  bool fill,
+  ElementKind kind)
+{
+  drawPartiallyFilledSquare(
+    transform,
+    color,
+    margin,
+    fill? 1.0 : 0.0,
+    1.0 /*fillHR*/,
+    kind);
+}
+
+
+void ControllerPainter::drawPartiallyFilledSquare(
+  Matrix3x2 transform,
+  GVColorRole color,
+  float margin,
+  float fillAmount,
+  float fillHR,
+  ElementKind kind)
+{
+  m_canvas->setTransform(transform);
+
+  RectF square(margin, margin, 1.0 - margin, 1.0 - margin);
+
+  // Draw the outline always since the stroke width means the outer
+  // edge is a bit larger than the filled shape.
+  if (paintingOutline(kind)) {
+    m_canvas->drawRectangle(
+      square,
+      color,
+      lp().m_lineWidthPixels);         // strokeWidth
+  }
+
+  if (fillAmount > 0 && paintingFill(kind)) {
+    square.m_top = square.m_bottom - square.height() * fillAmount;
+
+    // Apply `fillHR` to `square`.
+    float hr = square.width() / 2.0;
+    float x = (square.m_right + square.m_left) / 2.0;
+    square.m_left = x - hr * fillHR;
+    square.m_right = x + hr * fillHR;
+
+    m_canvas->fillRectangle(square, color);
+  }
+}
+
+
+void ControllerPainter::drawLine(
+  Matrix3x2 transform,
+  float x1,
+  float y1,
+  float x2,
+  float y2,
+  GVColorRole color)
+{
+  if (m_paintPass == PP_STATIC) {
+    return;
+  }
+
+  m_canvas->setTransform(transform);
+
+  m_canvas->drawLine(
+    Point2F(x1, y1),
+    Point2F(x2, y2),
+    color,
+    lp().m_lineWidthPixels);           // strokeWidth
+}
+
+
+void ControllerPainter::drawTextWithBackground(
+  std::wstring const &str,
+  Point2F const &textCursor,
+  GVColorRole bgColorRole)
+{
+  if (m_paintPass == PP_STATIC) {
+    return;
+  }
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_TEXT);
+
+  // Drawing text requires the identity transform.
+  m_canvas->setTransform(Matrix3x2::identity());
+
+  // Compute a rectangle to hold the text.  This is meant to be larger
+  // than the actual text to display.
+  //
+  // TODO: This could be made more general by accepting or computing
+  // the width and height.
+  //
+  RectF textRect(textCursor.m_x,         textCursor.m_y,
+                 textCursor.m_x + 200.0, textCursor.m_y + 20.0);
+
+  // Paint a background beneath the region the text actually occupies.
+  m_canvas->fillRectangle(
+    m_canvas->measureText(str, textRect),
+    bgColorRole);
+
+  // Draw the text.
+  m_canvas->drawText(str, textRect);
+}
+
+
+// Rotate around (0.5,0.5) counterclockwise by `degrees`.
+static Matrix3x2 rotateAroundCenterDeg(float degrees)
+{
+  return Matrix3x2::rotation(degrees, Point2F(0.5, 0.5));
+}
+
+
+void ControllerPainter::drawRoundButtons(
+  Matrix3x2 transform)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_ROUND_BUTTONS);
+  WORD buttons = m_inputModel->inputState().Gamepad.wButtons;
+
+  // Button masks, starting at top, then going clockwise.
+  static WORD const masks[4] = {
+    XINPUT_GAMEPAD_Y,        // Top, PS triangle
+    XINPUT_GAMEPAD_B,        // Right, PS circle
+    XINPUT_GAMEPAD_A,        // Bottom, PS X
+    XINPUT_GAMEPAD_X,        // Left, PS square
+  };
+
+  float const x = 0.5;
+  float const y = lp().m_roundButtonR;
+  float const r = lp().m_roundButtonR;
+
+  for (int i=0; i < 4; ++i) {
+    drawCircle(focusPtR(x, y, r) * transform,
+      buttons & masks[i], EK_BUTTON);
+
+    if (masks[i] == XINPUT_GAMEPAD_B &&
+        m_inputModel->m_dodgeReleaseTimer.isRunning()) {
+      // Draw a small circle inside the big one to indicate that the
+      // button was recently released.  The primary purpose is to ensure
+      // that a screen recording running at 30 FPS reliably contains
+      // evidence of the button press even if it is pressed and released
+      // very quickly.
+      float const rSmall = r * lp().m_roundButtonTimerSizeFactor;
+      drawCircle(focusPtR(x, y, rSmall) * transform,
+        true /*fill*/, EK_DYNAMIC);
+    }
+
+    // Rotate the transform 90 degrees around the center.
+    transform = rotateAroundCenterDeg(90) * transform;
+  }
+}
+
+
+void ControllerPainter::drawDPadButtons(
+  Matrix3x2 transform)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_DPAD_BUTTONS);
+  WORD buttons = m_inputModel->inputState().Gamepad.wButtons;
+
+  // Button masks, starting at top, then going clockwise.
+  WORD masks[4] = {
+    XINPUT_GAMEPAD_DPAD_UP,
+    XINPUT_GAMEPAD_DPAD_RIGHT,
+    XINPUT_GAMEPAD_DPAD_DOWN,
+    XINPUT_GAMEPAD_DPAD_LEFT,
+  };
+
+  for (int i=0; i < 4; ++i) {
+    drawSquare(
+      focusPtR(0.5, lp().m_dpadButtonR, lp().m_dpadButtonR) * transform,
+      GVCR_NORMAL,
+      lp().m_circleMargin,
+      buttons & masks[i],
+      EK_BUTTON);
+
+    // Rotate the transform 90 degrees around the center.
+    transform = rotateAroundCenterDeg(90) * transform;
+  }
+}
+
+
+void ControllerPainter::drawShoulderButtons(
+  Matrix3x2 transform,
+  bool leftSide)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_SHOULDER_BUTTONS);
+  WORD buttons = m_inputModel->inputState().Gamepad.wButtons;
+  WORD mask = (leftSide? XINPUT_GAMEPAD_LEFT_SHOULDER :
+                         XINPUT_GAMEPAD_RIGHT_SHOULDER);
+
+  // Bumper.
+  drawSquare(
+    focusPtHVR(0.5, 1.0 - lp().m_bumperVR, 0.5, lp().m_bumperVR) * transform,
+    GVCR_NORMAL,
+    lp().m_circleMargin,
+    buttons & mask,
+    EK_BUTTON);
+
+  BYTE trigger = (leftSide? m_inputModel->inputState().Gamepad.bLeftTrigger :
+                            m_inputModel->inputState().Gamepad.bRightTrigger);
+  float fillAmount = trigger / 255.0;
+
+  bool isPressed =
+    m_inputModel->m_controllerState.isTriggerPressed(
+      m_config->m_analogThresholds, leftSide);
+
+  // Trigger.
+  //
+  // If `trigger` exceeds the dead zone threshold, then the fill is the
+  // entire rectangle width.  But if not, it is only half of the width
+  // in order to indicate that the game may not register it.
+  //
+  drawPartiallyFilledSquare(
+    focusPtHVR(0.5, lp().m_triggerVR, 0.5, lp().m_triggerVR) * transform,
+    GVCR_NORMAL,
+    lp().m_circleMargin,
+    fillAmount,
+    isPressed? 1.0 : 0.5,
+    EK_BUTTON);
+}
+
+
+void ControllerPainter::drawParryTimer(
+  Matrix3x2 transform)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_PARRY_TIMER);
+  ParryTimerConfig const &ptc = m_config->m_parryTimer;
+
+  if (ptc.m_durationMS > 0) {
+    // Draw the timer bar.  This comes first so it appears below the
+    // outline and hash marks.
+    float fillAmount =
+      (float)m_inputModel->parryTimerElapsedMS() / ptc.m_durationMS;
+    drawSquare(
+      focusArea(0, 0, fillAmount, 1.0) * transform,
+      m_inputModel->isParryActive()? GVCR_PARRY_ACTIVE : GVCR_PARRY_INACTIVE,
+      0 /*margin*/,
+      true /*fill*/,
+      EK_DYNAMIC);
+
+    // Draw the outline of the timer.
+    drawSquare(transform, GVCR_NORMAL, 0 /*margin*/, false /*fill*/,
+               EK_DYNAMIC);
+
+    // Draw the segment hash marks.
+    for (int i=1; i < ptc.m_numSegments; ++i) {
+      float x = (float)i / ptc.m_numSegments;
+      drawLine(transform, x, 1.0 - lp().m_parryTimerHashHeight,
+                          x, 1.0,
+                          GVCR_NORMAL);
+    }
+
+    // Draw hash marks for the active area boundary.
+    float x = (float)ptc.m_activeStartMS / ptc.m_durationMS;
+    drawLine(transform, x, 0.0,
+                        x, lp().m_parryTimerHashHeight,
+                        GVCR_NORMAL);
+    x = (float)ptc.m_activeEndMS / ptc.m_durationMS;
+    drawLine(transform, x, 0.0,
+                        x, lp().m_parryTimerHashHeight,
+                        GVCR_NORMAL);
+  }
+}
+
+
+void ControllerPainter::drawStick(
+  Matrix3x2 transform,
+  bool leftSide)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_STICKS);
+
+  // Outline.
+  drawCircleAt(transform, 0.5, 0.5, lp().m_stickOutlineR, false /*fill*/,
+               EK_STATIC);
+
+  if (m_paintPass == PP_STATIC) {
+    // The rest depends on the input.
+    return;
+  }
+
+  XINPUT_GAMEPAD const &gamepad = m_inputModel->inputState().Gamepad;
+  StickResult stick = processStick(
+    leftSide? gamepad.sThumbLX : gamepad.sThumbRX,
+    leftSide? gamepad.sThumbLY : gamepad.sThumbRY,
+    StickParams::forStick(m_config->m_analogThresholds, leftSide));
+
+  if (stick.m_beyondDeadZone) {
+    // Filled circle representing the grippy part.
+    float spotX = 0.5 + stick.m_deflectX * lp().m_stickMaxDeflectR;
+    float spotY = 0.5 + stick.m_deflectY * lp().m_stickMaxDeflectR;
+    drawCircleAt(transform, spotX, spotY, lp().m_stickThumbR, true /*fill*/,
+                 EK_DYNAMIC);
+
+    // Line from center to circle showing the deflection angle, even
+    // when the thumb is close to the center.
+    float edgeX = 0.5 + stick.m_dirX * lp().m_stickMaxDeflectR;
+    float edgeY = 0.5 + stick.m_dirY * lp().m_stickMaxDeflectR;
+    drawLine(transform, 0.5, 0.5, edgeX, edgeY, GVCR_NORMAL);
+
+    if (leftSide) {
+      drawSpeedIndicator(transform, spotX, spotY,
+                         stick.m_dirX, stick.m_dirY, stick.m_speed);
+    }
+  }
+
+  WORD buttons = m_inputModel->inputState().Gamepad.wButtons;
+  WORD mask = (leftSide? XINPUT_GAMEPAD_LEFT_THUMB :
+                         XINPUT_GAMEPAD_RIGHT_THUMB);
+
+  // Stick click button.
+  if (buttons & mask) {
+    drawCircle(transform, false /*fill*/, EK_DYNAMIC);
+  }
+}
+
+
+void ControllerPainter::drawSpeedIndicator(
+  Matrix3x2 transform,
+  float spotX,
+  float spotY,
+  float dirX,
+  float dirY,
+  int speed)
+{
+  // Focus on the thumb circle.
+  transform = focusPtR(spotX, spotY, lp().m_stickThumbR) * transform;
+
+  // Turn the indicator to match the stick.  The chevron points up
+  // rather than right, so the rotation is 90 degrees more than the
+  // direction's angle, which swaps the cosine and sine and negates the
+  // new cosine.
+  transform = Matrix3x2::rotationCS(-dirY, dirX, Point2F(0.5, 0.5)) *
+              transform;
+
+  for (int i=0; i < speed; ++i) {
+    // [0], [0,1], or [-1,0,1].
+    int preliminary = i - (speed-1) / 2;
+
+    // If speed is 1, then 0.
+    // If speed is 2, then [-0.5,0.5].
+    // If speed is 3, then [-1,0,1].
+    float offset = preliminary - (speed%2 == 0? 0.5 : 0);
+
+    drawChevron(transform, offset * lp().m_chevronSeparation);
+  }
+}
+
+
+void ControllerPainter::drawChevron(
+  Matrix3x2 transform,
+  float dy)
+{
+  drawLine(transform, 0.5 - lp().m_chevronHR, 0.5 + lp().m_chevronVR + dy,
+                      0.5,                    0.5 - lp().m_chevronVR + dy, GVCR_HIGHLIGHT);
+  drawLine(transform, 0.5,                    0.5 - lp().m_chevronVR + dy,
+                      0.5 + lp().m_chevronHR, 0.5 + lp().m_chevronVR + dy, GVCR_HIGHLIGHT);
+}
+
+
+void ControllerPainter::drawSelStartButton(
+  Matrix3x2 transform,
+  bool leftSide)
+{
+  WORD buttons = m_inputModel->inputState().Gamepad.wButtons;
+  WORD mask = (leftSide? XINPUT_GAMEPAD_BACK :  // PS select
+                         XINPUT_GAMEPAD_START);
+
+  drawSquare(transform, GVCR_NORMAL, lp().m_circleMargin, buttons & mask,
+             EK_BUTTON);
+}
+
+
+void ControllerPainter::drawCentralCircle(
+  Matrix3x2 transform)
+{
+  drawCircle(transform, true /*fill*/, EK_STATIC);
+}
+
+
+void ControllerPainter::drawFrameProfile(Point2F size)
+{
+  FRAME_PROFILE_SCOPE(m_profiler, FPP_OVERLAY);
+
+  // Fill color of each phase's segment and legend swatch.  There are
+  // only so many colors, so some repeat, but not next to each other.
+  static GVColorRole const phaseColors[NUM_FRAME_PROFILER_PHASES] = {
+    GVCR_TEXT_BACKGROUND,    // FPP_OTHER
+    GVCR_DODGE_INACTIVE,     // FPP_DEBUG_TEXT
+    GVCR_NORMAL,             // FPP_ROUND_BUTTONS
+    GVCR_HIGHLIGHT,          // FPP_DPAD_BUTTONS
+    GVCR_PARRY_ACTIVE,       // FPP_SHOULDER_BUTTONS
+    GVCR_PARRY_INACTIVE,     // FPP_PARRY_TIMER
+    GVCR_DODGE_ACTIVE,       // FPP_STICKS
+    GVCR_HIGHLIGHT,          // FPP_TEXT
+    GVCR_NORMAL,             // FPP_OVERLAY
+  };
+
+  float const margin = 10;
+  float const barHeight = 12;
+  float const left = margin;
+  float const right = size.m_x - margin;
+  float const barTop = size.m_y - margin - barHeight;
+  if (right <= left || barTop <= margin) {
+    return;
+  }
+  float const pixelsPerUS =
+    (right - left) / std::max(m_profiler->m_budgetUS, 1.0f);
+
+  m_canvas->setTransform(Matrix3x2::identity());
+
+  // Legend, one line per phase.  Like the text display, it has no
+  // background, since filling one that size costs more than the
+  // whole rest of a frame with the CPU rasterizer.
+  std::wstring &legend = m_labelText;
+  legend.clear();
+  for (int p=0; p < NUM_FRAME_PROFILER_PHASES; ++p) {
+    FrameProfilerPhase phase = (FrameProfilerPhase)p;
+    appendFormat(legend, "%s: %.0f us (max %.0f)\n", toString(phase),
+                 m_profiler->averageUS(phase), m_profiler->maxUS(phase));
+  }
+
+  // Measure to find the line height, which depends on the configured
+  // font size, then put the block just above the bar, leaving room on
+  // the left for the color swatches.
+  RectF textRect = m_canvas->measureText(legend,
+    RectF(0, 0, size.m_x, size.m_y));
+  float const lineHeight = textRect.height() / NUM_FRAME_PROFILER_PHASES;
+  float const textTop = barTop - margin - textRect.height();
+  m_canvas->drawText(legend,
+    RectF(left + lineHeight, textTop, size.m_x, barTop));
+
+  float const swatch = lineHeight * 0.6f;
+  for (int p=0; p < NUM_FRAME_PROFILER_PHASES; ++p) {
+    float y = textTop + p * lineHeight + (lineHeight - swatch) / 2;
+    m_canvas->fillRectangle(RectF(left, y, left + swatch, y + swatch),
+                            phaseColors[p]);
+  }
+
+  // Segments of the bar, in phase order, clipped to the budget.
+  float x = left;
+  for (int p=0; p < NUM_FRAME_PROFILER_PHASES && x < right; ++p) {
+    float w = m_profiler->averageUS((FrameProfilerPhase)p) * pixelsPerUS;
+    float end = std::min(x + w, right);
+    if (end > x) {
+      m_canvas->fillRectangle(RectF(x, barTop, end, barTop + barHeight),
+                              phaseColors[p]);
+    }
+    x = end;
+  }
+
+  // Outline of the budget.
+  m_canvas->drawRectangle(RectF(left, barTop, right, barTop + barHeight),
+                          GVCR_NORMAL, 1.0f);
+}
+
+
+// EOF
@@ -0,0 +1,222 @@
+// controller-painter.h
+// `ControllerPainter`, which draws the controller display on a `Canvas`.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef CONTROLLER_PAINTER_H
+#define CONTROLLER_PAINTER_H
+
+#include "canvas.h"                    // Canvas, GVColorRole
+#include "frame-profiler.h"            // FrameProfiler
+#include "geometry.h"                  // Matrix3x2, Point2F
+#include "gpv-config.h"                // GPVConfig, LayoutParams
+#include "input-model.h"               // InputModel
+#include "windows-compat.h"            // COLORREF
+
+#include <string>                      // std::wstring
+
+
+// Which parts of the display a call to `drawControllerState` draws.
+enum PaintPass {
+  // Everything.
+  PP_ALL,
+
+  // Only the parts that never depend on the controller input.  These
+  // are drawn once into the static layer, which is then reused until
+  // the window size or relevant configuration changes.
+  PP_STATIC,
+
+  // Only the parts that do depend on the input, drawn every frame on
+  // top of the static layer.
+  PP_DYNAMIC,
+};
+
+
+// How the parts of one drawn element relate to the static layer.
+enum ElementKind {
+  // The outline is always drawn, and hence static, while the fill
+  // depends on the input.  Most buttons are like this.
+  EK_BUTTON,
+
+  // The entire element is static.
+  EK_STATIC,
+
+  // The entire element depends on the input.
+  EK_DYNAMIC,
+};
+
+
+// The inputs that determine the contents of the static layer.  If any
+// of them change, the layer has to be redrawn.
+class StaticLayerKey {
+public:      // data
+  // Size of the layer in pixels.
+  int m_width;
+  int m_height;
+
+  // Color of the outlines.
+  COLORREF m_linesColorref;
+
+  // Geometry of everything.
+  LayoutParams m_layoutParams;
+
+public:      // methods
+  // Size 0x0, which never matches a real layer.
+  StaticLayerKey();
+
+  StaticLayerKey(int width, int height, GPVConfig const &config);
+
+  bool operator==(StaticLayerKey const &obj) const;
+  bool operator!=(StaticLayerKey const &obj) const
+    { return !operator==(obj); }
+};
+
+
+// Return the color `config` specifies for `color`.
+COLORREF colorrefForColorRole(GPVConfig const &config, GVColorRole color);
+
+
+// Draws the buttons, sticks, timers, etc., that make up the display,
+// reflecting the state of an `InputModel`.
+//
+// This has no state of its own beyond what it is pointed at, so it is
+// cheap to make one per thread.
+//
+class ControllerPainter {
+public:      // data
+  // Configuration, mainly for the layout.  Not owned.  Must not be
+  // null.
+  GPVConfig const *m_config;
+
+  // Input to display.  Not owned.  Must not be null.
+  InputModel const *m_inputModel;
+
+  // Canvas to draw on.  Not owned.  Only needs to be valid during
+  // `drawControllerState`.
+  Canvas *m_canvas;
+
+  // Which parts of the display the `draw` methods draw.
+  PaintPass m_paintPass;
+
+  // If not null, the `draw` methods are timed with this, and while it
+  // is enabled, its results are drawn over the display.  Not owned.
+  FrameProfiler *m_profiler;
+
+  // Text appended to the diagnostic text display, if shown.  Each line
+  // should end with a newline.
+  std::wstring m_extraDebugText;
+
+  // Scratch strings for the text drawn each frame.  They are reused so
+  // that, once they have grown to size, drawing does not allocate.
+  std::wstring m_debugText;
+  std::wstring m_labelText;
+
+public:      // methods
+  ControllerPainter(GPVConfig const *config, InputModel const *inputModel);
+
+  // Current layout parameters.
+  LayoutParams const &lp() const
+    { return m_config->m_layoutParams; }
+
+  // Draw the parts of the controller state selected by `pass` on
+  // `m_canvas`, which is `size` pixels.
+  void drawControllerState(PaintPass pass, Point2F size);
+
+  // True if, in the current pass, we should draw the outline or fill,
+  // respectively, of an element of `kind`.
+  bool paintingOutline(ElementKind kind) const;
+  bool paintingFill(ElementKind kind) const;
+
+  // Draw a centered circle mostly filling the box.
+  void drawCircle(Matrix3x2 transform, bool fill, ElementKind kind);
+
+  // Draw a circle centered at (x,y) with radius (r).
+  void drawCircleAt(
+    Matrix3x2 transform,
+    float x,
+    float y,
+    float r,
+    bool fill,
+    ElementKind kind);
+
+  // Draw a square in the box.
+  void drawSquare(
+    Matrix3x2 transform,
+    GVColorRole color,
+    float margin,
+    bool fill,
+    ElementKind kind);
+
+  // Draw a square that is filled, from the bottom, by `fillAmount`.
+  // `fillHR` is the horizontal radius of the filled portion, where 1.0
+  // represents filling the box completely.
+  //
+  // The square is drawn `margin` proportional units inside the edges of
+  // `transform`.
+  void drawPartiallyFilledSquare(
+    Matrix3x2 transform,
+    GVColorRole color,
+    float margin,
+    float fillAmount,
+    float fillHR,
+    ElementKind kind);
+
+  // Draw a line from (x1,y1) to (x2,y2).  Lines are always dynamic.
+  void drawLine(
+    Matrix3x2 transform,
+    float x1,
+    float y1,
+    float x2,
+    float y2,
+    GVColorRole color);
+
+  // Draw `str` with its upper-left corner at `textCursor`, painting the
+  // actually used region with `bgColorRole` first.  Text is always
+  // dynamic.
+  void drawTextWithBackground(
+    std::wstring const &str,
+    Point2F const &textCursor,
+    GVColorRole bgColorRole);
+
+  // Draw the round face buttons.
+  void drawRoundButtons(Matrix3x2 transform);
+
+  // Draw the dpad buttons.
+  void drawDPadButtons(Matrix3x2 transform);
+
+  // Draw the left or right shoulder button and trigger.
+  void drawShoulderButtons(Matrix3x2 transform, bool leftSide);
+
+  // Draw the parry timer.
+  void drawParryTimer(Matrix3x2 transform);
+
+  // Draw one of the sticks.
+  void drawStick(Matrix3x2 transform, bool leftSide);
+
+  // Draw the speed indicator on the left thumb, pointing in the
+  // direction of the unit vector (dirX,dirY).
+  void drawSpeedIndicator(
+    Matrix3x2 transform,
+    float spotX,
+    float spotY,
+    float dirX,
+    float dirY,
+    int speed);
+
+  // Draw a up-pointing chevron in the nominal box.  Offset its Y
+  // coordinate by `dy`.
+  void drawChevron(Matrix3x2 transform, float dy);
+
+  // Draw one of the select/start buttons.
+  void drawSelStartButton(Matrix3x2 transform, bool leftSide);
+
+  // Draw the central filled circle.
+  void drawCentralCircle(Matrix3x2 transform);
+
+  // Draw `m_profiler`'s averages as a bar, one segment per phase, whose
+  // full width is the frame budget, with a legend above it.
+  void drawFrameProfile(Point2F size);
+};
+
+
+#endif // CONTROLLER_PAINTER_H
@@ -3,16 +3,17 @@
 
 #include "controller-state.h"          // this module
 
-#include <windows.h>                   // GetTickCount
-#include <xinput.h>                    // XInputGetState
+#include "windows-compat.h"            // GetTickCount, XInputGetState
 
-#include <cstring>                     // std::{memset, memcpy}
+#include <chrono>                      // std::chrono
+#include <cstring>                     // std::{memcpy, memset, strcmp}
 
 
 ControllerState::ControllerState()
   : m_inputState(),
     m_hasInputState(false),
-    m_pollTimeMS(0)
+    m_pollTimeMS(0),
+    m_pollTimeUS(0)
 {
   // I'm not sure if the default ctor initializes this.
   std::memset(&m_inputState, 0, sizeof(m_inputState));
@@ -27,11 +28,13 @@ ControllerState &ControllerState::operator=(ControllerState const &obj)
 
   m_hasInputState = obj.m_hasInputState;
   m_pollTimeMS = obj.m_pollTimeMS;
+  m_pollTimeUS = obj.m_pollTimeUS;
 
   return *this;
 }
 
 
+#ifdef _WIN32
 void ControllerState::poll(int controllerID)
 {
   std::memset(&m_inputState, 0, sizeof(m_inputState));
@@ -39,7 +42,9 @@ void ControllerState::poll(int controllerID)
   m_hasInputState = (res == ERROR_SUCCESS);
 
   m_pollTimeMS = GetTickCount();
+  m_pollTimeUS = steadyClockUS();
 }
+#endif // _WIN32
 
 
 bool ControllerState::isTriggerPressed(
@@ -65,4 +70,54 @@ bool ControllerState::isButtonPressed(WORD button) const
 }
 
 
+// Name of each `XINPUT_GAMEPAD_*` bit, by bit position.
+static char const * const s_buttonNames[16] = {
+  "dpad_up",
+  "dpad_down",
+  "dpad_left",
+  "dpad_right",
+  "start",
+  "back",
+  "left_thumb",
+  "right_thumb",
+  "left_shoulder",
+  "right_shoulder",
+  "unknown_0400",
+  "unknown_0800",
+  "a",
+  "b",
+  "x",
+  "y",
+};
+
+
+char const *xinputButtonName(int button)
+{
+  for (int i=0; i < 16; ++i) {
+    if (button == (1 << i)) {
+      return s_buttonNames[i];
+    }
+  }
+  return "unknown";
+}
+
+
+int xinputButtonFromName(char const *name)
+{
+  for (int i=0; i < 16; ++i) {
+    if (0==std::strcmp(name, s_buttonNames[i])) {
+      return 1 << i;
+    }
+  }
+  return 0;
+}
+
+
+std::uint64_t steadyClockUS()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
 // EOF
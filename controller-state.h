@@ -5,8 +5,9 @@
 #define CONTROLLER_STATE_H
 
 #include "gpv-config.h"                // AnalogThresholdConfig
+#include "windows-compat.h"            // XINPUT_STATE
 
-#include <xinput.h>                    // XINPUT_STATE
+#include <cstdint>                     // std::uint64_t
 
 
 // Encapsulate the state of the controller and a few related variables.
@@ -21,12 +22,17 @@ public:      // data
   // Value of `GetTickCount()` when the input was read.
   DWORD m_pollTimeMS;
 
+  // Value of `steadyClockUS()` when the input was read, for measuring
+  // display latency.  This is not recorded, so it is 0 on replay.
+  std::uint64_t m_pollTimeUS;
+
 public:      // funcs
   ControllerState();
 
   ControllerState &operator=(ControllerState const &obj);
 
-  // Read the controller state.
+  // Read the controller state.  This is only available on Windows;
+  // elsewhere, the state comes from a recording.
   void poll(int controllerID);
 
   // Return true if a trigger (which one depends on `leftSide`) should
@@ -40,4 +46,18 @@ public:      // funcs
 };
 
 
+// Return the name of the single `XINPUT_GAMEPAD_*` bit `button`, like
+// "a" or "left_shoulder", or "unknown".
+char const *xinputButtonName(int button);
+
+// Return the `XINPUT_GAMEPAD_*` bit named `name`, or 0 if there is
+// none.
+int xinputButtonFromName(char const *name);
+
+
+// Microseconds on `std::chrono::steady_clock`, which, unlike
+// `GetTickCount()`, has much better than 16 ms resolution.
+std::uint64_t steadyClockUS();
+
+
 #endif // CONTROLLER_STATE_H
@@ -0,0 +1,185 @@
+// d2d-canvas.cc
+// Code for `d2d-canvas` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "d2d-canvas.h"                // this module
+
+#include "winapi-util.h"               // CALL_HR_WINAPI, SafeReleaseOnLeave
+
+#include <cassert>                     // assert
+
+
+D2D1_MATRIX_3X2_F toD2D(Matrix3x2 const &m)
+{
+  D2D1_MATRIX_3X2_F ret;
+  ret._11 = m.m_11;
+  ret._12 = m.m_12;
+  ret._21 = m.m_21;
+  ret._22 = m.m_22;
+  ret._31 = m.m_31;
+  ret._32 = m.m_32;
+  return ret;
+}
+
+
+D2D1_RECT_F toD2D(RectF const &r)
+{
+  return D2D1::RectF(r.m_left, r.m_top, r.m_right, r.m_bottom);
+}
+
+
+D2D1_POINT_2F toD2D(Point2F p)
+{
+  return D2D1::Point2F(p.m_x, p.m_y);
+}
+
+
+D2DCanvas::D2DCanvas()
+  : Canvas(),
+    m_renderTarget(nullptr),
+    m_brushes{},
+    m_textBrush(nullptr),
+    m_writeFactory(nullptr),
+    m_textFormat(nullptr),
+    m_strokeStyle(nullptr),
+    m_textLayoutCache(nullptr)
+{}
+
+
+void D2DCanvas::setTransform(Matrix3x2 const &transform)
+{
+  m_renderTarget->SetTransform(toD2D(transform));
+}
+
+
+void D2DCanvas::drawEllipse(Point2F center, float rx, float ry,
+                            GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (ID2D1SolidColorBrush *brush = m_brushes[color]) {
+    m_renderTarget->DrawEllipse(
+      D2D1::Ellipse(toD2D(center), rx, ry),
+      brush,
+      strokeWidth,
+      m_strokeStyle);
+  }
+}
+
+
+void D2DCanvas::fillEllipse(Point2F center, float rx, float ry,
+                            GVColorRole color)
+{
+  ++m_primitiveCount;
+  if (ID2D1SolidColorBrush *brush = m_brushes[color]) {
+    m_renderTarget->FillEllipse(
+      D2D1::Ellipse(toD2D(center), rx, ry),
+      brush);
+  }
+}
+
+
+void D2DCanvas::drawRectangle(RectF const &rect,
+                              GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (ID2D1SolidColorBrush *brush = m_brushes[color]) {
+    m_renderTarget->DrawRectangle(
+      toD2D(rect),
+      brush,
+      strokeWidth,
+      m_strokeStyle);
+  }
+}
+
+
+void D2DCanvas::fillRectangle(RectF const &rect, GVColorRole color)
+{
+  ++m_primitiveCount;
+  if (ID2D1SolidColorBrush *brush = m_brushes[color]) {
+    m_renderTarget->FillRectangle(toD2D(rect), brush);
+  }
+}
+
+
+void D2DCanvas::drawLine(Point2F p1, Point2F p2,
+                         GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (ID2D1SolidColorBrush *brush = m_brushes[color]) {
+    m_renderTarget->DrawLine(
+      toD2D(p1),
+      toD2D(p2),
+      brush,
+      strokeWidth,
+      m_strokeStyle);
+  }
+}
+
+
+RectF D2DCanvas::measureText(std::wstring const &str,
+                             RectF const &layoutRect)
+{
+  if (m_textLayoutCache) {
+    RectF const &b = m_textLayoutCache->get(m_writeFactory, str,
+      layoutRect.width(), layoutRect.height()).m_bounds;
+    return RectF(layoutRect.m_left + b.m_left,
+                 layoutRect.m_top + b.m_top,
+                 layoutRect.m_left + b.m_right,
+                 layoutRect.m_top + b.m_bottom);
+  }
+
+  // Make a "text layout" object to measure the text that will be drawn.
+  IDWriteTextLayout *textLayout = nullptr;
+  CALL_HR_WINAPI(m_writeFactory->CreateTextLayout,
+    str.data(),
+    str.size(),
+    m_textFormat,
+    layoutRect.width(),
+    layoutRect.height(),
+    &textLayout);
+  assert(textLayout);
+  SafeReleaseOnLeave releaseTextLayout(textLayout);
+
+  // Measure it.
+  DWRITE_TEXT_METRICS tm{};
+  CALL_HR_WINAPI(textLayout->GetMetrics,
+    &tm);
+
+  // The measured width is just a bit tight on the right side.
+  tm.width += 1;
+
+  // The metrics structure contains coordinates that are relative to
+  // the upper-left corner of `layoutRect`.
+  float L = layoutRect.m_left + tm.left;
+  float T = layoutRect.m_top + tm.top;
+  return RectF(L,            T,
+               L + tm.width, T + tm.height);
+}
+
+
+void D2DCanvas::drawText(std::wstring const &str,
+                         RectF const &layoutRect)
+{
+  ++m_primitiveCount;
+
+  if (m_textLayoutCache) {
+    IDWriteTextLayout *layout = m_textLayoutCache->get(m_writeFactory, str,
+      layoutRect.width(), layoutRect.height()).m_layout;
+    m_renderTarget->DrawTextLayout(
+      toD2D(Point2F(layoutRect.m_left, layoutRect.m_top)),
+      layout,
+      m_textBrush);
+    return;
+  }
+
+  m_renderTarget->DrawText(
+    str.data(),
+    str.size(),
+    m_textFormat,
+    toD2D(layoutRect),
+    m_textBrush);
+}
+
+
+// EOF
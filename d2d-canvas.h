@@ -0,0 +1,74 @@
+// d2d-canvas.h
+// `D2DCanvas`, an implementation of `Canvas` that uses Direct2D.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef D2D_CANVAS_H
+#define D2D_CANVAS_H
+
+#include "canvas.h"                    // Canvas
+#include "text-layout-cache.h"         // TextLayoutCache
+
+#include <d2d1.h>                      // Direct2D
+#include <dwrite.h>                    // IDWriteFactory, IDWriteTextFormat
+
+
+// Forwards drawing operations to a D2D render target.
+//
+// None of the pointers are owned by this object; the client creates
+// and releases the underlying resources and points this object at them.
+//
+class D2DCanvas : public Canvas {
+public:      // data
+  // Render target to draw on.
+  ID2D1RenderTarget *m_renderTarget;
+
+  // Brush for each color role.  `GVCR_NONE` maps to null.
+  ID2D1SolidColorBrush *m_brushes[NUM_GV_COLOR_ROLES];
+
+  // Brush for drawing text.
+  ID2D1SolidColorBrush *m_textBrush;
+
+  // Used to create text layouts for measuring text.
+  IDWriteFactory *m_writeFactory;
+
+  // Format for all text.
+  IDWriteTextFormat *m_textFormat;
+
+  // Stroke style for all outlines.
+  ID2D1StrokeStyle *m_strokeStyle;
+
+  // If not null, text layouts are taken from here rather than made
+  // anew for each measurement and drawing.  Its context must already
+  // have been set to `m_textFormat` and the target's DPI.
+  TextLayoutCache *m_textLayoutCache;
+
+public:      // methods
+  // All pointers are initially null.
+  D2DCanvas();
+
+  // Canvas methods.
+  virtual void setTransform(Matrix3x2 const &transform) override;
+  virtual void drawEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color, float strokeWidth) override;
+  virtual void fillEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color) override;
+  virtual void drawRectangle(RectF const &rect,
+                             GVColorRole color, float strokeWidth) override;
+  virtual void fillRectangle(RectF const &rect, GVColorRole color) override;
+  virtual void drawLine(Point2F p1, Point2F p2,
+                        GVColorRole color, float strokeWidth) override;
+  virtual RectF measureText(std::wstring const &str,
+                            RectF const &layoutRect) override;
+  virtual void drawText(std::wstring const &str,
+                        RectF const &layoutRect) override;
+};
+
+
+// Conversions to D2D types.
+D2D1_MATRIX_3X2_F toD2D(Matrix3x2 const &m);
+D2D1_RECT_F toD2D(RectF const &r);
+D2D1_POINT_2F toD2D(Point2F p);
+
+
+#endif // D2D_CANVAS_H
@@ -0,0 +1,249 @@
+// event-stream-test.cc
+// Tests for `event-stream` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "event-stream.h"              // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <atomic>                      // std::atomic
+#include <chrono>                      // std::chrono
+#include <cstdlib>                     // std::strtoull
+#include <filesystem>                  // std::filesystem
+#include <fstream>                     // std::ofstream
+#include <thread>                      // std::thread
+
+#ifndef _WIN32
+  #include <cstring>                   // std::memcpy
+  #include <sys/socket.h>              // socket, bind
+  #include <sys/un.h>                  // sockaddr_un
+  #include <unistd.h>                  // close
+#endif
+
+namespace fs = std::filesystem;
+
+
+UNIT_TEST(eventStreamKeepsOtherFiles)
+{
+  std::string path = unitTestTempDir() + "/not-a-socket";
+  std::ofstream(path) << "precious";
+
+  EventStreamServer server(path);
+  EXPECT(!server.start().empty());
+  EXPECT(fs::is_regular_file(path));
+}
+
+
+UNIT_TEST(eventStreamKeepsLiveSocket)
+{
+  std::string path = unitTestTempDir() + "/live.sock";
+  EventStreamServer first(path);
+  EXPECT_EQ(first.start(), "");
+
+  EventStreamServer second(path);
+  EXPECT(!second.start().empty());
+  EXPECT(fs::exists(path));
+  first.stop();
+}
+
+
+#ifndef _WIN32
+UNIT_TEST(eventStreamReplacesStaleSocket)
+{
+  // Bind a socket and close it without removing the file, as a viewer
+  // that was killed would.
+  std::string path = unitTestTempDir() + "/stale.sock";
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size()+1);
+  int s = socket(AF_UNIX, SOCK_STREAM, 0);
+  EXPECT_EQ(bind(s, (sockaddr const *)&addr, sizeof(addr)), 0);
+  close(s);
+  EXPECT(fs::is_socket(path));
+
+  EventStreamServer server(path);
+  EXPECT_EQ(server.start(), "");
+  server.stop();
+  EXPECT(!fs::exists(path));
+}
+#endif // !_WIN32
+
+
+// Set `value` to the number after `"key":` in `line`.  Return false if
+// there is none.
+static bool getNumber(std::string const &line, char const *key,
+                      std::uint64_t &value /*OUT*/)
+{
+  std::string pattern = std::string("\"") + key + "\":";
+  std::size_t pos = line.find(pattern);
+  if (pos == std::string::npos) {
+    return false;
+  }
+  value = std::strtoull(line.c_str() + pos + pattern.size(), nullptr, 10);
+  return true;
+}
+
+
+// What a subscriber has read.
+class SubscriberLog {
+public:      // data
+  // Events read, and the total of the dropped counts.
+  std::uint64_t m_events;
+  std::uint64_t m_dropped;
+
+  // Events whose sequence number is not one more than the previous
+  // one's plus the dropped count in between, or whose contents are not
+  // those published with that number.
+  std::uint64_t m_unaccounted;
+
+  // Sequence number of the last event read.
+  std::atomic<std::uint64_t> m_lastSequence;
+
+  // True if the connection ended early.
+  bool m_closed;
+
+public:      // methods
+  SubscriberLog()
+    : m_events(0),
+      m_dropped(0),
+      m_unaccounted(0),
+      m_lastSequence(0),
+      m_closed(false)
+  {}
+};
+
+
+// The event published as number `n`, whose time is derived from `n`
+// so the subscribers can check they got the right one.
+static InputEvent numberedEvent(std::uint64_t n)
+{
+  InputEvent e;
+  e.m_timeMS = (std::uint32_t)(n * 7);
+  e.m_type = IET_BUTTON;
+  e.m_which = XINPUT_GAMEPAD_A;
+  e.m_a = (int)(n % 2);
+  return e;
+}
+
+
+// Read the greeting from `subscriber`.
+static void readGreeting(EventStreamSubscriber &subscriber)
+{
+  std::string line;
+  EXPECT(subscriber.readLine(line));
+  EXPECT_EQ(line, "{\"event\":\"hello\",\"version\":1}");
+}
+
+
+// Read events from `subscriber` into `log` until the one numbered
+// `lastSequence`.
+static void readEvents(EventStreamSubscriber &subscriber,
+                       std::uint64_t lastSequence, SubscriberLog &log)
+{
+  // Dropped count not yet matched by a jump in the sequence.
+  std::uint64_t pendingDropped = 0;
+
+  std::string line;
+  while (log.m_lastSequence.load() < lastSequence) {
+    if (!subscriber.readLine(line)) {
+      log.m_closed = true;
+      return;
+    }
+
+    std::uint64_t n, t;
+    if (getNumber(line, "seq", n)) {
+      std::uint64_t last = log.m_lastSequence.load();
+      if (n != last + 1 + pendingDropped ||
+          !getNumber(line, "t_ms", t) ||
+          t != numberedEvent(n).m_timeMS) {
+        log.m_unaccounted++;
+      }
+      log.m_events++;
+      pendingDropped = 0;
+      log.m_lastSequence.store(n);
+    }
+    else if (getNumber(line, "count", n)) {
+      log.m_dropped += n;
+      pendingDropped += n;
+    }
+  }
+}
+
+
+// A bounded `gpv-events load`.  One subscriber keeps up, and gets
+// every event in order.  The other does not read until everything has
+// been published, so its small queue overflows, and it gets the newest
+// events, in order, with dropped counts that account for the rest.
+UNIT_TEST(eventStreamSlowAndFastSubscribers)
+{
+  std::string path = unitTestTempDir() + "/load.sock";
+  int const capacity = 16;
+  EventStreamServer server(path, capacity);
+  EXPECT_EQ(server.start(), "");
+
+  EventStreamSubscriber fast, slow;
+  EXPECT_EQ(fast.open(path), "");
+  EXPECT_EQ(slow.open(path), "");
+  readGreeting(fast);
+  readGreeting(slow);
+
+  // The server accepts subscribers on its own thread.
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+  while (server.numClients() < 2 && Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(server.numClients(), 2);
+
+  // Enough for the slow one's socket buffers to fill many times over.
+  std::uint64_t const numEvents = 20000;
+  SubscriberLog fastLog, slowLog;
+  std::atomic<bool> published(false);
+  std::thread fastReader([&] { readEvents(fast, numEvents, fastLog); });
+  std::thread slowReader([&] {
+    while (!published.load()) {
+      std::this_thread::yield();
+    }
+    readEvents(slow, numEvents, slowLog);
+  });
+
+  // Publish in bursts smaller than the queue, letting the fast one
+  // catch up after each, as the viewer's poll rate would.
+  deadline = Clock::now() + std::chrono::seconds(30);
+  for (std::uint64_t n=1; n <= numEvents; ++n) {
+    server.publish(numberedEvent(n));
+    if (n % (capacity/2) == 0) {
+      while (fastLog.m_lastSequence.load() < n && Clock::now() < deadline) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  published = true;
+
+  // Stopping the server disconnects the subscribers, so if either
+  // never gets the last event, it stops waiting for it.
+  while (slowLog.m_lastSequence.load() < numEvents &&
+         Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  server.stop();
+  fastReader.join();
+  slowReader.join();
+
+  EXPECT(!fastLog.m_closed);
+  EXPECT_EQ(fastLog.m_events, numEvents);
+  EXPECT_EQ(fastLog.m_dropped, (std::uint64_t)0);
+  EXPECT_EQ(fastLog.m_unaccounted, (std::uint64_t)0);
+
+  EXPECT(!slowLog.m_closed);
+  EXPECT_EQ(slowLog.m_lastSequence.load(), numEvents);
+  EXPECT_EQ(slowLog.m_unaccounted, (std::uint64_t)0);
+  EXPECT_EQ(slowLog.m_events + slowLog.m_dropped, numEvents);
+  EXPECT(slowLog.m_dropped > 0);
+  EXPECT(slowLog.m_events >= (std::uint64_t)capacity);
+  EXPECT_EQ(server.numDropped(), slowLog.m_dropped);
+}
+
+
+// EOF
@@ -0,0 +1,692 @@
+// event-stream.cc
+// Code for `event-stream` module.
+
+// See license.txt for copyright and terms of use.
+
+// On Windows, winsock2.h has to come before windows.h, which the
+// module header includes indirectly.
+#ifdef _WIN32
+  #include <winsock2.h>                // socket, etc.
+  #include <afunix.h>                  // sockaddr_un
+#endif
+
+#include "event-stream.h"              // this module
+
+#include <chrono>                      // std::chrono
+#include <cstdio>                      // std::{remove, snprintf}
+#include <cstring>                     // std::{memcpy, memset, strerror}
+#include <filesystem>                  // std::filesystem::path
+
+#ifndef _WIN32
+  #include <cerrno>                    // errno, EAGAIN, etc.
+  #include <fcntl.h>                   // fcntl, O_NONBLOCK
+  #include <sys/socket.h>              // socket, etc.
+  #include <sys/stat.h>                // lstat, S_ISSOCK
+  #include <sys/un.h>                  // sockaddr_un
+  #include <unistd.h>                  // close, unlink
+#endif
+
+
+// ---------------------------- Portability ----------------------------
+#ifdef _WIN32
+
+typedef SOCKET NativeSocket;
+
+static EventStreamSocket const c_invalidSocket =
+  (EventStreamSocket)INVALID_SOCKET;
+
+// Flags for `send`.
+static int const c_sendFlags = 0;
+
+// Return a message describing the last socket error after `what`.
+static std::string socketErrorString(char const *what)
+{
+  return std::string(what) + " failed with code " +
+         std::to_string(WSAGetLastError());
+}
+
+// True if the last socket call failed only because it would block.
+static bool lastErrorWouldBlock()
+{
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+static void closeSocket(EventStreamSocket s)
+{
+  closesocket((NativeSocket)s);
+}
+
+static bool setNonBlocking(EventStreamSocket s)
+{
+  u_long one = 1;
+  return ioctlsocket((NativeSocket)s, FIONBIO, &one) == 0;
+}
+
+// Winsock has to be initialized by every user, and counts them.
+static std::string startSockets()
+{
+  WSADATA data;
+  int err = WSAStartup(MAKEWORD(2, 2), &data);
+  if (err != 0) {
+    return "WSAStartup failed with code " + std::to_string(err);
+  }
+  return "";
+}
+
+static void stopSockets()
+{
+  WSACleanup();
+}
+
+// True if the last `connect` failed because nothing is listening.
+static bool lastErrorConnectionRefused()
+{
+  return WSAGetLastError() == WSAECONNREFUSED;
+}
+
+// Older SDKs lack this.
+#ifndef IO_REPARSE_TAG_AF_UNIX
+  #define IO_REPARSE_TAG_AF_UNIX 0x80000023L
+#endif
+
+// Set `exists` and `isSocket` for `path`, without following links.
+// Return an empty string on success or an error message on failure.
+static std::string statSocketPath(std::string const &path,
+                                  bool &exists /*OUT*/,
+                                  bool &isSocket /*OUT*/)
+{
+  exists = isSocket = false;
+
+  // `FindFirstFile` reports the reparse tag, which is how Windows
+  // marks a socket file.
+  WIN32_FIND_DATAW data;
+  HANDLE h = FindFirstFileW(std::filesystem::path(path).wstring().c_str(),
+                            &data);
+  if (h == INVALID_HANDLE_VALUE) {
+    DWORD err = GetLastError();
+    if (err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND) {
+      return "";
+    }
+    return "FindFirstFile failed with code " + std::to_string(err);
+  }
+  FindClose(h);
+
+  exists = true;
+  isSocket = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+             data.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+  return "";
+}
+
+// Remove the socket file at `path`.  Return false on failure.
+static bool removeSocketFile(std::string const &path)
+{
+  return DeleteFileW(std::filesystem::path(path).wstring().c_str()) ||
+         GetLastError() == ERROR_FILE_NOT_FOUND;
+}
+
+#else // !_WIN32
+
+typedef int NativeSocket;
+
+static EventStreamSocket const c_invalidSocket = (EventStreamSocket)-1;
+
+// Report a closed connection as an error rather than with SIGPIPE.
+static int const c_sendFlags = MSG_NOSIGNAL;
+
+static std::string socketErrorString(char const *what)
+{
+  return std::string(what) + ": " + std::strerror(errno);
+}
+
+static bool lastErrorWouldBlock()
+{
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static void closeSocket(EventStreamSocket s)
+{
+  ::close((NativeSocket)s);
+}
+
+static bool setNonBlocking(EventStreamSocket s)
+{
+  int flags = fcntl((NativeSocket)s, F_GETFL);
+  return flags >= 0 &&
+         fcntl((NativeSocket)s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static std::string startSockets()
+{
+  return "";
+}
+
+static void stopSockets()
+{}
+
+static bool lastErrorConnectionRefused()
+{
+  return errno == ECONNREFUSED;
+}
+
+static std::string statSocketPath(std::string const &path,
+                                  bool &exists /*OUT*/,
+                                  bool &isSocket /*OUT*/)
+{
+  exists = isSocket = false;
+
+  struct stat st;
+  if (lstat(path.c_str(), &st) != 0) {
+    if (errno == ENOENT) {
+      return "";
+    }
+    return socketErrorString("lstat");
+  }
+
+  exists = true;
+  isSocket = S_ISSOCK(st.st_mode);
+  return "";
+}
+
+static bool removeSocketFile(std::string const &path)
+{
+  return unlink(path.c_str()) == 0 || errno == ENOENT;
+}
+
+#endif // !_WIN32
+
+
+// Bytes of socket send buffer for each subscriber.
+static int const c_sendBufferSize = 16384;
+
+
+// Set `addr` to the address of `path`.  Return an empty string on
+// success or an error message if the path is too long.
+static std::string makeAddress(sockaddr_un &addr, std::string const &path)
+{
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return "socket path is too long";
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size()+1);
+  return "";
+}
+
+
+// A socket file left at `path` by a viewer that did not exit cleanly
+// would make `bind` fail, so remove it, but only if it is a socket
+// that nothing is listening on.  Anything else there is not ours to
+// delete: report it instead.  `addr` is the address of `path`.  Return
+// an empty string if `path` is now free.
+static std::string removeStaleSocket(std::string const &path,
+                                     sockaddr_un const &addr)
+{
+  bool exists, isSocket;
+  std::string error = statSocketPath(path, exists, isSocket);
+  if (!error.empty() || !exists) {
+    return error;
+  }
+  if (!isSocket) {
+    return "the path exists and is not a socket";
+  }
+
+  NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((EventStreamSocket)s == c_invalidSocket) {
+    return socketErrorString("socket");
+  }
+  if (connect(s, (sockaddr const *)&addr, sizeof(addr)) == 0) {
+    error = "another process is listening on the socket";
+  }
+  else if (!lastErrorConnectionRefused()) {
+    error = socketErrorString("connecting to the existing socket");
+  }
+  closeSocket((EventStreamSocket)s);
+  if (!error.empty()) {
+    return error;
+  }
+
+  if (!removeSocketFile(path)) {
+    return "could not remove the stale socket";
+  }
+  return "";
+}
+
+
+// ------------------------- EventStreamClient -------------------------
+class EventStreamClient {
+public:      // data
+  EventStreamSocket const m_socket;
+
+  // Events waiting to be sent, as a ring of fixed capacity.  Guarded
+  // by the server's mutex.
+  std::vector<InputEvent> m_queue;
+  int m_head;
+  int m_count;
+
+  // Events discarded since the thread last took from `m_queue`.
+  // Guarded by the server's mutex.
+  std::uint64_t m_dropped;
+
+  // The rest is only used by the server's thread.
+
+  // Events taken from `m_queue`, and how many were dropped before
+  // them.
+  std::vector<InputEvent> m_batch;
+  std::uint64_t m_batchDropped;
+
+  // Formatted text, and how much of it has been sent.
+  std::string m_out;
+  std::size_t m_outSent;
+
+  // True once the connection has failed or been closed by the peer.
+  bool m_closed;
+
+public:      // methods
+  EventStreamClient(EventStreamSocket socket, int capacity)
+    : m_socket(socket),
+      m_queue(capacity),
+      m_head(0),
+      m_count(0),
+      m_dropped(0),
+      m_batch(),
+      m_batchDropped(0),
+      m_out(),
+      m_outSent(0),
+      m_closed(false)
+  {
+    m_batch.reserve(capacity);
+  }
+
+  ~EventStreamClient()
+  {
+    closeSocket(m_socket);
+  }
+
+  // True if everything formatted so far has been sent.
+  bool caughtUp() const
+    { return m_outSent == m_out.size(); }
+
+  // Append `event` to the queue, discarding the oldest event if it is
+  // full.  Return true if one was discarded.
+  bool push(InputEvent const &event)
+  {
+    int capacity = (int)m_queue.size();
+    bool drop = (m_count == capacity);
+    if (drop) {
+      m_head = (m_head + 1) % capacity;
+      m_count--;
+      m_dropped++;
+    }
+    m_queue[(m_head + m_count) % capacity] = event;
+    m_count++;
+    return drop;
+  }
+
+  // Move the queued events to `m_batch`.
+  void take()
+  {
+    int capacity = (int)m_queue.size();
+    for (int i=0; i < m_count; ++i) {
+      m_batch.push_back(m_queue[(m_head + i) % capacity]);
+    }
+    m_head = 0;
+    m_count = 0;
+    m_batchDropped += m_dropped;
+    m_dropped = 0;
+  }
+
+  // Format `m_batch` into `m_out`.
+  void format()
+  {
+    if (caughtUp()) {
+      m_out.clear();
+      m_outSent = 0;
+    }
+
+    if (m_batchDropped) {
+      char buf[80];
+      int len = std::snprintf(buf, sizeof(buf),
+        "{\"event\":\"dropped\",\"count\":%llu}\n",
+        (unsigned long long)m_batchDropped);
+      m_out.append(buf, len);
+      m_batchDropped = 0;
+    }
+
+    for (InputEvent const &e : m_batch) {
+      appendInputEventJSON(m_out, e);
+    }
+    m_batch.clear();
+  }
+
+  // Send as much of `m_out` as the socket will take without waiting.
+  void flush()
+  {
+    while (!m_closed && !caughtUp()) {
+      int n = send((NativeSocket)m_socket, m_out.data() + m_outSent,
+                   (int)(m_out.size() - m_outSent), c_sendFlags);
+      if (n > 0) {
+        m_outSent += n;
+      }
+      else if (n < 0 && lastErrorWouldBlock()) {
+        break;
+      }
+      else {
+        m_closed = true;
+      }
+    }
+  }
+
+  // Check whether the peer has closed the connection.  Subscribers do
+  // not send anything, so whatever they do send is discarded.
+  void checkClosed()
+  {
+    char buf[256];
+    while (!m_closed) {
+      int n = recv((NativeSocket)m_socket, buf, sizeof(buf), 0);
+      if (n > 0) {
+        continue;
+      }
+      if (n < 0 && lastErrorWouldBlock()) {
+        break;
+      }
+      m_closed = true;
+    }
+  }
+};
+
+
+// ------------------------- EventStreamServer -------------------------
+EventStreamServer::EventStreamServer(std::string const &path,
+                                     int queueCapacity)
+  : m_path(path),
+    m_queueCapacity(queueCapacity),
+    m_listenSocket(c_invalidSocket),
+    m_mutex(),
+    m_wake(),
+    m_clients(),
+    m_eventsPending(false),
+    m_stopping(false),
+    m_nextSequence(1),
+    m_numClients(0),
+    m_numDropped(0),
+    m_thread()
+{}
+
+
+EventStreamServer::~EventStreamServer()
+{
+  stop();
+}
+
+
+std::string EventStreamServer::start()
+{
+  std::string error = startSockets();
+  if (!error.empty()) {
+    return error;
+  }
+
+  sockaddr_un addr;
+  error = makeAddress(addr, m_path);
+  if (!error.empty()) {
+    stopSockets();
+    return error;
+  }
+
+  NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((EventStreamSocket)s == c_invalidSocket) {
+    error = socketErrorString("socket");
+    stopSockets();
+    return error;
+  }
+
+  error = removeStaleSocket(m_path, addr);
+  if (!error.empty()) {
+    closeSocket((EventStreamSocket)s);
+    stopSockets();
+    return error;
+  }
+
+  if (bind(s, (sockaddr const *)&addr, sizeof(addr)) != 0) {
+    error = socketErrorString("bind");
+  }
+  else if (listen(s, 16) != 0) {
+    error = socketErrorString("listen");
+  }
+  else if (!setNonBlocking((EventStreamSocket)s)) {
+    error = socketErrorString("setting non-blocking mode");
+  }
+  if (!error.empty()) {
+    closeSocket((EventStreamSocket)s);
+    stopSockets();
+    return error;
+  }
+
+  m_listenSocket = (EventStreamSocket)s;
+  m_thread = std::thread(&EventStreamServer::run, this);
+  return "";
+}
+
+
+void EventStreamServer::stop()
+{
+  if (m_listenSocket == c_invalidSocket) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_clients.clear();
+  }
+  m_numClients = 0;
+
+  closeSocket(m_listenSocket);
+  m_listenSocket = c_invalidSocket;
+  std::remove(m_path.c_str());
+  stopSockets();
+}
+
+
+void EventStreamServer::publish(InputEvent const &event)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    InputEvent e = event;
+    e.m_sequence = m_nextSequence++;
+    for (std::unique_ptr<EventStreamClient> &c : m_clients) {
+      if (c->push(e)) {
+        m_numDropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    m_eventsPending = true;
+  }
+  m_wake.notify_one();
+}
+
+
+void EventStreamServer::acceptClients()
+{
+  while (true) {
+    NativeSocket s = accept((NativeSocket)m_listenSocket, nullptr, nullptr);
+    if ((EventStreamSocket)s == c_invalidSocket) {
+      // Nothing more to accept, or an error that the next attempt will
+      // run into again.  Either way, try again later.
+      return;
+    }
+
+    std::unique_ptr<EventStreamClient> client(
+      new EventStreamClient((EventStreamSocket)s, m_queueCapacity));
+    if (!setNonBlocking(client->m_socket)) {
+      // Dropping `client` closes the socket.
+      continue;
+    }
+
+    // Keep the kernel from buffering much more than the queue does, so
+    // the queue, not the kernel, decides what a slow subscriber misses.
+    // Failure just leaves the default.
+    int sendBufferSize = c_sendBufferSize;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char const *)&sendBufferSize,
+               sizeof(sendBufferSize));
+    client->m_out = "{\"event\":\"hello\",\"version\":1}\n";
+    client->flush();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_clients.push_back(std::move(client));
+    m_numClients = (int)m_clients.size();
+  }
+}
+
+
+void EventStreamServer::run()
+{
+  // True if some subscriber has events or text it could not be given
+  // yet because it is not reading fast enough.
+  bool backlog = false;
+
+  while (true) {
+    {
+      // Wake for new events, and periodically to accept subscribers,
+      // or more often while waiting for a slow one to catch up.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait_for(lock, std::chrono::milliseconds(backlog? 2 : 20),
+        [this] { return m_eventsPending || m_stopping; });
+      if (m_stopping) {
+        break;
+      }
+      m_eventsPending = false;
+
+      // Only take events for subscribers that have been sent
+      // everything already.  Events for the others wait in their
+      // queues, which bounds the memory a slow one can use.
+      backlog = false;
+      for (std::unique_ptr<EventStreamClient> &c : m_clients) {
+        if (c->caughtUp()) {
+          c->take();
+        }
+        else {
+          backlog = true;
+        }
+      }
+    }
+
+    // Format and send without holding the lock, so `publish` never
+    // waits for that.
+    bool anyClosed = false;
+    for (std::unique_ptr<EventStreamClient> &c : m_clients) {
+      c->format();
+      c->flush();
+      c->checkClosed();
+      backlog = backlog || !c->caughtUp();
+      anyClosed = anyClosed || c->m_closed;
+    }
+
+    if (anyClosed) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (std::size_t i=0; i < m_clients.size(); ) {
+        if (m_clients[i]->m_closed) {
+          m_clients.erase(m_clients.begin() + i);
+        }
+        else {
+          ++i;
+        }
+      }
+      m_numClients = (int)m_clients.size();
+    }
+
+    acceptClients();
+  }
+}
+
+
+// ----------------------- EventStreamSubscriber -----------------------
+EventStreamSubscriber::EventStreamSubscriber()
+  : m_socket(c_invalidSocket),
+    m_buffer()
+{}
+
+
+EventStreamSubscriber::~EventStreamSubscriber()
+{
+  close();
+}
+
+
+std::string EventStreamSubscriber::open(std::string const &path)
+{
+  close();
+
+  std::string error = startSockets();
+  if (!error.empty()) {
+    return error;
+  }
+
+  sockaddr_un addr;
+  error = makeAddress(addr, path);
+  if (!error.empty()) {
+    stopSockets();
+    return error;
+  }
+
+  NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((EventStreamSocket)s == c_invalidSocket) {
+    error = socketErrorString("socket");
+    stopSockets();
+    return error;
+  }
+
+  if (connect(s, (sockaddr const *)&addr, sizeof(addr)) != 0) {
+    error = socketErrorString("connect");
+    closeSocket((EventStreamSocket)s);
+    stopSockets();
+    return error;
+  }
+
+  m_socket = (EventStreamSocket)s;
+  m_buffer.clear();
+  return "";
+}
+
+
+bool EventStreamSubscriber::readLine(std::string &line /*OUT*/)
+{
+  if (m_socket == c_invalidSocket) {
+    return false;
+  }
+
+  while (true) {
+    std::size_t newline = m_buffer.find('\n');
+    if (newline != std::string::npos) {
+      line.assign(m_buffer, 0, newline);
+      m_buffer.erase(0, newline+1);
+      return true;
+    }
+
+    char buf[4096];
+    int n = recv((NativeSocket)m_socket, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    m_buffer.append(buf, n);
+  }
+}
+
+
+void EventStreamSubscriber::close()
+{
+  if (m_socket != c_invalidSocket) {
+    closeSocket(m_socket);
+    m_socket = c_invalidSocket;
+    stopSockets();
+  }
+}
+
+
+// EOF
@@ -0,0 +1,164 @@
+// event-stream.h
+// `EventStreamServer`, which pushes input events to local subscribers
+// over a Unix-domain socket, and `EventStreamSubscriber`, which reads
+// them.
+
+// See license.txt for copyright and terms of use.
+
+// The viewer (with `EVENT_STREAM` set) listens on a Unix-domain socket
+// (`AF_UNIX`, which Windows 10 and later also support) and sends each
+// connected subscriber every `InputEvent` as a line of JSON.  The first
+// line a subscriber gets is a greeting:
+//
+//   {"event":"hello","version":1}
+//
+// Each subscriber has its own fixed-size queue.  Publishing an event
+// just appends it to the queues, which never blocks on a subscriber
+// and never allocates; a background thread formats and sends them.  If
+// a subscriber reads too slowly and its queue is full, the oldest
+// event in it is discarded, and before the next event it receives,
+// the subscriber is told how many it missed:
+//
+//   {"event":"dropped","count":12}
+//
+// Sequence numbers are consecutive, so the `seq` of the next event is
+// always one more than the previous one plus any dropped count.
+
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include "input-events.h"              // InputEvent
+
+#include <atomic>                      // std::atomic
+#include <condition_variable>          // std::condition_variable
+#include <cstdint>                     // std::{uint64_t, uintptr_t}
+#include <memory>                      // std::unique_ptr
+#include <mutex>                       // std::mutex
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Socket path used if `EVENT_STREAM` is set to 1 rather than a path.
+#define EVENT_STREAM_DEFAULT_PATH "gamepad-viewer-events.sock"
+
+
+// A socket: a `SOCKET` on Windows and a descriptor elsewhere.  This
+// avoids including the socket headers here.
+typedef std::uintptr_t EventStreamSocket;
+
+// One connected subscriber.  Defined in event-stream.cc.
+class EventStreamClient;
+
+
+class EventStreamServer {
+public:      // data
+  // Path of the socket.
+  std::string const m_path;
+
+  // Events each subscriber's queue holds.
+  int const m_queueCapacity;
+
+private:     // data
+  // Listening socket, or invalid if not started.
+  EventStreamSocket m_listenSocket;
+
+  // Protects `m_clients`, their queues, `m_eventsPending`, and
+  // `m_stopping`.  The list itself is only changed by the thread.
+  std::mutex m_mutex;
+
+  // Signaled when events are published or `stop` is called.
+  std::condition_variable m_wake;
+
+  // Connected subscribers.
+  std::vector<std::unique_ptr<EventStreamClient>> m_clients;
+
+  // True if events have been queued since the thread last looked.
+  bool m_eventsPending;
+
+  // True once `stop` has been called.
+  bool m_stopping;
+
+  // Sequence number of the next event.  Only used by `publish`.
+  std::uint64_t m_nextSequence;
+
+  // Number of subscribers, and events discarded from full queues.
+  std::atomic<int> m_numClients;
+  std::atomic<std::uint64_t> m_numDropped;
+
+  // Accepts subscribers and sends them their events.
+  std::thread m_thread;
+
+private:     // methods
+  // Background thread body.
+  void run();
+
+  // Accept any pending connections.
+  void acceptClients();
+
+public:      // methods
+  // This does not listen yet; call `start` for that.
+  explicit EventStreamServer(std::string const &path,
+                             int queueCapacity = 1024);
+
+  // Stops the thread if it is running.
+  ~EventStreamServer();
+
+  EventStreamServer(EventStreamServer const &obj) = delete;
+  EventStreamServer &operator=(EventStreamServer const &obj) = delete;
+
+  // Listen on `m_path` and start the background thread.  A socket
+  // file there that nothing listens on, left by a previous run, is
+  // replaced; anything else there is an error.  Return an empty string
+  // on success or an error message on failure.
+  std::string start();
+
+  // Stop the thread, disconnect the subscribers, and remove the socket
+  // file.
+  void stop();
+
+  // Queue `event` for every subscriber, giving it the next sequence
+  // number.  Call from one thread only.
+  void publish(InputEvent const &event);
+
+  // Number of subscribers connected now.
+  int numClients() const
+    { return m_numClients.load(std::memory_order_relaxed); }
+
+  // Total events discarded because a subscriber's queue was full.
+  std::uint64_t numDropped() const
+    { return m_numDropped.load(std::memory_order_relaxed); }
+};
+
+
+// A connection to an `EventStreamServer`, for reading its lines.
+class EventStreamSubscriber {
+private:     // data
+  // Connected socket, or invalid if not connected.
+  EventStreamSocket m_socket;
+
+  // Bytes received but not yet returned by `readLine`.
+  std::string m_buffer;
+
+public:      // methods
+  EventStreamSubscriber();
+  ~EventStreamSubscriber();
+
+  EventStreamSubscriber(EventStreamSubscriber const &obj) = delete;
+  EventStreamSubscriber &operator=(EventStreamSubscriber const &obj)
+    = delete;
+
+  // Connect to the server listening at `path`.  Return an empty string
+  // on success or an error message on failure.
+  std::string open(std::string const &path);
+
+  // Wait for the next line, and store it in `line` without its
+  // newline.  Return false if the server closed the connection or
+  // there was an error.
+  bool readLine(std::string &line /*OUT*/);
+
+  void close();
+};
+
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,177 @@
+// frame-encoder.cc
+// Code for `frame-encoder` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "frame-encoder.h"             // this module
+
+#include <cassert>                     // assert
+#include <cstddef>                     // std::size_t
+#include <cstring>                     // std::{memcpy, memset}
+#include <sstream>                     // std::ostringstream
+
+
+// Separator that precedes each Y4M frame.
+static char const s_y4mFrameHeader[] = "FRAME\n";
+static std::size_t const s_y4mFrameHeaderLen = sizeof(s_y4mFrameHeader)-1;
+
+
+// Undo alpha premultiplication of one component.
+static inline int unpremultiply(int c, int a)
+{
+  return (c * 255 + a/2) / a;
+}
+
+
+// Get the straight-alpha components of `p`.
+static inline void straightRGBA(RasterPixel p,
+                                int &r, int &g, int &b, int &a)
+{
+  r = rasterPixelR(p);
+  g = rasterPixelG(p);
+  b = rasterPixelB(p);
+  a = rasterPixelA(p);
+
+  if (a != 255 && a != 0) {
+    r = unpremultiply(r, a);
+    g = unpremultiply(g, a);
+    b = unpremultiply(b, a);
+  }
+}
+
+
+std::string frameStreamHeader(FrameFormat format, int width, int height,
+                              int fps, bool alpha)
+{
+  if (format == FF_Y4M) {
+    std::ostringstream oss;
+    oss << "YUV4MPEG2 W" << width << " H" << height
+        << " F" << fps << ":1 Ip A1:1 "
+        << (alpha? "C444alpha" : "C444") << "\n";
+    return oss.str();
+  }
+
+  // Raw frames have no header.
+  return "";
+}
+
+
+// Encode pixels [x0,x1) of row `y` of `image` into `frame`, which
+// points at the first pixel byte of an encoded frame.
+static void encodeSpan(unsigned char *frame, RasterImage const &image,
+                       FrameFormat format, bool alpha,
+                       int y, int x0, int x1)
+{
+  std::size_t const numPixels = image.m_pixels.size();
+  std::size_t const start = (std::size_t)y * image.m_width + x0;
+  std::size_t const end = start + (x1 - x0);
+  RasterPixel const *src = image.m_pixels.data();
+
+  if (format == FF_RGBA) {
+    unsigned char *out = frame + start*4;
+
+    if (!alpha) {
+      // Opaque pixels need no unpremultiplying, and on a little-endian
+      // machine, `RasterPixel` is already R, G, B, A in memory order.
+      std::memcpy(out, src + start, (end - start) * 4);
+      return;
+    }
+
+    for (std::size_t i=start; i < end; ++i) {
+      int r, g, b, a;
+      straightRGBA(src[i], r, g, b, a);
+      out[0] = r;
+      out[1] = g;
+      out[2] = b;
+      out[3] = a;
+      out += 4;
+    }
+    return;
+  }
+
+  // Y4M planes.
+  unsigned char *yPlane = frame;
+  unsigned char *uPlane = yPlane + numPixels;
+  unsigned char *vPlane = uPlane + numPixels;
+  unsigned char *aPlane = vPlane + numPixels;
+
+  // The display is mostly long runs of identical pixels, so convert
+  // once per run and fill the planes with `memset`.
+  for (std::size_t i=start; i < end; ) {
+    RasterPixel p = src[i];
+    std::size_t runEnd = i+1;
+    while (runEnd < end && src[runEnd] == p) {
+      ++runEnd;
+    }
+
+    int r, g, b, a;
+    straightRGBA(p, r, g, b, a);
+
+    // BT.601 studio range, in 8.8 fixed point.
+    std::size_t n = runEnd - i;
+    std::memset(yPlane + i, (( 66*r + 129*g +  25*b + 128) >> 8) + 16,  n);
+    std::memset(uPlane + i, ((-38*r -  74*g + 112*b + 128) >> 8) + 128, n);
+    std::memset(vPlane + i, ((112*r -  94*g -  18*b + 128) >> 8) + 128, n);
+    if (alpha) {
+      std::memset(aPlane + i, a, n);
+    }
+    i = runEnd;
+  }
+}
+
+
+// Return the number of bytes before the first pixel byte of an
+// encoded frame.
+static std::size_t frameHeaderLength(FrameFormat format)
+{
+  return format == FF_Y4M? s_y4mFrameHeaderLen : 0;
+}
+
+
+// Return the number of pixel bytes in an encoded frame.
+static std::size_t framePixelBytes(RasterImage const &image,
+                                   FrameFormat format, bool alpha)
+{
+  int bytesPerPixel = (format == FF_RGBA || alpha)? 4 : 3;
+  return image.m_pixels.size() * bytesPerPixel;
+}
+
+
+void encodeFrame(std::string &dest, RasterImage const &image,
+                 FrameFormat format, bool alpha)
+{
+  if (format == FF_Y4M) {
+    dest.append(s_y4mFrameHeader, s_y4mFrameHeaderLen);
+  }
+
+  std::size_t start = dest.size();
+  dest.resize(start + framePixelBytes(image, format, alpha));
+  unsigned char *frame = (unsigned char*)&dest[start];
+
+  for (int y=0; y < image.m_height; ++y) {
+    encodeSpan(frame, image, format, alpha, y, 0, image.m_width);
+  }
+}
+
+
+void reencodeFrameRows(std::string &encoded, RasterImage const &image,
+                       FrameFormat format, bool alpha,
+                       RasterDirtyRows const &rows)
+{
+  std::size_t headerLen = frameHeaderLength(format);
+  assert(encoded.size() ==
+         headerLen + framePixelBytes(image, format, alpha));
+  assert((int)rows.m_rows.size() == image.m_height);
+
+  unsigned char *frame = (unsigned char*)&encoded[headerLen];
+  for (int y=0; y < image.m_height; ++y) {
+    RasterSpan const &span = rows.m_rows[y];
+    if (!span.empty()) {
+      encodeSpan(frame, image, format, alpha,
+                 y, span.m_left, span.m_right);
+    }
+  }
+}
+
+
+// EOF
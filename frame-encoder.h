@@ -0,0 +1,47 @@
+// frame-encoder.h
+// Conversion of rendered frames to raw video formats.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef FRAME_ENCODER_H
+#define FRAME_ENCODER_H
+
+#include "raster-canvas.h"             // RasterDirtyRows, RasterImage
+
+#include <string>                      // std::string
+
+
+// Output video formats.
+enum FrameFormat {
+  // Raw 8-bit R, G, B, A bytes per pixel, rows top to bottom, with no
+  // header or frame separators.  Alpha is straight (not premultiplied),
+  // which is what, e.g., `ffmpeg -f rawvideo -pix_fmt rgba` expects.
+  FF_RGBA,
+
+  // YUV4MPEG2 with full-resolution (4:4:4) BT.601 studio-range chroma.
+  // With alpha, it uses the "C444alpha" colorspace that ffmpeg
+  // understands, which adds a full-range alpha plane.
+  FF_Y4M,
+};
+
+
+// Return the bytes that precede the first frame of a stream.
+std::string frameStreamHeader(FrameFormat format, int width, int height,
+                              int fps, bool alpha);
+
+// Append the encoding of `image` to `dest`.  If `alpha` is false, the
+// image is assumed to be opaque and no alpha is written for Y4M.
+void encodeFrame(std::string &dest, RasterImage const &image,
+                 FrameFormat format, bool alpha);
+
+// Given `encoded`, exactly the result of `encodeFrame` for an image the
+// same size as `image` with the same `format` and `alpha`, re-encode
+// just the pixels in `rows` from `image`.  When only a small part of
+// the image has changed since `encoded` was made, this is much faster
+// than encoding it all again.
+void reencodeFrameRows(std::string &encoded, RasterImage const &image,
+                       FrameFormat format, bool alpha,
+                       RasterDirtyRows const &rows);
+
+
+#endif // FRAME_ENCODER_H
@@ -0,0 +1,119 @@
+// frame-profiler.cc
+// Code for `frame-profiler` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "frame-profiler.h"            // this module
+
+#include <cstring>                     // std::memset
+
+
+char const *toString(FrameProfilerPhase phase)
+{
+  switch (phase) {
+    case FPP_OTHER:              return "other";
+    case FPP_DEBUG_TEXT:         return "debug text";
+    case FPP_ROUND_BUTTONS:      return "round buttons";
+    case FPP_DPAD_BUTTONS:       return "dpad";
+    case FPP_SHOULDER_BUTTONS:   return "shoulders";
+    case FPP_PARRY_TIMER:        return "parry timer";
+    case FPP_STICKS:             return "sticks";
+    case FPP_TEXT:               return "text";
+    case FPP_OVERLAY:            return "overlay";
+    default:                     return "unknown";
+  }
+}
+
+
+// --------------------------- FrameProfiler ---------------------------
+FrameProfiler::FrameProfiler()
+  : m_nextSlot(0),
+    m_historyCount(0),
+    m_current(FPP_OTHER),
+    m_phaseStartNS(0),
+    m_inFrame(false),
+    m_enabled(false),
+    m_budgetUS(16667)
+{
+  clear();
+}
+
+
+void FrameProfiler::clear()
+{
+  std::memset(m_historyUS, 0, sizeof(m_historyUS));
+  std::memset(m_frameNS, 0, sizeof(m_frameNS));
+  m_nextSlot = 0;
+  m_historyCount = 0;
+}
+
+
+void FrameProfiler::beginFrame()
+{
+  if (!m_enabled) {
+    return;
+  }
+
+  std::memset(m_frameNS, 0, sizeof(m_frameNS));
+  m_current = FPP_OTHER;
+  m_phaseStartNS = nowNS();
+  m_inFrame = true;
+}
+
+
+void FrameProfiler::endFrame()
+{
+  if (!m_inFrame) {
+    return;
+  }
+  charge();
+  m_inFrame = false;
+
+  for (int p=0; p < NUM_FRAME_PROFILER_PHASES; ++p) {
+    m_historyUS[p][m_nextSlot] = m_frameNS[p] / 1000.0f;
+  }
+  m_nextSlot = (m_nextSlot + 1) % HISTORY_FRAMES;
+  if (m_historyCount < HISTORY_FRAMES) {
+    m_historyCount++;
+  }
+}
+
+
+float FrameProfiler::averageUS(FrameProfilerPhase phase) const
+{
+  if (m_historyCount == 0) {
+    return 0;
+  }
+
+  // Unfilled slots are zero, so they do not affect the sum.
+  float sum = 0;
+  for (int i=0; i < HISTORY_FRAMES; ++i) {
+    sum += m_historyUS[phase][i];
+  }
+  return sum / m_historyCount;
+}
+
+
+float FrameProfiler::maxUS(FrameProfilerPhase phase) const
+{
+  float ret = 0;
+  for (int i=0; i < HISTORY_FRAMES; ++i) {
+    if (m_historyUS[phase][i] > ret) {
+      ret = m_historyUS[phase][i];
+    }
+  }
+  return ret;
+}
+
+
+float FrameProfiler::frameAverageUS() const
+{
+  float ret = 0;
+  for (int p=0; p < NUM_FRAME_PROFILER_PHASES; ++p) {
+    ret += averageUS((FrameProfilerPhase)p);
+  }
+  return ret;
+}
+
+
+// EOF
@@ -0,0 +1,187 @@
+// frame-profiler.h
+// `FrameProfiler`, which times the phases of drawing a frame.
+
+// See license.txt for copyright and terms of use.
+
+// The painter marks each of its drawing routines with
+// `FRAME_PROFILE_SCOPE`.  While the profiler is enabled, the time of
+// each frame is split among the phases, exclusively (time in a nested
+// phase, such as text drawn by the parry timer, is not also charged to
+// the outer one), and anything not in a phase goes to `FPP_OTHER`.
+//
+// When the profiler is disabled, a scope costs one well-predicted
+// branch.  Building with `GPV_FRAME_PROFILER` defined as 0 removes the
+// scopes entirely.
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <chrono>                      // std::chrono
+#include <cstdint>                     // std::uint64_t
+
+
+#ifndef GPV_FRAME_PROFILER
+  #define GPV_FRAME_PROFILER 1
+#endif
+
+
+// The parts of a frame that are timed separately.
+enum FrameProfilerPhase {
+  FPP_OTHER,                 // Anything not in another phase.
+  FPP_DEBUG_TEXT,            // The text display (`S` key).
+  FPP_ROUND_BUTTONS,         // `drawRoundButtons`.
+  FPP_DPAD_BUTTONS,          // `drawDPadButtons`.
+  FPP_SHOULDER_BUTTONS,      // `drawShoulderButtons`.
+  FPP_PARRY_TIMER,           // `drawParryTimer`.
+  FPP_STICKS,                // `drawStick`.
+  FPP_TEXT,                  // `drawTextWithBackground`.
+  FPP_OVERLAY,               // The profiler's own overlay.
+
+  NUM_FRAME_PROFILER_PHASES
+};
+
+// Return a short name for `phase`, like "sticks".
+char const *toString(FrameProfilerPhase phase);
+
+
+class FrameProfiler {
+public:      // types
+  enum {
+    // Number of frames the averages and maxima cover.
+    HISTORY_FRAMES = 64,
+  };
+
+private:     // data
+  // Microseconds spent in each phase in each of the last
+  // `HISTORY_FRAMES` frames, and the slot for the next frame.
+  float m_historyUS[NUM_FRAME_PROFILER_PHASES][HISTORY_FRAMES];
+  int m_nextSlot;
+
+  // Number of slots filled, up to `HISTORY_FRAMES`.
+  int m_historyCount;
+
+  // Accumulated time of each phase in the current frame.
+  std::uint64_t m_frameNS[NUM_FRAME_PROFILER_PHASES];
+
+  // Phase being timed, and when it was entered or resumed.
+  FrameProfilerPhase m_current;
+  std::uint64_t m_phaseStartNS;
+
+  // True between `beginFrame` and `endFrame`.
+  bool m_inFrame;
+
+public:      // data
+  // True to time frames.  Only change this between frames.
+  bool m_enabled;
+
+  // Time available for a frame, for the width of the overlay bar.
+  float m_budgetUS;
+
+private:     // methods
+  static std::uint64_t nowNS()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Charge the time since `m_phaseStartNS` to `m_current` and restart
+  // the clock.
+  void charge()
+  {
+    std::uint64_t now = nowNS();
+    m_frameNS[m_current] += now - m_phaseStartNS;
+    m_phaseStartNS = now;
+  }
+
+public:      // methods
+  FrameProfiler();
+
+  // True if built with the profiler.
+  static bool compiledIn()
+    { return GPV_FRAME_PROFILER != 0; }
+
+  // True if phases are being timed right now.
+  bool timing() const
+    { return m_inFrame; }
+
+  // Forget the history.
+  void clear();
+
+  // Bracket the drawing of one frame.  These do nothing if disabled.
+  void beginFrame();
+  void endFrame();
+
+  // Switch to timing `phase`, returning the phase to give to `leave`.
+  // Only call while `timing()`.
+  FrameProfilerPhase enter(FrameProfilerPhase phase)
+  {
+    charge();
+    FrameProfilerPhase prev = m_current;
+    m_current = phase;
+    return prev;
+  }
+
+  // Go back to timing `prev`.
+  void leave(FrameProfilerPhase prev)
+  {
+    charge();
+    m_current = prev;
+  }
+
+  // Number of frames in the history.
+  int historyCount() const
+    { return m_historyCount; }
+
+  // Average and largest microseconds spent in `phase` per frame over
+  // the history, or 0 if it is empty.
+  float averageUS(FrameProfilerPhase phase) const;
+  float maxUS(FrameProfilerPhase phase) const;
+
+  // Average microseconds per frame over all phases.
+  float frameAverageUS() const;
+};
+
+
+// Times `phase` for as long as it is in scope, if `profiler` is not
+// null and is timing.
+class FrameProfilerScope {
+private:     // data
+  // Profiler being charged, or null if not timing.
+  FrameProfiler *m_profiler;
+
+  // Phase to return to.
+  FrameProfilerPhase m_prev;
+
+public:      // methods
+  FrameProfilerScope(FrameProfiler *profiler, FrameProfilerPhase phase)
+    : m_profiler(nullptr),
+      m_prev(FPP_OTHER)
+  {
+    if (profiler && profiler->timing()) {
+      m_profiler = profiler;
+      m_prev = profiler->enter(phase);
+    }
+  }
+
+  ~FrameProfilerScope()
+  {
+    if (m_profiler) {
+      m_profiler->leave(m_prev);
+    }
+  }
+
+  FrameProfilerScope(FrameProfilerScope const &) = delete;
+  void operator=(FrameProfilerScope const &) = delete;
+};
+
+
+// Time the rest of the enclosing block as `phase` of `profiler`.
+#if GPV_FRAME_PROFILER
+  #define FRAME_PROFILE_SCOPE(profiler, phase) \
+    FrameProfilerScope frameProfilerScope((profiler), (phase))
+#else
+  #define FRAME_PROFILE_SCOPE(profiler, phase) ((void)0)
+#endif
+
+
+#endif // FRAME_PROFILER_H
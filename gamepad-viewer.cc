@@ -5,6 +5,9 @@
 
 #include "gamepad-viewer.h"            // this module
 
+#include "alloc-audit.h"               // AllocAuditScope, allocAuditCompiledIn
+#include "text-format.h"               // appendFormat
+#include "trace-ring.h"                // traceEvent, traceRingInit, etc.
 #include "winapi-util.h"               // getLastErrorMessage, CreateWindowExWArgs, toWideString
 
 #include <d2d1.h>                      // Direct2D
@@ -15,17 +18,14 @@
 
 #include <algorithm>                   // std::min
 #include <cassert>                     // assert
-#include <cmath>                       // std::{cos, sin, atan2, sqrt}
+#include <chrono>                      // std::chrono
+#include <cstdio>                      // std::snprintf
 #include <cstdlib>                     // std::{getenv, atoi}
 #include <cstring>                     // std::memset
 #include <filesystem>                  // std::filesystem
 #include <iomanip>                     // std::{dec, hex}
 #include <iostream>                    // std::{wcerr, flush}
-#include <sstream>                     // std::wostringstream
-
-
-// This should go someplace else...
-float const c_pi = 3.1415926535897932384626433832795;
+#include <sstream>                     // std::ostringstream
 
 
 // Level of diagnostics to print.
@@ -48,6 +48,86 @@ int g_tracingLevel = 1;
 bool g_useTransparency = true;
 
 
+// True to draw the parts of the display that do not depend on the
+// controller input once, into a cached layer, rather than every frame.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+bool g_useStaticLayer = true;
+
+
+// True to draw with the portable CPU rasterizer instead of D2D.  This
+// is mainly for checking that the two produce the same picture.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+bool g_useCpuRaster = false;
+
+
+// If positive, instead of polling the controller, generate this many
+// synthetic input samples per poll.  This is for measuring how the
+// display keeps up with high-rate input.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+int g_syntheticInputSamplesPerPoll = 0;
+
+
+// True to reuse DirectWrite text layouts across frames.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+bool g_useTextLayoutCache = true;
+
+
+// How to watch the configuration file for edits: 0 to not watch it, 1
+// for OS change notifications, and 2 for polling.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+int g_configWatchMode = 1;
+
+
+// Minimum milliseconds between background saves of the configuration
+// file.  If 0 or negative, it is only saved on exit.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+int g_configSaveDelayMS = 1000;
+
+
+// True to write trace dumps in the Chrome trace-event JSON format,
+// including one on exit, rather than as text only on request.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+bool g_traceChromeJSON = false;
+
+
+// If not empty, the name of the shared-memory region to publish the
+// input and timer state to.  See shared-input.h.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+std::string g_publishInputName;
+
+
+// If not empty, the path of the socket to send input events on.  See
+// event-stream.h.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+std::string g_eventStreamPath;
+
+
+// Minutes of input to keep in the replay buffer, or 0 to not keep any.
+// See replay-buffer.h.
+//
+// The default value is not used, as `wWinMain` overwrites it.
+//
+int g_replayBufferMinutes = 5;
+
+
 // Write a diagnostic message.
 #define TRACE(level, msg)           \
   if (g_tracingLevel >= (level)) {  \
@@ -73,6 +153,12 @@ enum {
   IDM_TOGGLE_PARRY_ACCURACY_TEXT,
   IDM_TOGGLE_PARRY_TIME_TEXT,
   IDM_TOGGLE_DODGE_INVULNERABILITY_TIMER,
+  IDM_TOGGLE_RECORDING,
+  IDM_SAVE_REPLAY,
+  IDM_NEXT_PROFILE,
+  IDM_CALIBRATE,
+  IDM_DUMP_TRACE,
+  IDM_TOGGLE_FRAME_PROFILER,
   IDM_CONTROLLER_0,
   IDM_CONTROLLER_1,
   IDM_CONTROLLER_2,
@@ -86,9 +172,11 @@ enum {
 // Timer identifiers.
 enum {
   IDT_POLL_CONTROLLER = 1,
+  IDT_PRESENT,
 };
 
 
+// --------------------------- GVMainWindow ----------------------------
 GVMainWindow::GVMainWindow()
   : m_d2dFactory(nullptr),
     m_writeFactory(nullptr),
@@ -101,17 +189,68 @@ GVMainWindow::GVMainWindow()
     m_highlightBrush(nullptr),
     m_parryActiveBrush(nullptr),
     m_parryInactiveBrush(nullptr),
+    m_textBackgroundBrush(nullptr),
+    m_dodgeActiveBrush(nullptr),
+    m_dodgeInactiveBrush(nullptr),
+    m_staticLayerTarget(nullptr),
+    m_staticLayerKey(),
     m_config(),
-    m_controllerState(),
-    m_prevControllerState(),
-    m_parryTimer(),
-    m_dodgeReleaseTimer(),
-    m_dodgeInvulnerabilityTimer(),
+    m_configWatcher(),
+    m_configPersister(),
+    m_submittedConfig(),
+    m_inputModel(&m_config),
+    m_presentedModel(&m_config),
+    m_inputPublisher(),
+    m_eventStream(),
+    m_eventDetector(),
+    m_inputLatch(),
+    m_redrawPending(true),
+    m_presentIntervalMS(16),
+    m_syntheticInput(),
+    m_sampleRate(),
+    m_pollRate(),
+    m_paintRate(),
+    m_paintTime(),
+    m_pollAllocs(),
+    m_paintAllocs(),
+    m_inputArrivalUS(0),
+    m_frameInputUS(0),
+    m_lastPresentedInputUS(0),
+    m_invalidateLatency(),
+    m_drawLatency(),
+    m_sessionStartUS(steadyClockUS()),
+    m_textLayoutCache(32 /*capacity*/),
+    m_d2dCanvas(),
+    m_painter(&m_config, &m_presentedModel),
+    m_frameProfiler(),
+    m_rasterPainter(&m_config, &m_presentedModel),
+    m_rasterFrame(),
+    m_rasterBGRA(),
+    m_framePrimitiveCount(0),
+    m_staticLayerPrimitiveCount(0),
+    m_shownProfileName(),
+    m_shownProfileNameWide(),
+    m_recordingFile(),
+    m_recorder(),
+    m_recordingFilename(),
+    m_recordedConfig(),
+    m_replayBuffer(),
+    m_calibrator(),
+    m_calibrationForcedText(false),
+    m_driftTracker(60000 /*intervalMS*/),
     m_lastDragPoint{},
     m_movingWindow(false),
     m_lastShownControllerID(-1)
 {
-  loadConfiguration();
+  m_painter.m_profiler = &m_frameProfiler;
+  m_rasterPainter.m_painter.m_profiler = &m_frameProfiler;
+
+  bool loaded = loadConfiguration();
+  startConfigPersister(loaded);
+  startConfigWatcher();
+  startInputPublisher();
+  startEventStream();
+  startReplayBuffer();
 }
 
 
@@ -128,25 +267,7 @@ void GVMainWindow::createDeviceIndependentResources()
     reinterpret_cast<IUnknown **>(&m_writeFactory));
   assert(m_writeFactory);
 
-  CALL_HR_WINAPI(m_writeFactory->CreateTextFormat,
-    L"Verdana",                        // fontFamilyName
-    nullptr,                           // fontCollection
-    DWRITE_FONT_WEIGHT_NORMAL,         // fontWeight
-    DWRITE_FONT_STYLE_NORMAL,          // fontStyle
-    DWRITE_FONT_STRETCH_NORMAL,        // fontStretch
-    lp().m_textFontSizeDIPs,           // fontSize
-    L"",                               // localeName
-    &m_textFormat                      // textFormat
-  );
-  assert(m_textFormat);
-
-  if (false) {
-    // Center text horizontally and vertically.
-    CALL_HR_WINAPI(m_textFormat->SetTextAlignment,
-      DWRITE_TEXT_ALIGNMENT_CENTER);
-    CALL_HR_WINAPI(m_textFormat->SetParagraphAlignment,
-      DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
-  }
+  createTextFormat();
 
   // Make a stroke style that has a fixed width, thereby avoiding the
   // effects of coordinate transformations.
@@ -177,8 +298,33 @@ void GVMainWindow::createDeviceIndependentResources()
 }
 
 
+void GVMainWindow::createTextFormat()
+{
+  CALL_HR_WINAPI(m_writeFactory->CreateTextFormat,
+    L"Verdana",                        // fontFamilyName
+    nullptr,                           // fontCollection
+    DWRITE_FONT_WEIGHT_NORMAL,         // fontWeight
+    DWRITE_FONT_STYLE_NORMAL,          // fontStyle
+    DWRITE_FONT_STRETCH_NORMAL,        // fontStretch
+    lp().m_textFontSizeDIPs,           // fontSize
+    L"",                               // localeName
+    &m_textFormat                      // textFormat
+  );
+  assert(m_textFormat);
+
+  if (false) {
+    // Center text horizontally and vertically.
+    CALL_HR_WINAPI(m_textFormat->SetTextAlignment,
+      DWRITE_TEXT_ALIGNMENT_CENTER);
+    CALL_HR_WINAPI(m_textFormat->SetParagraphAlignment,
+      DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+  }
+}
+
+
 void GVMainWindow::destroyDeviceIndependentResources()
 {
+  m_textLayoutCache.clear();
   safeRelease(m_d2dFactory);
   safeRelease(m_writeFactory);
   safeRelease(m_textFormat);
@@ -188,281 +334,169 @@ void GVMainWindow::destroyDeviceIndependentResources()
 }
 
 
-void GVMainWindow::pollControllerState()
-{
-  m_prevControllerState = m_controllerState;
-  m_controllerState.poll(m_config.m_controllerID);
-
-  // Possibly expire the timers.
-  m_parryTimer.possiblyExpire(
-    m_controllerState.m_pollTimeMS,
-    m_config.m_parryTimer.m_durationMS);
-  m_dodgeReleaseTimer.possiblyExpire(
-    m_controllerState.m_pollTimeMS,
-    m_config.m_dodgeReleaseTimerDurationMS);
-  m_dodgeInvulnerabilityTimer.possiblyExpire(
-    m_controllerState.m_pollTimeMS,
-    m_config.m_dodgeInvulnerabilityTimer.m_durationMS,
-    m_config.m_dodgeInvulnerabilityTimer.m_activeStartMS);
-
-  // Possibly start the timers.
-  if (m_prevControllerState.m_hasInputState &&
-      m_controllerState.m_hasInputState) {
-    // Parry timer.
-    bool const leftSide = true;
-    AnalogThresholdConfig const &atConfig = m_config.m_analogThresholds;
-    if (!m_parryTimer.isRunning() &&
-        !m_prevControllerState.isTriggerPressed(atConfig, leftSide) &&
-        m_controllerState.isTriggerPressed(atConfig, leftSide))
-    {
-      // Upon pressing L2, start the timer.
-      m_parryTimer.startTimer(m_controllerState.m_pollTimeMS);
-    }
-
-    // Upon *releasing* B/Circle, start the dodge timer.
-    if (m_prevControllerState.isButtonPressed(XINPUT_GAMEPAD_B) &&
-        !m_controllerState.isButtonPressed(XINPUT_GAMEPAD_B))
-    {
-      // One timer simply tracks releasing the button.
-      if (!m_dodgeReleaseTimer.isRunning()) {
-        m_dodgeReleaseTimer.startTimer(m_controllerState.m_pollTimeMS);
-      }
+// The button timers of `InputModel`, in the order their index appears
+// in `TE_TIMER_START` and `TE_TIMER_EXPIRE` records.
+static ButtonTimer InputModel::* const s_tracedTimers[] = {
+  &InputModel::m_parryTimer,
+  &InputModel::m_dodgeReleaseTimer,
+  &InputModel::m_dodgeInvulnerabilityTimer,
+};
 
-      // Another tracks the full lifecycle of invulnerability.
-      m_dodgeInvulnerabilityTimer.startOrEnqueueTimer(
-        m_controllerState.m_pollTimeMS);
-    }
-  }
-}
+int const NUM_TRACED_TIMERS =
+  sizeof(s_tracedTimers) / sizeof(s_tracedTimers[0]);
 
 
-bool GVMainWindow::isAnyButtonTimerRunning() const
+// Record the button timers of `model` that started or expired since
+// they were `prevTimers`.
+static void traceTimerChanges(InputModel const &model,
+                              ButtonTimer const *prevTimers)
 {
-  return m_parryTimer.isRunning() ||
-         m_dodgeReleaseTimer.isRunning() ||
-         m_dodgeInvulnerabilityTimer.isRunning();
-}
-
+  for (int t=0; t < NUM_TRACED_TIMERS; ++t) {
+    ButtonTimer const &prev = prevTimers[t];
+    ButtonTimer const &cur = model.*s_tracedTimers[t];
 
-XINPUT_STATE const &GVMainWindow::inputState() const
-{
-  return m_controllerState.m_inputState;
+    // A queued run restarts the timer without it ever stopping.
+    if (cur.m_running &&
+        (!prev.m_running || cur.m_startMS != prev.m_startMS)) {
+      traceEvent(TE_TIMER_START, t, (std::int32_t)cur.m_startMS);
+    }
+    else if (prev.m_running && !cur.m_running) {
+      traceEvent(TE_TIMER_EXPIRE, t);
+    }
+  }
 }
 
 
-// Convert a number of milliseconds into a frame count (at 30 FPS).
-static int msToFrames(int ms)
+void GVMainWindow::pollControllerState()
 {
-  // If we happen to press the button at the moment the active window
-  // starts, call that part of frame 1.  (In practice, this never
-  // happens, due to the granularity of the timer.)
-  if (ms == 0) {
-    ms = 1;
-  }
+  traceEvent(TE_POLL_BEGIN);
+  int numSamples = std::max(g_syntheticInputSamplesPerPoll, 1);
 
-  // There are 30 frames in 1000 milliseconds, and we want to round up.
-  return (ms * 30 + 999) / 1000;
-}
+  for (int i=0; i < numSamples; ++i) {
+    ControllerState newState;
+    if (g_syntheticInputSamplesPerPoll > 0) {
+      m_syntheticInput.next(newState, GetTickCount());
+      newState.m_pollTimeUS = steadyClockUS();
+    }
+    else {
+      newState.poll(m_config.m_controllerID);
+      m_driftTracker.add(m_config.m_controllerID, newState,
+                         m_config.m_analogThresholds);
+    }
 
+    if (newState.m_inputState.dwPacketNumber !=
+          m_inputModel.inputState().dwPacketNumber) {
+      m_inputArrivalUS = newState.m_pollTimeUS;
+    }
 
-namespace {
-  // Classification of the current time in comparison to the active time
-  // window of a button press effect.
-  enum ButtonWindowState {
-    BWS_BEFORE,              // Before active window.
-    BWS_ACTIVE,              // In active window.
-    BWS_AFTER,               // After active window.
-  };
-}
+    ButtonTimer prevTimers[NUM_TRACED_TIMERS];
+    for (int t=0; t < NUM_TRACED_TIMERS; ++t) {
+      prevTimers[t] = m_inputModel.*s_tracedTimers[t];
+    }
+    m_inputModel.update(newState);
+    traceTimerChanges(m_inputModel, prevTimers);
 
+    if (m_inputPublisher.isOpen()) {
+      publishInputState();
+    }
+    if (m_eventStream) {
+      publishInputEvents();
+    }
 
-// Classify a button press `elapsedMS` ago relative to the active
-// window described by `config`.
-//
-// In the case of BWS_BEFORE, set `frameDelta` to the number of frames
-// (at 30 FPS) by which the press was too late.
-//
-// In the case of BWS_ACTIVE, set `frameDelta` to the the frame number
-// on which the button was pressed, from among those that would have
-// also led to a successful action.  Frame 1 is the first in the window,
-// meaning the button was pressed on the last possible frame.  In this
-// case, also set `maxFrame` to the maximum value that would have led to
-// a successful action (which corresponds to the first possible frame on
-// which the button could have been pressed).
-//
-// In the case of BWS_AFTER, set `frameDelta` to the number of frames
-// by which the press was too early.
-//
-static ButtonWindowState getButtonWindowState(
-  ButtonTimerConfig const &config,
-  int elapsedMS,
-  int &frameDelta /*OUT*/,
-  int &maxFrame /*OUT*/)
-{
-  // Meaningless value for cases other than BWS_ACTIVE.
-  maxFrame = 0;
+    if (m_calibrator.addSample(newState)) {
+      finishCalibration();
+    }
 
-  if (elapsedMS < config.m_activeStartMS) {
-    // The active window has not yet started.
-    frameDelta = msToFrames(config.m_activeStartMS - elapsedMS);
-    return BWS_BEFORE;
-  }
+    // Remember presses even if released before the next present.
+    m_inputLatch.add(newState);
 
-  else if (elapsedMS > config.m_activeEndMS) {
-    // The active window has already ended.
-    frameDelta = msToFrames(elapsedMS - config.m_activeEndMS);
-    return BWS_AFTER;
-  }
+    if (m_recorder) {
+      m_recorder->writeSample(newState);
+      if (!m_recorder->ok()) {
+        TRACE1(toWideString(m_recordingFilename + ": write failed"));
+        stopRecording();
+        m_redrawPending = true;
+      }
+    }
 
-  else {
-    // We are within the active window.
-    frameDelta = msToFrames(elapsedMS - config.m_activeStartMS);
-    maxFrame = msToFrames(config.m_activeEndMS - config.m_activeStartMS);
-    return BWS_ACTIVE;
+    if (m_replayBuffer.isOpen()) {
+      m_replayBuffer.add(newState);
+    }
   }
-}
 
-
-// True if we are in the active phase of the button described by
-// `config`.
-static bool isButtonActive(
-  ButtonTimerConfig const &config,
-  int elapsedMS)
-{
-  int frameDelta;
-  int maxFrame;
-  ButtonWindowState bws =
-    getButtonWindowState(config, elapsedMS, frameDelta, maxFrame);
-  return bws == BWS_ACTIVE;
+  m_sampleRate.add(GetTickCount(), numSamples);
+  traceEvent(TE_POLL, numSamples,
+    m_inputModel.inputState().dwPacketNumber,
+    m_inputModel.inputState().Gamepad.wButtons);
 }
 
 
-DWORD GVMainWindow::dodgeInvulnerabilityTimerElapsedMS() const
+int GVMainWindow::getDisplayRefreshHz() const
 {
-  return m_dodgeInvulnerabilityTimer.elapsedMS(
-    m_controllerState.m_pollTimeMS);
-}
-
+  HDC hdc = GetDC(m_hwnd);
+  int hz = GetDeviceCaps(hdc, VREFRESH);
+  ReleaseDC(m_hwnd, hdc);
 
-bool GVMainWindow::isDodgeInvulnerabilityActive() const
-{
-  if (m_dodgeInvulnerabilityTimer.isRunning()) {
-    return isButtonActive(
-      m_config.m_dodgeInvulnerabilityTimer,
-      (int)dodgeInvulnerabilityTimerElapsedMS());
-  }
-  else {
-    return false;
+  // 0 and 1 mean the hardware default, which is not otherwise known.
+  if (hz <= 1) {
+    hz = 60;
   }
+  return hz;
 }
 
 
-DWORD GVMainWindow::parryTimerElapsedMS() const
-{
-  return m_parryTimer.elapsedMS(m_controllerState.m_pollTimeMS);
-}
-
-
-bool GVMainWindow::isParryActive() const
+void GVMainWindow::startTimers()
 {
-  if (m_parryTimer.isRunning()) {
-    return isButtonActive(
-      m_config.m_parryTimer,
-      (int)parryTimerElapsedMS());
+  UINT_PTR id =
+    SetTimer(m_hwnd, IDT_POLL_CONTROLLER,
+             m_config.m_pollingIntervalMS, nullptr /*proc*/);
+  if (!id) {
+    winapiDie(L"SetTimer");
   }
-  else {
-    return false;
+  assert(id == IDT_POLL_CONTROLLER);
+
+  // Presenting runs on its own timer so that raising the poll rate
+  // does not raise the paint rate.  `SetTimer` rounds the interval up
+  // to the system timer resolution, typically 15.6 ms, so rates above
+  // about 64 FPS are not actually achieved.
+  int fps = m_config.m_presentFPS > 0?
+              m_config.m_presentFPS : getDisplayRefreshHz();
+  m_presentIntervalMS = std::max(1000 / fps, 1);
+  TRACE2(L"startTimers:" << TRVAL(fps) << TRVAL(m_presentIntervalMS));
+
+  id = SetTimer(m_hwnd, IDT_PRESENT,
+                m_presentIntervalMS, nullptr /*proc*/);
+  if (!id) {
+    winapiDie(L"SetTimer");
   }
+  assert(id == IDT_PRESENT);
 }
 
 
-std::wstring GVMainWindow::dodgeAccuracyString(bool &active /*OUT*/) const
+void GVMainWindow::present()
 {
-  int frameDelta;
-  int maxFrame;
-  ButtonWindowState bws = getButtonWindowState(
-    m_config.m_dodgeInvulnerabilityTimer,
-    (int)dodgeInvulnerabilityTimerElapsedMS(),
-    frameDelta,
-    maxFrame);
-
-  std::wostringstream oss;
-  active = false;
-
-  switch (bws) {
-    case BWS_BEFORE:
-      // The active window has not yet started, meaning the button was
-      // pressed, but the game has not yet registered it due to input lag.
-      oss << "L " << frameDelta;
-      break;
-
-    case BWS_AFTER:
-      // The active window has already ended, meaning the button was
-      // pressed too early, and we are in the recovery window.
-      oss << "R " << frameDelta;
-      break;
+  traceEvent(TE_PRESENT, m_inputLatch.m_buttons, m_inputLatch.m_leftTrigger,
+             m_inputLatch.m_rightTrigger);
+  m_presentedModel = m_inputModel;
 
-    case BWS_ACTIVE:
-      // We are within the active invulnerability window.
-      if (false) {
-        // This takes up a bit more space than I'd like.
-        oss << frameDelta << "/" << maxFrame;
-      }
-      else {
-        oss << "A " << frameDelta;
-      }
-      active = true;
-      break;
+  // Show the briefly pressed buttons and triggers now, and then, since
+  // they are not pressed anymore, redraw again next time to show them
+  // released.
+  m_redrawPending = m_inputLatch.applyTo(
+    m_presentedModel.m_controllerState, m_config.m_analogThresholds);
 
-    // No default provided, as cases are exhaustive.
-  }
+  m_lastShownControllerID = m_config.m_controllerID;
 
-  if (m_dodgeInvulnerabilityTimer.m_queued) {
-    oss << "+";
+  // Tag the frame with the arrival time of its input, if it is new.
+  if (m_inputArrivalUS != m_lastPresentedInputUS) {
+    m_frameInputUS = m_lastPresentedInputUS = m_inputArrivalUS;
+    m_invalidateLatency.add(steadyClockUS() - m_frameInputUS);
   }
-
-  return oss.str();
-}
-
-
-std::wstring GVMainWindow::parryAccuracyString() const
-{
-  int frameDelta;
-  int maxFrame;
-  ButtonWindowState bws = getButtonWindowState(
-    m_config.m_parryTimer,
-    (int)parryTimerElapsedMS(),
-    frameDelta,
-    maxFrame);
-
-  std::wostringstream oss;
-
-  switch (bws) {
-    case BWS_BEFORE:
-      // The active window has not yet started, meaning the button was
-      // pressed too late.
-      oss << frameDelta << " late";
-      break;
-
-    case BWS_AFTER:
-      // The active window has already ended, meaning the button was
-      // pressed too early.
-      oss << frameDelta << " early";
-      break;
-
-    case BWS_ACTIVE:
-      // We are within the active window, so report the frame number on
-      // which the button was pressed, from among those that would have
-      // also led to a successful parry.  Frame 1 is the first in the
-      // window, meaning the button was pressed on the last possible
-      // frame.
-      oss << frameDelta << " of " << maxFrame;
-      break;
-
-    // No default provided, as cases are exhaustive.
+  else {
+    m_frameInputUS = 0;
   }
 
-  return oss.str();
+  invalidateAllPixels();
 }
 
 
@@ -496,6 +530,8 @@ void GVMainWindow::createGraphicsResources()
 
 void GVMainWindow::destroyGraphicsResources()
 {
+  safeRelease(m_staticLayerTarget);
+  m_staticLayerKey = StaticLayerKey();
   safeRelease(m_renderTarget);
   destroyLinesBrushes();
 }
@@ -569,39 +605,60 @@ ID2D1SolidColorBrush *GVMainWindow::brushForColorRole(
   }
 }
 
+
 void GVMainWindow::onTimer(WPARAM wParam)
 {
   switch (wParam) {
     case IDT_POLL_CONTROLLER: {
-      DWORD prevPN = inputState().dwPacketNumber;
-      bool prevAnyButtonTimerRunning = isAnyButtonTimerRunning();
+      checkForConfigUpdate();
+      submitConfigIfChanged();
+      recordConfigIfChanged();
+      checkReplaySaved();
+
+      DWORD prevPN = m_inputModel.inputState().dwPacketNumber;
+      bool prevAnyButtonTimerRunning = m_inputModel.isAnyButtonTimerRunning();
 
-      pollControllerState();
+      {
+        AllocAuditScope audit;
+        pollControllerState();
+        if (allocAuditCompiledIn()) {
+          m_pollAllocs.add(GetTickCount(), (double)audit.count());
+        }
+      }
+      m_pollRate.add(GetTickCount());
+      logDrift();
 
       // Redraw if any of the following:
       if (
         // There is new controller data.
-        prevPN != inputState().dwPacketNumber ||
+        prevPN != m_inputModel.inputState().dwPacketNumber ||
 
         // The data is for a different controller.
         m_lastShownControllerID != m_config.m_controllerID ||
 
         // A button timer is currently running.
-        isAnyButtonTimerRunning() ||
+        m_inputModel.isAnyButtonTimerRunning() ||
 
         // A button timer was running on the previous update.  If it is
         // not now running, we need to redraw to remove its display.
-        prevAnyButtonTimerRunning
-      ) {
-        // Redraw to show the new state.
-        invalidateAllPixels();
+        prevAnyButtonTimerRunning ||
 
-        m_lastShownControllerID = m_config.m_controllerID;
+        // The calibration countdown is showing.
+        m_calibrator.isRunning()
+      ) {
+        // Redraw to show the new state at the next present.
+        m_redrawPending = true;
       }
 
       break;
     }
 
+    case IDT_PRESENT:
+      if (m_redrawPending) {
+        present();
+      }
+      break;
+
     default:
       // Ignore unknown timer IDs.
       break;
@@ -611,6 +668,45 @@ void GVMainWindow::onTimer(WPARAM wParam)
 
 void GVMainWindow::onPaint()
 {
+  traceEvent(TE_PAINT_BEGIN);
+  m_paintRate.add(GetTickCount());
+  auto startTime = std::chrono::steady_clock::now();
+  m_frameProfiler.m_budgetUS = m_presentIntervalMS * 1000.0f;
+  m_frameProfiler.beginFrame();
+  AllocAuditScope audit;
+
+  if (g_useCpuRaster) {
+    onPaintRaster();
+  }
+  else {
+    onPaintD2D();
+  }
+
+  if (allocAuditCompiledIn()) {
+    m_paintAllocs.add(GetTickCount(), (double)audit.count());
+  }
+  m_frameProfiler.endFrame();
+  std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - startTime;
+  m_paintTime.add(GetTickCount(), elapsed.count());
+
+  // `EndDraw` (or the raster blit) has returned, so the frame is done
+  // as far as we can tell.
+  std::uint64_t latencyUS = 0;
+  if (m_frameInputUS) {
+    latencyUS = steadyClockUS() - m_frameInputUS;
+    m_drawLatency.add(latencyUS);
+    m_frameInputUS = 0;
+  }
+
+  traceEvent(TE_PAINT, (int)(elapsed.count() * 1000),
+             m_framePrimitiveCount, g_useCpuRaster, (int)latencyUS);
+}
+
+
+void GVMainWindow::onPaintD2D()
+{
+
   createGraphicsResources();
 
   PAINTSTRUCT ps;
@@ -620,6 +716,10 @@ void GVMainWindow::onPaint()
   // The `hdc` is not further used because this function uses D2D
   // rather than GDI.
 
+  // Bring the static layer up to date first since drawing it is a
+  // separate `BeginDraw`/`EndDraw` sequence.
+  bool haveStaticLayer = g_useStaticLayer && updateD2DStaticLayer();
+
   m_renderTarget->BeginDraw();
 
   // Use a black background, which is then keyed as transparent.
@@ -628,10 +728,39 @@ void GVMainWindow::onPaint()
   // Reset the transform.
   m_renderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
 
-  // Draw the controller buttons, etc.
-  drawControllerState();
+  prepareD2DCanvas(m_renderTarget);
+  setPaintStatsText(haveStaticLayer);
+  D2D1_SIZE_F size = m_renderTarget->GetSize();
+
+  if (haveStaticLayer) {
+    ID2D1Bitmap *bitmap = nullptr;
+    CALL_HR_WINAPI(m_staticLayerTarget->GetBitmap, &bitmap);
+    SafeReleaseOnLeave releaseBitmap(bitmap);
+
+    // The layer has the same pixel size as the window, so there is no
+    // need for any filtering.
+    m_renderTarget->DrawBitmap(
+      bitmap,
+      D2D1::RectF(0, 0, size.width, size.height),
+      1.0f,                            // opacity
+      D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+    m_d2dCanvas.m_primitiveCount++;
+
+    // Draw the controller buttons, etc., that change.
+    m_painter.drawControllerState(PP_DYNAMIC,
+                                  Point2F(size.width, size.height));
+  }
+  else {
+    // Draw everything.
+    m_painter.drawControllerState(PP_ALL,
+                                  Point2F(size.width, size.height));
+  }
+
+  m_framePrimitiveCount = m_d2dCanvas.m_primitiveCount;
 
+  traceEvent(TE_END_DRAW_BEGIN);
   HRESULT hr = m_renderTarget->EndDraw();
+  traceEvent(TE_END_DRAW, (std::int32_t)hr);
   if (hr == HRESULT(D2DERR_RECREATE_TARGET)) {
     // This is a normal condition (but `FAILED(hr)` is still true) that
     // means the target device has become invalid.  Dispose of resources
@@ -647,722 +776,302 @@ void GVMainWindow::onPaint()
 }
 
 
-// Create a transformation matrix so that (0,0) is mapped to
-// (left,top) and (1,1) is mapped to (right,bottom).
-static D2D1_MATRIX_3X2_F focusArea(
-  float left,
-  float top,
-  float right,
-  float bottom)
+void GVMainWindow::onPaintRaster()
 {
-  return
-    D2D1::Matrix3x2F::Scale(right-left, bottom-top) *
-    D2D1::Matrix3x2F::Translation(left, top);
-}
+  PAINTSTRUCT ps;
+  HDC hdc;
+  CALL_HANDLE_WINAPI(hdc, BeginPaint, m_hwnd, &ps);
 
+  D2D1_SIZE_U size = getClientRectSizeU();
+  int w = size.width;
+  int h = size.height;
+  m_rasterFrame.resize(w, h);
+
+  m_rasterPainter.m_useStaticLayer = g_useStaticLayer;
+  setPaintStatsText(g_useStaticLayer);
+  m_rasterPainter.m_painter.m_extraDebugText =
+    m_painter.m_extraDebugText;
+  m_rasterPainter.paint(m_rasterFrame);
+  m_framePrimitiveCount = m_rasterPainter.m_framePrimitiveCount;
+  m_staticLayerPrimitiveCount =
+    m_rasterPainter.m_staticLayerPrimitiveCount;
+
+  // `SetDIBitsToDevice` wants BGRA byte order, whereas `RasterPixel`
+  // is RGBA, so swap red and blue.  Every pixel is opaque since the
+  // frame starts out opaque black.
+  m_rasterBGRA.resize(m_rasterFrame.m_pixels.size());
+  for (std::size_t i=0; i < m_rasterBGRA.size(); ++i) {
+    RasterPixel p = m_rasterFrame.m_pixels[i];
+    m_rasterBGRA[i] = (p & 0xFF00FF00) |
+                      ((p >> 16) & 0xFF) |
+                      ((p & 0xFF) << 16);
+  }
 
-// Create a transformation matrix centered on (x,y) with horizontal
-// radius `hr` and vertical radius `vr`.
-static D2D1_MATRIX_3X2_F focusPtHVR(
-  float x,
-  float y,
-  float hr,
-  float vr)
-{
-  return focusArea(x - hr, y - vr,
-                   x + hr, y + vr);
-}
+  BITMAPINFO bmi;
+  ZeroMemory(&bmi, sizeof(bmi));
+  bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+  bmi.bmiHeader.biWidth = w;
+  bmi.bmiHeader.biHeight = -h;         // Negative means top-down rows.
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+
+  if (w > 0 && h > 0) {
+    SetDIBitsToDevice(hdc,
+      0, 0, w, h,                      // Destination rectangle.
+      0, 0,                            // Source lower-left.
+      0, h,                            // First scan line, count.
+      m_rasterBGRA.data(),
+      &bmi,
+      DIB_RGB_COLORS);
+  }
 
-// Create a transformation matrix centered on (x,y) with square radius
-// `r`.
-static D2D1_MATRIX_3X2_F focusPtR(
-  float x,
-  float y,
-  float r)
-{
-  return focusPtHVR(x, y, r, r);
+  EndPaint(m_hwnd, &ps);
 }
 
 
-// Given a point (x,y) meant to be relative to `transform`, transform it
-// into screen pixel coordinates.
-static D2D1_POINT_2F transformPoint(
-  D2D1_MATRIX_3X2_F const &transform,
-  float x, float y)
+void GVMainWindow::prepareD2DCanvas(ID2D1RenderTarget *target)
 {
-  return
-    D2D1::Matrix3x2F::ReinterpretBaseType(&transform)->
-      TransformPoint(D2D1_POINT_2F{x, y});
+  m_d2dCanvas.m_renderTarget = target;
+  for (int i=0; i < NUM_GV_COLOR_ROLES; ++i) {
+    m_d2dCanvas.m_brushes[i] = brushForColorRole((GVColorRole)i);
+  }
+  m_d2dCanvas.m_textBrush = m_textBrush;
+  m_d2dCanvas.m_writeFactory = m_writeFactory;
+  m_d2dCanvas.m_textFormat = m_textFormat;
+  m_d2dCanvas.m_strokeStyle = m_strokeStyleFixedThickness;
+
+  if (g_useTextLayoutCache) {
+    // Cached layouts are only valid for the format and DPI they were
+    // made with.  The format's font size is checked too, in case the
+    // format gets recreated with a different `m_textFontSizeDIPs`.
+    float dpiX, dpiY;
+    target->GetDpi(&dpiX, &dpiY);
+    m_textLayoutCache.setContext(m_textFormat, dpiX, dpiY);
+    m_d2dCanvas.m_textLayoutCache = &m_textLayoutCache;
+  }
+  else {
+    m_d2dCanvas.m_textLayoutCache = nullptr;
+  }
+  m_d2dCanvas.resetPrimitiveCount();
+
+  m_painter.m_canvas = &m_d2dCanvas;
 }
 
 
-void GVMainWindow::drawControllerState()
+bool GVMainWindow::updateD2DStaticLayer()
 {
-  D2D1_SIZE_F renderTargetSize = m_renderTarget->GetSize();
-
-  if (m_config.m_showText) {
-    std::wostringstream oss;
+  D2D1_SIZE_U pixelSize = m_renderTarget->GetPixelSize();
+  StaticLayerKey key(pixelSize.width, pixelSize.height, m_config);
+  if (m_staticLayerTarget && key == m_staticLayerKey) {
+    return true;
+  }
 
-    XINPUT_STATE const &i = inputState();
-    XINPUT_GAMEPAD const &g = i.Gamepad;
+  TRACE2(L"updateD2DStaticLayer: size=(" << pixelSize.width <<
+         L"x" << pixelSize.height << L")");
 
-    oss << L"controllerID: " << m_config.m_controllerID << L"\n";
-    oss << L"hasState: " << m_controllerState.m_hasInputState << L"\n";
-    oss << L"packet: " << i.dwPacketNumber << L"\n";
-    oss << L"buttons: " << std::hex << g.wButtons << std::dec << L"\n";
-    oss << L"leftTrigger: " << +g.bLeftTrigger << L"\n";
-    oss << L"rightTrigger: " << +g.bRightTrigger << L"\n";
-    oss << L"thumbLX: " << g.sThumbLX << L"\n";
-    oss << L"thumbLY: " << g.sThumbLY << L"\n";
-    oss << L"thumbRX: " << g.sThumbRX << L"\n";
-    oss << L"thumbRY: " << g.sThumbRY << L"\n";
-    oss << L"parryElapsedMS: " << parryTimerElapsedMS() << L"\n";
-    oss << L"dodgeElapsedMS: " << dodgeInvulnerabilityTimerElapsedMS() << L"\n";
+  safeRelease(m_staticLayerTarget);
+  m_staticLayerKey = StaticLayerKey();
 
-    std::wstring s = oss.str();
-    m_renderTarget->DrawText(
-      s.data(),
-      s.size(),
-      m_textFormat,
-      D2D1::RectF(150, 10, renderTargetSize.width, renderTargetSize.height),
-      m_textBrush);
+  if (!( pixelSize.width > 0 && pixelSize.height > 0 )) {
+    return false;
   }
 
-  if (!( renderTargetSize.width > 0 && renderTargetSize.height > 0 )) {
-    // Bail if the sizes are zero.
-    return;
+  // Match both the DIP and pixel sizes of the window so the layer maps
+  // one to one onto it.  The layer is transparent except where drawn,
+  // so it gets the default premultiplied alpha format.
+  D2D1_SIZE_F size = m_renderTarget->GetSize();
+  CALL_HR_WINAPI(m_renderTarget->CreateCompatibleRenderTarget,
+    &size,
+    &pixelSize,
+    nullptr,                           // desiredFormat
+    D2D1_COMPATIBLE_RENDER_TARGET_OPTIONS_NONE,
+    &m_staticLayerTarget);
+  assert(m_staticLayerTarget);
+
+  m_staticLayerTarget->BeginDraw();
+  m_staticLayerTarget->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+
+  prepareD2DCanvas(m_staticLayerTarget);
+  m_painter.drawControllerState(PP_STATIC,
+                                Point2F(size.width, size.height));
+  m_staticLayerPrimitiveCount = m_d2dCanvas.m_primitiveCount;
+
+  HRESULT hr = m_staticLayerTarget->EndDraw();
+  if (FAILED(hr)) {
+    // Most likely `D2DERR_RECREATE_TARGET`, which the main target will
+    // report too.  Either way, just draw without the layer this time.
+    TRACE1(L"updateD2DStaticLayer: EndDraw failed: " << std::hex <<
+           hr << std::dec);
+    safeRelease(m_staticLayerTarget);
+    return false;
   }
 
-  // Create a coordinate system where the upper-left is (0,0) and the
-  // lower-right is (1,1).
-  D2D1_MATRIX_3X2_F baseTransform =
-    D2D1::Matrix3x2F::Scale(renderTargetSize.width, renderTargetSize.height);
-
-  // Draw the round buttons.
-  drawRoundButtons(
-    focusPtR(1.0 - lp().m_faceButtonsR, lp().m_faceButtonsY, lp().m_faceButtonsR) *
-    baseTransform);
-
-  // Draw the dpad.
-  drawDPadButtons(
-    focusPtR(lp().m_faceButtonsR, lp().m_faceButtonsY, lp().m_faceButtonsR) *
-    baseTransform);
-
-  // Draw the shoulder buttons.
-  drawShoulderButtons(
-    focusPtR(lp().m_shoulderButtonsX, lp().m_shoulderButtonsR, lp().m_shoulderButtonsR) * baseTransform,
-    true /*left*/);
-  drawShoulderButtons(
-    focusPtR(1.0 - lp().m_shoulderButtonsX, lp().m_shoulderButtonsR, lp().m_shoulderButtonsR) * baseTransform,
-    false /*left*/);
-
-  // Draw the parry timer.
-  if (m_parryTimer.isRunning()) {
-    // Compute a transform for the region of the timer.
-    D2D1_MATRIX_3X2_F parryTimerRegion =
-      focusPtHVR(lp().m_parryTimerX,  lp().m_parryTimerY,
-                 lp().m_parryTimerHR, lp().m_parryTimerVR) * baseTransform;
-
-    // Draw the main timer.
-    drawParryTimer(parryTimerRegion);
-
-    // Point to act as the upper-left corner of the next line of text to
-    // draw.  We start at the bottom-left corner of the parry timer
-    // region.  (We have to compute this manually because drawing text
-    // really only works with an identity transform active.)
-    D2D1_POINT_2F textCursor = transformPoint(
-      parryTimerRegion,
-      lp().m_parryElapsedTimeX,
-      lp().m_parryElapsedTimeY);
-
-    // With `TimeY` at 1.0, the meter and text overlap slightly, so push
-    // the text down slightly.
-    textCursor.y += 2;
-
-    if (m_config.m_parryTimer.m_showAccuracy) {
-      // Paint a background beneath the text to ensure it can be
-      // reliably read.  (Prior to adding the background, I've had cases
-      // where I could not read it in a game play recording due to the
-      // combination of low-contrast background and video compression
-      // effects.)
-      drawTextWithBackground(parryAccuracyString(),
-                             textCursor, GVCR_TEXT_BACKGROUND);
-
-      // Move the cursor down before drawing the next line.
-      textCursor.y += 22;
-    }
+  m_staticLayerKey = key;
+  return true;
+}
 
-    if (m_config.m_parryTimer.m_showElapsedTime) {
-      // Elapsed time as a string.
-      std::wostringstream oss;
-      oss << parryTimerElapsedMS();
-      std::wstring s = oss.str();
 
-      drawTextWithBackground(s, textCursor, GVCR_TEXT_BACKGROUND);
-    }
+void GVMainWindow::setPaintStatsText(bool usingStaticLayer)
+{
+  // This is rebuilt for every frame, so it is appended to the existing
+  // string, which does not allocate once that has grown to size.
+  std::wstring &s = m_painter.m_extraDebugText;
+  s.clear();
+  if (!m_config.m_showText) {
+    return;
   }
 
-  // Draw the sticks.
-  drawStick(
-    focusPtR(lp().m_stickR, 1.0 - lp().m_stickR, lp().m_stickR) * baseTransform,
-    true /*left*/);
-  drawStick(
-    focusPtR(1.0 - lp().m_stickR, 1.0 - lp().m_stickR, lp().m_stickR) * baseTransform,
-    false /*left*/);
-
-  // Draw the select and start buttons.
-  drawSelStartButton(
-    focusPtHVR(0.5 - lp().m_selStartX, lp().m_faceButtonsY,
-               lp().m_selStartHR,      lp().m_selStartVR)   * baseTransform,
-    true /*left*/);
-  drawSelStartButton(
-    focusPtHVR(0.5 + lp().m_selStartX, lp().m_faceButtonsY,
-               lp().m_selStartHR,      lp().m_selStartVR)   * baseTransform,
-    false /*left*/);
+  // These are from the previous frame since the current one is not
+  // done yet.
+  appendFormat(s, "primitives: %d", m_framePrimitiveCount);
+  if (usingStaticLayer) {
+    appendFormat(s, " (layer: %d)", m_staticLayerPrimitiveCount);
+  }
+  s += L'\n';
 
-  // Draw a central circle that could be considered to mimic the
-  // Playstation button, but in this app mostly functions as a larger
-  // place for the mouse to be clicked since the rest of the UI consists
-  // of thin lines that are hard to click.
-  drawCentralCircle(
-    focusPtR(0.5, lp().m_centralCircleY, lp().m_centralCircleR) * baseTransform);
+  if (m_recorder) {
+    appendFormat(s, "recording: %ld samples\n", m_recorder->m_sampleCount);
+  }
 
-  if (m_config.m_showDodgeInvulnerabilityTimer &&
-      m_dodgeInvulnerabilityTimer.isRunning()) {
-    D2D1_POINT_2F textCursor = transformPoint(
-      baseTransform,
-      lp().m_dodgeInvulnerabilityTimeX,
-      lp().m_dodgeInvulnerabilityTimeY);
+  // Rates over the last second.
+  appendFormat(s, "input: %d/s, polls: %d/s, frames: %d/s\n",
+    (int)m_sampleRate.m_rate,
+    (int)m_pollRate.m_rate,
+    (int)m_paintRate.m_rate);
 
-    bool active;
-    std::wstring s = dodgeAccuracyString(active /*OUT*/);
+  appendFormat(s, "paint: %.2f ms", m_paintTime.m_average);
+  if (!g_useCpuRaster && g_useTextLayoutCache) {
+    appendFormat(s, ", text layouts: %.1f%% hits",
+      m_textLayoutCache.hitRate() * 100);
+  }
+  s += L'\n';
 
-    drawTextWithBackground(s, textCursor,
-      active? GVCR_DODGE_ACTIVE : GVCR_DODGE_INACTIVE);
+  if (allocAuditCompiledIn()) {
+    appendFormat(s, "allocations: %.1f/poll, %.1f/paint\n",
+      m_pollAllocs.m_average, m_paintAllocs.m_average);
   }
-}
 
+  if (m_drawLatency.m_count) {
+    s += L"latency to invalidate: ";
+    m_invalidateLatency.appendSummary(s);
+    s += L"\nlatency to EndDraw: ";
+    m_drawLatency.appendSummary(s);
+    s += L'\n';
+  }
 
-void GVMainWindow::drawCircle(
-  D2D1_MATRIX_3X2_F transform,
-  bool fill)
-{
-  m_renderTarget->SetTransform(transform);
+  if (TimingProfile const *profile = m_config.activeProfile()) {
+    // Only convert the name when it changes.
+    if (profile->m_name != m_shownProfileName) {
+      m_shownProfileName = profile->m_name;
+      m_shownProfileNameWide = toWideString(profile->m_name);
+    }
+    s += L"profile: ";
+    s += m_shownProfileNameWide;
+    s += L'\n';
+  }
 
-  D2D1_ELLIPSE circle;
-  circle.point.x = 0.5;
-  circle.point.y = 0.5;
-  circle.radiusX = 0.5 - lp().m_circleMargin;
-  circle.radiusY = 0.5 - lp().m_circleMargin;
+  if (m_calibrator.isRunning()) {
+    CalibrationStepInfo const &info =
+      calibrationStepInfo(m_calibrator.step());
+    appendFormat(s, "calibrating %s (%ds, D skips, Esc cancels):\n%s\n",
+      info.m_name,
+      (m_calibrator.remainingMS() + 999) / 1000,
+      info.m_prompt);
+  }
 
-  // Draw the outline always since the stroke width means the outer
-  // edge is a bit larger than the filled ellipse.
-  m_renderTarget->DrawEllipse(
-    circle,
-    m_linesBrush,
-    lp().m_lineWidthPixels,            // strokeWidth in pixels
-    m_strokeStyleFixedThickness);      // strokeStyle
+  DriftRecord first, latest;
+  if (m_driftTracker.firstAndLatest(m_config.m_controllerID,
+                                    first, latest)) {
+    appendFormat(s, "rest: L %.0f,%.0f R %.0f,%.0f "
+                    "(was L %.0f,%.0f R %.0f,%.0f)\n",
+      latest.m_meanX[0], latest.m_meanY[0],
+      latest.m_meanX[1], latest.m_meanY[1],
+      first.m_meanX[0], first.m_meanY[0],
+      first.m_meanX[1], first.m_meanY[1]);
+  }
 
-  if (fill) {
-    m_renderTarget->FillEllipse(
-      circle,
-      m_linesBrush);
+  if (m_configWatcher || m_configPersister) {
+    s += L"config:";
+    if (m_configWatcher) {
+      appendFormat(s, " %s, %d reloads",
+        toString(m_configWatcher->activeMethod()),
+        m_configWatcher->numUpdates());
+    }
+    if (m_configPersister) {
+      appendFormat(s, "%s %d saves",
+        m_configWatcher? "," : "",
+        m_configPersister->numWrites());
+    }
+    s += L'\n';
   }
 }
 
 
-void GVMainWindow::drawCircleAt(
-  D2D1_MATRIX_3X2_F transform,
-  float x,
-  float y,
-  float r,
-  bool fill)
+void GVMainWindow::onResize()
 {
-  drawCircle(focusArea(x-r, y-r, x+r, y+r) * transform, fill);
+  if (g_useCpuRaster) {
+    invalidateAllPixels();
+  }
+  else if (m_renderTarget) {
+    m_renderTarget->Resize(getClientRectSizeU());
+
+    // Cause a repaint event for the entire window, not just any newly
+    // exposed part, because the size affects everything displayed.
+    invalidateAllPixels();
+  }
 }
 
 
-void GVMainWindow::drawSquare(
-  D2D1_MATRIX_3X2_F transform,
-  GVColorRole color,
-  float margin,
-  bool fill)
+void GVMainWindow::invalidateAllPixels()
 {
-  drawPartiallyFilledSquare(
-    transform,
-    color,
-    margin,
-    fill? 1.0 : 0.0,
-    1.0 /*fillHR*/);
+  traceEvent(TE_INVALIDATE);
+  InvalidateRect(m_hwnd, nullptr /*lpRect*/, false /*bErase*/);
 }
 
 
-void GVMainWindow::drawPartiallyFilledSquare(
-  D2D1_MATRIX_3X2_F transform,
-  GVColorRole color,
-  float margin,
-  float fillAmount,
-  float fillHR)
+bool GVMainWindow::onKeyDown(WPARAM wParam, LPARAM lParam)
 {
-  m_renderTarget->SetTransform(transform);
-
-  D2D1_RECT_F square;
-  square.left = margin;
-  square.top = margin;
-  square.right = 1.0 - margin;
-  square.bottom = 1.0 - margin;
-
-  // Draw the outline always since the stroke width means the outer
-  // edge is a bit larger than the filled shape.
-  m_renderTarget->DrawRectangle(
-    square,
-    brushForColorRole(color),
-    lp().m_lineWidthPixels,            // strokeWidth
-    m_strokeStyleFixedThickness);      // strokeStyle
+  TRACE2(L"onKeyDown:" << std::hex <<
+         TRVAL(wParam) << TRVAL(lParam) << std::dec);
 
-  if (fillAmount > 0) {
-    square.top = square.bottom - (square.bottom-square.top) * fillAmount;
+  switch (wParam) {
+    case 'B':
+      toggleFrameProfiler();
+      return true;
 
-    // Apply `fillHR` to `square`.
-    float hr = (square.right - square.left) / 2.0;
-    float x = (square.right + square.left) / 2.0;
-    square.left = x - hr * fillHR;
-    square.right = x + hr * fillHR;
-
-    m_renderTarget->FillRectangle(
-      square,
-      brushForColorRole(color));
-  }
-}
-
-
-void GVMainWindow::drawLine(
-  D2D1_MATRIX_3X2_F transform,
-  float x1,
-  float y1,
-  float x2,
-  float y2,
-  GVColorRole color)
-{
-  m_renderTarget->SetTransform(transform);
-
-  m_renderTarget->DrawLine(
-    D2D1::Point2F(x1, y1),
-    D2D1::Point2F(x2, y2),
-    brushForColorRole(color),
-    lp().m_lineWidthPixels,            // strokeWidth
-    m_strokeStyleFixedThickness);      // strokeStyle
-}
-
-
-void GVMainWindow::drawTextWithBackground(
-  std::wstring const &str,
-  D2D1_POINT_2F const &textCursor,
-  GVColorRole bgColorRole)
-{
-  // Drawing text requires the identity transform.
-  m_renderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
-
-  // Compute a rectangle to hold the text.  This is meant to be larger
-  // than the actual text to display.
-  //
-  // TODO: This could be made more general by accepting or computing
-  // the width and height.
-  //
-  D2D1_RECT_F textRect =
-    D2D1::RectF(textCursor.x,         textCursor.y,
-                textCursor.x + 200.0, textCursor.y + 20.0);
-
-  // Make a "text layout" object to measure the text that will be drawn.
-  IDWriteTextLayout *textLayout = nullptr;
-  CALL_HR_WINAPI(m_writeFactory->CreateTextLayout,
-    str.data(),
-    str.size(),
-    m_textFormat,
-    textRect.right - textRect.left,
-    textRect.bottom - textRect.top,
-    &textLayout);
-  assert(textLayout);
-  SafeReleaseOnLeave releaseTextLayout(textLayout);
-
-  // Measure it.
-  DWRITE_TEXT_METRICS tm{};
-  CALL_HR_WINAPI(textLayout->GetMetrics,
-    &tm);
-
-  // The measured width is just a bit tight on the right side.
-  tm.width += 1;
-
-  // Get the rectangle that the metrics say the text will occupy.  The
-  // metrics structure contains coordinates that are relative to the
-  // upper-left corner of `textRect`.
-  float L = textRect.left + tm.left;
-  float T = textRect.top + tm.top;
-  D2D1_RECT_F layoutRect =
-    D2D1::RectF(L,            T,
-                L + tm.width, T + tm.height);
-
-  // Paint a background beneath the text.
-  m_renderTarget->FillRectangle(
-    layoutRect,
-    brushForColorRole(bgColorRole));
-
-  // Draw the text.
-  m_renderTarget->DrawText(
-    str.data(),
-    str.size(),
-    m_textFormat,
-    textRect,
-    m_textBrush);
-}
-
-
-// Rotate around (0.5,0.5) counterclockwise by `degrees`.
-static D2D1_MATRIX_3X2_F rotateAroundCenterDeg(float degrees)
-{
-  return D2D1::Matrix3x2F::Rotation(degrees, D2D1::Point2F(0.5, 0.5));
-}
-
-static float radiansToDegrees(float radians)
-{
-  return radians / c_pi * 180.0;
-}
-
-static D2D1_MATRIX_3X2_F rotateAroundCenterRad(float radians)
-{
-  return rotateAroundCenterDeg(radiansToDegrees(radians));
-}
-
-
-void GVMainWindow::drawRoundButtons(
-  D2D1_MATRIX_3X2_F transform)
-{
-  WORD buttons = inputState().Gamepad.wButtons;
-
-  // Button masks, starting at top, then going clockwise.
-  static WORD const masks[4] = {
-    XINPUT_GAMEPAD_Y,        // Top, PS triangle
-    XINPUT_GAMEPAD_B,        // Right, PS circle
-    XINPUT_GAMEPAD_A,        // Bottom, PS X
-    XINPUT_GAMEPAD_X,        // Left, PS square
-  };
-
-  float const x = 0.5;
-  float const y = lp().m_roundButtonR;
-  float const r = lp().m_roundButtonR;
-
-  for (int i=0; i < 4; ++i) {
-    drawCircle(focusPtR(x, y, r) * transform,
-      buttons & masks[i]);
-
-    if (masks[i] == XINPUT_GAMEPAD_B &&
-        m_dodgeReleaseTimer.isRunning()) {
-      // Draw a small circle inside the big one to indicate that the
-      // button was recently released.  The primary purpose is to ensure
-      // that a screen recording running at 30 FPS reliably contains
-      // evidence of the button press even if it is pressed and released
-      // very quickly.
-      float const rSmall = r * lp().m_roundButtonTimerSizeFactor;
-      drawCircle(focusPtR(x, y, rSmall) * transform,
-        true /*fill*/);
-    }
-
-    // Rotate the transform 90 degrees around the center.
-    transform = rotateAroundCenterDeg(90) * transform;
-  }
-}
-
-
-void GVMainWindow::drawDPadButtons(
-  D2D1_MATRIX_3X2_F transform)
-{
-  WORD buttons = inputState().Gamepad.wButtons;
-
-  // Button masks, starting at top, then going clockwise.
-  WORD masks[4] = {
-    XINPUT_GAMEPAD_DPAD_UP,
-    XINPUT_GAMEPAD_DPAD_RIGHT,
-    XINPUT_GAMEPAD_DPAD_DOWN,
-    XINPUT_GAMEPAD_DPAD_LEFT,
-  };
-
-  for (int i=0; i < 4; ++i) {
-    drawSquare(
-      focusPtR(0.5, lp().m_dpadButtonR, lp().m_dpadButtonR) * transform,
-      GVCR_NORMAL,
-      lp().m_circleMargin,
-      buttons & masks[i]);
-
-    // Rotate the transform 90 degrees around the center.
-    transform = rotateAroundCenterDeg(90) * transform;
-  }
-}
-
-
-void GVMainWindow::drawShoulderButtons(
-  D2D1_MATRIX_3X2_F transform,
-  bool leftSide)
-{
-  WORD buttons = inputState().Gamepad.wButtons;
-  WORD mask = (leftSide? XINPUT_GAMEPAD_LEFT_SHOULDER :
-                         XINPUT_GAMEPAD_RIGHT_SHOULDER);
-
-  // Bumper.
-  drawSquare(
-    focusPtHVR(0.5, 1.0 - lp().m_bumperVR, 0.5, lp().m_bumperVR) * transform,
-    GVCR_NORMAL,
-    lp().m_circleMargin,
-    buttons & mask);
-
-  BYTE trigger = (leftSide? inputState().Gamepad.bLeftTrigger :
-                            inputState().Gamepad.bRightTrigger);
-  float fillAmount = trigger / 255.0;
-
-  bool isPressed =
-    m_controllerState.isTriggerPressed(m_config.m_analogThresholds, leftSide);
-
-  // Trigger.
-  //
-  // If `trigger` exceeds the dead zone threshold, then the fill is the
-  // entire rectangle width.  But if not, it is only half of the width
-  // in order to indicate that the game may not register it.
-  //
-  drawPartiallyFilledSquare(
-    focusPtHVR(0.5, lp().m_triggerVR, 0.5, lp().m_triggerVR) * transform,
-    GVCR_NORMAL,
-    lp().m_circleMargin,
-    fillAmount,
-    isPressed? 1.0 : 0.5);
-}
-
-
-void GVMainWindow::drawParryTimer(
-  D2D1_MATRIX_3X2_F transform)
-{
-  ParryTimerConfig const &ptc = m_config.m_parryTimer;
-
-  if (ptc.m_durationMS > 0) {
-    // Draw the timer bar.  This comes first so it appears below the
-    // outline and hash marks.
-    float fillAmount =
-      (float)parryTimerElapsedMS() / ptc.m_durationMS;
-    drawSquare(
-      focusArea(0, 0, fillAmount, 1.0) * transform,
-      isParryActive()? GVCR_PARRY_ACTIVE : GVCR_PARRY_INACTIVE,
-      0 /*margin*/,
-      true /*fill*/);
-
-    // Draw the outline of the timer.
-    drawSquare(transform, GVCR_NORMAL, 0 /*margin*/, false /*fill*/);
-
-    // Draw the segment hash marks.
-    for (int i=1; i < ptc.m_numSegments; ++i) {
-      float x = (float)i / ptc.m_numSegments;
-      drawLine(transform, x, 1.0 - lp().m_parryTimerHashHeight,
-                          x, 1.0,
-                          GVCR_NORMAL);
-    }
-
-    // Draw hash marks for the active area boundary.
-    float x = (float)ptc.m_activeStartMS / ptc.m_durationMS;
-    drawLine(transform, x, 0.0,
-                        x, lp().m_parryTimerHashHeight,
-                        GVCR_NORMAL);
-    x = (float)ptc.m_activeEndMS / ptc.m_durationMS;
-    drawLine(transform, x, 0.0,
-                        x, lp().m_parryTimerHashHeight,
-                        GVCR_NORMAL);
-  }
-}
-
-
-void GVMainWindow::drawStick(
-  D2D1_MATRIX_3X2_F transform,
-  bool leftSide)
-{
-  AnalogThresholdConfig const &thr = m_config.m_analogThresholds;
-
-  // Outline.
-  drawCircleAt(transform, 0.5, 0.5, lp().m_stickOutlineR, false /*fill*/);
-
-  // Raw stick position in [-32768,32767], positive being rightward.
-  float rawX = (leftSide? inputState().Gamepad.sThumbLX :
-                          inputState().Gamepad.sThumbRX);
-
-  // Raw stick position in [-32768,32767], positive being upward.
-  float rawY = (leftSide? inputState().Gamepad.sThumbLY :
-                          inputState().Gamepad.sThumbRY);
-
-  // Dead zone size.  The exact shape depends on `leftSide`.
-  float deadZone = (leftSide? thr.m_leftStickWalkThreshold :
-                              thr.m_rightStickDeadZone);
-
-  // Absolute values for easier dead zone calculations.
-  float absX = std::abs(rawX);
-  float absY = std::abs(rawY);
-
-  // Magnitude of deflection in the raw units.
-  float magnitude = std::sqrt(absX*absX + absY*absY);
-
-  // True if we are beyond the dead zone.
-  bool beyondDeadZone = leftSide?
-    // Octagon with radius `deadZone`.
-    std::max(absX, absY) > deadZone || (absX + absY) > deadZone * 1.5 :
-    // Square with radius `deadZone`.
-    std::max(absX, absY) > deadZone;
-
-  // How fast will we run (if this is the left stick)?
-  int speed =
-    magnitude > thr.m_leftStickSprintThreshold? 3 :
-    magnitude > thr.m_leftStickRunThreshold?    2 :
-                                                     1 ;
-
-  if (beyondDeadZone) {
-    // Truncate anything outside the circle.
-    if (magnitude > 32767) {
-      magnitude = 32767;
-    }
-
-    // Remove the dead zone contribution.
-    //
-    // This is probably not correct for Elden Ring.
-    //
-    magnitude -= deadZone;
-
-    // Scale what remains to [0,1].
-    magnitude = magnitude / (32767 - deadZone);
-
-    // Deflection angle.  Flip the Y coordinate here to account for the
-    // raw units having the oppositely oriented vertical axis.
-    float angleRadians = std::atan2(-rawY, rawX);
-
-    // Deflection distances in [-1,1].
-    float deflectX = magnitude * std::cos(angleRadians);
-    float deflectY = magnitude * std::sin(angleRadians);
-
-    // Filled circle representing the grippy part.
-    float spotX = 0.5 + deflectX * lp().m_stickMaxDeflectR;
-    float spotY = 0.5 + deflectY * lp().m_stickMaxDeflectR;
-    drawCircleAt(transform, spotX, spotY, lp().m_stickThumbR, true /*fill*/);
-
-    // Line from center to circle showing the deflection angle, even
-    // when the thumb is close to the center.
-    float edgeX = 0.5 + std::cos(angleRadians) * lp().m_stickMaxDeflectR;
-    float edgeY = 0.5 + std::sin(angleRadians) * lp().m_stickMaxDeflectR;
-    drawLine(transform, 0.5, 0.5, edgeX, edgeY, GVCR_NORMAL);
-
-    if (leftSide) {
-      // Add 90 degrees to the angle because it is 0 when going right,
-      // but my chevron is oriented upward.
-      drawSpeedIndicator(transform, spotX, spotY,
-                         angleRadians + c_pi/2.0, speed);
-    }
-  }
-
-  WORD buttons = inputState().Gamepad.wButtons;
-  WORD mask = (leftSide? XINPUT_GAMEPAD_LEFT_THUMB :
-                         XINPUT_GAMEPAD_RIGHT_THUMB);
-
-  // Stick click button.
-  if (buttons & mask) {
-    drawCircle(transform, false /*fill*/);
-  }
-}
-
-
-void GVMainWindow::drawSpeedIndicator(
-  D2D1_MATRIX_3X2_F transform,
-  float spotX,
-  float spotY,
-  float angleRadians,
-  int speed)
-{
-  // Focus on the thumb circle.
-  transform = focusPtR(spotX, spotY, lp().m_stickThumbR) * transform;
-
-  // Turn the indicator to match the stick.
-  transform = rotateAroundCenterRad(angleRadians) * transform;
-
-  for (int i=0; i < speed; ++i) {
-    // [0], [0,1], or [-1,0,1].
-    int preliminary = i - (speed-1) / 2;
-
-    // If speed is 1, then 0.
-    // If speed is 2, then [-0.5,0.5].
-    // If speed is 3, then [-1,0,1].
-    float offset = preliminary - (speed%2 == 0? 0.5 : 0);
-
-    drawChevron(transform, offset * lp().m_chevronSeparation);
-  }
-}
-
-
-void GVMainWindow::drawChevron(
-  D2D1_MATRIX_3X2_F transform,
-  float dy)
-{
-  drawLine(transform, 0.5 - lp().m_chevronHR, 0.5 + lp().m_chevronVR + dy,
-                      0.5,                    0.5 - lp().m_chevronVR + dy, GVCR_HIGHLIGHT);
-  drawLine(transform, 0.5,                    0.5 - lp().m_chevronVR + dy,
-                      0.5 + lp().m_chevronHR, 0.5 + lp().m_chevronVR + dy, GVCR_HIGHLIGHT);
-}
-
-
-void GVMainWindow::drawSelStartButton(
-  D2D1_MATRIX_3X2_F transform,
-  bool leftSide)
-{
-  WORD buttons = inputState().Gamepad.wButtons;
-  WORD mask = (leftSide? XINPUT_GAMEPAD_BACK :  // PS select
-                         XINPUT_GAMEPAD_START);
-
-  drawSquare(transform, GVCR_NORMAL, lp().m_circleMargin, buttons & mask);
-}
-
-
-void GVMainWindow::drawCentralCircle(
-  D2D1_MATRIX_3X2_F transform)
-{
-  drawCircle(transform, true /*fill*/);
-}
-
-
-void GVMainWindow::onResize()
-{
-  if (m_renderTarget) {
-    m_renderTarget->Resize(getClientRectSizeU());
-
-    // Cause a repaint event for the entire window, not just any newly
-    // exposed part, because the size affects everything displayed.
-    invalidateAllPixels();
-  }
-}
-
-
-void GVMainWindow::invalidateAllPixels()
-{
-  InvalidateRect(m_hwnd, nullptr /*lpRect*/, false /*bErase*/);
-}
-
-
-bool GVMainWindow::onKeyDown(WPARAM wParam, LPARAM lParam)
-{
-  TRACE2(L"onKeyDown:" << std::hex <<
-         TRVAL(wParam) << TRVAL(lParam) << std::dec);
-
-  switch (wParam) {
     case 'C':
       runColorChooser(false /*highlight*/);
       return true;
 
+    case 'D':
+      advanceCalibration();
+      return true;
+
+    case 'F':
+      dumpTrace();
+      return true;
+
     case 'H':
       runColorChooser(true /*highlight*/);
       return true;
 
+    case 'I':
+      saveReplay();
+      return true;
+
     case 'M':
       minimizeWindow();
       return true;
 
+    case 'P':
+      selectNextProfile();
+      return true;
+
+    case 'R':
+      toggleRecording();
+      return true;
+
     case 'Q':
       // Q to quit.
       TRACE2(L"Saw Q keypress.");
@@ -1384,6 +1093,13 @@ bool GVMainWindow::onKeyDown(WPARAM wParam, LPARAM lParam)
     case VK_OEM_PLUS:
       resizeWindow(+50);
       return true;
+
+    case VK_ESCAPE:
+      if (m_calibrator.isRunning()) {
+        cancelCalibration();
+        return true;
+      }
+      break;
   }
 
   // Not handled.
@@ -1424,6 +1140,12 @@ void GVMainWindow::createContextMenu()
   appendContextMenu(IDM_TOGGLE_PARRY_TIME_TEXT,     L"Toggle showing parry elapsed time text");
   appendContextMenu(IDM_TOGGLE_DODGE_INVULNERABILITY_TIMER,
     L"Toggle showing dodge invulnerability timer");
+  appendContextMenu(IDM_TOGGLE_RECORDING,           L"Start/stop recording input (R)");
+  appendContextMenu(IDM_SAVE_REPLAY,                L"Save last minutes of input (I)");
+  appendContextMenu(IDM_NEXT_PROFILE,               L"Next timing profile (P)");
+  appendContextMenu(IDM_CALIBRATE,                  L"Calibrate stick dead zones (D)");
+  appendContextMenu(IDM_DUMP_TRACE,                 L"Dump trace to file (F)");
+  appendContextMenu(IDM_TOGGLE_FRAME_PROFILER,      L"Toggle frame profiler overlay (B)");
 
   CALL_HANDLE_WINAPI(m_controllerIDMenu, CreatePopupMenu);
 
@@ -1539,6 +1261,30 @@ bool GVMainWindow::onCommand(WPARAM wParam, LPARAM lParam)
       toggleShowDodgeInvulnerabilityTimer();
       return true;
 
+    case IDM_TOGGLE_RECORDING:
+      toggleRecording();
+      return true;
+
+    case IDM_SAVE_REPLAY:
+      saveReplay();
+      return true;
+
+    case IDM_NEXT_PROFILE:
+      selectNextProfile();
+      return true;
+
+    case IDM_CALIBRATE:
+      advanceCalibration();
+      return true;
+
+    case IDM_DUMP_TRACE:
+      dumpTrace();
+      return true;
+
+    case IDM_TOGGLE_FRAME_PROFILER:
+      toggleFrameProfiler();
+      return true;
+
     case IDM_CONTROLLER_0:
     case IDM_CONTROLLER_1:
     case IDM_CONTROLLER_2:
@@ -1624,11 +1370,338 @@ static void toggleBool(bool &b)
 
 void GVMainWindow::toggleShowText()
 {
+  // Now it is the user's choice.
+  m_calibrationForcedText = false;
   toggleBool(m_config.m_showText);
   invalidateAllPixels();
 }
 
 
+void GVMainWindow::toggleFrameProfiler()
+{
+  if (!FrameProfiler::compiledIn()) {
+    TRACE1(L"The frame profiler was disabled at compile time.");
+    return;
+  }
+
+  toggleBool(m_frameProfiler.m_enabled);
+  m_frameProfiler.clear();
+  invalidateAllPixels();
+}
+
+
+void GVMainWindow::toggleRecording()
+{
+  if (m_recorder) {
+    stopRecording();
+  }
+  else {
+    startRecording();
+  }
+
+  // The text display shows the recording status.
+  invalidateAllPixels();
+}
+
+
+// Return a recording file name starting with `prefix` and ending with
+// the current local time.
+static std::string timestampedRecordingName(char const *prefix)
+{
+  SYSTEMTIME t;
+  GetLocalTime(&t);
+
+  char fname[80];
+  std::snprintf(fname, sizeof(fname),
+    "%s-%04d%02d%02d-%02d%02d%02d.gpvrec", prefix,
+    t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
+  return fname;
+}
+
+
+void GVMainWindow::startRecording()
+{
+  m_recordingFilename = timestampedRecordingName("gamepad-viewer");
+
+  m_recordingFile.reset(
+    new std::ofstream(m_recordingFilename, std::ios::binary));
+  if (!*m_recordingFile) {
+    TRACE1(toWideString(m_recordingFilename + ": cannot open for writing"));
+    m_recordingFile.reset();
+    return;
+  }
+
+  traceEvent(TE_RECORDING, 1);
+  m_recorder.reset(new InputRecordingWriter(*m_recordingFile));
+  m_recorder->writeHeader(m_config);
+  m_recordedConfig = m_config;
+
+  // Start with the current state so the recording does not depend on
+  // the input changing soon.
+  m_recorder->writeSample(m_inputModel.m_controllerState);
+
+  TRACE2(toWideString("Recording to " + m_recordingFilename));
+}
+
+
+void GVMainWindow::stopRecording()
+{
+  if (!m_recorder) {
+    return;
+  }
+
+  TRACE2(toWideString("Stopped recording to " + m_recordingFilename) <<
+         L" after " << m_recorder->m_sampleCount << L" samples");
+  traceEvent(TE_RECORDING, 0, m_recorder->m_sampleCount);
+
+  m_recorder->writeFooter();
+  m_recorder.reset();
+  m_recordingFile.reset();
+}
+
+
+void GVMainWindow::startReplayBuffer()
+{
+  if (g_replayBufferMinutes <= 0) {
+    return;
+  }
+
+  // Size it for a changed sample on every poll, which is the most
+  // there can be.  Samples that repeat the previous one are not
+  // stored, so it usually covers far more than the window.
+  std::uint64_t windowMS = (std::uint64_t)g_replayBufferMinutes * 60000;
+  std::uint64_t capacity =
+    windowMS / std::max(m_config.m_pollingIntervalMS, 1) *
+    std::max(g_syntheticInputSamplesPerPoll, 1);
+  capacity = std::min<std::uint64_t>(capacity, 100000000);
+
+  std::string error = m_replayBuffer.open(REPLAY_BUFFER_DEFAULT_PATH,
+    (std::uint32_t)capacity, (DWORD)windowMS);
+  if (!error.empty()) {
+    TRACE1(toWideString(REPLAY_BUFFER_DEFAULT_PATH ": " + error));
+    return;
+  }
+  TRACE2(L"Keeping the last " << g_replayBufferMinutes <<
+         L" minutes of input in " REPLAY_BUFFER_DEFAULT_PATH
+         L", " << capacity << L" samples");
+}
+
+
+void GVMainWindow::saveReplay()
+{
+  if (!m_replayBuffer.isOpen()) {
+    TRACE1(L"The replay buffer is disabled.");
+    return;
+  }
+
+  // The samples are copied and written on another thread, so this
+  // does not delay polling.
+  std::string fname = timestampedRecordingName("gamepad-viewer-replay");
+  if (!m_replayBuffer.saveSnapshot(fname, m_config)) {
+    TRACE1(L"Still saving the previous replay.");
+    return;
+  }
+  TRACE2(toWideString("Saving replay to " + fname));
+}
+
+
+void GVMainWindow::checkReplaySaved()
+{
+  std::string fname, error;
+  long numSamples;
+  if (!m_replayBuffer.takeSnapshotResult(fname, numSamples, error)) {
+    return;
+  }
+
+  if (!error.empty()) {
+    TRACE1(toWideString(error));
+  }
+  else {
+    TRACE2(toWideString("Saved replay to " + fname) <<
+           L": " << numSamples << L" samples");
+  }
+}
+
+
+void GVMainWindow::recordConfigIfChanged()
+{
+  if (!m_recorder || m_config == m_recordedConfig) {
+    return;
+  }
+
+  // Moving the window changes the configuration on every poll, but
+  // does not affect a replay, so do not record that.
+  m_recordedConfig.m_windowLeft   = m_config.m_windowLeft;
+  m_recordedConfig.m_windowTop    = m_config.m_windowTop;
+  m_recordedConfig.m_windowWidth  = m_config.m_windowWidth;
+  m_recordedConfig.m_windowHeight = m_config.m_windowHeight;
+  if (m_config == m_recordedConfig) {
+    return;
+  }
+
+  TRACE2(L"recordConfigIfChanged: changed " <<
+         toWideString(m_recordedConfig.diffFields(m_config).front()));
+  m_recorder->writeConfig(m_config, GetTickCount());
+  m_recordedConfig = m_config;
+}
+
+
+void GVMainWindow::advanceCalibration()
+{
+  if (m_calibrator.isRunning()) {
+    if (m_calibrator.nextStep()) {
+      finishCalibration();
+    }
+  }
+  else {
+    TRACE2(L"advanceCalibration: starting");
+    m_calibrator.start();
+
+    // The instructions are in the text display.
+    m_calibrationForcedText = !m_config.m_showText;
+    m_config.m_showText = true;
+  }
+  traceEvent(TE_CALIBRATION,
+    m_calibrator.isRunning()? m_calibrator.step() : -1);
+
+  m_redrawPending = true;
+  invalidateAllPixels();
+}
+
+
+void GVMainWindow::finishCalibration()
+{
+  CalibrationResult result = m_calibrator.result();
+  std::string report = result.report(m_config.m_analogThresholds);
+
+  AnalogThresholdConfig thr = m_config.m_analogThresholds;
+  int count = result.apply(thr);
+  m_config.setAnalogThresholds(thr);
+
+  TRACE2(L"finishCalibration: updated " << count << L" thresholds:\n" <<
+         toWideString(report));
+
+  std::ostringstream oss;
+  oss << "calibration of controller " << m_config.m_controllerID
+      << ", " << count << " thresholds updated:\n" << report;
+  appendCalibrationLog(oss.str());
+
+  endCalibration();
+}
+
+
+void GVMainWindow::cancelCalibration()
+{
+  TRACE2(L"cancelCalibration");
+  m_calibrator.cancel();
+  traceEvent(TE_CALIBRATION, -1);
+  endCalibration();
+}
+
+
+void GVMainWindow::endCalibration()
+{
+  if (m_calibrationForcedText) {
+    m_calibrationForcedText = false;
+    m_config.m_showText = false;
+  }
+
+  m_redrawPending = true;
+  invalidateAllPixels();
+}
+
+
+void GVMainWindow::logDrift()
+{
+  DriftRecord rec;
+  while (m_driftTracker.takeRecord(rec)) {
+    appendCalibrationLog("rest position of " + rec.toString() + "\n");
+  }
+}
+
+
+// Return `text` prefixed with the current time.
+static std::string timestamped(std::string const &text)
+{
+  SYSTEMTIME t;
+  GetLocalTime(&t);
+
+  char stamp[40];
+  std::snprintf(stamp, sizeof(stamp),
+    "%04d-%02d-%02d %02d:%02d:%02d ",
+    t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
+  return stamp + text;
+}
+
+
+// Append `text`, prefixed with the current time, to `fname`.
+static void appendToLog(char const *fname, std::string const &text)
+{
+  std::ofstream out(fname, std::ios::app);
+  out << timestamped(text);
+  if (!out) {
+    TRACE1(toWideString(std::string(fname) + ": write failed"));
+  }
+}
+
+
+void GVMainWindow::appendCalibrationLog(std::string const &text)
+{
+  char const *fname = "gamepad-viewer-calibration.log";
+  if (m_configPersister) {
+    // This is called while polling, which should not wait for a disk.
+    m_configPersister->appendLog(fname, timestamped(text));
+  }
+  else {
+    appendToLog(fname, text);
+  }
+}
+
+
+void GVMainWindow::logSessionStats()
+{
+  if (m_drawLatency.m_count == 0) {
+    // Nothing was shown, perhaps because no controller was connected.
+    return;
+  }
+  double seconds = (steadyClockUS() - m_sessionStartUS) / 1e6;
+
+  std::ostringstream oss;
+  oss.setf(std::ios::fixed);
+  oss.precision(0);
+  oss << "session of " << seconds << " s: "
+      << m_sampleRate.m_total << " samples, "
+      << m_pollRate.m_total << " polls, "
+      << m_paintRate.m_total << " frames, "
+      << m_drawLatency.m_count << " with new input; latency to "
+      << "invalidate " << m_invalidateLatency.summary()
+      << ", to EndDraw " << m_drawLatency.summary() << "\n";
+  appendToLog("gamepad-viewer-session.log", oss.str());
+}
+
+
+void GVMainWindow::dumpTrace()
+{
+  SYSTEMTIME t;
+  GetLocalTime(&t);
+
+  char fname[80];
+  std::snprintf(fname, sizeof(fname),
+    "gamepad-viewer-trace-%04d%02d%02d-%02d%02d%02d.%s",
+    t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond,
+    g_traceChromeJSON? "json" : "txt");
+
+  std::string error = traceRingDumpToFile(fname,
+    g_traceChromeJSON? TDF_CHROME_JSON : TDF_TEXT);
+  if (!error.empty()) {
+    TRACE1(toWideString(std::string(fname) + ": " + error));
+  }
+  else {
+    TRACE2(toWideString(std::string("Wrote trace to ") + fname));
+  }
+}
+
+
 void GVMainWindow::toggleTopmost()
 {
   toggleBool(m_config.m_topmostWindow);
@@ -1669,6 +1742,23 @@ void GVMainWindow::toggleShowDodgeInvulnerabilityTimer()
 }
 
 
+void GVMainWindow::selectNextProfile()
+{
+  // The input model and painters read the settings from `m_config`,
+  // so they pick up the new windows on the next poll.
+  if (!m_config.selectNextProfile()) {
+    TRACE1(L"selectNextProfile: no profiles are configured");
+    return;
+  }
+
+  TRACE2(L"selectNextProfile: now " <<
+         toWideString(m_config.activeProfile()->m_name));
+  traceEvent(TE_PROFILE, m_config.m_activeProfile);
+  m_redrawPending = true;
+  invalidateAllPixels();
+}
+
+
 std::string GVMainWindow::getConfigFilename() const
 {
   // For now, just save it to the directory where we started.
@@ -1676,7 +1766,7 @@ std::string GVMainWindow::getConfigFilename() const
 }
 
 
-void GVMainWindow::loadConfiguration()
+bool GVMainWindow::loadConfiguration()
 {
   std::string fname = getConfigFilename();
   if (std::filesystem::exists(fname)) {
@@ -1685,19 +1775,35 @@ void GVMainWindow::loadConfiguration()
     if (!error.empty()) {
       // Just print the error and continue.
       TRACE1(toWideString(fname + ": " + error));
+      return false;
     }
     else {
       TRACE2(toWideString("Read " + fname));
+      return true;
     }
   }
   else {
     TRACE2(toWideString(fname) << " does not exist, skipping");
+    return false;
   }
 }
 
 
-void GVMainWindow::saveConfiguration() const
+void GVMainWindow::saveConfiguration()
 {
+  if (m_configPersister) {
+    // Hand over the final state and let the persister write it, if it
+    // differs from what was last saved.
+    m_configPersister->submit(m_config);
+    m_configPersister->stop();
+    std::string error = m_configPersister->lastError();
+    if (!error.empty()) {
+      TRACE1(toWideString(getConfigFilename() + ": " + error));
+    }
+    m_configPersister.reset();
+    return;
+  }
+
   std::string fname = getConfigFilename();
   std::string error = m_config.saveToFile(fname);
   if (!error.empty()) {
@@ -1710,6 +1816,269 @@ void GVMainWindow::saveConfiguration() const
 }
 
 
+void GVMainWindow::startConfigPersister(bool loaded)
+{
+  m_submittedConfig = m_config;
+
+  if (g_configSaveDelayMS <= 0) {
+    return;
+  }
+
+  // If the file was read cleanly, it holds `m_config`, so there is no
+  // need to write it until something changes.
+  m_configPersister.reset(new ConfigPersister(getConfigFilename(),
+    loaded? &m_config : nullptr, g_configSaveDelayMS));
+  m_configPersister->start();
+}
+
+
+void GVMainWindow::submitConfigIfChanged()
+{
+  if (!m_configPersister) {
+    return;
+  }
+
+  // Compare and save the user's setting rather than calibration's,
+  // changing `m_config` briefly rather than copying it, which would
+  // allocate.
+  bool showText = m_config.m_showText;
+  if (m_calibrationForcedText) {
+    m_config.m_showText = false;
+  }
+  if (m_config != m_submittedConfig) {
+    m_submittedConfig = m_config;
+    m_configPersister->submit(m_config);
+    traceEvent(TE_CONFIG_SUBMIT);
+  }
+  m_config.m_showText = showText;
+}
+
+
+void GVMainWindow::startConfigWatcher()
+{
+  if (g_configWatchMode <= 0) {
+    return;
+  }
+
+  std::unique_ptr<ConfigWatcher> watcher(new ConfigWatcher(
+    getConfigFilename(), g_configWatchMode == 2? CWM_POLL : CWM_NOTIFY));
+  std::string error = watcher->start();
+  if (!error.empty()) {
+    TRACE1(toWideString("Not watching the configuration file: " + error));
+    return;
+  }
+  m_configWatcher = std::move(watcher);
+}
+
+
+void GVMainWindow::checkForConfigUpdate()
+{
+  if (!m_configWatcher) {
+    return;
+  }
+
+  std::unique_ptr<ConfigUpdate> update = m_configWatcher->takeUpdate();
+  if (!update) {
+    return;
+  }
+
+  std::string fname = getConfigFilename();
+  if (!update->m_error.empty()) {
+    // Probably a save in progress or a typo.  Keep the current
+    // settings; the next save will be picked up.
+    TRACE1(toWideString(fname + ": " + update->m_error));
+    return;
+  }
+
+  if (m_configPersister &&
+      m_configPersister->isLastWritten(update->m_config)) {
+    // This is the file we just wrote.  Applying it could undo a change
+    // made after that write.
+    TRACE3(toWideString("Ignoring own write of " + fname));
+    return;
+  }
+
+  TRACE2(toWideString("Reloaded " + fname));
+  traceEvent(TE_CONFIG_RELOAD, m_configWatcher->numUpdates());
+  applyConfig(update->m_config);
+
+  // What is now in `m_config` came from the file (apart from the
+  // window geometry and calibration's text display), so do not write
+  // it back, which would reformat the user's edits.
+  m_submittedConfig = m_config;
+  if (m_calibrationForcedText) {
+    m_submittedConfig.m_showText = false;
+  }
+}
+
+
+void GVMainWindow::startInputPublisher()
+{
+  if (g_publishInputName.empty()) {
+    return;
+  }
+
+  std::string error = m_inputPublisher.open(g_publishInputName);
+  if (!error.empty()) {
+    TRACE1(toWideString(g_publishInputName + ": " + error));
+    return;
+  }
+  TRACE2(toWideString("Publishing input to " + g_publishInputName));
+}
+
+
+// Fill `dest` from `timer`, whose window classification, if it has
+// one, is `windowState`, `frameDelta`, and `maxFrame`.
+static void setSharedTimerState(
+  SharedTimerState &dest,
+  ButtonTimer const &timer,
+  DWORD elapsedMS,
+  int windowState,
+  int frameDelta,
+  int maxFrame)
+{
+  if (timer.isRunning()) {
+    dest.m_running = 1;
+    dest.m_queued = timer.m_queued;
+    dest.m_elapsedMS = elapsedMS;
+    dest.m_windowState = windowState;
+    dest.m_frameDelta = frameDelta;
+    dest.m_maxFrame = maxFrame;
+  }
+  else {
+    dest.m_running = 0;
+    dest.m_queued = 0;
+    dest.m_elapsedMS = 0;
+    dest.m_windowState = -1;
+    dest.m_frameDelta = 0;
+    dest.m_maxFrame = 0;
+  }
+}
+
+
+void GVMainWindow::publishInputState()
+{
+  InputModel const &m = m_inputModel;
+  ControllerState const &cs = m.m_controllerState;
+
+  SharedInputSample s;
+  s.m_pollTimeUS = cs.m_pollTimeUS;
+  s.m_pollTimeMS = cs.m_pollTimeMS;
+  s.m_controllerID = m_config.m_controllerID;
+  s.m_hasInputState = cs.m_hasInputState;
+  s.m_inputState = cs.m_inputState;
+
+  int frameDelta, maxFrame;
+  ButtonWindowState bws = m.parryWindowState(frameDelta, maxFrame);
+  setSharedTimerState(s.m_parryTimer, m.m_parryTimer,
+    m.parryTimerElapsedMS(), bws, frameDelta, maxFrame);
+
+  setSharedTimerState(s.m_dodgeReleaseTimer, m.m_dodgeReleaseTimer,
+    m.m_dodgeReleaseTimer.elapsedMS(cs.m_pollTimeMS), -1, 0, 0);
+
+  bws = m.dodgeWindowState(frameDelta, maxFrame);
+  setSharedTimerState(s.m_dodgeInvulnerabilityTimer,
+    m.m_dodgeInvulnerabilityTimer,
+    m.dodgeInvulnerabilityTimerElapsedMS(), bws, frameDelta, maxFrame);
+
+  s.m_parryActive = m.isParryActive();
+  s.m_dodgeInvulnerabilityActive = m.isDodgeInvulnerabilityActive();
+
+  m_inputPublisher.publish(s);
+}
+
+
+void GVMainWindow::startEventStream()
+{
+  if (g_eventStreamPath.empty()) {
+    return;
+  }
+
+  std::unique_ptr<EventStreamServer> server(
+    new EventStreamServer(g_eventStreamPath));
+  std::string error = server->start();
+  if (!error.empty()) {
+    TRACE1(toWideString(g_eventStreamPath + ": " + error));
+    return;
+  }
+  TRACE2(toWideString("Sending input events on " + g_eventStreamPath));
+  m_eventStream = std::move(server);
+}
+
+
+void GVMainWindow::publishInputEvents()
+{
+  InputEvent events[InputEventDetector::MAX_EVENTS_PER_UPDATE];
+  int n = m_eventDetector.update(m_inputModel, events);
+  for (int i=0; i < n; ++i) {
+    m_eventStream->publish(events[i]);
+  }
+}
+
+
+void GVMainWindow::applyConfig(GPVConfig const &newConfig)
+{
+  GPVConfig oldConfig(m_config);
+  m_config = newConfig;
+
+  // The window position and size in the file are only a starting
+  // point; the user may have moved the window since.
+  m_config.m_windowLeft   = oldConfig.m_windowLeft;
+  m_config.m_windowTop    = oldConfig.m_windowTop;
+  m_config.m_windowWidth  = oldConfig.m_windowWidth;
+  m_config.m_windowHeight = oldConfig.m_windowHeight;
+
+  // Keep showing the calibration instructions.  The file's setting
+  // takes effect when calibration ends.
+  if (m_calibrator.isRunning() && !m_config.m_showText) {
+    m_calibrationForcedText = true;
+    m_config.m_showText = true;
+  }
+  else if (m_config.m_showText) {
+    m_calibrationForcedText = false;
+  }
+
+  if (m_config == oldConfig) {
+    return;
+  }
+
+  // The painters and input model point at `m_config`, so they see the
+  // new values directly.  The static layer notices changes to what it
+  // depends on by itself.  Other derived state has to be rebuilt.
+  bool colorsChanged = false;
+  for (int i=0; i < NUM_GV_COLOR_ROLES; ++i) {
+    GVColorRole role = static_cast<GVColorRole>(i);
+    if (colorrefForColorRole(m_config, role) !=
+        colorrefForColorRole(oldConfig, role)) {
+      colorsChanged = true;
+    }
+  }
+  if (colorsChanged && m_renderTarget) {
+    destroyLinesBrushes();
+    createLinesBrushes();
+  }
+
+  if (m_writeFactory &&
+      lp().m_textFontSizeDIPs != oldConfig.m_layoutParams.m_textFontSizeDIPs) {
+    safeRelease(m_textFormat);
+    createTextFormat();
+  }
+
+  if (m_config.m_topmostWindow != oldConfig.m_topmostWindow) {
+    setTopmost(m_config.m_topmostWindow);
+  }
+
+  if (m_config.m_pollingIntervalMS != oldConfig.m_pollingIntervalMS ||
+      m_config.m_presentFPS != oldConfig.m_presentFPS) {
+    // Setting a timer again with the same ID replaces it.
+    startTimers();
+  }
+
+  m_redrawPending = true;
+  invalidateAllPixels();
+}
+
+
 void GVMainWindow::onWindowPosChanged(WINDOWPOS const *wp)
 {
   bool changedSize =
@@ -1787,14 +2156,7 @@ LRESULT CALLBACK GVMainWindow::handleMessage(
           LWA_COLORKEY);       // dwFlags
       }
 
-      // Create a timer for polling the controller.
-      UINT_PTR id =
-        SetTimer(m_hwnd, IDT_POLL_CONTROLLER,
-                 m_config.m_pollingIntervalMS, nullptr /*proc*/);
-      if (!id) {
-        winapiDie(L"SetTimer");
-      }
-      assert(id == IDT_POLL_CONTROLLER);
+      startTimers();
 
       createDeviceIndependentResources();
       return 0;
@@ -1803,6 +2165,18 @@ LRESULT CALLBACK GVMainWindow::handleMessage(
     case WM_DESTROY:
       TRACE2(L"received WM_DESTROY");
       CALL_BOOL_WINAPI(KillTimer, m_hwnd, IDT_POLL_CONTROLLER);
+      CALL_BOOL_WINAPI(KillTimer, m_hwnd, IDT_PRESENT);
+      stopRecording();
+      logSessionStats();
+      m_inputPublisher.close();
+      m_eventStream.reset();
+      m_replayBuffer.close();
+
+      // Stop watching before writing the file ourselves.
+      m_configWatcher.reset();
+      if (m_calibrator.isRunning()) {
+        cancelCalibration();
+      }
       saveConfiguration();
       destroyGraphicsResources();
       destroyDeviceIndependentResources();
@@ -1916,6 +2290,58 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
   // Configure transparency, with default of true.
   g_useTransparency = envIntOr("TRANSPARENT", 1) != 0;
 
+  // Configure the static layer cache, with default of true.
+  g_useStaticLayer = envIntOr("STATIC_LAYER", 1) != 0;
+
+  // Configure the CPU rasterizer, with default of false.
+  g_useCpuRaster = envIntOr("CPU_RASTER", 0) != 0;
+
+  // Configure synthetic input, with default of off.
+  g_syntheticInputSamplesPerPoll = envIntOr("SYNTHETIC_INPUT", 0);
+
+  // Configure text layout caching, with default of true.
+  g_useTextLayoutCache = envIntOr("TEXT_LAYOUT_CACHE", 1) != 0;
+
+  // Configure config file watching, with default of notifications.
+  g_configWatchMode = envIntOr("CONFIG_WATCH", 1);
+
+  // Configure background config saving, with default of one second.
+  g_configSaveDelayMS = envIntOr("CONFIG_SAVE_DELAY", 1000);
+
+  // Configure the trace rings, with default of 8192 records per
+  // thread, and dump them if we crash.
+  traceRingInit(std::max(envIntOr("TRACE_RING", 8192), 0));
+  g_traceChromeJSON = envIntOr("TRACE_JSON", 0) != 0;
+
+  // Configure input publishing, with default of off.  1 means to use
+  // the default name.
+  if (char const *name = std::getenv("PUBLISH_INPUT")) {
+    g_publishInputName = name;
+    if (g_publishInputName == "0") {
+      g_publishInputName.clear();
+    }
+    else if (g_publishInputName == "1") {
+      g_publishInputName = SHARED_INPUT_DEFAULT_NAME;
+    }
+  }
+
+  // Configure the replay buffer, with default of five minutes.
+  g_replayBufferMinutes = envIntOr("REPLAY_BUFFER", 5);
+
+  // Configure the event stream, with default of off.  1 means to use
+  // the default path.
+  if (char const *path = std::getenv("EVENT_STREAM")) {
+    g_eventStreamPath = path;
+    if (g_eventStreamPath == "0") {
+      g_eventStreamPath.clear();
+    }
+    else if (g_eventStreamPath == "1") {
+      g_eventStreamPath = EVENT_STREAM_DEFAULT_PATH;
+    }
+  }
+  traceSetThreadName("ui");
+  traceRingInstallCrashDump("gamepad-viewer-crash-trace.txt");
+
   // Load the configuration file if it exists.
   GVMainWindow mainWindow;
 
@@ -1943,6 +2369,10 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     DispatchMessage(&msg);
   }
 
+  if (g_traceChromeJSON) {
+    mainWindow.dumpTrace();
+  }
+
   TRACE2(L"Returning from main");
   return 0;
 }
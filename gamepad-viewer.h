@@ -7,9 +7,26 @@
 #define GAMEPAD_VIEWER_H
 
 #include "base-window.h"               // BaseWindow
-#include "button-timer.h"              // ButtonTimer
-#include "controller-state.h"          // ControllerState
+#include "canvas.h"                    // GVColorRole
+#include "config-persister.h"          // ConfigPersister
+#include "config-watcher.h"            // ConfigWatcher
+#include "controller-painter.h"        // ControllerPainter, StaticLayerKey
+#include "frame-profiler.h"            // FrameProfiler
+#include "d2d-canvas.h"                // D2DCanvas
+#include "event-stream.h"              // EventStreamServer
 #include "gpv-config.h"                // GPVConfig
+#include "input-events.h"              // InputEventDetector
+#include "input-latch.h"               // InputLatch
+#include "input-model.h"               // InputModel
+#include "input-recording.h"           // InputRecordingWriter
+#include "latency-histogram.h"         // LatencyHistogram
+#include "raster-painter.h"            // RasterPainter, RasterImage
+#include "rate-counter.h"              // RateCounter
+#include "replay-buffer.h"             // ReplayBuffer
+#include "shared-input.h"              // SharedInputPublisher
+#include "stick-calibration.h"         // StickCalibrator, StickDriftTracker
+#include "synthetic-input.h"           // SyntheticInput
+#include "text-layout-cache.h"         // TextLayoutCache
 
 #include <d2d1.h>                      // Direct2D
 #include <d2d1_1.h>                    // ID2D1StrokeStyle1, ID2DFactory1
@@ -17,35 +34,11 @@
 #include <windows.h>                   // Windows API
 #include <xinput.h>                    // XINPUT_STATE
 
-
-// A UI element role that corresponds to a color.
-enum GVColorRole {
-  // No color; used to indicate, e.g., an unfilled interior.
-  GVCR_NONE,
-
-  // The normal color used for most lines.
-  GVCR_NORMAL,
-
-  // The highlight color for chevrons.
-  GVCR_HIGHLIGHT,
-
-  // Color to indicate parry is active.
-  GVCR_PARRY_ACTIVE,
-
-  // Color to indicate parry is inactive.
-  GVCR_PARRY_INACTIVE,
-
-  // Background color behind the text that shows the milliseconds on
-  // the parry timer.
-  GVCR_TEXT_BACKGROUND,
-
-  // Text background colors for dodge invulnerability timer, depending
-  // on whether it is active (invulnerable).
-  GVCR_DODGE_ACTIVE,
-  GVCR_DODGE_INACTIVE,
-
-  NUM_GV_COLOR_ROLES
-};
+#include <cstdint>                     // std::uint64_t
+#include <fstream>                     // std::ofstream
+#include <memory>                      // std::unique_ptr
+#include <string>                      // std::string
+#include <vector>                      // std::vector
 
 
 // Main window of the gamepad viewer.
@@ -97,28 +90,159 @@ public:      // data
   ID2D1SolidColorBrush *m_dodgeActiveBrush;
   ID2D1SolidColorBrush *m_dodgeInactiveBrush;
 
+  // Offscreen target holding the static layer when drawing with D2D.
+  // It is created lazily and recreated whenever `m_staticLayerKey`
+  // stops matching.
+  ID2D1BitmapRenderTarget *m_staticLayerTarget;
+
+  // What `m_staticLayerTarget` was drawn for.
+  StaticLayerKey m_staticLayerKey;
+
   // ------------------------- Other app state -------------------------
   // User-adjustable configuration.
   GPVConfig m_config;
 
-  // Current controller input.
-  ControllerState m_controllerState;
+  // Reloads the configuration file when it is edited.  Null if that
+  // is disabled.
+  std::unique_ptr<ConfigWatcher> m_configWatcher;
+
+  // Saves `m_config` in the background shortly after it changes.  Null
+  // if that is disabled, in which case it is only saved on exit.
+  std::unique_ptr<ConfigPersister> m_configPersister;
+
+  // Configuration last passed to `m_configPersister`.
+  GPVConfig m_submittedConfig;
+
+  // Controller input and button timers, updated on every poll.
+  InputModel m_inputModel;
+
+  // Snapshot of `m_inputModel` taken when the display was last
+  // presented, plus any buttons or triggers that were pressed only
+  // briefly since the previous one.  This is what gets drawn.
+  InputModel m_presentedModel;
+
+  // Publishes every polled sample to other processes if
+  // `PUBLISH_INPUT` is set.  Otherwise it is not open.
+  SharedInputPublisher m_inputPublisher;
+
+  // Sends input events to local subscribers if `EVENT_STREAM` is set.
+  // Otherwise it is null.
+  std::unique_ptr<EventStreamServer> m_eventStream;
+
+  // Finds the events in successive states of `m_inputModel`.
+  InputEventDetector m_eventDetector;
+
+  // Buttons and trigger presses seen by any poll since the last
+  // present.
+  InputLatch m_inputLatch;
+
+  // True if something has changed that the display should show at the
+  // next present.
+  bool m_redrawPending;
+
+  // Milliseconds between presents.
+  int m_presentIntervalMS;
+
+  // Source of input when the `SYNTHETIC_INPUT` envvar is set.
+  SyntheticInput m_syntheticInput;
+
+  // Rates of input samples, polls, and painted frames.
+  RateCounter m_sampleRate;
+  RateCounter m_pollRate;
+  RateCounter m_paintRate;
+
+  // Milliseconds spent in `onPaint`.
+  AverageCounter m_paintTime;
+
+  // Heap allocations per poll and per paint, when built with
+  // `GPV_ALLOC_AUDIT` (see alloc-audit.h).
+  AverageCounter m_pollAllocs;
+  AverageCounter m_paintAllocs;
+
+  // `m_pollTimeUS` of the first sample with the current packet number,
+  // which is when the input now in `m_inputModel` arrived.
+  std::uint64_t m_inputArrivalUS;
+
+  // Arrival time of the input in the frame being drawn, or 0 if that
+  // input was already shown by an earlier frame, in which case the
+  // frame says nothing about latency.  Set by `present`.
+  std::uint64_t m_frameInputUS;
+
+  // `m_frameInputUS` as of the previous present.
+  std::uint64_t m_lastPresentedInputUS;
+
+  // Latency of new input for this session, from its arrival to the
+  // present that invalidates the window, and to `EndDraw` returning.
+  LatencyHistogram m_invalidateLatency;
+  LatencyHistogram m_drawLatency;
+
+  // `steadyClockUS()` at startup, for the session log.
+  std::uint64_t m_sessionStartUS;
+
+  // ----------------------------- Drawing -----------------------------
+  // Recently used text layouts, for `m_d2dCanvas`.
+  TextLayoutCache m_textLayoutCache;
+
+  // Canvas that draws on `m_renderTarget` or `m_staticLayerTarget`.
+  D2DCanvas m_d2dCanvas;
+
+  // Draws on `m_d2dCanvas`.
+  ControllerPainter m_painter;
+
+  // Times the drawing phases of `m_painter` or `m_rasterPainter` while
+  // the overlay is on (`B` key).
+  FrameProfiler m_frameProfiler;
+
+  // When the CPU rasterizer is used instead of D2D, this draws the
+  // frames.
+  RasterPainter m_rasterPainter;
+
+  // Frame drawn by `m_rasterPainter`.
+  RasterImage m_rasterFrame;
+
+  // Scratch buffer for converting `m_rasterFrame` to the pixel order
+  // that `SetDIBitsToDevice` wants.
+  std::vector<RasterPixel> m_rasterBGRA;
+
+  // Number of primitives drawn for the most recent frame, including
+  // one for copying the static layer if it was used.
+  int m_framePrimitiveCount;
 
-  // Controller input state during the previous polling cycle.
-  ControllerState m_prevControllerState;
+  // Number of primitives drawn into the static layer when it was last
+  // created.
+  int m_staticLayerPrimitiveCount;
 
-  // Timer associated with pressing the parry button (L2).
-  ButtonTimer m_parryTimer;
+  // Name of the profile last shown in the text display, and its wide
+  // form, so the name is only converted when it changes.
+  std::string m_shownProfileName;
+  std::wstring m_shownProfileNameWide;
 
-  // Timer associated with releasing the dodge button (XBox B,
-  // PlayStation circle).
-  ButtonTimer m_dodgeReleaseTimer;
+  // While recording input, the file being written and the writer.
+  // Both are null when not recording.
+  std::unique_ptr<std::ofstream> m_recordingFile;
+  std::unique_ptr<InputRecordingWriter> m_recorder;
 
-  // Timer that tracks the invulnerability window associated with
-  // dodging.  This starts at the same time as the release timer, but
-  // then tracks both the invulnerability window and the recovery
-  // window, and also handles dodge queueing.
-  ButtonTimer m_dodgeInvulnerabilityTimer;
+  // Name of the file `m_recordingFile` is writing.
+  std::string m_recordingFilename;
+
+  // Configuration last written to `m_recorder`, apart from the window
+  // position and size, which are kept equal to `m_config`'s.
+  GPVConfig m_recordedConfig;
+
+  // The last few minutes of input, if `REPLAY_BUFFER` is not 0.
+  // Otherwise it is not open.
+  ReplayBuffer m_replayBuffer;
+
+  // Collects samples while calibrating the stick thresholds.
+  StickCalibrator m_calibrator;
+
+  // True if calibration turned on the text display to show its
+  // instructions.  Then `m_config.m_showText` is not the user's
+  // setting: it is not saved, and is turned off when calibration ends.
+  bool m_calibrationForcedText;
+
+  // Watches the resting positions of the sticks.
+  StickDriftTracker m_driftTracker;
 
   // Last point where the mouse was seen pressed.
   POINT m_lastDragPoint;
@@ -142,52 +266,21 @@ public:      // methods
   // Destroy the device-independent resources.
   void destroyDeviceIndependentResources();
 
-  // Set `m_controllerState` by polling the controller.
+  // Create `m_textFormat` using the configured font size.
+  void createTextFormat();
+
+  // Update `m_inputModel` by polling the controller, or by reading
+  // synthetic input.
   void pollControllerState();
 
-  // Is any button timer currently running?
-  bool isAnyButtonTimerRunning() const;
-
-  // Current state of buttons, etc.
-  XINPUT_STATE const &inputState() const;
-
-  // If the dodge invulnerability timer is active, return the number of
-  // milliseconds since its timer started.  Otherwise return 0.
-  DWORD dodgeInvulnerabilityTimerElapsedMS() const;
-
-  // Is the invulnerability effect active according to the timer and
-  // config?
-  //
-  // This is our best guess, based only on dodge button release events,
-  // whether the player should be invulnerable right now.  It can be
-  // wrong for many reasons, but should be more convenient, when
-  // reviewing recordings, than manually counting frames.
-  //
-  bool isDodgeInvulnerabilityActive() const;
-
-  // If the parry timer is active, return the number of milliseconds
-  // since its.  Otherwise return 0.
-  DWORD parryTimerElapsedMS() const;
-
-  // Is the parry effect active according to the timer and config?
-  bool isParryActive() const;
-
-  // Evaulate the current dodge timer value and classify it as being a
-  // certain number of frames before, after, or during the
-  // invulnerability window, returning that classification as a string.
-  // Also set `active` to true if invulnerability is active, and false
-  // otherwise.
-  //
-  // This is meant to be meaningful when reviewing a recording and
-  // examining the frame on which damage was taken (or would have been).
-  //
-  std::wstring dodgeAccuracyString(bool &active /*OUT*/) const;
-
-  // Evaluate the current parry timer value as a parry accuracy
-  // assessment, under the assumption that the frame we are showing is
-  // the frame where either damage was received (for a failed parry) or
-  // the game registered a successful parry.
-  std::wstring parryAccuracyString() const;
+  // Return the display refresh rate, or a default if it is unknown.
+  int getDisplayRefreshHz() const;
+
+  // Start the timers that drive polling and presenting.
+  void startTimers();
+
+  // Snapshot the input into `m_presentedModel` and repaint.
+  void present();
 
   // Return the client rectangle size as a D2D1_SIZE_U.
   D2D1_SIZE_U getClientRectSizeU() const;
@@ -216,88 +309,22 @@ public:      // methods
   // Handle `WM_PAINT`.
   void onPaint();
 
-  // Draw the controller state on `m_renderTarget`.
-  void drawControllerState();
-
-  // Draw a centered circle mostly filling the box.
-  void drawCircle(D2D1_MATRIX_3X2_F transform, bool fill);
-
-  // Draw a circle centered at (x,y) with radius (r).
-  void drawCircleAt(
-    D2D1_MATRIX_3X2_F transform,
-    float x,
-    float y,
-    float r,
-    bool fill);
-
-  // Draw a square in the box.
-  void drawSquare(
-    D2D1_MATRIX_3X2_F transform,
-    GVColorRole color,
-    float margin,
-    bool fill);
-
-  // Draw a square that is filled, from the bottom, by `fillAmount`.
-  // `fillHR` is the horizontal radius of the filled portion, where 1.0
-  // represents filling the box completely.
-  //
-  // The square is drawn `margin` proportional units inside the edges of
-  // `transform`.
-  void drawPartiallyFilledSquare(
-    D2D1_MATRIX_3X2_F transform,
-    GVColorRole color,
-    float margin,
-    float fillAmount,
-    float fillHR);
-
-  // Draw a line from (x1,y1) to (x2,y2).
-  void drawLine(
-    D2D1_MATRIX_3X2_F transform,
-    float x1,
-    float y1,
-    float x2,
-    float y2,
-    GVColorRole color);
-
-  // Draw `str` with its upper-left corner at `textCursor`, painting the
-  // actually used region with `bgColorRole` first.
-  void drawTextWithBackground(
-    std::wstring const &str,
-    D2D1_POINT_2F const &textCursor,
-    GVColorRole bgColorRole);
-
-  // Draw the round face buttons.
-  void drawRoundButtons(D2D1_MATRIX_3X2_F transform);
-
-  // Draw the dpad buttons.
-  void drawDPadButtons(D2D1_MATRIX_3X2_F transform);
-
-  // Draw the left or right shoulder button and trigger.
-  void drawShoulderButtons(D2D1_MATRIX_3X2_F transform, bool leftSide);
-
-  // Draw the parry timer.
-  void drawParryTimer(D2D1_MATRIX_3X2_F transform);
-
-  // Draw one of the sticks.
-  void drawStick(D2D1_MATRIX_3X2_F transform, bool leftSide);
-
-  // Draw the speed indicator on the left thumb.
-  void drawSpeedIndicator(
-    D2D1_MATRIX_3X2_F transform,
-    float spotX,
-    float spotY,
-    float angleRadians,
-    int speed);
-
-  // Draw a up-pointing chevron in the nominal box.  Offset its Y
-  // coordinate by `dy`.
-  void drawChevron(D2D1_MATRIX_3X2_F transform, float dy);
-
-  // Draw one of the select/start buttons.
-  void drawSelStartButton(D2D1_MATRIX_3X2_F transform, bool leftSide);
-
-  // Draw the central filled circle.
-  void drawCentralCircle(D2D1_MATRIX_3X2_F transform);
+  // Handle `WM_PAINT` when using D2D.
+  void onPaintD2D();
+
+  // Handle `WM_PAINT` when using the CPU rasterizer.
+  void onPaintRaster();
+
+  // Point `m_d2dCanvas` at `target` and the current D2D resources.
+  void prepareD2DCanvas(ID2D1RenderTarget *target);
+
+  // If the D2D static layer does not match the current size and
+  // configuration, (re)draw it.  Return false if that fails, in which
+  // case there is no layer.
+  bool updateD2DStaticLayer();
+
+  // Set `m_painter.m_extraDebugText` to describe the drawing work.
+  void setPaintStatsText(bool usingStaticLayer);
 
   // Cause a repaint event that will redraw the entire window.
   void invalidateAllPixels();
@@ -332,6 +359,60 @@ public:      // methods
   // Toggle whether we show the text.
   void toggleShowText();
 
+  // Toggle the frame profiler and its overlay.
+  void toggleFrameProfiler();
+
+  // Start or stop recording the controller input to a file.
+  void toggleRecording();
+
+  // Start recording to a new file in the current directory, named after
+  // the current time.
+  void startRecording();
+
+  // Finish the current recording, if any.
+  void stopRecording();
+
+  // Open `m_replayBuffer` if `g_replayBufferMinutes` is positive.
+  void startReplayBuffer();
+
+  // Start saving the contents of `m_replayBuffer` to a new recording
+  // file in the current directory, named after the current time.
+  void saveReplay();
+
+  // Report the outcome of `saveReplay` once it has finished.
+  void checkReplaySaved();
+
+  // If recording, and the configuration has changed in a way that
+  // matters to a replay, write it to the recording.
+  void recordConfigIfChanged();
+
+  // Start calibrating the stick thresholds, or if already doing so,
+  // skip to the next step.
+  void advanceCalibration();
+
+  // Store the calibration result in `m_config` and log it.
+  void finishCalibration();
+
+  // Stop calibrating without changing the thresholds.
+  void cancelCalibration();
+
+  // Undo the display changes made for calibration.
+  void endCalibration();
+
+  // Log any finished `m_driftTracker` intervals.
+  void logDrift();
+
+  // Append `text`, prefixed with the current time, to the calibration
+  // log file.  This is done on the persister's thread if there is one.
+  void appendCalibrationLog(std::string const &text);
+
+  // Append a summary of this session's rates and latencies to the
+  // session log file.
+  void logSessionStats();
+
+  // Write the trace rings to a new file in the current directory.
+  void dumpTrace();
+
   // Toggle whether this window is topmost.
   void toggleTopmost();
 
@@ -347,18 +428,55 @@ public:      // methods
   // Toggle whether to show the dodge invulnerability timer.
   void toggleShowDodgeInvulnerabilityTimer();
 
+  // Switch to the next timing profile in the configuration.
+  void selectNextProfile();
+
   // Return the name of the file in which configuration information is
   // stored.
   std::string getConfigFilename() const;
 
   // Attempt to read the configuration from the file.  If the file does
   // not exist, skip it.  If it does, but there is an error, print a
-  // tracing message but continue.
-  void loadConfiguration();
+  // tracing message but continue.  Return true if the file was read
+  // without error.
+  bool loadConfiguration();
+
+  // Attempt to write the current configuration to the file, and stop
+  // `m_configPersister`.  On error, print a tracing message but keep
+  // going.
+  void saveConfiguration();
+
+  // Start `m_configPersister` unless disabled by
+  // `g_configSaveDelayMS`.  `loaded` is what `loadConfiguration`
+  // returned.
+  void startConfigPersister(bool loaded);
+
+  // If `m_config` has changed since it was last submitted to
+  // `m_configPersister`, submit it.
+  void submitConfigIfChanged();
+
+  // Start `m_configWatcher` unless disabled by `g_configWatchMode`.
+  void startConfigWatcher();
+
+  // If `m_configWatcher` has loaded a new configuration, switch to it.
+  void checkForConfigUpdate();
+
+  // Open `m_inputPublisher` if `g_publishInputName` is set.
+  void startInputPublisher();
+
+  // Publish the state of `m_inputModel` with `m_inputPublisher`.
+  void publishInputState();
+
+  // Create and start `m_eventStream` if `g_eventStreamPath` is set.
+  void startEventStream();
+
+  // Send the events of the latest `m_inputModel` update, if any, to
+  // `m_eventStream`.
+  void publishInputEvents();
 
-  // Attempt to write the current configuration to the file.  On error,
-  // print a tracing message but keep going.
-  void saveConfiguration() const;
+  // Switch to `newConfig`, except for the window position and size,
+  // and update whatever depends on the settings that changed.
+  void applyConfig(GPVConfig const &newConfig);
 
   // Handle `WM_WINDOWPOSCHANGED`.
   void onWindowPosChanged(WINDOWPOS const *wp);
@@ -0,0 +1,144 @@
+// geometry.cc
+// Code for `geometry` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "geometry.h"                  // this module
+
+#include <cmath>                       // std::{cos, sin}
+
+
+// This should go someplace else...
+static float const c_pi = 3.1415926535897932384626433832795;
+
+
+// ------------------------------ RectF --------------------------------
+bool RectF::operator==(RectF const &obj) const
+{
+  return m_left   == obj.m_left &&
+         m_top    == obj.m_top &&
+         m_right  == obj.m_right &&
+         m_bottom == obj.m_bottom;
+}
+
+
+// ---------------------------- Matrix3x2 ------------------------------
+Matrix3x2::Matrix3x2()
+  : m_11(1), m_12(0),
+    m_21(0), m_22(1),
+    m_31(0), m_32(0)
+{}
+
+
+Matrix3x2::Matrix3x2(float m11, float m12,
+                     float m21, float m22,
+                     float m31, float m32)
+  : m_11(m11), m_12(m12),
+    m_21(m21), m_22(m22),
+    m_31(m31), m_32(m32)
+{}
+
+
+/*static*/ Matrix3x2 Matrix3x2::identity()
+{
+  return Matrix3x2();
+}
+
+
+/*static*/ Matrix3x2 Matrix3x2::scale(float sx, float sy)
+{
+  return Matrix3x2(sx, 0,
+                   0,  sy,
+                   0,  0);
+}
+
+
+/*static*/ Matrix3x2 Matrix3x2::translation(float dx, float dy)
+{
+  return Matrix3x2(1,  0,
+                   0,  1,
+                   dx, dy);
+}
+
+
+/*static*/ Matrix3x2 Matrix3x2::rotation(float degrees, Point2F center)
+{
+  float radians = degrees * c_pi / 180.0f;
+  return rotationCS(std::cos(radians), std::sin(radians), center);
+}
+
+
+/*static*/ Matrix3x2 Matrix3x2::rotationCS(float c, float s, Point2F center)
+{
+  // Translate `center` to the origin, rotate, then translate back.
+  return Matrix3x2(
+     c,  s,
+    -s,  c,
+    center.m_x - center.m_x*c + center.m_y*s,
+    center.m_y - center.m_x*s - center.m_y*c);
+}
+
+
+Matrix3x2 Matrix3x2::operator*(Matrix3x2 const &b) const
+{
+  return Matrix3x2(
+    m_11*b.m_11 + m_12*b.m_21,
+    m_11*b.m_12 + m_12*b.m_22,
+
+    m_21*b.m_11 + m_22*b.m_21,
+    m_21*b.m_12 + m_22*b.m_22,
+
+    m_31*b.m_11 + m_32*b.m_21 + b.m_31,
+    m_31*b.m_12 + m_32*b.m_22 + b.m_32);
+}
+
+
+bool Matrix3x2::operator==(Matrix3x2 const &obj) const
+{
+  return m_11 == obj.m_11 && m_12 == obj.m_12 &&
+         m_21 == obj.m_21 && m_22 == obj.m_22 &&
+         m_31 == obj.m_31 && m_32 == obj.m_32;
+}
+
+
+Point2F Matrix3x2::transformPoint(Point2F p) const
+{
+  return Point2F(p.m_x*m_11 + p.m_y*m_21 + m_31,
+                 p.m_x*m_12 + p.m_y*m_22 + m_32);
+}
+
+
+Point2F Matrix3x2::transformVector(Point2F v) const
+{
+  return Point2F(v.m_x*m_11 + v.m_y*m_21,
+                 v.m_x*m_12 + v.m_y*m_22);
+}
+
+
+float Matrix3x2::determinant() const
+{
+  return m_11*m_22 - m_12*m_21;
+}
+
+
+Matrix3x2 Matrix3x2::inverse() const
+{
+  float det = determinant();
+  if (det == 0) {
+    return Matrix3x2(0,0, 0,0, 0,0);
+  }
+
+  float inv11 =  m_22 / det;
+  float inv12 = -m_12 / det;
+  float inv21 = -m_21 / det;
+  float inv22 =  m_11 / det;
+
+  return Matrix3x2(
+    inv11, inv12,
+    inv21, inv22,
+    -(m_31*inv11 + m_32*inv21),
+    -(m_31*inv12 + m_32*inv22));
+}
+
+
+// EOF
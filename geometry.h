@@ -0,0 +1,120 @@
+// geometry.h
+// `Point2F`, `RectF`, and `Matrix3x2`, simple 2D geometry types.
+
+// See license.txt for copyright and terms of use.
+
+// These mirror the Direct2D types of the same general shape, but do not
+// depend on `windows.h`, so the drawing code can also run against the
+// CPU rasterizer on any platform.
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+
+// A point, or a vector, in 2D.
+class Point2F {
+public:      // data
+  float m_x;
+  float m_y;
+
+public:      // methods
+  Point2F()
+    : m_x(0),
+      m_y(0)
+  {}
+
+  Point2F(float x, float y)
+    : m_x(x),
+      m_y(y)
+  {}
+};
+
+
+// Axis-aligned rectangle.  Like `D2D1_RECT_F`, this is given by its
+// edges rather than a corner and a size.
+class RectF {
+public:      // data
+  float m_left;
+  float m_top;
+  float m_right;
+  float m_bottom;
+
+public:      // methods
+  RectF()
+    : m_left(0),
+      m_top(0),
+      m_right(0),
+      m_bottom(0)
+  {}
+
+  RectF(float left, float top, float right, float bottom)
+    : m_left(left),
+      m_top(top),
+      m_right(right),
+      m_bottom(bottom)
+  {}
+
+  float width() const { return m_right - m_left; }
+  float height() const { return m_bottom - m_top; }
+
+  bool operator==(RectF const &obj) const;
+  bool operator!=(RectF const &obj) const
+    { return !operator==(obj); }
+};
+
+
+// 2D affine transformation.  This has the same layout and conventions
+// as `D2D1_MATRIX_3X2_F`: points are row vectors multiplied on the
+// left, so `A * B` means "apply A, then B".
+class Matrix3x2 {
+public:      // data
+  float m_11, m_12;
+  float m_21, m_22;
+  float m_31, m_32;
+
+public:      // methods
+  // Identity.
+  Matrix3x2();
+
+  Matrix3x2(float m11, float m12,
+            float m21, float m22,
+            float m31, float m32);
+
+  static Matrix3x2 identity();
+
+  // Scale about the origin.
+  static Matrix3x2 scale(float sx, float sy);
+
+  static Matrix3x2 translation(float dx, float dy);
+
+  // Rotate by `degrees` around `center`.  As with D2D, in a coordinate
+  // system where Y points down, positive angles rotate clockwise.
+  static Matrix3x2 rotation(float degrees, Point2F center);
+
+  // Rotate around `center` by the angle whose cosine is `c` and sine is
+  // `s`.  This lets callers that already have a direction vector avoid
+  // a round trip through `atan2`.
+  static Matrix3x2 rotationCS(float c, float s, Point2F center);
+
+  // Compose: `*this` followed by `obj`.
+  Matrix3x2 operator*(Matrix3x2 const &obj) const;
+
+  bool operator==(Matrix3x2 const &obj) const;
+  bool operator!=(Matrix3x2 const &obj) const
+    { return !operator==(obj); }
+
+  // Apply the transformation to a point.
+  Point2F transformPoint(Point2F p) const;
+
+  // Apply only the linear part, as is appropriate for a vector.
+  Point2F transformVector(Point2F v) const;
+
+  float determinant() const;
+
+  // Return the inverse.  If the matrix is singular, return a matrix
+  // that maps everything to the origin.
+  Matrix3x2 inverse() const;
+};
+
+
+#endif // GEOMETRY_H
@@ -0,0 +1,463 @@
+// gpv-archive.cc
+// Command-line tool to convert recordings to session archives and
+// query them.
+
+// See license.txt for copyright and terms of use.
+
+// `gpv-archive convert IN OUT` converts input recording IN to session
+// archive OUT (see session-archive.h), a block at a time.
+//
+// `gpv-archive query FILE` prints the samples of archive FILE that
+// satisfy the conditions given as options, using the zone maps to skip
+// blocks that cannot contain any.  For example, to find every press of
+// the left trigger past 30 during the first hour while the right
+// shoulder button was held, run, as one command:
+//
+//   gpv-archive --where lt=31:255 --where time=0:3600000
+//     --held right_shoulder --presses query session.gpvcol
+//
+// `gpv-archive scan FILE` answers the same query by decoding input
+// recording FILE from start to end, and prints the same lines, to
+// check `query` and to compare how long they take.
+
+#include "controller-state.h"          // xinputButtonFromName, etc.
+#include "input-recording.h"           // InputRecordingReader
+#include "session-archive.h"           // SessionArchive{Reader,Writer}
+
+#include <cerrno>                      // errno
+#include <cstdint>                     // std::{int64_t, uint64_t}
+#include <cstdlib>                     // std::{exit, strtoll}
+#include <cstring>                     // std::{strcmp, strerror}
+#include <fstream>                     // std::{ifstream, ofstream}
+#include <iostream>                    // std::{cerr, cout}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Command line options.
+class ArchiveOptions {
+public:      // data
+  // "convert", "query", or "scan".
+  std::string m_command;
+
+  // File names after the command.
+  std::vector<std::string> m_files;
+
+  // Conditions a sample must satisfy.  Those on `AC_TIME` are in
+  // milliseconds since the first sample.
+  std::vector<ArchivePredicate> m_predicates;
+
+  // If true, only report the first sample of each run of matching
+  // samples.
+  bool m_presses;
+
+  // If true, only print the number of matches.
+  bool m_count;
+
+public:      // methods
+  ArchiveOptions()
+    : m_command(),
+      m_files(),
+      m_predicates(),
+      m_presses(false),
+      m_count(false)
+  {}
+};
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-archive [options] convert IN OUT\n"
+    "       gpv-archive [options] query FILE\n"
+    "       gpv-archive [options] scan FILE\n"
+    "\n"
+    "convert: Convert input recording IN to session archive OUT.\n"
+    "\n"
+    "query: Print the number and time of each sample in archive FILE\n"
+    "that satisfies all of the conditions.\n"
+    "\n"
+    "scan: Same as query, but by decoding all of input recording FILE.\n"
+    "\n"
+    "options:\n"
+    "  --where COL=MIN:MAX Column COL must be between MIN and MAX.\n"
+    "                      Columns: time (ms since the first sample),\n"
+    "                      connected, packet, lt, rt, lx, ly, rx, ry.\n"
+    "  --held B[,B...]     Buttons that must be held, like a or\n"
+    "                      left_shoulder.\n"
+    "  --released B[,B...] Buttons that must be released.\n"
+    "  --presses           Only the first sample of each run of matches.\n"
+    "  --count             Only print the number of matches.\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-archive: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+// Parse an integer that must make up all of `s`.
+static std::int64_t parseInteger(std::string const &s)
+{
+  char *end;
+  std::int64_t v = std::strtoll(s.c_str(), &end, 10);
+  if (s.empty() || *end) {
+    std::cerr << "gpv-archive: not an integer: \"" << s << "\"\n";
+    usage();
+  }
+  return v;
+}
+
+
+// Parse `--where COL=MIN:MAX`.
+static ArchivePredicate parseWhere(char const *arg)
+{
+  std::string s(arg);
+  std::size_t eq = s.find('=');
+  std::size_t colon = s.find(':', eq);
+  if (eq == std::string::npos || colon == std::string::npos) {
+    std::cerr << "gpv-archive: --where requires COL=MIN:MAX\n";
+    usage();
+  }
+
+  ArchiveColumn column = archiveColumnFromName(s.substr(0, eq).c_str());
+  if (column == NUM_ARCHIVE_COLUMNS || column == AC_BUTTONS) {
+    std::cerr << "gpv-archive: unknown column: "
+              << s.substr(0, eq) << "\n";
+    usage();
+  }
+  return ArchivePredicate(column,
+                          parseInteger(s.substr(eq+1, colon-eq-1)),
+                          parseInteger(s.substr(colon+1)));
+}
+
+
+// Parse a comma-separated list of button names into a mask.
+static int parseButtons(char const *arg)
+{
+  int mask = 0;
+  std::string s(arg);
+  std::size_t start = 0;
+  while (start <= s.size()) {
+    std::size_t comma = s.find(',', start);
+    if (comma == std::string::npos) {
+      comma = s.size();
+    }
+    std::string name = s.substr(start, comma - start);
+    int button = xinputButtonFromName(name.c_str());
+    if (!button) {
+      std::cerr << "gpv-archive: unknown button: \"" << name << "\"\n";
+      usage();
+    }
+    mask |= button;
+    start = comma+1;
+  }
+  return mask;
+}
+
+
+static void parseOptions(ArchiveOptions &opts, int argc, char **argv)
+{
+  int held = 0;
+  int released = 0;
+
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--where")) {
+      opts.m_predicates.push_back(parseWhere(optionArg(argc, argv, i)));
+    }
+    else if (0==std::strcmp(arg, "--held")) {
+      held |= parseButtons(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--released")) {
+      released |= parseButtons(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--presses")) {
+      opts.m_presses = true;
+    }
+    else if (0==std::strcmp(arg, "--count")) {
+      opts.m_count = true;
+    }
+    else if (arg[0] == '-') {
+      std::cerr << "gpv-archive: unknown option: " << arg << "\n";
+      usage();
+    }
+    else if (opts.m_command.empty()) {
+      opts.m_command = arg;
+    }
+    else {
+      opts.m_files.push_back(arg);
+    }
+  }
+
+  if (held || released) {
+    opts.m_predicates.push_back(
+      ArchivePredicate(AC_BUTTONS, held, 0xFFFF & ~released));
+  }
+
+  std::size_t numFiles = opts.m_command == "convert"? 2 : 1;
+  if ((opts.m_command != "convert" && opts.m_command != "query" &&
+       opts.m_command != "scan") ||
+      opts.m_files.size() != numFiles) {
+    usage();
+  }
+}
+
+
+// Open `fname` for reading, or print an error and return false.
+static bool openInput(std::ifstream &in, std::string const &fname)
+{
+  in.open(fname, std::ios::binary);
+  if (!in) {
+    std::cerr << fname << ": " << std::strerror(errno) << "\n";
+    return false;
+  }
+  return true;
+}
+
+
+// ------------------------------ convert ------------------------------
+static int convert(ArchiveOptions const &opts)
+{
+  std::string const &inFname = opts.m_files[0];
+  std::string const &outFname = opts.m_files[1];
+
+  std::ifstream in;
+  if (!openInput(in, inFname)) {
+    return 2;
+  }
+  InputRecordingReader reader(in);
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    std::cerr << inFname << ": " << error << "\n";
+    return 2;
+  }
+
+  std::ofstream out(outFname, std::ios::binary);
+  if (!out) {
+    std::cerr << outFname << ": " << std::strerror(errno) << "\n";
+    return 2;
+  }
+  SessionArchiveWriter writer(out);
+  writer.writeHeader();
+
+  std::uint64_t start = steadyClockUS();
+  while (reader.readSample()) {
+    writer.writeSample(reader.m_state);
+  }
+  if (!reader.m_error.empty()) {
+    std::cerr << inFname << ": " << reader.m_error << "\n";
+    return 2;
+  }
+  writer.finish();
+  std::uint64_t elapsedUS = steadyClockUS() - start;
+
+  std::uint64_t outSize = (std::uint64_t)out.tellp();
+  out.close();
+  if (!out) {
+    std::cerr << outFname << ": write failed\n";
+    return 2;
+  }
+
+  std::cout << outFname << ": " << writer.m_sampleCount << " samples in "
+            << writer.m_blockCount << " blocks, " << outSize
+            << " bytes, in " << elapsedUS / 1000 << " ms\n";
+  return 0;
+}
+
+
+// ------------------------------- query -------------------------------
+// Reports the matching samples.
+class MatchPrinter {
+public:      // data
+  ArchiveOptions const &m_opts;
+
+  // Number of matches.
+  long m_matches;
+
+  // True if the previous sample matched.
+  bool m_prevMatched;
+
+public:      // methods
+  explicit MatchPrinter(ArchiveOptions const &opts)
+    : m_opts(opts),
+      m_matches(0),
+      m_prevMatched(false)
+  {}
+
+  // Note whether sample `sample`, taken `timeMS` after the first,
+  // matched.
+  void sample(bool matched, long sample, std::int64_t timeMS)
+  {
+    if (matched && !(m_opts.m_presses && m_prevMatched)) {
+      m_matches++;
+      if (!m_opts.m_count) {
+        std::cout << sample << " " << timeMS << "\n";
+      }
+    }
+    m_prevMatched = matched;
+  }
+
+  // Report the total, along with `how` the query went.
+  void finish(std::string const &how, std::uint64_t elapsedUS)
+  {
+    std::cout << m_matches << " matches\n";
+    std::cerr << how << " in " << elapsedUS / 1000 << " ms\n";
+  }
+};
+
+
+static int query(ArchiveOptions const &opts)
+{
+  std::string const &fname = opts.m_files[0];
+  std::ifstream in;
+  if (!openInput(in, fname)) {
+    return 2;
+  }
+  SessionArchiveReader reader(in);
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return 2;
+  }
+
+  std::uint64_t start = steadyClockUS();
+
+  // Only the columns the query needs are decoded.
+  unsigned columnMask = 1u << AC_TIME;
+  for (ArchivePredicate const &pred : opts.m_predicates) {
+    columnMask |= 1u << pred.m_column;
+  }
+
+  // Times are relative to the first sample, which is not known until
+  // the first block is read, so that one is never skipped.
+  std::vector<ArchivePredicate> predicates(opts.m_predicates);
+  std::int64_t firstTimeMS = 0;
+
+  MatchPrinter printer(opts);
+  while (reader.nextBlock()) {
+    if (reader.m_blocksSeen > 1 && !reader.blockMayMatch(predicates)) {
+      // No sample in the block matches, including the last.
+      printer.m_prevMatched = false;
+      continue;
+    }
+    if (!reader.readColumns(columnMask)) {
+      break;
+    }
+
+    std::vector<std::int64_t> const &times = reader.m_values[AC_TIME];
+    if (reader.m_blocksSeen == 1) {
+      firstTimeMS = times[0];
+      for (ArchivePredicate &pred : predicates) {
+        if (pred.m_column == AC_TIME) {
+          pred.m_min += firstTimeMS;
+          pred.m_max += firstTimeMS;
+        }
+      }
+    }
+
+    for (int s=0; s < reader.m_blockSamples; ++s) {
+      bool matched = true;
+      for (ArchivePredicate const &pred : predicates) {
+        if (!pred.matches(reader.m_values[pred.m_column][s])) {
+          matched = false;
+          break;
+        }
+      }
+      printer.sample(matched, reader.m_firstSample + s,
+                     times[s] - firstTimeMS);
+    }
+  }
+  if (!reader.m_error.empty()) {
+    std::cerr << fname << ": " << reader.m_error << "\n";
+    return 2;
+  }
+
+  printer.finish("decoded " + std::to_string(reader.m_blocksRead) +
+                   " of " + std::to_string(reader.m_blocksSeen) +
+                   " blocks",
+                 steadyClockUS() - start);
+  return 0;
+}
+
+
+// ------------------------------- scan --------------------------------
+static int scan(ArchiveOptions const &opts)
+{
+  std::string const &fname = opts.m_files[0];
+  std::ifstream in;
+  if (!openInput(in, fname)) {
+    return 2;
+  }
+  InputRecordingReader reader(in);
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return 2;
+  }
+
+  std::uint64_t start = steadyClockUS();
+  std::vector<ArchivePredicate> predicates(opts.m_predicates);
+  std::int64_t firstTimeMS = 0;
+
+  MatchPrinter printer(opts);
+  while (reader.readSample()) {
+    ControllerState const &state = reader.m_state;
+    if (reader.m_sampleCount == 1) {
+      firstTimeMS = state.m_pollTimeMS;
+      for (ArchivePredicate &pred : predicates) {
+        if (pred.m_column == AC_TIME) {
+          pred.m_min += firstTimeMS;
+          pred.m_max += firstTimeMS;
+        }
+      }
+    }
+
+    bool matched = true;
+    for (ArchivePredicate const &pred : predicates) {
+      if (!pred.matches(archiveColumnValue(state, pred.m_column))) {
+        matched = false;
+        break;
+      }
+    }
+    printer.sample(matched, reader.m_sampleCount - 1,
+                   state.m_pollTimeMS - firstTimeMS);
+  }
+  if (!reader.m_error.empty()) {
+    std::cerr << fname << ": " << reader.m_error << "\n";
+    return 2;
+  }
+
+  printer.finish("decoded " + std::to_string(reader.m_sampleCount) +
+                   " samples",
+                 steadyClockUS() - start);
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  ArchiveOptions opts;
+  parseOptions(opts, argc, argv);
+
+  if (opts.m_command == "convert") {
+    return convert(opts);
+  }
+  else if (opts.m_command == "query") {
+    return query(opts);
+  }
+  else {
+    return scan(opts);
+  }
+}
+
+
+// EOF
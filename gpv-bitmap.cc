@@ -0,0 +1,340 @@
+// gpv-bitmap.cc
+// Command-line tool to build and query bitmap indexes of recordings.
+
+// See license.txt for copyright and terms of use.
+
+// `gpv-bitmap build REC OUT` writes the bitmap index (see
+// bitmap-index.h) of input recording REC to OUT.
+//
+// `gpv-bitmap query INDEX EXPR` prints how many samples satisfy EXPR,
+// and with `--list`, their numbers.
+//
+// `gpv-bitmap bench REC [EXPR...]` indexes REC in memory, then times
+// each query both with the bitmaps and by a linear scan over the
+// samples, and checks that they agree.  It exits with status 1 if not.
+
+#include "bitmap-index.h"              // BitmapIndex, BitmapQuery
+#include "controller-state.h"          // steadyClockUS
+#include "input-recording.h"           // InputRecordingReader
+
+#include <algorithm>                   // std::sort
+#include <cerrno>                      // errno
+#include <cstdint>                     // std::{uint32_t, uint64_t}
+#include <cstdlib>                     // std::{atoi, exit}
+#include <cstring>                     // std::{strcmp, strerror}
+#include <fstream>                     // std::{ifstream, ofstream}
+#include <iostream>                    // std::{cerr, cout}
+#include <iterator>                    // std::istreambuf_iterator
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Queries `bench` runs if none are given.
+static char const * const s_defaultQueries[] = {
+  "right_shoulder - b",
+  "left_trigger & !right_stick",
+  "(a | b | x | y) & left_run",
+  "left_shoulder & right_shoulder - left_sprint",
+  "!connected | start",
+};
+
+
+// Command line options.
+class BitmapOptions {
+public:      // data
+  // "build", "query", or "bench".
+  std::string m_command;
+
+  // Arguments after the command.
+  std::vector<std::string> m_args;
+
+  // For "query", print the matching sample numbers.
+  bool m_list;
+
+  // For "bench", how many times to run each query.
+  int m_repeat;
+
+public:      // methods
+  BitmapOptions()
+    : m_command(),
+      m_args(),
+      m_list(false),
+      m_repeat(20)
+  {}
+};
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-bitmap [options] build REC OUT\n"
+    "       gpv-bitmap [options] query INDEX EXPR\n"
+    "       gpv-bitmap [options] bench REC [EXPR...]\n"
+    "\n"
+    "build: Write the bitmap index of input recording REC to OUT.\n"
+    "\n"
+    "query: Print the number of samples that satisfy EXPR, like\n"
+    "\"right_shoulder - b\" (R1 held and B released).  Operators are\n"
+    "| (or), & (and), - (and not), ! (not), and parentheses.\n"
+    "\n"
+    "bench: Time queries with the bitmaps and by scanning the samples.\n"
+    "\n"
+    "options:\n"
+    "  --list              For query, also print the sample numbers.\n"
+    "  --repeat N          For bench, runs of each query (default: 20).\n";
+  std::exit(2);
+}
+
+
+static void parseOptions(BitmapOptions &opts, int argc, char **argv)
+{
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--list")) {
+      opts.m_list = true;
+    }
+    else if (0==std::strcmp(arg, "--repeat")) {
+      if (i+1 >= argc) {
+        usage();
+      }
+      opts.m_repeat = std::atoi(argv[++i]);
+    }
+    else if (arg[0] == '-' && arg[1] == '-') {
+      std::cerr << "gpv-bitmap: unknown option: " << arg << "\n";
+      usage();
+    }
+    else if (opts.m_command.empty()) {
+      opts.m_command = arg;
+    }
+    else {
+      opts.m_args.push_back(arg);
+    }
+  }
+
+  if (!((opts.m_command == "build" && opts.m_args.size() == 2) ||
+        (opts.m_command == "query" && opts.m_args.size() == 2) ||
+        (opts.m_command == "bench" && opts.m_args.size() >= 1))) {
+    usage();
+  }
+  if (opts.m_repeat <= 0) {
+    std::cerr << "gpv-bitmap: --repeat must be positive\n";
+    usage();
+  }
+}
+
+
+// Decode recording `fname`, appending the terms of each sample to
+// `terms`.  Return false after printing an error if that fails.
+static bool readRecordingTerms(std::string const &fname,
+                               std::vector<std::uint32_t> &terms /*OUT*/)
+{
+  std::ifstream in(fname, std::ios::binary);
+  if (!in) {
+    std::cerr << fname << ": " << std::strerror(errno) << "\n";
+    return false;
+  }
+  InputRecordingReader reader(in);
+  std::string error = reader.readHeader();
+  if (error.empty()) {
+    while (reader.readSample()) {
+      terms.push_back(sampleTerms(reader.m_state,
+                                  reader.m_config.m_analogThresholds));
+    }
+    error = reader.m_error;
+  }
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return false;
+  }
+  return true;
+}
+
+
+// Parse `text` into `query`, or print an error and return false.
+static bool parseQuery(BitmapQuery &query, std::string const &text)
+{
+  std::string error = query.parse(text);
+  if (!error.empty()) {
+    std::cerr << "\"" << text << "\": " << error << "\n";
+    return false;
+  }
+  return true;
+}
+
+
+// ------------------------------- build -------------------------------
+static int build(BitmapOptions const &opts)
+{
+  std::string const &inFname = opts.m_args[0];
+  std::string const &outFname = opts.m_args[1];
+
+  std::uint64_t start = steadyClockUS();
+  std::vector<std::uint32_t> terms;
+  if (!readRecordingTerms(inFname, terms)) {
+    return 2;
+  }
+
+  BitmapIndex index;
+  for (std::uint32_t t : terms) {
+    index.add(t);
+  }
+  index.optimize();
+
+  std::string data;
+  index.encode(data);
+  std::ofstream out(outFname, std::ios::binary);
+  out.write(data.data(), data.size());
+  out.close();
+  if (!out) {
+    std::cerr << outFname << ": write failed\n";
+    return 2;
+  }
+
+  std::cout << outFname << ": " << index.m_sampleCount << " samples, "
+            << data.size() << " bytes, in "
+            << (steadyClockUS() - start) / 1000 << " ms\n";
+  return 0;
+}
+
+
+// ------------------------------- query -------------------------------
+static int query(BitmapOptions const &opts)
+{
+  std::string const &fname = opts.m_args[0];
+  BitmapQuery query;
+  if (!parseQuery(query, opts.m_args[1])) {
+    return 2;
+  }
+
+  std::ifstream in(fname, std::ios::binary);
+  if (!in) {
+    std::cerr << fname << ": " << std::strerror(errno) << "\n";
+    return 2;
+  }
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  BitmapIndex index;
+  std::string error = index.decode(data);
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return 2;
+  }
+
+  std::uint64_t start = steadyClockUS();
+  SampleBitmap result = query.evaluate(index);
+  std::uint64_t elapsedUS = steadyClockUS() - start;
+
+  if (opts.m_list) {
+    std::vector<std::uint32_t> samples;
+    result.toVector(samples);
+    for (std::uint32_t s : samples) {
+      std::cout << s << "\n";
+    }
+  }
+  std::cout << result.cardinality() << " of " << index.m_sampleCount
+            << " samples\n";
+  std::cerr << "evaluated in " << elapsedUS << " us\n";
+  return 0;
+}
+
+
+// ------------------------------- bench -------------------------------
+// Return the median of `v`.
+static std::uint64_t median(std::vector<std::uint64_t> v)
+{
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+
+static int bench(BitmapOptions const &opts)
+{
+  std::string const &fname = opts.m_args[0];
+  std::vector<std::string> texts(opts.m_args.begin()+1, opts.m_args.end());
+  if (texts.empty()) {
+    texts.assign(std::begin(s_defaultQueries), std::end(s_defaultQueries));
+  }
+
+  std::vector<BitmapQuery> queries(texts.size());
+  for (std::size_t q=0; q < texts.size(); ++q) {
+    if (!parseQuery(queries[q], texts[q])) {
+      return 2;
+    }
+  }
+
+  std::uint64_t start = steadyClockUS();
+  std::vector<std::uint32_t> terms;
+  if (!readRecordingTerms(fname, terms)) {
+    return 2;
+  }
+  std::uint64_t decodeUS = steadyClockUS() - start;
+
+  start = steadyClockUS();
+  BitmapIndex index;
+  for (std::uint32_t t : terms) {
+    index.add(t);
+  }
+  index.optimize();
+  std::uint64_t buildUS = steadyClockUS() - start;
+
+  std::cout << fname << ": " << terms.size() << " samples, decoded in "
+            << decodeUS / 1000 << " ms\n"
+            << "index: " << index.sizeBytes() << " bytes, built in "
+            << buildUS / 1000 << " ms\n";
+
+  bool allAgree = true;
+  for (std::size_t q=0; q < queries.size(); ++q) {
+    BitmapQuery const &query = queries[q];
+    std::vector<std::uint64_t> bitmapUS, scanUS;
+    SampleBitmap result;
+    std::vector<std::uint32_t> scanned;
+
+    for (int r=0; r < opts.m_repeat; ++r) {
+      start = steadyClockUS();
+      result = query.evaluate(index);
+      bitmapUS.push_back(steadyClockUS() - start);
+
+      scanned.clear();
+      start = steadyClockUS();
+      for (std::uint32_t s=0; s < terms.size(); ++s) {
+        if (query.matches(terms[s])) {
+          scanned.push_back(s);
+        }
+      }
+      scanUS.push_back(steadyClockUS() - start);
+    }
+
+    std::vector<std::uint32_t> fromBitmap;
+    result.toVector(fromBitmap);
+    bool agree = fromBitmap == scanned;
+    allAgree = allAgree && agree;
+
+    std::cout << "\"" << texts[q] << "\": " << fromBitmap.size()
+              << " samples; bitmap " << median(bitmapUS)
+              << " us, scan " << median(scanUS) << " us"
+              << (agree? "" : "; RESULTS DIFFER") << "\n";
+  }
+
+  return allAgree? 0 : 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  BitmapOptions opts;
+  parseOptions(opts, argc, argv);
+
+  if (opts.m_command == "build") {
+    return build(opts);
+  }
+  else if (opts.m_command == "query") {
+    return query(opts);
+  }
+  else {
+    return bench(opts);
+  }
+}
+
+
+// EOF
@@ -0,0 +1,121 @@
+// gpv-config-bench.cc
+// Benchmarks for `gpv-config` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "gpv-config.h"                // module under test
+
+#include "alloc-audit.h"               // AllocAuditScope
+#include "bench.h"                     // BENCHMARK, benchTimeNS, etc.
+#include "json-reader.h"               // JSONReader
+#include "json.hpp"                    // json::JSON
+
+#include <cstdint>                     // std::uint64_t
+#include <fstream>                     // std::ifstream
+#include <iostream>                    // std::cerr
+#include <sstream>                     // std::ostringstream
+#include <string>                      // std::to_string
+
+
+// Allocations made by one call of `f`, as text for `benchReportValue`.
+template <class F>
+static std::string countAllocs(F const &f)
+{
+  if (!allocAuditCompiledIn()) {
+    return "not counted; build with `make ALLOC_AUDIT=1`";
+  }
+  AllocAuditScope audit;
+  f();
+  std::uint64_t n = audit.count();
+  return std::to_string(n);
+}
+
+
+// Load settings from JSON `text` the way `GPVConfig::loadFromFile` did
+// before `JSONReader`: by parsing it into a `json::JSON` tree and then
+// reading that.
+static void loadFromJSONTree(GPVConfig &config, std::string const &text)
+{
+  config.loadFromJSON(json::JSON::Load(text));
+  if (!config.selectProfile(config.m_activeProfile)) {
+    config.m_activeProfile = -1;
+  }
+}
+
+
+// Loading and saving the configuration file, as the viewer does at
+// startup, when the file is edited, and after changes.
+BENCHMARK(configLoadSave)
+{
+  std::string fname = benchTempDir() + "/config.json";
+  GPVConfig config;
+  std::string error = config.saveToFile(fname);
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return;
+  }
+
+  auto load = [&] {
+    GPVConfig loaded;
+    loaded.loadFromFile(fname);
+    benchKeep(loaded);
+  };
+  benchReport("GPVConfig::loadFromFile", benchTimeNS(load));
+  benchReportValue("  allocations", countAllocs(load));
+
+  // Each save writes, syncs, and renames a file, so this mostly
+  // measures the file system.
+  benchReport("GPVConfig::saveToFile", benchTimeNS([&] {
+    config.saveToFile(fname);
+  }, 5e7 /*minBatchNS*/, 5 /*runs*/));
+}
+
+
+// Parsing configuration text with `JSONReader`, compared to building a
+// `json::JSON` tree and reading that, as `loadFromFile` used to.  Each
+// timing profile adds to the file, so this is done with one and
+// with many.
+BENCHMARK(configParse)
+{
+  for (int numProfiles : { 1, 100 }) {
+    GPVConfig config;
+    for (int i = 0; i < numProfiles; ++i) {
+      TimingProfile p;
+      p.m_name = "Profile \"" + std::to_string(i) + "\"";
+      p.m_parryTimer.m_activeStartMS = i;
+      config.m_profiles.push_back(p);
+    }
+    std::string fname = benchTempDir() + "/profiles.json";
+    std::string error = config.saveToFile(fname);
+    if (!error.empty()) {
+      std::cerr << fname << ": " << error << "\n";
+      return;
+    }
+    std::ostringstream oss;
+    oss << std::ifstream(fname).rdbuf();
+    std::string text = oss.str();
+
+    std::string what = std::to_string(numProfiles) + " profiles, " +
+                       std::to_string(text.size()) + " bytes";
+
+    auto domLoad = [&] {
+      GPVConfig loaded;
+      loadFromJSONTree(loaded, text);
+      benchKeep(loaded);
+    };
+    auto readerLoad = [&] {
+      GPVConfig loaded;
+      JSONReader reader(text.data(), text.data() + text.size());
+      loaded.readFromJSON(reader);
+      benchKeep(loaded);
+    };
+
+    benchReport("json::JSON tree, " + what, benchTimeNS(domLoad));
+    benchReportValue("  allocations", countAllocs(domLoad));
+    benchReport("JSONReader, " + what, benchTimeNS(readerLoad));
+    benchReportValue("  allocations", countAllocs(readerLoad));
+  }
+}
+
+
+// EOF
@@ -0,0 +1,111 @@
+// gpv-config-test.cc
+// Tests for `gpv-config` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "gpv-config.h"                // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <fstream>                     // std::ofstream
+
+
+// Write `text` to `fname`.
+static void writeTextFile(std::string const &fname, char const *text)
+{
+  std::ofstream out(fname, std::ios::binary);
+  out << text;
+}
+
+
+// A configuration with some of every kind of field changed.
+static GPVConfig makeNonDefaultConfig()
+{
+  GPVConfig config;
+  config.m_showText = !config.m_showText;
+  config.m_controllerID = 2;
+  config.m_parryTimer.m_durationMS = 900;
+  config.m_parryTimer.m_showElapsedTime = true;
+  config.m_analogThresholds.m_triggerDeadZone = 30;
+  config.m_layoutParams.m_faceButtonsR += 1.5f;
+
+  TimingProfile p;
+  p.m_name = "Buckler \"quick\"";
+  p.m_parryTimer.m_activeStartMS = 100;
+  config.m_profiles.push_back(p);
+  config.m_profiles.push_back(TimingProfile());
+  config.m_profiles.back().m_name = "other";
+  return config;
+}
+
+
+UNIT_TEST(configSaveLoadRoundTrip)
+{
+  std::string fname = unitTestTempDir() + "/round-trip.json";
+  GPVConfig config = makeNonDefaultConfig();
+  EXPECT_EQ(config.saveToFile(fname), "");
+
+  GPVConfig loaded;
+  EXPECT(loaded != config);
+  EXPECT_EQ(loaded.loadFromFile(fname), "");
+  EXPECT(loaded == config);
+  EXPECT_EQ(loaded.m_profiles.at(0).m_name, "Buckler \"quick\"");
+}
+
+
+UNIT_TEST(configLoadIgnoresUnknownKeys)
+{
+  std::string fname = unitTestTempDir() + "/unknown.json";
+  writeTextFile(fname,
+    "{ \"futureOption\": [1, {\"a\": null}], \"controllerID\": 3 }");
+
+  GPVConfig config;
+  EXPECT_EQ(config.loadFromFile(fname), "");
+  EXPECT_EQ(config.m_controllerID, 3);
+}
+
+
+UNIT_TEST(configLoadReportsSyntaxError)
+{
+  std::string fname = unitTestTempDir() + "/bad.json";
+  writeTextFile(fname, "{\n  \"controllerID\": 1,\n  \"showText\" true\n}");
+
+  GPVConfig config;
+  EXPECT_EQ(config.loadFromFile(fname),
+            "line 3: expected ':' after object key");
+
+  // Fields before the error are kept.
+  EXPECT_EQ(config.m_controllerID, 1);
+}
+
+
+UNIT_TEST(configLoadMissingFile)
+{
+  GPVConfig config;
+  EXPECT(!config.loadFromFile(unitTestTempDir() + "/missing.json").empty());
+  EXPECT(config == GPVConfig());
+}
+
+
+UNIT_TEST(configLoadDirectory)
+{
+  // This opens, on Linux, but cannot be read as a file.
+  GPVConfig config;
+  EXPECT(!config.loadFromFile(unitTestTempDir()).empty());
+  EXPECT(config == GPVConfig());
+}
+
+
+UNIT_TEST(configBinaryRoundTrip)
+{
+  GPVConfig config = makeNonDefaultConfig();
+  std::string data;
+  config.encodeBinary(data);
+
+  GPVConfig decoded;
+  EXPECT(decoded.decodeBinary(data.data(), data.data() + data.size()));
+  EXPECT(decoded.diffFields(config).empty());
+}
+
+
+// EOF
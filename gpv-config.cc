@@ -5,549 +5,642 @@
 
 #include "gpv-config.h"                // this module
 
+#include "atomic-file.h"               // writeFileAtomically
+#include "config-fields.h"             // ConfigFieldTable, configField, etc.
+#include "json-reader.h"               // JSONReader
 #include "json.hpp"                    // json::...
 
-#include <windows.h>                   // COLORREF
+#include "windows-compat.h"            // COLORREF, RGB
 
 #include <cerrno>                      // errno
 #include <cstring>                     // std::strerror
-#include <fstream>                     // std::ofstream
-#include <sstream>                     // std::ostringstream
+#include <filesystem>                  // std::filesystem::is_regular_file
+#include <fstream>                     // std::ifstream
+#include <system_error>                // std::error_code
+#include <tuple>                       // std::make_tuple, std::tuple_cat
+#include <vector>                      // std::vector
 
 using json::JSON;
 
 
-// True if `name` of `this` equals the same field in `obj`.
-#define EMEMB(name) (name == obj.name)
+// In a `ConfigFieldTable<C>`, the descriptor for field `m_<name>`,
+// stored under the JSON key "<name>".
+#define FIELD(id, name, dflt) \
+  configField<C>(id, #name, &C::m_##name, dflt)
 
+// Same, for a color, which is field `m_<name>ref` and key "<name>RGB".
+#define COLOR_FIELD(id, name, dflt) \
+  configField<C>(id, #name "RGB", &C::m_##name##ref, dflt)
 
-// Load `field` from `key`.  `expr` is an expression that refers to
-// `data`, the JSON object at `key`.
-#define LOAD_FIELD(key, field, expr) \
-  if (obj.hasKey(key)) {             \
-    JSON const &data = obj.at(key);  \
-    field = (expr);                  \
-  }
+// Same, for a nested configuration object.
+#define OBJECT_FIELD(id, name) \
+  configObjectField<C>(id, #name, &C::m_##name)
 
-// For when the key and field names are related in the usual way.
-#define LOAD_KEY_FIELD(name, expr) \
-  LOAD_FIELD(#name, m_##name, expr)
 
+// Check the table for `Class` at compile time.
+#define CHECK_CONFIG_TABLE(Class)                                  \
+  static_assert(configFieldIDsAreUnique<Class>(),                  \
+                "duplicate binary ID in the table for " #Class);  \
+  static_assert(configFieldsCoverClass<Class>(),                   \
+                "the table for " #Class " does not have "          \
+                #Class "::NUM_FIELDS fields");
 
-// For when the data type is `bool`.
-#define LOAD_KEY_BOOL_FIELD(name) \
-  LOAD_FIELD(#name, m_##name, data.ToBool())
 
-// For when the data type is `int`.
-#define LOAD_KEY_INT_FIELD(name) \
-  LOAD_FIELD(#name, m_##name, data.ToInt())
+// ------------------------- json::JSON trees --------------------------
+// Convert one field value to JSON.
+static JSON configValueToJSON(bool value)
+{
+  return JSON(value);
+}
 
-// For when the data type is `float`.
-#define LOAD_KEY_FLOAT_FIELD(name) \
-  LOAD_FIELD(#name, m_##name, data.ToFloat())
+static JSON configValueToJSON(int value)
+{
+  return JSON(value);
+}
 
+static JSON configValueToJSON(float value)
+{
+  return JSON(value);
+}
 
-// Save a field where converting to JSON only requires invoking one of
-// the `JSON` constructors.
-#define SAVE_KEY_FIELD_CTOR(name) \
-  obj[#name] = JSON(m_##name);
+static JSON configValueToJSON(COLORREF cr)
+{
+  int r = GetRValue(cr);
+  int g = GetGValue(cr);
+  int b = GetBValue(cr);
 
+  return json::Array(r,g,b);
+}
 
-// ----------------------- AnalogThresholdConfig -----------------------
-AnalogThresholdConfig::AnalogThresholdConfig()
-    // These defaults are tuned for Elden Ring.
-  : m_triggerDeadZone(127),
-    m_rightStickDeadZone(6600),
-    m_leftStickWalkThreshold(16000),
-    m_leftStickRunThreshold(25500),
-    m_leftStickSprintThreshold(30000)
-{}
+static JSON configValueToJSON(std::string const &value)
+{
+  return JSON(value);
+}
 
+template <class T>
+static JSON configValueToJSON(T const &obj)
+{
+  return obj.saveToJSON();
+}
 
-#define X_ATC_FIELDS          \
-  X(triggerDeadZone)          \
-  X(rightStickDeadZone)       \
-  X(leftStickWalkThreshold)   \
-  X(leftStickRunThreshold)    \
-  X(leftStickSprintThreshold)
+template <class T>
+static JSON configValueToJSON(std::vector<T> const &vec)
+{
+  JSON arr = json::Array();
+  for (T const &elt : vec) {
+    arr.append(configValueToJSON(elt));
+  }
+  return arr;
+}
 
 
-bool AnalogThresholdConfig::operator==(
-  AnalogThresholdConfig const &obj) const
+// Set one field value from JSON.
+static void configValueFromJSON(JSON const &data, bool &value)
 {
-  #define X(name) EMEMB(m_##name) &&
+  value = data.ToBool();
+}
 
-  return X_ATC_FIELDS
-         true;
+static void configValueFromJSON(JSON const &data, int &value)
+{
+  value = data.ToInt();
+}
 
-  #undef X
+static void configValueFromJSON(JSON const &data, float &value)
+{
+  value = data.ToFloat();
 }
 
+static void configValueFromJSON(JSON const &data, COLORREF &cr)
+{
+  if (data.length() >= 3) {
+    JSON arr = data;
+    int r = arr[0].ToInt();
+    int g = arr[1].ToInt();
+    int b = arr[2].ToInt();
+
+    cr = RGB(r,g,b);
+  }
+  else {
+    // We don't have proper exception infrastructure here.
+    cr = RGB(0,0,0);
+  }
+}
 
-void AnalogThresholdConfig::loadFromJSON(JSON const &obj)
+static void configValueFromJSON(JSON const &data, std::string &value)
 {
-  #define X(name) \
-    LOAD_KEY_FIELD(name, data.ToInt());
+  // `ToString` returns the string re-escaped.
+  std::string unescaped;
+  if (unescapeJSONString(data.ToString(), unescaped)) {
+    value = unescaped;
+  }
+}
 
-  X_ATC_FIELDS
+template <class T>
+static void configValueFromJSON(JSON const &data, T &obj)
+{
+  obj.loadFromJSON(data);
+}
 
-  #undef X
+template <class T>
+static void configValueFromJSON(JSON const &data, std::vector<T> &vec)
+{
+  vec.clear();
+  for (JSON const &elt : data.ArrayRange()) {
+    vec.emplace_back();
+    configValueFromJSON(elt, vec.back());
+  }
 }
 
 
-JSON AnalogThresholdConfig::saveToJSON() const
+// Set the fields of `obj` whose keys are present in `data`.
+template <class C>
+static void loadConfigFromJSON(C &obj, JSON const &data)
 {
-  JSON obj = json::Object();
+  forEachConfigField<C>([&obj, &data](auto const &field) {
+    if (data.hasKey(field.m_name)) {
+      configValueFromJSON(data.at(field.m_name), obj.*(field.m_member));
+    }
+  });
+}
 
-  #define X(name) \
-    SAVE_KEY_FIELD_CTOR(name);
 
-  X_ATC_FIELDS
+// Return a JSON object with all the fields of `obj`.
+template <class C>
+static JSON saveConfigToJSON(C const &obj)
+{
+  JSON data = json::Object();
 
-  #undef X
+  forEachConfigField<C>([&obj, &data](auto const &field) {
+    data[field.m_name] = configValueToJSON(obj.*(field.m_member));
+  });
 
-  return obj;
+  return data;
 }
 
 
-#undef X_ATC_FIELDS
+// Define the methods that every configuration class has in terms of
+// its table.
+#define DEFINE_CONFIG_METHODS(Class)                                   \
+  bool Class::operator==(Class const &obj) const                       \
+  {                                                                    \
+    return configEquals(*this, obj);                                   \
+  }                                                                    \
+                                                                       \
+  void Class::loadFromJSON(JSON const &obj)                            \
+  {                                                                    \
+    loadConfigFromJSON(*this, obj);                                    \
+  }                                                                    \
+                                                                       \
+  JSON Class::saveToJSON() const                                       \
+  {                                                                    \
+    return saveConfigToJSON(*this);                                    \
+  }                                                                    \
+                                                                       \
+  bool Class::readJSONMember(std::string_view key, JSONReader &reader) \
+  {                                                                    \
+    return readConfigJSONMember(*this, key, reader);                   \
+  }                                                                    \
+                                                                       \
+  void Class::readFromJSON(JSONReader &reader)                         \
+  {                                                                    \
+    readConfigJSONValue(reader, *this);                                \
+  }
 
 
-// ------------------------- ButtonTimerConfig -------------------------
-ButtonTimerConfig::ButtonTimerConfig()
-  // Defaults in class body.
-{}
+// ----------------------- AnalogThresholdConfig -----------------------
+template <>
+struct ConfigFieldTable<AnalogThresholdConfig> {
+  typedef AnalogThresholdConfig C;
 
+  // These defaults are tuned for Elden Ring.
+  static constexpr auto c_fields = std::make_tuple(
+    FIELD(1, triggerDeadZone,          127),
+    FIELD(2, rightStickDeadZone,       6600),
+    FIELD(3, leftStickWalkThreshold,   16000),
+    FIELD(4, leftStickRunThreshold,    25500),
+    FIELD(5, leftStickSprintThreshold, 30000)
+  );
+};
 
-#define X_BTC_FIELDS      \
-  X(durationMS,      INT) \
-  X(activeStartMS,   INT) \
-  X(activeEndMS,     INT)
+CHECK_CONFIG_TABLE(AnalogThresholdConfig)
 
 
-bool ButtonTimerConfig::operator==(ButtonTimerConfig const &obj) const
+AnalogThresholdConfig::AnalogThresholdConfig()
 {
-  #define X(name, TYPE) EMEMB(m_##name) &&
-
-  return X_BTC_FIELDS
-         true;
-
-  #undef X
+  setConfigDefaults(*this);
 }
 
 
-void ButtonTimerConfig::loadFromJSON(json::JSON const &obj)
-{
-  #define X(name, TYPE) \
-    LOAD_KEY_##TYPE##_FIELD(name);
+DEFINE_CONFIG_METHODS(AnalogThresholdConfig)
 
-  X_BTC_FIELDS
 
-  #undef X
+// ------------------------- ButtonTimerConfig -------------------------
+// The fields of `ButtonTimerConfig`, for the table of `C`, which is
+// either that class or one derived from it, with the given defaults.
+// IDs up to 15 are reserved for these; derived classes use 16 and up.
+template <class C>
+static constexpr auto buttonTimerConfigFields(
+  int defaultDurationMS, int defaultActiveStartMS, int defaultActiveEndMS)
+{
+  return std::make_tuple(
+    FIELD(1, durationMS,    defaultDurationMS),
+    FIELD(2, activeStartMS, defaultActiveStartMS),
+    FIELD(3, activeEndMS,   defaultActiveEndMS)
+  );
 }
 
 
-json::JSON ButtonTimerConfig::saveToJSON() const
-{
-  JSON obj = json::Object();
+template <>
+struct ConfigFieldTable<ButtonTimerConfig> {
+  typedef ButtonTimerConfig C;
 
-  #define X(name, TYPE) \
-    SAVE_KEY_FIELD_CTOR(name);
+  // A duration of zero disables the timer.
+  static constexpr auto c_fields = buttonTimerConfigFields<C>(0, 0, 0);
+};
 
-  X_BTC_FIELDS
+CHECK_CONFIG_TABLE(ButtonTimerConfig)
 
-  #undef X
 
-  return obj;
+ButtonTimerConfig::ButtonTimerConfig()
+{
+  setConfigDefaults(*this);
 }
 
 
-#undef X_BTC_FIELDS
+DEFINE_CONFIG_METHODS(ButtonTimerConfig)
 
 
 // ------------------ DodgeInvulnerabilityTimerConfig ------------------
+// Startup time, which is due to game input lag.  Typical is a bit more
+// than 1 frame.  We start by saying 1, then adjust.
+static int const c_dodgeStartupFrames = 1;
+
+// 13 i-frames on light and medium roll.
+static int const c_dodgeActiveFrames = 13;
+
+// 8 recovery frames on light and medium if the next action is also a
+// roll.
+static int const c_dodgeRecoveryFrames = 8;
+
+// Milliseconds to add to all the thresholds, effectively increasing
+// the startup delay by this amount.
+//
+// This value (10 ms) was calibrated experimentally by going to the
+// first Leyndell bonfire (where Boc is), clearing the horn blowers
+// until the gargoyle statue, then repeatedly rolling into its fire
+// attack such that the i-frames end while inside the fire.  A perfect
+// measurement system would always yield frame "R 1" (first recovery
+// frame) as the first damage frame.  With this value, the system comes
+// close to that, with one frame of error in either direction about 40%
+// of the time, about evenly balanced on each side.
+//
+static int const c_dodgeAdjustMS = 10;
+
+
+template <>
+struct ConfigFieldTable<DodgeInvulnerabilityTimerConfig> {
+  typedef DodgeInvulnerabilityTimerConfig C;
+
+  static constexpr auto c_fields = buttonTimerConfigFields<C>(
+    // Total duration: startup + active + recovery.
+    1000 * (c_dodgeStartupFrames + c_dodgeActiveFrames +
+            c_dodgeRecoveryFrames) / 30 + c_dodgeAdjustMS,
+
+    // In this division, round up so that a time that falls right on
+    // the boundary of active and inactive will be classified as the
+    // last active frame rather than last+1.
+    (1000 * c_dodgeStartupFrames + 29) / 30 + c_dodgeAdjustMS,
+
+    // Time from start to the end of the active window: startup +
+    // active.
+    1000 * (c_dodgeStartupFrames + c_dodgeActiveFrames) / 30 +
+      c_dodgeAdjustMS
+  );
+};
+
+CHECK_CONFIG_TABLE(DodgeInvulnerabilityTimerConfig)
+
+
 DodgeInvulnerabilityTimerConfig::DodgeInvulnerabilityTimerConfig()
   : ButtonTimerConfig()
 {
-  // Startup time, which is due to game input lag.  Typical is a bit
-  // more than 1 frame.  We start by saying 1, then adjust.
-  int const startupFrames = 1;
+  setConfigDefaults(*this);
+}
 
-  // 13 i-frames on light and medium roll.
-  int const activeFrames = 13;
 
-  // 8 recovery frames on light and medium if the next action is also a
-  // roll.
-  int const recoveryFrames = 8;
+// ------------------------- ParryWindowConfig -------------------------
+// If elapsed time is in [start,end], parry is considered active.  These
+// defaults are for Carrian Retaliation.
+static int const c_parryDurationMS    = 667;
+static int const c_parryActiveStartMS = 1000 * 6 / 30;
+static int const c_parryActiveEndMS   = 1000 * 12 / 30;
 
-  // Milliseconds to add to all the thresholds, effectively increasing
-  // the startup delay by this amount.
-  //
-  // This value (10 ms) was calibrated experimentally by going to the
-  // first Leyndell bonfire (where Boc is), clearing the horn blowers
-  // until the gargoyle statue, then repeatedly rolling into its fire
-  // attack such that the i-frames end while inside the fire.  A perfect
-  // measurement system would always yield frame "R 1" (first recovery
-  // frame) as the first damage frame.  With this value, the system
-  // comes close to that, with one frame of error in either direction
-  // about 40% of the time, about evenly balanced on each side.
-  //
-  int const adjustMS = 10;
 
-  // Total duration: startup + active + recovery.
-  int const totalFrames = startupFrames + activeFrames + recoveryFrames;
-  m_durationMS = 1000 * totalFrames / 30 + adjustMS;
+template <>
+struct ConfigFieldTable<ParryWindowConfig> {
+  typedef ParryWindowConfig C;
 
-  // In this division, round up so that a time that falls right on the
-  // boundary of active and inactive will be classified as the last
-  // active frame rather than last+1.
-  m_activeStartMS = (1000 * startupFrames + 29) / 30 + adjustMS;
+  static constexpr auto c_fields = buttonTimerConfigFields<C>(
+    c_parryDurationMS, c_parryActiveStartMS, c_parryActiveEndMS);
+};
 
-  // Time from start to the end of the active window: startup + active.
-  m_activeEndMS = 1000 * (startupFrames + activeFrames) / 30 + adjustMS;
-}
+CHECK_CONFIG_TABLE(ParryWindowConfig)
 
 
-// ------------------------- ParryTimerConfig --------------------------
-ParryTimerConfig::ParryTimerConfig()
+ParryWindowConfig::ParryWindowConfig()
   : ButtonTimerConfig()
-    // Non-inherited member defaults are specified in the class body.
 {
-  m_durationMS = 667;
-
-  // If elapsed time is in [start,end], parry is considered active.
-  m_activeStartMS = 1000 * 6 / 30;
-  m_activeEndMS = 1000 * 12 / 30;
+  setConfigDefaults(*this);
 }
 
 
-#define X_PTC_FIELDS       \
-  X(numSegments,     INT)  \
-  X(showAccuracy,    BOOL) \
-  X(showElapsedTime, BOOL)
+// ------------------------- ParryTimerConfig --------------------------
+template <>
+struct ConfigFieldTable<ParryTimerConfig> {
+  typedef ParryTimerConfig C;
 
+  static constexpr auto c_fields = std::tuple_cat(
+    buttonTimerConfigFields<C>(
+      c_parryDurationMS, c_parryActiveStartMS, c_parryActiveEndMS),
 
-bool ParryTimerConfig::operator==(ParryTimerConfig const &obj) const
-{
-  #define X(name, TYPE) EMEMB(m_##name) &&
+    std::make_tuple(
+      FIELD(16, numSegments,     20),
+      FIELD(17, showAccuracy,    false),
+      FIELD(18, showElapsedTime, false)
+    )
+  );
+};
 
-  return ButtonTimerConfig::operator==(obj) &&
-         X_PTC_FIELDS
-         true;
+CHECK_CONFIG_TABLE(ParryTimerConfig)
 
-  #undef X
-}
 
-
-void ParryTimerConfig::loadFromJSON(json::JSON const &obj)
+ParryTimerConfig::ParryTimerConfig()
+  : ParryWindowConfig()
 {
-  ButtonTimerConfig::loadFromJSON(obj);
-
-  #define X(name, TYPE) \
-    LOAD_KEY_##TYPE##_FIELD(name);
-
-  X_PTC_FIELDS
-
-  #undef X
+  setConfigDefaults(*this);
 }
 
 
-json::JSON ParryTimerConfig::saveToJSON() const
-{
-  JSON obj = ButtonTimerConfig::saveToJSON();
+DEFINE_CONFIG_METHODS(ParryTimerConfig)
 
-  #define X(name, TYPE) \
-    SAVE_KEY_FIELD_CTOR(name);
 
-  X_PTC_FIELDS
+// --------------------------- LayoutParams ----------------------------
+template <>
+struct ConfigFieldTable<LayoutParams> {
+  typedef LayoutParams C;
+
+  static constexpr auto c_fields = std::make_tuple(
+    FIELD( 1, textFontSizeDIPs,           16.0),
+    FIELD( 2, faceButtonsY,               0.42),
+    FIELD( 3, faceButtonsR,               0.15),
+    FIELD( 4, roundButtonR,               0.20),
+    FIELD( 5, roundButtonTimerSizeFactor, 0.20),
+    FIELD( 6, dpadButtonR,                0.15),
+    FIELD( 7, shoulderButtonsX,           0.15),
+    FIELD( 8, shoulderButtonsR,           0.125),
+    FIELD( 9, bumperVR,                   0.15),
+    FIELD(10, triggerVR,                  0.35),
+    FIELD(11, parryTimerX,                0.5),
+    FIELD(12, parryTimerY,                0.125),
+    FIELD(13, parryTimerHR,               0.2),
+    FIELD(14, parryTimerVR,               0.04),
+    FIELD(15, parryTimerHashHeight,       0.25),
+    FIELD(16, parryElapsedTimeX,          0),
+    FIELD(17, parryElapsedTimeY,          1),
+    FIELD(18, dodgeInvulnerabilityTimeX,  0.65),
+    FIELD(19, dodgeInvulnerabilityTimeY,  0.6),
+    FIELD(20, stickR,                     0.25),
+    FIELD(21, stickOutlineR,              0.4),
+    FIELD(22, stickMaxDeflectR,           0.3),
+    FIELD(23, stickThumbR,                0.1),
+    FIELD(24, chevronSeparation,          0.2),
+    FIELD(25, chevronHR,                  0.25),
+    FIELD(26, chevronVR,                  0.17),
+    FIELD(27, selStartX,                  0.08),
+    FIELD(28, selStartHR,                 0.05),
+    FIELD(29, selStartVR,                 0.03),
+    FIELD(30, centralCircleY,             0.52),
+    FIELD(31, centralCircleR,             0.035),
+    FIELD(32, circleMargin,               0.1),
+    FIELD(33, lineWidthPixels,            3.0)
+  );
+};
+
+CHECK_CONFIG_TABLE(LayoutParams)
 
-  #undef X
 
-  return obj;
+LayoutParams::LayoutParams()
+{
+  setConfigDefaults(*this);
 }
 
 
-#undef X_PTC_FIELDS
+DEFINE_CONFIG_METHODS(LayoutParams)
 
 
-// --------------------------- LayoutParams ----------------------------
-LayoutParams::LayoutParams()
-  // All of the default values are in the class body.
-{}
+// --------------------------- TimingProfile ---------------------------
+template <>
+struct ConfigFieldTable<TimingProfile> {
+  typedef TimingProfile C;
 
+  static constexpr auto c_fields = std::make_tuple(
+    OBJECT_FIELD(1, name),
+    OBJECT_FIELD(2, analogThresholds),
+    OBJECT_FIELD(3, parryTimer),
+    OBJECT_FIELD(4, dodgeInvulnerabilityTimer)
+  );
+};
 
-#define X_LP_FIELDS                \
-  X(textFontSizeDIPs)              \
-  X(faceButtonsY)                  \
-  X(faceButtonsR)                  \
-  X(roundButtonR)                  \
-  X(roundButtonTimerSizeFactor)    \
-  X(dpadButtonR)                   \
-  X(shoulderButtonsX)              \
-  X(shoulderButtonsR)              \
-  X(bumperVR)                      \
-  X(triggerVR)                     \
-  X(parryTimerX)                   \
-  X(parryTimerY)                   \
-  X(parryTimerHR)                  \
-  X(parryTimerVR)                  \
-  X(parryTimerHashHeight)          \
-  X(parryElapsedTimeX)             \
-  X(parryElapsedTimeY)             \
-  X(dodgeInvulnerabilityTimeX)     \
-  X(dodgeInvulnerabilityTimeY)     \
-  X(stickR)                        \
-  X(stickOutlineR)                 \
-  X(stickMaxDeflectR)              \
-  X(stickThumbR)                   \
-  X(chevronSeparation)             \
-  X(chevronHR)                     \
-  X(chevronVR)                     \
-  X(selStartX)                     \
-  X(selStartHR)                    \
-  X(selStartVR)                    \
-  X(centralCircleY)                \
-  X(centralCircleR)                \
-  X(circleMargin)                  \
-  X(lineWidthPixels)
+CHECK_CONFIG_TABLE(TimingProfile)
 
 
-bool LayoutParams::operator==(LayoutParams const &obj) const
+TimingProfile::TimingProfile()
 {
-  #define X(name) EMEMB(m_##name) &&
-
-  return X_LP_FIELDS
-         true;
-
-  #undef X
+  setConfigDefaults(*this);
 }
 
 
-void LayoutParams::loadFromJSON(JSON const &obj)
-{
-  #define X(name) \
-    LOAD_KEY_FLOAT_FIELD(name);
+DEFINE_CONFIG_METHODS(TimingProfile)
 
-  X_LP_FIELDS
 
-  #undef X
-}
+// ----------------------------- GPVConfig -----------------------------
+template <>
+struct ConfigFieldTable<GPVConfig> {
+  typedef GPVConfig C;
+
+  static constexpr auto c_fields = std::make_tuple(
+    // Pastel cyan.
+    COLOR_FIELD( 1, linesColor,          RGB(118, 235, 220)),
+
+    // Dark blue, almost purple.
+    COLOR_FIELD( 2, highlightColor,      RGB(53, 53, 242)),
+
+    COLOR_FIELD( 3, parryActiveColor,    RGB(255, 0, 0)),
+    COLOR_FIELD( 4, parryInactiveColor,  RGB(128, 128, 128)),
+
+    // Dark gray.
+    COLOR_FIELD( 5, textBackgroundColor, RGB(32, 32, 32)),
+
+    COLOR_FIELD( 6, dodgeActiveColor,    RGB(128, 32, 32)),
+    COLOR_FIELD( 7, dodgeInactiveColor,  RGB(32, 32, 32)),
+
+    FIELD( 8, showText,                      false),
+    FIELD( 9, showDodgeInvulnerabilityTimer, false),
+    FIELD(10, topmostWindow,                 false),
+    FIELD(11, windowLeft,                    50),
+    FIELD(12, windowTop,                     300),
+    FIELD(13, windowWidth,                   400),
+    FIELD(14, windowHeight,                  400),
+    FIELD(15, pollingIntervalMS,             16),     // ~60 FPS.
+    FIELD(16, presentFPS,                    0),      // Display refresh.
+    FIELD(17, dodgeReleaseTimerDurationMS,   33),     // 1 frame at 30 FPS.
+    FIELD(18, controllerID,                  0),      // First controller.
+
+    OBJECT_FIELD(19, analogThresholds),
+    OBJECT_FIELD(20, dodgeInvulnerabilityTimer),
+    OBJECT_FIELD(21, parryTimer),
+    OBJECT_FIELD(22, layoutParams),
+    OBJECT_FIELD(23, profiles),
+    FIELD(24, activeProfile,                 -1)      // None.
+  );
+};
+
+CHECK_CONFIG_TABLE(GPVConfig)
 
 
-JSON LayoutParams::saveToJSON() const
+GPVConfig::GPVConfig()
 {
-  JSON obj = json::Object();
-
-  #define X(name) \
-    SAVE_KEY_FIELD_CTOR(name);
-
-  X_LP_FIELDS
-
-  #undef X
-
-  return obj;
+  setConfigDefaults(*this);
 }
 
 
-#undef X_LP_FIELDS
+DEFINE_CONFIG_METHODS(GPVConfig)
 
 
-// ----------------------------- GPVConfig -----------------------------
-GPVConfig::GPVConfig()
-  : m_linesColorref(RGB(118, 235, 220)),         // Pastel cyan.
-    m_highlightColorref(RGB(53, 53, 242)),       // Dark blue, almost purple.
-    m_parryActiveColorref(RGB(255, 0, 0)),
-    m_parryInactiveColorref(RGB(128, 128, 128)),
-    m_textBackgroundColorref(RGB(32, 32, 32)),   // Dark gray.
-    m_dodgeActiveColorref(RGB(128, 32, 32)),
-    m_dodgeInactiveColorref(RGB(32, 32, 32)),
-    m_showText(false),
-    m_showDodgeInvulnerabilityTimer(false),
-    m_topmostWindow(false),
-    m_windowLeft(50),
-    m_windowTop(300),
-    m_windowWidth(400),
-    m_windowHeight(400),
-    m_pollingIntervalMS(16),                     // ~60 FPS.
-    m_dodgeReleaseTimerDurationMS(33),           // 1 frame at 30 FPS.
-    m_controllerID(0),                           // First controller.
-    m_analogThresholds(),
-    m_dodgeInvulnerabilityTimer(),
-    m_parryTimer(),
-    m_layoutParams()
-{}
-
-
-static JSON COLORREF_to_JSON(COLORREF cr)
+std::string GPVConfig::loadFromFile(std::string const &fname)
 {
-  int r = GetRValue(cr);
-  int g = GetGValue(cr);
-  int b = GetBValue(cr);
-
-  return json::Array(r,g,b);
-}
-
+  std::ifstream in(fname, std::ios::binary);
+  if (!in) {
+    return std::strerror(errno);
+  }
 
-static COLORREF COLORREF_from_JSON(JSON arr)
-{
-  if (arr.length() >= 3) {
-    int r = arr[0].ToInt();
-    int g = arr[1].ToInt();
-    int b = arr[2].ToInt();
+  // A directory, for one, opens on Linux, and seeking to its end
+  // gives a nonsensical size.
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(fname, ec)) {
+    return "Not a regular file.";
+  }
 
-    return RGB(r,g,b);
+  // Read the whole file with one allocation.
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg();
+  if (size < 0) {
+    return "Could not determine the file size.";
   }
-  else {
-    // We don't have proper exception infrastructure here.
-    return RGB(0,0,0);
+  std::string text(static_cast<std::size_t>(size), '\0');
+  in.seekg(0, std::ios::beg);
+  in.read(text.data(), text.size());
+  if (in.gcount() != size) {
+    return "Could not read the whole file.";
   }
-}
 
+  JSONReader reader(text.data(), text.data() + text.size());
+  readFromJSON(reader);
+  reader.finish();
 
-// Not used at the moment, but retaining this in case I want to later.
-#define X_GPVC_FIELDS                   \
-  X_COLOR(linesColor)                   \
-  X_COLOR(highlightColor)               \
-  X_COLOR(parryActiveColor)             \
-  X_COLOR(parryInactiveColor)           \
-  X_COLOR(textBackgroundColor)          \
-  X_COLOR(dodgeActiveColor)             \
-  X_COLOR(dodgeInactiveColor)           \
-  X_BOOL(showText)                      \
-  X_BOOL(showDodgeInvulnerabilityTimer) \
-  X_BOOL(topmostWindow)                 \
-  X_INT(windowLeft)                     \
-  X_INT(windowTop)                      \
-  X_INT(windowWidth)                    \
-  X_INT(windowHeight)                   \
-  X_INT(pollingIntervalMS)              \
-  X_INT(dodgeReleaseTimerDurationMS)    \
-  X_INT(controllerID)                   \
-  X_OBJ(analogThresholds)               \
-  X_OBJ(dodgeInvulnerabilityTimer)      \
-  X_OBJ(parryTimer)                     \
-  X_OBJ(layoutParams)
-
-
-void GPVConfig::loadFromJSON(JSON const &obj)
-{
-  #define LOAD_KEY_FIELD_COLOR(name) \
-    LOAD_FIELD(#name "RGB", m_##name##ref, COLORREF_from_JSON(data));
-
-  LOAD_KEY_FIELD_COLOR(linesColor)
-  LOAD_KEY_FIELD_COLOR(highlightColor)
-  LOAD_KEY_FIELD_COLOR(parryActiveColor)
-  LOAD_KEY_FIELD_COLOR(parryInactiveColor)
-  LOAD_KEY_FIELD_COLOR(textBackgroundColor)
-  LOAD_KEY_FIELD_COLOR(dodgeActiveColor)
-  LOAD_KEY_FIELD_COLOR(dodgeInactiveColor)
-
-  #undef LOAD_KEY_FIELD_COLOR
-
-  LOAD_KEY_FIELD(showText, data.ToBool());
-  LOAD_KEY_FIELD(showDodgeInvulnerabilityTimer, data.ToBool());
-  LOAD_KEY_FIELD(topmostWindow, data.ToBool());
-  LOAD_KEY_FIELD(windowLeft, data.ToInt());
-  LOAD_KEY_FIELD(windowTop, data.ToInt());
-  LOAD_KEY_FIELD(windowWidth, data.ToInt());
-  LOAD_KEY_FIELD(windowHeight, data.ToInt());
-  LOAD_KEY_FIELD(pollingIntervalMS, data.ToInt());
-  LOAD_KEY_FIELD(dodgeReleaseTimerDurationMS, data.ToInt());
-  LOAD_KEY_FIELD(controllerID, data.ToInt());
-
-  #define LOAD_KEY_FIELD_OBJ(name)          \
-    if (obj.hasKey(#name)) {                \
-      m_##name.loadFromJSON(obj.at(#name)); \
-    }
-
-  LOAD_KEY_FIELD_OBJ(analogThresholds)
-  LOAD_KEY_FIELD_OBJ(dodgeInvulnerabilityTimer)
-  LOAD_KEY_FIELD_OBJ(parryTimer)
-  LOAD_KEY_FIELD_OBJ(layoutParams)
+  // The file has the profile's settings in the top-level fields too,
+  // but the profile may have been edited since, and it wins.
+  if (!selectProfile(m_activeProfile)) {
+    m_activeProfile = -1;
+  }
 
-  #undef LOAD_KEY_FIELD_OBJ
+  // On a syntax error, the fields read before it keep their new values.
+  return reader.m_error;
 }
 
 
-JSON GPVConfig::saveToJSON() const
+std::string GPVConfig::saveToFile(std::string const &fname) const
 {
-  JSON obj = json::Object();
+  JSON obj = saveToJSON();
 
-  #define SAVE_KEY_FIELD_COLOR(name) \
-    obj[#name "RGB"] = COLORREF_to_JSON(m_##name##ref);
+  std::string serialized = obj.dump();
+  serialized += "\n";
 
-  SAVE_KEY_FIELD_COLOR(linesColor)
-  SAVE_KEY_FIELD_COLOR(highlightColor)
-  SAVE_KEY_FIELD_COLOR(parryActiveColor)
-  SAVE_KEY_FIELD_COLOR(parryInactiveColor)
-  SAVE_KEY_FIELD_COLOR(textBackgroundColor)
-  SAVE_KEY_FIELD_COLOR(dodgeActiveColor)
-  SAVE_KEY_FIELD_COLOR(dodgeInactiveColor)
+  return writeFileAtomically(fname, serialized);
+}
 
-  #undef SAVE_KEY_FIELD_COLOR
 
-  SAVE_KEY_FIELD_CTOR(showText);
-  SAVE_KEY_FIELD_CTOR(showDodgeInvulnerabilityTimer);
-  SAVE_KEY_FIELD_CTOR(topmostWindow);
-  SAVE_KEY_FIELD_CTOR(windowLeft);
-  SAVE_KEY_FIELD_CTOR(windowTop);
-  SAVE_KEY_FIELD_CTOR(windowWidth);
-  SAVE_KEY_FIELD_CTOR(windowHeight);
-  SAVE_KEY_FIELD_CTOR(pollingIntervalMS);
-  SAVE_KEY_FIELD_CTOR(dodgeReleaseTimerDurationMS);
-  SAVE_KEY_FIELD_CTOR(controllerID);
+std::vector<std::string> GPVConfig::diffFields(GPVConfig const &obj) const
+{
+  std::vector<std::string> names;
+  diffConfig(*this, obj, "", names);
+  return names;
+}
 
-  #define SAVE_KEY_FIELD_OBJ(name) \
-    obj[#name] = m_##name.saveToJSON();
 
-  SAVE_KEY_FIELD_OBJ(analogThresholds)
-  SAVE_KEY_FIELD_OBJ(dodgeInvulnerabilityTimer)
-  SAVE_KEY_FIELD_OBJ(parryTimer)
-  SAVE_KEY_FIELD_OBJ(layoutParams)
+void GPVConfig::encodeBinary(std::string &dest) const
+{
+  encodeConfigBinary(*this, dest);
+}
 
-  #undef SAVE_KEY_FIELD_OBJ
 
-  return obj;
+bool GPVConfig::decodeBinary(char const *p, char const *end)
+{
+  return decodeConfigBinary(*this, p, end);
 }
 
 
-std::string GPVConfig::loadFromFile(std::string const &fname)
+TimingProfile const *GPVConfig::activeProfile() const
 {
-  std::ifstream in(fname, std::ios::binary);
-  if (!in) {
-    return std::strerror(errno);
+  if (0 <= m_activeProfile && m_activeProfile < (int)m_profiles.size()) {
+    return &m_profiles[m_activeProfile];
   }
+  else {
+    return nullptr;
+  }
+}
 
-  std::ostringstream oss;
-  oss << in.rdbuf();
-
-  // This merely reports errors to stderr...
-  JSON obj = JSON::Load(oss.str());
 
-  loadFromJSON(obj);
+bool GPVConfig::selectProfile(int index)
+{
+  if (!( 0 <= index && index < (int)m_profiles.size() )) {
+    return false;
+  }
 
-  return "";
+  TimingProfile const &profile = m_profiles[index];
+  m_analogThresholds = profile.m_analogThresholds;
+  static_cast<ParryWindowConfig&>(m_parryTimer) = profile.m_parryTimer;
+  m_dodgeInvulnerabilityTimer = profile.m_dodgeInvulnerabilityTimer;
+  m_activeProfile = index;
+  return true;
 }
 
 
-std::string GPVConfig::saveToFile(std::string const &fname) const
+bool GPVConfig::selectNextProfile()
 {
-  JSON obj = saveToJSON();
+  if (m_profiles.empty()) {
+    return false;
+  }
 
-  std::string serialized = obj.dump();
+  int next = activeProfile()? m_activeProfile + 1 : 0;
+  return selectProfile(next % (int)m_profiles.size());
+}
 
-  std::ofstream out(fname, std::ios::binary);
-  if (out) {
-    out << serialized << "\n";
-    return "";
-  }
-  else {
-    return std::strerror(errno);
+
+void GPVConfig::setAnalogThresholds(AnalogThresholdConfig const &thr)
+{
+  m_analogThresholds = thr;
+  if (activeProfile()) {
+    m_profiles[m_activeProfile].m_analogThresholds = thr;
   }
 }
 
 
-#undef X_GPVC_FIELDS
+#undef FIELD
+#undef COLOR_FIELD
+#undef OBJECT_FIELD
+#undef CHECK_CONFIG_TABLE
+#undef DEFINE_CONFIG_METHODS
 
 
 // EOF
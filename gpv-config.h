@@ -3,18 +3,41 @@
 
 // See license.txt for copyright and terms of use.
 
+// The fields of each class, with their JSON keys and default values,
+// are listed in the tables in gpv-config.cc, from which everything
+// else is generated; see config-fields.h.  A new field must be added
+// there too, and counted in its class's `NUM_FIELDS`.
+
 #ifndef GPV_CONFIG_H
 #define GPV_CONFIG_H
 
 #include "json-fwd.h"                  // json::JSON
 
-#include <windows.h>                   // COLORREF
+#include "windows-compat.h"            // COLORREF
 
 #include <string>                      // std::string
+#include <string_view>                 // std::string_view
+#include <vector>                      // std::vector
+
+class JSONReader;                      // json-reader.h
+
+
+// Version of the `GPVConfig::encodeBinary` format.  Adding or removing
+// fields does not change it, since decoding skips unknown IDs; it only
+// needs to change if an existing field's encoding does.
+int const GPV_CONFIG_BINARY_VERSION = 1;
 
 
 // Configuration of analog input thresholds
 class AnalogThresholdConfig {
+public:      // types
+  enum {
+    // Number of data members.  Each must also have an entry in the
+    // field table in gpv-config.cc, which is checked against this, so
+    // change it along with them.
+    NUM_FIELDS = 5,
+  };
+
 public:      // data
   // When the trigger is greater than or equal to this value, we regard it
   // as "active".
@@ -55,22 +78,36 @@ public:      // methods
   // De/serialize as JSON.
   void loadFromJSON(json::JSON const &obj);
   json::JSON saveToJSON() const;
+
+  // Read the value of member `key` of a JSON object from `reader` into
+  // the corresponding field.  Return false, consuming nothing, if `key`
+  // is not one of ours.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+
+  // Read an entire JSON object from `reader`, ignoring unknown keys.
+  void readFromJSON(JSONReader &reader);
 };
 
 
 // Parameters for a button timer.
 class ButtonTimerConfig {
+public:      // types
+  enum {
+    // Number of data members; see `AnalogThresholdConfig`.
+    NUM_FIELDS = 3,
+  };
+
 public:      // data
   // Total duration, after which the timer expires.
   //
   // This can be set to zero to disable the timer display.
-  int m_durationMS = 0;
+  int m_durationMS;
 
   // Startup time before the active window begins.
-  int m_activeStartMS = 0;
+  int m_activeStartMS;
 
   // Time from start to the end of the active window.
-  int m_activeEndMS = 0;
+  int m_activeEndMS;
 
 public:
   ButtonTimerConfig();
@@ -82,6 +119,10 @@ public:
   // De/serialize as JSON.
   void loadFromJSON(json::JSON const &obj);
   json::JSON saveToJSON() const;
+
+  // Read fields directly from JSON text; see `AnalogThresholdConfig`.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+  void readFromJSON(JSONReader &reader);
 };
 
 
@@ -93,18 +134,33 @@ public:      // methods
 };
 
 
+// Timing of the parry window.
+class ParryWindowConfig : public ButtonTimerConfig {
+public:      // methods
+  // Set defaults for parrying.
+  ParryWindowConfig();
+};
+
+
 // Parameters related to the parry timer.
-class ParryTimerConfig : public ButtonTimerConfig {
+class ParryTimerConfig : public ParryWindowConfig {
+public:      // types
+  enum {
+    // Number of data members, including inherited ones; see
+    // `AnalogThresholdConfig`.
+    NUM_FIELDS = ParryWindowConfig::NUM_FIELDS + 3,
+  };
+
 public:      // data
   // Number of segments in the timer bar.
-  int m_numSegments = 20;
+  int m_numSegments;
 
   // If true, interpret the elapsed time as a number of frames early,
   // late, or within the active parry window.
-  bool m_showAccuracy = false;
+  bool m_showAccuracy;
 
   // If true, show the elapsed time in milliseconds as text too.
-  bool m_showElapsedTime = false;
+  bool m_showElapsedTime;
 
 public:      // methods
   ParryTimerConfig();
@@ -116,6 +172,47 @@ public:      // methods
   // De/serialize as JSON.
   void loadFromJSON(json::JSON const &obj);
   json::JSON saveToJSON() const;
+
+  // Read fields directly from JSON text; see `AnalogThresholdConfig`.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+  void readFromJSON(JSONReader &reader);
+};
+
+
+// A named set of timing windows and thresholds, such as for one parry
+// skill or one equipment load, that can be switched to at runtime.
+class TimingProfile {
+public:      // types
+  enum {
+    // Number of data members; see `AnalogThresholdConfig`.
+    NUM_FIELDS = 4,
+  };
+
+public:      // data
+  // Name shown when the profile is selected.
+  std::string m_name;
+
+  // Replacements for the like-named members of `GPVConfig`.  Only the
+  // window timings of `m_parryTimer` are part of the profile; the
+  // display options stay as they are.
+  AnalogThresholdConfig m_analogThresholds;
+  ParryWindowConfig m_parryTimer;
+  DodgeInvulnerabilityTimerConfig m_dodgeInvulnerabilityTimer;
+
+public:      // methods
+  TimingProfile();
+
+  bool operator==(TimingProfile const &obj) const;
+  bool operator!=(TimingProfile const &obj) const
+    { return !operator==(obj); }
+
+  // De/serialize as JSON.
+  void loadFromJSON(json::JSON const &obj);
+  json::JSON saveToJSON() const;
+
+  // Read fields directly from JSON text; see `AnalogThresholdConfig`.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+  void readFromJSON(JSONReader &reader);
 };
 
 
@@ -125,103 +222,109 @@ public:      // methods
 // whole within either the whole UI or a parent button cluster.
 //
 class LayoutParams {
+public:      // types
+  enum {
+    // Number of data members; see `AnalogThresholdConfig`.
+    NUM_FIELDS = 33,
+  };
+
 public:      // data
   // Font size for the text display in "device-independent pixel" units,
   // one of which is 1/96th of an inch.
-  float m_textFontSizeDIPs = 16.0;
+  float m_textFontSizeDIPs;
 
   // Distance from top to center of face button cluster and center of
   // select/start cluster.
-  float m_faceButtonsY = 0.42;
+  float m_faceButtonsY;
 
   // Radius of face button clusters.
-  float m_faceButtonsR = 0.15;
+  float m_faceButtonsR;
 
   // Radius of one of the round face buttons.
-  float m_roundButtonR = 0.20;
+  float m_roundButtonR;
 
   // If a just-released timer is shown inside a round button, its size
   // is this much times the size of the circle it is inside.
-  float m_roundButtonTimerSizeFactor = 0.20;
+  float m_roundButtonTimerSizeFactor;
 
   // Square radius of one of the dpad buttons.
-  float m_dpadButtonR = 0.15;
+  float m_dpadButtonR;
 
   // Distance from side to center of shoulder buttons.
-  float m_shoulderButtonsX = 0.15;
+  float m_shoulderButtonsX;
 
   // Radius of shoulder button cluster.
-  float m_shoulderButtonsR = 0.125;
+  float m_shoulderButtonsR;
 
   // Vertical radius of a bumper button within its shoulder cluster.
-  float m_bumperVR = 0.15;
+  float m_bumperVR;
 
   // Vertical radius of a trigger box within its shoulder cluster.
-  float m_triggerVR = 0.35;
+  float m_triggerVR;
 
   // X/Y of center of parry timer.
-  float m_parryTimerX = 0.5;
-  float m_parryTimerY = 0.125;
+  float m_parryTimerX;
+  float m_parryTimerY;
 
   // H/V radius of parry timer.
-  float m_parryTimerHR = 0.2;
-  float m_parryTimerVR = 0.04;
+  float m_parryTimerHR;
+  float m_parryTimerVR;
 
   // Height of hash marks as a proportion of the meter height.
-  float m_parryTimerHashHeight = 0.25;
+  float m_parryTimerHashHeight;
 
   // Location of the top-left corner of the elapsed parry time text, in
   // proportional units relative to the parry timer region.  Thus, (0,1)
   // represents the bottom-left corner of that region.  This is only
   // shown if `ParryTimerConfig::m_showElapsedTime` is true.
-  float m_parryElapsedTimeX = 0;
-  float m_parryElapsedTimeY = 1;
+  float m_parryElapsedTimeX;
+  float m_parryElapsedTimeY;
 
   // Location of top-left corner of dodge timer text, relative to the
   // entire gamepad viewer display.
-  float m_dodgeInvulnerabilityTimeX = 0.65;
-  float m_dodgeInvulnerabilityTimeY = 0.6;
+  float m_dodgeInvulnerabilityTimeX;
+  float m_dodgeInvulnerabilityTimeY;
 
   // Radius of each stick display cluster.
-  float m_stickR = 0.25;
+  float m_stickR;
 
   // Radius of the always-visible circle around the stick thumb.
-  float m_stickOutlineR = 0.4;
+  float m_stickOutlineR;
 
   // Maximum distance of the thumb from its center.
-  float m_stickMaxDeflectR = 0.3;
+  float m_stickMaxDeflectR;
 
   // Radius of the filled circle representing the thumb.
-  float m_stickThumbR = 0.1;
+  float m_stickThumbR;
 
   // By how much vertical space are the chevrons separated?
-  float m_chevronSeparation = 0.2;
+  float m_chevronSeparation;
 
   // Horizontal radius of the chevrons.
-  float m_chevronHR = 0.25;
+  float m_chevronHR;
 
   // Vertical radius of the chevrons.
-  float m_chevronVR = 0.17;
+  float m_chevronVR;
 
   // Horizontal distance from the center line to the sel/start buttons.
-  float m_selStartX = 0.08;
+  float m_selStartX;
 
   // Horizontal and vertical radii for sel/start.
-  float m_selStartHR = 0.05;
-  float m_selStartVR = 0.03;
+  float m_selStartHR;
+  float m_selStartVR;
 
   // Distance from the top to the central circle.
-  float m_centralCircleY = 0.52;
+  float m_centralCircleY;
 
   // Radius of the central circle.
-  float m_centralCircleR = 0.035;
+  float m_centralCircleR;
 
   // Distance that most uses of `drawCircle` and `drawSquare` leave
   // between the edge of the circle and the edge of its nominal area.
-  float m_circleMargin = 0.1;
+  float m_circleMargin;
 
   // Width in pixels of the lines.
-  float m_lineWidthPixels = 3.0;
+  float m_lineWidthPixels;
 
 public:      // methods
   LayoutParams();
@@ -233,11 +336,21 @@ public:      // methods
   // De/serialize as JSON.
   void loadFromJSON(json::JSON const &obj);
   json::JSON saveToJSON() const;
+
+  // Read fields directly from JSON text; see `AnalogThresholdConfig`.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+  void readFromJSON(JSONReader &reader);
 };
 
 
 // User configuration settings for the gamepad viewer.
 class GPVConfig {
+public:      // types
+  enum {
+    // Number of data members; see `AnalogThresholdConfig`.
+    NUM_FIELDS = 24,
+  };
+
 public:      // data
   // NOTE: None of the colors can be black, because black is used as the
   // transparency key color (and I cannot easily change that due to a
@@ -279,6 +392,11 @@ public:      // data
   // Milliseconds between attempts to poll the controller.
   int m_pollingIntervalMS;
 
+  // Maximum number of times per second to redraw the display, which
+  // is independent of the polling rate.  Zero means to use the refresh
+  // rate of the display.
+  int m_presentFPS;
+
   // Milliseconds after dodge button is released for which we should
   // show a small dot inside the circle.  Zero disables that display.
   int m_dodgeReleaseTimerDurationMS;
@@ -298,20 +416,74 @@ public:      // data
   // UI layout.
   LayoutParams m_layoutParams;
 
+  // Available timing profiles.
+  std::vector<TimingProfile> m_profiles;
+
+  // Index in `m_profiles` of the profile whose settings are in
+  // `m_analogThresholds`, `m_parryTimer`, and
+  // `m_dodgeInvulnerabilityTimer`, or -1 if they were set directly.
+  int m_activeProfile;
+
 public:      // methods
   // Initialize with defaults.
   GPVConfig();
 
+  bool operator==(GPVConfig const &obj) const;
+  bool operator!=(GPVConfig const &obj) const
+    { return !operator==(obj); }
+
   // De/serialize as JSON.
   void loadFromJSON(json::JSON const &obj);
   json::JSON saveToJSON() const;
 
+  // Read fields directly from JSON text; see `AnalogThresholdConfig`.
+  bool readJSONMember(std::string_view key, JSONReader &reader);
+  void readFromJSON(JSONReader &reader);
+
   // Load settings from the named file.  Return an empty string on
   // success, and an error message otherwise.
+  //
+  // This uses `JSONReader` rather than building a `json::JSON` tree,
+  // so it only allocates to read the file and for the strings and
+  // profiles in it.
   std::string loadFromFile(std::string const &fname);
 
-  // Save the settings.  Return a non-empty error message on failure.
+  // Save the settings, replacing the file atomically so that it is
+  // never left half written.  Return a non-empty error message on
+  // failure.
   std::string saveToFile(std::string const &fname) const;
+
+  // Return the keys of the fields that differ between `this` and
+  // `obj`.  Fields of nested objects are named like
+  // "layoutParams.stickR".
+  std::vector<std::string> diffFields(GPVConfig const &obj) const;
+
+  // Append a compact binary encoding of the settings to `dest`.  The
+  // format tolerates fields being added and removed; see
+  // config-fields.h.
+  void encodeBinary(std::string &dest) const;
+
+  // Decode [p,end), as produced by `encodeBinary`, into `this`.  Fields
+  // not present keep their current values.  Return false if the data
+  // is malformed.
+  bool decodeBinary(char const *p, char const *end);
+
+  // The profile at `m_activeProfile`, or null if there is none.
+  TimingProfile const *activeProfile() const;
+
+  // Make profile `index` active by copying its settings over the
+  // current ones.  This only copies a few fixed-size structures, so
+  // it is cheap enough to do between two controller polls.  Return
+  // false, changing nothing, if `index` is out of range.
+  bool selectProfile(int index);
+
+  // Select the profile after the active one, wrapping around, or the
+  // first if none is active.  Return false if there are no profiles.
+  bool selectNextProfile();
+
+  // Set `m_analogThresholds`, and the active profile's too, if any, so
+  // that the change survives reloading the file.
+  void setAnalogThresholds(AnalogThresholdConfig const &thr);
 };
 
 
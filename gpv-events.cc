@@ -0,0 +1,380 @@
+// gpv-events.cc
+// Command-line tool to read, and load test, the input event stream.
+
+// See license.txt for copyright and terms of use.
+
+// `gpv-events watch` prints the lines that a viewer started with
+// `EVENT_STREAM` is sending, as an example of subscribing and a way to
+// check that the stream works.
+//
+// `gpv-events load` runs a server of its own, feeds it the events of
+// synthetic input at the poll rate, and connects many subscribers, a
+// few of which read slowly on purpose.  It reports how long each poll
+// spent detecting and publishing events, which should not depend on
+// the subscribers, and checks that every subscriber's sequence numbers
+// are accounted for: each must be one more than the previous, plus any
+// count of dropped events in between.  It exits with status 1 if not.
+
+#include "event-stream.h"              // EventStream{Server,Subscriber}
+#include "gpv-config.h"                // GPVConfig
+#include "input-events.h"              // InputEventDetector
+#include "input-model.h"               // InputModel
+#include "latency-histogram.h"         // LatencyHistogram
+#include "synthetic-input.h"           // SyntheticInput
+
+#include <chrono>                      // std::chrono
+#include <cstdint>                     // std::uint64_t
+#include <cstdlib>                     // std::{atoi, exit, strtoull}
+#include <cstring>                     // std::{strcmp, strstr}
+#include <iostream>                    // std::{cerr, cout}
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Command line options.
+class EventsOptions {
+public:      // data
+  // "watch" or "load".
+  std::string m_command;
+
+  // Socket path.
+  std::string m_path;
+
+  // For "load", the number of subscribers, and how many of those are
+  // slow.
+  int m_subscribers;
+  int m_slow;
+
+  // For "load", how long to run, and the poll rate.
+  int m_seconds;
+  int m_rate;
+
+  // For "load", the capacity of each subscriber's queue.
+  int m_queue;
+
+public:      // methods
+  EventsOptions()
+    : m_command(),
+      m_path(),
+      m_subscribers(32),
+      m_slow(4),
+      m_seconds(5),
+      m_rate(4000),
+      m_queue(256)
+  {}
+};
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-events [options] watch|load\n"
+    "\n"
+    "watch: Print the events sent by a viewer started with\n"
+    "EVENT_STREAM set.\n"
+    "\n"
+    "load: Publish synthetic input events to many local subscribers,\n"
+    "some of them slow, and check that none stalls publishing or\n"
+    "loses events without being told.\n"
+    "\n"
+    "options:\n"
+    "  --path PATH         Socket path (default for watch: "
+      EVENT_STREAM_DEFAULT_PATH ",\n"
+    "                      for load: gpv-events-load.sock).\n"
+    "  --subscribers N     Subscribers for load (default: 32).\n"
+    "  --slow N            How many of those read slowly (default: 4).\n"
+    "  --seconds N         How long to load (default: 5).\n"
+    "  --rate HZ           Polls per second for load (default: 4000).\n"
+    "  --queue N           Events queued per subscriber (default: 256).\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-events: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+static void parseOptions(EventsOptions &opts, int argc, char **argv)
+{
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--path")) {
+      opts.m_path = optionArg(argc, argv, i);
+    }
+    else if (0==std::strcmp(arg, "--subscribers")) {
+      opts.m_subscribers = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--slow")) {
+      opts.m_slow = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--seconds")) {
+      opts.m_seconds = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--rate")) {
+      opts.m_rate = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--queue")) {
+      opts.m_queue = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (arg[0] == '-') {
+      std::cerr << "gpv-events: unknown option: " << arg << "\n";
+      usage();
+    }
+    else if (opts.m_command.empty()) {
+      opts.m_command = arg;
+    }
+    else {
+      usage();
+    }
+  }
+
+  if (opts.m_command != "watch" && opts.m_command != "load") {
+    usage();
+  }
+  if (opts.m_subscribers <= 0 || opts.m_seconds <= 0 ||
+      opts.m_rate <= 0 || opts.m_queue <= 0) {
+    std::cerr << "gpv-events: --subscribers, --seconds, --rate, and "
+                 "--queue must be positive\n";
+    usage();
+  }
+  if (opts.m_slow < 0 || opts.m_slow > opts.m_subscribers) {
+    std::cerr << "gpv-events: --slow must be between 0 and "
+                 "--subscribers\n";
+    usage();
+  }
+  if (opts.m_path.empty()) {
+    opts.m_path = opts.m_command == "watch"?
+                    EVENT_STREAM_DEFAULT_PATH : "gpv-events-load.sock";
+  }
+}
+
+
+// If `line` has `"key":N`, set `value` to N and return true.
+static bool getNumber(std::string const &line, char const *key,
+                      std::uint64_t &value /*OUT*/)
+{
+  std::string pattern = std::string("\"") + key + "\":";
+  char const *p = std::strstr(line.c_str(), pattern.c_str());
+  if (!p) {
+    return false;
+  }
+  value = std::strtoull(p + pattern.size(), nullptr, 10);
+  return true;
+}
+
+
+// ------------------------------- watch -------------------------------
+static int watch(EventsOptions const &opts)
+{
+  EventStreamSubscriber subscriber;
+  std::string error = subscriber.open(opts.m_path);
+  if (!error.empty()) {
+    std::cerr << opts.m_path << ": " << error << "\n";
+    return 2;
+  }
+
+  std::string line;
+  while (subscriber.readLine(line)) {
+    std::cout << line << std::endl;
+  }
+
+  std::cerr << opts.m_path << ": connection closed\n";
+  return 0;
+}
+
+
+// ------------------------------- load --------------------------------
+// What one subscriber saw.
+class LoadSubscriberResult {
+public:      // data
+  // True if this one reads slowly.
+  bool m_slow;
+
+  // True if it could not connect, or the first line was not the
+  // greeting.
+  bool m_failed;
+
+  // Events received, and the total of the dropped counts.
+  std::uint64_t m_events;
+  std::uint64_t m_dropped;
+
+  // Events whose sequence number was not accounted for.
+  std::uint64_t m_gaps;
+
+  // Sequence number of the last event received.
+  std::uint64_t m_lastSequence;
+
+public:      // methods
+  LoadSubscriberResult()
+    : m_slow(false),
+      m_failed(false),
+      m_events(0),
+      m_dropped(0),
+      m_gaps(0),
+      m_lastSequence(0)
+  {}
+};
+
+
+static void loadSubscriber(std::string const &path,
+                           LoadSubscriberResult &result)
+{
+  EventStreamSubscriber subscriber;
+  std::string error = subscriber.open(path);
+  std::string line;
+  if (!error.empty() || !subscriber.readLine(line) ||
+      line.find("\"hello\"") == std::string::npos) {
+    std::cerr << path << ": " << (error.empty()? "no greeting" : error)
+              << "\n";
+    result.m_failed = true;
+    return;
+  }
+
+  // Dropped count not yet matched by a jump in the sequence.
+  std::uint64_t pendingDropped = 0;
+
+  while (subscriber.readLine(line)) {
+    std::uint64_t n;
+    if (getNumber(line, "seq", n)) {
+      // The first event may be any, as the subscriber joined late.
+      if (result.m_lastSequence &&
+          n != result.m_lastSequence + 1 + pendingDropped) {
+        result.m_gaps++;
+      }
+      result.m_lastSequence = n;
+      result.m_events++;
+      pendingDropped = 0;
+    }
+    else if (getNumber(line, "count", n)) {
+      result.m_dropped += n;
+      pendingDropped += n;
+    }
+
+    if (result.m_slow) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+
+static int load(EventsOptions const &opts)
+{
+  EventStreamServer server(opts.m_path, opts.m_queue);
+  std::string error = server.start();
+  if (!error.empty()) {
+    std::cerr << opts.m_path << ": " << error << "\n";
+    return 2;
+  }
+
+  std::vector<LoadSubscriberResult> results(opts.m_subscribers);
+  std::vector<std::thread> subscribers;
+  for (int i=0; i < opts.m_subscribers; ++i) {
+    results[i].m_slow = (i < opts.m_slow);
+    subscribers.emplace_back(loadSubscriber, std::cref(opts.m_path),
+                             std::ref(results[i]));
+  }
+
+  // Wait for them all to connect, so they all see every event.
+  for (int i=0; i < 500 && server.numClients() < opts.m_subscribers;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  int connected = server.numClients();
+
+  // Poll synthetic input, one simulated millisecond per poll, as the
+  // viewer would, timing what the event stream adds to each poll.
+  GPVConfig config;
+  InputModel model(&config);
+  SyntheticInput synth;
+  InputEventDetector detector;
+  InputEvent events[InputEventDetector::MAX_EVENTS_PER_UPDATE];
+  LatencyHistogram publishTime;
+  std::uint64_t published = 0;
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::duration period =
+    std::chrono::nanoseconds(1000000000 / opts.m_rate);
+  Clock::time_point next = Clock::now();
+  long polls = (long)opts.m_seconds * opts.m_rate;
+  for (long p=0; p < polls; ++p) {
+    ControllerState state;
+    synth.next(state, (DWORD)p);
+    state.m_pollTimeUS = (std::uint64_t)p * 1000;
+    model.update(state);
+
+    std::uint64_t start = steadyClockUS();
+    int n = detector.update(model, events);
+    for (int i=0; i < n; ++i) {
+      server.publish(events[i]);
+    }
+    publishTime.add(steadyClockUS() - start);
+    published += n;
+
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+
+  // Let the fast subscribers catch up before disconnecting them.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::uint64_t serverDropped = server.numDropped();
+  server.stop();
+  for (std::thread &t : subscribers) {
+    t.join();
+  }
+
+  LoadSubscriberResult fast, slow;
+  bool failed = false;
+  for (LoadSubscriberResult const &r : results) {
+    LoadSubscriberResult &total = r.m_slow? slow : fast;
+    total.m_events += r.m_events;
+    total.m_dropped += r.m_dropped;
+    total.m_gaps += r.m_gaps;
+    failed = failed || r.m_failed;
+  }
+
+  std::cout << "published " << published << " events in " << polls
+            << " polls to " << connected << " subscribers\n"
+            << "per poll: p50 " << publishTime.percentileUS(0.5)
+            << " p99 " << publishTime.percentileUS(0.99)
+            << " max " << publishTime.m_maxUS << " us\n"
+            << "fast subscribers: " << fast.m_events << " events, "
+            << fast.m_dropped << " dropped, "
+            << fast.m_gaps << " unaccounted\n"
+            << "slow subscribers: " << slow.m_events << " events, "
+            << slow.m_dropped << " dropped, "
+            << slow.m_gaps << " unaccounted\n"
+            << "server dropped " << serverDropped << "\n";
+
+  bool ok = !failed &&
+            connected == opts.m_subscribers &&
+            fast.m_gaps == 0 &&
+            slow.m_gaps == 0 &&
+            fast.m_events > 0;
+  return ok? 0 : 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  EventsOptions opts;
+  parseOptions(opts, argc, argv);
+
+  if (opts.m_command == "watch") {
+    return watch(opts);
+  }
+  else {
+    return load(opts);
+  }
+}
+
+
+// EOF
@@ -0,0 +1,677 @@
+// gpv-export.cc
+// Command-line tool to render an input recording as overlay video.
+
+// See license.txt for copyright and terms of use.
+
+// This replays a recording made by the viewer (`R` key) through the
+// same drawing code, using the CPU rasterizer, and writes the frames as
+// raw video that can be composited onto gameplay footage, e.g.:
+//
+//   $ gpv-export --width 1920 --height 1080 --alpha rec.gpvrec - |
+//       ffmpeg -i - -c:v ffv1 overlay.mkv
+//
+// By default, each part of the recording is drawn with the
+// configuration that was in effect when it was recorded, as stored in
+// the recording.  `--config` overrides that.
+//
+// The work is pipelined: the main thread replays the input and makes
+// a snapshot of the model for each frame, several worker threads draw
+// and encode the snapshots, and a writer thread emits the results in
+// order.
+
+#include "alloc-audit.h"               // AllocAuditScope
+#include "bounded-queue.h"             // BoundedQueue
+#include "controller-state.h"          // ControllerState
+#include "frame-encoder.h"             // encodeFrame, FrameFormat, etc.
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+#include "input-recording.h"           // readInputRecordingFile
+#include "raster-canvas.h"             // RasterDirtyRows, RasterImage
+#include "raster-painter.h"            // RasterPainter
+
+#include <algorithm>                   // std::max
+#include <atomic>                      // std::atomic
+#include <cerrno>                      // errno
+#include <chrono>                      // std::chrono
+#include <cstdlib>                     // std::{atoi, strtoul, exit}
+#include <cstring>                     // std::{strcmp, strerror}
+#include <filesystem>                  // std::filesystem
+#include <fstream>                     // std::ofstream
+#include <iostream>                    // std::{cerr, cout}
+#include <map>                         // std::map
+#include <memory>                      // std::unique_ptr
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Command line options.
+class ExportOptions {
+public:      // data
+  // Configuration file to use instead of the configurations stored in
+  // the recording, or empty.
+  std::string m_configFile;
+
+  // Input recording.
+  std::string m_inputFile;
+
+  // Output file, or "-" for standard output.
+  std::string m_outputFile;
+
+  // Frame size in pixels.  Zero means to use the configured window
+  // size.
+  int m_width;
+  int m_height;
+
+  // Frames per second.
+  int m_fps;
+
+  // Output format.
+  FrameFormat m_format;
+
+  // If true, the background is transparent.  Otherwise it is
+  // `m_keyColor`.
+  bool m_alpha;
+
+  // Opaque background color, as 0xRRGGBB.
+  unsigned m_keyColor;
+
+  // Milliseconds to keep rendering after the last sample so that any
+  // running timers finish.
+  int m_tailMS;
+
+  // Number of drawing threads.
+  int m_threads;
+
+  // If false, draw every element every frame.
+  bool m_useStaticLayer;
+
+  // If true, count the heap allocations made while replaying and
+  // drawing, once warmed up, and fail if there are any.
+  bool m_allocAudit;
+
+public:      // methods
+  ExportOptions()
+    : m_configFile(),
+      m_inputFile(),
+      m_outputFile(),
+      m_width(0),
+      m_height(0),
+      m_fps(60),
+      m_format(FF_Y4M),
+      m_alpha(false),
+      m_keyColor(0x000000),
+      m_tailMS(1000),
+      m_threads(std::max(1u, std::thread::hardware_concurrency())),
+      m_useStaticLayer(true),
+      m_allocAudit(false)
+  {}
+};
+
+
+// One frame to draw.
+class FrameJob {
+public:      // data
+  // Position in the output, starting at 0.
+  long m_index;
+
+  // If true, this frame is identical to the previous one, so there is
+  // nothing to draw.
+  bool m_repeat;
+
+  // State to draw.  Its `m_config` points at the configuration in
+  // effect at this frame, which stays alive for the whole export.
+  InputModel m_model;
+
+public:      // methods
+  FrameJob()
+    : m_index(0),
+      m_repeat(false),
+      m_model(nullptr)
+  {}
+};
+
+
+// A buffer holding one encoded frame.
+class EncodedFrame {
+public:      // data
+  // Encoded bytes.
+  std::string m_bytes;
+
+  // The pixels of the frame that may differ from the static layer.
+  // Every worker draws the same static layer for the same key, so this
+  // is valid for any worker whose layer has `m_staticLayerKey`.
+  RasterDirtyRows m_dirtyRows;
+
+  // What the static layer under `m_bytes` was drawn for.
+  StaticLayerKey m_staticLayerKey;
+
+  // False if `m_bytes` and `m_dirtyRows` are not usable as a starting
+  // point for the next frame.
+  bool m_reusable;
+
+public:      // methods
+  EncodedFrame()
+    : m_bytes(),
+      m_dirtyRows(),
+      m_staticLayerKey(),
+      m_reusable(false)
+  {}
+};
+
+
+// One encoded frame.
+class FrameResult {
+public:      // data
+  // Position in the output.
+  long m_index;
+
+  // Encoded frame, or null to repeat the previous frame.
+  std::unique_ptr<EncodedFrame> m_bytes;
+
+public:      // methods
+  FrameResult()
+    : m_index(0),
+      m_bytes()
+  {}
+};
+
+
+// State shared by the threads.
+class ExportPipeline {
+public:      // data
+  ExportOptions const &m_options;
+
+  // Configuration in effect at the start.  Jobs may point at others.
+  GPVConfig const &m_config;
+
+  // Jobs from the replay thread to the workers.
+  BoundedQueue<FrameJob> m_jobs;
+
+  // Results from the workers to the writer, in completion order.
+  BoundedQueue<FrameResult> m_results;
+
+  // Permission to start another frame.  The writer returns a token
+  // after writing each frame, which bounds the number of frames in
+  // flight, and hence the memory used for results awaiting their turn.
+  BoundedQueue<int> m_tokens;
+
+  // Encoded-frame buffers that the writer is finished with, so the
+  // workers can reuse them rather than allocating.
+  BoundedQueue<std::unique_ptr<EncodedFrame>> m_freeBuffers;
+
+  // Where the output goes.
+  std::ostream &m_out;
+
+  // Number of frames written, and how many of them were repeats.
+  long m_framesWritten;
+  long m_framesRepeated;
+
+  // With `--alloc-audit`, the number of frames drawn in the steady
+  // state, and the allocations made while drawing them.
+  std::atomic<long> m_auditedPaints;
+  std::atomic<std::uint64_t> m_paintAllocs;
+
+public:      // methods
+  ExportPipeline(ExportOptions const &options, GPVConfig const &config,
+                 int maxFramesInFlight, std::ostream &out)
+    : m_options(options),
+      m_config(config),
+      m_jobs(maxFramesInFlight),
+      m_results(maxFramesInFlight),
+      m_tokens(maxFramesInFlight),
+      m_freeBuffers(maxFramesInFlight),
+      m_out(out),
+      m_framesWritten(0),
+      m_framesRepeated(0),
+      m_auditedPaints(0),
+      m_paintAllocs(0)
+  {
+    for (int i=0; i < maxFramesInFlight; ++i) {
+      m_tokens.push(0);
+    }
+  }
+
+  // Draw and encode jobs until there are no more.
+  void runWorker();
+
+  // Write results in order until there are no more.
+  void runWriter();
+};
+
+
+void ExportPipeline::runWorker()
+{
+  // Each worker has its own painter, and hence its own static layer.
+  InputModel const *noModelYet = nullptr;
+  RasterPainter painter(&m_config, noModelYet);
+  painter.m_useStaticLayer = m_options.m_useStaticLayer;
+  painter.m_trackDirtyRows = true;
+  if (m_options.m_alpha) {
+    painter.m_background = 0;
+  }
+  else {
+    unsigned k = m_options.m_keyColor;
+    painter.m_background =
+      rasterPixelRGB((k >> 16) & 0xFF, (k >> 8) & 0xFF, k & 0xFF);
+  }
+
+  RasterImage frame(m_options.m_width, m_options.m_height);
+
+  // Allocation audit totals for this worker.
+  bool warmedUp = false;
+  long auditedPaints = 0;
+  std::uint64_t paintAllocs = 0;
+
+  FrameJob job;
+  while (m_jobs.pop(job)) {
+    FrameResult result;
+    result.m_index = job.m_index;
+
+    if (!job.m_repeat) {
+      painter.m_painter.m_config = job.m_model.m_config;
+      painter.m_painter.m_inputModel = &job.m_model;
+
+      long layerVersion = painter.m_staticLayerVersion;
+      AllocAuditScope audit;
+      painter.paint(frame);
+
+      // The first frame sizes the painter's buffers, and redrawing the
+      // static layer is not part of the steady state, so neither
+      // counts.
+      if (m_options.m_allocAudit && warmedUp &&
+          layerVersion == painter.m_staticLayerVersion) {
+        auditedPaints++;
+        paintAllocs += audit.count();
+      }
+      warmedUp = true;
+
+      if (!m_freeBuffers.tryPop(result.m_bytes)) {
+        result.m_bytes.reset(new EncodedFrame);
+      }
+      EncodedFrame &buf = *result.m_bytes;
+
+      // If the painter says which pixels it changed, then only those
+      // and the ones that were changed in the frame previously in
+      // `buf` need to be encoded.  The rest already hold the encoded
+      // static layer.  Usually this is a small fraction of the frame.
+      // If the configuration changed the static layer since `buf` was
+      // encoded, it has to be encoded from scratch.
+      bool tracked = painter.m_dirtyRowsLayerVersion >= 0;
+      if (tracked && buf.m_reusable &&
+          buf.m_staticLayerKey == painter.m_staticLayerKey) {
+        for (int y=0; y < frame.m_height; ++y) {
+          buf.m_dirtyRows.m_rows[y].include(painter.m_dirtyRows.m_rows[y]);
+        }
+        reencodeFrameRows(buf.m_bytes, frame,
+                          m_options.m_format, m_options.m_alpha,
+                          buf.m_dirtyRows);
+      }
+      else {
+        buf.m_bytes.clear();
+        encodeFrame(buf.m_bytes, frame,
+                    m_options.m_format, m_options.m_alpha);
+      }
+
+      buf.m_reusable = tracked;
+      if (tracked) {
+        buf.m_dirtyRows = painter.m_dirtyRows;
+        buf.m_staticLayerKey = painter.m_staticLayerKey;
+      }
+    }
+
+    m_results.push(std::move(result));
+  }
+
+  m_auditedPaints += auditedPaints;
+  m_paintAllocs += paintAllocs;
+}
+
+
+void ExportPipeline::runWriter()
+{
+  // Results that arrived before their turn.
+  std::map<long, FrameResult> pending;
+
+  // Most recently written frame, for repeats.
+  std::unique_ptr<EncodedFrame> previous;
+
+  FrameResult result;
+  while (m_results.pop(result)) {
+    long index = result.m_index;
+    pending[index] = std::move(result);
+
+    // Write as many as are now in order.
+    std::map<long, FrameResult>::iterator it;
+    while ((it = pending.find(m_framesWritten)) != pending.end()) {
+      FrameResult &r = it->second;
+      if (r.m_bytes) {
+        if (previous) {
+          // If the free list is somehow full, just let it go.
+          m_freeBuffers.tryPush(previous);
+        }
+        previous = std::move(r.m_bytes);
+      }
+      else {
+        m_framesRepeated++;
+      }
+
+      if (previous) {
+        m_out.write(previous->m_bytes.data(), previous->m_bytes.size());
+      }
+
+      pending.erase(it);
+      m_framesWritten++;
+      m_tokens.push(0);
+    }
+  }
+}
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-export [options] input.gpvrec output\n"
+    "\n"
+    "Render a recording made by the gamepad viewer as raw video.  Use\n"
+    "\"-\" as the output to write to standard output.\n"
+    "\n"
+    "options:\n"
+    "  --config FILE       Viewer configuration to use instead of the ones\n"
+    "                      stored in the recording (default for recordings\n"
+    "                      without them: gamepad-viewer.json if it exists).\n"
+    "  --width N           Frame width (default: configured window width).\n"
+    "  --height N          Frame height (default: configured window height).\n"
+    "  --fps N             Frames per second (default: 60).\n"
+    "  --format y4m|rgba   Output format (default: y4m).\n"
+    "  --alpha             Transparent background.\n"
+    "  --key-color RRGGBB  Opaque background color (default: 000000).\n"
+    "  --tail-ms N         Time to keep drawing after the last input\n"
+    "                      (default: 1000).\n"
+    "  --threads N         Drawing threads (default: number of CPUs).\n"
+    "  --no-static-layer   Draw everything on every frame.\n"
+    "  --alloc-audit       Count heap allocations made by replaying and\n"
+    "                      drawing after the first frame, and exit with\n"
+    "                      status 1 if there are any.  Requires a build\n"
+    "                      with `make ALLOC_AUDIT=1`.\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-export: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+static void parseOptions(ExportOptions &opts, int argc, char **argv)
+{
+  std::vector<std::string> positional;
+
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--config")) {
+      opts.m_configFile = optionArg(argc, argv, i);
+    }
+    else if (0==std::strcmp(arg, "--width")) {
+      opts.m_width = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--height")) {
+      opts.m_height = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--fps")) {
+      opts.m_fps = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--format")) {
+      std::string f = optionArg(argc, argv, i);
+      if (f == "y4m") {
+        opts.m_format = FF_Y4M;
+      }
+      else if (f == "rgba") {
+        opts.m_format = FF_RGBA;
+      }
+      else {
+        std::cerr << "gpv-export: unknown format: " << f << "\n";
+        usage();
+      }
+    }
+    else if (0==std::strcmp(arg, "--alpha")) {
+      opts.m_alpha = true;
+    }
+    else if (0==std::strcmp(arg, "--key-color")) {
+      opts.m_keyColor = std::strtoul(optionArg(argc, argv, i), nullptr, 16);
+    }
+    else if (0==std::strcmp(arg, "--tail-ms")) {
+      opts.m_tailMS = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--threads")) {
+      opts.m_threads = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--no-static-layer")) {
+      opts.m_useStaticLayer = false;
+    }
+    else if (0==std::strcmp(arg, "--alloc-audit")) {
+      opts.m_allocAudit = true;
+    }
+    else if (arg[0] == '-' && arg[1] != 0) {
+      std::cerr << "gpv-export: unknown option: " << arg << "\n";
+      usage();
+    }
+    else {
+      positional.push_back(arg);
+    }
+  }
+
+  if (positional.size() != 2) {
+    usage();
+  }
+  opts.m_inputFile = positional[0];
+  opts.m_outputFile = positional[1];
+
+  if (opts.m_fps <= 0 || opts.m_threads <= 0 || opts.m_tailMS < 0) {
+    std::cerr << "gpv-export: --fps, --threads, and --tail-ms "
+                 "must be positive\n";
+    usage();
+  }
+
+  if (opts.m_allocAudit && !allocAuditCompiledIn()) {
+    std::cerr << "gpv-export: --alloc-audit requires a build with "
+                 "`make ALLOC_AUDIT=1`\n";
+    std::exit(2);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  ExportOptions opts;
+  parseOptions(opts, argc, argv);
+
+  std::vector<ControllerState> samples;
+  std::vector<RecordedConfig> configs;
+  {
+    std::string error =
+      readInputRecordingFile(opts.m_inputFile, samples, configs);
+    if (!error.empty()) {
+      std::cerr << opts.m_inputFile << ": " << error << "\n";
+      return 2;
+    }
+  }
+  if (samples.empty()) {
+    std::cerr << opts.m_inputFile << ": recording has no samples\n";
+    return 2;
+  }
+
+  // Use the configuration file if asked to, or if the recording
+  // predates storing configurations in it.
+  if (opts.m_configFile.empty() && configs.empty() &&
+      std::filesystem::exists("gamepad-viewer.json")) {
+    opts.m_configFile = "gamepad-viewer.json";
+  }
+  if (!opts.m_configFile.empty() || configs.empty()) {
+    GPVConfig fileConfig;
+    if (!opts.m_configFile.empty()) {
+      std::string error = fileConfig.loadFromFile(opts.m_configFile);
+      if (!error.empty()) {
+        std::cerr << opts.m_configFile << ": " << error << "\n";
+        return 2;
+      }
+    }
+    configs.clear();
+    configs.emplace_back(0, 0, fileConfig);
+  }
+
+  // Everything recorded before the first sample is in effect from the
+  // start, so the last of those is the initial configuration.
+  std::size_t nextConfig = 0;
+  while (nextConfig+1 < configs.size() &&
+         configs[nextConfig+1].m_firstSample == 0) {
+    nextConfig++;
+  }
+  GPVConfig const &config = configs[nextConfig].m_config;
+  nextConfig++;
+
+  if (opts.m_width <= 0) {
+    opts.m_width = config.m_windowWidth;
+  }
+  if (opts.m_height <= 0) {
+    opts.m_height = config.m_windowHeight;
+  }
+
+  // Timeline, using the recording's clock.
+  DWORD const startMS = samples.front().m_pollTimeMS;
+  DWORD const durationMS =
+    (DWORD)(samples.back().m_pollTimeMS - startMS) + opts.m_tailMS;
+  long const numFrames = (long)((double)durationMS * opts.m_fps / 1000.0) + 1;
+
+  std::ofstream outFile;
+  if (opts.m_outputFile != "-") {
+    outFile.open(opts.m_outputFile, std::ios::binary);
+    if (!outFile) {
+      std::cerr << opts.m_outputFile << ": " << std::strerror(errno) << "\n";
+      return 2;
+    }
+  }
+  else {
+    std::ios::sync_with_stdio(false);
+  }
+  std::ostream &out = outFile.is_open()? outFile : std::cout;
+
+  std::string header = frameStreamHeader(opts.m_format,
+    opts.m_width, opts.m_height, opts.m_fps, opts.m_alpha);
+  out.write(header.data(), header.size());
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  // Enough frames in flight to keep every worker busy while the writer
+  // waits on a slow one.
+  ExportPipeline pipeline(opts, config, opts.m_threads * 3, out);
+
+  std::vector<std::thread> workers;
+  for (int i=0; i < opts.m_threads; ++i) {
+    workers.emplace_back([&pipeline] { pipeline.runWorker(); });
+  }
+  std::thread writer([&pipeline] { pipeline.runWriter(); });
+
+  // Replay.
+  InputModel model(&config);
+  std::size_t nextSample = 0;
+  std::uint64_t replayAllocs = 0;
+  for (long f = 0; f < numFrames; ++f) {
+    AllocAuditScope audit;
+    DWORD frameMS = startMS + (DWORD)((double)f * 1000.0 / opts.m_fps);
+    bool timersWereRunning = model.isAnyButtonTimerRunning();
+
+    // Apply the configurations and samples up to and including this
+    // frame's time, in the order they were recorded.
+    DWORD const frameOffset = (DWORD)(frameMS - startMS);
+    bool changed = false;
+    while (true) {
+      if (nextConfig < configs.size() &&
+          configs[nextConfig].m_firstSample == nextSample) {
+        RecordedConfig const &rc = configs[nextConfig];
+        if ((DWORD)(rc.m_timeMS - startMS) > frameOffset) {
+          // Not yet, and the samples after it are not either.
+          break;
+        }
+        model.m_config = &rc.m_config;
+        nextConfig++;
+        changed = true;
+      }
+      else if (nextSample < samples.size() &&
+               (DWORD)(samples[nextSample].m_pollTimeMS - startMS) <=
+                 frameOffset) {
+        model.update(samples[nextSample]);
+        nextSample++;
+        changed = true;
+      }
+      else {
+        break;
+      }
+    }
+    model.advanceTime(frameMS);
+    if (f > 0) {
+      replayAllocs += audit.count();
+    }
+
+    int token;
+    pipeline.m_tokens.pop(token);
+
+    FrameJob job;
+    job.m_index = f;
+
+    // Same criteria the viewer uses to decide whether to redraw.
+    job.m_repeat = f > 0 &&
+                   !changed &&
+                   !timersWereRunning &&
+                   !model.isAnyButtonTimerRunning();
+    job.m_model = model;
+    pipeline.m_jobs.push(std::move(job));
+  }
+
+  pipeline.m_jobs.close();
+  for (std::thread &t : workers) {
+    t.join();
+  }
+  pipeline.m_results.close();
+  writer.join();
+
+  out.flush();
+  if (!out) {
+    std::cerr << opts.m_outputFile << ": write failed\n";
+    return 2;
+  }
+
+  double wallSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wallStart).count();
+  double inputSeconds = (double)numFrames / opts.m_fps;
+  std::cerr << "gpv-export: " << pipeline.m_framesWritten << " frames ("
+            << pipeline.m_framesRepeated << " repeated), "
+            << opts.m_width << "x" << opts.m_height << " at "
+            << opts.m_fps << " fps, in " << wallSeconds << " s: "
+            << (pipeline.m_framesWritten / wallSeconds) << " fps, "
+            << (inputSeconds / wallSeconds) << "x real time\n";
+
+  if (opts.m_allocAudit) {
+    std::uint64_t paintAllocs = pipeline.m_paintAllocs;
+    std::cerr << "gpv-export: allocation audit: "
+              << replayAllocs << " allocations replaying "
+              << (numFrames-1) << " frames, "
+              << paintAllocs << " drawing "
+              << pipeline.m_auditedPaints << " frames\n";
+    if (replayAllocs != 0 || paintAllocs != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+// EOF
@@ -0,0 +1,508 @@
+// gpv-seek.cc
+// Command-line tool to index input recordings and benchmark seeking.
+
+// See license.txt for copyright and terms of use.
+
+// `gpv-seek index IN OUT` rewrites a recording with keyframes and an
+// index (see input-recording.h), which recordings made before those
+// existed lack.
+//
+// `gpv-seek synth OUT` writes a long recording of synthetic input, by
+// default three hours of it, changing the configuration now and then.
+//
+// `gpv-seek bench FILE` seeks to many random times in an indexed
+// recording, timing each seek, and checks every result against
+// decoding the whole recording from the start, which it also times.
+// It exits with status 1 if any seek disagrees.
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+#include "input-recording.h"           // InputRecording{Reader,Writer}
+#include "latency-histogram.h"         // LatencyHistogram
+#include "synthetic-input.h"           // SyntheticInput
+
+#include <algorithm>                   // std::sort
+#include <cerrno>                      // errno
+#include <cstdint>                     // std::uint64_t
+#include <cstdlib>                     // std::{atoi, exit}
+#include <cstring>                     // std::{strcmp, strerror}
+#include <fstream>                     // std::{ifstream, ofstream}
+#include <iostream>                    // std::{cerr, cout}
+#include <random>                      // std::mt19937
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Command line options.
+class SeekOptions {
+public:      // data
+  // "index", "synth", or "bench".
+  std::string m_command;
+
+  // File names after the command.
+  std::vector<std::string> m_files;
+
+  // For "synth", the length of the recording, and the time between
+  // polls.
+  int m_minutes;
+  int m_pollMS;
+
+  // For "index" and "synth", the time between keyframes.
+  int m_keyframeMS;
+
+  // For "bench", the number of seeks, and the random seed.
+  int m_seeks;
+  int m_seed;
+
+public:      // methods
+  SeekOptions()
+    : m_command(),
+      m_files(),
+      m_minutes(180),
+      m_pollMS(4),
+      m_keyframeMS(10000),
+      m_seeks(1000),
+      m_seed(1)
+  {}
+};
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-seek [options] index IN OUT\n"
+    "       gpv-seek [options] synth OUT\n"
+    "       gpv-seek [options] bench FILE\n"
+    "\n"
+    "index: Rewrite recording IN as OUT with keyframes and an index.\n"
+    "\n"
+    "synth: Write a long recording of synthetic input to OUT.\n"
+    "\n"
+    "bench: Time random seeks in FILE, checking each against decoding\n"
+    "from the start.\n"
+    "\n"
+    "options:\n"
+    "  --keyframe-ms N     Time between keyframes (default: 10000).\n"
+    "  --minutes N         Length of the synthetic recording\n"
+    "                      (default: 180).\n"
+    "  --poll-ms N         Time between synthetic polls (default: 4).\n"
+    "  --seeks N           Number of seeks to time (default: 1000).\n"
+    "  --seed N            Seed for the seek times (default: 1).\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-seek: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+static void parseOptions(SeekOptions &opts, int argc, char **argv)
+{
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--keyframe-ms")) {
+      opts.m_keyframeMS = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--minutes")) {
+      opts.m_minutes = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--poll-ms")) {
+      opts.m_pollMS = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--seeks")) {
+      opts.m_seeks = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--seed")) {
+      opts.m_seed = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (arg[0] == '-') {
+      std::cerr << "gpv-seek: unknown option: " << arg << "\n";
+      usage();
+    }
+    else if (opts.m_command.empty()) {
+      opts.m_command = arg;
+    }
+    else {
+      opts.m_files.push_back(arg);
+    }
+  }
+
+  std::size_t numFiles = opts.m_command == "index"? 2 : 1;
+  if ((opts.m_command != "index" && opts.m_command != "synth" &&
+       opts.m_command != "bench") ||
+      opts.m_files.size() != numFiles) {
+    usage();
+  }
+  if (opts.m_minutes <= 0 || opts.m_pollMS <= 0 ||
+      opts.m_keyframeMS < 0 || opts.m_seeks <= 0) {
+    std::cerr << "gpv-seek: --minutes, --poll-ms, and --seeks must be "
+                 "positive, and --keyframe-ms not negative\n";
+    usage();
+  }
+}
+
+
+// Open `fname` for reading and read its header.  Return false after
+// printing an error if that fails.
+static bool openRecording(std::ifstream &in, InputRecordingReader &reader,
+                          std::string const &fname)
+{
+  in.open(fname, std::ios::binary);
+  if (!in) {
+    std::cerr << fname << ": " << std::strerror(errno) << "\n";
+    return false;
+  }
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return false;
+  }
+  return true;
+}
+
+
+// Finish writing `out`, to `fname`.  Return false after printing an
+// error if that fails.
+static bool finishRecording(std::ofstream &out,
+                            InputRecordingWriter &writer,
+                            std::string const &fname)
+{
+  writer.writeFooter();
+  out.close();
+  if (!out) {
+    std::cerr << fname << ": write failed\n";
+    return false;
+  }
+  std::cout << fname << ": " << writer.m_sampleCount << " samples, "
+            << writer.m_configCount << " configurations\n";
+  return true;
+}
+
+
+// ------------------------------- index -------------------------------
+static int indexRecording(SeekOptions const &opts)
+{
+  std::string const &inFname = opts.m_files[0];
+  std::string const &outFname = opts.m_files[1];
+
+  std::ifstream in;
+  InputRecordingReader reader(in);
+  if (!openRecording(in, reader, inFname)) {
+    return 2;
+  }
+
+  std::ofstream out(outFname, std::ios::binary);
+  if (!out) {
+    std::cerr << outFname << ": " << std::strerror(errno) << "\n";
+    return 2;
+  }
+  InputRecordingWriter writer(out);
+  writer.m_keyframeIntervalMS = opts.m_keyframeMS;
+
+  // The header includes a configuration, which is the first record of
+  // a recording unless it is from before configurations were recorded.
+  bool wroteHeader = false;
+  while (int type = reader.readNext()) {
+    if (!wroteHeader) {
+      writer.writeHeader(reader.m_config);
+      wroteHeader = true;
+      if (type == IRT_CONFIG) {
+        continue;
+      }
+    }
+
+    if (type == IRT_SAMPLE) {
+      writer.writeSample(reader.m_state);
+    }
+    else {
+      writer.writeConfig(reader.m_config, reader.m_configTimeMS);
+    }
+  }
+  if (!reader.m_error.empty()) {
+    std::cerr << inFname << ": " << reader.m_error << "\n";
+    return 2;
+  }
+
+  return finishRecording(out, writer, outFname)? 0 : 2;
+}
+
+
+// ------------------------------- synth -------------------------------
+static int synthRecording(SeekOptions const &opts)
+{
+  std::string const &fname = opts.m_files[0];
+  std::ofstream out(fname, std::ios::binary);
+  if (!out) {
+    std::cerr << fname << ": " << std::strerror(errno) << "\n";
+    return 2;
+  }
+  InputRecordingWriter writer(out);
+  writer.m_keyframeIntervalMS = opts.m_keyframeMS;
+
+  GPVConfig config;
+  writer.writeHeader(config);
+
+  SyntheticInput synth;
+  DWORD endMS = (DWORD)opts.m_minutes * 60000;
+  for (DWORD t=0; t < endMS; t += opts.m_pollMS) {
+    // Change something every 20 minutes, so seeking has to find the
+    // right configuration.
+    if (t > 0 && t % 1200000 == 0) {
+      int &deadZone = config.m_analogThresholds.m_triggerDeadZone;
+      deadZone = (deadZone + 7) % 64;
+      writer.writeConfig(config, t);
+    }
+
+    ControllerState state;
+    synth.next(state, t);
+    writer.writeSample(state);
+  }
+
+  return finishRecording(out, writer, fname)? 0 : 2;
+}
+
+
+// ------------------------------- bench -------------------------------
+// Where a seek ended up.
+class SeekResult {
+public:      // data
+  ControllerState m_state;
+  long m_sampleCount;
+  DWORD m_configTimeMS;
+  int m_triggerDeadZone;
+  ButtonTimer m_timers[3];
+
+public:      // methods
+  SeekResult()
+    : m_state(),
+      m_sampleCount(0),
+      m_configTimeMS(0),
+      m_triggerDeadZone(0),
+      m_timers()
+  {}
+
+  SeekResult(long sampleCount, DWORD configTimeMS,
+             GPVConfig const &config, InputModel const &model)
+    : m_state(model.m_controllerState),
+      m_sampleCount(sampleCount),
+      m_configTimeMS(configTimeMS),
+      m_triggerDeadZone(config.m_analogThresholds.m_triggerDeadZone),
+      m_timers{ model.m_parryTimer,
+                model.m_dodgeReleaseTimer,
+                model.m_dodgeInvulnerabilityTimer }
+  {}
+
+  bool operator==(SeekResult const &obj) const;
+};
+
+
+bool SeekResult::operator==(SeekResult const &obj) const
+{
+  XINPUT_GAMEPAD const &g = m_state.m_inputState.Gamepad;
+  XINPUT_GAMEPAD const &og = obj.m_state.m_inputState.Gamepad;
+  if (m_state.m_pollTimeMS != obj.m_state.m_pollTimeMS ||
+      m_state.m_hasInputState != obj.m_state.m_hasInputState ||
+      m_state.m_inputState.dwPacketNumber !=
+        obj.m_state.m_inputState.dwPacketNumber ||
+      g.wButtons != og.wButtons ||
+      g.bLeftTrigger != og.bLeftTrigger ||
+      g.bRightTrigger != og.bRightTrigger ||
+      g.sThumbLX != og.sThumbLX ||
+      g.sThumbLY != og.sThumbLY ||
+      g.sThumbRX != og.sThumbRX ||
+      g.sThumbRY != og.sThumbRY ||
+      m_sampleCount != obj.m_sampleCount ||
+      m_configTimeMS != obj.m_configTimeMS ||
+      m_triggerDeadZone != obj.m_triggerDeadZone) {
+    return false;
+  }
+  for (int i=0; i < 3; ++i) {
+    // The start time of a timer that is not running is left over from
+    // its last run, and not part of the state.
+    ButtonTimer const &t = m_timers[i];
+    ButtonTimer const &ot = obj.m_timers[i];
+    if (t.m_running != ot.m_running ||
+        t.m_queued != ot.m_queued ||
+        (t.m_running && t.m_startMS != ot.m_startMS)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// A seek target, and where seeking there ended up.
+class SeekTarget {
+public:      // data
+  DWORD m_timeMS;
+  SeekResult m_result;
+
+public:      // methods
+  SeekTarget()
+    : m_timeMS(0),
+      m_result()
+  {}
+};
+
+
+static int bench(SeekOptions const &opts)
+{
+  std::string const &fname = opts.m_files[0];
+
+  // Decode everything once, as scrubbing would without an index, to
+  // time it and find the time range.
+  DWORD lastTimeMS = 0;
+  {
+    std::ifstream in;
+    InputRecordingReader reader(in);
+    if (!openRecording(in, reader, fname)) {
+      return 2;
+    }
+    InputModel model(&reader.m_config);
+
+    std::uint64_t start = steadyClockUS();
+    while (reader.readSample()) {
+      model.update(reader.m_state);
+    }
+    std::uint64_t elapsedUS = steadyClockUS() - start;
+    if (!reader.m_error.empty()) {
+      std::cerr << fname << ": " << reader.m_error << "\n";
+      return 2;
+    }
+    lastTimeMS = reader.m_state.m_pollTimeMS;
+
+    std::cout << fname << ": " << reader.m_sampleCount << " samples, "
+              << lastTimeMS / 60000.0 << " minutes\n"
+              << "full decode: " << elapsedUS / 1000 << " ms\n";
+  }
+
+  std::ifstream in;
+  InputRecordingReader reader(in);
+  if (!openRecording(in, reader, fname)) {
+    return 2;
+  }
+  std::string error = reader.readIndex();
+  if (!error.empty()) {
+    std::cerr << fname << ": " << error << "\n";
+    return 2;
+  }
+  std::cout << "index: " << reader.m_index.size() << " keyframes\n";
+
+  // Random times from a little before the first sample to a little
+  // after the last.
+  std::mt19937 rng(opts.m_seed);
+  std::uniform_int_distribution<std::int64_t> dist(
+    (std::int64_t)reader.m_firstSampleTimeMS - 1000,
+    (std::int64_t)lastTimeMS + 1000);
+  std::vector<SeekTarget> targets(opts.m_seeks);
+  for (SeekTarget &t : targets) {
+    t.m_timeMS = (DWORD)std::max<std::int64_t>(0, dist(rng));
+  }
+
+  InputModel model(&reader.m_config);
+  LatencyHistogram seekTime;
+  for (SeekTarget &t : targets) {
+    std::uint64_t start = steadyClockUS();
+    error = reader.seek(t.m_timeMS, model);
+    seekTime.add(steadyClockUS() - start);
+    if (!error.empty()) {
+      std::cerr << fname << ": seek to " << t.m_timeMS << ": " << error
+                << "\n";
+      return 1;
+    }
+    t.m_result = SeekResult(reader.m_sampleCount, reader.m_configTimeMS,
+                            reader.m_config, model);
+  }
+
+  std::cout << "seek: p50 " << seekTime.percentileUS(0.5)
+            << " p99 " << seekTime.percentileUS(0.99)
+            << " max " << seekTime.m_maxUS << " us over "
+            << targets.size() << " seeks\n";
+
+  // Check them all with one pass over the recording in time order.
+  std::sort(targets.begin(), targets.end(),
+    [](SeekTarget const &a, SeekTarget const &b) {
+      return a.m_timeMS < b.m_timeMS;
+    });
+
+  std::ifstream checkIn;
+  InputRecordingReader checker(checkIn);
+  if (!openRecording(checkIn, checker, fname)) {
+    return 2;
+  }
+
+  // The checker reads one record ahead, so what is in effect is kept
+  // separately.
+  GPVConfig config;
+  DWORD configTimeMS = 0;
+  long sampleCount = 0;
+  InputModel checkModel(&config);
+
+  int type = checker.readNext();
+  long mismatches = 0;
+  for (SeekTarget const &t : targets) {
+    while (type != 0) {
+      DWORD recordTimeMS = type == IRT_SAMPLE?
+        checker.m_state.m_pollTimeMS : checker.m_configTimeMS;
+      if (recordTimeMS > t.m_timeMS) {
+        break;
+      }
+      if (type == IRT_SAMPLE) {
+        checkModel.update(checker.m_state);
+        sampleCount++;
+      }
+      else {
+        config = checker.m_config;
+        configTimeMS = checker.m_configTimeMS;
+      }
+      type = checker.readNext();
+    }
+
+    InputModel expectModel(checkModel);
+    expectModel.advanceTime(t.m_timeMS);
+    SeekResult expect(sampleCount, configTimeMS, config, expectModel);
+    if (!(t.m_result == expect)) {
+      if (mismatches++ < 10) {
+        std::cerr << "seek to " << t.m_timeMS << " disagrees with "
+                     "decoding from the start\n";
+      }
+    }
+  }
+  if (!checker.m_error.empty()) {
+    std::cerr << fname << ": " << checker.m_error << "\n";
+    return 2;
+  }
+
+  std::cout << "checked " << targets.size() << " seeks: "
+            << mismatches << " mismatches\n";
+  return mismatches == 0? 0 : 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  SeekOptions opts;
+  parseOptions(opts, argc, argv);
+
+  if (opts.m_command == "index") {
+    return indexRecording(opts);
+  }
+  else if (opts.m_command == "synth") {
+    return synthRecording(opts);
+  }
+  else {
+    return bench(opts);
+  }
+}
+
+
+// EOF
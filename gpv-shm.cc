@@ -0,0 +1,386 @@
+// gpv-shm.cc
+// Command-line tool to read, and stress, the shared input region.
+
+// See license.txt for copyright and terms of use.
+
+// `gpv-shm watch` prints the samples that a viewer started with
+// `PUBLISH_INPUT` is publishing, as an example of reading them and a
+// way to check that publishing works.
+//
+// `gpv-shm stress` checks the sequence lock itself.  It publishes as
+// fast as it can, from one thread, into a region of its own, samples
+// in which every word is derived from the sample number, while many
+// reader threads, each with its own mapping of the region, read
+// continuously and check that every sample they get is consistent
+// with its number and that the numbers never go backwards.  It exits
+// with status 1 if any reader saw a torn or out-of-order sample.
+
+#include "input-model.h"               // ButtonWindowState
+#include "shared-input.h"              // SharedInput{Publisher,Reader}
+
+#include <atomic>                      // std::atomic
+#include <chrono>                      // std::chrono
+#include <cstdlib>                     // std::{atoi, exit}
+#include <cstring>                     // std::{memcmp, memcpy, strcmp}
+#include <iostream>                    // std::{cerr, cout}
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Command line options.
+class ShmOptions {
+public:      // data
+  // "watch" or "stress".
+  std::string m_command;
+
+  // Region name.
+  std::string m_name;
+
+  // For "stress", the number of reader threads.
+  int m_readers;
+
+  // For "stress", how long to run.
+  int m_seconds;
+
+public:      // methods
+  ShmOptions()
+    : m_command(),
+      m_name(),
+      m_readers(16),
+      m_seconds(5)
+  {}
+};
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-shm [options] watch|stress\n"
+    "\n"
+    "watch: Print the samples published by a viewer started with\n"
+    "PUBLISH_INPUT set.\n"
+    "\n"
+    "stress: Publish into a private region while many threads read it,\n"
+    "and check that no reader sees a torn sample.\n"
+    "\n"
+    "options:\n"
+    "  --name NAME         Region name (default for watch: "
+      SHARED_INPUT_DEFAULT_NAME ",\n"
+    "                      for stress: gpv-shm-stress).\n"
+    "  --readers N         Reader threads for stress (default: 16).\n"
+    "  --seconds N         How long to stress (default: 5).\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-shm: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+static void parseOptions(ShmOptions &opts, int argc, char **argv)
+{
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--name")) {
+      opts.m_name = optionArg(argc, argv, i);
+    }
+    else if (0==std::strcmp(arg, "--readers")) {
+      opts.m_readers = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--seconds")) {
+      opts.m_seconds = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (arg[0] == '-') {
+      std::cerr << "gpv-shm: unknown option: " << arg << "\n";
+      usage();
+    }
+    else if (opts.m_command.empty()) {
+      opts.m_command = arg;
+    }
+    else {
+      usage();
+    }
+  }
+
+  if (opts.m_command != "watch" && opts.m_command != "stress") {
+    usage();
+  }
+  if (opts.m_readers <= 0 || opts.m_seconds <= 0) {
+    std::cerr << "gpv-shm: --readers and --seconds must be positive\n";
+    usage();
+  }
+  if (opts.m_name.empty()) {
+    opts.m_name = opts.m_command == "watch"?
+                    SHARED_INPUT_DEFAULT_NAME : "gpv-shm-stress";
+  }
+}
+
+
+// ------------------------------- watch -------------------------------
+// Print `t` like "parry 3 of 6 312ms".
+static void printTimer(char const *label, SharedTimerState const &t)
+{
+  std::cout << "  " << label;
+  if (!t.m_running) {
+    std::cout << " -";
+    return;
+  }
+
+  switch (t.m_windowState) {
+    case BWS_BEFORE:
+      std::cout << " " << t.m_frameDelta << " late";
+      break;
+
+    case BWS_ACTIVE:
+      std::cout << " " << t.m_frameDelta << " of " << t.m_maxFrame;
+      break;
+
+    case BWS_AFTER:
+      std::cout << " " << t.m_frameDelta << " early";
+      break;
+
+    default:
+      // No window.
+      break;
+  }
+  std::cout << " " << t.m_elapsedMS << "ms";
+  if (t.m_queued) {
+    std::cout << "+";
+  }
+}
+
+
+static int watch(ShmOptions const &opts)
+{
+  SharedInputReader reader;
+  std::string error = reader.open(opts.m_name);
+  if (!error.empty()) {
+    std::cerr << opts.m_name << ": " << error << "\n";
+    return 2;
+  }
+
+  std::uint64_t lastNumber = 0;
+  while (true) {
+    SharedInputSample s;
+    if (reader.read(s) && s.m_sampleNumber != lastNumber) {
+      if (lastNumber && s.m_sampleNumber > lastNumber+1) {
+        std::cout << "(" << (s.m_sampleNumber - lastNumber - 1)
+                  << " not shown)\n";
+      }
+      lastNumber = s.m_sampleNumber;
+
+      XINPUT_GAMEPAD const &g = s.m_inputState.Gamepad;
+      std::cout << "#" << s.m_sampleNumber
+                << " t=" << s.m_pollTimeMS
+                << " id=" << s.m_controllerID;
+      if (s.m_hasInputState) {
+        std::cout << " packet=" << s.m_inputState.dwPacketNumber
+                  << std::hex << " buttons=" << g.wButtons << std::dec
+                  << " LT=" << (int)g.bLeftTrigger
+                  << " RT=" << (int)g.bRightTrigger
+                  << " L=" << g.sThumbLX << "," << g.sThumbLY
+                  << " R=" << g.sThumbRX << "," << g.sThumbRY;
+      }
+      else {
+        std::cout << " (no controller)";
+      }
+      printTimer("parry", s.m_parryTimer);
+      printTimer("dodge", s.m_dodgeInvulnerabilityTimer);
+      std::cout << std::endl;
+    }
+
+    // Printing every sample of a fast poll would flood the terminal.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+
+// ------------------------------ stress -------------------------------
+// Fill `s` with the contents expected of sample number `n`.
+static void fillStressSample(SharedInputSample &s, std::uint64_t n)
+{
+  std::uint32_t words[SharedInputRegion::SAMPLE_WORDS];
+  for (int i=0; i < SharedInputRegion::SAMPLE_WORDS; ++i) {
+    words[i] = (std::uint32_t)(n * 2654435761u) + (std::uint32_t)i;
+  }
+  std::memcpy(&s, words, sizeof(s));
+  s.m_sampleNumber = n;
+}
+
+
+// What one reader thread saw.
+class StressReaderResult {
+public:      // data
+  // Successful reads.
+  long m_reads;
+
+  // Reads that returned a sample other than the previous one.
+  long m_newSamples;
+
+  // Reads whose contents did not match their number.
+  long m_torn;
+
+  // Reads whose number was below the previous one.
+  long m_backwards;
+
+  // Reads that gave up because the publisher was writing, which
+  // happens when it is preempted in the middle.  These are retried.
+  long m_busy;
+
+  // True if the region could not be opened.
+  bool m_openFailed;
+
+public:      // methods
+  StressReaderResult()
+    : m_reads(0),
+      m_newSamples(0),
+      m_torn(0),
+      m_backwards(0),
+      m_busy(0),
+      m_openFailed(false)
+  {}
+};
+
+
+static void stressReader(std::string const &name,
+                         std::atomic<bool> const &stop,
+                         StressReaderResult &result)
+{
+  SharedInputReader reader;
+  std::string error = reader.open(name);
+  if (!error.empty()) {
+    std::cerr << name << ": " << error << "\n";
+    result.m_openFailed = true;
+    return;
+  }
+
+  std::uint64_t lastNumber = 0;
+  SharedInputSample s, expect;
+  while (!stop.load(std::memory_order_relaxed)) {
+    if (!reader.read(s)) {
+      if (lastNumber) {
+        result.m_busy++;
+      }
+      continue;
+    }
+    result.m_reads++;
+
+    fillStressSample(expect, s.m_sampleNumber);
+    if (std::memcmp(&s, &expect, sizeof(s)) != 0) {
+      result.m_torn++;
+    }
+
+    if (s.m_sampleNumber < lastNumber) {
+      result.m_backwards++;
+    }
+    else if (s.m_sampleNumber > lastNumber) {
+      result.m_newSamples++;
+      lastNumber = s.m_sampleNumber;
+    }
+  }
+}
+
+
+// Publish as fast as possible for `seconds`, and return the number of
+// samples per second.
+static double stressPublish(SharedInputPublisher &publisher, int seconds)
+{
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  Clock::time_point end = start + std::chrono::seconds(seconds);
+
+  std::uint64_t startCount = publisher.sampleCount();
+  SharedInputSample s;
+  while (Clock::now() < end) {
+    // Check the clock only every so often.
+    for (int i=0; i < 1000; ++i) {
+      fillStressSample(s, publisher.sampleCount()+1);
+      publisher.publish(s);
+    }
+  }
+
+  double elapsed =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  return (publisher.sampleCount() - startCount) / elapsed;
+}
+
+
+static int stress(ShmOptions const &opts)
+{
+  SharedInputPublisher publisher;
+  std::string error = publisher.open(opts.m_name);
+  if (!error.empty()) {
+    std::cerr << opts.m_name << ": " << error << "\n";
+    return 2;
+  }
+
+  // First, with nobody reading, for comparison.
+  double aloneRate = stressPublish(publisher, 1);
+
+  std::atomic<bool> stop(false);
+  std::vector<StressReaderResult> results(opts.m_readers);
+  std::vector<std::thread> readers;
+  for (int i=0; i < opts.m_readers; ++i) {
+    readers.emplace_back(stressReader, std::cref(opts.m_name),
+                         std::cref(stop), std::ref(results[i]));
+  }
+
+  double contendedRate = stressPublish(publisher, opts.m_seconds);
+
+  stop = true;
+  for (std::thread &t : readers) {
+    t.join();
+  }
+
+  StressReaderResult total;
+  for (StressReaderResult const &r : results) {
+    total.m_reads += r.m_reads;
+    total.m_newSamples += r.m_newSamples;
+    total.m_torn += r.m_torn;
+    total.m_backwards += r.m_backwards;
+    total.m_busy += r.m_busy;
+    total.m_openFailed = total.m_openFailed || r.m_openFailed;
+  }
+
+  std::cout << "published " << publisher.sampleCount() << " samples: "
+            << (long)aloneRate << "/s alone, "
+            << (long)contendedRate << "/s with "
+            << opts.m_readers << " readers\n"
+            << "readers: " << total.m_reads << " reads, "
+            << total.m_newSamples << " new samples, "
+            << total.m_torn << " torn, "
+            << total.m_backwards << " backwards, "
+            << total.m_busy << " busy\n";
+
+  bool ok = total.m_torn == 0 &&
+            total.m_backwards == 0 &&
+            !total.m_openFailed &&
+            total.m_reads > 0;
+  return ok? 0 : 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  ShmOptions opts;
+  parseOptions(opts, argc, argv);
+
+  if (opts.m_command == "watch") {
+    return watch(opts);
+  }
+  else {
+    return stress(opts);
+  }
+}
+
+
+// EOF
@@ -0,0 +1,772 @@
+// gpv-sweep.cc
+// Command-line tool to fit timer windows to recorded outcomes.
+
+// See license.txt for copyright and terms of use.
+
+// Given input recordings made by the viewer (`R` key) and a list of
+// parry or dodge attempts in them, each marked with whether it
+// actually worked in the game, this tries every combination of active
+// window start, active window end, and (for parries) trigger dead zone
+// in a grid, and reports the combinations whose timer display would
+// have agreed with the game most often.
+//
+// The attempts file has one attempt per line:
+//
+//   # recording              kind   timeMS  worked
+//   session1.gpvrec          parry  51230   yes
+//   session1.gpvrec          dodge  60410   no
+//
+// where `timeMS` is when the attack landed, in milliseconds since the
+// first sample of the recording (which is how `gpv-export` output is
+// timed), and `worked` says whether the parry or dodge succeeded.
+// Recording names are relative to the attempts file.
+//
+// For each candidate, each attempt is replayed from shortly before
+// its time, using the configuration recorded at that point with the
+// candidate's values substituted, and the candidate is charged an
+// error whenever the timer would show the window as active and the
+// attempt failed, or vice versa.  Candidates are evaluated on all
+// cores.
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+#include "input-recording.h"           // readInputRecordingFile
+
+#include <algorithm>                   // std::{max, sort}
+#include <atomic>                      // std::atomic
+#include <cerrno>                      // errno
+#include <chrono>                      // std::chrono
+#include <cstdlib>                     // std::{atoi, exit, strtol}
+#include <cstring>                     // std::{strcmp, strerror}
+#include <filesystem>                  // std::filesystem
+#include <fstream>                     // std::{ifstream, ofstream}
+#include <iomanip>                     // std::{fixed, setprecision, setw}
+#include <iostream>                    // std::{cerr, cout}
+#include <map>                         // std::map
+#include <sstream>                     // std::istringstream
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Which timer an attempt is judged by.
+enum AttemptKind {
+  AK_PARRY,
+  AK_DODGE,
+};
+
+
+// An inclusive range of values to try, in steps.
+class SweepRange {
+public:      // data
+  int m_min;
+  int m_max;
+  int m_step;
+
+public:      // methods
+  SweepRange(int min, int max, int step)
+    : m_min(min),
+      m_max(max),
+      m_step(step)
+  {}
+
+  // Parse "MIN:MAX:STEP" or a single value.  Return false if it is
+  // malformed.
+  bool parse(char const *str);
+
+  // Values in the range.
+  std::vector<int> values() const;
+};
+
+
+bool SweepRange::parse(char const *str)
+{
+  char *end;
+  long min = std::strtol(str, &end, 10);
+  if (end == str) {
+    return false;
+  }
+  if (*end == 0) {
+    m_min = m_max = (int)min;
+    m_step = 1;
+    return min >= 0;
+  }
+
+  if (*end != ':') {
+    return false;
+  }
+  char const *p = end+1;
+  long max = std::strtol(p, &end, 10);
+  if (end == p || *end != ':') {
+    return false;
+  }
+  p = end+1;
+  long step = std::strtol(p, &end, 10);
+  if (end == p || *end != 0) {
+    return false;
+  }
+
+  m_min = (int)min;
+  m_max = (int)max;
+  m_step = (int)step;
+  return min >= 0 && max >= min && step > 0;
+}
+
+
+std::vector<int> SweepRange::values() const
+{
+  std::vector<int> ret;
+  for (int v = m_min; v <= m_max; v += m_step) {
+    ret.push_back(v);
+  }
+  return ret;
+}
+
+
+// Command line options.
+class SweepOptions {
+public:      // data
+  // File listing the attempts.
+  std::string m_attemptsFile;
+
+  // Which attempts to use.
+  AttemptKind m_kind;
+
+  // Values to try for the active window.
+  SweepRange m_activeStart;
+  SweepRange m_activeEnd;
+
+  // Trigger dead zones to try.  If not set, use the recorded one.
+  bool m_sweepDeadZone;
+  SweepRange m_deadZone;
+
+  // Number of evaluation threads.
+  int m_threads;
+
+  // Number of best candidates to print.
+  int m_top;
+
+  // If not empty, write every candidate's result here as CSV.
+  std::string m_csvFile;
+
+public:      // methods
+  SweepOptions()
+    : m_attemptsFile(),
+      m_kind(AK_PARRY),
+      m_activeStart(0, 500, 10),
+      m_activeEnd(0, 800, 10),
+      m_sweepDeadZone(false),
+      m_deadZone(0, 0, 1),
+      m_threads(std::max(1u, std::thread::hardware_concurrency())),
+      m_top(10),
+      m_csvFile()
+  {}
+};
+
+
+// One annotated attempt, with the input leading up to it.
+class Attempt {
+public:      // data
+  // Where it came from, for error messages.
+  std::string m_recording;
+  int m_line;
+
+  // Time at which to judge the timer, on the recording's clock.
+  DWORD m_timeMS;
+
+  // True if the attempt worked in the game.
+  bool m_worked;
+
+  // Index into `Sweep::m_baseConfigs` of the configuration in effect.
+  std::size_t m_configIndex;
+
+  // The sample in effect just before the replay starts, followed by
+  // the samples up to `m_timeMS`.
+  std::vector<ControllerState> m_samples;
+
+public:      // methods
+  Attempt()
+    : m_recording(),
+      m_line(0),
+      m_timeMS(0),
+      m_worked(false),
+      m_configIndex(0),
+      m_samples()
+  {}
+};
+
+
+// Result of evaluating one combination of values.
+class Candidate {
+public:      // data
+  int m_activeStartMS;
+  int m_activeEndMS;
+
+  // -1 to use the recorded dead zone.
+  int m_triggerDeadZone;
+
+  // Attempts where the timer showed the window as active but the
+  // attempt failed.
+  int m_falseActive;
+
+  // Attempts where the timer did not show the window as active but
+  // the attempt worked.
+  int m_falseInactive;
+
+public:      // methods
+  Candidate(int activeStartMS, int activeEndMS, int triggerDeadZone)
+    : m_activeStartMS(activeStartMS),
+      m_activeEndMS(activeEndMS),
+      m_triggerDeadZone(triggerDeadZone),
+      m_falseActive(0),
+      m_falseInactive(0)
+  {}
+
+  int errors() const
+    { return m_falseActive + m_falseInactive; }
+};
+
+
+// The attempts and the configurations they are judged with.
+class Sweep {
+public:      // data
+  AttemptKind m_kind;
+
+  // Every configuration recorded in any of the recordings.
+  std::vector<GPVConfig> m_baseConfigs;
+
+  std::vector<Attempt> m_attempts;
+
+public:      // methods
+  explicit Sweep(AttemptKind kind)
+    : m_kind(kind),
+      m_baseConfigs(),
+      m_attempts()
+  {}
+
+  // Set `c`'s error counts.  `configs` is the evaluating thread's own
+  // copy of `m_baseConfigs`, which is modified.
+  void evaluate(Candidate &c, std::vector<GPVConfig> &configs) const;
+
+  // Count errors with the recorded configurations as they are.
+  Candidate evaluateRecorded() const;
+
+private:     // methods
+  void judge(Candidate &c, std::vector<GPVConfig> const &configs) const;
+};
+
+
+// Return a reference to the timer configuration that `kind` uses.
+static ButtonTimerConfig &timerConfig(GPVConfig &config, AttemptKind kind)
+{
+  if (kind == AK_PARRY) {
+    return config.m_parryTimer;
+  }
+  else {
+    return config.m_dodgeInvulnerabilityTimer;
+  }
+}
+
+static ButtonTimerConfig const &timerConfig(GPVConfig const &config,
+                                            AttemptKind kind)
+{
+  return timerConfig(const_cast<GPVConfig&>(config), kind);
+}
+
+
+void Sweep::evaluate(Candidate &c, std::vector<GPVConfig> &configs) const
+{
+  for (std::size_t i=0; i < configs.size(); ++i) {
+    GPVConfig &config = configs[i];
+    ButtonTimerConfig &timer = timerConfig(config, m_kind);
+    ButtonTimerConfig const &base =
+      timerConfig(m_baseConfigs[i], m_kind);
+
+    timer.m_activeStartMS = c.m_activeStartMS;
+    timer.m_activeEndMS = c.m_activeEndMS;
+
+    // A window that ends after the timer would otherwise expire makes
+    // the timer run until the window ends.
+    timer.m_durationMS = std::max(base.m_durationMS, c.m_activeEndMS);
+
+    config.m_analogThresholds.m_triggerDeadZone =
+      c.m_triggerDeadZone >= 0?
+        c.m_triggerDeadZone :
+        m_baseConfigs[i].m_analogThresholds.m_triggerDeadZone;
+  }
+
+  judge(c, configs);
+}
+
+
+Candidate Sweep::evaluateRecorded() const
+{
+  Candidate c(0, 0, -1);
+  judge(c, m_baseConfigs);
+  return c;
+}
+
+
+void Sweep::judge(Candidate &c, std::vector<GPVConfig> const &configs) const
+{
+  c.m_falseActive = c.m_falseInactive = 0;
+
+  for (Attempt const &a : m_attempts) {
+    InputModel model(&configs[a.m_configIndex]);
+    for (ControllerState const &s : a.m_samples) {
+      model.update(s);
+    }
+    model.advanceTime(a.m_timeMS);
+
+    bool active = m_kind == AK_PARRY?
+      model.isParryActive() :
+      model.isDodgeInvulnerabilityActive();
+
+    if (active && !a.m_worked) {
+      c.m_falseActive++;
+    }
+    else if (!active && a.m_worked) {
+      c.m_falseInactive++;
+    }
+  }
+}
+
+
+static void usage()
+{
+  std::cerr <<
+    "usage: gpv-sweep [options] attempts.txt\n"
+    "\n"
+    "Find the timer windows that best agree with whether recorded parry\n"
+    "or dodge attempts worked.  Each line of the attempts file is\n"
+    "\"RECORDING parry|dodge TIME_MS yes|no\", with TIME_MS measured from\n"
+    "the first sample of the recording.\n"
+    "\n"
+    "options:\n"
+    "  --kind parry|dodge  Which attempts to fit (default: parry).\n"
+    "  --start MIN:MAX:STEP\n"
+    "                      Active window starts to try, in ms\n"
+    "                      (default: 0:500:10).\n"
+    "  --end MIN:MAX:STEP  Active window ends to try (default: 0:800:10).\n"
+    "  --dead-zone MIN:MAX:STEP\n"
+    "                      Trigger dead zones to try, for parries\n"
+    "                      (default: as recorded).\n"
+    "  --threads N         Evaluation threads (default: number of CPUs).\n"
+    "  --top N             Number of results to print (default: 10).\n"
+    "  --csv FILE          Write every candidate's result to FILE.\n";
+  std::exit(2);
+}
+
+
+// Return the argument after `argv[i]`, advancing `i`.
+static char const *optionArg(int argc, char **argv, int &i)
+{
+  if (i+1 >= argc) {
+    std::cerr << "gpv-sweep: " << argv[i] << " requires an argument\n";
+    usage();
+  }
+  return argv[++i];
+}
+
+
+// Parse the argument after `argv[i]` into `range`.
+static void rangeArg(SweepRange &range, int argc, char **argv, int &i)
+{
+  char const *opt = argv[i];
+  char const *arg = optionArg(argc, argv, i);
+  if (!range.parse(arg)) {
+    std::cerr << "gpv-sweep: " << opt << ": malformed range: " << arg << "\n";
+    usage();
+  }
+}
+
+
+static void parseOptions(SweepOptions &opts, int argc, char **argv)
+{
+  std::vector<std::string> positional;
+
+  for (int i=1; i < argc; ++i) {
+    char const *arg = argv[i];
+
+    if (0==std::strcmp(arg, "--kind")) {
+      std::string k = optionArg(argc, argv, i);
+      if (k == "parry") {
+        opts.m_kind = AK_PARRY;
+      }
+      else if (k == "dodge") {
+        opts.m_kind = AK_DODGE;
+      }
+      else {
+        std::cerr << "gpv-sweep: unknown kind: " << k << "\n";
+        usage();
+      }
+    }
+    else if (0==std::strcmp(arg, "--start")) {
+      rangeArg(opts.m_activeStart, argc, argv, i);
+    }
+    else if (0==std::strcmp(arg, "--end")) {
+      rangeArg(opts.m_activeEnd, argc, argv, i);
+    }
+    else if (0==std::strcmp(arg, "--dead-zone")) {
+      rangeArg(opts.m_deadZone, argc, argv, i);
+      opts.m_sweepDeadZone = true;
+    }
+    else if (0==std::strcmp(arg, "--threads")) {
+      opts.m_threads = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--top")) {
+      opts.m_top = std::atoi(optionArg(argc, argv, i));
+    }
+    else if (0==std::strcmp(arg, "--csv")) {
+      opts.m_csvFile = optionArg(argc, argv, i);
+    }
+    else if (arg[0] == '-' && arg[1] != 0) {
+      std::cerr << "gpv-sweep: unknown option: " << arg << "\n";
+      usage();
+    }
+    else {
+      positional.push_back(arg);
+    }
+  }
+
+  if (positional.size() != 1) {
+    usage();
+  }
+  opts.m_attemptsFile = positional[0];
+
+  if (opts.m_threads <= 0 || opts.m_top <= 0) {
+    std::cerr << "gpv-sweep: --threads and --top must be positive\n";
+    usage();
+  }
+  if (opts.m_sweepDeadZone && opts.m_kind != AK_PARRY) {
+    std::cerr << "gpv-sweep: --dead-zone only applies to parries\n";
+    usage();
+  }
+}
+
+
+// A recording, as loaded for `addAttempt`.
+class LoadedRecording {
+public:      // data
+  std::vector<ControllerState> m_samples;
+
+  // Times at which each configuration took effect, and its index in
+  // `Sweep::m_baseConfigs`.
+  std::vector<DWORD> m_configTimes;
+  std::vector<std::size_t> m_configIndices;
+};
+
+
+// Load `fname` into `rec`, adding its configurations to `sweep`.
+// Return an error message, or "" on success.
+static std::string loadRecording(Sweep &sweep, LoadedRecording &rec,
+                                 std::string const &fname)
+{
+  std::vector<RecordedConfig> configs;
+  std::string error = readInputRecordingFile(fname, rec.m_samples, configs);
+  if (!error.empty()) {
+    return error;
+  }
+  if (rec.m_samples.empty()) {
+    return "recording has no samples";
+  }
+
+  if (configs.empty()) {
+    // Older recordings do not have one, so use the defaults.
+    configs.emplace_back(0, 0, GPVConfig());
+  }
+  for (RecordedConfig const &rc : configs) {
+    // The first configuration applies from the start, even if it was
+    // stamped with time 0 rather than on the samples' clock.
+    rec.m_configTimes.push_back(rec.m_configIndices.empty()?
+      rec.m_samples.front().m_pollTimeMS : rc.m_timeMS);
+    rec.m_configIndices.push_back(sweep.m_baseConfigs.size());
+    sweep.m_baseConfigs.push_back(rc.m_config);
+  }
+  return "";
+}
+
+
+// Replaying this much before each attempt is enough for the timers to
+// be in the same state as when replaying the whole recording, unless
+// the trigger was pressed repeatedly for longer than this while the
+// timer was running.
+static DWORD lookbackMS(Sweep const &sweep, SweepOptions const &opts)
+{
+  int longest = std::max(opts.m_activeEnd.m_max,
+                         opts.m_activeStart.m_max);
+  for (GPVConfig const &config : sweep.m_baseConfigs) {
+    longest = std::max(longest,
+      timerConfig(config, opts.m_kind).m_durationMS);
+  }
+  return (DWORD)(4 * longest + 1000);
+}
+
+
+// Make an attempt at `offsetMS` into `rec`.
+static void addAttempt(Sweep &sweep, LoadedRecording const &rec,
+                       Attempt &attempt, DWORD offsetMS, DWORD lookback)
+{
+  DWORD const startMS = rec.m_samples.front().m_pollTimeMS;
+  attempt.m_timeMS = startMS + offsetMS;
+  DWORD const replayStart =
+    offsetMS > lookback? attempt.m_timeMS - lookback : startMS;
+
+  // Configuration in effect at the attempt.
+  std::size_t ci = 0;
+  while (ci+1 < rec.m_configTimes.size() &&
+         (DWORD)(rec.m_configTimes[ci+1] - startMS) <= offsetMS) {
+    ci++;
+  }
+  attempt.m_configIndex = rec.m_configIndices[ci];
+
+  for (std::size_t i=0; i < rec.m_samples.size(); ++i) {
+    ControllerState const &s = rec.m_samples[i];
+    DWORD const sOffset = (DWORD)(s.m_pollTimeMS - startMS);
+    if (sOffset > offsetMS) {
+      break;
+    }
+    if (sOffset >= (DWORD)(replayStart - startMS)) {
+      if (attempt.m_samples.empty() && i > 0) {
+        // Start from the state before the replay so that a button
+        // already held is not seen as being pressed.
+        attempt.m_samples.push_back(rec.m_samples[i-1]);
+      }
+      attempt.m_samples.push_back(s);
+    }
+  }
+
+  sweep.m_attempts.push_back(std::move(attempt));
+}
+
+
+// Read the attempts file, loading the recordings it names.  Return an
+// error message, or "" on success.
+static std::string readAttempts(Sweep &sweep, SweepOptions const &opts)
+{
+  std::ifstream in(opts.m_attemptsFile);
+  if (!in) {
+    return std::strerror(errno);
+  }
+  std::filesystem::path dir =
+    std::filesystem::path(opts.m_attemptsFile).parent_path();
+
+  // Attempts waiting for their recording's configurations, since the
+  // lookback depends on all of them.
+  struct Pending {
+    Attempt m_attempt;
+    DWORD m_offsetMS;
+  };
+  std::map<std::string, LoadedRecording> recordings;
+  std::vector<std::pair<std::string, Pending>> pending;
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    std::string::size_type hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+
+    std::istringstream iss(line);
+    std::string recording, kind, worked;
+    long offsetMS;
+    if (!(iss >> recording)) {
+      continue;                        // Blank line.
+    }
+
+    std::ostringstream where;
+    where << "line " << lineNumber << ": ";
+    if (!(iss >> kind >> offsetMS >> worked) || offsetMS < 0) {
+      return where.str() + "expected \"RECORDING KIND TIME_MS yes|no\"";
+    }
+    std::string extra;
+    if (iss >> extra) {
+      return where.str() + "unexpected text: " + extra;
+    }
+    if (kind != "parry" && kind != "dodge") {
+      return where.str() + "unknown kind: " + kind;
+    }
+    if (worked != "yes" && worked != "no") {
+      return where.str() + "expected yes or no: " + worked;
+    }
+    if ((kind == "parry") != (opts.m_kind == AK_PARRY)) {
+      continue;
+    }
+
+    std::string path = (dir / recording).string();
+    if (recordings.find(path) == recordings.end()) {
+      std::string error = loadRecording(sweep, recordings[path], path);
+      if (!error.empty()) {
+        return path + ": " + error;
+      }
+    }
+
+    Pending p;
+    p.m_attempt.m_recording = path;
+    p.m_attempt.m_line = lineNumber;
+    p.m_attempt.m_worked = worked == "yes";
+    p.m_offsetMS = (DWORD)offsetMS;
+    pending.emplace_back(path, std::move(p));
+  }
+
+  DWORD lookback = lookbackMS(sweep, opts);
+  for (auto &kv : pending) {
+    addAttempt(sweep, recordings[kv.first], kv.second.m_attempt,
+               kv.second.m_offsetMS, lookback);
+  }
+  return "";
+}
+
+
+// Evaluate `candidates[i]` for each `i` taken from `next`.
+static void runWorker(Sweep const &sweep,
+                      std::vector<Candidate> &candidates,
+                      std::atomic<std::size_t> &next)
+{
+  std::vector<GPVConfig> configs(sweep.m_baseConfigs);
+  while (true) {
+    std::size_t i = next.fetch_add(1);
+    if (i >= candidates.size()) {
+      break;
+    }
+    sweep.evaluate(candidates[i], configs);
+  }
+}
+
+
+static double errorPercent(Candidate const &c, std::size_t attempts)
+{
+  return 100.0 * c.errors() / attempts;
+}
+
+
+int main(int argc, char **argv)
+{
+  SweepOptions opts;
+  parseOptions(opts, argc, argv);
+
+  Sweep sweep(opts.m_kind);
+  {
+    std::string error = readAttempts(sweep, opts);
+    if (!error.empty()) {
+      std::cerr << opts.m_attemptsFile << ": " << error << "\n";
+      return 2;
+    }
+  }
+  char const *kindName = opts.m_kind == AK_PARRY? "parry" : "dodge";
+  if (sweep.m_attempts.empty()) {
+    std::cerr << opts.m_attemptsFile << ": no " << kindName
+              << " attempts\n";
+    return 2;
+  }
+
+  std::vector<int> deadZones;
+  if (opts.m_sweepDeadZone) {
+    deadZones = opts.m_deadZone.values();
+  }
+  else {
+    deadZones.push_back(-1);
+  }
+
+  std::vector<Candidate> candidates;
+  for (int dz : deadZones) {
+    for (int start : opts.m_activeStart.values()) {
+      for (int end : opts.m_activeEnd.values()) {
+        if (end >= start) {
+          candidates.emplace_back(start, end, dz);
+        }
+      }
+    }
+  }
+  if (candidates.empty()) {
+    std::cerr << "gpv-sweep: no window ends at or after its start\n";
+    return 2;
+  }
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  std::atomic<std::size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int i=0; i < opts.m_threads; ++i) {
+    workers.emplace_back([&sweep, &candidates, &next] {
+      runWorker(sweep, candidates, next);
+    });
+  }
+  for (std::thread &t : workers) {
+    t.join();
+  }
+
+  double wallSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wallStart).count();
+
+  if (!opts.m_csvFile.empty()) {
+    std::ofstream csv(opts.m_csvFile);
+    csv << "activeStartMS,activeEndMS,triggerDeadZone,"
+           "errors,falseActive,falseInactive\n";
+    for (Candidate const &c : candidates) {
+      csv << c.m_activeStartMS << ","
+          << c.m_activeEndMS << ","
+          << c.m_triggerDeadZone << ","
+          << c.errors() << ","
+          << c.m_falseActive << ","
+          << c.m_falseInactive << "\n";
+    }
+    if (!csv) {
+      std::cerr << opts.m_csvFile << ": " << std::strerror(errno) << "\n";
+      return 2;
+    }
+  }
+
+  // Fewest errors first; among equals, prefer the narrowest window,
+  // since it is the one the others' successes are consistent with.
+  std::stable_sort(candidates.begin(), candidates.end(),
+    [](Candidate const &a, Candidate const &b) {
+      if (a.errors() != b.errors()) {
+        return a.errors() < b.errors();
+      }
+      return a.m_activeEndMS - a.m_activeStartMS <
+             b.m_activeEndMS - b.m_activeStartMS;
+    });
+
+  std::size_t const n = sweep.m_attempts.size();
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << n << " " << kindName << " attempts, "
+            << candidates.size() << " candidates, "
+            << opts.m_threads << " threads, "
+            << std::setprecision(2) << wallSeconds << " s\n"
+            << std::setprecision(1);
+
+  Candidate recorded = sweep.evaluateRecorded();
+  std::cout << "as recorded: " << recorded.errors() << " errors ("
+            << errorPercent(recorded, n) << "%), "
+            << recorded.m_falseActive << " false active, "
+            << recorded.m_falseInactive << " false inactive\n\n";
+
+  std::cout << " startMS   endMS";
+  if (opts.m_sweepDeadZone) {
+    std::cout << "  deadZone";
+  }
+  std::cout << "  errors   rate  falseActive  falseInactive\n";
+
+  std::size_t top = std::min((std::size_t)opts.m_top, candidates.size());
+  for (std::size_t i=0; i < top; ++i) {
+    Candidate const &c = candidates[i];
+    std::cout << std::setw(8) << c.m_activeStartMS
+              << std::setw(8) << c.m_activeEndMS;
+    if (opts.m_sweepDeadZone) {
+      std::cout << std::setw(10) << c.m_triggerDeadZone;
+    }
+    std::cout << std::setw(8) << c.errors()
+              << std::setw(6) << errorPercent(c, n) << "%"
+              << std::setw(13) << c.m_falseActive
+              << std::setw(15) << c.m_falseInactive << "\n";
+  }
+
+  return 0;
+}
+
+
+// EOF
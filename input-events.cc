@@ -0,0 +1,220 @@
+// input-events.cc
+// Code for `input-events` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-events.h"              // this module
+
+#include "controller-state.h"          // xinputButtonName
+
+#include <cstdio>                      // std::snprintf
+
+
+char const *toString(InputEventType type)
+{
+  switch (type) {
+    case IET_CONTROLLER:           return "controller";
+    case IET_BUTTON:               return "button";
+    case IET_TRIGGER:              return "trigger";
+    case IET_TIMER_START:          return "timer_start";
+    case IET_TIMER_END:            return "timer_end";
+    case IET_TIMER_WINDOW:         return "timer_window";
+    case NUM_INPUT_EVENT_TYPES:    break;
+  }
+  return "unknown";
+}
+
+
+char const *toString(InputEventTimer timer)
+{
+  switch (timer) {
+    case IETM_PARRY:               return "parry";
+    case IETM_DODGE_RELEASE:       return "dodge_release";
+    case IETM_DODGE:               return "dodge";
+    case NUM_INPUT_EVENT_TIMERS:   break;
+  }
+  return "unknown";
+}
+
+
+// Name of a `ButtonWindowState`, as the parry accuracy text says it.
+static char const *windowStateName(int state)
+{
+  switch (state) {
+    case BWS_BEFORE:               return "late";
+    case BWS_ACTIVE:               return "active";
+    case BWS_AFTER:                return "early";
+  }
+  return "unknown";
+}
+
+
+// ---------------------------- InputEvent -----------------------------
+InputEvent::InputEvent()
+  : m_sequence(0),
+    m_timeUS(0),
+    m_timeMS(0),
+    m_type(IET_BUTTON),
+    m_which(0),
+    m_a(0),
+    m_b(0),
+    m_c(0)
+{}
+
+
+void appendInputEventJSON(std::string &out, InputEvent const &e)
+{
+  char buf[200];
+  int len = std::snprintf(buf, sizeof(buf),
+    "{\"seq\":%llu,\"t_us\":%llu,\"t_ms\":%lu,\"event\":\"%s\"",
+    (unsigned long long)e.m_sequence,
+    (unsigned long long)e.m_timeUS,
+    (unsigned long)e.m_timeMS,
+    toString(e.m_type));
+  out.append(buf, len);
+
+  char const *timerName = toString((InputEventTimer)e.m_which);
+  switch (e.m_type) {
+    case IET_CONTROLLER:
+      len = std::snprintf(buf, sizeof(buf), ",\"connected\":%s",
+        e.m_a? "true" : "false");
+      break;
+
+    case IET_BUTTON:
+      len = std::snprintf(buf, sizeof(buf),
+        ",\"button\":\"%s\",\"down\":%s",
+        xinputButtonName(e.m_which), e.m_a? "true" : "false");
+      break;
+
+    case IET_TRIGGER:
+      len = std::snprintf(buf, sizeof(buf),
+        ",\"side\":\"%s\",\"down\":%s",
+        e.m_which == 0? "left" : "right", e.m_a? "true" : "false");
+      break;
+
+    case IET_TIMER_START:
+    case IET_TIMER_END:
+      len = std::snprintf(buf, sizeof(buf), ",\"timer\":\"%s\"",
+        timerName);
+      break;
+
+    case IET_TIMER_WINDOW:
+      len = std::snprintf(buf, sizeof(buf),
+        ",\"timer\":\"%s\",\"state\":\"%s\",\"frame\":%d,\"frames\":%d",
+        timerName, windowStateName(e.m_a), e.m_b, e.m_c);
+      break;
+
+    case NUM_INPUT_EVENT_TYPES:
+      len = 0;
+      break;
+  }
+  out.append(buf, len);
+  out += "}\n";
+}
+
+
+// ------------------------ InputEventDetector -------------------------
+InputEventDetector::InputEventDetector()
+  : m_initialized(false),
+    m_connected(false),
+    m_buttons(0),
+    m_triggerDown{false, false},
+    m_timerRunning{},
+    m_windowState{-1, -1, -1}
+{}
+
+
+int InputEventDetector::update(InputModel const &model,
+                               InputEvent *events /*OUT*/)
+{
+  ControllerState const &cs = model.m_controllerState;
+  AnalogThresholdConfig const &atConfig =
+    model.m_config->m_analogThresholds;
+
+  // Current state.  A disconnected controller has nothing pressed.
+  bool connected = cs.m_hasInputState;
+  WORD buttons = connected? cs.m_inputState.Gamepad.wButtons : 0;
+  bool triggerDown[2] = {
+    connected && cs.isTriggerPressed(atConfig, true /*left*/),
+    connected && cs.isTriggerPressed(atConfig, false /*left*/),
+  };
+
+  ButtonTimer const *timers[NUM_INPUT_EVENT_TIMERS] = {
+    &model.m_parryTimer,
+    &model.m_dodgeReleaseTimer,
+    &model.m_dodgeInvulnerabilityTimer,
+  };
+  int windowState[NUM_INPUT_EVENT_TIMERS];
+  int frameDelta[NUM_INPUT_EVENT_TIMERS] = {};
+  int maxFrame[NUM_INPUT_EVENT_TIMERS] = {};
+  windowState[IETM_PARRY] = !model.m_parryTimer.isRunning()? -1 :
+    model.parryWindowState(frameDelta[IETM_PARRY], maxFrame[IETM_PARRY]);
+  windowState[IETM_DODGE_RELEASE] = -1;
+  windowState[IETM_DODGE] =
+    !model.m_dodgeInvulnerabilityTimer.isRunning()? -1 :
+    model.dodgeWindowState(frameDelta[IETM_DODGE], maxFrame[IETM_DODGE]);
+
+  int n = 0;
+  if (m_initialized) {
+    // Start an event of `type` at the next slot.
+    auto add = [&](InputEventType type, int which, int a) -> InputEvent& {
+      InputEvent &e = events[n++];
+      e = InputEvent();
+      e.m_timeUS = cs.m_pollTimeUS;
+      e.m_timeMS = cs.m_pollTimeMS;
+      e.m_type = type;
+      e.m_which = which;
+      e.m_a = a;
+      return e;
+    };
+
+    if (connected != m_connected) {
+      add(IET_CONTROLLER, 0, connected);
+    }
+
+    WORD changed = buttons ^ m_buttons;
+    for (int i=0; i < 16; ++i) {
+      int bit = 1 << i;
+      if (changed & bit) {
+        add(IET_BUTTON, bit, (buttons & bit) != 0);
+      }
+    }
+
+    for (int side=0; side < 2; ++side) {
+      if (triggerDown[side] != m_triggerDown[side]) {
+        add(IET_TRIGGER, side, triggerDown[side]);
+      }
+    }
+
+    for (int t=0; t < NUM_INPUT_EVENT_TIMERS; ++t) {
+      bool running = timers[t]->isRunning();
+      if (running && !m_timerRunning[t]) {
+        add(IET_TIMER_START, t, 0);
+      }
+      if (windowState[t] != m_windowState[t] && windowState[t] >= 0) {
+        InputEvent &e = add(IET_TIMER_WINDOW, t, windowState[t]);
+        e.m_b = frameDelta[t];
+        e.m_c = maxFrame[t];
+      }
+      if (!running && m_timerRunning[t]) {
+        add(IET_TIMER_END, t, 0);
+      }
+    }
+  }
+
+  m_initialized = true;
+  m_connected = connected;
+  m_buttons = buttons;
+  for (int side=0; side < 2; ++side) {
+    m_triggerDown[side] = triggerDown[side];
+  }
+  for (int t=0; t < NUM_INPUT_EVENT_TIMERS; ++t) {
+    m_timerRunning[t] = timers[t]->isRunning();
+    m_windowState[t] = windowState[t];
+  }
+
+  return n;
+}
+
+
+// EOF
@@ -0,0 +1,126 @@
+// input-events.h
+// `InputEvent` and `InputEventDetector`, which turn successive input
+// states into discrete events for the event stream.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include "input-model.h"               // InputModel
+
+#include <cstdint>                     // std::{uint32_t, uint64_t}
+#include <string>                      // std::string
+
+
+// Kinds of `InputEvent`.
+enum InputEventType {
+  // The controller was connected (`m_a` is 1) or disconnected (0).
+  IET_CONTROLLER,
+
+  // Button `m_which` (an `XINPUT_GAMEPAD_*` bit) was pressed (`m_a` is
+  // 1) or released (0).
+  IET_BUTTON,
+
+  // The left (`m_which` is 0) or right (1) trigger crossed its
+  // threshold, down (`m_a` is 1) or up (0).
+  IET_TRIGGER,
+
+  // Timer `m_which` (an `InputEventTimer`) started or stopped running.
+  IET_TIMER_START,
+  IET_TIMER_END,
+
+  // Timer `m_which` moved into a different part of its window:
+  // `m_a` is the `ButtonWindowState`, `m_b` the frame delta, and
+  // `m_c` the number of frames in the window, as returned by
+  // `InputModel::parryWindowState`.
+  IET_TIMER_WINDOW,
+
+  NUM_INPUT_EVENT_TYPES
+};
+
+// Return a name for `type`, like "button".
+char const *toString(InputEventType type);
+
+
+// Timers reported by `IET_TIMER_*` events.
+enum InputEventTimer {
+  IETM_PARRY,
+  IETM_DODGE_RELEASE,
+  IETM_DODGE,
+
+  NUM_INPUT_EVENT_TIMERS
+};
+
+// Return a name for `timer`, like "parry".
+char const *toString(InputEventTimer timer);
+
+
+// One event.  This is plain data so it can be queued without
+// allocating and formatted later, on another thread.
+class InputEvent {
+public:      // data
+  // Position in the stream, starting at 1.  Set when published.
+  std::uint64_t m_sequence;
+
+  // Poll time of the sample that caused the event, per `steadyClockUS`
+  // and `GetTickCount()`.
+  std::uint64_t m_timeUS;
+  std::uint32_t m_timeMS;
+
+  // What happened.  The meaning of the rest depends on this.
+  InputEventType m_type;
+  int m_which;
+  int m_a;
+  int m_b;
+  int m_c;
+
+public:      // methods
+  InputEvent();
+};
+
+
+// Append `event` to `out` as one line of JSON, like:
+//
+//   {"seq":12,"t_us":1234567,"t_ms":5678,"event":"button","button":"a",
+//    "down":true}
+//
+void appendInputEventJSON(std::string &out, InputEvent const &event);
+
+
+// Compares each `InputModel` state to the previous one and reports the
+// differences as events.
+class InputEventDetector {
+public:      // types
+  enum {
+    // Most events one update can produce: a connection change, every
+    // button, both triggers, and a start or end and a window change
+    // for each timer.
+    MAX_EVENTS_PER_UPDATE = 1 + 16 + 2 + 2 * NUM_INPUT_EVENT_TIMERS,
+  };
+
+private:     // data
+  // False until the first update, which only records the state.
+  bool m_initialized;
+
+  // State as of the previous update.
+  bool m_connected;
+  WORD m_buttons;
+  bool m_triggerDown[2];
+  bool m_timerRunning[NUM_INPUT_EVENT_TIMERS];
+
+  // `ButtonWindowState` of each timer that has a window, or -1 if not
+  // running or it does not have one.
+  int m_windowState[NUM_INPUT_EVENT_TIMERS];
+
+public:      // methods
+  InputEventDetector();
+
+  // Compare `model` to the previous state, store the events in
+  // `events`, which has room for `MAX_EVENTS_PER_UPDATE`, and return
+  // how many there are.  Their sequence numbers are not set.
+  int update(InputModel const &model, InputEvent *events /*OUT*/);
+};
+
+
+#endif // INPUT_EVENTS_H
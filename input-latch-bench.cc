@@ -0,0 +1,110 @@
+// input-latch-bench.cc
+// Benchmarks for `input-latch` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-latch.h"               // module under test
+
+#include "bench.h"                     // BENCHMARK, benchReportValue, etc.
+#include "synthetic-input.h"           // SyntheticInput
+
+#include <string>                      // std::to_string
+
+
+// Number of the bits of `buttons` that are set.
+static int countBits(WORD buttons)
+{
+  int n = 0;
+  for (; buttons; buttons &= buttons-1) {
+    ++n;
+  }
+  return n;
+}
+
+
+// Simulation of the viewer polling the controller every millisecond
+// and presenting frames at 60 Hz, over a minute of `SyntheticInput`
+// with a one-sample parry press (left trigger) added every 53 samples.
+// It reports the two rates and how many of the one-sample dpad taps
+// and trigger presses some presented frame shows, with `InputLatch`,
+// and, for comparison, when each frame only shows the latest sample.
+BENCHMARK(presentedVsPolled)
+{
+  AnalogThresholdConfig thr;
+  SyntheticInput input;
+  InputLatch latch;
+
+  int const pollHz = 1000;
+  int const presentHz = 60;
+  int const seconds = 60;
+  WORD const dpad = XINPUT_GAMEPAD_DPAD_UP | XINPUT_GAMEPAD_DPAD_DOWN |
+                    XINPUT_GAMEPAD_DPAD_LEFT | XINPUT_GAMEPAD_DPAD_RIGHT;
+
+  long polls = 0, presents = 0;
+  long taps = 0, tapsShown = 0, tapsShownLatest = 0;
+  long presses = 0, pressesShown = 0, pressesShownLatest = 0;
+
+  // Taps and presses since the last present.
+  WORD pendingTaps = 0;
+  bool pendingPress = false;
+
+  ControllerState state;
+  for (int ms = 0; ms < seconds * pollHz; ++ms) {
+    input.next(state, 1000 + ms);
+    BYTE &trigger = state.m_inputState.Gamepad.bLeftTrigger;
+    trigger = (ms % 53 == 0)? 255 : 0;
+    ++polls;
+
+    WORD tapped = state.m_inputState.Gamepad.wButtons & dpad;
+    taps += countBits(tapped);
+    pendingTaps |= tapped;
+    if (state.isTriggerPressed(thr, true /*leftSide*/)) {
+      ++presses;
+      pendingPress = true;
+    }
+
+    latch.add(state);
+
+    // Present when the frame clock ticks.
+    if ((ms+1) * presentHz / pollHz == ms * presentHz / pollHz) {
+      continue;
+    }
+    ++presents;
+
+    tapsShownLatest +=
+      countBits(pendingTaps & state.m_inputState.Gamepad.wButtons);
+    pressesShownLatest +=
+      pendingPress && state.isTriggerPressed(thr, true /*leftSide*/);
+
+    ControllerState shown = state;
+    latch.applyTo(shown, thr);
+    tapsShown += countBits(pendingTaps & shown.m_inputState.Gamepad.wButtons);
+    pressesShown +=
+      pendingPress && shown.isTriggerPressed(thr, true /*leftSide*/);
+
+    // Anything not shown now has been released, so is lost.
+    pendingTaps = 0;
+    pendingPress = false;
+  }
+
+  benchReportValue("polls per second", std::to_string(polls / seconds));
+  benchReportValue("presents per second",
+                   std::to_string(presents / seconds));
+  benchReportValue("dpad taps shown, latched",
+    std::to_string(tapsShown) + " of " + std::to_string(taps));
+  benchReportValue("dpad taps shown, latest sample only",
+    std::to_string(tapsShownLatest) + " of " + std::to_string(taps));
+  benchReportValue("trigger presses shown, latched",
+    std::to_string(pressesShown) + " of " + std::to_string(presses));
+  benchReportValue("trigger presses shown, latest sample only",
+    std::to_string(pressesShownLatest) + " of " + std::to_string(presses));
+
+  // What latching costs each poll.
+  benchReport("InputLatch::add", benchTimeNS([&] {
+    latch.add(state);
+  }), "per sample");
+  benchKeep(latch);
+}
+
+
+// EOF
@@ -0,0 +1,82 @@
+// input-latch-test.cc
+// Tests for `input-latch` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-latch.h"               // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+
+// A connected controller with `buttons` held and the left trigger at
+// `leftTrigger`.
+static ControllerState makeState(WORD buttons, BYTE leftTrigger = 0)
+{
+  ControllerState s;
+  s.m_hasInputState = true;
+  s.m_inputState.Gamepad.wButtons = buttons;
+  s.m_inputState.Gamepad.bLeftTrigger = leftTrigger;
+  return s;
+}
+
+
+UNIT_TEST(latchShowsReleasedButtons)
+{
+  AnalogThresholdConfig thr;
+  InputLatch latch;
+
+  latch.add(makeState(XINPUT_GAMEPAD_A));
+  latch.add(makeState(XINPUT_GAMEPAD_DPAD_UP));
+  ControllerState latest = makeState(XINPUT_GAMEPAD_DPAD_UP);
+  EXPECT(latch.applyTo(latest, thr));
+  EXPECT_EQ(latest.m_inputState.Gamepad.wButtons,
+            XINPUT_GAMEPAD_A | XINPUT_GAMEPAD_DPAD_UP);
+
+  // It was cleared, so the next frame shows the release.
+  latch.add(makeState(0));
+  latest = makeState(0);
+  EXPECT(!latch.applyTo(latest, thr));
+  EXPECT_EQ(latest.m_inputState.Gamepad.wButtons, 0);
+}
+
+
+UNIT_TEST(latchShowsReleasedTriggerPress)
+{
+  AnalogThresholdConfig thr;
+  InputLatch latch;
+
+  // A parry press that ends before the frame.
+  latch.add(makeState(0, 0));
+  latch.add(makeState(0, 255));
+  latch.add(makeState(0, 200));
+  ControllerState latest = makeState(0, 10);
+  latch.add(latest);
+  EXPECT(latch.applyTo(latest, thr));
+  EXPECT_EQ(latest.m_inputState.Gamepad.bLeftTrigger, 255);
+  EXPECT(latest.isTriggerPressed(thr, true /*leftSide*/));
+  EXPECT(!latest.isTriggerPressed(thr, false /*leftSide*/));
+}
+
+
+UNIT_TEST(latchLeavesCurrentTriggerAlone)
+{
+  AnalogThresholdConfig thr;
+  InputLatch latch;
+
+  // Still held: the current value is shown, not the peak.
+  latch.add(makeState(0, 255));
+  ControllerState latest = makeState(0, thr.m_triggerDeadZone + 1);
+  latch.add(latest);
+  EXPECT(!latch.applyTo(latest, thr));
+  EXPECT_EQ(latest.m_inputState.Gamepad.bLeftTrigger,
+            thr.m_triggerDeadZone + 1);
+
+  // Never past the dead zone: nothing to show.
+  latch.add(makeState(0, thr.m_triggerDeadZone));
+  latest = makeState(0, 0);
+  EXPECT(!latch.applyTo(latest, thr));
+  EXPECT_EQ(latest.m_inputState.Gamepad.bLeftTrigger, 0);
+}
+
+
+// EOF
@@ -0,0 +1,71 @@
+// input-latch.cc
+// Code for `input-latch` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-latch.h"               // this module
+
+#include <algorithm>                   // std::max
+
+
+InputLatch::InputLatch()
+  : m_buttons(0),
+    m_leftTrigger(0),
+    m_rightTrigger(0)
+{}
+
+
+void InputLatch::clear()
+{
+  m_buttons = 0;
+  m_leftTrigger = 0;
+  m_rightTrigger = 0;
+}
+
+
+void InputLatch::add(ControllerState const &state)
+{
+  if (!state.m_hasInputState) {
+    return;
+  }
+
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  m_buttons |= g.wButtons;
+  m_leftTrigger = std::max(m_leftTrigger, g.bLeftTrigger);
+  m_rightTrigger = std::max(m_rightTrigger, g.bRightTrigger);
+}
+
+
+bool InputLatch::applyTo(ControllerState &state,
+                         AnalogThresholdConfig const &thresholds)
+{
+  bool changed = false;
+
+  if (state.m_hasInputState) {
+    XINPUT_GAMEPAD &g = state.m_inputState.Gamepad;
+
+    if (m_buttons & ~g.wButtons) {
+      g.wButtons |= m_buttons;
+      changed = true;
+    }
+
+    // Only a press that has been released is shown this way.  While a
+    // trigger is held, or if it never crossed the threshold, the
+    // display shows its current value as usual.
+    int deadZone = thresholds.m_triggerDeadZone;
+    if (m_leftTrigger > deadZone && g.bLeftTrigger <= deadZone) {
+      g.bLeftTrigger = m_leftTrigger;
+      changed = true;
+    }
+    if (m_rightTrigger > deadZone && g.bRightTrigger <= deadZone) {
+      g.bRightTrigger = m_rightTrigger;
+      changed = true;
+    }
+  }
+
+  clear();
+  return changed;
+}
+
+
+// EOF
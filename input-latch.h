@@ -0,0 +1,49 @@
+// input-latch.h
+// `InputLatch`, which keeps brief input until the display shows it.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef INPUT_LATCH_H
+#define INPUT_LATCH_H
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // AnalogThresholdConfig
+#include "windows-compat.h"            // BYTE, WORD
+
+
+// The viewer polls much more often than it presents frames, so a
+// button tap or a quick trigger pull (like an L2 parry) can start and
+// end between two frames.  This accumulates the polled samples between
+// frames so that each frame can show such input even though it is no
+// longer present in the latest sample.
+class InputLatch {
+public:      // data
+  // Buttons held in any sample added since the last `clear`.
+  WORD m_buttons;
+
+  // Largest value of each trigger in those samples.
+  BYTE m_leftTrigger;
+  BYTE m_rightTrigger;
+
+public:      // methods
+  // Initially empty.
+  InputLatch();
+
+  // Forget all samples.
+  void clear();
+
+  // Include `state`, if it has input.
+  void add(ControllerState const &state);
+
+  // Modify `state`, the latest sample, to also show what was latched
+  // but has since been released: the latched buttons, and for each
+  // trigger that was pressed, according to `thresholds`, but is not
+  // now, its largest value.  Return true if that changed anything, in
+  // which case the following frame needs to be drawn to show the
+  // release.  Then `clear`.
+  bool applyTo(ControllerState &state /*INOUT*/,
+               AnalogThresholdConfig const &thresholds);
+};
+
+
+#endif // INPUT_LATCH_H
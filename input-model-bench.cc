@@ -0,0 +1,86 @@
+// input-model-bench.cc
+// Benchmarks for `input-model` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-model.h"               // module under test
+
+#include "bench.h"                     // BENCHMARK, benchTimeNS, etc.
+#include "synthetic-input.h"           // SyntheticInput
+
+#include <string>                      // std::wstring
+#include <vector>                      // std::vector
+
+
+// Samples from `SyntheticInput`, 1 ms apart, which change on every
+// sample and start and expire timers regularly.
+static std::vector<ControllerState> syntheticSamples(int n)
+{
+  std::vector<ControllerState> samples(n);
+  SyntheticInput input;
+  for (int i=0; i < n; ++i) {
+    input.next(samples[i], 1000 + i);
+  }
+  return samples;
+}
+
+
+// What the viewer's poll does with each sample, formerly
+// `GVMainWindow::pollControllerState`.
+BENCHMARK(inputModelUpdate)
+{
+  GPVConfig config;
+  InputModel model(&config);
+  std::vector<ControllerState> samples = syntheticSamples(1 << 16);
+
+  std::size_t i = 0;
+  benchReport("InputModel::update", benchTimeNS([&] {
+    model.update(samples[i]);
+    if (++i == samples.size()) {
+      // Start over, since time would otherwise go backward.
+      i = 0;
+      model = InputModel(&config);
+    }
+  }), "per sample");
+  benchKeep(model);
+}
+
+
+// Formatting the accuracy labels, which happens every frame while a
+// timer runs.
+BENCHMARK(accuracyStrings)
+{
+  GPVConfig config;
+  InputModel model(&config);
+  std::vector<ControllerState> samples = syntheticSamples(4000);
+
+  // Snapshots with both timers running, at times spread over the
+  // before, active, and after parts of their windows.
+  std::vector<InputModel> models;
+  for (ControllerState const &s : samples) {
+    model.update(s);
+    if (model.m_parryTimer.isRunning() &&
+        model.m_dodgeInvulnerabilityTimer.isRunning()) {
+      models.push_back(model);
+    }
+  }
+
+  std::size_t i = 0;
+  std::wstring str;
+  bool active;
+  benchReport("parryAccuracyString into a string", benchTimeNS([&] {
+    models[i++ % models.size()].parryAccuracyString(str);
+    benchKeep(str);
+  }));
+  benchReport("dodgeAccuracyString into a string", benchTimeNS([&] {
+    models[i++ % models.size()].dodgeAccuracyString(str, active);
+    benchKeep(str);
+  }));
+  benchReport("parryAccuracyString returning a string", benchTimeNS([&] {
+    std::wstring s = models[i++ % models.size()].parryAccuracyString();
+    benchKeep(s);
+  }));
+}
+
+
+// EOF
@@ -0,0 +1,140 @@
+// input-model-test.cc
+// Tests for `input-model` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-model.h"               // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+
+// A connected controller at `timeMS` with `buttons` held and the left
+// trigger at `leftTrigger`.
+static ControllerState makeState(DWORD timeMS, WORD buttons,
+                                 BYTE leftTrigger = 0)
+{
+  ControllerState s;
+  s.m_hasInputState = true;
+  s.m_pollTimeMS = timeMS;
+  s.m_inputState.Gamepad.wButtons = buttons;
+  s.m_inputState.Gamepad.bLeftTrigger = leftTrigger;
+  return s;
+}
+
+
+UNIT_TEST(parryTimerStartsOnTriggerPress)
+{
+  GPVConfig config;
+  InputModel model(&config);
+
+  model.update(makeState(1000, 0));
+  EXPECT(!model.m_parryTimer.isRunning());
+
+  // Below the dead zone is not a press.
+  model.update(makeState(1010, 0, 100));
+  EXPECT(!model.m_parryTimer.isRunning());
+
+  model.update(makeState(1020, 0, 255));
+  EXPECT(model.m_parryTimer.isRunning());
+  EXPECT_EQ(model.parryTimerElapsedMS(), 0u);
+
+  model.advanceTime(1120);
+  EXPECT_EQ(model.parryTimerElapsedMS(), 100u);
+
+  // The timer runs out after its duration.
+  model.advanceTime(1020 + config.m_parryTimer.m_durationMS + 1);
+  EXPECT(!model.m_parryTimer.isRunning());
+}
+
+
+UNIT_TEST(parryTimerNeedsConnectedController)
+{
+  GPVConfig config;
+  InputModel model(&config);
+
+  // A press seen on the first sample after connecting does not count,
+  // since it might have started long before.
+  ControllerState disconnected;
+  model.update(disconnected);
+  model.update(makeState(1000, 0, 255));
+  EXPECT(!model.m_parryTimer.isRunning());
+}
+
+
+UNIT_TEST(dodgeTimersStartOnRelease)
+{
+  GPVConfig config;
+  InputModel model(&config);
+
+  model.update(makeState(1000, XINPUT_GAMEPAD_B));
+  EXPECT(!model.isAnyButtonTimerRunning());
+
+  model.update(makeState(1050, 0));
+  EXPECT(model.m_dodgeReleaseTimer.isRunning());
+  EXPECT(model.m_dodgeInvulnerabilityTimer.isRunning());
+  EXPECT(!model.m_dodgeInvulnerabilityTimer.m_queued);
+
+  // Releasing again while it runs queues another dodge.
+  model.update(makeState(1100, XINPUT_GAMEPAD_B));
+  model.update(makeState(1150, 0));
+  EXPECT(model.m_dodgeInvulnerabilityTimer.m_queued);
+}
+
+
+UNIT_TEST(parryAccuracyStrings)
+{
+  GPVConfig config;
+  ButtonTimerConfig const &w = config.m_parryTimer;
+  InputModel model(&config);
+
+  model.update(makeState(1000, 0));
+  model.update(makeState(1000, 0, 255));
+
+  // Before the window: the press was late by the remaining frames.
+  model.advanceTime(1000 + w.m_activeStartMS - 40);
+  EXPECT_EQ(model.parryAccuracyString(), L"2 late");
+
+  // In the window: frame N of the window's frames.
+  model.advanceTime(1000 + w.m_activeStartMS + 50);
+  EXPECT_EQ(model.parryAccuracyString(), L"2 of 6");
+  EXPECT(model.isParryActive());
+
+  // After it: early.
+  model.advanceTime(1000 + w.m_activeEndMS + 70);
+  EXPECT_EQ(model.parryAccuracyString(), L"3 early");
+  EXPECT(!model.isParryActive());
+
+  // The in-place form gives the same text.
+  std::wstring s = L"previous contents";
+  model.parryAccuracyString(s);
+  EXPECT_EQ(s, L"3 early");
+}
+
+
+UNIT_TEST(dodgeAccuracyStrings)
+{
+  GPVConfig config;
+  ButtonTimerConfig const &w = config.m_dodgeInvulnerabilityTimer;
+  InputModel model(&config);
+
+  model.update(makeState(1000, XINPUT_GAMEPAD_B));
+  model.update(makeState(1000, 0));
+
+  bool active = true;
+  if (w.m_activeStartMS > 0) {
+    model.advanceTime(1000 + w.m_activeStartMS - 1);
+    EXPECT_EQ(model.dodgeAccuracyString(active), L"L 1");
+    EXPECT(!active);
+  }
+
+  model.advanceTime(1000 + w.m_activeStartMS + 1);
+  EXPECT_EQ(model.dodgeAccuracyString(active), L"A 1");
+  EXPECT(active);
+
+  model.advanceTime(1000 + w.m_activeEndMS + 1);
+  EXPECT_EQ(model.dodgeAccuracyString(active), L"R 1");
+  EXPECT(!active);
+}
+
+
+// EOF
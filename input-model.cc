@@ -0,0 +1,325 @@
+// input-model.cc
+// Code for `input-model` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-model.h"               // this module
+
+#include "text-format.h"               // appendFormat
+
+
+InputModel::InputModel(GPVConfig const *config)
+  : m_config(config),
+    m_controllerState(),
+    m_prevControllerState(),
+    m_parryTimer(),
+    m_dodgeReleaseTimer(),
+    m_dodgeInvulnerabilityTimer()
+{}
+
+
+void InputModel::update(ControllerState const &newState)
+{
+  m_prevControllerState = m_controllerState;
+  m_controllerState = newState;
+
+  // Possibly expire the timers.
+  m_parryTimer.possiblyExpire(
+    m_controllerState.m_pollTimeMS,
+    m_config->m_parryTimer.m_durationMS);
+  m_dodgeReleaseTimer.possiblyExpire(
+    m_controllerState.m_pollTimeMS,
+    m_config->m_dodgeReleaseTimerDurationMS);
+  m_dodgeInvulnerabilityTimer.possiblyExpire(
+    m_controllerState.m_pollTimeMS,
+    m_config->m_dodgeInvulnerabilityTimer.m_durationMS,
+    m_config->m_dodgeInvulnerabilityTimer.m_activeStartMS);
+
+  // Possibly start the timers.
+  if (m_prevControllerState.m_hasInputState &&
+      m_controllerState.m_hasInputState) {
+    // Parry timer.
+    bool const leftSide = true;
+    AnalogThresholdConfig const &atConfig = m_config->m_analogThresholds;
+    if (!m_parryTimer.isRunning() &&
+        !m_prevControllerState.isTriggerPressed(atConfig, leftSide) &&
+        m_controllerState.isTriggerPressed(atConfig, leftSide))
+    {
+      // Upon pressing L2, start the timer.
+      m_parryTimer.startTimer(m_controllerState.m_pollTimeMS);
+    }
+
+    // Upon *releasing* B/Circle, start the dodge timer.
+    if (m_prevControllerState.isButtonPressed(XINPUT_GAMEPAD_B) &&
+        !m_controllerState.isButtonPressed(XINPUT_GAMEPAD_B))
+    {
+      // One timer simply tracks releasing the button.
+      if (!m_dodgeReleaseTimer.isRunning()) {
+        m_dodgeReleaseTimer.startTimer(m_controllerState.m_pollTimeMS);
+      }
+
+      // Another tracks the full lifecycle of invulnerability.
+      m_dodgeInvulnerabilityTimer.startOrEnqueueTimer(
+        m_controllerState.m_pollTimeMS);
+    }
+  }
+}
+
+
+void InputModel::advanceTime(DWORD timeMS)
+{
+  ControllerState newState = m_controllerState;
+  newState.m_pollTimeMS = timeMS;
+  update(newState);
+}
+
+
+bool InputModel::isAnyButtonTimerRunning() const
+{
+  return m_parryTimer.isRunning() ||
+         m_dodgeReleaseTimer.isRunning() ||
+         m_dodgeInvulnerabilityTimer.isRunning();
+}
+
+
+XINPUT_STATE const &InputModel::inputState() const
+{
+  return m_controllerState.m_inputState;
+}
+
+
+// Convert a number of milliseconds into a frame count (at 30 FPS).
+static int msToFrames(int ms)
+{
+  // If we happen to press the button at the moment the active window
+  // starts, call that part of frame 1.  (In practice, this never
+  // happens, due to the granularity of the timer.)
+  if (ms == 0) {
+    ms = 1;
+  }
+
+  // There are 30 frames in 1000 milliseconds, and we want to round up.
+  return (ms * 30 + 999) / 1000;
+}
+
+
+// Classify a button press `elapsedMS` ago relative to the active
+// window described by `config`.
+//
+// In the case of BWS_BEFORE, set `frameDelta` to the number of frames
+// (at 30 FPS) by which the press was too late.
+//
+// In the case of BWS_ACTIVE, set `frameDelta` to the the frame number
+// on which the button was pressed, from among those that would have
+// also led to a successful action.  Frame 1 is the first in the window,
+// meaning the button was pressed on the last possible frame.  In this
+// case, also set `maxFrame` to the maximum value that would have led to
+// a successful action (which corresponds to the first possible frame on
+// which the button could have been pressed).
+//
+// In the case of BWS_AFTER, set `frameDelta` to the number of frames
+// by which the press was too early.
+//
+static ButtonWindowState getButtonWindowState(
+  ButtonTimerConfig const &config,
+  int elapsedMS,
+  int &frameDelta /*OUT*/,
+  int &maxFrame /*OUT*/)
+{
+  // Meaningless value for cases other than BWS_ACTIVE.
+  maxFrame = 0;
+
+  if (elapsedMS < config.m_activeStartMS) {
+    // The active window has not yet started.
+    frameDelta = msToFrames(config.m_activeStartMS - elapsedMS);
+    return BWS_BEFORE;
+  }
+
+  else if (elapsedMS > config.m_activeEndMS) {
+    // The active window has already ended.
+    frameDelta = msToFrames(elapsedMS - config.m_activeEndMS);
+    return BWS_AFTER;
+  }
+
+  else {
+    // We are within the active window.
+    frameDelta = msToFrames(elapsedMS - config.m_activeStartMS);
+    maxFrame = msToFrames(config.m_activeEndMS - config.m_activeStartMS);
+    return BWS_ACTIVE;
+  }
+}
+
+
+// True if we are in the active phase of the button described by
+// `config`.
+static bool isButtonActive(
+  ButtonTimerConfig const &config,
+  int elapsedMS)
+{
+  int frameDelta;
+  int maxFrame;
+  ButtonWindowState bws =
+    getButtonWindowState(config, elapsedMS, frameDelta, maxFrame);
+  return bws == BWS_ACTIVE;
+}
+
+
+DWORD InputModel::dodgeInvulnerabilityTimerElapsedMS() const
+{
+  return m_dodgeInvulnerabilityTimer.elapsedMS(
+    m_controllerState.m_pollTimeMS);
+}
+
+
+bool InputModel::isDodgeInvulnerabilityActive() const
+{
+  if (m_dodgeInvulnerabilityTimer.isRunning()) {
+    return isButtonActive(
+      m_config->m_dodgeInvulnerabilityTimer,
+      (int)dodgeInvulnerabilityTimerElapsedMS());
+  }
+  else {
+    return false;
+  }
+}
+
+
+DWORD InputModel::parryTimerElapsedMS() const
+{
+  return m_parryTimer.elapsedMS(m_controllerState.m_pollTimeMS);
+}
+
+
+bool InputModel::isParryActive() const
+{
+  if (m_parryTimer.isRunning()) {
+    return isButtonActive(
+      m_config->m_parryTimer,
+      (int)parryTimerElapsedMS());
+  }
+  else {
+    return false;
+  }
+}
+
+
+ButtonWindowState InputModel::dodgeWindowState(
+  int &frameDelta /*OUT*/,
+  int &maxFrame /*OUT*/) const
+{
+  return getButtonWindowState(
+    m_config->m_dodgeInvulnerabilityTimer,
+    (int)dodgeInvulnerabilityTimerElapsedMS(),
+    frameDelta,
+    maxFrame);
+}
+
+
+ButtonWindowState InputModel::parryWindowState(
+  int &frameDelta /*OUT*/,
+  int &maxFrame /*OUT*/) const
+{
+  return getButtonWindowState(
+    m_config->m_parryTimer,
+    (int)parryTimerElapsedMS(),
+    frameDelta,
+    maxFrame);
+}
+
+
+std::wstring InputModel::dodgeAccuracyString(bool &active /*OUT*/) const
+{
+  std::wstring ret;
+  dodgeAccuracyString(ret, active);
+  return ret;
+}
+
+
+void InputModel::dodgeAccuracyString(std::wstring &str /*OUT*/,
+                                     bool &active /*OUT*/) const
+{
+  int frameDelta;
+  int maxFrame;
+  ButtonWindowState bws = dodgeWindowState(frameDelta, maxFrame);
+
+  str.clear();
+  active = false;
+
+  switch (bws) {
+    case BWS_BEFORE:
+      // The active window has not yet started, meaning the button was
+      // pressed, but the game has not yet registered it due to input lag.
+      appendFormat(str, "L %d", frameDelta);
+      break;
+
+    case BWS_AFTER:
+      // The active window has already ended, meaning the button was
+      // pressed too early, and we are in the recovery window.
+      appendFormat(str, "R %d", frameDelta);
+      break;
+
+    case BWS_ACTIVE:
+      // We are within the active invulnerability window.
+      if (false) {
+        // This takes up a bit more space than I'd like.
+        appendFormat(str, "%d/%d", frameDelta, maxFrame);
+      }
+      else {
+        appendFormat(str, "A %d", frameDelta);
+      }
+      active = true;
+      break;
+
+    // No default provided, as cases are exhaustive.
+  }
+
+  if (m_dodgeInvulnerabilityTimer.m_queued) {
+    str += L'+';
+  }
+}
+
+
+std::wstring InputModel::parryAccuracyString() const
+{
+  std::wstring ret;
+  parryAccuracyString(ret);
+  return ret;
+}
+
+
+void InputModel::parryAccuracyString(std::wstring &str /*OUT*/) const
+{
+  int frameDelta;
+  int maxFrame;
+  ButtonWindowState bws = parryWindowState(frameDelta, maxFrame);
+
+  str.clear();
+
+  switch (bws) {
+    case BWS_BEFORE:
+      // The active window has not yet started, meaning the button was
+      // pressed too late.
+      appendFormat(str, "%d late", frameDelta);
+      break;
+
+    case BWS_AFTER:
+      // The active window has already ended, meaning the button was
+      // pressed too early.
+      appendFormat(str, "%d early", frameDelta);
+      break;
+
+    case BWS_ACTIVE:
+      // We are within the active window, so report the frame number on
+      // which the button was pressed, from among those that would have
+      // also led to a successful parry.  Frame 1 is the first in the
+      // window, meaning the button was pressed on the last possible
+      // frame.
+      appendFormat(str, "%d of %d", frameDelta, maxFrame);
+      break;
+
+    // No default provided, as cases are exhaustive.
+  }
+}
+
+
+// EOF
@@ -0,0 +1,136 @@
+// input-model.h
+// `InputModel`, the controller input and the timers derived from it.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef INPUT_MODEL_H
+#define INPUT_MODEL_H
+
+#include "button-timer.h"              // ButtonTimer
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // GPVConfig
+#include "windows-compat.h"            // XINPUT_STATE, DWORD
+
+#include <string>                      // std::wstring
+
+
+// Classification of the current time in comparison to the active time
+// window of a button press effect.
+enum ButtonWindowState {
+  BWS_BEFORE,                // Before active window.
+  BWS_ACTIVE,                // In active window.
+  BWS_AFTER,                 // After active window.
+};
+
+
+// The most recent controller input, plus the timers that track recent
+// button presses and how they relate to the game's timing windows.
+//
+// This does not know where the input comes from; the viewer feeds it
+// polled input, and the offline tools feed it input from a recording.
+//
+class InputModel {
+public:      // data
+  // Configuration that determines the timer durations and thresholds.
+  // Not owned.  Must not be null.
+  GPVConfig const *m_config;
+
+  // Current controller input.
+  ControllerState m_controllerState;
+
+  // Controller input state during the previous update.
+  ControllerState m_prevControllerState;
+
+  // Timer associated with pressing the parry button (L2).
+  ButtonTimer m_parryTimer;
+
+  // Timer associated with releasing the dodge button (XBox B,
+  // PlayStation circle).
+  ButtonTimer m_dodgeReleaseTimer;
+
+  // Timer that tracks the invulnerability window associated with
+  // dodging.  This starts at the same time as the release timer, but
+  // then tracks both the invulnerability window and the recovery
+  // window, and also handles dodge queueing.
+  ButtonTimer m_dodgeInvulnerabilityTimer;
+
+public:      // methods
+  explicit InputModel(GPVConfig const *config);
+
+  // Make `newState` the current input, and start or expire timers
+  // accordingly, using `newState.m_pollTimeMS` as the current time.
+  void update(ControllerState const &newState);
+
+  // Advance the clock to `timeMS` without changing the input, which
+  // may expire timers.
+  void advanceTime(DWORD timeMS);
+
+  // Is any button timer currently running?
+  bool isAnyButtonTimerRunning() const;
+
+  // Current state of buttons, etc.
+  XINPUT_STATE const &inputState() const;
+
+  // If the dodge invulnerability timer is active, return the number of
+  // milliseconds since its timer started.  Otherwise return 0.
+  DWORD dodgeInvulnerabilityTimerElapsedMS() const;
+
+  // Is the invulnerability effect active according to the timer and
+  // config?
+  //
+  // This is our best guess, based only on dodge button release events,
+  // whether the player should be invulnerable right now.  It can be
+  // wrong for many reasons, but should be more convenient, when
+  // reviewing recordings, than manually counting frames.
+  //
+  bool isDodgeInvulnerabilityActive() const;
+
+  // If the parry timer is active, return the number of milliseconds
+  // since its.  Otherwise return 0.
+  DWORD parryTimerElapsedMS() const;
+
+  // Is the parry effect active according to the timer and config?
+  bool isParryActive() const;
+
+  // Classify the current dodge invulnerability or parry timer value
+  // relative to its active window.  For `BWS_BEFORE` and `BWS_AFTER`,
+  // `frameDelta` is how many frames (at 30 FPS) late or early the
+  // press was.  For `BWS_ACTIVE`, it is the current frame of the
+  // window, starting at 1, and `maxFrame` is the number of frames in
+  // the window; otherwise `maxFrame` is 0.
+  //
+  // The result is only meaningful while the timer is running.
+  //
+  ButtonWindowState dodgeWindowState(int &frameDelta /*OUT*/,
+                                     int &maxFrame /*OUT*/) const;
+  ButtonWindowState parryWindowState(int &frameDelta /*OUT*/,
+                                     int &maxFrame /*OUT*/) const;
+
+  // Evaulate the current dodge timer value and classify it as being a
+  // certain number of frames before, after, or during the
+  // invulnerability window, returning that classification as a string.
+  // Also set `active` to true if invulnerability is active, and false
+  // otherwise.
+  //
+  // This is meant to be meaningful when reviewing a recording and
+  // examining the frame on which damage was taken (or would have been).
+  //
+  std::wstring dodgeAccuracyString(bool &active /*OUT*/) const;
+
+  // Same, but replacing the contents of `str`, which does not allocate
+  // if it already has the capacity.
+  void dodgeAccuracyString(std::wstring &str /*OUT*/,
+                           bool &active /*OUT*/) const;
+
+  // Evaluate the current parry timer value as a parry accuracy
+  // assessment, under the assumption that the frame we are showing is
+  // the frame where either damage was received (for a failed parry) or
+  // the game registered a successful parry.
+  std::wstring parryAccuracyString() const;
+
+  // Same, but replacing the contents of `str`.
+  void parryAccuracyString(std::wstring &str /*OUT*/) const;
+};
+
+
+#endif // INPUT_MODEL_H
@@ -0,0 +1,279 @@
+// input-recording-test.cc
+// Tests for `input-recording` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-recording.h"           // module under test
+
+#include "synthetic-input.h"           // SyntheticInput
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <algorithm>                   // std::{shuffle, sort, unique}
+#include <map>                         // std::map
+#include <random>                      // std::mt19937
+#include <sstream>                     // std::{istringstream, ostringstream}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Time of the first sample of `synthRecording`.
+DWORD const c_firstSampleMS = 1000;
+
+// Interval between its keyframes.
+DWORD const c_keyframeMS = 10000;
+
+
+// A recording of `seconds` of `SyntheticInput`, polled every 4 ms from
+// `c_firstSampleMS`, with a change of configuration between two polls
+// every 20 seconds.  Only with `footer` is there an index.
+static std::string synthRecording(int seconds, bool footer)
+{
+  std::ostringstream oss;
+  InputRecordingWriter writer(oss);
+  writer.m_keyframeIntervalMS = c_keyframeMS;
+
+  GPVConfig config;
+  writer.writeHeader(config);
+
+  SyntheticInput synth;
+  DWORD endMS = c_firstSampleMS + seconds * 1000;
+  for (DWORD t = c_firstSampleMS; t < endMS; t += 4) {
+    ControllerState state;
+    synth.next(state, t);
+    writer.writeSample(state);
+
+    if (t % 20000 == 0) {
+      int &deadZone = config.m_analogThresholds.m_triggerDeadZone;
+      deadZone = (deadZone + 37) % 256;
+      writer.writeConfig(config, t + 2);
+    }
+  }
+
+  if (footer) {
+    writer.writeFooter();
+  }
+  EXPECT(writer.ok());
+  return oss.str();
+}
+
+
+// Description of where a seek ended up: the latest sample and how many
+// there have been, the configuration and when it took effect, the
+// model's timers, and `type`, the record read next.
+static std::string describeResult(
+  ControllerState const &state, long sampleCount,
+  GPVConfig const &config, DWORD configTimeMS,
+  InputModel const &model,
+  int type, InputRecordingReader const &next)
+{
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  std::ostringstream oss;
+  oss << "sample " << sampleCount
+      << " at " << state.m_pollTimeMS
+      << ": state=" << state.m_hasInputState
+      << " packet=" << state.m_inputState.dwPacketNumber
+      << " buttons=" << g.wButtons
+      << " triggers=" << (int)g.bLeftTrigger << "," << (int)g.bRightTrigger
+      << " sticks=" << g.sThumbLX << "," << g.sThumbLY << ","
+                    << g.sThumbRX << "," << g.sThumbRY
+      << "; config from " << configTimeMS
+      << " dead zone " << config.m_analogThresholds.m_triggerDeadZone
+      << "; timers";
+
+  // The start time of a timer that is not running is left over from
+  // its last run, and not part of the state.
+  for (ButtonTimer const *timer : { &model.m_parryTimer,
+                                    &model.m_dodgeReleaseTimer,
+                                    &model.m_dodgeInvulnerabilityTimer }) {
+    oss << " " << timer->m_running << timer->m_queued;
+    if (timer->m_running) {
+      oss << "@" << timer->m_startMS;
+    }
+  }
+
+  oss << "; then ";
+  if (type == IRT_SAMPLE) {
+    oss << "sample at " << next.m_state.m_pollTimeMS;
+  }
+  else if (type == IRT_CONFIG) {
+    oss << "config at " << next.m_configTimeMS;
+  }
+  else {
+    oss << "end";
+  }
+  return oss.str();
+}
+
+
+// Where seeking `recording` to each of `times` should end up, found by
+// decoding it from the start.
+static std::map<DWORD, std::string> decodeTo(std::string const &recording,
+                                             std::vector<DWORD> times)
+{
+  std::sort(times.begin(), times.end());
+
+  std::istringstream iss(recording);
+  InputRecordingReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+
+  // The reader reads one record ahead, so what is in effect is kept
+  // separately.
+  ControllerState state;
+  long sampleCount = 0;
+  GPVConfig config;
+  DWORD configTimeMS = 0;
+  InputModel model(&config);
+
+  std::map<DWORD, std::string> results;
+  int type = reader.readNext();
+  for (DWORD t : times) {
+    while (type != 0) {
+      DWORD recordTimeMS = type == IRT_SAMPLE?
+        reader.m_state.m_pollTimeMS : reader.m_configTimeMS;
+      if (recordTimeMS > t) {
+        break;
+      }
+      if (type == IRT_SAMPLE) {
+        state = reader.m_state;
+        sampleCount++;
+        model.update(state);
+      }
+      else {
+        config = reader.m_config;
+        configTimeMS = reader.m_configTimeMS;
+      }
+      type = reader.readNext();
+    }
+
+    InputModel expectModel(model);
+    expectModel.advanceTime(t);
+    results[t] = describeResult(state, sampleCount, config, configTimeMS,
+                                expectModel, type, reader);
+  }
+  EXPECT_EQ(reader.m_error, "");
+  return results;
+}
+
+
+// Seek `recording` to each of `times`, in a random order, and check
+// that each ends up where decoding from the start does.  Check that
+// the recording has an index if and only if `indexed`.
+static void checkSeeks(std::string const &recording,
+                       std::vector<DWORD> times, bool indexed)
+{
+  std::map<DWORD, std::string> expect = decodeTo(recording, times);
+
+  std::istringstream iss(recording);
+  InputRecordingReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+  std::string error = reader.readIndex();
+  EXPECT_EQ(error.empty(), indexed);
+  EXPECT_EQ(reader.m_index.empty(), !indexed);
+
+  std::shuffle(times.begin(), times.end(), std::mt19937(9));
+  InputModel model(&reader.m_config);
+  int mismatches = 0;
+  for (DWORD t : times) {
+    EXPECT_EQ(reader.seek(t, model), "");
+    ControllerState state = reader.m_state;
+    long sampleCount = reader.m_sampleCount;
+    GPVConfig config = reader.m_config;
+    DWORD configTimeMS = reader.m_configTimeMS;
+    int type = reader.readNext();
+    std::string actual = describeResult(state, sampleCount, config,
+                                        configTimeMS, model, type, reader);
+    if (actual != expect[t] && mismatches++ < 5) {
+      unitTestFail(__FILE__, __LINE__,
+                   "seek to " + std::to_string(t) + ": " + actual +
+                   " != " + expect[t]);
+    }
+  }
+  EXPECT_EQ(mismatches, 0);
+}
+
+
+// Times that are interesting for a recording of `seconds` made by
+// `synthRecording`, with `keyframes`, plus `random` others.
+static std::vector<DWORD> seekTimes(
+  int seconds, std::vector<InputRecordingIndexEntry> const &keyframes,
+  int random)
+{
+  DWORD lastMS = c_firstSampleMS + seconds * 1000 - 4;
+  std::vector<DWORD> times = {
+    // Before the first sample, and on it.
+    0, c_firstSampleMS - 1, c_firstSampleMS, c_firstSampleMS + 1,
+
+    // Before the first keyframe.
+    c_firstSampleMS + 4000, c_firstSampleMS + c_keyframeMS - 1,
+
+    // On and around the configuration changes.
+    19999, 20000, 20001, 20002, 20003, 20004, 40002,
+
+    // On the last sample, and past the end.
+    lastMS - 1, lastMS, lastMS + 1, lastMS + 100000,
+  };
+
+  // On and around each keyframe.
+  for (InputRecordingIndexEntry const &e : keyframes) {
+    times.push_back(e.m_timeMS - 1);
+    times.push_back(e.m_timeMS);
+    times.push_back(e.m_timeMS + 1);
+  }
+
+  std::mt19937 rng(10);
+  for (int i=0; i < random; ++i) {
+    times.push_back(rng() % (lastMS + 2000));
+  }
+
+  std::sort(times.begin(), times.end());
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+  return times;
+}
+
+
+UNIT_TEST(seekMatchesDecoding)
+{
+  int const seconds = 300;
+  std::string recording = synthRecording(seconds, true /*footer*/);
+
+  std::istringstream iss(recording);
+  InputRecordingReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+  EXPECT_EQ(reader.readIndex(), "");
+  EXPECT_EQ(reader.m_firstSampleTimeMS, c_firstSampleMS);
+  EXPECT_EQ(reader.m_index.size(), (std::size_t)(seconds * 1000 /
+                                                 c_keyframeMS - 1));
+  for (std::size_t i=1; i < reader.m_index.size(); ++i) {
+    EXPECT(reader.m_index[i].m_timeMS > reader.m_index[i-1].m_timeMS);
+  }
+
+  checkSeeks(recording, seekTimes(seconds, reader.m_index, 200),
+             true /*indexed*/);
+}
+
+
+// Without the index, or the pointer to it, seeking decodes from the
+// start, with the same results.
+UNIT_TEST(seekWithoutIndex)
+{
+  int const seconds = 60;
+  std::vector<DWORD> times =
+    seekTimes(seconds, std::vector<InputRecordingIndexEntry>(), 20);
+
+  // Not finished with `writeFooter`.
+  checkSeeks(synthRecording(seconds, false /*footer*/), times,
+             false /*indexed*/);
+
+  // The index record, but not the pointer after it.
+  std::string recording = synthRecording(seconds, true /*footer*/);
+  std::string withoutPointer = recording.substr(0, recording.size() - 10);
+  checkSeeks(withoutPointer, times, false /*indexed*/);
+
+  // A pointer to something other than the index.
+  std::string badPointer = recording;
+  badPointer[badPointer.size() - 8] ^= 1;
+  checkSeeks(badPointer, times, false /*indexed*/);
+}
+
+
+// EOF
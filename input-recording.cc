@@ -0,0 +1,754 @@
+// input-recording.cc
+// Code for `input-recording` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "input-recording.h"           // this module
+
+#include "varint.h"                    // appendVarint, readVarint, etc.
+
+#include <algorithm>                   // std::upper_bound
+#include <cerrno>                      // errno
+#include <cstring>                     // std::{memcmp, strerror}
+#include <fstream>                     // std::ifstream
+#include <istream>                     // std::istream
+#include <memory>                      // std::unique_ptr
+#include <ostream>                     // std::ostream
+#include <sstream>                     // std::ostringstream
+
+
+// First bytes of every recording.  The CR LF makes it evident if the
+// file has been through a text-mode transfer.
+static char const s_magic[8] = { 'G','P','V','R','E','C','\r','\n' };
+
+// Size of the index pointer record, including its type and length.
+static int const c_indexPointerSize = 10;
+
+
+// The timers stored in a keyframe, in order.
+static ButtonTimer InputModel::* const s_keyframeTimers[] = {
+  &InputModel::m_parryTimer,
+  &InputModel::m_dodgeReleaseTimer,
+  &InputModel::m_dodgeInvulnerabilityTimer,
+};
+
+
+// --------------------- InputRecordingIndexEntry ----------------------
+InputRecordingIndexEntry::InputRecordingIndexEntry()
+  : m_timeMS(0),
+    m_sampleCount(0),
+    m_keyframeOffset(0),
+    m_configOffset(0),
+    m_configTimeMS(0)
+{}
+
+
+// ------------------------ InputRecordingWriter -----------------------
+InputRecordingWriter::InputRecordingWriter(std::ostream &os)
+  : m_os(os),
+    m_prevState(),
+    m_sampleCount(0),
+    m_configCount(0),
+    m_keyframeIntervalMS(10000),
+    m_buffer(),
+    m_offset(0),
+    m_config(),
+    m_configOffset(0),
+    m_configTimeMS(0),
+    m_model(&m_config),
+    m_firstSampleTimeMS(0),
+    m_lastKeyframeTimeMS(0),
+    m_index()
+{}
+
+
+void InputRecordingWriter::writeRecord(InputRecordType type)
+{
+  std::string header;
+  header.push_back((char)type);
+  appendVarint(header, m_buffer.size());
+
+  m_os.write(header.data(), header.size());
+  m_os.write(m_buffer.data(), m_buffer.size());
+  m_offset += header.size() + m_buffer.size();
+}
+
+
+void InputRecordingWriter::writeHeader(GPVConfig const &config)
+{
+  std::string header(s_magic, sizeof(s_magic));
+  appendVarint(header, INPUT_RECORDING_VERSION);
+  m_os.write(header.data(), header.size());
+  m_offset += header.size();
+
+  // Relative to the all-zero initial state, this says time 0.
+  writeConfig(config, m_prevState.m_pollTimeMS);
+}
+
+
+void InputRecordingWriter::writeConfig(GPVConfig const &config,
+                                       DWORD timeMS)
+{
+  m_buffer.clear();
+  appendVarint(m_buffer, (std::uint32_t)(timeMS - m_prevState.m_pollTimeMS));
+  appendVarint(m_buffer, GPV_CONFIG_BINARY_VERSION);
+  config.encodeBinary(m_buffer);
+
+  m_configOffset = m_offset;
+  m_configTimeMS = timeMS;
+  m_config = config;
+  writeRecord(IRT_CONFIG);
+  m_configCount++;
+}
+
+
+bool InputRecordingWriter::writeSample(ControllerState const &state)
+{
+  XINPUT_STATE const &cur = state.m_inputState;
+  XINPUT_STATE const &prev = m_prevState.m_inputState;
+  XINPUT_GAMEPAD const &g = cur.Gamepad;
+  XINPUT_GAMEPAD const &pg = prev.Gamepad;
+
+  unsigned mask = 0;
+  if (state.m_hasInputState != m_prevState.m_hasInputState) {
+    mask |= SF_HAS_STATE;
+  }
+  if (cur.dwPacketNumber != prev.dwPacketNumber) { mask |= SF_PACKET; }
+  if (g.wButtons         != pg.wButtons)         { mask |= SF_BUTTONS; }
+  if (g.bLeftTrigger     != pg.bLeftTrigger)     { mask |= SF_LEFT_TRIGGER; }
+  if (g.bRightTrigger    != pg.bRightTrigger)    { mask |= SF_RIGHT_TRIGGER; }
+  if (g.sThumbLX         != pg.sThumbLX)         { mask |= SF_THUMB_LX; }
+  if (g.sThumbLY         != pg.sThumbLY)         { mask |= SF_THUMB_LY; }
+  if (g.sThumbRX         != pg.sThumbRX)         { mask |= SF_THUMB_RX; }
+  if (g.sThumbRY         != pg.sThumbRY)         { mask |= SF_THUMB_RY; }
+
+  if (mask == 0 && m_sampleCount > 0) {
+    // Nothing changed.
+    return false;
+  }
+
+  m_buffer.clear();
+
+  // The subtraction is done in 32 bits so the tick counter wrapping
+  // around does not matter.
+  appendVarint(m_buffer,
+    (std::uint32_t)(state.m_pollTimeMS - m_prevState.m_pollTimeMS));
+  appendVarint(m_buffer, mask);
+
+  if (mask & SF_PACKET) {
+    appendVarint(m_buffer,
+      (std::uint32_t)(cur.dwPacketNumber - prev.dwPacketNumber));
+  }
+  if (mask & SF_BUTTONS) {
+    appendVarint(m_buffer, g.wButtons ^ pg.wButtons);
+  }
+  if (mask & SF_LEFT_TRIGGER) {
+    appendSignedVarint(m_buffer, g.bLeftTrigger - pg.bLeftTrigger);
+  }
+  if (mask & SF_RIGHT_TRIGGER) {
+    appendSignedVarint(m_buffer, g.bRightTrigger - pg.bRightTrigger);
+  }
+  if (mask & SF_THUMB_LX) {
+    appendSignedVarint(m_buffer, g.sThumbLX - pg.sThumbLX);
+  }
+  if (mask & SF_THUMB_LY) {
+    appendSignedVarint(m_buffer, g.sThumbLY - pg.sThumbLY);
+  }
+  if (mask & SF_THUMB_RX) {
+    appendSignedVarint(m_buffer, g.sThumbRX - pg.sThumbRX);
+  }
+  if (mask & SF_THUMB_RY) {
+    appendSignedVarint(m_buffer, g.sThumbRY - pg.sThumbRY);
+  }
+
+  writeRecord(IRT_SAMPLE);
+
+  m_prevState = state;
+  m_sampleCount++;
+
+  m_model.update(state);
+  if (m_sampleCount == 1) {
+    m_firstSampleTimeMS = state.m_pollTimeMS;
+    m_lastKeyframeTimeMS = state.m_pollTimeMS;
+  }
+  else if (m_keyframeIntervalMS > 0 &&
+           state.m_pollTimeMS - m_lastKeyframeTimeMS >=
+             m_keyframeIntervalMS) {
+    writeKeyframe();
+  }
+
+  return true;
+}
+
+
+void InputRecordingWriter::writeKeyframe()
+{
+  ControllerState const &cs = m_model.m_controllerState;
+  XINPUT_GAMEPAD const &g = cs.m_inputState.Gamepad;
+
+  InputRecordingIndexEntry entry;
+  entry.m_timeMS = cs.m_pollTimeMS;
+  entry.m_sampleCount = m_sampleCount;
+  entry.m_keyframeOffset = m_offset;
+  entry.m_configOffset = m_configOffset;
+  entry.m_configTimeMS = m_configTimeMS;
+
+  m_buffer.clear();
+  appendVarint(m_buffer, m_sampleCount);
+  appendVarint(m_buffer, cs.m_pollTimeMS);
+  m_buffer.push_back((char)cs.m_hasInputState);
+  appendVarint(m_buffer, cs.m_inputState.dwPacketNumber);
+  appendVarint(m_buffer, g.wButtons);
+  appendVarint(m_buffer, g.bLeftTrigger);
+  appendVarint(m_buffer, g.bRightTrigger);
+  appendSignedVarint(m_buffer, g.sThumbLX);
+  appendSignedVarint(m_buffer, g.sThumbLY);
+  appendSignedVarint(m_buffer, g.sThumbRX);
+  appendSignedVarint(m_buffer, g.sThumbRY);
+
+  for (ButtonTimer InputModel::*member : s_keyframeTimers) {
+    ButtonTimer const &timer = m_model.*member;
+    appendVarint(m_buffer, (timer.m_running? 1 : 0) |
+                           (timer.m_queued? 2 : 0));
+    if (timer.m_running) {
+      // Done in 64 bits like the timer itself, so it survives the
+      // queued start being before time 0.
+      appendSignedVarint(m_buffer, (std::int64_t)
+        ((ButtonTimer::ClockValue)cs.m_pollTimeMS - timer.m_startMS));
+    }
+  }
+
+  writeRecord(IRT_KEYFRAME);
+  m_index.push_back(entry);
+  m_lastKeyframeTimeMS = cs.m_pollTimeMS;
+}
+
+
+void InputRecordingWriter::writeFooter()
+{
+  std::uint64_t indexOffset = m_offset;
+
+  m_buffer.clear();
+  appendVarint(m_buffer, m_firstSampleTimeMS);
+  appendVarint(m_buffer, m_index.size());
+
+  InputRecordingIndexEntry prev;
+  for (InputRecordingIndexEntry const &e : m_index) {
+    appendVarint(m_buffer, (std::uint32_t)(e.m_timeMS - prev.m_timeMS));
+    appendVarint(m_buffer, e.m_sampleCount - prev.m_sampleCount);
+    appendVarint(m_buffer, e.m_keyframeOffset - prev.m_keyframeOffset);
+    appendVarint(m_buffer, e.m_configOffset - prev.m_configOffset);
+    appendVarint(m_buffer, (std::uint32_t)(e.m_timeMS - e.m_configTimeMS));
+    prev = e;
+  }
+  writeRecord(IRT_INDEX);
+
+  // Fixed size, so it can be found from the end.
+  m_buffer.clear();
+  for (int i=0; i < 8; ++i) {
+    m_buffer.push_back((char)(indexOffset >> (i*8)));
+  }
+  writeRecord(IRT_INDEX_POINTER);
+}
+
+
+bool InputRecordingWriter::ok() const
+{
+  return m_os.good();
+}
+
+
+// ------------------------ InputRecordingReader -----------------------
+InputRecordingReader::InputRecordingReader(std::istream &is)
+  : m_is(is),
+    m_state(),
+    m_sampleCount(0),
+    m_config(),
+    m_configTimeMS(0),
+    m_configCount(0),
+    m_error(),
+    m_buffer(),
+    m_index(),
+    m_firstSampleTimeMS(0),
+    m_firstRecordOffset(0)
+{}
+
+
+std::string InputRecordingReader::readHeader()
+{
+  char magic[sizeof(s_magic)];
+  if (!m_is.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, s_magic, sizeof(magic)) != 0) {
+    return "not an input recording (bad magic number)";
+  }
+
+  // The version is small enough to fit in one byte.
+  int version = m_is.get();
+  if (version != INPUT_RECORDING_VERSION) {
+    std::ostringstream oss;
+    oss << "unsupported input recording version " << version;
+    return oss.str();
+  }
+
+  m_firstRecordOffset = (std::uint64_t)m_is.tellg();
+  return "";
+}
+
+
+bool InputRecordingReader::readRecord(int &type /*OUT*/)
+{
+  type = m_is.get();
+  if (type == std::istream::traits_type::eof()) {
+    // Normal end of stream.
+    return false;
+  }
+
+  // Read the length a byte at a time since it precedes the payload.
+  std::uint64_t length = 0;
+  for (int shift = 0; ; shift += 7) {
+    int b = m_is.get();
+    if (b == std::istream::traits_type::eof() || shift >= 64) {
+      m_error = "truncated or malformed record length";
+      return false;
+    }
+    length |= (std::uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      break;
+    }
+  }
+
+  // A record is never remotely this large; this guards against
+  // allocating a huge buffer due to a corrupt length.  The index of a
+  // recording weeks long can be a few megabytes.
+  if (length > (type == IRT_INDEX? 0x4000000u : 0x100000u)) {
+    m_error = "record length is implausibly large";
+    return false;
+  }
+
+  m_buffer.resize(length);
+  if (!m_is.read(&m_buffer[0], length)) {
+    m_error = "truncated record";
+    return false;
+  }
+
+  return true;
+}
+
+
+bool InputRecordingReader::decodeSample()
+{
+  char const *p = m_buffer.data();
+  char const *end = p + m_buffer.size();
+
+  XINPUT_STATE &cur = m_state.m_inputState;
+  XINPUT_GAMEPAD &g = cur.Gamepad;
+
+  std::uint64_t dt, mask;
+  if (!readVarint(p, end, dt) ||
+      !readVarint(p, end, mask)) {
+    return false;
+  }
+  m_state.m_pollTimeMS += (DWORD)dt;
+
+  if (mask & SF_HAS_STATE) {
+    m_state.m_hasInputState = !m_state.m_hasInputState;
+  }
+
+  std::uint64_t u;
+  std::int64_t d;
+
+  #define READ_UNSIGNED(bit, stmt)             \
+    if (mask & (bit)) {                        \
+      if (!readVarint(p, end, u)) {            \
+        return false;                          \
+      }                                        \
+      stmt;                                    \
+    }
+  #define READ_SIGNED(bit, field, type)        \
+    if (mask & (bit)) {                        \
+      if (!readSignedVarint(p, end, d)) {      \
+        return false;                          \
+      }                                        \
+      field = (type)(field + d);               \
+    }
+
+  READ_UNSIGNED(SF_PACKET,  cur.dwPacketNumber += (DWORD)u)
+  READ_UNSIGNED(SF_BUTTONS, g.wButtons ^= (WORD)u)
+  READ_SIGNED(SF_LEFT_TRIGGER,  g.bLeftTrigger,  BYTE)
+  READ_SIGNED(SF_RIGHT_TRIGGER, g.bRightTrigger, BYTE)
+  READ_SIGNED(SF_THUMB_LX,      g.sThumbLX,      SHORT)
+  READ_SIGNED(SF_THUMB_LY,      g.sThumbLY,      SHORT)
+  READ_SIGNED(SF_THUMB_RX,      g.sThumbRX,      SHORT)
+  READ_SIGNED(SF_THUMB_RY,      g.sThumbRY,      SHORT)
+
+  #undef READ_UNSIGNED
+  #undef READ_SIGNED
+
+  // Any remaining bytes would be fields added by a later version.
+  return true;
+}
+
+
+std::string InputRecordingReader::decodeConfig()
+{
+  char const *p = m_buffer.data();
+  char const *end = p + m_buffer.size();
+
+  std::uint64_t dt, version;
+  if (!readVarint(p, end, dt) ||
+      !readVarint(p, end, version)) {
+    return "malformed configuration record";
+  }
+
+  if (version != GPV_CONFIG_BINARY_VERSION) {
+    // Guessing would make the replay quietly disagree with what was
+    // shown live, which is what the record is meant to prevent.
+    std::ostringstream oss;
+    oss << "unsupported configuration encoding version " << version;
+    return oss.str();
+  }
+
+  // Each record has every field its writer knew about.  Decode over
+  // the defaults, so fields added since then get their defaults rather
+  // than values left over from an earlier record.
+  GPVConfig config;
+  if (!config.decodeBinary(p, end)) {
+    return "malformed configuration record";
+  }
+
+  m_config = config;
+  m_configTimeMS = m_state.m_pollTimeMS + (DWORD)dt;
+  return "";
+}
+
+
+int InputRecordingReader::readNext()
+{
+  int type;
+  while (readRecord(type)) {
+    if (type == IRT_SAMPLE) {
+      if (!decodeSample()) {
+        std::ostringstream oss;
+        oss << "malformed sample record after sample " << m_sampleCount;
+        m_error = oss.str();
+        return 0;
+      }
+      m_sampleCount++;
+      return type;
+    }
+
+    if (type == IRT_CONFIG) {
+      std::string error = decodeConfig();
+      if (!error.empty()) {
+        std::ostringstream oss;
+        oss << error << " after sample " << m_sampleCount;
+        m_error = oss.str();
+        return 0;
+      }
+      m_configCount++;
+      return type;
+    }
+
+    // Skip records of other types.
+  }
+
+  return 0;
+}
+
+
+bool InputRecordingReader::readSample()
+{
+  int type;
+  while ((type = readNext()) != 0) {
+    if (type == IRT_SAMPLE) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+std::string InputRecordingReader::readRecordAt(std::uint64_t offset,
+                                              int type)
+{
+  m_is.clear();
+  m_is.seekg(offset);
+
+  int actualType;
+  if (!readRecord(actualType)) {
+    std::string error = m_error.empty()? "truncated record" : m_error;
+    m_error.clear();
+    return error;
+  }
+  if (actualType != type) {
+    std::ostringstream oss;
+    oss << "expected a record of type " << type << " at offset "
+        << offset << ", but found type " << actualType;
+    return oss.str();
+  }
+  return "";
+}
+
+
+bool InputRecordingReader::decodeKeyframe(InputModel &model)
+{
+  char const *p = m_buffer.data();
+  char const *end = p + m_buffer.size();
+
+  ControllerState cs;
+  XINPUT_GAMEPAD &g = cs.m_inputState.Gamepad;
+  std::uint64_t count, time, packet, buttons, lt, rt;
+  std::int64_t lx, ly, rx, ry;
+  if (!readVarint(p, end, count) ||
+      !readVarint(p, end, time) ||
+      p == end) {
+    return false;
+  }
+  cs.m_hasInputState = *p++ != 0;
+  if (!readVarint(p, end, packet) ||
+      !readVarint(p, end, buttons) ||
+      !readVarint(p, end, lt) ||
+      !readVarint(p, end, rt) ||
+      !readSignedVarint(p, end, lx) ||
+      !readSignedVarint(p, end, ly) ||
+      !readSignedVarint(p, end, rx) ||
+      !readSignedVarint(p, end, ry)) {
+    return false;
+  }
+  cs.m_pollTimeMS = (DWORD)time;
+  cs.m_inputState.dwPacketNumber = (DWORD)packet;
+  g.wButtons = (WORD)buttons;
+  g.bLeftTrigger = (BYTE)lt;
+  g.bRightTrigger = (BYTE)rt;
+  g.sThumbLX = (SHORT)lx;
+  g.sThumbLY = (SHORT)ly;
+  g.sThumbRX = (SHORT)rx;
+  g.sThumbRY = (SHORT)ry;
+
+  for (ButtonTimer InputModel::*member : s_keyframeTimers) {
+    ButtonTimer &timer = model.*member;
+    std::uint64_t flags;
+    std::int64_t elapsed = 0;
+    if (!readVarint(p, end, flags) ||
+        ((flags & 1) && !readSignedVarint(p, end, elapsed))) {
+      return false;
+    }
+    timer.m_running = (flags & 1) != 0;
+    timer.m_queued = (flags & 2) != 0;
+    timer.m_startMS = timer.m_running?
+      (ButtonTimer::ClockValue)cs.m_pollTimeMS -
+        (ButtonTimer::ClockValue)elapsed : 0;
+  }
+
+  m_state = cs;
+  m_sampleCount = (long)count;
+  model.m_controllerState = cs;
+  model.m_prevControllerState = cs;
+  return true;
+}
+
+
+std::string InputRecordingReader::readIndex()
+{
+  std::istream::pos_type startPos = m_is.tellg();
+  std::string error;
+
+  m_is.seekg(0, std::ios::end);
+  std::uint64_t size = (std::uint64_t)m_is.tellg();
+  unsigned char pointer[c_indexPointerSize];
+  if (!m_is || size < m_firstRecordOffset + c_indexPointerSize) {
+    error = "recording has no index";
+  }
+  else {
+    m_is.seekg(size - c_indexPointerSize);
+    if (!m_is.read((char*)pointer, c_indexPointerSize) ||
+        pointer[0] != IRT_INDEX_POINTER ||
+        pointer[1] != 8) {
+      error = "recording has no index";
+    }
+  }
+
+  if (error.empty()) {
+    std::uint64_t indexOffset = 0;
+    for (int i=0; i < 8; ++i) {
+      indexOffset |= (std::uint64_t)pointer[2+i] << (i*8);
+    }
+    error = readRecordAt(indexOffset, IRT_INDEX);
+  }
+
+  if (error.empty()) {
+    char const *p = m_buffer.data();
+    char const *end = p + m_buffer.size();
+    std::uint64_t first, count;
+    if (!readVarint(p, end, first) ||
+        !readVarint(p, end, count) ||
+        count > m_buffer.size()) {
+      error = "malformed index";
+    }
+
+    std::vector<InputRecordingIndexEntry> index;
+    InputRecordingIndexEntry prev;
+    for (std::uint64_t i=0; error.empty() && i < count; ++i) {
+      std::uint64_t dt, dn, dk, dc, ct;
+      if (!readVarint(p, end, dt) ||
+          !readVarint(p, end, dn) ||
+          !readVarint(p, end, dk) ||
+          !readVarint(p, end, dc) ||
+          !readVarint(p, end, ct)) {
+        error = "malformed index";
+        break;
+      }
+      InputRecordingIndexEntry e;
+      e.m_timeMS = prev.m_timeMS + (DWORD)dt;
+      e.m_sampleCount = prev.m_sampleCount + (long)dn;
+      e.m_keyframeOffset = prev.m_keyframeOffset + dk;
+      e.m_configOffset = prev.m_configOffset + dc;
+      e.m_configTimeMS = e.m_timeMS - (DWORD)ct;
+      index.push_back(e);
+      prev = e;
+    }
+
+    if (error.empty()) {
+      m_firstSampleTimeMS = (DWORD)first;
+      m_index.swap(index);
+    }
+  }
+
+  m_is.clear();
+  m_is.seekg(startPos);
+  return error;
+}
+
+
+std::string InputRecordingReader::seek(DWORD timeMS, InputModel &model)
+{
+  // Compare times relative to the first sample, so this works across
+  // the tick counter wrapping around.
+  DWORD relMS = timeMS - m_firstSampleTimeMS;
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), relMS,
+    [this](DWORD t, InputRecordingIndexEntry const &e) {
+      return t < e.m_timeMS - m_firstSampleTimeMS;
+    });
+  if ((std::int32_t)relMS < 0) {
+    it = m_index.begin();
+  }
+
+  if (it == m_index.begin()) {
+    // Before the first keyframe, so start from the beginning.
+    m_is.clear();
+    m_is.seekg(m_firstRecordOffset);
+    m_state = ControllerState();
+    m_sampleCount = 0;
+    m_config = GPVConfig();
+    m_configTimeMS = 0;
+    model = InputModel(model.m_config);
+  }
+  else {
+    InputRecordingIndexEntry const &e = *(it-1);
+
+    std::string error = readRecordAt(e.m_configOffset, IRT_CONFIG);
+    if (error.empty()) {
+      error = decodeConfig();
+    }
+    if (!error.empty()) {
+      return error;
+    }
+    m_configTimeMS = e.m_configTimeMS;
+
+    error = readRecordAt(e.m_keyframeOffset, IRT_KEYFRAME);
+    if (!error.empty()) {
+      return error;
+    }
+    if (!decodeKeyframe(model)) {
+      return "malformed keyframe";
+    }
+  }
+
+  // Decode forward to `timeMS`, stopping before the first record after
+  // it.
+  while (m_is.peek() != std::istream::traits_type::eof()) {
+    std::istream::pos_type pos = m_is.tellg();
+    ControllerState prevState = m_state;
+    long prevSampleCount = m_sampleCount;
+
+    // Configuration records are rare, so only those are saved.
+    bool isConfig = m_is.peek() == IRT_CONFIG;
+    std::unique_ptr<GPVConfig> prevConfig;
+    DWORD prevConfigTimeMS = m_configTimeMS;
+    if (isConfig) {
+      prevConfig.reset(new GPVConfig(m_config));
+    }
+
+    int type = readNext();
+    if (type == 0) {
+      if (!m_error.empty()) {
+        return m_error;
+      }
+      break;
+    }
+
+    DWORD t = type == IRT_SAMPLE? m_state.m_pollTimeMS : m_configTimeMS;
+    if ((std::int32_t)(t - timeMS) > 0) {
+      m_state = prevState;
+      m_sampleCount = prevSampleCount;
+      if (type == IRT_CONFIG) {
+        m_config = *prevConfig;
+        m_configTimeMS = prevConfigTimeMS;
+        m_configCount--;
+      }
+      m_is.clear();
+      m_is.seekg(pos);
+      break;
+    }
+
+    if (type == IRT_SAMPLE) {
+      model.update(m_state);
+    }
+  }
+
+  m_is.clear();
+  model.advanceTime(timeMS);
+  return "";
+}
+
+
+// -------------------------- RecordedConfig ---------------------------
+RecordedConfig::RecordedConfig(std::size_t firstSample, DWORD timeMS,
+                               GPVConfig const &config)
+  : m_firstSample(firstSample),
+    m_timeMS(timeMS),
+    m_config(config)
+{}
+
+
+std::string readInputRecordingFile(
+  std::string const &fname,
+  std::vector<ControllerState> &samples /*OUT*/,
+  std::vector<RecordedConfig> &configs /*OUT*/)
+{
+  std::ifstream in(fname, std::ios::binary);
+  if (!in) {
+    return std::strerror(errno);
+  }
+
+  InputRecordingReader reader(in);
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    return error;
+  }
+
+  while (int type = reader.readNext()) {
+    if (type == IRT_SAMPLE) {
+      samples.push_back(reader.m_state);
+    }
+    else {
+      configs.emplace_back(samples.size(), reader.m_configTimeMS,
+                           reader.m_config);
+    }
+  }
+
+  return reader.m_error;
+}
+
+
+// EOF
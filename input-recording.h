@@ -0,0 +1,373 @@
+// input-recording.h
+// Binary file format for recorded controller input.
+
+// See license.txt for copyright and terms of use.
+
+// A recording is a header followed by a sequence of records:
+//
+//   header:
+//     8 bytes    magic: "GPVREC" CR LF
+//     varint     format version, currently 1
+//     record     configuration record giving the initial configuration
+//                (absent in recordings made before it was added)
+//
+//   record:
+//     1 byte     type, one of `InputRecordType`
+//     varint     payload length in bytes
+//     payload
+//
+// Readers skip records whose type they do not know, so new types can
+// be added without breaking old readers.  The stream simply ends after
+// the last record.
+//
+// A sample record describes a `ControllerState` relative to the one
+// before it (or to an all-zero state for the first one):
+//
+//   varint       milliseconds since the previous sample's poll time
+//   varint       mask of changed fields, `SampleField` bits
+//   for each set bit, in increasing bit order:
+//     SF_HAS_STATE         nothing; `m_hasInputState` is toggled
+//     SF_PACKET            varint, amount added (mod 2^32)
+//     SF_BUTTONS           varint, bits that flipped
+//     SF_*_TRIGGER         signed varint, amount added
+//     SF_THUMB_*           signed varint, amount added
+//
+// Consecutive identical samples are not written, so the sample rate
+// follows the rate at which the input changes rather than the poll
+// rate.  A consumer that needs a time base for running timers supplies
+// its own (see `InputModel::advanceTime`).
+//
+// A configuration record gives the `GPVConfig` in effect from then on,
+// so a replay can classify timings with the thresholds and windows that
+// were live at the time, rather than whatever the configuration file
+// says now.  One follows the header, and another is written whenever
+// the configuration changes (other than the window position and size):
+//
+//   varint       milliseconds since the previous sample's poll time
+//                (0 in the one after the header)
+//   varint       encoding version, `GPV_CONFIG_BINARY_VERSION`
+//   rest         `GPVConfig::encodeBinary`
+//
+// So that a long recording can be entered in the middle without
+// decoding everything before that point, every `m_keyframeIntervalMS`
+// of sample time the writer follows a sample with a keyframe record,
+// holding the full state a replay would have at that point: the
+// sample itself, and the `InputModel` timers after applying it.
+//
+//   varint       number of samples so far, including this one
+//   varint       poll time of the sample
+//   1 byte       `m_hasInputState`
+//   varint       packet number
+//   varint       buttons
+//   varint       left trigger, then right trigger
+//   signed varint x4  stick axes, LX LY RX RY
+//   for each timer (parry, dodge release, dodge invulnerability):
+//     varint     1 if running, plus 2 if queued
+//     signed varint  if running, the poll time minus its start time
+//
+// `writeFooter` finishes the recording with an index of the keyframes
+// and, as the very last record, a pointer to the index, so a reader
+// can find it from the end of the file:
+//
+//   index record:
+//     varint     poll time of the first sample
+//     varint     number of entries
+//     for each entry, each number relative to the previous entry's
+//     (or to 0 for the first):
+//       varint   poll time of the keyframe
+//       varint   number of samples so far
+//       varint   file offset of the keyframe record
+//       varint   file offset of the configuration record in effect
+//       varint   poll time of the keyframe minus the time that
+//                configuration took effect (not relative)
+//
+//   index pointer record (always 10 bytes):
+//     1 byte     `IRT_INDEX_POINTER`
+//     1 byte     payload length, 8
+//     8 bytes    file offset of the index record, little-endian
+//
+// Readers that do not know these records skip them, and a recording
+// that was not finished properly simply has no index.
+
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::uint64_t
+#include <iosfwd>                      // std::{istream, ostream}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Current format version.
+int const INPUT_RECORDING_VERSION = 1;
+
+
+// Record types.
+enum InputRecordType {
+  // A `ControllerState`.
+  IRT_SAMPLE = 1,
+
+  // A `GPVConfig`.
+  IRT_CONFIG = 2,
+
+  // The state after the preceding sample, in full.
+  IRT_KEYFRAME = 3,
+
+  // Index of the keyframes.
+  IRT_INDEX = 4,
+
+  // Offset of the `IRT_INDEX` record, at the end of the file.
+  IRT_INDEX_POINTER = 5,
+};
+
+
+// One keyframe, as listed in the index.
+class InputRecordingIndexEntry {
+public:      // data
+  // Poll time of the keyframe's sample.
+  DWORD m_timeMS;
+
+  // Number of samples up to and including that one.
+  long m_sampleCount;
+
+  // File offsets of the keyframe record and of the configuration
+  // record in effect at that point.
+  std::uint64_t m_keyframeOffset;
+  std::uint64_t m_configOffset;
+
+  // Time at which that configuration took effect.
+  DWORD m_configTimeMS;
+
+public:      // methods
+  InputRecordingIndexEntry();
+};
+
+
+// Bits in the changed-field mask of a sample record.
+enum SampleField {
+  SF_HAS_STATE           = 0x001,
+  SF_PACKET              = 0x002,
+  SF_BUTTONS             = 0x004,
+  SF_LEFT_TRIGGER        = 0x008,
+  SF_RIGHT_TRIGGER       = 0x010,
+  SF_THUMB_LX            = 0x020,
+  SF_THUMB_LY            = 0x040,
+  SF_THUMB_RX            = 0x080,
+  SF_THUMB_RY            = 0x100,
+};
+
+
+// Writes a recording to a stream.
+class InputRecordingWriter {
+public:      // data
+  // Stream to write to.  Not owned.
+  std::ostream &m_os;
+
+  // The most recently written sample, which the next is encoded
+  // relative to.  Initially all zeroes.
+  ControllerState m_prevState;
+
+  // Number of sample records written.
+  long m_sampleCount;
+
+  // Number of configuration records written.
+  long m_configCount;
+
+  // Sample time between keyframes.  0 means not to write any.
+  DWORD m_keyframeIntervalMS;
+
+  // Scratch buffer for building a record.
+  std::string m_buffer;
+
+private:     // data
+  // Bytes written so far, which is the offset of the next record.
+  std::uint64_t m_offset;
+
+  // The most recently written configuration, where it is in the file,
+  // and when it took effect.
+  GPVConfig m_config;
+  std::uint64_t m_configOffset;
+  DWORD m_configTimeMS;
+
+  // The samples written so far, replayed, for the keyframes.  Its
+  // configuration is `m_config`.
+  InputModel m_model;
+
+  // Poll time of the first sample, and of the last keyframe or, until
+  // there is one, the first sample.
+  DWORD m_firstSampleTimeMS;
+  DWORD m_lastKeyframeTimeMS;
+
+  // Keyframes written so far.
+  std::vector<InputRecordingIndexEntry> m_index;
+
+private:     // methods
+  // Write a record of `type` whose payload is `m_buffer`.
+  void writeRecord(InputRecordType type);
+
+  // Write a keyframe for the current state of `m_model`.
+  void writeKeyframe();
+
+public:      // methods
+  // Does not write anything yet.
+  explicit InputRecordingWriter(std::ostream &os);
+
+  InputRecordingWriter(InputRecordingWriter const &obj) = delete;
+  InputRecordingWriter &operator=(InputRecordingWriter const &obj)
+    = delete;
+
+  // Write the file header, including `config` as the initial
+  // configuration.  This must be called first.
+  void writeHeader(GPVConfig const &config);
+
+  // Write `config` as the configuration in effect from `timeMS`, on
+  // the same clock as the samples, onward.  `timeMS` must not be
+  // earlier than the previous sample.
+  void writeConfig(GPVConfig const &config, DWORD timeMS);
+
+  // Write `state` as the next sample, unless it is identical to the
+  // previous one, apart from its time, followed by a keyframe if one
+  // is due.  Return true if written.
+  bool writeSample(ControllerState const &state);
+
+  // Write the index of the keyframes.  This should be the last thing
+  // written.
+  void writeFooter();
+
+  // True if no write has failed so far.
+  bool ok() const;
+};
+
+
+// Reads a recording from a stream.
+class InputRecordingReader {
+public:      // data
+  // Stream to read from.  Not owned.
+  std::istream &m_is;
+
+  // The most recently read sample.  Initially all zeroes.
+  ControllerState m_state;
+
+  // Number of samples read.
+  long m_sampleCount;
+
+  // Configuration from the most recent configuration record, or the
+  // defaults if there has not been one.
+  GPVConfig m_config;
+
+  // Time at which `m_config` took effect, on the samples' clock.
+  DWORD m_configTimeMS;
+
+  // Number of configuration records read.
+  long m_configCount;
+
+  // If a read fails due to malformed input, a description of why.
+  std::string m_error;
+
+  // Scratch buffer holding the payload of the current record.
+  std::string m_buffer;
+
+  // Keyframes listed in the index, in order, once `readIndex` has
+  // succeeded.
+  std::vector<InputRecordingIndexEntry> m_index;
+
+  // Poll time of the first sample, per the index.
+  DWORD m_firstSampleTimeMS;
+
+private:     // data
+  // Offset of the first record after the header.
+  std::uint64_t m_firstRecordOffset;
+
+private:     // methods
+  // Read the next record, putting its payload in `m_buffer`.  Return
+  // false at end of stream or on error, which sets `m_error`.
+  bool readRecord(int &type /*OUT*/);
+
+  // Read the record at `offset`, which must be of `type`, into
+  // `m_buffer`.  Return an error message, or an empty string.
+  std::string readRecordAt(std::uint64_t offset, int type);
+
+  // Decode the keyframe in `m_buffer` into `m_state`,
+  // `m_sampleCount`, and the timers of `model`.
+  bool decodeKeyframe(InputModel &model);
+
+  // Decode the sample in `m_buffer` relative to `m_state`.
+  bool decodeSample();
+
+  // Decode the configuration in `m_buffer` into `m_config`.  Return an
+  // error message, or an empty string.
+  std::string decodeConfig();
+
+public:      // methods
+  explicit InputRecordingReader(std::istream &is);
+
+  // Read and check the file header.  Return an empty string on
+  // success, and an error message otherwise.
+  std::string readHeader();
+
+  // Read the next sample or configuration record into `m_state` or
+  // `m_config`.  Return its type, or 0 at the end of the stream or on
+  // error, in which case `m_error` is set.
+  int readNext();
+
+  // Read the next sample into `m_state`, applying any configuration
+  // records before it to `m_config`.  Return false at the end of the
+  // stream, or on error, in which case `m_error` is set.
+  bool readSample();
+
+  // Read the index into `m_index`, leaving the read position where it
+  // was.  The stream must be seekable.  Return an empty string on
+  // success, and an error message otherwise, including if the
+  // recording has no index.
+  std::string readIndex();
+
+  // Position the reader at `timeMS`, on the samples' clock: make
+  // `m_state` the last sample at or before then, `m_config` the
+  // configuration in effect, and `model` what it would be after
+  // `update` with every sample up to there, in order, and then
+  // `advanceTime(timeMS)`.  The next `readNext` returns what follows.
+  // The one exception is that if no sample follows the keyframe used,
+  // `model.m_prevControllerState` is the same as its current state.
+  //
+  // `model` should use `m_config`.  This starts from the last keyframe
+  // at or before `timeMS`, so it only decodes the samples after that,
+  // or, without an index, from the beginning.  Return an empty string
+  // on success, and an error message otherwise.
+  std::string seek(DWORD timeMS, InputModel &model);
+};
+
+
+// A configuration read from a recording.
+class RecordedConfig {
+public:      // data
+  // Index of the first sample recorded after it.
+  std::size_t m_firstSample;
+
+  // Time at which it took effect, on the samples' clock.  This is 0 for
+  // the initial configuration.
+  DWORD m_timeMS;
+
+  GPVConfig m_config;
+
+public:      // methods
+  RecordedConfig(std::size_t firstSample, DWORD timeMS,
+                 GPVConfig const &config);
+};
+
+
+// Read all of the samples in the named file into `samples`, and the
+// configurations into `configs`, which is left empty for a recording
+// that has none.  Return an empty string on success, and an error
+// message otherwise.
+std::string readInputRecordingFile(
+  std::string const &fname,
+  std::vector<ControllerState> &samples /*OUT*/,
+  std::vector<RecordedConfig> &configs /*OUT*/);
+
+
+#endif // INPUT_RECORDING_H
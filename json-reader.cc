@@ -0,0 +1,387 @@
+// json-reader.cc
+// Code for `json-reader` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "json-reader.h"               // this module
+
+#include <algorithm>                   // std::count
+#include <charconv>                    // std::from_chars
+#include <cstring>                     // std::strlen, std::memcmp
+#include <sstream>                     // std::ostringstream
+#include <utility>                     // std::move
+
+
+// Limit on nesting when skipping unknown values, so that malicious
+// input cannot exhaust the stack.
+static int const c_maxSkipDepth = 64;
+
+
+JSONReader::JSONReader(char const *begin, char const *end)
+  : m_cur(begin),
+    m_end(end),
+    m_begin(begin),
+    m_error(),
+    m_stringBuffer()
+{}
+
+
+void JSONReader::skipSpace()
+{
+  while (m_cur < m_end &&
+         (*m_cur == ' ' || *m_cur == '\t' ||
+          *m_cur == '\n' || *m_cur == '\r')) {
+    ++m_cur;
+  }
+}
+
+
+bool JSONReader::fail(char const *msg)
+{
+  if (ok()) {
+    int line = 1 + std::count(m_begin, m_cur, '\n');
+    std::ostringstream oss;
+    oss << "line " << line << ": " << msg;
+    m_error = oss.str();
+  }
+
+  // Stop any further progress.
+  m_cur = m_end;
+  return false;
+}
+
+
+bool JSONReader::consume(char c)
+{
+  skipSpace();
+  if (m_cur < m_end && *m_cur == c) {
+    ++m_cur;
+    return true;
+  }
+  return false;
+}
+
+
+bool JSONReader::readStringLiteral(std::string_view &contents)
+{
+  if (!consume('"')) {
+    return fail("expected a string");
+  }
+
+  char const *start = m_cur;
+  while (m_cur < m_end && *m_cur != '"') {
+    if (*m_cur == '\\') {
+      // Skip the escaped character.  For "\uXXXX", the hex digits are
+      // ordinary characters as far as finding the end is concerned.
+      ++m_cur;
+    }
+    ++m_cur;
+  }
+  if (m_cur >= m_end) {
+    return fail("unterminated string");
+  }
+
+  contents = std::string_view(start, m_cur - start);
+  ++m_cur;                             // Closing quote.
+  return true;
+}
+
+
+bool JSONReader::readNumberLiteral(std::string_view &text)
+{
+  skipSpace();
+  char const *start = m_cur;
+  while (m_cur < m_end &&
+         (('0' <= *m_cur && *m_cur <= '9') ||
+          *m_cur == '-' || *m_cur == '+' || *m_cur == '.' ||
+          *m_cur == 'e' || *m_cur == 'E')) {
+    ++m_cur;
+  }
+  if (m_cur == start) {
+    return fail("expected a value");
+  }
+
+  text = std::string_view(start, m_cur - start);
+  return true;
+}
+
+
+bool JSONReader::consumeWord(char const *word)
+{
+  skipSpace();
+  std::size_t len = std::strlen(word);
+  if ((std::size_t)(m_end - m_cur) >= len &&
+      0==std::memcmp(m_cur, word, len)) {
+    m_cur += len;
+    return true;
+  }
+  return false;
+}
+
+
+bool JSONReader::beginAggregate(char open)
+{
+  if (!consume(open)) {
+    return fail(open == '{'? "expected an object" : "expected an array");
+  }
+  return true;
+}
+
+
+bool JSONReader::nextMember(char close, bool &first)
+{
+  if (!ok()) {
+    return false;
+  }
+  if (consume(close)) {
+    return false;
+  }
+
+  if (first) {
+    first = false;
+  }
+  else if (!consume(',')) {
+    return fail("expected ',' or closing bracket");
+  }
+  return true;
+}
+
+
+bool JSONReader::readKey(std::string_view &key)
+{
+  if (!readStringLiteral(key)) {
+    return false;
+  }
+  if (!consume(':')) {
+    return fail("expected ':' after object key");
+  }
+  return true;
+}
+
+
+bool JSONReader::readInt(int &value)
+{
+  skipSpace();
+  if (m_cur < m_end && (*m_cur == '-' || ('0' <= *m_cur && *m_cur <= '9'))) {
+    std::string_view text;
+    if (!readNumberLiteral(text)) {
+      return false;
+    }
+
+    int v;
+    std::from_chars_result res =
+      std::from_chars(text.data(), text.data() + text.size(), v);
+    if (res.ec == std::errc() && res.ptr == text.data() + text.size()) {
+      value = v;
+    }
+    return true;
+  }
+
+  return skipValue();
+}
+
+
+bool JSONReader::readFloat(float &value)
+{
+  skipSpace();
+  if (m_cur < m_end && (*m_cur == '-' || ('0' <= *m_cur && *m_cur <= '9'))) {
+    std::string_view text;
+    if (!readNumberLiteral(text)) {
+      return false;
+    }
+
+    float v;
+    std::from_chars_result res =
+      std::from_chars(text.data(), text.data() + text.size(), v);
+    if (res.ec == std::errc() && res.ptr == text.data() + text.size()) {
+      value = v;
+    }
+    return true;
+  }
+
+  return skipValue();
+}
+
+
+bool JSONReader::readBool(bool &value)
+{
+  if (consumeWord("true")) {
+    value = true;
+    return true;
+  }
+  if (consumeWord("false")) {
+    value = false;
+    return true;
+  }
+  return skipValue();
+}
+
+
+bool JSONReader::readString(std::string &value)
+{
+  skipSpace();
+  if (m_cur < m_end && *m_cur == '"') {
+    std::string_view text;
+    if (!readStringLiteral(text)) {
+      return false;
+    }
+
+    if (unescapeJSONString(text, m_stringBuffer)) {
+      value.assign(m_stringBuffer);
+    }
+    return true;
+  }
+
+  return skipValue();
+}
+
+
+bool JSONReader::skipValueAt(int maxDepth)
+{
+  if (maxDepth <= 0) {
+    return fail("nesting is too deep");
+  }
+
+  skipSpace();
+  if (m_cur >= m_end) {
+    return fail("expected a value");
+  }
+
+  switch (*m_cur) {
+    case '{':
+      return readObject([this, maxDepth](std::string_view) {
+        skipValueAt(maxDepth-1);
+        return true;
+      });
+
+    case '[':
+      return readArray([this, maxDepth]() {
+        skipValueAt(maxDepth-1);
+      });
+
+    case '"': {
+      std::string_view s;
+      return readStringLiteral(s);
+    }
+
+    case 't':
+    case 'f':
+    case 'n':
+      if (consumeWord("true") || consumeWord("false") ||
+          consumeWord("null")) {
+        return true;
+      }
+      return fail("expected a value");
+
+    default: {
+      std::string_view n;
+      return readNumberLiteral(n);
+    }
+  }
+}
+
+
+bool JSONReader::skipValue()
+{
+  return skipValueAt(c_maxSkipDepth);
+}
+
+
+bool JSONReader::finish()
+{
+  skipSpace();
+  if (ok() && m_cur != m_end) {
+    return fail("unexpected text after the end");
+  }
+  return ok();
+}
+
+
+// Value of hex digit `c`, or -1.
+static int hexDigitValue(char c)
+{
+  if ('0' <= c && c <= '9') {
+    return c - '0';
+  }
+  if ('a' <= c && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if ('A' <= c && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+
+// Append code point `c` to `dest` as UTF-8.
+static void appendUTF8(std::string &dest, unsigned c)
+{
+  if (c < 0x80) {
+    dest.push_back((char)c);
+  }
+  else if (c < 0x800) {
+    dest.push_back((char)(0xC0 | (c >> 6)));
+    dest.push_back((char)(0x80 | (c & 0x3F)));
+  }
+  else {
+    dest.push_back((char)(0xE0 | (c >> 12)));
+    dest.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+    dest.push_back((char)(0x80 | (c & 0x3F)));
+  }
+}
+
+
+bool unescapeJSONString(std::string_view text, std::string &dest)
+{
+  dest.clear();
+  dest.reserve(text.size());
+
+  for (std::size_t i=0; i < text.size(); ++i) {
+    char c = text[i];
+    if (c != '\\') {
+      dest.push_back(c);
+      continue;
+    }
+
+    if (++i >= text.size()) {
+      return false;
+    }
+    switch (text[i]) {
+      case '"':  dest.push_back('"');  break;
+      case '\\': dest.push_back('\\'); break;
+      case '/':  dest.push_back('/');  break;
+      case 'b':  dest.push_back('\b'); break;
+      case 'f':  dest.push_back('\f'); break;
+      case 'n':  dest.push_back('\n'); break;
+      case 'r':  dest.push_back('\r'); break;
+      case 't':  dest.push_back('\t'); break;
+
+      case 'u': {
+        // Surrogate pairs are not combined; configuration strings are
+        // names, which do not need characters outside the BMP.
+        if (text.size() - i < 5) {
+          return false;
+        }
+        unsigned code = 0;
+        for (int d=1; d <= 4; ++d) {
+          int v = hexDigitValue(text[i+d]);
+          if (v < 0) {
+            return false;
+          }
+          code = code*16 + v;
+        }
+        appendUTF8(dest, code);
+        i += 4;
+        break;
+      }
+
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+
+// EOF
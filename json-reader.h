@@ -0,0 +1,171 @@
+// json-reader.h
+// `JSONReader`, a pull-style JSON parser that does not allocate.
+
+// See license.txt for copyright and terms of use.
+
+// Unlike `json::JSON::Load`, which builds a tree of heap-allocated
+// nodes, this walks the text in place and lets the caller pull out the
+// values it wants, binding them directly into its own variables:
+//
+//   reader.readObject([&](std::string_view key) {
+//     if (key == "width") {
+//       reader.readInt(m_width);
+//       return true;
+//     }
+//     return false;                   // Not recognized; skipped.
+//   });
+//
+// Object keys are returned as views of the input text.  They are
+// compared as written, so a key that contains escape sequences will not
+// match the unescaped name; configuration keys never do.
+//
+// The first syntax error is recorded in `m_error`, after which all
+// further reads fail, so callers can check once at the end.
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>                      // std::string
+#include <string_view>                 // std::string_view
+
+
+class JSONReader {
+public:      // data
+  // Next character to read.
+  char const *m_cur;
+
+  // End of the input.
+  char const *m_end;
+
+  // Start of the input, for computing error positions.
+  char const *m_begin;
+
+  // Description of the first error, including its line number, or
+  // empty if there has not been one.
+  std::string m_error;
+
+private:     // data
+  // Where `readString` unescapes, reused so that it only allocates
+  // while growing to the longest string.
+  std::string m_stringBuffer;
+
+private:     // methods
+  // Skip whitespace.
+  void skipSpace();
+
+  // Record an error at the current position, unless there already is
+  // one.  Return false.
+  bool fail(char const *msg);
+
+  // If the next non-space character is `c`, consume it and return true.
+  bool consume(char c);
+
+  // Consume a string literal, setting `contents` to the text between
+  // the quotes, without interpreting escapes.
+  bool readStringLiteral(std::string_view &contents /*OUT*/);
+
+  // Consume a number literal, setting `text` to its characters.
+  bool readNumberLiteral(std::string_view &text /*OUT*/);
+
+  // Consume `word` if it is next.
+  bool consumeWord(char const *word);
+
+  // Skip a value, which must be present, up to `maxDepth` levels of
+  // nesting.
+  bool skipValueAt(int maxDepth);
+
+public:      // methods
+  // Read [begin,end).
+  JSONReader(char const *begin, char const *end);
+
+  // True if no error has occurred.
+  bool ok() const { return m_error.empty(); }
+
+  // Read an object, calling `handler(key)` for each member.  The handler
+  // must either consume the value, typically with one of the `read`
+  // methods, and return true, or consume nothing and return false, in
+  // which case the value is skipped.  Return false on error.
+  template <class HANDLER>
+  bool readObject(HANDLER handler);
+
+  // Read an array, calling `handler()` for each element, which must
+  // consume it.  Return false on error.
+  template <class HANDLER>
+  bool readArray(HANDLER handler);
+
+  // Read a scalar value into `value`.  If the next value is not of the
+  // right type (or, for `readInt`, not an integer in range), it is
+  // skipped and `value` is left alone.  Return false only for syntax
+  // errors.  `readFloat` accepts integers too.
+  bool readInt(int &value /*OUT*/);
+  bool readFloat(float &value /*OUT*/);
+  bool readBool(bool &value /*OUT*/);
+
+  // Read a string, interpreting escape sequences.  Unlike the other
+  // `read` methods, this allocates if `value` lacks the capacity, and
+  // the first time a string is longer than any before it.
+  bool readString(std::string &value /*OUT*/);
+
+  // Skip one value of any type.
+  bool skipValue();
+
+  // Check that nothing but whitespace remains.
+  bool finish();
+
+  // Internal, for the templates: begin and continue aggregates.
+  bool beginAggregate(char open);
+  bool nextMember(char close, bool &first);
+  bool readKey(std::string_view &key /*OUT*/);
+};
+
+
+template <class HANDLER>
+bool JSONReader::readObject(HANDLER handler)
+{
+  if (!beginAggregate('{')) {
+    return false;
+  }
+
+  bool first = true;
+  while (nextMember('}', first)) {
+    std::string_view key;
+    if (!readKey(key)) {
+      return false;
+    }
+    if (!handler(key) && !skipValue()) {
+      return false;
+    }
+    if (!ok()) {
+      return false;
+    }
+  }
+  return ok();
+}
+
+
+template <class HANDLER>
+bool JSONReader::readArray(HANDLER handler)
+{
+  if (!beginAggregate('[')) {
+    return false;
+  }
+
+  bool first = true;
+  while (nextMember(']', first)) {
+    handler();
+    if (!ok()) {
+      return false;
+    }
+  }
+  return ok();
+}
+
+
+// Set `dest` to the contents of a JSON string literal, `text` being the
+// characters between the quotes.  "\uXXXX" escapes are converted to
+// UTF-8.  Return false, leaving `dest` unspecified, if an escape is
+// malformed.
+bool unescapeJSONString(std::string_view text, std::string &dest);
+
+
+#endif // JSON_READER_H
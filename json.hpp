@@ -36,8 +36,8 @@ using std::is_convertible;
 using std::is_integral;
 using std::is_floating_point;
 
-namespace {
-    string json_escape( const string &str ) {
+namespace detail {
+    inline string json_escape( const string &str ) {
         string output;
         for( unsigned i = 0; i < str.length(); ++i )
             switch( str[i] ) {
@@ -300,7 +300,7 @@ class JSON
         string ToString() const { bool b; return ToString( b ); }
         string ToString( bool &ok ) const {
             ok = (Type == Class::String);
-            return ok ? json_escape( *Internal.String ): string("");
+            return ok ? detail::json_escape( *Internal.String ): string("");
         }
 
         double ToFloat() const { bool b; return ToFloat( b ); }
@@ -376,7 +376,7 @@ class JSON
                     return s;
                 }
                 case Class::String:
-                    return "\"" + json_escape( *Internal.String ) + "\"";
+                    return "\"" + detail::json_escape( *Internal.String ) + "\"";
                 case Class::Floating:
                     return std::to_string( Internal.Float );
                 case Class::Integral:
@@ -430,7 +430,7 @@ class JSON
         Class Type = Class::Null;
 };
 
-JSON Array() {
+inline JSON Array() {
     return JSON::Make( JSON::Class::Array );
 }
 
@@ -441,23 +441,23 @@ JSON Array( T... args ) {
     return arr;
 }
 
-JSON Object() {
+inline JSON Object() {
     return JSON::Make( JSON::Class::Object );
 }
 
-std::ostream& operator<<( std::ostream &os, const JSON &json ) {
+inline std::ostream& operator<<( std::ostream &os, const JSON &json ) {
     os << json.dump();
     return os;
 }
 
-namespace {
-    JSON parse_next( const string &, size_t & );
+namespace detail {
+    inline JSON parse_next( const string &, size_t & );
 
-    void consume_ws( const string &str, size_t &offset ) {
+    inline void consume_ws( const string &str, size_t &offset ) {
         while( isspace( str[offset] ) ) ++offset;
     }
 
-    JSON parse_object( const string &str, size_t &offset ) {
+    inline JSON parse_object( const string &str, size_t &offset ) {
         JSON Object = JSON::Make( JSON::Class::Object );
 
         ++offset;
@@ -493,7 +493,7 @@ namespace {
         return Object;
     }
 
-    JSON parse_array( const string &str, size_t &offset ) {
+    inline JSON parse_array( const string &str, size_t &offset ) {
         JSON Array = JSON::Make( JSON::Class::Array );
         unsigned index = 0;
         
@@ -522,7 +522,7 @@ namespace {
         return Array;
     }
 
-    JSON parse_string( const string &str, size_t &offset ) {
+    inline JSON parse_string( const string &str, size_t &offset ) {
         JSON String;
         string val;
         for( char c = str[++offset]; c != '\"' ; c = str[++offset] ) {
@@ -560,7 +560,7 @@ namespace {
         return String;
     }
 
-    JSON parse_number( const string &str, size_t &offset ) {
+    inline JSON parse_number( const string &str, size_t &offset ) {
         JSON Number;
         string val, exp_str;
         char c;
@@ -610,7 +610,7 @@ namespace {
         return Number;
     }
 
-    JSON parse_bool( const string &str, size_t &offset ) {
+    inline JSON parse_bool( const string &str, size_t &offset ) {
         JSON Bool;
         if( str.substr( offset, 4 ) == "true" )
             Bool = true;
@@ -624,7 +624,7 @@ namespace {
         return Bool;
     }
 
-    JSON parse_null( const string &str, size_t &offset ) {
+    inline JSON parse_null( const string &str, size_t &offset ) {
         JSON Null;
         if( str.substr( offset, 4 ) != "null" ) {
             std::cerr << "ERROR: Null: Expected 'null', found '" << str.substr( offset, 4 ) << "'\n";
@@ -634,7 +634,7 @@ namespace {
         return Null;
     }
 
-    JSON parse_next( const string &str, size_t &offset ) {
+    inline JSON parse_next( const string &str, size_t &offset ) {
         char value;
         consume_ws( str, offset );
         value = str[offset];
@@ -653,9 +653,9 @@ namespace {
     }
 }
 
-JSON JSON::Load( const string &str ) {
+inline JSON JSON::Load( const string &str ) {
     size_t offset = 0;
-    return parse_next( str, offset );
+    return detail::parse_next( str, offset );
 }
 
 } // End Namespace json
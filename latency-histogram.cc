@@ -0,0 +1,138 @@
+// latency-histogram.cc
+// Code for `latency-histogram` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "latency-histogram.h"         // this module
+
+#include "text-format.h"               // appendFormat
+
+#include <cmath>                       // std::ceil
+#include <cstdio>                      // std::snprintf
+#include <cstring>                     // std::memset
+
+
+// log2 of `SUB_BUCKETS`.
+static int const c_subBucketBits = 5;
+
+// log2 of `NUM_EXACT`.
+static int const c_exactBits = 6;
+
+// Format of `summary`, given p50, p99, and max in milliseconds.
+static char const c_summaryFormat[] = "p50 %.1f p99 %.1f max %.1f ms";
+
+
+LatencyHistogram::LatencyHistogram()
+{
+  clear();
+}
+
+
+void LatencyHistogram::clear()
+{
+  std::memset(m_counts, 0, sizeof(m_counts));
+  m_count = 0;
+  m_maxUS = 0;
+  m_sumUS = 0;
+}
+
+
+void LatencyHistogram::add(std::uint64_t us)
+{
+  m_counts[bucketIndex(us)]++;
+  m_count++;
+  m_sumUS += us;
+  if (us > m_maxUS) {
+    m_maxUS = us;
+  }
+}
+
+
+/*static*/ int LatencyHistogram::bucketIndex(std::uint64_t us)
+{
+  if (us < NUM_EXACT) {
+    return (int)us;
+  }
+
+  // Position of the highest set bit.
+#ifdef __GNUC__
+  int exponent = 63 - __builtin_clzll(us);
+#else
+  int exponent = 63;
+  while (!(us >> exponent)) {
+    exponent--;
+  }
+#endif
+
+  // The bits just below it select the sub-bucket.
+  int sub = (int)(us >> (exponent - c_subBucketBits)) & (SUB_BUCKETS - 1);
+  int index = NUM_EXACT + (exponent - c_exactBits) * SUB_BUCKETS + sub;
+  return index < NUM_BUCKETS? index : NUM_BUCKETS-1;
+}
+
+
+/*static*/ std::uint64_t LatencyHistogram::bucketMaxUS(int index)
+{
+  if (index < NUM_EXACT) {
+    return index;
+  }
+
+  int exponent = (index - NUM_EXACT) / SUB_BUCKETS + c_exactBits;
+  int sub = (index - NUM_EXACT) % SUB_BUCKETS;
+  int shift = exponent - c_subBucketBits;
+  return ((std::uint64_t)(SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+
+std::uint64_t LatencyHistogram::percentileUS(double p) const
+{
+  if (m_count == 0) {
+    return 0;
+  }
+
+  // Number of values that must be at or below the answer.
+  std::uint64_t rank = (std::uint64_t)std::ceil(p * m_count);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  std::uint64_t seen = 0;
+  for (int i=0; i < NUM_BUCKETS; ++i) {
+    seen += m_counts[i];
+    if (seen >= rank) {
+      // The bucket's upper end can exceed anything actually seen.
+      std::uint64_t us = bucketMaxUS(i);
+      return us < m_maxUS? us : m_maxUS;
+    }
+  }
+  return m_maxUS;
+}
+
+
+double LatencyHistogram::meanUS() const
+{
+  return m_count? (double)m_sumUS / m_count : 0;
+}
+
+
+std::string LatencyHistogram::summary() const
+{
+  char buf[80];
+  std::snprintf(buf, sizeof(buf), c_summaryFormat,
+    percentileUS(0.50) / 1e3,
+    percentileUS(0.99) / 1e3,
+    m_maxUS / 1e3);
+  return buf;
+}
+
+
+void LatencyHistogram::appendSummary(std::wstring &out) const
+{
+  appendFormat(out, c_summaryFormat,
+    percentileUS(0.50) / 1e3,
+    percentileUS(0.99) / 1e3,
+    m_maxUS / 1e3);
+}
+
+
+// EOF
@@ -0,0 +1,77 @@
+// latency-histogram.h
+// `LatencyHistogram`, a fixed-size histogram of durations.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>                     // std::uint64_t
+#include <string>                      // std::{string, wstring}
+
+
+// Counts durations in microseconds, in buckets whose width is at most
+// 1/32 of their value, so percentiles are accurate to about 3% over
+// the whole range while the storage stays constant, however many
+// values are added.
+//
+// Values below 64 us get a bucket each.  Above that, each power of two
+// is divided into 32 equal buckets.
+class LatencyHistogram {
+public:      // types
+  enum {
+    // Values below this have their own bucket.
+    NUM_EXACT = 64,
+
+    // Buckets per power of two above that.
+    SUB_BUCKETS = 32,
+
+    // Powers of two from 2^6 to 2^31.  Larger values go in the last
+    // bucket.
+    NUM_BUCKETS = NUM_EXACT + 26 * SUB_BUCKETS,
+  };
+
+private:     // data
+  std::uint64_t m_counts[NUM_BUCKETS];
+
+public:      // data
+  // Number of values added.
+  std::uint64_t m_count;
+
+  // Largest value added, or 0 if none.
+  std::uint64_t m_maxUS;
+
+  // Sum of the values added.
+  std::uint64_t m_sumUS;
+
+public:      // methods
+  LatencyHistogram();
+
+  // Forget all values.
+  void clear();
+
+  // Add one duration.
+  void add(std::uint64_t us);
+
+  // Return the smallest value that is at least as large as fraction
+  // `p` (between 0 and 1) of the values added, to within the bucket
+  // width, or 0 if there are none.
+  std::uint64_t percentileUS(double p) const;
+
+  // Average value, or 0 if there are none.
+  double meanUS() const;
+
+  // Describe as milliseconds, like "p50 8.1 p99 16.3 max 17.0 ms".
+  std::string summary() const;
+
+  // Append the same to `out`, which does not allocate if it already
+  // has the capacity.
+  void appendSummary(std::wstring &out) const;
+
+  // Map a value to its bucket and back to the largest value in it.
+  static int bucketIndex(std::uint64_t us);
+  static std::uint64_t bucketMaxUS(int index);
+};
+
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,724 @@
+// raster-canvas.cc
+// Code for `raster-canvas` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "raster-canvas.h"             // this module
+
+#include "bitmap-font.h"               // bitmapFontGlyph
+
+#include <algorithm>                   // std::{min, max, fill, copy}
+#include <cassert>                     // assert
+#include <cmath>                       // std::{sqrt, abs, floor}, HUGE_VAL
+
+
+// Clamp `x` to [0,1].
+static float clamp01(float x)
+{
+  return x < 0? 0 : x > 1? 1 : x;
+}
+
+
+static float dot(Point2F a, Point2F b)
+{
+  return a.m_x*b.m_x + a.m_y*b.m_y;
+}
+
+
+static Point2F sub(Point2F a, Point2F b)
+{
+  return Point2F(a.m_x - b.m_x, a.m_y - b.m_y);
+}
+
+
+// Distance, in pixels, by which the ranges given to `fillBox` are
+// widened (`outer`) or narrowed (`inner`) beyond what the coverage
+// functions imply.  The ranges are computed exactly, in double
+// precision, but the coverage in single precision, and this keeps
+// rounding in the latter from ever mattering: the pixels that are set
+// or skipped without calling `coverageAt` are exactly those for which
+// it would return 1 or 0.
+static double const c_spanMargin = 0.05;
+
+
+// A range [m_lo,m_hi] of pixel center X coordinates on one row.
+class CenterRange {
+public:      // data
+  double m_lo;
+  double m_hi;
+
+public:      // methods
+  // Everything.
+  CenterRange()
+    : m_lo(-HUGE_VAL),
+      m_hi(HUGE_VAL)
+  {}
+
+  void clear()
+  {
+    m_lo = 1;
+    m_hi = 0;
+  }
+
+  // Intersect with the X values where `a*x + b <= 0`.
+  void clipLinear(double a, double b);
+
+  // Intersect with the X values where `a*x*x + b*x + c <= 0`, where
+  // `a` is positive.
+  void clipQuadratic(double a, double b, double c);
+
+  // Set [x0,x1) to the columns of pixels whose centers might be in
+  // the range, within [lo,hi).
+  void outerColumns(int lo, int hi, int &x0, int &x1) const;
+
+  // Set [x0,x1) to the columns of pixels whose centers are certainly
+  // in the range, within [lo,hi).
+  void innerColumns(int lo, int hi, int &x0, int &x1) const;
+};
+
+
+void CenterRange::clipLinear(double a, double b)
+{
+  if (a > 0) {
+    m_hi = std::min(m_hi, -b / a);
+  }
+  else if (a < 0) {
+    m_lo = std::max(m_lo, -b / a);
+  }
+  else if (b > 0) {
+    clear();
+  }
+}
+
+
+void CenterRange::clipQuadratic(double a, double b, double c)
+{
+  double disc = b*b - 4*a*c;
+  if (disc < 0) {
+    clear();
+    return;
+  }
+  double r = std::sqrt(disc);
+  m_lo = std::max(m_lo, (-b - r) / (2*a));
+  m_hi = std::min(m_hi, (-b + r) / (2*a));
+}
+
+
+void CenterRange::outerColumns(int lo, int hi, int &x0, int &x1) const
+{
+  // Pixel x has its center at x+0.5.  Clamping first keeps the
+  // conversions in range.
+  x0 = (int)std::floor(std::max(m_lo - 0.5, (double)lo));
+  x1 = (int)std::ceil(std::min(m_hi - 0.5, (double)hi)) + 1;
+  x0 = std::max(x0, lo);
+  x1 = std::min(x1, hi);
+}
+
+
+void CenterRange::innerColumns(int lo, int hi, int &x0, int &x1) const
+{
+  x0 = (int)std::ceil(std::max(m_lo - 0.5, (double)lo));
+  x1 = (int)std::floor(std::min(m_hi - 0.5, (double)hi)) + 1;
+  x0 = std::max(x0, lo);
+  x1 = std::min(x1, hi);
+}
+
+
+// ----------------------------- RasterSpan ----------------------------
+void RasterSpan::include(int left, int right)
+{
+  if (left >= right) {
+    return;
+  }
+  if (empty()) {
+    m_left = left;
+    m_right = right;
+  }
+  else {
+    m_left = std::min(m_left, left);
+    m_right = std::max(m_right, right);
+  }
+}
+
+
+// -------------------------- RasterDirtyRows --------------------------
+void RasterDirtyRows::reset(int height)
+{
+  m_rows.assign(height, RasterSpan());
+}
+
+
+void RasterDirtyRows::mark(int x0, int y0, int x1, int y1)
+{
+  assert(0 <= y0 && y1 <= (int)m_rows.size());
+  for (int y=y0; y < y1; ++y) {
+    m_rows[y].include(x0, x1);
+  }
+}
+
+
+// ---------------------------- RasterImage ----------------------------
+RasterImage::RasterImage()
+  : m_width(0),
+    m_height(0),
+    m_pixels()
+{}
+
+
+RasterImage::RasterImage(int width, int height)
+  : RasterImage()
+{
+  resize(width, height);
+}
+
+
+void RasterImage::resize(int width, int height)
+{
+  assert(width >= 0 && height >= 0);
+  m_width = width;
+  m_height = height;
+  m_pixels.resize((std::size_t)width * height);
+}
+
+
+void RasterImage::clear(RasterPixel p)
+{
+  std::fill(m_pixels.begin(), m_pixels.end(), p);
+}
+
+
+void RasterImage::copyFrom(RasterImage const &src)
+{
+  assert(src.m_width == m_width && src.m_height == m_height);
+  std::copy(src.m_pixels.begin(), src.m_pixels.end(), m_pixels.begin());
+}
+
+
+void RasterImage::copySpansFrom(
+  RasterImage const &src, RasterDirtyRows const &rows)
+{
+  assert(src.m_width == m_width && src.m_height == m_height);
+  assert((int)rows.m_rows.size() == m_height);
+
+  for (int y=0; y < m_height; ++y) {
+    RasterSpan const &span = rows.m_rows[y];
+    if (!span.empty()) {
+      std::copy(src.row(y) + span.m_left, src.row(y) + span.m_right,
+                row(y) + span.m_left);
+    }
+  }
+}
+
+
+void RasterImage::compositeOver(RasterImage const &src)
+{
+  assert(src.m_width == m_width && src.m_height == m_height);
+
+  RasterPixel *d = m_pixels.data();
+  RasterPixel const *s = src.m_pixels.data();
+  std::size_t n = m_pixels.size();
+
+  for (std::size_t i=0; i < n; ++i) {
+    RasterPixel sp = s[i];
+    int sa = rasterPixelA(sp);
+    if (sa == 0) {
+      // Common case: nothing drawn here.
+      continue;
+    }
+    if (sa == 0xFF) {
+      d[i] = sp;
+      continue;
+    }
+
+    // out = src + dst * (1 - srcAlpha), per channel.
+    int inv = 255 - sa;
+    RasterPixel dp = d[i];
+    RasterPixel out = 0;
+    for (int shift=0; shift < 32; shift += 8) {
+      int sc = (sp >> shift) & 0xFF;
+      int dc = (dp >> shift) & 0xFF;
+      int oc = sc + (dc * inv + 127) / 255;
+      out |= (RasterPixel)std::min(oc, 255) << shift;
+    }
+    d[i] = out;
+  }
+}
+
+
+// --------------------------- RasterCanvas ----------------------------
+RasterCanvas::RasterCanvas(RasterImage *image)
+  : Canvas(),
+    m_image(image),
+    m_transform(),
+    m_palette{},
+    m_textColor(rasterPixelRGB(255, 255, 255)),
+    m_textScale(2),
+    m_dirtyRows(nullptr)
+{
+  for (RasterPixel &p : m_palette) {
+    p = rasterPixelRGB(255, 255, 255);
+  }
+}
+
+
+void RasterCanvas::setTextSizeDIPs(float sizeDIPs)
+{
+  // The glyph cell is 9 font pixels tall, which is about the same as
+  // the line height of a typical font at 8 DIPs.
+  m_textScale = std::max(1, (int)(sizeDIPs / 8.0f + 0.5f));
+}
+
+
+void RasterCanvas::blendPixel(int x, int y, RasterPixel color,
+                              float coverage)
+{
+  RasterPixel &dst = m_image->row(y)[x];
+
+  // Coverage as a fraction of 256.
+  int a = (int)(coverage * 256.0f + 0.5f);
+  if (a >= 256) {
+    dst = color;
+    return;
+  }
+  if (a <= 0) {
+    return;
+  }
+
+  // `color` is opaque, so its premultiplied form is itself, and "over"
+  // reduces to a linear interpolation on every channel, alpha included:
+  // `(sc*a + dc*(256-a)) >> 8`.  Each such sum fits in 16 bits, so this
+  // does red and blue, then green and alpha, two at a time.
+  std::uint32_t const lo = 0x00FF00FF;
+  std::uint32_t rb = ((color & lo) * a + (dst & lo) * (256-a)) >> 8;
+  std::uint32_t ga = ((color >> 8) & lo) * a + ((dst >> 8) & lo) * (256-a);
+  dst = (rb & lo) | (ga & ~lo);
+}
+
+
+template <class S, class F>
+void RasterCanvas::fillBox(float left, float top, float right, float bottom,
+                           RasterPixel color, bool innerCovered,
+                           S const &rowSpans, F const &coverageAt)
+{
+  if (!m_image) {
+    return;
+  }
+
+  // Pixel (x,y) has its center at (x+0.5, y+0.5).
+  int x0 = std::max(0, (int)std::floor(left));
+  int y0 = std::max(0, (int)std::floor(top));
+  int x1 = std::min(m_image->m_width,  (int)std::ceil(right));
+  int y1 = std::min(m_image->m_height, (int)std::ceil(bottom));
+
+  for (int y=y0; y < y1; ++y) {
+    float py = y + 0.5f;
+    CenterRange outer, inner;
+    rowSpans(py, outer, inner);
+
+    int ox0, ox1;
+    outer.outerColumns(x0, x1, ox0, ox1);
+    if (ox0 >= ox1) {
+      continue;
+    }
+    markDirty(ox0, y, ox1, y+1);
+
+    int ix0, ix1;
+    inner.innerColumns(ox0, ox1, ix0, ix1);
+    if (ix0 >= ix1) {
+      ix0 = ix1 = ox1;
+    }
+
+    for (int x=ox0; x < ix0; ++x) {
+      float coverage = coverageAt(x + 0.5f, py);
+      if (coverage > 0) {
+        blendPixel(x, y, color, coverage);
+      }
+    }
+    if (innerCovered) {
+      std::fill(m_image->row(y) + ix0, m_image->row(y) + ix1, color);
+    }
+    for (int x=ix1; x < ox1; ++x) {
+      float coverage = coverageAt(x + 0.5f, py);
+      if (coverage > 0) {
+        blendPixel(x, y, color, coverage);
+      }
+    }
+  }
+}
+
+
+void RasterCanvas::setTransform(Matrix3x2 const &transform)
+{
+  m_transform = transform;
+}
+
+
+void RasterCanvas::rasterEllipse(Point2F center, float rx, float ry,
+                                 GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (color == GVCR_NONE) {
+    return;
+  }
+
+  // Map the ellipse into pixel space as a center and two axis vectors.
+  // A pixel point is `c + u*a + v*b`, and the ellipse is `u^2+v^2 = 1`.
+  Point2F c = m_transform.transformPoint(center);
+  Point2F a = m_transform.transformVector(Point2F(rx, 0));
+  Point2F b = m_transform.transformVector(Point2F(0, ry));
+
+  // Inverse of the matrix with rows `a` and `b`, for getting (u,v).
+  Matrix3x2 axes(a.m_x, a.m_y, b.m_x, b.m_y, 0, 0);
+  if (axes.determinant() == 0) {
+    return;
+  }
+  Matrix3x2 inv = axes.inverse();
+
+  float halfWidth = strokeWidth < 0? 0 : strokeWidth / 2.0f;
+  float pad = halfWidth + 1;
+  float extentX = std::abs(a.m_x) + std::abs(b.m_x) + pad;
+  float extentY = std::abs(a.m_y) + std::abs(b.m_y) + pad;
+
+  // Distance from the center to the edge along the shorter axis, used
+  // when a pixel center coincides with the ellipse center.
+  float minAxis = std::min(std::sqrt(dot(a,a)), std::sqrt(dot(b,b)));
+
+  // The gradient of `rho` below has length at most `n`, the largest
+  // singular value of `inv`, so the approximate signed distance `sd`
+  // is at least `(rho-1)/n` outside and at most that inside.  Hence
+  // coverage is 0 where `rho` exceeds `1 + (halfWidth+0.5)*n`, and
+  // where it is below `1 - (halfWidth+0.5)*n` for a stroke, while for a
+  // fill it is 1 below `1 - 0.5*n`.
+  double i11 = inv.m_11, i12 = inv.m_12, i21 = inv.m_21, i22 = inv.m_22;
+  double sumSq = i11*i11 + i12*i12 + i21*i21 + i22*i22;
+  double det = i11*i22 - i12*i21;
+  double n = std::sqrt(
+    (sumSq + std::sqrt(std::max(0.0, sumSq*sumSq - 4*det*det))) / 2);
+  double outerRho = 1 + (halfWidth + 0.5 + c_spanMargin) * n;
+  double innerRho = strokeWidth < 0?
+    1 - (0.5 + c_spanMargin) * n :
+    1 - (halfWidth + 0.5 + c_spanMargin) * n;
+
+  // `rho^2` as a quadratic in the pixel X coordinate on a row.
+  double cx = c.m_x;
+  double qa = i11*i11 + i12*i12;
+  auto clipRho = [&](CenterRange &range, double dy, double rhoLimit) {
+    if (rhoLimit <= 0) {
+      range.clear();
+      return;
+    }
+    double du = dy*i21, dv = dy*i22;
+    double qb = 2*(i11*du + i12*dv);
+    double qc = du*du + dv*dv - rhoLimit*rhoLimit;
+    range.clipQuadratic(qa, qb - 2*qa*cx, qa*cx*cx - qb*cx + qc);
+  };
+
+  fillBox(c.m_x - extentX, c.m_y - extentY,
+          c.m_x + extentX, c.m_y + extentY,
+          m_palette[color], strokeWidth < 0 /*innerCovered*/,
+    [&](float py, CenterRange &outer, CenterRange &inner) {
+      double dy = (double)py - c.m_y;
+      clipRho(outer, dy, outerRho);
+      clipRho(inner, dy, innerRho);
+    },
+    [&](float px, float py) -> float {
+      Point2F d(px - c.m_x, py - c.m_y);
+      float u = d.m_x*inv.m_11 + d.m_y*inv.m_21;
+      float v = d.m_x*inv.m_12 + d.m_y*inv.m_22;
+      float rho = std::sqrt(u*u + v*v);
+
+      // Signed distance to the edge, positive outside, approximated to
+      // first order as the value of `rho-1` over its gradient.
+      float sd;
+      if (rho < 1e-6f) {
+        sd = -minAxis;
+      }
+      else {
+        float gx = (u*inv.m_11 + v*inv.m_12) / rho;
+        float gy = (u*inv.m_21 + v*inv.m_22) / rho;
+        sd = (rho - 1) / std::sqrt(gx*gx + gy*gy);
+      }
+
+      if (strokeWidth < 0) {
+        return clamp01(0.5f - sd);
+      }
+      else {
+        return clamp01(halfWidth + 0.5f - std::abs(sd));
+      }
+    });
+}
+
+
+void RasterCanvas::drawEllipse(Point2F center, float rx, float ry,
+                               GVColorRole color, float strokeWidth)
+{
+  rasterEllipse(center, rx, ry, color, strokeWidth);
+}
+
+
+void RasterCanvas::fillEllipse(Point2F center, float rx, float ry,
+                               GVColorRole color)
+{
+  rasterEllipse(center, rx, ry, color, -1 /*fill*/);
+}
+
+
+void RasterCanvas::rasterRectangle(RectF const &rect,
+                                   GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (color == GVCR_NONE) {
+    return;
+  }
+
+  // Corners in pixel space, going around the rectangle.
+  Point2F p[4] = {
+    m_transform.transformPoint(Point2F(rect.m_left,  rect.m_top)),
+    m_transform.transformPoint(Point2F(rect.m_right, rect.m_top)),
+    m_transform.transformPoint(Point2F(rect.m_right, rect.m_bottom)),
+    m_transform.transformPoint(Point2F(rect.m_left,  rect.m_bottom)),
+  };
+
+  // Twice the signed area, which tells us the winding direction.
+  float area2 = 0;
+  for (int i=0; i < 4; ++i) {
+    Point2F const &p1 = p[i];
+    Point2F const &p2 = p[(i+1) % 4];
+    area2 += p1.m_x*p2.m_y - p2.m_x*p1.m_y;
+  }
+  if (strokeWidth < 0 && std::abs(area2) < 1e-6f) {
+    // Filling an empty rectangle draws nothing.
+    return;
+  }
+  float orient = area2 < 0? -1 : 1;
+
+  // Outward unit normal of each edge.  A degenerate edge gets a zero
+  // normal, which means it does not constrain the shape.
+  Point2F normal[4];
+  for (int i=0; i < 4; ++i) {
+    Point2F e = sub(p[(i+1) % 4], p[i]);
+    float len = std::sqrt(dot(e,e));
+    if (len > 0) {
+      normal[i] = Point2F(orient * e.m_y / len, -orient * e.m_x / len);
+    }
+  }
+
+  float halfWidth = strokeWidth < 0? 0 : strokeWidth / 2.0f;
+  float pad = halfWidth + 1;
+  float left   = std::min({p[0].m_x, p[1].m_x, p[2].m_x, p[3].m_x}) - pad;
+  float right  = std::max({p[0].m_x, p[1].m_x, p[2].m_x, p[3].m_x}) + pad;
+  float top    = std::min({p[0].m_y, p[1].m_y, p[2].m_y, p[3].m_y}) - pad;
+  float bottom = std::max({p[0].m_y, p[1].m_y, p[2].m_y, p[3].m_y}) + pad;
+
+  // The coverage is 0 wherever the distance to some edge line is at
+  // least `halfWidth+0.5`, or for a stroke, where the distances to all
+  // are at most `-(halfWidth+0.5)`.  For a fill, it is 1 where they are
+  // all at most -0.5.
+  double outerDist = halfWidth + 0.5 + c_spanMargin;
+  double innerDist = strokeWidth < 0?
+    0.5 + c_spanMargin :
+    halfWidth + 0.5 + c_spanMargin;
+
+  fillBox(left, top, right, bottom, m_palette[color],
+          strokeWidth < 0 /*innerCovered*/,
+    [&](float py, CenterRange &outer, CenterRange &inner) {
+      bool anyEdge = false;
+      for (int i=0; i < 4; ++i) {
+        double nx = normal[i].m_x, ny = normal[i].m_y;
+        if (nx != 0 || ny != 0) {
+          // Distance to edge `i` is `nx*px + base`.
+          double base = ((double)py - p[i].m_y) * ny - p[i].m_x * nx;
+          outer.clipLinear(nx, base - outerDist);
+          inner.clipLinear(nx, base + innerDist);
+          anyEdge = true;
+        }
+      }
+      if (!anyEdge) {
+        // Without edges, `sd` is hugely negative, so a stroke
+        // covers nothing.
+        outer.clear();
+      }
+    },
+    [&](float px, float py) -> float {
+      // For a convex polygon, the largest signed distance to any edge
+      // line is the signed distance to the shape, except near outside
+      // corners, where it yields the square corner of a miter join.
+      Point2F q(px, py);
+      float sd = -1e30f;
+      for (int i=0; i < 4; ++i) {
+        if (normal[i].m_x != 0 || normal[i].m_y != 0) {
+          sd = std::max(sd, dot(sub(q, p[i]), normal[i]));
+        }
+      }
+
+      if (strokeWidth < 0) {
+        return clamp01(0.5f - sd);
+      }
+      else {
+        return clamp01(halfWidth + 0.5f - std::abs(sd));
+      }
+    });
+}
+
+
+void RasterCanvas::drawRectangle(RectF const &rect,
+                                 GVColorRole color, float strokeWidth)
+{
+  rasterRectangle(rect, color, strokeWidth);
+}
+
+
+void RasterCanvas::fillRectangle(RectF const &rect, GVColorRole color)
+{
+  rasterRectangle(rect, color, -1 /*fill*/);
+}
+
+
+void RasterCanvas::drawLine(Point2F p1, Point2F p2,
+                            GVColorRole color, float strokeWidth)
+{
+  ++m_primitiveCount;
+  if (color == GVCR_NONE) {
+    return;
+  }
+
+  Point2F a = m_transform.transformPoint(p1);
+  Point2F b = m_transform.transformPoint(p2);
+  Point2F d = sub(b, a);
+  float len = std::sqrt(dot(d,d));
+  if (len == 0) {
+    // With flat caps, a zero-length line covers nothing.
+    return;
+  }
+
+  // Unit vectors along and across the line.
+  Point2F along(d.m_x / len, d.m_y / len);
+  Point2F across(-along.m_y, along.m_x);
+
+  float halfWidth = strokeWidth / 2.0f;
+  float pad = halfWidth + 1;
+
+  // The coverage is nonzero within `halfWidth+0.5` across the line and
+  // 0.5 beyond its ends, and 1 within `halfWidth-0.5` across and at
+  // least 0.5 inside the ends.
+  double outerAcross = halfWidth + 0.5 + c_spanMargin;
+  double innerAcross = halfWidth - 0.5 - c_spanMargin;
+  double outerAlong = 0.5 + c_spanMargin;
+  double innerAlong = 0.5 + c_spanMargin;
+
+  fillBox(std::min(a.m_x, b.m_x) - pad, std::min(a.m_y, b.m_y) - pad,
+          std::max(a.m_x, b.m_x) + pad, std::max(a.m_y, b.m_y) + pad,
+          m_palette[color], true /*innerCovered*/,
+    [&](float py, CenterRange &outer, CenterRange &inner) {
+      // The signed distances across and along are `across.m_x*px +
+      // acrossBase` and `along.m_x*px + alongBase`.
+      double dy = (double)py - a.m_y;
+      double acrossBase = dy*across.m_y - (double)a.m_x*across.m_x;
+      double alongBase = dy*along.m_y - (double)a.m_x*along.m_x;
+
+      outer.clipLinear(across.m_x, acrossBase - outerAcross);
+      outer.clipLinear(-across.m_x, -acrossBase - outerAcross);
+      outer.clipLinear(-along.m_x, -alongBase - outerAlong);
+      outer.clipLinear(along.m_x, alongBase - len - outerAlong);
+
+      if (innerAcross <= 0) {
+        inner.clear();
+        return;
+      }
+      inner.clipLinear(across.m_x, acrossBase - innerAcross);
+      inner.clipLinear(-across.m_x, -acrossBase - innerAcross);
+      inner.clipLinear(-along.m_x, -alongBase + innerAlong);
+      inner.clipLinear(along.m_x, alongBase - len + innerAlong);
+    },
+    [&](float px, float py) -> float {
+      Point2F q = sub(Point2F(px, py), a);
+      float t = dot(q, along);
+      float s = std::abs(dot(q, across));
+      return clamp01(halfWidth + 0.5f - s) *
+             clamp01(std::min(t, len - t) + 0.5f);
+    });
+}
+
+
+RectF RasterCanvas::measureText(std::wstring const &str,
+                                RectF const &layoutRect)
+{
+  // Count lines and the longest line.
+  int lines = 1;
+  int cols = 0;
+  int maxCols = 0;
+  for (wchar_t c : str) {
+    if (c == L'\n') {
+      ++lines;
+      cols = 0;
+    }
+    else {
+      maxCols = std::max(maxCols, ++cols);
+    }
+  }
+
+  if (!str.empty() && str.back() == L'\n') {
+    // Like DirectWrite, do not count an empty final line.
+    --lines;
+  }
+
+  // Omit the spacing column after the last character.
+  int width = maxCols == 0? 0 :
+    (maxCols * c_bitmapFontCellWidth - 1) * m_textScale;
+  int height = lines * c_bitmapFontCellHeight * m_textScale;
+
+  return RectF(layoutRect.m_left,         layoutRect.m_top,
+               layoutRect.m_left + width, layoutRect.m_top + height);
+}
+
+
+void RasterCanvas::drawText(std::wstring const &str,
+                            RectF const &layoutRect)
+{
+  ++m_primitiveCount;
+  if (!m_image) {
+    return;
+  }
+
+  int const s = m_textScale;
+  int x = (int)layoutRect.m_left;
+  int y = (int)layoutRect.m_top;
+
+  for (wchar_t c : str) {
+    if (c == L'\n') {
+      x = (int)layoutRect.m_left;
+      y += c_bitmapFontCellHeight * s;
+      continue;
+    }
+
+    std::uint8_t const *glyph = bitmapFontGlyph(c);
+    for (int gy=0; gy < c_bitmapFontGlyphHeight; ++gy) {
+      // One font pixel of space above the glyph.
+      int top = y + (gy+1) * s;
+
+      for (int gx=0; gx < c_bitmapFontGlyphWidth; ++gx) {
+        if (!( glyph[gy] & (0x10 >> gx) )) {
+          continue;
+        }
+
+        int left = x + gx*s;
+        int py0 = std::max(top, 0);
+        int py1 = std::min(top + s, m_image->m_height);
+        int px0 = std::max(left, 0);
+        int px1 = std::min(left + s, m_image->m_width);
+        markDirty(px0, py0, px1, py1);
+
+        for (int py = py0; py < py1; ++py) {
+          for (int px = px0; px < px1; ++px) {
+            m_image->row(py)[px] = m_textColor;
+          }
+        }
+      }
+    }
+
+    x += c_bitmapFontCellWidth * s;
+  }
+}
+
+
+// EOF
@@ -0,0 +1,213 @@
+// raster-canvas.h
+// `RasterImage` and `RasterCanvas`, a CPU implementation of `Canvas`.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef RASTER_CANVAS_H
+#define RASTER_CANVAS_H
+
+#include "canvas.h"                    // Canvas
+#include "geometry.h"                  // Matrix3x2
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::uint32_t
+#include <vector>                      // std::vector
+
+
+// One pixel.  The red component is in the low byte, then green, blue,
+// and alpha in the high byte.  Color components are premultiplied by
+// alpha.  For an opaque color, the low 24 bits have the same layout as
+// a Windows `COLORREF`, and in memory the bytes are in RGBA order on a
+// little-endian machine.
+typedef std::uint32_t RasterPixel;
+
+
+// Make an opaque pixel.
+inline RasterPixel rasterPixelRGB(int r, int g, int b)
+{
+  return (RasterPixel)r |
+         ((RasterPixel)g << 8) |
+         ((RasterPixel)b << 16) |
+         ((RasterPixel)0xFF << 24);
+}
+
+inline int rasterPixelR(RasterPixel p) { return p & 0xFF; }
+inline int rasterPixelG(RasterPixel p) { return (p >> 8) & 0xFF; }
+inline int rasterPixelB(RasterPixel p) { return (p >> 16) & 0xFF; }
+inline int rasterPixelA(RasterPixel p) { return (p >> 24) & 0xFF; }
+
+
+// Horizontal extent of the changed pixels in one row: [m_left,m_right).
+class RasterSpan {
+public:      // data
+  int m_left;
+  int m_right;
+
+public:      // methods
+  // Empty.
+  RasterSpan()
+    : m_left(0),
+      m_right(0)
+  {}
+
+  bool empty() const { return m_left >= m_right; }
+
+  // Grow to include [left,right).
+  void include(int left, int right);
+
+  // Grow to include `obj`.
+  void include(RasterSpan const &obj)
+    { include(obj.m_left, obj.m_right); }
+};
+
+
+// Which pixels of an image have been changed, conservatively, as one
+// span per row.
+class RasterDirtyRows {
+public:      // data
+  // One span per row of the image.
+  std::vector<RasterSpan> m_rows;
+
+public:      // methods
+  // Make every one of `height` rows empty.
+  void reset(int height);
+
+  // Record a change to the box [x0,x1) x [y0,y1), which must already be
+  // clipped to the image.
+  void mark(int x0, int y0, int x1, int y1);
+};
+
+
+// A rectangular array of pixels in memory, stored row by row from the
+// top.
+class RasterImage {
+public:      // data
+  // Dimensions in pixels.
+  int m_width;
+  int m_height;
+
+  // `m_width * m_height` pixels.
+  std::vector<RasterPixel> m_pixels;
+
+public:      // methods
+  // Initially 0x0.
+  RasterImage();
+
+  RasterImage(int width, int height);
+
+  // Change the size.  The contents are then unspecified.
+  void resize(int width, int height);
+
+  // Set every pixel to `p`.
+  void clear(RasterPixel p);
+
+  // Make this image a copy of `src`, which must have the same size.
+  void copyFrom(RasterImage const &src);
+
+  // Copy just the pixels in `rows` from `src`, which must have the
+  // same size.
+  void copySpansFrom(RasterImage const &src, RasterDirtyRows const &rows);
+
+  // Composite `src`, which must have the same size, over this image
+  // using the premultiplied "source over" operator.
+  void compositeOver(RasterImage const &src);
+
+  RasterPixel *row(int y)
+    { return m_pixels.data() + (std::size_t)y * m_width; }
+  RasterPixel const *row(int y) const
+    { return m_pixels.data() + (std::size_t)y * m_width; }
+};
+
+
+// Draws antialiased shapes into a `RasterImage`.
+//
+// Coverage is computed analytically from the distance between each
+// pixel center and the shape edge, measured in pixels after applying
+// the transform, so stroke widths stay fixed under scaling just as
+// with `D2D1_STROKE_TRANSFORM_TYPE_FIXED`.
+//
+class RasterCanvas : public Canvas {
+public:      // data
+  // Image being drawn on.  Not owned.  May be null, in which case the
+  // drawing methods do nothing.
+  RasterImage *m_image;
+
+  // Current transform.
+  Matrix3x2 m_transform;
+
+  // Color for each role.  `GVCR_NONE` is ignored.
+  RasterPixel m_palette[NUM_GV_COLOR_ROLES];
+
+  // Color used by `drawText`.
+  RasterPixel m_textColor;
+
+  // Size of one font pixel, in image pixels.
+  int m_textScale;
+
+  // If not null, every pixel this canvas changes is recorded here.
+  // Not owned.
+  RasterDirtyRows *m_dirtyRows;
+
+private:     // methods
+  // If tracking, record a change to [x0,x1) x [y0,y1).
+  void markDirty(int x0, int y0, int x1, int y1)
+  {
+    if (m_dirtyRows && x0 < x1 && y0 < y1) {
+      m_dirtyRows->mark(x0, y0, x1, y1);
+    }
+  }
+
+  // Blend `color` into the pixel at (x,y) with `coverage` in [0,1].
+  void blendPixel(int x, int y, RasterPixel color, float coverage);
+
+  // Call `coverageAt(px,py)`, where (px,py) is a pixel center, for
+  // pixels whose centers are in the given box, blending `color` with
+  // the returned coverage.
+  //
+  // First, `rowSpans(py, outer, inner)` sets two ranges of X
+  // coordinates on the row, and only pixels with centers in `outer`
+  // are considered, since the others have no coverage.  Those with
+  // centers in `inner` have coverage 1 if `innerCovered`, and 0
+  // otherwise, so they are set or skipped without calling
+  // `coverageAt`.
+  template <class S, class F>
+  void fillBox(float left, float top, float right, float bottom,
+               RasterPixel color, bool innerCovered,
+               S const &rowSpans, F const &coverageAt);
+
+  // Shared implementation of `drawEllipse` and `fillEllipse`.  If
+  // `strokeWidth` is negative, fill.
+  void rasterEllipse(Point2F center, float rx, float ry,
+                     GVColorRole color, float strokeWidth);
+
+  // Shared implementation of `drawRectangle` and `fillRectangle`.
+  void rasterRectangle(RectF const &rect,
+                       GVColorRole color, float strokeWidth);
+
+public:      // methods
+  // Draws on `image`, which may be null to defer choosing it.  The
+  // palette is initially all white.
+  explicit RasterCanvas(RasterImage *image);
+
+  // Set the font scale so the text is roughly `sizeDIPs` tall.
+  void setTextSizeDIPs(float sizeDIPs);
+
+  // Canvas methods.
+  virtual void setTransform(Matrix3x2 const &transform) override;
+  virtual void drawEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color, float strokeWidth) override;
+  virtual void fillEllipse(Point2F center, float rx, float ry,
+                           GVColorRole color) override;
+  virtual void drawRectangle(RectF const &rect,
+                             GVColorRole color, float strokeWidth) override;
+  virtual void fillRectangle(RectF const &rect, GVColorRole color) override;
+  virtual void drawLine(Point2F p1, Point2F p2,
+                        GVColorRole color, float strokeWidth) override;
+  virtual RectF measureText(std::wstring const &str,
+                            RectF const &layoutRect) override;
+  virtual void drawText(std::wstring const &str,
+                        RectF const &layoutRect) override;
+};
+
+
+#endif // RASTER_CANVAS_H
@@ -0,0 +1,66 @@
+// raster-painter-bench.cc
+// Benchmarks for `raster-painter` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "raster-painter.h"            // module under test
+
+#include "bench.h"                     // BENCHMARK, benchFrameModels, etc.
+
+#include <cstdio>                      // std::snprintf
+#include <vector>                      // std::vector
+
+
+// Frame time with and without the cached static layer (the outlines,
+// labels, and other elements that do not depend on the input), at the
+// default window size and at 1080p.
+BENCHMARK(staticLayerFrameTime)
+{
+  GPVConfig config;
+  std::vector<InputModel> models = benchFrameModels(&config, 256);
+
+  int const sizes[][2] = {
+    { config.m_windowWidth, config.m_windowHeight },
+    { 1920, 1080 },
+  };
+  for (auto const &size : sizes) {
+    struct Mode {
+      char const *m_name;
+      bool m_useStaticLayer;
+      bool m_trackDirtyRows;
+    };
+    Mode const modes[] = {
+      { "uncached",                   false, false },
+      { "cached layer",               true,  false },
+      { "cached layer, dirty rows",   true,  true  },
+    };
+    for (Mode const &mode : modes) {
+      RasterPainter painter(&config, &models[0]);
+      painter.m_useStaticLayer = mode.m_useStaticLayer;
+      painter.m_trackDirtyRows = mode.m_trackDirtyRows;
+      RasterImage frame(size[0], size[1]);
+
+      std::size_t i = 0;
+      double ns = benchTimeNS([&] {
+        painter.m_painter.m_inputModel = &models[i++ % models.size()];
+        painter.paint(frame);
+      });
+
+      // The count varies with the input, so report it for the same
+      // frame in each mode.
+      painter.m_painter.m_inputModel = &models[0];
+      painter.paint(frame);
+
+      char what[80];
+      std::snprintf(what, sizeof(what), "%dx%d %s",
+                    size[0], size[1], mode.m_name);
+      char note[80];
+      std::snprintf(note, sizeof(note), "per frame, %d primitives",
+                    painter.m_framePrimitiveCount);
+      benchReport(what, ns, note);
+    }
+  }
+}
+
+
+// EOF
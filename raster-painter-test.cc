@@ -0,0 +1,108 @@
+// raster-painter-test.cc
+// Tests for `raster-painter` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "raster-painter.h"            // module under test
+
+#include "alloc-audit.h"               // AllocAuditScope
+#include "input-recording.h"           // InputRecording{Reader,Writer}
+#include "synthetic-input.h"           // SyntheticInput
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <sstream>                     // std::{istringstream, ostringstream}
+#include <vector>                      // std::vector
+
+
+// The samples of a recording of `seconds` of `SyntheticInput`, polled
+// every 4 ms, as read back from the recording.
+static std::vector<ControllerState> syntheticRecording(int seconds)
+{
+  std::ostringstream oss;
+  {
+    InputRecordingWriter writer(oss);
+    writer.writeHeader(GPVConfig());
+    SyntheticInput synth;
+    for (DWORD t = 1000; t < 1000 + (DWORD)seconds * 1000; t += 4) {
+      ControllerState state;
+      synth.next(state, t);
+      writer.writeSample(state);
+    }
+    writer.writeFooter();
+    EXPECT(writer.ok());
+  }
+
+  std::istringstream iss(oss.str());
+  InputRecordingReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+  std::vector<ControllerState> samples;
+  while (int type = reader.readNext()) {
+    if (type == IRT_SAMPLE) {
+      samples.push_back(reader.m_state);
+    }
+  }
+  EXPECT_EQ(reader.m_error, "");
+  return samples;
+}
+
+
+// Once the first frame has sized its buffers, playing input through
+// the model and painter at 60 frames per second, as the viewer and
+// `gpv-export` do, allocates nothing, in each way of painting.
+//
+// `make test` builds the tests with the allocation counting on, so
+// this always checks something.
+UNIT_TEST(rasterPainterSteadyStateDoesNotAllocate)
+{
+  EXPECT(allocAuditCompiledIn());
+
+  GPVConfig config;
+  std::vector<ControllerState> samples = syntheticRecording(10);
+  EXPECT(!samples.empty());
+
+  struct Mode {
+    bool m_useStaticLayer;
+    bool m_trackDirtyRows;
+  };
+  Mode const modes[] = {
+    { false, false },
+    { true,  false },
+    { true,  true  },
+  };
+  for (Mode const &mode : modes) {
+    InputModel model(&config);
+    RasterPainter painter(&config, &model);
+    painter.m_useStaticLayer = mode.m_useStaticLayer;
+    painter.m_trackDirtyRows = mode.m_trackDirtyRows;
+    RasterImage frame(config.m_windowWidth, config.m_windowHeight);
+
+    long auditedFrames = 0;
+    std::uint64_t allocs = 0;
+    std::size_t next = 0;
+    DWORD const startMS = samples.front().m_pollTimeMS;
+    for (long f = 0; next < samples.size(); ++f) {
+      DWORD frameMS = startMS + (DWORD)(f * 1000 / 60);
+      long layerVersion = painter.m_staticLayerVersion;
+      AllocAuditScope audit;
+      while (next < samples.size() &&
+             samples[next].m_pollTimeMS <= frameMS) {
+        model.update(samples[next++]);
+      }
+      model.advanceTime(frameMS);
+      painter.paint(frame);
+
+      // As in `gpv-export`, redrawing the static layer is not part of
+      // the steady state.
+      if (f > 0 && layerVersion == painter.m_staticLayerVersion) {
+        auditedFrames++;
+        allocs += audit.count();
+      }
+    }
+
+    EXPECT(auditedFrames > 500);
+    EXPECT_EQ(allocs, (std::uint64_t)0);
+  }
+}
+
+
+// EOF
@@ -0,0 +1,114 @@
+// raster-painter.cc
+// Code for `raster-painter` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "raster-painter.h"            // this module
+
+#include "windows-compat.h"            // GetRValue, etc.
+
+
+// Convert an opaque `COLORREF` to a `RasterPixel`.
+static RasterPixel COLORREF_to_RasterPixel(COLORREF cr)
+{
+  return rasterPixelRGB(GetRValue(cr), GetGValue(cr), GetBValue(cr));
+}
+
+
+RasterPainter::RasterPainter(
+  GPVConfig const *config,
+  InputModel const *inputModel)
+  : m_painter(config, inputModel),
+    m_canvas(nullptr),
+    m_background(rasterPixelRGB(0,0,0)),
+    m_useStaticLayer(true),
+    m_staticLayer(),
+    m_staticLayerKey(),
+    m_staticLayerBackground(0),
+    m_staticLayerVersion(0),
+    m_trackDirtyRows(false),
+    m_dirtyRows(),
+    m_dirtyRowsLayerVersion(-1),
+    m_framePrimitiveCount(0),
+    m_staticLayerPrimitiveCount(0)
+{}
+
+
+void RasterPainter::prepareCanvas(RasterImage *image)
+{
+  GPVConfig const &config = *(m_painter.m_config);
+
+  m_canvas.m_image = image;
+  for (int i=0; i < NUM_GV_COLOR_ROLES; ++i) {
+    m_canvas.m_palette[i] = COLORREF_to_RasterPixel(
+      colorrefForColorRole(config, (GVColorRole)i));
+  }
+  m_canvas.m_textColor = COLORREF_to_RasterPixel(config.m_linesColorref);
+  m_canvas.setTextSizeDIPs(config.m_layoutParams.m_textFontSizeDIPs);
+  m_canvas.resetPrimitiveCount();
+  m_canvas.m_dirtyRows = nullptr;
+
+  m_painter.m_canvas = &m_canvas;
+}
+
+
+void RasterPainter::updateStaticLayer(int width, int height)
+{
+  StaticLayerKey key(width, height, *(m_painter.m_config));
+  if (key == m_staticLayerKey &&
+      m_background == m_staticLayerBackground) {
+    return;
+  }
+
+  m_staticLayer.resize(width, height);
+  m_staticLayer.clear(m_background);
+
+  prepareCanvas(&m_staticLayer);
+  m_painter.drawControllerState(PP_STATIC, Point2F(width, height));
+  m_staticLayerPrimitiveCount = m_canvas.m_primitiveCount;
+
+  m_staticLayerKey = key;
+  m_staticLayerBackground = m_background;
+  m_staticLayerVersion++;
+}
+
+
+void RasterPainter::paint(RasterImage &frame)
+{
+  Point2F size(frame.m_width, frame.m_height);
+
+  if (m_useStaticLayer) {
+    updateStaticLayer(frame.m_width, frame.m_height);
+
+    // The layer includes the background, so it replaces the clear.
+    if (m_trackDirtyRows &&
+        m_dirtyRowsLayerVersion == m_staticLayerVersion) {
+      frame.copySpansFrom(m_staticLayer, m_dirtyRows);
+    }
+    else {
+      frame.copyFrom(m_staticLayer);
+    }
+    prepareCanvas(&frame);
+    m_canvas.m_primitiveCount++;
+
+    if (m_trackDirtyRows) {
+      m_dirtyRows.reset(frame.m_height);
+      m_canvas.m_dirtyRows = &m_dirtyRows;
+      m_dirtyRowsLayerVersion = m_staticLayerVersion;
+    }
+
+    m_painter.drawControllerState(PP_DYNAMIC, size);
+  }
+  else {
+    m_dirtyRowsLayerVersion = -1;
+    frame.clear(m_background);
+    prepareCanvas(&frame);
+
+    m_painter.drawControllerState(PP_ALL, size);
+  }
+
+  m_framePrimitiveCount = m_canvas.m_primitiveCount;
+}
+
+
+// EOF
@@ -0,0 +1,93 @@
+// raster-painter.h
+// `RasterPainter`, which draws whole frames with the CPU rasterizer.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef RASTER_PAINTER_H
+#define RASTER_PAINTER_H
+
+#include "controller-painter.h"        // ControllerPainter, StaticLayerKey
+#include "gpv-config.h"                // GPVConfig
+#include "input-model.h"               // InputModel
+#include "raster-canvas.h"             // RasterCanvas, RasterImage, RasterPixel
+
+
+// Draws complete frames of the controller display into a
+// `RasterImage`, keeping a cached copy of the static layer.
+//
+// Each instance has its own layer and scratch state, so separate
+// threads can draw concurrently as long as each uses its own
+// `RasterPainter`.
+//
+class RasterPainter {
+public:      // data
+  // Draws the elements.  Clients can change what it points at between
+  // frames.
+  ControllerPainter m_painter;
+
+  // Canvas `m_painter` draws on.
+  RasterCanvas m_canvas;
+
+  // Color every frame starts with.  The default is opaque black, which
+  // the viewer treats as transparent.  A fully transparent background
+  // (0) is also fine.
+  RasterPixel m_background;
+
+  // If true, draw the static elements once into `m_staticLayer` and
+  // copy that at the start of each frame.
+  bool m_useStaticLayer;
+
+  // Static elements over `m_background`.
+  RasterImage m_staticLayer;
+
+  // What `m_staticLayer` was drawn for.
+  StaticLayerKey m_staticLayerKey;
+
+  // The background `m_staticLayer` was drawn over.
+  RasterPixel m_staticLayerBackground;
+
+  // Incremented each time `m_staticLayer` is redrawn.
+  long m_staticLayerVersion;
+
+  // If true, and the static layer is in use, record in `m_dirtyRows`
+  // which pixels of each frame differ from the static layer, and start
+  // each frame by restoring only those pixels of the previous one.
+  // That is much cheaper than copying the whole layer when little is
+  // moving, but requires that successive calls to `paint` pass the same
+  // image, same size, not modified in between.
+  bool m_trackDirtyRows;
+
+  // When `m_trackDirtyRows`, the pixels of the most recent frame that
+  // may differ from `m_staticLayer`.
+  RasterDirtyRows m_dirtyRows;
+
+  // Value of `m_staticLayerVersion` that `m_dirtyRows` is relative to,
+  // or -1 if it is not valid.
+  long m_dirtyRowsLayerVersion;
+
+  // Number of primitives drawn for the most recent frame, including
+  // one for copying the static layer if it was used.
+  int m_framePrimitiveCount;
+
+  // Number of primitives drawn into the static layer when it was last
+  // created.
+  int m_staticLayerPrimitiveCount;
+
+private:     // methods
+  // Point `m_canvas` at `image` and the current colors.
+  void prepareCanvas(RasterImage *image);
+
+  // If the static layer does not match the configuration and a
+  // `width` by `height` frame, redraw it.
+  void updateStaticLayer(int width, int height);
+
+public:      // methods
+  RasterPainter(GPVConfig const *config, InputModel const *inputModel);
+
+  // Draw the current input state into `frame`, whose existing size
+  // determines the drawing size.
+  void paint(RasterImage &frame);
+};
+
+
+#endif // RASTER_PAINTER_H
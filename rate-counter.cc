@@ -0,0 +1,71 @@
+// rate-counter.cc
+// Code for `rate-counter` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "rate-counter.h"              // this module
+
+
+// Length of a measurement window.
+static DWORD const c_windowMS = 1000;
+
+
+// ---------------------------- RateCounter ----------------------------
+RateCounter::RateCounter()
+  : m_started(false),
+    m_windowStartMS(0),
+    m_count(0),
+    m_rate(0),
+    m_total(0)
+{}
+
+
+void RateCounter::add(DWORD nowMS, long n)
+{
+  update(nowMS);
+  m_count += n;
+  m_total += n;
+}
+
+
+void RateCounter::update(DWORD nowMS)
+{
+  if (!m_started) {
+    m_started = true;
+    m_windowStartMS = nowMS;
+    return;
+  }
+
+  // Unsigned subtraction handles the tick count wrapping around.
+  DWORD elapsed = nowMS - m_windowStartMS;
+  if (elapsed >= c_windowMS) {
+    m_rate = m_count * 1000.0f / elapsed;
+    m_windowStartMS = nowMS;
+    m_count = 0;
+  }
+}
+
+
+// --------------------------- AverageCounter --------------------------
+AverageCounter::AverageCounter()
+  : m_rateCounter(),
+    m_sum(0),
+    m_average(0)
+{}
+
+
+void AverageCounter::add(DWORD nowMS, double value)
+{
+  long prevCount = m_rateCounter.m_count;
+  m_rateCounter.add(nowMS);
+
+  if (m_rateCounter.m_count == 1 && prevCount > 0) {
+    // `add` just started a new window; publish the old one.
+    m_average = m_sum / prevCount;
+    m_sum = 0;
+  }
+  m_sum += value;
+}
+
+
+// EOF
@@ -0,0 +1,67 @@
+// rate-counter.h
+// `RateCounter`, which measures how often an event happens, and
+// `AverageCounter`, which measures its average value.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef RATE_COUNTER_H
+#define RATE_COUNTER_H
+
+#include "windows-compat.h"            // DWORD
+
+
+// Counts events over successive windows of about a second and reports
+// the rate observed in the most recent complete window.
+class RateCounter {
+public:      // data
+  // False until the first call to `add` or `update`.
+  bool m_started;
+
+  // Time, in milliseconds, at which the current window started.
+  DWORD m_windowStartMS;
+
+  // Events so far in the current window.
+  long m_count;
+
+  // Events per second in the last complete window, or 0 if there has
+  // not been one yet.
+  float m_rate;
+
+  // Total events ever.
+  long m_total;
+
+public:      // methods
+  RateCounter();
+
+  // Record `n` events at `nowMS`.
+  void add(DWORD nowMS, long n = 1);
+
+  // Close the window if it has been long enough, without recording
+  // an event, so the rate drops to zero when events stop.
+  void update(DWORD nowMS);
+};
+
+
+// Averages a measured value over successive windows of about a second
+// and reports the average from the most recent complete window.
+class AverageCounter {
+public:      // data
+  // Counts the samples.
+  RateCounter m_rateCounter;
+
+  // Sum of the samples in the current window.
+  double m_sum;
+
+  // Average of the samples in the last complete window, or 0 if there
+  // has not been one yet.
+  double m_average;
+
+public:      // methods
+  AverageCounter();
+
+  // Record `value`, measured at `nowMS`.
+  void add(DWORD nowMS, double value);
+};
+
+
+#endif // RATE_COUNTER_H
@@ -0,0 +1,267 @@
+// replay-buffer-test.cc
+// Tests for `replay-buffer` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "replay-buffer.h"             // module under test
+
+#include "input-recording.h"           // readInputRecordingFile
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <atomic>                      // std::atomic
+#include <cstring>                     // std::memcmp
+#include <fstream>                     // std::fstream
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// Sample `n` of a sequence in which every field is derived from `n`,
+// so a sample mixing two of them can be recognized.
+static ControllerState sequenceSample(std::uint32_t n)
+{
+  ControllerState s;
+  XINPUT_GAMEPAD &g = s.m_inputState.Gamepad;
+  s.m_hasInputState = n % 3 != 0;
+  s.m_pollTimeMS = 1000 + n;
+  s.m_inputState.dwPacketNumber = n;
+  g.wButtons = (WORD)(n * 7);
+  g.bLeftTrigger = (BYTE)n;
+  g.bRightTrigger = (BYTE)(n >> 8);
+  g.sThumbLX = (SHORT)n;
+  g.sThumbLY = (SHORT)~n;
+  g.sThumbRX = (SHORT)(n * 3);
+  g.sThumbRY = (SHORT)-(int)n;
+  return s;
+}
+
+
+// True if `s` is sample `n` of `sequenceSample`, in every field a slot
+// holds.
+static bool isSequenceSample(ControllerState const &s, std::uint32_t n)
+{
+  std::uint32_t words[REPLAY_SLOT_WORDS], expect[REPLAY_SLOT_WORDS];
+  ReplayBuffer::encodeSlot(words, s);
+  ReplayBuffer::encodeSlot(expect, sequenceSample(n));
+  return std::memcmp(words, expect, sizeof(words)) == 0;
+}
+
+
+// Check that `samples` are consecutive samples of `sequenceSample`.
+// Return the number of the first, or -1 if there are none.
+static long checkSequence(std::vector<ControllerState> const &samples)
+{
+  if (samples.empty()) {
+    return -1;
+  }
+  std::uint32_t first = samples[0].m_inputState.dwPacketNumber;
+  for (std::size_t i=0; i < samples.size(); ++i) {
+    if (!isSequenceSample(samples[i], first + (std::uint32_t)i)) {
+      unitTestFail(__FILE__, __LINE__,
+                   "sample " + std::to_string(i) + " after " +
+                   std::to_string(first) + " is not intact");
+      break;
+    }
+  }
+  return first;
+}
+
+
+UNIT_TEST(replayBufferSlotRoundTrip)
+{
+  for (std::uint32_t n : { 0u, 1u, 0x7FFFu, 0x8000u, 0xFFFFu, 0x12345u,
+                           0xFFFFFFFFu }) {
+    std::uint32_t words[REPLAY_SLOT_WORDS];
+    ReplayBuffer::encodeSlot(words, sequenceSample(n));
+    ControllerState s;
+    ReplayBuffer::decodeSlot(s, words);
+    EXPECT(isSequenceSample(s, n));
+    EXPECT_EQ(s.m_inputState.Gamepad.sThumbLY, (SHORT)~n);
+    EXPECT_EQ(s.m_hasInputState, n % 3 != 0);
+  }
+}
+
+
+UNIT_TEST(replayBufferWraparound)
+{
+  std::string path = unitTestTempDir() + "/wrap.ring";
+  ReplayBuffer ring;
+  EXPECT_EQ(ring.open(path, 16, 0xFFFFFFFF), "");
+  EXPECT_EQ(ring.capacity(), (std::uint32_t)16);
+
+  std::vector<ControllerState> samples;
+  ring.readRecent(samples);
+  EXPECT(samples.empty());
+
+  // Less than a full ring.
+  for (std::uint32_t n=0; n < 10; ++n) {
+    ring.add(sequenceSample(n));
+  }
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)10);
+  EXPECT_EQ(checkSequence(samples), 0);
+
+  // A repeat, apart from its time, is not added.
+  ControllerState repeat = sequenceSample(9);
+  repeat.m_pollTimeMS += 5;
+  ring.add(repeat);
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)10);
+
+  // Around the ring three times, and a bit.
+  for (std::uint32_t n=10; n < 50; ++n) {
+    ring.add(sequenceSample(n));
+  }
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)50);
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)16);
+  EXPECT_EQ(checkSequence(samples), 34);
+
+  // Only the last `m_windowMS` are read.
+  ring.m_windowMS = 5;
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)6);
+  EXPECT_EQ(checkSequence(samples), 44);
+
+  // Nor any from before the time goes backward, as it would after a
+  // reboot.
+  ring.m_windowMS = 0xFFFFFFFF;
+  for (std::uint32_t n=0; n < 3; ++n) {
+    ring.add(sequenceSample(n));
+  }
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)3);
+  EXPECT_EQ(checkSequence(samples), 0);
+}
+
+
+// A thread adds samples as fast as it can, lapping the small ring many
+// times, while this one reads it and saves snapshots.  What is read
+// must be consecutive, intact samples.
+UNIT_TEST(replayBufferSnapshotWhileLapping)
+{
+  std::string path = unitTestTempDir() + "/lapped.ring";
+  ReplayBuffer ring;
+  EXPECT_EQ(ring.open(path, 64, 0xFFFFFFFF), "");
+
+  std::atomic<bool> stop(false);
+  std::atomic<std::uint32_t> added(0);
+  std::thread writer([&] {
+    for (std::uint32_t n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+      ring.add(sequenceSample(n));
+      added.store(n+1, std::memory_order_relaxed);
+    }
+  });
+
+  // Let it lap the ring first, and keep reading until it has lapped
+  // it many more times, which with one CPU needs it to be preempted.
+  while (added.load(std::memory_order_relaxed) < 1000) {
+    std::this_thread::yield();
+  }
+  std::uint32_t const start = added.load(std::memory_order_relaxed);
+  std::vector<ControllerState> samples;
+  long nonEmptyReads = 0;
+  for (int r = 0;
+       r < 200 || added.load(std::memory_order_relaxed) < start + 100000;
+       ++r) {
+    // If the writer laps the ring during the copy, none of it is
+    // intact, and nothing is read.
+    ring.readRecent(samples);
+    EXPECT(samples.size() <= 64);
+    nonEmptyReads += checkSequence(samples) >= 0;
+  }
+
+  // Likewise for a snapshot, which reads on its own thread.
+  std::string fname = unitTestTempDir() + "/lapped.gpvrec";
+  EXPECT(ring.saveSnapshot(fname, GPVConfig()));
+  std::string resultFname, error;
+  long resultSamples = 0;
+  while (!ring.takeSnapshotResult(resultFname, resultSamples, error)) {
+    std::this_thread::yield();
+  }
+  stop = true;
+  writer.join();
+
+  EXPECT_EQ(resultFname, fname);
+  EXPECT_EQ(error, "");
+  EXPECT(resultSamples <= 64);
+
+  std::vector<RecordedConfig> configs;
+  samples.clear();
+  EXPECT_EQ(readInputRecordingFile(fname, samples, configs), "");
+  EXPECT_EQ((long)samples.size(), resultSamples);
+  checkSequence(samples);
+
+  // Once the writer has stopped, the ring is full and intact.
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)64);
+  EXPECT_EQ(checkSequence(samples) + 64, (long)ring.numSamples());
+  EXPECT(nonEmptyReads > 0);
+}
+
+
+// The header counters, as stored in the file.
+static std::uint64_t const c_startedOffset = 16;
+
+
+UNIT_TEST(replayBufferReopen)
+{
+  std::string path = unitTestTempDir() + "/reopened.ring";
+  std::vector<ControllerState> samples;
+  {
+    ReplayBuffer ring;
+    EXPECT_EQ(ring.open(path, 32, 0xFFFFFFFF), "");
+    for (std::uint32_t n=0; n < 100; ++n) {
+      ring.add(sequenceSample(n));
+    }
+  }
+
+  // The samples survive closing, and more are added after them.
+  ReplayBuffer ring;
+  EXPECT_EQ(ring.open(path, 32, 0xFFFFFFFF), "");
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)100);
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)32);
+  EXPECT_EQ(checkSequence(samples), 68);
+
+  for (std::uint32_t n=100; n < 110; ++n) {
+    ring.add(sequenceSample(n));
+  }
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)32);
+  EXPECT_EQ(checkSequence(samples), 78);
+  ring.close();
+
+  // As if the viewer had crashed in the middle of `add`: the slot it
+  // was overwriting, the oldest, is left out.
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    std::uint64_t started = 111;
+    f.seekp(c_startedOffset);
+    f.write((char const*)&started, sizeof(started));
+    EXPECT(f.good());
+  }
+  EXPECT_EQ(ring.open(path, 32, 0xFFFFFFFF), "");
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)110);
+  ring.readRecent(samples);
+  EXPECT_EQ(samples.size(), (std::size_t)31);
+  EXPECT_EQ(checkSequence(samples), 79);
+  ring.close();
+
+  // A different capacity starts a new ring.
+  EXPECT_EQ(ring.open(path, 48, 0xFFFFFFFF), "");
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)0);
+  ring.readRecent(samples);
+  EXPECT(samples.empty());
+  ring.close();
+
+  // So does a file that is not a ring.
+  {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f << "not a ring, but long enough to look like a header";
+  }
+  EXPECT_EQ(ring.open(path, 48, 0xFFFFFFFF), "");
+  EXPECT_EQ(ring.numSamples(), (std::uint64_t)0);
+}
+
+
+// EOF
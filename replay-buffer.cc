@@ -0,0 +1,445 @@
+// replay-buffer.cc
+// Code for `replay-buffer` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "replay-buffer.h"             // this module
+
+#include "input-recording.h"           // InputRecordingWriter
+
+#include <algorithm>                   // std::min
+#include <cerrno>                      // errno
+#include <cstring>                     // std::memcmp, etc.
+#include <fstream>                     // std::ofstream
+#include <type_traits>                 // std::is_standard_layout
+
+#ifdef _WIN32
+  #include <windows.h>                 // CreateFileMappingW, etc.
+#else
+  #include <fcntl.h>                   // open, O_*
+  #include <sys/mman.h>                // mmap, munmap
+  #include <unistd.h>                  // ftruncate, close
+#endif
+
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+              std::atomic<std::uint32_t>::is_always_lock_free,
+              "the ring is read while it is written");
+static_assert(sizeof(ReplayBufferHeader) == 32 &&
+              std::is_standard_layout<ReplayBufferHeader>::value,
+              "the header is stored in the file");
+static_assert(sizeof(std::atomic<std::uint32_t>) == 4,
+              "slots are stored in the file");
+
+
+// First bytes of every ring file.
+static char const s_magic[8] = { 'G','P','V','R','I','N','G','\n' };
+
+
+// --------------------------- ReplayBuffer ----------------------------
+ReplayBuffer::ReplayBuffer()
+  : m_path(),
+    m_windowMS(0),
+    m_header(nullptr),
+    m_slots(nullptr),
+    m_capacity(0),
+    m_mappedSize(0),
+#ifdef _WIN32
+    m_mapping(nullptr),
+#endif
+    m_prevState(),
+    m_numAdded(0),
+    m_snapshotThread(),
+    m_snapshotBusy(false),
+    m_snapshotDone(false),
+    m_resultMutex(),
+    m_resultFname(),
+    m_resultSamples(0),
+    m_resultError()
+{}
+
+
+ReplayBuffer::~ReplayBuffer()
+{
+  close();
+}
+
+
+#ifdef _WIN32
+
+// Return a message describing `GetLastError()`.
+static std::string lastErrorString(char const *what)
+{
+  return std::string(what) + " failed with code " +
+         std::to_string(GetLastError());
+}
+
+
+std::string ReplayBuffer::mapFile(std::uint32_t capacity)
+{
+  std::size_t size = sizeof(ReplayBufferHeader) +
+    (std::size_t)capacity * REPLAY_SLOT_WORDS * sizeof(std::uint32_t);
+
+  // Paths are ASCII in practice.
+  std::wstring wpath;
+  for (char c : m_path) {
+    wpath.push_back((wchar_t)(unsigned char)c);
+  }
+
+  HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return lastErrorString("CreateFile");
+  }
+
+  // This extends the file, with zeroes, if it is smaller.  The mapping
+  // keeps the file open, so its handle is not needed afterward.
+  m_mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+                                 (DWORD)((std::uint64_t)size >> 32),
+                                 (DWORD)size, nullptr);
+  std::string error;
+  if (!m_mapping) {
+    error = lastErrorString("CreateFileMapping");
+  }
+  CloseHandle(file);
+  if (!error.empty()) {
+    return error;
+  }
+
+  void *p = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (!p) {
+    error = lastErrorString("MapViewOfFile");
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+    return error;
+  }
+
+  m_header = static_cast<ReplayBufferHeader*>(p);
+  m_mappedSize = size;
+  return "";
+}
+
+
+void ReplayBuffer::unmapFile()
+{
+  if (m_header) {
+    UnmapViewOfFile(m_header);
+    m_header = nullptr;
+  }
+  if (m_mapping) {
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+  }
+}
+
+#else // !_WIN32
+
+// Return a message for `errno` after `what` failed.
+static std::string errnoString(char const *what)
+{
+  return std::string(what) + ": " + std::strerror(errno);
+}
+
+
+std::string ReplayBuffer::mapFile(std::uint32_t capacity)
+{
+  std::size_t size = sizeof(ReplayBufferHeader) +
+    (std::size_t)capacity * REPLAY_SLOT_WORDS * sizeof(std::uint32_t);
+
+  int fd = ::open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return errnoString(m_path.c_str());
+  }
+
+  // Extending the file fills it with zeroes, which do not look like a
+  // ring, so `open` starts a new one.
+  if (ftruncate(fd, size) < 0) {
+    std::string error = errnoString("ftruncate");
+    ::close(fd);
+    return error;
+  }
+
+  void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    return errnoString("mmap");
+  }
+
+  m_header = static_cast<ReplayBufferHeader*>(p);
+  m_mappedSize = size;
+  return "";
+}
+
+
+void ReplayBuffer::unmapFile()
+{
+  if (m_header) {
+    munmap(m_header, m_mappedSize);
+    m_header = nullptr;
+  }
+}
+
+#endif // !_WIN32
+
+
+std::string ReplayBuffer::open(std::string const &path,
+                               std::uint32_t capacity, DWORD windowMS)
+{
+  close();
+  if (capacity == 0) {
+    return "the capacity must be positive";
+  }
+
+  m_path = path;
+  m_windowMS = windowMS;
+  std::string error = mapFile(capacity);
+  if (!error.empty()) {
+    return error;
+  }
+
+  m_slots = reinterpret_cast<std::atomic<std::uint32_t>*>(m_header + 1);
+  m_capacity = capacity;
+
+  // Keep what a previous run left, which may be the lead-up to a
+  // crash, if it is compatible.  If that run stopped in the middle of
+  // `add`, `m_started` is ahead of `m_finished`, which correctly marks
+  // the slot it was overwriting as no longer holding a sample.
+  ReplayBufferHeader &h = *m_header;
+  bool compatible =
+    std::memcmp(h.m_magic, s_magic, sizeof(s_magic)) == 0 &&
+    h.m_version == REPLAY_BUFFER_VERSION &&
+    h.m_capacity == capacity;
+  if (!compatible) {
+    // With the counters at 0, the slots are not read, so they do not
+    // need to be cleared.
+    std::memcpy(h.m_magic, s_magic, sizeof(s_magic));
+    h.m_version = REPLAY_BUFFER_VERSION;
+    h.m_capacity = capacity;
+    h.m_started.store(0);
+    h.m_finished.store(0);
+  }
+
+  m_prevState = ControllerState();
+  m_numAdded = 0;
+  return "";
+}
+
+
+void ReplayBuffer::close()
+{
+  if (m_snapshotThread.joinable()) {
+    m_snapshotThread.join();
+  }
+
+  unmapFile();
+  m_slots = nullptr;
+  m_capacity = 0;
+  m_mappedSize = 0;
+}
+
+
+std::uint64_t ReplayBuffer::numSamples() const
+{
+  return m_header?
+    m_header->m_finished.load(std::memory_order_relaxed) : 0;
+}
+
+
+void ReplayBuffer::encodeSlot(std::uint32_t *words,
+                              ControllerState const &s)
+{
+  XINPUT_GAMEPAD const &g = s.m_inputState.Gamepad;
+  words[0] = s.m_pollTimeMS;
+  words[1] = s.m_inputState.dwPacketNumber;
+  words[2] = g.wButtons | ((std::uint32_t)s.m_hasInputState << 16);
+  words[3] = g.bLeftTrigger | ((std::uint32_t)g.bRightTrigger << 8);
+  words[4] = (std::uint16_t)g.sThumbLX |
+             ((std::uint32_t)(std::uint16_t)g.sThumbLY << 16);
+  words[5] = (std::uint16_t)g.sThumbRX |
+             ((std::uint32_t)(std::uint16_t)g.sThumbRY << 16);
+}
+
+
+void ReplayBuffer::decodeSlot(ControllerState &s /*OUT*/,
+                              std::uint32_t const *words)
+{
+  XINPUT_GAMEPAD &g = s.m_inputState.Gamepad;
+  s.m_pollTimeMS = words[0];
+  s.m_inputState.dwPacketNumber = words[1];
+  g.wButtons = (WORD)words[2];
+  s.m_hasInputState = (words[2] >> 16) & 1;
+  g.bLeftTrigger = (BYTE)words[3];
+  g.bRightTrigger = (BYTE)(words[3] >> 8);
+  g.sThumbLX = (SHORT)(std::uint16_t)words[4];
+  g.sThumbLY = (SHORT)(std::uint16_t)(words[4] >> 16);
+  g.sThumbRX = (SHORT)(std::uint16_t)words[5];
+  g.sThumbRY = (SHORT)(std::uint16_t)(words[5] >> 16);
+  s.m_pollTimeUS = 0;
+}
+
+
+void ReplayBuffer::add(ControllerState const &state)
+{
+  if (!m_header) {
+    return;
+  }
+
+  // Only compare what a slot holds.
+  std::uint32_t words[REPLAY_SLOT_WORDS], prevWords[REPLAY_SLOT_WORDS];
+  encodeSlot(words, state);
+  encodeSlot(prevWords, m_prevState);
+  if (m_numAdded > 0 &&
+      std::memcmp(words+1, prevWords+1,
+                  (REPLAY_SLOT_WORDS-1) * sizeof(std::uint32_t)) == 0) {
+    return;
+  }
+
+  ReplayBufferHeader &h = *m_header;
+  std::uint64_t n = h.m_finished.load(std::memory_order_relaxed);
+
+  // Announce the overwrite before doing it; see `readRecent`.
+  h.m_started.store(n+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::atomic<std::uint32_t> *slot =
+    m_slots + (n % m_capacity) * REPLAY_SLOT_WORDS;
+  for (int i=0; i < REPLAY_SLOT_WORDS; ++i) {
+    slot[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  h.m_finished.store(n+1, std::memory_order_release);
+
+  m_prevState = state;
+  m_numAdded++;
+}
+
+
+void ReplayBuffer::readRecent(
+  std::vector<ControllerState> &samples /*OUT*/) const
+{
+  samples.clear();
+  if (!m_header) {
+    return;
+  }
+  ReplayBufferHeader const &h = *m_header;
+
+  // Copy every sample that was complete when we started.
+  std::uint64_t end = h.m_finished.load(std::memory_order_acquire);
+  std::uint64_t begin = end > m_capacity? end - m_capacity : 0;
+  samples.resize(end - begin);
+  for (std::uint64_t n = begin; n < end; ++n) {
+    std::atomic<std::uint32_t> const *slot =
+      m_slots + (n % m_capacity) * REPLAY_SLOT_WORDS;
+    std::uint32_t words[REPLAY_SLOT_WORDS];
+    for (int i=0; i < REPLAY_SLOT_WORDS; ++i) {
+      words[i] = slot[i].load(std::memory_order_relaxed);
+    }
+    decodeSlot(samples[n - begin], words);
+  }
+
+  // If we read anything the writer stored after announcing sample
+  // `m`, this sees `m_started` at least `m+1`, so any sample it could
+  // have overwritten, which is any before `m+1 - capacity`, is
+  // discarded.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  std::uint64_t started = h.m_started.load(std::memory_order_relaxed);
+  std::uint64_t firstIntact =
+    started > m_capacity? started - m_capacity : 0;
+  if (firstIntact > begin) {
+    std::size_t overwritten =
+      (std::size_t)std::min(firstIntact - begin, end - begin);
+    samples.erase(samples.begin(), samples.begin() + overwritten);
+  }
+
+  // Keep the last `m_windowMS`, going back from the newest sample
+  // until one is too old or out of order, which happens where a
+  // previous run's samples are from before a reboot.
+  std::size_t first = samples.size();
+  if (first > 0) {
+    DWORD newestMS = samples.back().m_pollTimeMS;
+    while (first > 0) {
+      DWORD t = samples[first-1].m_pollTimeMS;
+      DWORD laterMS = first < samples.size()?
+                        samples[first].m_pollTimeMS : newestMS;
+      if ((std::int32_t)(laterMS - t) < 0 || newestMS - t > m_windowMS) {
+        break;
+      }
+      --first;
+    }
+  }
+  samples.erase(samples.begin(), samples.begin() + first);
+}
+
+
+bool ReplayBuffer::saveSnapshot(std::string const &fname,
+                                GPVConfig const &config)
+{
+  if (!m_header || m_snapshotBusy) {
+    return false;
+  }
+
+  if (m_snapshotThread.joinable()) {
+    m_snapshotThread.join();
+  }
+  m_snapshotBusy = true;
+  m_snapshotThread =
+    std::thread(&ReplayBuffer::writeSnapshot, this, fname, config);
+  return true;
+}
+
+
+void ReplayBuffer::writeSnapshot(std::string fname, GPVConfig config)
+{
+  std::vector<ControllerState> samples;
+  readRecent(samples);
+
+  std::string error;
+  long written = 0;
+  std::ofstream out(fname, std::ios::binary);
+  if (!out) {
+    error = fname + ": " + std::strerror(errno);
+  }
+  else {
+    InputRecordingWriter writer(out);
+    writer.writeHeader(config);
+    for (ControllerState const &s : samples) {
+      writer.writeSample(s);
+    }
+    writer.writeFooter();
+    out.close();
+    if (!out) {
+      error = fname + ": write failed";
+    }
+    written = writer.m_sampleCount;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    m_resultFname = fname;
+    m_resultSamples = written;
+    m_resultError = error;
+  }
+  m_snapshotDone = true;
+  m_snapshotBusy = false;
+}
+
+
+bool ReplayBuffer::takeSnapshotResult(std::string &fname /*OUT*/,
+                                      long &numSamples /*OUT*/,
+                                      std::string &error /*OUT*/)
+{
+  if (!m_snapshotDone.exchange(false)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_resultMutex);
+  fname = m_resultFname;
+  numSamples = m_resultSamples;
+  error = m_resultError;
+  return true;
+}
+
+
+// EOF
@@ -0,0 +1,193 @@
+// replay-buffer.h
+// `ReplayBuffer`, a fixed-size circular log of the most recent input
+// samples in a memory-mapped file, like a dashcam.
+
+// See license.txt for copyright and terms of use.
+
+// The viewer appends every sample that differs from the previous one
+// to a ring of fixed-size slots, overwriting the oldest, so the file
+// always holds roughly the last few minutes of input and never grows.
+// Because the ring lives in a file mapping, what it holds survives the
+// viewer crashing, and is still there for the next run to save.
+//
+// `saveSnapshot` writes the samples from the last `m_windowMS` as an
+// ordinary recording (see input-recording.h) on a background thread,
+// so polling carries on meanwhile.  That thread reads the ring while
+// it is still being written, so the ring is guarded like a sequence
+// lock: the writer announces which sample it is about to write before
+// it writes it, and the reader, after copying, discards any sample
+// that may have been overwritten during the copy.
+//
+// The file layout is a header followed by the slots:
+//
+//   header:
+//     8 bytes    magic: "GPVRING" LF
+//     u32        format version, currently 1
+//     u32        number of slots
+//     u64        number of samples started (see above)
+//     u64        number of samples finished
+//   slot:
+//     `REPLAY_SLOT_WORDS` little-endian u32 words, see `encodeSlot`
+//
+// Sample `n` (counting from 0) is in slot `n % capacity`.
+
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // GPVConfig
+
+#include <atomic>                      // std::atomic
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::{uint32_t, uint64_t}
+#include <mutex>                       // std::mutex
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+#include <vector>                      // std::vector
+
+
+// File name used by the viewer.
+#define REPLAY_BUFFER_DEFAULT_PATH "gamepad-viewer-replay.ring"
+
+// Current format version.
+int const REPLAY_BUFFER_VERSION = 1;
+
+// Number of 32-bit words in a slot.
+int const REPLAY_SLOT_WORDS = 6;
+
+
+// Header at the start of the mapped file.
+class ReplayBufferHeader {
+public:      // data
+  char m_magic[8];
+  std::uint32_t m_version;
+  std::uint32_t m_capacity;
+
+  // Sequence counters, as described above.
+  std::atomic<std::uint64_t> m_started;
+  std::atomic<std::uint64_t> m_finished;
+};
+
+
+class ReplayBuffer {
+public:      // data
+  // Path of the ring file, as given to `open`.
+  std::string m_path;
+
+  // How much of the most recent input a snapshot saves.
+  DWORD m_windowMS;
+
+private:     // data
+  // Start of the mapping, or null if not open.
+  ReplayBufferHeader *m_header;
+
+  // The slots, right after `m_header`.
+  std::atomic<std::uint32_t> *m_slots;
+
+  // Number of slots.
+  std::uint32_t m_capacity;
+
+  // Bytes mapped.
+  std::size_t m_mappedSize;
+
+#ifdef _WIN32
+  // File mapping object.
+  HANDLE m_mapping;
+#endif
+
+  // The most recently added sample, to skip repeats, and the number
+  // of samples added since `open`.
+  ControllerState m_prevState;
+  std::uint64_t m_numAdded;
+
+  // Thread writing a snapshot, if one has been started.
+  std::thread m_snapshotThread;
+
+  // True while `m_snapshotThread` is writing.
+  std::atomic<bool> m_snapshotBusy;
+
+  // Set by the snapshot thread when it finishes, and cleared by
+  // `takeSnapshotResult`.
+  std::atomic<bool> m_snapshotDone;
+
+  // Protects the result fields below.
+  std::mutex m_resultMutex;
+
+  // Outcome of the most recent snapshot: the file written, the number
+  // of samples in it, and an error message, or empty if it worked.
+  std::string m_resultFname;
+  long m_resultSamples;
+  std::string m_resultError;
+
+private:     // methods
+  // Map `m_path`, sized for `capacity` slots.
+  std::string mapFile(std::uint32_t capacity);
+
+  // Unmap the file.
+  void unmapFile();
+
+  // Snapshot thread body.
+  void writeSnapshot(std::string fname, GPVConfig config);
+
+public:      // methods
+  ReplayBuffer();
+
+  // Closes the buffer, waiting for any snapshot to finish.
+  ~ReplayBuffer();
+
+  ReplayBuffer(ReplayBuffer const &obj) = delete;
+  ReplayBuffer &operator=(ReplayBuffer const &obj) = delete;
+
+  // Map the ring file at `path`, creating it if necessary, with room
+  // for `capacity` samples, of which snapshots save the last
+  // `windowMS`.  If the file already holds a ring of that capacity, its
+  // samples are kept.  Return an empty string on success or an error
+  // message on failure.
+  std::string open(std::string const &path, std::uint32_t capacity,
+                   DWORD windowMS);
+
+  // Wait for any snapshot to finish, and unmap the file, which keeps
+  // its contents.
+  void close();
+
+  bool isOpen() const
+    { return m_header != nullptr; }
+
+  std::uint32_t capacity() const
+    { return m_capacity; }
+
+  // Number of samples added since the ring file was created.
+  std::uint64_t numSamples() const;
+
+  // Add `state` unless it is identical to the previous sample, apart
+  // from its time.  This only stores a few words to the mapping.
+  void add(ControllerState const &state);
+
+  // Read the samples from the last `m_windowMS` that are still in the
+  // ring into `samples`, oldest first.  This may run concurrently with
+  // `add` on another thread.
+  void readRecent(std::vector<ControllerState> &samples /*OUT*/) const;
+
+  // Start writing a snapshot of the recent samples, with `config` as
+  // its configuration, to the recording `fname` in the background.
+  // Return false, without doing anything, if the previous snapshot has
+  // not finished yet.
+  bool saveSnapshot(std::string const &fname, GPVConfig const &config);
+
+  // If a snapshot has finished since the last call, set the arguments
+  // to its outcome and return true.  `error` is empty if it worked.
+  bool takeSnapshotResult(std::string &fname /*OUT*/,
+                          long &numSamples /*OUT*/,
+                          std::string &error /*OUT*/);
+
+  // Store `s` in the `REPLAY_SLOT_WORDS` words at `words`, and back.
+  // The time and packet number each get a word, then the buttons and
+  // connected flag, the two triggers, and the stick axes, two at a
+  // time, share one.
+  static void encodeSlot(std::uint32_t *words, ControllerState const &s);
+  static void decodeSlot(ControllerState &s /*OUT*/,
+                         std::uint32_t const *words);
+};
+
+
+#endif // REPLAY_BUFFER_H
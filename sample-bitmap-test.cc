@@ -0,0 +1,549 @@
+// sample-bitmap-test.cc
+// Tests for `sample-bitmap` module.
+
+// See license.txt for copyright and terms of use.
+
+// Every result is checked against the same set computed with
+// `std::set`.
+
+#include "sample-bitmap.h"             // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+#include "varint.h"                    // appendVarint
+
+#include <algorithm>                   // std::set_intersection, etc.
+#include <iterator>                    // std::inserter
+#include <random>                      // std::mt19937
+#include <set>                         // std::set
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+typedef std::set<std::uint32_t> ValueSet;
+
+
+// The bitmap of `values`, built by appending them and optimizing.
+static SampleBitmap bitmapOf(ValueSet const &values)
+{
+  SampleBitmap bitmap;
+  for (std::uint32_t v : values) {
+    bitmap.append(v);
+  }
+  bitmap.optimize();
+  return bitmap;
+}
+
+
+// The members of `bitmap`.
+static ValueSet setOf(SampleBitmap const &bitmap)
+{
+  std::vector<std::uint32_t> members;
+  bitmap.toVector(members);
+  return ValueSet(members.begin(), members.end());
+}
+
+
+// The bitset form of `lows`.
+static std::vector<std::uint64_t> wordsOf(ValueSet const &lows)
+{
+  std::vector<std::uint64_t> words(SAMPLE_BITMAP_WORDS, 0);
+  for (std::uint32_t low : lows) {
+    words[low / 64] |= (std::uint64_t)1 << (low % 64);
+  }
+  return words;
+}
+
+
+// The container made by `fromWords` for `lows`, with `key`.
+static SampleBitmapContainer containerOf(std::uint16_t key,
+                                         ValueSet const &lows)
+{
+  SampleBitmapContainer c(key);
+  c.fromWords(wordsOf(lows).data());
+  return c;
+}
+
+
+// Check what every container of `bitmap` promises: increasing keys,
+// no empty containers, and a cardinality that matches the members.
+static void checkWellFormed(SampleBitmap const &bitmap)
+{
+  int prevKey = -1;
+  for (SampleBitmapContainer const &c : bitmap.m_containers) {
+    EXPECT((int)c.m_key > prevKey);
+    prevKey = c.m_key;
+    EXPECT(c.m_cardinality > 0);
+
+    std::vector<std::uint64_t> words(SAMPLE_BITMAP_WORDS);
+    c.toWords(words.data());
+    int members = 0;
+    for (std::uint64_t w : words) {
+      members += __builtin_popcountll(w);
+    }
+    EXPECT_EQ(members, c.m_cardinality);
+
+    if (c.m_kind == SBK_ARRAY) {
+      EXPECT_EQ((int)c.m_values.size(), c.m_cardinality);
+      EXPECT(std::is_sorted(c.m_values.begin(), c.m_values.end()));
+    }
+    if (c.m_kind == SBK_BITSET) {
+      EXPECT_EQ((int)c.m_words.size(), SAMPLE_BITMAP_WORDS);
+    }
+  }
+}
+
+
+// Low halves of members, random but with a shape that makes
+// `fromWords` choose `kind`.
+static ValueSet lowsOfKind(SampleBitmapKind kind, std::mt19937 &rng)
+{
+  ValueSet lows;
+  switch (kind) {
+    case SBK_ARRAY:
+      // A few hundred scattered members.
+      while (lows.size() < 300) {
+        lows.insert(rng() % 65536);
+      }
+      break;
+
+    case SBK_BITSET:
+      // Each possible member with probability one half.
+      for (std::uint32_t v=0; v < 65536; ++v) {
+        if (rng() & 1) {
+          lows.insert(v);
+        }
+      }
+      break;
+
+    case SBK_RUN:
+      // Some long runs, which may overlap.
+      for (int r=0; r < 20; ++r) {
+        std::uint32_t start = rng() % 60000;
+        std::uint32_t length = 1 + rng() % 3000;
+        for (std::uint32_t v = start; v < start+length && v < 65536; ++v) {
+          lows.insert(v);
+        }
+      }
+      break;
+
+    case NUM_SAMPLE_BITMAP_KINDS:
+      break;
+  }
+  return lows;
+}
+
+
+// The reference result of `op` on `a` and `b`.
+static ValueSet combineSets(ValueSet const &a, ValueSet const &b,
+                            SampleBitmapOp op)
+{
+  ValueSet result;
+  auto out = std::inserter(result, result.end());
+  switch (op) {
+    case SBO_AND:
+      std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), out);
+      break;
+
+    case SBO_OR:
+      std::set_union(a.begin(), a.end(), b.begin(), b.end(), out);
+      break;
+
+    case SBO_ANDNOT:
+      std::set_difference(a.begin(), a.end(), b.begin(), b.end(), out);
+      break;
+  }
+  return result;
+}
+
+
+// ---------------------------- fromWords ----------------------------
+UNIT_TEST(fromWordsRunsAcrossWords)
+{
+  ValueSet lows = { 0, 5, 63, 64, 65535 };
+  for (std::uint32_t v = 127; v <= 256; ++v) {
+    lows.insert(v);             // Starts and ends at a word boundary.
+  }
+  for (std::uint32_t v = 320; v <= 383; ++v) {
+    lows.insert(v);             // Exactly one word.
+  }
+  for (std::uint32_t v = 4000; v <= 8000; ++v) {
+    lows.insert(v);
+  }
+
+  SampleBitmapContainer c = containerOf(7, lows);
+  EXPECT_EQ(c.m_kind, SBK_RUN);
+  EXPECT_EQ(c.m_cardinality, (int)lows.size());
+
+  std::vector<std::uint16_t> expect = {
+    0, 0,
+    5, 0,
+    63, 1,
+    127, 129,
+    320, 63,
+    4000, 4000,
+    65535, 0,
+  };
+  EXPECT(c.m_values == expect);
+  EXPECT(c.m_words.empty());
+
+  std::vector<std::uint64_t> words(SAMPLE_BITMAP_WORDS);
+  c.toWords(words.data());
+  EXPECT(words == wordsOf(lows));
+}
+
+
+UNIT_TEST(fromWordsOneBitRuns)
+{
+  // Alternate bits of one word, then a long run to make runs cheaper
+  // than an array.
+  ValueSet lows;
+  for (std::uint32_t v = 0; v < 64; v += 2) {
+    lows.insert(v);
+  }
+  for (std::uint32_t v = 1000; v <= 5000; ++v) {
+    lows.insert(v);
+  }
+
+  SampleBitmapContainer c = containerOf(0, lows);
+  EXPECT_EQ(c.m_kind, SBK_RUN);
+  EXPECT_EQ((int)c.m_values.size(), 2 * 33);
+  for (int i=0; i < 32; ++i) {
+    EXPECT_EQ(c.m_values[2*i], 2*i);
+    EXPECT_EQ(c.m_values[2*i+1], 0);
+  }
+  EXPECT_EQ(c.m_values[64], 1000);
+  EXPECT_EQ(c.m_values[65], 4000);
+
+  // Only one-bit runs, and every other bit: a bitset is smaller.
+  ValueSet alternate;
+  for (std::uint32_t v = 1; v < 65536; v += 2) {
+    alternate.insert(v);
+  }
+  c = containerOf(0, alternate);
+  EXPECT_EQ(c.m_kind, SBK_BITSET);
+  EXPECT_EQ(c.m_cardinality, 32768);
+  EXPECT(c.m_values.empty());
+
+  // A few scattered ones: an array is smaller.
+  c = containerOf(0, ValueSet{ 3, 300, 30000 });
+  EXPECT_EQ(c.m_kind, SBK_ARRAY);
+  EXPECT(c.m_values == std::vector<std::uint16_t>({ 3, 300, 30000 }));
+  EXPECT(c.m_words.empty());
+}
+
+
+UNIT_TEST(fromWordsFullChunk)
+{
+  std::vector<std::uint64_t> words(SAMPLE_BITMAP_WORDS, ~(std::uint64_t)0);
+  SampleBitmapContainer c(1);
+  c.fromWords(words.data());
+  EXPECT_EQ(c.m_kind, SBK_RUN);
+  EXPECT_EQ(c.m_cardinality, 65536);
+  EXPECT(c.m_values == std::vector<std::uint16_t>({ 0, 65535 }));
+  EXPECT(c.contains(0));
+  EXPECT(c.contains(65535));
+}
+
+
+// At random densities, `fromWords` keeps the members and picks the
+// smallest kind.
+UNIT_TEST(fromWordsPicksSmallest)
+{
+  std::mt19937 rng(1);
+  int const oneIn[] = { 2, 16, 300, 5000 };
+  for (int trial=0; trial < 40; ++trial) {
+    ValueSet lows;
+    if (trial % 5 == 4) {
+      lows = lowsOfKind(SBK_RUN, rng);
+    }
+    else {
+      int n = oneIn[trial % 4];
+      for (std::uint32_t v=0; v < 65536; ++v) {
+        if (rng() % n == 0) {
+          lows.insert(v);
+        }
+      }
+    }
+    if (lows.empty()) {
+      continue;
+    }
+
+    std::size_t runs = 0;
+    for (std::uint32_t v : lows) {
+      runs += (v == 0 || !lows.count(v-1));
+    }
+    std::size_t smallest = std::min<std::size_t>(runs * 4,
+                                                 SAMPLE_BITMAP_WORDS * 8);
+    if (lows.size() <= (std::size_t)SAMPLE_BITMAP_ARRAY_MAX) {
+      smallest = std::min(smallest, lows.size() * 2);
+    }
+
+    SampleBitmapContainer c = containerOf(0, lows);
+    EXPECT_EQ(c.sizeBytes(), smallest);
+    EXPECT_EQ(c.m_cardinality, (int)lows.size());
+
+    std::vector<std::uint64_t> words(SAMPLE_BITMAP_WORDS);
+    c.toWords(words.data());
+    EXPECT(words == wordsOf(lows));
+    for (int probe=0; probe < 1000; ++probe) {
+      std::uint16_t low = (std::uint16_t)rng();
+      EXPECT_EQ(c.contains(low), lows.count(low) != 0);
+    }
+  }
+}
+
+
+// ---------------------------- SampleBitmap ----------------------------
+UNIT_TEST(sampleBitmapAppend)
+{
+  std::mt19937 rng(2);
+  ValueSet values;
+  std::uint32_t v = 0;
+  while (values.size() < 20000) {
+    v += 1 + rng() % (values.size() < 10000? 3 : 500);
+    values.insert(v);
+  }
+
+  SampleBitmap bitmap = bitmapOf(values);
+  checkWellFormed(bitmap);
+  EXPECT_EQ(bitmap.cardinality(), (std::uint64_t)values.size());
+  EXPECT(setOf(bitmap) == values);
+  for (std::uint32_t probe : values) {
+    EXPECT(bitmap.contains(probe));
+    EXPECT_EQ(bitmap.contains(probe+1), values.count(probe+1) != 0);
+  }
+}
+
+
+UNIT_TEST(sampleBitmapRange)
+{
+  for (std::uint32_t n : { 0u, 1u, 65535u, 65536u, 65537u, 200000u }) {
+    SampleBitmap bitmap = SampleBitmap::range(n);
+    checkWellFormed(bitmap);
+    EXPECT_EQ(bitmap.cardinality(), (std::uint64_t)n);
+    EXPECT(!bitmap.contains(n));
+    if (n) {
+      EXPECT(bitmap.contains(0));
+      EXPECT(bitmap.contains(n-1));
+    }
+  }
+}
+
+
+// Every pair of container kinds, under every operation, with chunks
+// in only one of the operands as well as one in both.
+UNIT_TEST(combineEveryKindPair)
+{
+  std::mt19937 rng(3);
+  SampleBitmapOp const ops[] = { SBO_AND, SBO_OR, SBO_ANDNOT };
+
+  for (int ka=0; ka < NUM_SAMPLE_BITMAP_KINDS; ++ka) {
+    for (int kb=0; kb < NUM_SAMPLE_BITMAP_KINDS; ++kb) {
+      // Key 1 is in both, key 0 only in `a`, and key 2 only in `b`.
+      SampleBitmap a, b;
+      ValueSet aValues, bValues;
+      for (int key=0; key < 3; ++key) {
+        bool inA = key < 2;
+        bool inB = key > 0;
+        SampleBitmapKind kind = (SampleBitmapKind)(inA? ka : kb);
+        ValueSet lows = lowsOfKind(kind, rng);
+        if (inA && inB) {
+          // Give `b` its own members of its own kind.
+          ValueSet bLows = lowsOfKind((SampleBitmapKind)kb, rng);
+          b.m_containers.push_back(containerOf(key, bLows));
+          EXPECT_EQ(b.m_containers.back().m_kind, kb);
+          for (std::uint32_t low : bLows) {
+            bValues.insert(((std::uint32_t)key << 16) | low);
+          }
+        }
+        SampleBitmap &which = inA? a : b;
+        ValueSet &whichValues = inA? aValues : bValues;
+        which.m_containers.push_back(containerOf(key, lows));
+        EXPECT_EQ(which.m_containers.back().m_kind, kind);
+        for (std::uint32_t low : lows) {
+          whichValues.insert(((std::uint32_t)key << 16) | low);
+        }
+      }
+      checkWellFormed(a);
+      checkWellFormed(b);
+
+      for (SampleBitmapOp op : ops) {
+        SampleBitmap result = SampleBitmap::combine(a, b, op);
+        checkWellFormed(result);
+        ValueSet expect = combineSets(aValues, bValues, op);
+        EXPECT_EQ(result.cardinality(), (std::uint64_t)expect.size());
+        EXPECT(setOf(result) == expect);
+      }
+    }
+  }
+}
+
+
+// Results that are empty, or whole, in the shared chunk.
+UNIT_TEST(combineEmptyAndFull)
+{
+  ValueSet few = { 1, 2, 3, 70000 };
+  SampleBitmap a = bitmapOf(few);
+  SampleBitmap empty;
+  SampleBitmap full = SampleBitmap::range(131072);
+
+  EXPECT(SampleBitmap::combine(a, a, SBO_ANDNOT).m_containers.empty());
+  EXPECT(SampleBitmap::combine(a, empty, SBO_AND).m_containers.empty());
+  EXPECT(setOf(SampleBitmap::combine(a, empty, SBO_OR)) == few);
+  EXPECT(setOf(SampleBitmap::combine(empty, a, SBO_OR)) == few);
+  EXPECT(setOf(SampleBitmap::combine(a, full, SBO_AND)) == few);
+  EXPECT(SampleBitmap::combine(a, full, SBO_ANDNOT).m_containers.empty());
+
+  SampleBitmap rest = SampleBitmap::combine(full, a, SBO_ANDNOT);
+  checkWellFormed(rest);
+  EXPECT_EQ(rest.cardinality(), (std::uint64_t)(131072 - few.size()));
+  EXPECT(!rest.contains(70000));
+  EXPECT(rest.contains(69999));
+
+  SampleBitmap whole = SampleBitmap::combine(rest, a, SBO_OR);
+  checkWellFormed(whole);
+  EXPECT_EQ(whole.cardinality(), (std::uint64_t)131072);
+}
+
+
+// ---------------------------- encode/decode ----------------------------
+// A bitmap with one container of each kind, the bitset last.
+static SampleBitmap mixedBitmap()
+{
+  std::mt19937 rng(4);
+  SampleBitmap bitmap;
+  bitmap.m_containers.push_back(containerOf(0, lowsOfKind(SBK_ARRAY, rng)));
+  bitmap.m_containers.push_back(containerOf(3, lowsOfKind(SBK_RUN, rng)));
+  bitmap.m_containers.push_back(
+    containerOf(0xFFFF, lowsOfKind(SBK_BITSET, rng)));
+  return bitmap;
+}
+
+
+UNIT_TEST(encodeDecodeRoundTrip)
+{
+  SampleBitmap bitmap = mixedBitmap();
+  std::string data;
+  bitmap.encode(data);
+  data += "after";
+
+  SampleBitmap decoded;
+  char const *p = data.data();
+  char const *end = p + data.size();
+  EXPECT(decoded.decode(p, end));
+  EXPECT_EQ(std::string(p, end), "after");
+  checkWellFormed(decoded);
+  EXPECT(setOf(decoded) == setOf(bitmap));
+  for (std::size_t i=0; i < bitmap.m_containers.size(); ++i) {
+    EXPECT_EQ(decoded.m_containers[i].m_kind,
+              bitmap.m_containers[i].m_kind);
+  }
+
+  // The empty bitmap.
+  data.clear();
+  SampleBitmap().encode(data);
+  p = data.data();
+  EXPECT(decoded.decode(p, data.data() + data.size()));
+  EXPECT(decoded.m_containers.empty());
+}
+
+
+UNIT_TEST(decodeRejectsTruncation)
+{
+  std::string data;
+  mixedBitmap().encode(data);
+  for (std::size_t len=0; len < data.size(); ++len) {
+    SampleBitmap decoded;
+    char const *p = data.data();
+    EXPECT(!decoded.decode(p, data.data() + len));
+  }
+}
+
+
+// Decode `data` as a whole bitmap.
+static bool decodeAll(std::string const &data)
+{
+  SampleBitmap decoded;
+  char const *p = data.data();
+  char const *end = p + data.size();
+  return decoded.decode(p, end) && p == end;
+}
+
+
+// A container header.
+static std::string header(std::uint64_t key, std::uint64_t kind,
+                          std::uint64_t cardinality)
+{
+  std::string s;
+  appendVarint(s, key);
+  appendVarint(s, kind);
+  appendVarint(s, cardinality);
+  return s;
+}
+
+
+// Concatenation of the varints `values`.
+static std::string varints(std::vector<std::uint64_t> const &values)
+{
+  std::string s;
+  for (std::uint64_t v : values) {
+    appendVarint(s, v);
+  }
+  return s;
+}
+
+
+UNIT_TEST(decodeRejectsMalformed)
+{
+  // Well-formed, to show the others fail for the reason intended:
+  // array { 3, 4 } and run [10, 12].
+  EXPECT(decodeAll(varints({1}) + header(0, SBK_ARRAY, 2) +
+                   varints({3, 0})));
+  EXPECT(decodeAll(varints({1}) + header(0, SBK_RUN, 3) +
+                   varints({1, 10, 2})));
+
+  // Too many containers.
+  EXPECT(!decodeAll(varints({65537})));
+
+  // Keys out of order, or too large.
+  EXPECT(!decodeAll(varints({2}) +
+                    header(5, SBK_ARRAY, 1) + varints({0}) +
+                    header(5, SBK_ARRAY, 1) + varints({1})));
+  EXPECT(!decodeAll(varints({2}) +
+                    header(5, SBK_ARRAY, 1) + varints({0}) +
+                    header(4, SBK_ARRAY, 1) + varints({1})));
+  EXPECT(!decodeAll(varints({1}) + header(0x10000, SBK_ARRAY, 1) +
+                    varints({0})));
+
+  // Unknown kind.
+  EXPECT(!decodeAll(varints({1}) + header(0, NUM_SAMPLE_BITMAP_KINDS, 1) +
+                    varints({0})));
+
+  // Empty, or impossibly large, container.
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_ARRAY, 0)));
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_RUN, 65537) +
+                    varints({1, 0, 65535})));
+
+  // Array members past 0xFFFF.
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_ARRAY, 2) +
+                    varints({0xFFFF, 0})));
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_ARRAY, 1) +
+                    varints({0x10000})));
+
+  // Runs that do not add up to the cardinality, or run past 0xFFFF.
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_RUN, 4) +
+                    varints({1, 10, 2})));
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_RUN, 2) +
+                    varints({1, 0xFFFF, 1})));
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_RUN, 2) +
+                    varints({2, 0, 0, 0xFFFF, 0})));
+
+  // A bitset whose bits do not match the cardinality.
+  std::string bits(SAMPLE_BITMAP_WORDS * 8, '\0');
+  bits[0] = 3;
+  EXPECT(decodeAll(varints({1}) + header(0, SBK_BITSET, 2) + bits));
+  EXPECT(!decodeAll(varints({1}) + header(0, SBK_BITSET, 3) + bits));
+}
+
+
+// EOF
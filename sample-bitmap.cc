@@ -0,0 +1,563 @@
+// sample-bitmap.cc
+// Code for `sample-bitmap` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "sample-bitmap.h"             // this module
+
+#include "varint.h"                    // appendVarint, readVarint
+
+#include <algorithm>                   // std::{lower_bound, set_*}
+#include <cstring>                     // std::memcpy
+#include <iterator>                    // std::back_inserter
+
+
+// Set bits [first, last] of `words`.
+static void setRange(std::uint64_t *words, int first, int last)
+{
+  int fw = first / 64;
+  int lw = last / 64;
+  std::uint64_t firstMask = ~(std::uint64_t)0 << (first % 64);
+  std::uint64_t lastMask = ~(std::uint64_t)0 >> (63 - last % 64);
+  if (fw == lw) {
+    words[fw] |= firstMask & lastMask;
+    return;
+  }
+  words[fw] |= firstMask;
+  for (int w = fw+1; w < lw; ++w) {
+    words[w] = ~(std::uint64_t)0;
+  }
+  words[lw] |= lastMask;
+}
+
+
+// ----------------------- SampleBitmapContainer -----------------------
+SampleBitmapContainer::SampleBitmapContainer()
+  : SampleBitmapContainer(0)
+{}
+
+
+SampleBitmapContainer::SampleBitmapContainer(std::uint16_t key)
+  : m_key(key),
+    m_kind(SBK_ARRAY),
+    m_cardinality(0),
+    m_values(),
+    m_words()
+{}
+
+
+bool SampleBitmapContainer::contains(std::uint16_t low) const
+{
+  switch (m_kind) {
+    case SBK_ARRAY:
+      return std::binary_search(m_values.begin(), m_values.end(), low);
+
+    case SBK_BITSET:
+      return (m_words[low / 64] >> (low % 64)) & 1;
+
+    case SBK_RUN: {
+      // Find the last run starting at or before `low`.
+      std::size_t lo = 0;
+      std::size_t hi = m_values.size() / 2;
+      while (lo < hi) {
+        std::size_t mid = (lo + hi) / 2;
+        if (m_values[mid*2] <= low) {
+          lo = mid+1;
+        }
+        else {
+          hi = mid;
+        }
+      }
+      if (lo == 0) {
+        return false;
+      }
+      std::uint16_t start = m_values[(lo-1)*2];
+      std::uint16_t lengthMinus1 = m_values[(lo-1)*2 + 1];
+      return low - start <= lengthMinus1;
+    }
+
+    case NUM_SAMPLE_BITMAP_KINDS:
+      break;
+  }
+  return false;
+}
+
+
+void SampleBitmapContainer::toWords(std::uint64_t *words /*OUT*/) const
+{
+  if (m_kind == SBK_BITSET) {
+    std::memcpy(words, m_words.data(),
+                SAMPLE_BITMAP_WORDS * sizeof(std::uint64_t));
+    return;
+  }
+
+  for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+    words[i] = 0;
+  }
+  if (m_kind == SBK_ARRAY) {
+    for (std::uint16_t v : m_values) {
+      words[v / 64] |= (std::uint64_t)1 << (v % 64);
+    }
+  }
+  else {
+    for (std::size_t i=0; i < m_values.size(); i += 2) {
+      setRange(words, m_values[i], m_values[i] + m_values[i+1]);
+    }
+  }
+}
+
+
+void SampleBitmapContainer::fromWords(std::uint64_t const *words)
+{
+  // Count the members, and the runs, each of which starts at a set bit
+  // whose predecessor is clear.
+  int cardinality = 0;
+  int runs = 0;
+  std::uint64_t carry = 0;
+  for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+    std::uint64_t w = words[i];
+    cardinality += __builtin_popcountll(w);
+    runs += __builtin_popcountll(w & ~((w << 1) | carry));
+    carry = w >> 63;
+  }
+  m_cardinality = cardinality;
+
+  std::size_t arrayBytes = cardinality <= SAMPLE_BITMAP_ARRAY_MAX?
+    cardinality * 2 : SIZE_MAX;
+  std::size_t runBytes = runs * 4;
+  std::size_t bitsetBytes = SAMPLE_BITMAP_WORDS * 8;
+
+  m_values.clear();
+  m_words.clear();
+
+  if (bitsetBytes < arrayBytes && bitsetBytes < runBytes) {
+    m_kind = SBK_BITSET;
+    m_words.assign(words, words + SAMPLE_BITMAP_WORDS);
+    return;
+  }
+
+  if (runBytes < arrayBytes) {
+    // Visit just the first and last bit of each run, which alternate.
+    m_kind = SBK_RUN;
+    m_values.reserve(runs*2);
+    std::uint64_t prev = 0;
+    for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+      std::uint64_t w = words[i];
+      std::uint64_t next = i+1 < SAMPLE_BITMAP_WORDS? words[i+1] : 0;
+      std::uint64_t starts = w & ~((w << 1) | (prev >> 63));
+      std::uint64_t ends = w & ~((w >> 1) | (next << 63));
+      while (starts | ends) {
+        int s = starts? __builtin_ctzll(starts) : 64;
+        int e = ends? __builtin_ctzll(ends) : 64;
+        if (s <= e) {
+          m_values.push_back((std::uint16_t)(i*64 + s));
+          starts &= starts-1;
+        }
+        else {
+          int start = m_values.back();
+          m_values.push_back((std::uint16_t)(i*64 + e - start));
+          ends &= ends-1;
+        }
+        if (s == e) {
+          // A run of one bit.
+          m_values.push_back(0);
+          ends &= ends-1;
+        }
+      }
+      prev = w;
+    }
+    return;
+  }
+
+  m_kind = SBK_ARRAY;
+  m_values.reserve(cardinality);
+  for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+    for (std::uint64_t w = words[i]; w; w &= w-1) {
+      m_values.push_back((std::uint16_t)(i*64 + __builtin_ctzll(w)));
+    }
+  }
+}
+
+
+void SampleBitmapContainer::optimize()
+{
+  std::uint64_t words[SAMPLE_BITMAP_WORDS];
+  toWords(words);
+  fromWords(words);
+}
+
+
+std::size_t SampleBitmapContainer::sizeBytes() const
+{
+  return m_values.size() * sizeof(std::uint16_t) +
+         m_words.size() * sizeof(std::uint64_t);
+}
+
+
+// Put the result of `op` on `a` and `b`, which have the same key, into
+// `out`, whose cardinality is left 0 if the result is empty.
+static void combineContainers(SampleBitmapContainer const &a,
+                              SampleBitmapContainer const &b,
+                              SampleBitmapOp op,
+                              SampleBitmapContainer &out /*OUT*/)
+{
+  out = SampleBitmapContainer(a.m_key);
+
+  // With a small array on the left, the result of AND or ANDNOT is a
+  // subset of it, which can be found without expanding either side.
+  if (a.m_kind == SBK_ARRAY && op != SBO_OR) {
+    if (b.m_kind == SBK_ARRAY) {
+      if (op == SBO_AND) {
+        std::set_intersection(a.m_values.begin(), a.m_values.end(),
+                              b.m_values.begin(), b.m_values.end(),
+                              std::back_inserter(out.m_values));
+      }
+      else {
+        std::set_difference(a.m_values.begin(), a.m_values.end(),
+                            b.m_values.begin(), b.m_values.end(),
+                            std::back_inserter(out.m_values));
+      }
+    }
+    else {
+      for (std::uint16_t v : a.m_values) {
+        if (b.contains(v) == (op == SBO_AND)) {
+          out.m_values.push_back(v);
+        }
+      }
+    }
+    out.m_cardinality = (int)out.m_values.size();
+    return;
+  }
+
+  if (op == SBO_OR && a.m_kind == SBK_ARRAY && b.m_kind == SBK_ARRAY &&
+      a.m_cardinality + b.m_cardinality <= SAMPLE_BITMAP_ARRAY_MAX) {
+    std::set_union(a.m_values.begin(), a.m_values.end(),
+                   b.m_values.begin(), b.m_values.end(),
+                   std::back_inserter(out.m_values));
+    out.m_cardinality = (int)out.m_values.size();
+    return;
+  }
+
+  // Otherwise, do it a word at a time.
+  std::uint64_t aw[SAMPLE_BITMAP_WORDS];
+  std::uint64_t bw[SAMPLE_BITMAP_WORDS];
+  a.toWords(aw);
+  b.toWords(bw);
+  std::uint64_t any = 0;
+  for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+    switch (op) {
+      case SBO_AND:    aw[i] &= bw[i];  break;
+      case SBO_OR:     aw[i] |= bw[i];  break;
+      case SBO_ANDNOT: aw[i] &= ~bw[i]; break;
+    }
+    any |= aw[i];
+  }
+  if (any) {
+    out.fromWords(aw);
+  }
+}
+
+
+// --------------------------- SampleBitmap ----------------------------
+SampleBitmap::SampleBitmap()
+  : m_containers()
+{}
+
+
+/*static*/ SampleBitmap SampleBitmap::range(std::uint32_t n)
+{
+  SampleBitmap ret;
+  for (std::uint64_t start = 0; start < n; start += 65536) {
+    std::uint64_t length = std::min<std::uint64_t>(n - start, 65536);
+    SampleBitmapContainer c((std::uint16_t)(start >> 16));
+    c.m_kind = SBK_RUN;
+    c.m_cardinality = (int)length;
+    c.m_values.push_back(0);
+    c.m_values.push_back((std::uint16_t)(length-1));
+    ret.m_containers.push_back(c);
+  }
+  return ret;
+}
+
+
+/*static*/ SampleBitmap SampleBitmap::combine(SampleBitmap const &a,
+                                              SampleBitmap const &b,
+                                              SampleBitmapOp op)
+{
+  SampleBitmap ret;
+  std::vector<SampleBitmapContainer> const &ac = a.m_containers;
+  std::vector<SampleBitmapContainer> const &bc = b.m_containers;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  SampleBitmapContainer result;
+
+  while (i < ac.size() || j < bc.size()) {
+    if (j == bc.size() ||
+        (i < ac.size() && ac[i].m_key < bc[j].m_key)) {
+      if (op != SBO_AND) {
+        ret.m_containers.push_back(ac[i]);
+      }
+      i++;
+    }
+    else if (i == ac.size() || bc[j].m_key < ac[i].m_key) {
+      if (op == SBO_OR) {
+        ret.m_containers.push_back(bc[j]);
+      }
+      j++;
+    }
+    else {
+      combineContainers(ac[i], bc[j], op, result);
+      if (result.m_cardinality > 0) {
+        ret.m_containers.push_back(std::move(result));
+      }
+      i++;
+      j++;
+    }
+  }
+
+  return ret;
+}
+
+
+void SampleBitmap::append(std::uint32_t v)
+{
+  std::uint16_t key = (std::uint16_t)(v >> 16);
+  std::uint16_t low = (std::uint16_t)v;
+
+  if (m_containers.empty() || m_containers.back().m_key != key) {
+    m_containers.emplace_back(key);
+  }
+  SampleBitmapContainer &c = m_containers.back();
+
+  if (c.m_kind == SBK_ARRAY &&
+      c.m_cardinality == SAMPLE_BITMAP_ARRAY_MAX) {
+    c.m_words.resize(SAMPLE_BITMAP_WORDS);
+    c.toWords(c.m_words.data());
+    c.m_kind = SBK_BITSET;
+    c.m_values.clear();
+    c.m_values.shrink_to_fit();
+  }
+
+  if (c.m_kind == SBK_ARRAY) {
+    c.m_values.push_back(low);
+  }
+  else {
+    c.m_words[low / 64] |= (std::uint64_t)1 << (low % 64);
+  }
+  c.m_cardinality++;
+}
+
+
+void SampleBitmap::optimize()
+{
+  for (SampleBitmapContainer &c : m_containers) {
+    c.optimize();
+  }
+}
+
+
+bool SampleBitmap::contains(std::uint32_t v) const
+{
+  std::uint16_t key = (std::uint16_t)(v >> 16);
+  auto it = std::lower_bound(m_containers.begin(), m_containers.end(),
+    key,
+    [](SampleBitmapContainer const &c, std::uint16_t k) {
+      return c.m_key < k;
+    });
+  return it != m_containers.end() && it->m_key == key &&
+         it->contains((std::uint16_t)v);
+}
+
+
+std::uint64_t SampleBitmap::cardinality() const
+{
+  std::uint64_t n = 0;
+  for (SampleBitmapContainer const &c : m_containers) {
+    n += c.m_cardinality;
+  }
+  return n;
+}
+
+
+void SampleBitmap::toVector(std::vector<std::uint32_t> &out /*OUT*/) const
+{
+  for (SampleBitmapContainer const &c : m_containers) {
+    std::uint32_t high = (std::uint32_t)c.m_key << 16;
+    switch (c.m_kind) {
+      case SBK_ARRAY:
+        for (std::uint16_t v : c.m_values) {
+          out.push_back(high | v);
+        }
+        break;
+
+      case SBK_BITSET:
+        for (int i=0; i < SAMPLE_BITMAP_WORDS; ++i) {
+          for (std::uint64_t w = c.m_words[i]; w; w &= w-1) {
+            out.push_back(high | (i*64 + __builtin_ctzll(w)));
+          }
+        }
+        break;
+
+      case SBK_RUN:
+        for (std::size_t i=0; i < c.m_values.size(); i += 2) {
+          std::uint32_t start = high | c.m_values[i];
+          for (std::uint32_t k=0; k <= c.m_values[i+1]; ++k) {
+            out.push_back(start + k);
+          }
+        }
+        break;
+
+      case NUM_SAMPLE_BITMAP_KINDS:
+        break;
+    }
+  }
+}
+
+
+std::size_t SampleBitmap::sizeBytes() const
+{
+  std::size_t n = 0;
+  for (SampleBitmapContainer const &c : m_containers) {
+    n += c.sizeBytes();
+  }
+  return n;
+}
+
+
+// The serialized form is the number of containers, then, for each,
+// its key, kind, and cardinality, and its members:
+//
+//   array      each member minus the previous one, minus 1
+//   run        the number of runs, then, for each, its start minus the
+//              end of the previous one, minus 1, and its length minus 1
+//   bitset     the words, little-endian
+//
+// all as varints except the bitset words, with the first "previous"
+// taken to be -1.
+void SampleBitmap::encode(std::string &dest) const
+{
+  appendVarint(dest, m_containers.size());
+  for (SampleBitmapContainer const &c : m_containers) {
+    appendVarint(dest, c.m_key);
+    appendVarint(dest, c.m_kind);
+    appendVarint(dest, c.m_cardinality);
+
+    int prev = -1;
+    switch (c.m_kind) {
+      case SBK_ARRAY:
+        for (std::uint16_t v : c.m_values) {
+          appendVarint(dest, v - prev - 1);
+          prev = v;
+        }
+        break;
+
+      case SBK_RUN:
+        appendVarint(dest, c.m_values.size() / 2);
+        for (std::size_t i=0; i < c.m_values.size(); i += 2) {
+          appendVarint(dest, c.m_values[i] - prev - 1);
+          appendVarint(dest, c.m_values[i+1]);
+          prev = c.m_values[i] + c.m_values[i+1];
+        }
+        break;
+
+      case SBK_BITSET:
+        for (std::uint64_t w : c.m_words) {
+          for (int b=0; b < 8; ++b) {
+            dest.push_back((char)(w >> (b*8)));
+          }
+        }
+        break;
+
+      case NUM_SAMPLE_BITMAP_KINDS:
+        break;
+    }
+  }
+}
+
+
+bool SampleBitmap::decode(char const *&p, char const *end)
+{
+  m_containers.clear();
+
+  std::uint64_t count;
+  if (!readVarint(p, end, count) || count > 65536) {
+    return false;
+  }
+
+  int prevKey = -1;
+  for (std::uint64_t i=0; i < count; ++i) {
+    std::uint64_t key, kind, cardinality;
+    if (!readVarint(p, end, key) ||
+        !readVarint(p, end, kind) ||
+        !readVarint(p, end, cardinality) ||
+        (int)key <= prevKey || key > 0xFFFF ||
+        kind >= NUM_SAMPLE_BITMAP_KINDS ||
+        cardinality == 0 || cardinality > 65536) {
+      return false;
+    }
+    prevKey = (int)key;
+
+    SampleBitmapContainer c((std::uint16_t)key);
+    c.m_kind = (SampleBitmapKind)kind;
+    c.m_cardinality = (int)cardinality;
+
+    // Number of members actually decoded, to check against
+    // `cardinality`.
+    std::uint64_t members = 0;
+    std::int64_t prev = -1;
+    if (c.m_kind == SBK_ARRAY) {
+      for (; members < cardinality; ++members) {
+        std::uint64_t delta;
+        if (!readVarint(p, end, delta) || delta > 0xFFFF ||
+            prev + 1 + (std::int64_t)delta > 0xFFFF) {
+          return false;
+        }
+        prev += 1 + delta;
+        c.m_values.push_back((std::uint16_t)prev);
+      }
+    }
+    else if (c.m_kind == SBK_RUN) {
+      std::uint64_t runs;
+      if (!readVarint(p, end, runs) || runs > 32768) {
+        return false;
+      }
+      for (std::uint64_t r=0; r < runs; ++r) {
+        std::uint64_t gap, lengthMinus1;
+        if (!readVarint(p, end, gap) ||
+            !readVarint(p, end, lengthMinus1) ||
+            gap > 0xFFFF || lengthMinus1 > 0xFFFF ||
+            prev + 1 + (std::int64_t)(gap + lengthMinus1) > 0xFFFF) {
+          return false;
+        }
+        std::int64_t start = prev + 1 + gap;
+        c.m_values.push_back((std::uint16_t)start);
+        c.m_values.push_back((std::uint16_t)lengthMinus1);
+        prev = start + lengthMinus1;
+        members += lengthMinus1 + 1;
+      }
+    }
+    else {
+      if (end - p < SAMPLE_BITMAP_WORDS * 8) {
+        return false;
+      }
+      c.m_words.resize(SAMPLE_BITMAP_WORDS);
+      for (std::uint64_t &w : c.m_words) {
+        w = 0;
+        for (int b=0; b < 8; ++b) {
+          w |= (std::uint64_t)(unsigned char)*p++ << (b*8);
+        }
+        members += __builtin_popcountll(w);
+      }
+    }
+
+    if (members != cardinality) {
+      return false;
+    }
+    m_containers.push_back(std::move(c));
+  }
+
+  return true;
+}
+
+
+// EOF
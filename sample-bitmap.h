@@ -0,0 +1,143 @@
+// sample-bitmap.h
+// `SampleBitmap`, a compressed set of sample numbers.
+
+// See license.txt for copyright and terms of use.
+
+// This follows the "Roaring" bitmap design: the 32-bit values are
+// split by their high 16 bits into chunks of 65536, and each non-empty
+// chunk is stored in whichever of three containers is smallest:
+//
+//   array    The low 16 bits of each member, sorted.  Used for at most
+//            `SAMPLE_BITMAP_ARRAY_MAX` members.
+//
+//   bitset   One bit per possible member, 8 KB.
+//
+//   run      The start and length of each run of consecutive members.
+//            A button held for a while is one run, so this is what
+//            most chunks of a button's bitmap end up as.
+//
+// The set operations go chunk by chunk, and only consider chunks that
+// can contribute to the result, so their cost depends on the size of
+// the bitmaps rather than the range of values.
+
+#ifndef SAMPLE_BITMAP_H
+#define SAMPLE_BITMAP_H
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::{uint16_t, uint32_t, uint64_t}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Most members of an array container.  Beyond this, a bitset is never
+// larger.
+int const SAMPLE_BITMAP_ARRAY_MAX = 4096;
+
+// Number of 64-bit words in a bitset container.
+int const SAMPLE_BITMAP_WORDS = 1024;
+
+
+// Kinds of `SampleBitmapContainer`.
+enum SampleBitmapKind {
+  SBK_ARRAY,
+  SBK_BITSET,
+  SBK_RUN,
+
+  NUM_SAMPLE_BITMAP_KINDS
+};
+
+
+// Operations for `SampleBitmap::combine`.
+enum SampleBitmapOp {
+  SBO_AND,                   // In both.
+  SBO_OR,                    // In either.
+  SBO_ANDNOT,                // In the first but not the second.
+};
+
+
+// The members of a `SampleBitmap` whose high 16 bits are `m_key`.
+class SampleBitmapContainer {
+public:      // data
+  // High 16 bits of the members.
+  std::uint16_t m_key;
+
+  SampleBitmapKind m_kind;
+
+  // Number of members.  Never 0.
+  int m_cardinality;
+
+  // For `SBK_ARRAY`, the low 16 bits of the members, in increasing
+  // order.  For `SBK_RUN`, for each run in increasing order, its first
+  // member and its length minus 1.
+  std::vector<std::uint16_t> m_values;
+
+  // For `SBK_BITSET`, `SAMPLE_BITMAP_WORDS` words, with member `low` in
+  // bit `low % 64` of word `low / 64`.
+  std::vector<std::uint64_t> m_words;
+
+public:      // methods
+  SampleBitmapContainer();
+  explicit SampleBitmapContainer(std::uint16_t key);
+
+  // True if `low` is a member.
+  bool contains(std::uint16_t low) const;
+
+  // Set `words`, `SAMPLE_BITMAP_WORDS` of them, to the bitset form.
+  void toWords(std::uint64_t *words /*OUT*/) const;
+
+  // Make this the smallest container holding the members set in
+  // `words`.  The cardinality must not be 0.
+  void fromWords(std::uint64_t const *words);
+
+  // Switch to the smallest kind for the current members.
+  void optimize();
+
+  // Bytes used by the members.
+  std::size_t sizeBytes() const;
+};
+
+
+class SampleBitmap {
+public:      // data
+  // Non-empty containers, in increasing order of key.
+  std::vector<SampleBitmapContainer> m_containers;
+
+public:      // methods
+  SampleBitmap();
+
+  // The bitmap of [0, n).
+  static SampleBitmap range(std::uint32_t n);
+
+  // The result of `op` on `a` and `b`.
+  static SampleBitmap combine(SampleBitmap const &a,
+                              SampleBitmap const &b,
+                              SampleBitmapOp op);
+
+  // Add `v`, which must be greater than every member.  Containers are
+  // left as arrays or bitsets; call `optimize` when done.
+  void append(std::uint32_t v);
+
+  // Switch every container to its smallest kind.
+  void optimize();
+
+  bool contains(std::uint32_t v) const;
+
+  // Number of members.
+  std::uint64_t cardinality() const;
+
+  // Append the members, in increasing order, to `out`.
+  void toVector(std::vector<std::uint32_t> &out /*OUT*/) const;
+
+  // Bytes used by the containers, not counting fixed overhead.
+  std::size_t sizeBytes() const;
+
+  // Append the serialized form to `dest`.
+  void encode(std::string &dest) const;
+
+  // Replace the members with those serialized from `p` to `end`,
+  // advancing `p`.  Return false if the encoding is malformed.
+  bool decode(char const *&p, char const *end);
+};
+
+
+#endif // SAMPLE_BITMAP_H
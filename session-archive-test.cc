@@ -0,0 +1,440 @@
+// session-archive-test.cc
+// Tests for `session-archive` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "session-archive.h"           // module under test
+
+#include "synthetic-input.h"           // SyntheticInput
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+#include "varint.h"                    // appendVarint
+
+#include <algorithm>                   // std::{min, max}
+#include <random>                      // std::mt19937
+#include <sstream>                     // std::{istringstream, ostringstream}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// The archive of `samples`.
+static std::string archiveOf(std::vector<ControllerState> const &samples)
+{
+  std::ostringstream oss;
+  SessionArchiveWriter writer(oss);
+  writer.writeHeader();
+  for (ControllerState const &state : samples) {
+    writer.writeSample(state);
+  }
+  writer.finish();
+  EXPECT(writer.ok());
+  EXPECT_EQ(writer.m_sampleCount, (long)samples.size());
+  return oss.str();
+}
+
+
+// Archive `samples`, read every column of every block back, and check
+// that the values and zone maps are those of `samples`.
+static void checkRoundTrip(std::vector<ControllerState> const &samples)
+{
+  std::istringstream iss(archiveOf(samples));
+  SessionArchiveReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+
+  long next = 0;
+  while (reader.nextBlock()) {
+    EXPECT_EQ(reader.m_firstSample, next);
+    EXPECT_EQ(reader.m_blockSamples,
+              std::min<int>(ARCHIVE_BLOCK_SAMPLES, samples.size() - next));
+    EXPECT(reader.readColumns((1u << NUM_ARCHIVE_COLUMNS) - 1));
+
+    for (int i=0; i < NUM_ARCHIVE_COLUMNS; ++i) {
+      ArchiveColumn c = (ArchiveColumn)i;
+      bool subsetOrder = c == AC_CONNECTED || c == AC_BUTTONS;
+      std::int64_t lo = archiveColumnValue(samples[next], c);
+      std::int64_t hi = lo;
+      int mismatches = 0;
+      for (int s=0; s < reader.m_blockSamples; ++s) {
+        std::int64_t v = archiveColumnValue(samples[next + s], c);
+        mismatches += reader.m_values[c][s] != v;
+        lo = subsetOrder? (lo & v) : std::min(lo, v);
+        hi = subsetOrder? (hi | v) : std::max(hi, v);
+      }
+      if (mismatches) {
+        unitTestFail(__FILE__, __LINE__,
+                     std::string("wrong values in ") + toString(c));
+      }
+      EXPECT_EQ(reader.m_zones[c].m_min, lo);
+      EXPECT_EQ(reader.m_zones[c].m_max, hi);
+    }
+    next += reader.m_blockSamples;
+  }
+  EXPECT_EQ(reader.m_error, "");
+  EXPECT_EQ(next, (long)samples.size());
+  EXPECT_EQ(reader.m_blocksSeen,
+            (long)(samples.size() + ARCHIVE_BLOCK_SAMPLES - 1) /
+              ARCHIVE_BLOCK_SAMPLES);
+}
+
+
+// Connected samples whose fields are all 0 except the time.
+static std::vector<ControllerState> idleSamples(int count, DWORD startMS)
+{
+  std::vector<ControllerState> samples(count);
+  for (int s=0; s < count; ++s) {
+    samples[s].m_hasInputState = true;
+    samples[s].m_pollTimeMS = startMS + s;
+  }
+  return samples;
+}
+
+
+// Delta-of-delta times: steady, jittery, repeated, with long gaps, and
+// wrapping around the 32-bit tick counter.
+UNIT_TEST(archiveTimeColumn)
+{
+  std::mt19937 rng(6);
+  std::vector<ControllerState> samples = idleSamples(10000, 0);
+  DWORD t = 0xFFFFFFFFu - 3000;
+  for (int s=0; s < (int)samples.size(); ++s) {
+    samples[s].m_pollTimeMS = t;
+    if (s < 2000 || s > 9000) {
+      t += 1;
+    }
+    else if (s % 1000 == 0) {
+      t += 60000;
+    }
+    else {
+      t += rng() % 4;           // Includes 0: the same time twice.
+    }
+  }
+  checkRoundTrip(samples);
+
+  // One sample, and exactly one block.
+  checkRoundTrip(idleSamples(1, 12345));
+  checkRoundTrip(idleSamples(ARCHIVE_BLOCK_SAMPLES, 0));
+}
+
+
+// Run lengths: long runs, runs of one sample, a block that is one run,
+// and runs that cross a block boundary.
+UNIT_TEST(archiveRunLengthColumns)
+{
+  std::mt19937 rng(7);
+  std::vector<ControllerState> samples = idleSamples(3 * 4096 + 17, 0);
+  WORD buttons = 0;
+  bool connected = true;
+  for (int s=0; s < (int)samples.size(); ++s) {
+    if (4096 <= s && s < 8192) {
+      // The whole second block is one run.
+      buttons = XINPUT_GAMEPAD_A | XINPUT_GAMEPAD_B;
+    }
+    else if (rng() % 8 == 0) {
+      buttons = (WORD)rng();
+    }
+    if (rng() % 500 == 0) {
+      connected = !connected;
+    }
+    samples[s].m_hasInputState = connected;
+    samples[s].m_inputState.Gamepad.wButtons = buttons;
+  }
+  checkRoundTrip(samples);
+}
+
+
+// Signed deltas, at their extremes.
+UNIT_TEST(archiveDeltaColumns)
+{
+  std::mt19937 rng(8);
+  std::vector<ControllerState> samples = idleSamples(5000, 0);
+  for (int s=0; s < (int)samples.size(); ++s) {
+    XINPUT_STATE &is = samples[s].m_inputState;
+    XINPUT_GAMEPAD &g = is.Gamepad;
+    is.dwPacketNumber = (s % 3 == 0)? 0xFFFFFFFFu : rng();
+    g.bLeftTrigger = (s & 1)? 255 : 0;
+    g.bRightTrigger = (BYTE)rng();
+    g.sThumbLX = (s & 1)? 32767 : -32768;
+    g.sThumbLY = (s & 1)? -32768 : 32767;
+    g.sThumbRX = (SHORT)rng();
+    g.sThumbRY = (SHORT)(s / 10);
+  }
+  checkRoundTrip(samples);
+}
+
+
+// A synthetic session of `count` samples, one per millisecond, in
+// which the right shoulder is held only from sample 20000 to 20999,
+// and the controller is disconnected from 30000 to 33999.
+static std::vector<ControllerState> syntheticSession(int count)
+{
+  SyntheticInput input;
+  std::vector<ControllerState> samples(count);
+  for (int s=0; s < count; ++s) {
+    ControllerState &state = samples[s];
+    input.next(state, 5000 + s);
+    WORD &buttons = state.m_inputState.Gamepad.wButtons;
+    buttons &= ~XINPUT_GAMEPAD_RIGHT_SHOULDER;
+    if (20000 <= s && s < 21000) {
+      buttons |= XINPUT_GAMEPAD_RIGHT_SHOULDER;
+    }
+    if (30000 <= s && s < 34000) {
+      DWORD timeMS = state.m_pollTimeMS;
+      state = ControllerState();
+      state.m_pollTimeMS = timeMS;
+    }
+  }
+  return samples;
+}
+
+
+// Numbers of the samples of `archive` that satisfy `predicates`,
+// reading only the blocks whose zone maps allow a match, and only the
+// columns the predicates need.  Set `blocksRead` and `blocksSeen`.
+static std::vector<long> queryArchive(
+  std::string const &archive,
+  std::vector<ArchivePredicate> const &predicates,
+  long &blocksRead /*OUT*/, long &blocksSeen /*OUT*/)
+{
+  std::istringstream iss(archive);
+  SessionArchiveReader reader(iss);
+  EXPECT_EQ(reader.readHeader(), "");
+
+  unsigned columnMask = 0;
+  for (ArchivePredicate const &pred : predicates) {
+    columnMask |= 1u << pred.m_column;
+  }
+
+  std::vector<long> matches;
+  while (reader.nextBlock()) {
+    if (!reader.blockMayMatch(predicates)) {
+      continue;
+    }
+    EXPECT(reader.readColumns(columnMask));
+    for (int s=0; s < reader.m_blockSamples; ++s) {
+      bool matched = true;
+      for (ArchivePredicate const &pred : predicates) {
+        matched = matched &&
+                  pred.matches(reader.m_values[pred.m_column][s]);
+      }
+      if (matched) {
+        matches.push_back(reader.m_firstSample + s);
+      }
+    }
+  }
+  EXPECT_EQ(reader.m_error, "");
+  blocksRead = reader.m_blocksRead;
+  blocksSeen = reader.m_blocksSeen;
+  return matches;
+}
+
+
+// Numbers of the samples of `samples` that satisfy `predicates`.
+static std::vector<long> scanSamples(
+  std::vector<ControllerState> const &samples,
+  std::vector<ArchivePredicate> const &predicates)
+{
+  std::vector<long> matches;
+  for (long s=0; s < (long)samples.size(); ++s) {
+    bool matched = true;
+    for (ArchivePredicate const &pred : predicates) {
+      matched = matched &&
+                pred.matches(archiveColumnValue(samples[s], pred.m_column));
+    }
+    if (matched) {
+      matches.push_back(s);
+    }
+  }
+  return matches;
+}
+
+
+UNIT_TEST(archiveQuerySkipsBlocks)
+{
+  std::vector<ControllerState> samples = syntheticSession(60000);
+  std::string archive = archiveOf(samples);
+
+  WORD const rb = XINPUT_GAMEPAD_RIGHT_SHOULDER;
+  WORD const a = XINPUT_GAMEPAD_A;
+  struct Case {
+    std::vector<ArchivePredicate> m_predicates;
+
+    // True if some blocks must be skipped.
+    bool m_skips;
+  };
+  Case const cases[] = {
+    // Right shoulder held.
+    { { ArchivePredicate(AC_BUTTONS, rb, 0xFFFF) }, true },
+
+    // Disconnected.
+    { { ArchivePredicate(AC_CONNECTED, 0, 0) }, true },
+
+    // Exactly A held, so not during the disconnection.
+    { { ArchivePredicate(AC_BUTTONS, a, a) }, false },
+
+    // A held, and the left trigger most of the way down.
+    { { ArchivePredicate(AC_BUTTONS, a, 0xFFFF),
+        ArchivePredicate(AC_LEFT_TRIGGER, 200, 255) }, false },
+
+    // A time range, and the left stick near the middle.
+    { { ArchivePredicate(AC_TIME, 5000 + 12345, 5000 + 23456),
+        ArchivePredicate(AC_THUMB_LX, -1000, 1000) }, true },
+
+    // Nothing: a packet number that never occurs.
+    { { ArchivePredicate(AC_PACKET, 100000, 200000) }, true },
+
+    // Everything.
+    { {}, false },
+  };
+
+  for (Case const &c : cases) {
+    long blocksRead, blocksSeen;
+    std::vector<long> expect = scanSamples(samples, c.m_predicates);
+    std::vector<long> actual =
+      queryArchive(archive, c.m_predicates, blocksRead, blocksSeen);
+    EXPECT(actual == expect);
+    EXPECT_EQ(blocksSeen, (60000 + ARCHIVE_BLOCK_SAMPLES - 1) /
+                            ARCHIVE_BLOCK_SAMPLES);
+    if (c.m_skips) {
+      EXPECT(blocksRead < blocksSeen);
+    }
+  }
+}
+
+
+// Read all of `archive`, reading the columns of each block if
+// `readColumns`, and skipping them otherwise.  Return the error, if
+// any, and set `samples` to the number of samples in blocks that were
+// read or skipped.
+static std::string readArchive(std::string const &archive,
+                               bool readColumns, long &samples /*OUT*/)
+{
+  samples = 0;
+  std::istringstream iss(archive);
+  SessionArchiveReader reader(iss);
+  std::string error = reader.readHeader();
+  if (!error.empty()) {
+    return error;
+  }
+  while (reader.nextBlock()) {
+    if (readColumns &&
+        !reader.readColumns((1u << NUM_ARCHIVE_COLUMNS) - 1)) {
+      return reader.m_error;
+    }
+    samples += reader.m_blockSamples;
+  }
+  return reader.m_error;
+}
+
+
+UNIT_TEST(archiveRejectsTruncation)
+{
+  // Blocks that mostly repeat the same sample.
+  std::vector<ControllerState> samples =
+    idleSamples(2 * ARCHIVE_BLOCK_SAMPLES + 100, 0);
+  for (int s=0; s < (int)samples.size(); s += 300) {
+    samples[s].m_inputState.Gamepad.wButtons = XINPUT_GAMEPAD_B;
+  }
+  std::string archive = archiveOf(samples);
+
+  // Where each block ends.
+  std::vector<std::size_t> blockEnds;
+  {
+    std::istringstream iss(archive);
+    SessionArchiveReader reader(iss);
+    EXPECT_EQ(reader.readHeader(), "");
+    while (reader.nextBlock()) {
+      EXPECT(reader.readColumns(0));
+      blockEnds.push_back((std::size_t)iss.tellg());
+    }
+    EXPECT_EQ(blockEnds.size(), (std::size_t)3);
+  }
+
+  for (std::size_t len=0; len < archive.size(); ++len) {
+    // Try every length near the start of the file or of a block, where
+    // the headers are, and a sample of those in between.
+    bool nearHeader = len < 64;
+    for (std::size_t end : blockEnds) {
+      nearHeader = nearHeader || (end <= len+64 && len <= end+64);
+    }
+    if (!nearHeader && len % 97 != 0) {
+      continue;
+    }
+
+    std::string prefix = archive.substr(0, len);
+    for (bool readColumns : { true, false }) {
+      long read;
+      std::string error = readArchive(prefix, readColumns, read);
+
+      // Stopping between blocks leaves a shorter archive, which is
+      // fine.  Anywhere else is an error.
+      std::size_t blocks = std::find(blockEnds.begin(), blockEnds.end(),
+                                     len) - blockEnds.begin();
+      if (len == 9 /*just the header*/ || blocks < blockEnds.size()) {
+        long expect = len == 9? 0 :
+          std::min<long>((blocks+1) * ARCHIVE_BLOCK_SAMPLES,
+                         samples.size());
+        if (!error.empty() || read != expect) {
+          unitTestFail(__FILE__, __LINE__,
+            "wrong result at block boundary " + std::to_string(len));
+        }
+      }
+      else if (error.empty()) {
+        unitTestFail(__FILE__, __LINE__,
+          "accepted a truncation to " + std::to_string(len) +
+          (readColumns? " bytes, reading columns" :
+                        " bytes, skipping columns"));
+        return;
+      }
+    }
+  }
+}
+
+
+UNIT_TEST(archiveRejectsCorruption)
+{
+  std::string const archive = archiveOf(idleSamples(5000, 0));
+  long samples;
+  EXPECT_EQ(readArchive(archive, true, samples), "");
+  EXPECT_EQ(samples, 5000);
+
+  std::string bad = archive;
+  bad[0] = 'X';
+  EXPECT_EQ(readArchive(bad, true, samples),
+            "not a session archive (bad magic number)");
+
+  bad = archive;
+  bad[8] = 2;
+  EXPECT_EQ(readArchive(bad, true, samples),
+            "unsupported session archive version 2");
+
+  // Byte 9 is the length of the first block header, and the number of
+  // samples, 4096, follows it in two bytes.
+  EXPECT_EQ((unsigned char)archive[10], 0x80);
+  EXPECT_EQ((unsigned char)archive[11], 0x20);
+
+  // One more sample than a block can have.
+  bad = archive;
+  bad[10] = (char)0x81;
+  EXPECT_EQ(readArchive(bad, true, samples), "malformed block header");
+
+  // One fewer than was encoded, so the columns have data left over.
+  bad = archive;
+  bad[10] = (char)0xFF;
+  bad[11] = 0x1F;
+  EXPECT_EQ(readArchive(bad, true, samples),
+            "malformed time column in block 0");
+
+  // A block header too long to be real.
+  bad = archive.substr(0, 9);
+  appendVarint(bad, 0x20000);
+  EXPECT_EQ(readArchive(bad + archive.substr(10), true, samples),
+            "truncated or malformed block length");
+
+  // A block header of just the number of samples.
+  bad = archive.substr(0, 9);
+  appendVarint(bad, 2);
+  EXPECT_EQ(readArchive(bad + archive.substr(10, 2), true, samples),
+            "malformed block header");
+}
+
+
+// EOF
@@ -0,0 +1,494 @@
+// session-archive.cc
+// Code for `session-archive` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "session-archive.h"           // this module
+
+#include "varint.h"                    // appendVarint, readVarint, etc.
+
+#include <algorithm>                   // std::{max, min}
+#include <cstring>                     // std::{memcmp, strcmp}
+#include <sstream>                     // std::ostringstream
+
+
+// First bytes of every archive.
+static char const s_magic[8] = { 'G','P','V','C','O','L','S','\n' };
+
+// A block header is never remotely this large; this guards against
+// allocating a huge buffer due to a corrupt length.  The same goes for
+// the data of one column.
+static std::uint64_t const c_maxHeaderLength = 0x10000;
+static std::uint64_t const c_maxColumnLength = 0x100000;
+
+
+// Name of each column, in `ArchiveColumn` order.
+static char const * const s_columnNames[NUM_ARCHIVE_COLUMNS] = {
+  "time",
+  "connected",
+  "packet",
+  "buttons",
+  "lt",
+  "rt",
+  "lx",
+  "ly",
+  "rx",
+  "ry",
+};
+
+
+char const *toString(ArchiveColumn column)
+{
+  if (0 <= column && column < NUM_ARCHIVE_COLUMNS) {
+    return s_columnNames[column];
+  }
+  return "unknown";
+}
+
+
+ArchiveColumn archiveColumnFromName(char const *name)
+{
+  for (int c=0; c < NUM_ARCHIVE_COLUMNS; ++c) {
+    if (0==std::strcmp(name, s_columnNames[c])) {
+      return (ArchiveColumn)c;
+    }
+  }
+  return NUM_ARCHIVE_COLUMNS;
+}
+
+
+std::int64_t archiveColumnValue(ControllerState const &state,
+                                ArchiveColumn column)
+{
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  switch (column) {
+    case AC_TIME:                  return state.m_pollTimeMS;
+    case AC_CONNECTED:             return state.m_hasInputState? 1 : 0;
+    case AC_PACKET:                return state.m_inputState.dwPacketNumber;
+    case AC_BUTTONS:               return g.wButtons;
+    case AC_LEFT_TRIGGER:          return g.bLeftTrigger;
+    case AC_RIGHT_TRIGGER:         return g.bRightTrigger;
+    case AC_THUMB_LX:              return g.sThumbLX;
+    case AC_THUMB_LY:              return g.sThumbLY;
+    case AC_THUMB_RX:              return g.sThumbRX;
+    case AC_THUMB_RY:              return g.sThumbRY;
+    case NUM_ARCHIVE_COLUMNS:      break;
+  }
+  return 0;
+}
+
+
+// True if `column` is stored with run lengths, and its zone map uses
+// the subset order.
+static bool isRunLengthColumn(ArchiveColumn column)
+{
+  return column == AC_CONNECTED || column == AC_BUTTONS;
+}
+
+
+// Read a varint from `is` a byte at a time.  Return 1 on success, 0 if
+// the stream ended before the first byte, and -1 if it is malformed or
+// truncated.
+static int readStreamVarint(std::istream &is, std::uint64_t &v /*OUT*/)
+{
+  v = 0;
+  for (int shift = 0; ; shift += 7) {
+    int b = is.get();
+    if (b == std::istream::traits_type::eof()) {
+      return shift == 0? 0 : -1;
+    }
+    if (shift >= 64) {
+      return -1;
+    }
+    v |= (std::uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return 1;
+    }
+  }
+}
+
+
+// -------------------------- ArchivePredicate -------------------------
+ArchivePredicate::ArchivePredicate(ArchiveColumn column,
+                                   std::int64_t min, std::int64_t max)
+  : m_column(column),
+    m_min(min),
+    m_max(max)
+{}
+
+
+bool ArchivePredicate::matches(std::int64_t value) const
+{
+  if (isRunLengthColumn(m_column)) {
+    return (value & m_min) == m_min && (value & ~m_max) == 0;
+  }
+  else {
+    return m_min <= value && value <= m_max;
+  }
+}
+
+
+bool ArchivePredicate::mayMatch(ArchiveZoneMap const &zone) const
+{
+  if (isRunLengthColumn(m_column)) {
+    // Some sample must hold each required button, and some sample must
+    // have each forbidden one released.
+    return (zone.m_max & m_min) == m_min && (zone.m_min & ~m_max) == 0;
+  }
+  else {
+    return zone.m_max >= m_min && zone.m_min <= m_max;
+  }
+}
+
+
+// ------------------------ SessionArchiveWriter -----------------------
+SessionArchiveWriter::SessionArchiveWriter(std::ostream &os)
+  : m_os(os),
+    m_sampleCount(0),
+    m_blockCount(0),
+    m_block(),
+    m_header(),
+    m_columns()
+{
+  m_block.reserve(ARCHIVE_BLOCK_SAMPLES);
+}
+
+
+void SessionArchiveWriter::writeHeader()
+{
+  std::string header(s_magic, sizeof(s_magic));
+  appendVarint(header, SESSION_ARCHIVE_VERSION);
+  m_os.write(header.data(), header.size());
+}
+
+
+void SessionArchiveWriter::writeSample(ControllerState const &state)
+{
+  m_block.push_back(state);
+  if (m_block.size() >= (std::size_t)ARCHIVE_BLOCK_SAMPLES) {
+    writeBlock();
+  }
+}
+
+
+void SessionArchiveWriter::writeBlock()
+{
+  if (m_block.empty()) {
+    return;
+  }
+
+  m_header.clear();
+  appendVarint(m_header, m_block.size());
+
+  for (int i=0; i < NUM_ARCHIVE_COLUMNS; ++i) {
+    ArchiveColumn c = (ArchiveColumn)i;
+    std::string &out = m_columns[c];
+    out.clear();
+
+    std::int64_t first = archiveColumnValue(m_block.front(), c);
+    ArchiveZoneMap zone;
+    zone.m_min = zone.m_max = first;
+
+    if (c == AC_TIME) {
+      // Done in 32 bits so the tick counter wrapping around does not
+      // matter.
+      appendVarint(out, (std::uint32_t)first);
+      std::int64_t prevDelta = 0;
+      for (std::size_t s=1; s < m_block.size(); ++s) {
+        std::int64_t delta = (std::int32_t)
+          (m_block[s].m_pollTimeMS - m_block[s-1].m_pollTimeMS);
+        appendSignedVarint(out, delta - prevDelta);
+        prevDelta = delta;
+
+        zone.m_min = std::min<std::int64_t>(zone.m_min,
+                                            m_block[s].m_pollTimeMS);
+        zone.m_max = std::max<std::int64_t>(zone.m_max,
+                                            m_block[s].m_pollTimeMS);
+      }
+    }
+
+    else if (isRunLengthColumn(c)) {
+      std::int64_t runValue = first;
+      std::uint64_t runLength = 0;
+      for (ControllerState const &state : m_block) {
+        std::int64_t v = archiveColumnValue(state, c);
+        if (v != runValue) {
+          appendVarint(out, runValue);
+          appendVarint(out, runLength);
+          runValue = v;
+          runLength = 0;
+        }
+        runLength++;
+
+        zone.m_min &= v;
+        zone.m_max |= v;
+      }
+      appendVarint(out, runValue);
+      appendVarint(out, runLength);
+    }
+
+    else {
+      std::int64_t prev = 0;
+      for (ControllerState const &state : m_block) {
+        std::int64_t v = archiveColumnValue(state, c);
+        appendSignedVarint(out, v - prev);
+        prev = v;
+
+        zone.m_min = std::min(zone.m_min, v);
+        zone.m_max = std::max(zone.m_max, v);
+      }
+    }
+
+    appendSignedVarint(m_header, zone.m_min);
+    appendVarint(m_header, zone.m_max - zone.m_min);
+  }
+
+  for (std::string const &column : m_columns) {
+    appendVarint(m_header, column.size());
+  }
+
+  std::string length;
+  appendVarint(length, m_header.size());
+  m_os.write(length.data(), length.size());
+  m_os.write(m_header.data(), m_header.size());
+  for (std::string const &column : m_columns) {
+    m_os.write(column.data(), column.size());
+  }
+
+  m_sampleCount += m_block.size();
+  m_blockCount++;
+  m_block.clear();
+}
+
+
+void SessionArchiveWriter::finish()
+{
+  writeBlock();
+  m_os.flush();
+}
+
+
+bool SessionArchiveWriter::ok() const
+{
+  return !m_os.fail();
+}
+
+
+// ------------------------ SessionArchiveReader -----------------------
+SessionArchiveReader::SessionArchiveReader(std::istream &is)
+  : m_is(is),
+    m_blockSamples(0),
+    m_firstSample(0),
+    m_zones(),
+    m_values(),
+    m_blocksSeen(0),
+    m_blocksRead(0),
+    m_error(),
+    m_columnLengths(),
+    m_pendingData(false),
+    m_buffer()
+{
+  for (std::vector<std::int64_t> &values : m_values) {
+    values.reserve(ARCHIVE_BLOCK_SAMPLES);
+  }
+}
+
+
+std::string SessionArchiveReader::readHeader()
+{
+  char magic[sizeof(s_magic)];
+  if (!m_is.read(magic, sizeof(magic)) ||
+      0 != std::memcmp(magic, s_magic, sizeof(magic))) {
+    return "not a session archive (bad magic number)";
+  }
+
+  std::uint64_t version;
+  if (readStreamVarint(m_is, version) != 1) {
+    return "truncated header";
+  }
+  if (version != (std::uint64_t)SESSION_ARCHIVE_VERSION) {
+    std::ostringstream oss;
+    oss << "unsupported session archive version " << version;
+    return oss.str();
+  }
+
+  return "";
+}
+
+
+bool SessionArchiveReader::nextBlock()
+{
+  if (m_pendingData) {
+    std::uint64_t length = 0;
+    for (std::uint64_t columnLength : m_columnLengths) {
+      length += columnLength;
+    }
+    m_pendingData = false;
+
+    // Seeking past the end does not fail for a file, so read the last
+    // byte of the data to be sure the block is all there.
+    if (length > 0) {
+      m_is.seekg(length - 1, std::ios::cur);
+      if (m_is.get() == std::istream::traits_type::eof()) {
+        m_error = "truncated block";
+        return false;
+      }
+    }
+  }
+  m_firstSample += m_blockSamples;
+  m_blockSamples = 0;
+
+  std::uint64_t headerLength;
+  int res = readStreamVarint(m_is, headerLength);
+  if (res == 0) {
+    // Normal end of stream.
+    return false;
+  }
+  if (res < 0 || headerLength > c_maxHeaderLength) {
+    m_error = "truncated or malformed block length";
+    return false;
+  }
+
+  m_buffer.resize(headerLength);
+  if (!m_is.read(&m_buffer[0], headerLength)) {
+    m_error = "truncated block header";
+    return false;
+  }
+
+  char const *p = m_buffer.data();
+  char const *end = p + m_buffer.size();
+  std::uint64_t n;
+  if (!readVarint(p, end, n) ||
+      n == 0 || n > (std::uint64_t)ARCHIVE_BLOCK_SAMPLES) {
+    m_error = "malformed block header";
+    return false;
+  }
+  for (ArchiveZoneMap &zone : m_zones) {
+    std::uint64_t range;
+    if (!readSignedVarint(p, end, zone.m_min) ||
+        !readVarint(p, end, range)) {
+      m_error = "malformed block header";
+      return false;
+    }
+    zone.m_max = zone.m_min + (std::int64_t)range;
+  }
+  for (std::uint64_t &length : m_columnLengths) {
+    if (!readVarint(p, end, length) || length > c_maxColumnLength) {
+      m_error = "malformed block header";
+      return false;
+    }
+  }
+
+  m_blockSamples = (int)n;
+  m_pendingData = true;
+  m_blocksSeen++;
+  return true;
+}
+
+
+bool SessionArchiveReader::readColumns(unsigned columnMask)
+{
+  if (!m_pendingData) {
+    m_error = "block data already read";
+    return false;
+  }
+
+  std::uint64_t length = 0;
+  for (std::uint64_t columnLength : m_columnLengths) {
+    length += columnLength;
+  }
+  m_buffer.resize(length);
+  if (length > 0 && !m_is.read(&m_buffer[0], length)) {
+    m_error = "truncated block";
+    return false;
+  }
+  m_pendingData = false;
+  m_blocksRead++;
+
+  char const *p = m_buffer.data();
+  for (int c=0; c < NUM_ARCHIVE_COLUMNS; ++c) {
+    char const *end = p + m_columnLengths[c];
+    if ((columnMask & (1u << c)) &&
+        !decodeColumn((ArchiveColumn)c, p, end)) {
+      std::ostringstream oss;
+      oss << "malformed " << toString((ArchiveColumn)c)
+          << " column in block " << (m_blocksSeen-1);
+      m_error = oss.str();
+      return false;
+    }
+    p = end;
+  }
+
+  return true;
+}
+
+
+bool SessionArchiveReader::decodeColumn(ArchiveColumn c,
+                                        char const *p, char const *end)
+{
+  std::vector<std::int64_t> &values = m_values[c];
+  values.clear();
+
+  if (c == AC_TIME) {
+    std::uint64_t first;
+    if (!readVarint(p, end, first)) {
+      return false;
+    }
+    std::uint32_t t = (std::uint32_t)first;
+    values.push_back(t);
+
+    std::int64_t delta = 0;
+    while ((int)values.size() < m_blockSamples) {
+      std::int64_t dd;
+      if (!readSignedVarint(p, end, dd)) {
+        return false;
+      }
+      delta += dd;
+      t += (std::uint32_t)delta;
+      values.push_back(t);
+    }
+  }
+
+  else if (isRunLengthColumn(c)) {
+    while ((int)values.size() < m_blockSamples) {
+      std::uint64_t v, runLength;
+      if (!readVarint(p, end, v) ||
+          !readVarint(p, end, runLength) ||
+          runLength == 0 ||
+          runLength > (std::uint64_t)(m_blockSamples - values.size())) {
+        return false;
+      }
+      values.insert(values.end(), runLength, (std::int64_t)v);
+    }
+  }
+
+  else {
+    std::int64_t v = 0;
+    while ((int)values.size() < m_blockSamples) {
+      std::int64_t delta;
+      if (!readSignedVarint(p, end, delta)) {
+        return false;
+      }
+      v += delta;
+      values.push_back(v);
+    }
+  }
+
+  // The encoding must be used up exactly.
+  return p == end;
+}
+
+
+bool SessionArchiveReader::blockMayMatch(
+  std::vector<ArchivePredicate> const &predicates) const
+{
+  for (ArchivePredicate const &pred : predicates) {
+    if (!pred.mayMatch(m_zones[pred.m_column])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// EOF
@@ -0,0 +1,244 @@
+// session-archive.h
+// `SessionArchiveWriter` and `SessionArchiveReader`, a columnar format
+// for long-term storage and querying of recorded input.
+
+// See license.txt for copyright and terms of use.
+
+// An input recording (see input-recording.h) stores each sample as a
+// change from the previous one, which is compact and easy to replay,
+// but answering a question like "when was L2 pressed in the last
+// month" means decoding all of it.  A session archive instead stores
+// the samples in blocks of up to `ARCHIVE_BLOCK_SAMPLES`, and within a
+// block, each field of the samples (see `ArchiveColumn`) separately,
+// with a codec suited to how it varies:
+//
+//   time               Delta of deltas: the first time, then the first
+//                      delta, then the change in delta for each later
+//                      sample, which at a steady poll rate is all 0.
+//
+//   connected, buttons Run lengths: each distinct value, and how many
+//                      samples in a row have it.
+//
+//   everything else    The change from the previous sample (or from 0
+//                      for the first), as a signed varint.
+//
+// Each block begins with a "zone map": the smallest and largest value
+// of every column in the block.  A query can then skip any block whose
+// range for some column cannot satisfy it, and of the blocks it does
+// look at, only decode the columns it needs.  For the button bits,
+// "smallest" and "largest" are in the subset order: the buttons held in
+// every sample of the block (bitwise AND), and those held in any (OR).
+//
+// Blocks are independent, so writing needs only one block of memory
+// however long the session, and so does reading.
+//
+// The file layout, using the varints of varint.h, is:
+//
+//   header:
+//     8 bytes    magic: "GPVCOLS" LF
+//     varint     format version, currently 1
+//   then any number of blocks:
+//     varint     length of the block header that follows
+//     block header:
+//       varint     number of samples
+//       for each column, in `ArchiveColumn` order:
+//         signed varint  smallest value
+//         varint         largest minus smallest
+//       for each column:
+//         varint     length of its encoded data
+//     each column's encoded data, in order
+
+#ifndef SESSION_ARCHIVE_H
+#define SESSION_ARCHIVE_H
+
+#include "controller-state.h"          // ControllerState
+
+#include <cstdint>                     // std::{int64_t, uint64_t}
+#include <istream>                     // std::istream
+#include <ostream>                     // std::ostream
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Current format version.
+int const SESSION_ARCHIVE_VERSION = 1;
+
+// Most samples in one block.
+int const ARCHIVE_BLOCK_SAMPLES = 4096;
+
+
+// The fields of a sample, each stored as a column.
+enum ArchiveColumn {
+  AC_TIME,                   // m_pollTimeMS
+  AC_CONNECTED,              // m_hasInputState, as 0 or 1
+  AC_PACKET,                 // dwPacketNumber
+  AC_BUTTONS,                // wButtons
+  AC_LEFT_TRIGGER,           // bLeftTrigger
+  AC_RIGHT_TRIGGER,          // bRightTrigger
+  AC_THUMB_LX,               // sThumbLX
+  AC_THUMB_LY,               // sThumbLY
+  AC_THUMB_RX,               // sThumbRX
+  AC_THUMB_RY,               // sThumbRY
+
+  NUM_ARCHIVE_COLUMNS
+};
+
+// Short name of `column`, like "lt", as `gpv-archive` accepts it.
+char const *toString(ArchiveColumn column);
+
+// Return the column whose name is `name`, or `NUM_ARCHIVE_COLUMNS` if
+// there is none.
+ArchiveColumn archiveColumnFromName(char const *name);
+
+// Value of `column` in `state`.
+std::int64_t archiveColumnValue(ControllerState const &state,
+                                ArchiveColumn column);
+
+
+// Smallest and largest value of a column in a block, as described
+// above.
+class ArchiveZoneMap {
+public:      // data
+  std::int64_t m_min;
+  std::int64_t m_max;
+
+public:      // methods
+  ArchiveZoneMap()
+    : m_min(0),
+      m_max(0)
+  {}
+};
+
+
+// A condition on one column: its value must be between `m_min` and
+// `m_max`, inclusive.  For `AC_BUTTONS`, it is again in the subset
+// order: the buttons in `m_min` must all be held, and any not in
+// `m_max` must be released.
+class ArchivePredicate {
+public:      // data
+  ArchiveColumn m_column;
+  std::int64_t m_min;
+  std::int64_t m_max;
+
+public:      // methods
+  ArchivePredicate(ArchiveColumn column, std::int64_t min,
+                   std::int64_t max);
+
+  // True if `value` of `m_column` satisfies this.
+  bool matches(std::int64_t value) const;
+
+  // False if no value in the range of `zone` can satisfy this.  For
+  // the buttons, this looks at each button separately, so it can be
+  // true even though no single sample matches.
+  bool mayMatch(ArchiveZoneMap const &zone) const;
+};
+
+
+// Writes an archive to a stream, one block at a time.
+class SessionArchiveWriter {
+public:      // data
+  // Stream to write to.  Not owned.
+  std::ostream &m_os;
+
+  // Number of samples and blocks written.
+  long m_sampleCount;
+  long m_blockCount;
+
+private:     // data
+  // Samples of the block being accumulated.
+  std::vector<ControllerState> m_block;
+
+  // Scratch buffers for the block header and the encoded columns.
+  std::string m_header;
+  std::string m_columns[NUM_ARCHIVE_COLUMNS];
+
+private:     // methods
+  // Encode and write `m_block`, and clear it.
+  void writeBlock();
+
+public:      // methods
+  explicit SessionArchiveWriter(std::ostream &os);
+
+  SessionArchiveWriter(SessionArchiveWriter const &obj) = delete;
+  SessionArchiveWriter &operator=(SessionArchiveWriter const &obj)
+    = delete;
+
+  // Write the file header.  Call this first.
+  void writeHeader();
+
+  // Append `state`.  Unlike a recording, every sample is kept, even if
+  // it repeats the previous one.
+  void writeSample(ControllerState const &state);
+
+  // Write the final, partial block.  Call this last.
+  void finish();
+
+  // True if no write has failed so far.
+  bool ok() const;
+};
+
+
+// Reads an archive a block at a time.
+class SessionArchiveReader {
+public:      // data
+  // Stream to read from.  Not owned.
+  std::istream &m_is;
+
+  // Number of samples in the current block, and of samples before it.
+  int m_blockSamples;
+  long m_firstSample;
+
+  // Zone maps of the current block.
+  ArchiveZoneMap m_zones[NUM_ARCHIVE_COLUMNS];
+
+  // The values of the columns decoded by `readColumns`, for the
+  // current block.
+  std::vector<std::int64_t> m_values[NUM_ARCHIVE_COLUMNS];
+
+  // Number of blocks whose header has been read, and of those whose
+  // columns were read.
+  long m_blocksSeen;
+  long m_blocksRead;
+
+  // If a read fails due to malformed input, a description of why.
+  std::string m_error;
+
+private:     // data
+  // Encoded length of each column of the current block.
+  std::uint64_t m_columnLengths[NUM_ARCHIVE_COLUMNS];
+
+  // True if the column data of the current block is still unread.
+  bool m_pendingData;
+
+  // Scratch buffer.
+  std::string m_buffer;
+
+private:     // methods
+  // Decode column `c` of the current block from `p` to `end`.
+  bool decodeColumn(ArchiveColumn c, char const *p, char const *end);
+
+public:      // methods
+  explicit SessionArchiveReader(std::istream &is);
+
+  // Read and check the file header.  Return an empty string on
+  // success, and an error message otherwise.
+  std::string readHeader();
+
+  // Move to the next block and read its header, skipping the data of
+  // the current one if it was not read.  Return false at the end of
+  // the stream or on error, in which case `m_error` is set.
+  bool nextBlock();
+
+  // Read the data of the current block, decoding the columns whose
+  // bits (`1 << column`) are set in `columnMask` into `m_values`.
+  // Return false on error, setting `m_error`.
+  bool readColumns(unsigned columnMask);
+
+  // True if every one of `predicates` may match some sample of the
+  // current block, according to its zone maps.
+  bool blockMayMatch(std::vector<ArchivePredicate> const &predicates)
+    const;
+};
+
+
+#endif // SESSION_ARCHIVE_H
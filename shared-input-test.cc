@@ -0,0 +1,153 @@
+// shared-input-test.cc
+// Tests for `shared-input` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "shared-input.h"              // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <atomic>                      // std::atomic
+#include <cstring>                     // std::{memcmp, memcpy}
+#include <filesystem>                  // std::filesystem
+#include <string>                      // std::string
+#include <thread>                      // std::thread
+
+namespace fs = std::filesystem;
+
+
+// Name of a region private to this run of the tests.
+static std::string regionName(char const *suffix)
+{
+  return fs::path(unitTestTempDir()).filename().string() + "-" + suffix;
+}
+
+
+// Fill `s` with the contents expected of sample number `n`, as
+// `gpv-shm stress` does: every word is derived from `n`.
+static void fillSample(SharedInputSample &s, std::uint64_t n)
+{
+  std::uint32_t words[SharedInputRegion::SAMPLE_WORDS];
+  for (int i=0; i < SharedInputRegion::SAMPLE_WORDS; ++i) {
+    words[i] = (std::uint32_t)(n * 2654435761u) + (std::uint32_t)i;
+  }
+  std::memcpy(&s, words, sizeof(s));
+  s.m_sampleNumber = n;
+}
+
+
+// True if `s` is intact sample number `s.m_sampleNumber`.
+static bool isIntact(SharedInputSample const &s)
+{
+  SharedInputSample expect;
+  fillSample(expect, s.m_sampleNumber);
+  return std::memcmp(&s, &expect, sizeof(s)) == 0;
+}
+
+
+UNIT_TEST(sharedInputPublishRead)
+{
+  std::string name = regionName("input");
+  SharedInputReader reader;
+  EXPECT(!reader.open(name).empty());
+
+  SharedInputPublisher publisher;
+  EXPECT_EQ(publisher.open(name), "");
+  EXPECT_EQ(reader.open(name), "");
+
+  // Nothing yet.
+  SharedInputSample s;
+  EXPECT(!reader.read(s));
+  EXPECT_EQ(reader.sequence(), (std::uint32_t)0);
+
+  SharedInputSample in;
+  fillSample(in, 1);
+  publisher.publish(in);
+  EXPECT(reader.read(s));
+  EXPECT_EQ(s.m_sampleNumber, (std::uint64_t)1);
+  EXPECT(isIntact(s));
+  std::uint32_t seq = reader.sequence();
+
+  // The publisher numbers the samples itself.
+  fillSample(in, 2);
+  in.m_sampleNumber = 77;
+  publisher.publish(in);
+  EXPECT(reader.sequence() != seq);
+  EXPECT(reader.read(s));
+  EXPECT_EQ(s.m_sampleNumber, (std::uint64_t)2);
+  EXPECT(isIntact(s));
+  EXPECT_EQ(publisher.sampleCount(), (std::uint64_t)2);
+
+  // Once the publisher closes, the name is gone, but a reader that has
+  // the region mapped still has the last sample.
+  publisher.close();
+  EXPECT(reader.read(s));
+  EXPECT_EQ(s.m_sampleNumber, (std::uint64_t)2);
+  SharedInputReader late;
+  EXPECT(!late.open(name).empty());
+}
+
+
+// A bounded `gpv-shm stress`: one thread publishes a fixed number of
+// samples as fast as it can, while this one reads them through its own
+// mapping.  No read may be torn or go backwards.
+UNIT_TEST(sharedInputNoTornReads)
+{
+  std::string name = regionName("stress");
+  SharedInputPublisher publisher;
+  EXPECT_EQ(publisher.open(name), "");
+  SharedInputReader reader;
+  EXPECT_EQ(reader.open(name), "");
+
+  std::uint64_t const numSamples = 2000000;
+  std::atomic<bool> reading(false);
+  std::atomic<bool> done(false);
+  std::thread writer([&] {
+    // Wait until the reader is running, so the two overlap even with
+    // one CPU.
+    while (!reading.load(std::memory_order_relaxed)) {
+      std::this_thread::yield();
+    }
+    SharedInputSample s;
+    for (std::uint64_t n=1; n <= numSamples; ++n) {
+      fillSample(s, n);
+      publisher.publish(s);
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  long reads = 0, newSamples = 0, torn = 0, backwards = 0;
+  std::uint64_t lastNumber = 0;
+  SharedInputSample s;
+  reading = true;
+  while (!done.load(std::memory_order_acquire)) {
+    // A read can fail if the writer is preempted mid-sample, or has
+    // not started.
+    if (!reader.read(s)) {
+      continue;
+    }
+    reads++;
+    torn += !isIntact(s);
+    if (s.m_sampleNumber < lastNumber) {
+      backwards++;
+    }
+    else if (s.m_sampleNumber > lastNumber) {
+      newSamples++;
+      lastNumber = s.m_sampleNumber;
+    }
+  }
+  writer.join();
+
+  EXPECT_EQ(torn, 0);
+  EXPECT_EQ(backwards, 0);
+  EXPECT(reads > 0);
+  EXPECT(newSamples > 1);
+
+  // Once the writer is done, the last sample is there, intact.
+  EXPECT(reader.read(s));
+  EXPECT_EQ(s.m_sampleNumber, numSamples);
+  EXPECT(isIntact(s));
+}
+
+
+// EOF
@@ -0,0 +1,312 @@
+// shared-input.cc
+// Code for `shared-input` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "shared-input.h"              // this module
+
+#include <cerrno>                      // errno
+#include <cstring>                     // std::{memcpy, strerror}
+#include <type_traits>                 // std::is_trivially_copyable
+
+#ifdef _WIN32
+  #include <windows.h>                 // CreateFileMappingW, etc.
+#else
+  #include <fcntl.h>                   // O_*
+  #include <sys/mman.h>                // shm_open, mmap, etc.
+  #include <sys/stat.h>                // fstat
+  #include <unistd.h>                  // ftruncate, close
+#endif
+
+
+static_assert(std::is_trivially_copyable<SharedInputSample>::value,
+              "samples are copied as raw memory");
+static_assert(sizeof(SharedInputSample) % 4 == 0,
+              "samples are copied as whole words");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+              "the region is shared between processes");
+
+
+// ------------------------ SharedInputMapping -------------------------
+SharedInputMapping::SharedInputMapping()
+  : m_name(),
+    m_region(nullptr),
+#ifdef _WIN32
+    m_mapping(nullptr),
+#endif
+    m_owner(false)
+{}
+
+
+SharedInputMapping::~SharedInputMapping()
+{
+  close();
+}
+
+
+#ifdef _WIN32
+
+// Return a message describing `GetLastError()`.
+static std::string lastErrorString(char const *what)
+{
+  return std::string(what) + " failed with code " +
+         std::to_string(GetLastError());
+}
+
+
+std::string SharedInputMapping::openMapping(std::string const &name,
+                                            bool create)
+{
+  close();
+
+  // Names are ASCII in practice.
+  std::wstring wname;
+  for (char c : name) {
+    wname.push_back((wchar_t)(unsigned char)c);
+  }
+
+  // A mapping backed by the paging file lives as long as some process
+  // has a handle to it, so there is nothing to remove in `close`.
+  if (create) {
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr,
+                                   PAGE_READWRITE, 0,
+                                   sizeof(SharedInputRegion),
+                                   wname.c_str());
+    if (!m_mapping) {
+      return lastErrorString("CreateFileMapping");
+    }
+  }
+  else {
+    m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wname.c_str());
+    if (!m_mapping) {
+      return lastErrorString("OpenFileMapping");
+    }
+  }
+
+  void *p = MapViewOfFile(m_mapping,
+                          create? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+                          0, 0, sizeof(SharedInputRegion));
+  if (!p) {
+    std::string error = lastErrorString("MapViewOfFile");
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+    return error;
+  }
+
+  m_name = name;
+  m_region = static_cast<SharedInputRegion*>(p);
+  m_owner = create;
+  return "";
+}
+
+
+void SharedInputMapping::close()
+{
+  if (m_region) {
+    UnmapViewOfFile(m_region);
+    m_region = nullptr;
+  }
+  if (m_mapping) {
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+  }
+  m_owner = false;
+}
+
+#else // !_WIN32
+
+// Return a message for `errno` after `what` failed.
+static std::string errnoString(char const *what)
+{
+  return std::string(what) + ": " + std::strerror(errno);
+}
+
+
+// POSIX shared memory names start with a slash.
+static std::string shmName(std::string const &name)
+{
+  return "/" + name;
+}
+
+
+std::string SharedInputMapping::openMapping(std::string const &name,
+                                            bool create)
+{
+  close();
+
+  int fd = shm_open(shmName(name).c_str(),
+                    create? (O_RDWR | O_CREAT) : O_RDONLY,
+                    0644);
+  if (fd < 0) {
+    return errnoString("shm_open");
+  }
+
+  if (create) {
+    if (ftruncate(fd, sizeof(SharedInputRegion)) < 0) {
+      std::string error = errnoString("ftruncate");
+      ::close(fd);
+      return error;
+    }
+  }
+  else {
+    // The publisher may not have sized it yet.
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      std::string error = errnoString("fstat");
+      ::close(fd);
+      return error;
+    }
+    if ((std::size_t)st.st_size < sizeof(SharedInputRegion)) {
+      ::close(fd);
+      return "region is too small";
+    }
+  }
+
+  void *p = mmap(nullptr, sizeof(SharedInputRegion),
+                 create? (PROT_READ | PROT_WRITE) : PROT_READ,
+                 MAP_SHARED, fd, 0);
+
+  // The mapping keeps the object alive, so the descriptor is not
+  // needed either way.
+  ::close(fd);
+
+  if (p == MAP_FAILED) {
+    return errnoString("mmap");
+  }
+
+  m_name = name;
+  m_region = static_cast<SharedInputRegion*>(p);
+  m_owner = create;
+  return "";
+}
+
+
+void SharedInputMapping::close()
+{
+  if (m_region) {
+    munmap(m_region, sizeof(SharedInputRegion));
+    m_region = nullptr;
+
+    if (m_owner) {
+      shm_unlink(shmName(m_name).c_str());
+    }
+  }
+  m_owner = false;
+}
+
+#endif // !_WIN32
+
+
+// ------------------------ SharedInputPublisher -----------------------
+SharedInputPublisher::SharedInputPublisher()
+  : SharedInputMapping(),
+    m_sampleCount(0)
+{}
+
+
+std::string SharedInputPublisher::open(std::string const &name)
+{
+  std::string error = openMapping(name, true /*create*/);
+  if (!error.empty()) {
+    return error;
+  }
+
+  // These never change for a given version, so rewriting them over a
+  // region left by a previous publisher does not disturb its readers.
+  m_region->m_magic = SharedInputRegion::MAGIC;
+  m_region->m_version = SharedInputRegion::VERSION;
+  m_region->m_sampleSize = sizeof(SharedInputSample);
+
+  // If the previous publisher died while writing, the sequence is
+  // stuck at odd, which would make readers spin.
+  std::uint32_t seq = m_region->m_sequence.load(std::memory_order_relaxed);
+  if (seq & 1) {
+    m_region->m_sequence.store(seq+1, std::memory_order_release);
+  }
+
+  m_sampleCount = 0;
+  return "";
+}
+
+
+void SharedInputPublisher::publish(SharedInputSample &sample)
+{
+  sample.m_sampleNumber = ++m_sampleCount;
+
+  std::uint32_t words[SharedInputRegion::SAMPLE_WORDS];
+  std::memcpy(words, &sample, sizeof(sample));
+
+  // This is the usual sequence lock write.  The release fence keeps the
+  // sample stores from becoming visible before the odd sequence number.
+  std::atomic<std::uint32_t> &sequence = m_region->m_sequence;
+  std::uint32_t seq = sequence.load(std::memory_order_relaxed);
+  sequence.store(seq+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (int i=0; i < SharedInputRegion::SAMPLE_WORDS; ++i) {
+    m_region->m_sample[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  // Skip 0 on wraparound, since that means "nothing published".
+  std::uint32_t next = seq+2;
+  if (next == 0) {
+    next = 2;
+  }
+  sequence.store(next, std::memory_order_release);
+}
+
+
+// ------------------------- SharedInputReader -------------------------
+std::string SharedInputReader::open(std::string const &name)
+{
+  return openMapping(name, false /*create*/);
+}
+
+
+bool SharedInputReader::read(SharedInputSample &sample /*OUT*/,
+                             int maxAttempts) const
+{
+  std::atomic<std::uint32_t> const &sequence = m_region->m_sequence;
+  std::uint32_t words[SharedInputRegion::SAMPLE_WORDS];
+
+  for (int attempt=0; attempt < maxAttempts; ++attempt) {
+    std::uint32_t before = sequence.load(std::memory_order_acquire);
+    if (before == 0) {
+      return false;
+    }
+    if (before & 1) {
+      // Being written.
+      continue;
+    }
+
+    if (m_region->m_magic != SharedInputRegion::MAGIC ||
+        m_region->m_version != SharedInputRegion::VERSION ||
+        m_region->m_sampleSize != sizeof(SharedInputSample)) {
+      return false;
+    }
+
+    for (int i=0; i < SharedInputRegion::SAMPLE_WORDS; ++i) {
+      words[i] = m_region->m_sample[i].load(std::memory_order_relaxed);
+    }
+
+    // The acquire fence keeps the sample loads from moving after the
+    // second sequence load, so if it has not changed, none of the
+    // words came from a later write.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) == before) {
+      std::memcpy(&sample, words, sizeof(sample));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+std::uint32_t SharedInputReader::sequence() const
+{
+  return m_region->m_sequence.load(std::memory_order_acquire);
+}
+
+
+// EOF
@@ -0,0 +1,227 @@
+// shared-input.h
+// `SharedInputPublisher` and `SharedInputReader`, which make the
+// viewer's input and timer state available to other processes.
+
+// See license.txt for copyright and terms of use.
+
+// The viewer (with `PUBLISH_INPUT` set) writes every input sample it
+// polls, along with the timer states and accuracy classifications it
+// derives from them, into a small named shared-memory region.  Other
+// programs, such as streaming overlays, can then show the same state
+// without polling the controller themselves.
+//
+// The region holds only the latest sample, guarded by a sequence lock:
+// the writer makes the sequence number odd, writes the sample, and
+// makes it even again, and a reader retries if the number was odd or
+// changed while it was copying.  The writer never waits for readers,
+// so any number of them cannot slow down polling.
+//
+// On Windows the region is a named file mapping (paging-file backed),
+// and elsewhere it is a POSIX shared memory object.  Readers only need
+// this module, which is built on its own as libgpvshm.a.
+
+#ifndef SHARED_INPUT_H
+#define SHARED_INPUT_H
+
+#include "windows-compat.h"            // XINPUT_STATE
+
+#include <atomic>                      // std::atomic
+#include <cstdint>                     // std::{uint32_t, uint64_t}
+#include <string>                      // std::string
+
+#ifdef _WIN32
+  #include <windows.h>                 // HANDLE
+#endif
+
+
+// Name used if `PUBLISH_INPUT` is set to 1 rather than a name.
+#define SHARED_INPUT_DEFAULT_NAME "gamepad-viewer-input"
+
+
+// State of one button timer in a `SharedInputSample`.
+class SharedTimerState {
+public:      // data
+  // 1 if the timer is running, 0 if not, in which case the counts
+  // below are 0.
+  std::uint32_t m_running;
+
+  // 1 if another run is queued behind the current one.
+  std::uint32_t m_queued;
+
+  // Milliseconds since the timer started.
+  std::uint32_t m_elapsedMS;
+
+  // Classification relative to the active window, as a
+  // `ButtonWindowState`, or -1 if the timer is not running or has no
+  // window, and its frame counts, as returned by
+  // `InputModel::parryWindowState`.
+  std::int32_t m_windowState;
+  std::int32_t m_frameDelta;
+  std::int32_t m_maxFrame;
+};
+
+
+// One published sample.
+//
+// This is copied between processes as raw memory, so every field has a
+// fixed size, and anything added has to go at the end along with an
+// increase of `SharedInputRegion::VERSION`.
+class SharedInputSample {
+public:      // data
+  // Number of samples published so far, including this one, by the
+  // current publisher.  Readers can compare this to the previous value
+  // to see whether anything is new, or how many samples they missed.
+  std::uint64_t m_sampleNumber;
+
+  // When the sample was polled, on the publisher's steady clock, in
+  // microseconds.  See `steadyClockUS`.
+  std::uint64_t m_pollTimeUS;
+
+  // When the sample was polled, per `GetTickCount()`.
+  std::uint32_t m_pollTimeMS;
+
+  // Which controller was polled.
+  std::uint32_t m_controllerID;
+
+  // 1 if `m_inputState` is valid, 0 if the controller was not
+  // connected.
+  std::uint32_t m_hasInputState;
+
+  // The input, as returned by `XInputGetState`.
+  XINPUT_STATE m_inputState;
+
+  // The timers, as of this sample.
+  SharedTimerState m_parryTimer;
+  SharedTimerState m_dodgeReleaseTimer;
+  SharedTimerState m_dodgeInvulnerabilityTimer;
+
+  // 1 if the parry or dodge invulnerability window is active.
+  std::uint32_t m_parryActive;
+  std::uint32_t m_dodgeInvulnerabilityActive;
+};
+
+
+// Layout of the shared-memory region.  This is the same in every
+// process, since it consists of fixed-size fields.
+class SharedInputRegion {
+public:      // types
+  enum {
+    // Value of `m_magic`: "GPVI".
+    MAGIC = 0x49565047,
+
+    // Layout version.  Readers should reject other versions.
+    VERSION = 1,
+
+    // Number of 32-bit words in a `SharedInputSample`.
+    SAMPLE_WORDS = (sizeof(SharedInputSample) + 3) / 4,
+  };
+
+public:      // data
+  // Identification, set before the first sample is published.
+  std::uint32_t m_magic;
+  std::uint32_t m_version;
+  std::uint32_t m_sampleSize;
+
+  // Sequence lock.  Odd while `m_sample` is being written, and
+  // incremented twice per sample, so 0 means nothing has been
+  // published yet.
+  std::atomic<std::uint32_t> m_sequence;
+
+  // The latest sample, as words so that copying it in and out is
+  // well defined even while the other side is doing the same.
+  std::atomic<std::uint32_t> m_sample[SAMPLE_WORDS];
+};
+
+
+// A mapping of a named `SharedInputRegion`.
+class SharedInputMapping {
+protected:   // data
+  // Name of the region, as given to `open`.
+  std::string m_name;
+
+  // Mapped region, or null if not open.
+  SharedInputRegion *m_region;
+
+#ifdef _WIN32
+  // File mapping object.
+  HANDLE m_mapping;
+#endif
+
+  // True if this created the region, and hence should remove the name
+  // on `close`.
+  bool m_owner;
+
+protected:   // methods
+  SharedInputMapping();
+  ~SharedInputMapping();
+
+  // Map `name`, creating it (for the publisher) or opening an existing
+  // one (for a reader).  Return an empty string on success or an error
+  // message on failure.
+  std::string openMapping(std::string const &name, bool create);
+
+public:      // methods
+  SharedInputMapping(SharedInputMapping const &obj) = delete;
+  SharedInputMapping &operator=(SharedInputMapping const &obj) = delete;
+
+  bool isOpen() const
+    { return m_region != nullptr; }
+
+  // Unmap the region.  If this created it, also remove its name, so
+  // later readers will not find it, although those that already have
+  // it mapped can keep reading the last sample.
+  void close();
+};
+
+
+// Writes samples into a region.  There should be only one publisher
+// per name.
+class SharedInputPublisher : public SharedInputMapping {
+private:     // data
+  // Samples published so far.
+  std::uint64_t m_sampleCount;
+
+public:      // methods
+  SharedInputPublisher();
+
+  // Create the region `name`, or take over an existing one left
+  // behind by a publisher that did not exit cleanly.  Return an empty
+  // string on success or an error message on failure.
+  std::string open(std::string const &name);
+
+  // Publish `sample`, replacing the previous one.  This sets its
+  // `m_sampleNumber`.  It never waits, and does not allocate.
+  void publish(SharedInputSample &sample);
+
+  // Samples published so far.
+  std::uint64_t sampleCount() const
+    { return m_sampleCount; }
+};
+
+
+// Reads samples from a region.
+class SharedInputReader : public SharedInputMapping {
+public:      // methods
+  SharedInputReader() {}
+
+  // Open the existing region `name`.  Return an empty string on
+  // success or an error message on failure, which includes the
+  // publisher not running.
+  std::string open(std::string const &name);
+
+  // Copy the latest sample to `sample`.  Return false if nothing has
+  // been published yet, the region has an unknown layout, or the
+  // publisher was writing on each of `maxAttempts` tries.  Writing
+  // takes well under a microsecond, so the last only happens if the
+  // publisher was preempted in the middle, and trying again later
+  // will work.
+  bool read(SharedInputSample &sample /*OUT*/,
+            int maxAttempts = 1000) const;
+
+  // Current sequence number.  This changes whenever a new sample is
+  // published, so polling it is a cheap way to wait for one.
+  std::uint32_t sequence() const;
+};
+
+
+#endif // SHARED_INPUT_H
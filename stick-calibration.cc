@@ -0,0 +1,525 @@
+// stick-calibration.cc
+// Code for `stick-calibration` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "stick-calibration.h"         // this module
+
+#include <algorithm>                   // std::{max, max_element, sort}
+#include <cassert>                     // assert
+#include <cstdio>                      // std::snprintf
+#include <sstream>                     // std::ostringstream
+#include <utility>                     // std::pair
+
+
+// Indexed by `CalibrationStep`.
+static CalibrationStepInfo const s_stepInfo[NUM_CALIBRATION_STEPS] = {
+  { "rest",
+    "Leave both sticks alone.",
+    3000, true, DZS_SQUARE, 0,
+    nullptr },
+
+  { "walk",
+    "Slowly push the left stick outward in all directions.  "
+    "Hold A while the character moves.",
+    20000, true, DZS_OCTAGON, XINPUT_GAMEPAD_A,
+    &AnalogThresholdConfig::m_leftStickWalkThreshold },
+
+  { "run",
+    "Slowly push the left stick outward in all directions.  "
+    "Hold A while the character runs.",
+    20000, true, DZS_CIRCLE, XINPUT_GAMEPAD_A,
+    &AnalogThresholdConfig::m_leftStickRunThreshold },
+
+  { "sprint",
+    "On Torrent, slowly push the left stick outward in all "
+    "directions.  Hold A while he keeps galloping.",
+    20000, true, DZS_CIRCLE, XINPUT_GAMEPAD_A,
+    &AnalogThresholdConfig::m_leftStickSprintThreshold },
+
+  { "right stick",
+    "Slowly push the right stick outward in all directions.  "
+    "Hold D-pad down while the camera moves.",
+    20000, false, DZS_SQUARE, XINPUT_GAMEPAD_DPAD_DOWN,
+    &AnalogThresholdConfig::m_rightStickDeadZone },
+};
+
+
+CalibrationStepInfo const &calibrationStepInfo(CalibrationStep step)
+{
+  assert(0 <= step && step < NUM_CALIBRATION_STEPS);
+  return s_stepInfo[step];
+}
+
+
+// ---------------------------- StickSamples ---------------------------
+StickSamples::StickSamples()
+  : m_x(),
+    m_y(),
+    m_active()
+{}
+
+
+void StickSamples::add(SHORT x, SHORT y, bool active)
+{
+  m_x.push_back(x);
+  m_y.push_back(y);
+  m_active.push_back(active);
+}
+
+
+void StickSamples::clear()
+{
+  m_x.clear();
+  m_y.clear();
+  m_active.clear();
+}
+
+
+// ----------------------------- StickNoise ----------------------------
+StickNoise::StickNoise()
+  : m_count(0),
+    m_meanX(0),
+    m_meanY(0),
+    m_maxNorm{0, 0, 0}
+{}
+
+
+StickNoise measureStickNoise(StickSamples const &samples)
+{
+  StickNoise ret;
+  std::size_t const n = samples.size();
+  if (n == 0) {
+    return ret;
+  }
+
+  double sumX = 0;
+  double sumY = 0;
+  for (std::size_t i=0; i < n; ++i) {
+    sumX += samples.m_x[i];
+    sumY += samples.m_y[i];
+  }
+  ret.m_count = (long)n;
+  ret.m_meanX = (float)(sumX / n);
+  ret.m_meanY = (float)(sumY / n);
+
+  std::vector<float> norms(n);
+  for (DeadZoneShape shape : { DZS_SQUARE, DZS_OCTAGON, DZS_CIRCLE }) {
+    stickNormBatch(samples.m_x.data(), samples.m_y.data(), n, shape,
+                   norms.data());
+    ret.m_maxNorm[shape] = *std::max_element(norms.begin(), norms.end());
+  }
+
+  return ret;
+}
+
+
+// ---------------------------- ThresholdFit ---------------------------
+ThresholdFit::ThresholdFit()
+  : m_valid(false),
+    m_threshold(0),
+    m_errors(0),
+    m_count(0)
+{}
+
+
+// Given (norm, label) pairs, set `threshold` to the value that
+// misclassifies the fewest.  Return false if all have the same label.
+static bool bestSplit(std::vector<std::pair<float, bool>> &pairs,
+                      float &threshold /*OUT*/)
+{
+  std::size_t const n = pairs.size();
+  long numActive = 0;
+  for (auto const &p : pairs) {
+    numActive += p.second;
+  }
+  if (numActive == 0 || numActive == (long)n) {
+    return false;
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  // With the threshold between `pairs[k-1]` and `pairs[k]`, the errors
+  // are the active samples below it plus the inactive ones above it.
+  // Start with it below everything and move it up, collecting the
+  // splits with the fewest errors.
+  long errors = (long)n - numActive;
+  long bestErrors = errors;
+  std::vector<std::size_t> bestKs(1, 0);
+  for (std::size_t k=1; k <= n; ++k) {
+    errors += pairs[k-1].second? +1 : -1;
+
+    // Only split between distinct values.
+    if (k < n && pairs[k-1].first == pairs[k].first) {
+      continue;
+    }
+    if (errors < bestErrors) {
+      bestErrors = errors;
+      bestKs.clear();
+    }
+    if (errors == bestErrors) {
+      bestKs.push_back(k);
+    }
+  }
+
+  // Take the middle of a run of equally good splits.
+  std::size_t k = bestKs[bestKs.size() / 2];
+  float below = k > 0? pairs[k-1].first : 0;
+  float above = k < n? pairs[k].first : below + 2;
+  threshold = (below + above) / 2;
+  return true;
+}
+
+
+ThresholdFit fitStickThreshold(StickSamples const &samples,
+                               DeadZoneShape shape)
+{
+  ThresholdFit ret;
+  std::size_t const n = samples.size();
+  ret.m_count = (long)n;
+
+  std::vector<float> norms(n);
+  stickNormBatch(samples.m_x.data(), samples.m_y.data(), n, shape,
+                 norms.data());
+
+  // The label flips late, by the user's reaction time, both when the
+  // stick is pushed out past the boundary and when it is let back in,
+  // so fitting all samples at once is biased toward wherever the
+  // sweep happened to linger.  Instead, fit the outward and inward
+  // movements separately and average them, which cancels the delay.
+  std::vector<std::pair<float, bool>> outward;
+  std::vector<std::pair<float, bool>> inward;
+  bool movingOut = true;
+  for (std::size_t i=0; i < n; ++i) {
+    if (i > 0 && norms[i] != norms[i-1]) {
+      movingOut = norms[i] > norms[i-1];
+    }
+    (movingOut? outward : inward).push_back(
+      std::make_pair(norms[i], samples.m_active[i] != 0));
+  }
+
+  float outThreshold, inThreshold;
+  bool outValid = bestSplit(outward, outThreshold);
+  bool inValid = bestSplit(inward, inThreshold);
+  if (outValid && inValid) {
+    ret.m_threshold = (int)((outThreshold + inThreshold) / 2);
+  }
+  else if (outValid || inValid) {
+    ret.m_threshold = (int)(outValid? outThreshold : inThreshold);
+  }
+  else {
+    return ret;
+  }
+
+  // Count the samples on the wrong side of the threshold that will
+  // actually be used.
+  ret.m_errors = 0;
+  for (std::size_t i=0; i < n; ++i) {
+    bool active = norms[i] > ret.m_threshold;
+    ret.m_errors += active != (samples.m_active[i] != 0);
+  }
+  ret.m_valid = true;
+  return ret;
+}
+
+
+// ------------------------- CalibrationResult -------------------------
+CalibrationResult::CalibrationResult()
+  : m_leftNoise(),
+    m_rightNoise(),
+    m_fits()
+{}
+
+
+int CalibrationResult::apply(AnalogThresholdConfig &thr) const
+{
+  int count = 0;
+  for (int s=CS_REST+1; s < NUM_CALIBRATION_STEPS; ++s) {
+    if (m_fits[s].m_valid) {
+      thr.*(s_stepInfo[s].m_field) = m_fits[s].m_threshold;
+      count++;
+    }
+  }
+  return count;
+}
+
+
+// Append a description of `noise` to `oss`.
+static void describeNoise(std::ostringstream &oss, char const *side,
+                          StickNoise const &noise)
+{
+  char buf[120];
+  std::snprintf(buf, sizeof(buf),
+    "%s stick at rest: center %.1f %.1f, max square %.0f, "
+    "octagon %.0f, circle %.0f (%ld samples)\n",
+    side, noise.m_meanX, noise.m_meanY,
+    noise.m_maxNorm[DZS_SQUARE], noise.m_maxNorm[DZS_OCTAGON],
+    noise.m_maxNorm[DZS_CIRCLE], noise.m_count);
+  oss << buf;
+}
+
+
+std::string CalibrationResult::report(AnalogThresholdConfig const &old) const
+{
+  std::ostringstream oss;
+  describeNoise(oss, "left", m_leftNoise);
+  describeNoise(oss, "right", m_rightNoise);
+
+  for (int s=CS_REST+1; s < NUM_CALIBRATION_STEPS; ++s) {
+    CalibrationStepInfo const &info = s_stepInfo[s];
+    ThresholdFit const &fit = m_fits[s];
+    oss << info.m_name << ": ";
+
+    if (!fit.m_valid) {
+      oss << "not enough samples with and without "
+          << (info.m_labelButton == XINPUT_GAMEPAD_A? "A" : "D-pad down")
+          << " held; keeping " << old.*(info.m_field) << "\n";
+      continue;
+    }
+
+    char buf[80];
+    std::snprintf(buf, sizeof(buf), "%d (was %d), %.1f%% of %ld off",
+      fit.m_threshold, old.*(info.m_field),
+      100.0 * fit.m_errors / fit.m_count, fit.m_count);
+    oss << buf;
+
+    StickNoise const &noise = info.m_leftSide? m_leftNoise : m_rightNoise;
+    if (noise.m_count > 0 &&
+        fit.m_threshold <= noise.m_maxNorm[info.m_shape]) {
+      oss << ", WITHIN RESTING NOISE";
+    }
+    oss << "\n";
+  }
+
+  return oss.str();
+}
+
+
+// -------------------------- StickCalibrator --------------------------
+StickCalibrator::StickCalibrator()
+  : m_running(false),
+    m_step(CS_REST),
+    m_stepStarted(false),
+    m_stepStartMS(0),
+    m_lastSampleMS(0),
+    m_restLeft(),
+    m_restRight(),
+    m_sweeps()
+{}
+
+
+void StickCalibrator::beginStep(CalibrationStep step)
+{
+  m_step = step;
+  m_stepStarted = false;
+}
+
+
+void StickCalibrator::start()
+{
+  m_restLeft.clear();
+  m_restRight.clear();
+  for (StickSamples &s : m_sweeps) {
+    s.clear();
+  }
+
+  m_running = true;
+  beginStep(CS_REST);
+}
+
+
+int StickCalibrator::remainingMS() const
+{
+  int duration = s_stepInfo[m_step].m_durationMS;
+  if (!m_stepStarted) {
+    return duration;
+  }
+  return std::max(0, duration - (int)(m_lastSampleMS - m_stepStartMS));
+}
+
+
+bool StickCalibrator::addSample(ControllerState const &state)
+{
+  if (!m_running || !state.m_hasInputState) {
+    return false;
+  }
+
+  m_lastSampleMS = state.m_pollTimeMS;
+  if (!m_stepStarted) {
+    m_stepStarted = true;
+    m_stepStartMS = state.m_pollTimeMS;
+  }
+
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  CalibrationStepInfo const &info = s_stepInfo[m_step];
+  if (m_step == CS_REST) {
+    m_restLeft.add(g.sThumbLX, g.sThumbLY, false);
+    m_restRight.add(g.sThumbRX, g.sThumbRY, false);
+  }
+  else {
+    bool active = state.isButtonPressed(info.m_labelButton);
+    if (info.m_leftSide) {
+      m_sweeps[m_step].add(g.sThumbLX, g.sThumbLY, active);
+    }
+    else {
+      m_sweeps[m_step].add(g.sThumbRX, g.sThumbRY, active);
+    }
+  }
+
+  if (remainingMS() == 0) {
+    return nextStep();
+  }
+  return false;
+}
+
+
+bool StickCalibrator::nextStep()
+{
+  if (!m_running) {
+    return false;
+  }
+
+  if (m_step+1 < NUM_CALIBRATION_STEPS) {
+    beginStep((CalibrationStep)(m_step+1));
+    return false;
+  }
+  else {
+    m_running = false;
+    return true;
+  }
+}
+
+
+void StickCalibrator::cancel()
+{
+  m_running = false;
+}
+
+
+CalibrationResult StickCalibrator::result() const
+{
+  CalibrationResult ret;
+  ret.m_leftNoise = measureStickNoise(m_restLeft);
+  ret.m_rightNoise = measureStickNoise(m_restRight);
+  for (int s=CS_REST+1; s < NUM_CALIBRATION_STEPS; ++s) {
+    ret.m_fits[s] = fitStickThreshold(m_sweeps[s], s_stepInfo[s].m_shape);
+  }
+  return ret;
+}
+
+
+// ---------------------------- DriftRecord ----------------------------
+DriftRecord::DriftRecord()
+  : m_controllerID(0),
+    m_endMS(0),
+    m_count{0, 0},
+    m_meanX{0, 0},
+    m_meanY{0, 0}
+{}
+
+
+std::string DriftRecord::toString() const
+{
+  char buf[120];
+  std::snprintf(buf, sizeof(buf),
+    "controller %d: left %.1f %.1f (%ld), right %.1f %.1f (%ld)",
+    m_controllerID,
+    m_meanX[0], m_meanY[0], m_count[0],
+    m_meanX[1], m_meanY[1], m_count[1]);
+  return buf;
+}
+
+
+// ------------------------- StickDriftTracker -------------------------
+StickDriftTracker::Accumulator::Accumulator()
+  : m_started(false),
+    m_startMS(0),
+    m_record(),
+    m_sumX{0, 0},
+    m_sumY{0, 0}
+{}
+
+
+StickDriftTracker::StickDriftTracker(int intervalMS)
+  : m_intervalMS(intervalMS),
+    m_accumulators(),
+    m_finished(),
+    m_first(),
+    m_latest()
+{}
+
+
+void StickDriftTracker::add(int controllerID, ControllerState const &state,
+                            AnalogThresholdConfig const &thr)
+{
+  if (!state.m_hasInputState) {
+    return;
+  }
+
+  Accumulator &acc = m_accumulators[controllerID];
+  if (!acc.m_started) {
+    acc.m_started = true;
+    acc.m_startMS = state.m_pollTimeMS;
+    acc.m_record.m_controllerID = controllerID;
+  }
+
+  XINPUT_GAMEPAD const &g = state.m_inputState.Gamepad;
+  SHORT const x[2] = { g.sThumbLX, g.sThumbRX };
+  SHORT const y[2] = { g.sThumbLY, g.sThumbRY };
+  for (int side=0; side < 2; ++side) {
+    StickParams params = StickParams::forStick(thr, side == 0);
+    if (stickNorm(x[side], y[side], params.m_deadZoneShape) <=
+          params.m_deadZone) {
+      acc.m_sumX[side] += x[side];
+      acc.m_sumY[side] += y[side];
+      acc.m_record.m_count[side]++;
+    }
+  }
+  acc.m_record.m_endMS = state.m_pollTimeMS;
+
+  if ((int)(state.m_pollTimeMS - acc.m_startMS) >= m_intervalMS) {
+    DriftRecord &rec = acc.m_record;
+    if (rec.m_count[0] + rec.m_count[1] > 0) {
+      for (int side=0; side < 2; ++side) {
+        if (rec.m_count[side] > 0) {
+          rec.m_meanX[side] = (float)(acc.m_sumX[side] / rec.m_count[side]);
+          rec.m_meanY[side] = (float)(acc.m_sumY[side] / rec.m_count[side]);
+        }
+      }
+      m_finished.push_back(rec);
+      if (m_first.find(controllerID) == m_first.end()) {
+        m_first[controllerID] = rec;
+      }
+      m_latest[controllerID] = rec;
+    }
+
+    acc = Accumulator();
+  }
+}
+
+
+bool StickDriftTracker::takeRecord(DriftRecord &rec)
+{
+  if (m_finished.empty()) {
+    return false;
+  }
+  rec = m_finished.front();
+  m_finished.pop_front();
+  return true;
+}
+
+
+bool StickDriftTracker::firstAndLatest(int controllerID,
+                                       DriftRecord &first,
+                                       DriftRecord &latest) const
+{
+  auto it = m_first.find(controllerID);
+  if (it == m_first.end()) {
+    return false;
+  }
+  first = it->second;
+  latest = m_latest.at(controllerID);
+  return true;
+}
+
+
+// EOF
@@ -0,0 +1,293 @@
+// stick-calibration.h
+// Fitting stick thresholds to labelled samples, and tracking drift.
+
+// See license.txt for copyright and terms of use.
+
+// The default `AnalogThresholdConfig` values come from measurements
+// made by hand (doc/elden-ring-dead-zones.txt).  `StickCalibrator`
+// automates that: it collects the stick positions while the sticks are
+// left alone, to measure the resting noise, and then while the user
+// slowly sweeps each stick outward holding a "label" button whenever
+// the game responds, and fits each threshold to the point where the
+// label flips.
+//
+// `StickDriftTracker` separately watches the resting position of each
+// stick during normal use, so that a controller whose center wanders
+// over time can be noticed.
+
+#ifndef STICK_CALIBRATION_H
+#define STICK_CALIBRATION_H
+
+#include "controller-state.h"          // ControllerState
+#include "gpv-config.h"                // AnalogThresholdConfig
+#include "stick-kernel.h"              // DeadZoneShape
+#include "windows-compat.h"            // DWORD, SHORT, WORD
+
+#include <cstddef>                     // std::size_t
+#include <deque>                       // std::deque
+#include <map>                         // std::map
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// The phases of a calibration, in order.
+enum CalibrationStep {
+  CS_REST,                   // Both sticks left alone.
+  CS_WALK,                   // Left stick, walk (octagon) threshold.
+  CS_RUN,                    // Left stick, run (circle) threshold.
+  CS_SPRINT,                 // Left stick, sprint (circle) threshold.
+  CS_RIGHT_STICK,            // Right stick, square dead zone.
+
+  NUM_CALIBRATION_STEPS
+};
+
+
+// What a step measures and how the user is told to do it.
+class CalibrationStepInfo {
+public:      // data
+  // Short name for reports.
+  char const *m_name;
+
+  // Instructions to display.
+  char const *m_prompt;
+
+  // How long the step lasts.
+  int m_durationMS;
+
+  // Which stick is swept.  Ignored for `CS_REST`.
+  bool m_leftSide;
+
+  // Shape of the boundary being found.
+  DeadZoneShape m_shape;
+
+  // Button to hold while the game responds, or 0 for `CS_REST`.
+  WORD m_labelButton;
+
+  // Field the fitted threshold goes into, or null for `CS_REST`.
+  int AnalogThresholdConfig::*m_field;
+};
+
+// Return the description of `step`.
+CalibrationStepInfo const &calibrationStepInfo(CalibrationStep step);
+
+
+// Positions of one stick, and for each, whether the label button was
+// held, as parallel arrays for `stickNormBatch`.
+class StickSamples {
+public:      // data
+  std::vector<SHORT> m_x;
+  std::vector<SHORT> m_y;
+  std::vector<unsigned char> m_active;
+
+public:      // methods
+  StickSamples();
+
+  void add(SHORT x, SHORT y, bool active);
+
+  std::size_t size() const
+    { return m_x.size(); }
+
+  void clear();
+};
+
+
+// Resting behavior of one stick.
+class StickNoise {
+public:      // data
+  // Number of samples measured.  The rest is zero if there are none.
+  long m_count;
+
+  // Average position, which would be (0,0) for a perfect stick.
+  float m_meanX;
+  float m_meanY;
+
+  // Largest `stickNorm` seen for each `DeadZoneShape`.  A threshold at
+  // or below this would be crossed without touching the stick.
+  float m_maxNorm[3];
+
+public:      // methods
+  StickNoise();
+};
+
+// Measure `samples`, ignoring their labels.
+StickNoise measureStickNoise(StickSamples const &samples);
+
+
+// Threshold that best separates labelled samples.
+class ThresholdFit {
+public:      // data
+  // False if there were no samples on one side of the boundary, in
+  // which case the rest is meaningless.
+  bool m_valid;
+
+  // Positions are classified as active when their `stickNorm` is
+  // greater than this.
+  int m_threshold;
+
+  // Samples on the wrong side of `m_threshold`, and total samples.
+  long m_errors;
+  long m_count;
+
+public:      // methods
+  ThresholdFit();
+};
+
+// Find the threshold for `shape` that best separates `samples`, which
+// must be in the order they were collected.
+ThresholdFit fitStickThreshold(StickSamples const &samples,
+                               DeadZoneShape shape);
+
+
+// Outcome of a calibration.
+class CalibrationResult {
+public:      // data
+  // Resting noise of the left and right sticks.
+  StickNoise m_leftNoise;
+  StickNoise m_rightNoise;
+
+  // Fit for each step other than `CS_REST`.
+  ThresholdFit m_fits[NUM_CALIBRATION_STEPS];
+
+public:      // methods
+  CalibrationResult();
+
+  // Store each valid fit in `thr`.  Return the number stored.
+  int apply(AnalogThresholdConfig &thr) const;
+
+  // Describe the result, one line per measurement, comparing the fits
+  // to `old`.
+  std::string report(AnalogThresholdConfig const &old) const;
+};
+
+
+// Runs the calibration steps, collecting samples.
+class StickCalibrator {
+private:     // data
+  // True between `start` and the end of the last step.
+  bool m_running;
+
+  // Current step, if running.
+  CalibrationStep m_step;
+
+  // True once the current step has seen a sample, which sets
+  // `m_stepStartMS`.
+  bool m_stepStarted;
+  DWORD m_stepStartMS;
+
+  // Time of the most recent sample.
+  DWORD m_lastSampleMS;
+
+  // Samples collected for `CS_REST`.
+  StickSamples m_restLeft;
+  StickSamples m_restRight;
+
+  // Samples for each other step.
+  StickSamples m_sweeps[NUM_CALIBRATION_STEPS];
+
+private:     // methods
+  void beginStep(CalibrationStep step);
+
+public:      // methods
+  StickCalibrator();
+
+  // Discard any previous samples and begin with `CS_REST`.
+  void start();
+
+  bool isRunning() const
+    { return m_running; }
+
+  // Current step.  Only meaningful if running.
+  CalibrationStep step() const
+    { return m_step; }
+
+  // Milliseconds left in the current step.
+  int remainingMS() const;
+
+  // Add a sample to the current step, moving to the next if its time
+  // is up.  Return true if that finished the last step.
+  bool addSample(ControllerState const &state);
+
+  // End the current step early.  Return true if it was the last.
+  bool nextStep();
+
+  // Stop without finishing.
+  void cancel();
+
+  // Fit the samples collected so far.
+  CalibrationResult result() const;
+};
+
+
+// Average resting position of a controller's sticks over an interval.
+class DriftRecord {
+public:      // data
+  int m_controllerID;
+
+  // Time of the last sample in the interval.
+  DWORD m_endMS;
+
+  // For each stick, 0 being left and 1 right, the number of samples in
+  // which it was resting, and their average position.
+  long m_count[2];
+  float m_meanX[2];
+  float m_meanY[2];
+
+public:      // methods
+  DriftRecord();
+
+  // Describe on one line, e.g.:
+  // "controller 0: left 12.5 -30.0 (7400), right 4.0 2.0 (7400)".
+  std::string toString() const;
+};
+
+
+// Accumulates `DriftRecord`s during normal use.
+class StickDriftTracker {
+private:     // types
+  // Sums for the current interval of one controller.
+  class Accumulator {
+  public:
+    bool m_started;
+    DWORD m_startMS;
+    DriftRecord m_record;
+    double m_sumX[2];
+    double m_sumY[2];
+
+    Accumulator();
+  };
+
+private:     // data
+  // Length of each interval.
+  int m_intervalMS;
+
+  // Current interval, by controller ID.
+  std::map<int, Accumulator> m_accumulators;
+
+  // Finished intervals not yet taken.
+  std::deque<DriftRecord> m_finished;
+
+  // First and most recent finished intervals, by controller ID.
+  std::map<int, DriftRecord> m_first;
+  std::map<int, DriftRecord> m_latest;
+
+public:      // methods
+  explicit StickDriftTracker(int intervalMS);
+
+  // Add a sample from controller `controllerID`.  A stick counts as
+  // resting when it is inside the dead zone per `thr`.
+  void add(int controllerID, ControllerState const &state,
+           AnalogThresholdConfig const &thr);
+
+  // If an interval has finished since the last call, remove the
+  // oldest into `rec` and return true.
+  bool takeRecord(DriftRecord &rec /*OUT*/);
+
+  // Get the first and most recent intervals of `controllerID`.  Return
+  // false if none has finished.
+  bool firstAndLatest(int controllerID,
+                      DriftRecord &first /*OUT*/,
+                      DriftRecord &latest /*OUT*/) const;
+};
+
+
+#endif // STICK_CALIBRATION_H
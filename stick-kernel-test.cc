@@ -0,0 +1,219 @@
+// stick-kernel-test.cc
+// Tests for `stick-kernel` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "stick-kernel.h"              // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <algorithm>                   // std::{max, sort, unique}
+#include <cmath>                       // std::{abs, atan2, cos, sin, sqrt}
+#include <cstring>                     // std::memcmp
+#include <vector>                      // std::vector
+
+
+// Largest difference allowed between the trigonometric formulation and
+// the kernel's direction and deflection.  See stick-kernel.h.
+static float const c_trigTolerance = 3e-7f;
+
+
+// What `ControllerPainter::drawStick` computed before the kernel, with
+// `atan2`, `cos`, and `sin`, for the square and octagon shapes.
+static StickResult trigStick(SHORT rawXS, SHORT rawYS,
+                             StickParams const &params)
+{
+  float rawX = rawXS;
+  float rawY = rawYS;
+  float deadZone = params.m_deadZone;
+
+  float absX = std::abs(rawX);
+  float absY = std::abs(rawY);
+  float magnitude = std::sqrt(absX*absX + absY*absY);
+
+  StickResult r;
+  r.m_beyondDeadZone = params.m_deadZoneShape == DZS_OCTAGON?
+    std::max(absX, absY) > deadZone || (absX + absY) > deadZone * 1.5 :
+    std::max(absX, absY) > deadZone;
+
+  r.m_speed =
+    magnitude > params.m_sprintThreshold? 3 :
+    magnitude > params.m_runThreshold?    2 :
+                                          1 ;
+
+  if (r.m_beyondDeadZone) {
+    if (magnitude > 32767) {
+      magnitude = 32767;
+    }
+    magnitude -= deadZone;
+    magnitude = magnitude / (32767 - deadZone);
+
+    float angleRadians = std::atan2(-rawY, rawX);
+    r.m_dirX = std::cos(angleRadians);
+    r.m_dirY = std::sin(angleRadians);
+    r.m_deflectX = magnitude * std::cos(angleRadians);
+    r.m_deflectY = magnitude * std::sin(angleRadians);
+  }
+
+  return r;
+}
+
+
+// Raw coordinates to test with: a regular sample of the whole range,
+// plus the extremes and values on either side of the thresholds.
+static std::vector<SHORT> testCoordinates(StickParams const &params)
+{
+  std::vector<int> v;
+  for (int c = -32768; c <= 32767; c += 61) {
+    v.push_back(c);
+  }
+  for (float t : { params.m_deadZone, params.m_deadZone * 0.75f,
+                   params.m_runThreshold, params.m_sprintThreshold }) {
+    for (int d = -1; d <= 1; ++d) {
+      v.push_back((int)t + d);
+      v.push_back(-(int)t + d);
+    }
+  }
+  for (int c : { -32768, -32767, -1, 0, 1, 32766, 32767 }) {
+    v.push_back(c);
+  }
+
+  std::sort(v.begin(), v.end());
+  v.erase(std::unique(v.begin(), v.end()), v.end());
+  return std::vector<SHORT>(v.begin(), v.end());
+}
+
+
+// All pairs of `testCoordinates`, as separate X and Y arrays.
+static void testPositions(StickParams const &params,
+                          std::vector<SHORT> &xs /*OUT*/,
+                          std::vector<SHORT> &ys /*OUT*/)
+{
+  std::vector<SHORT> coords = testCoordinates(params);
+  for (SHORT x : coords) {
+    for (SHORT y : coords) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+}
+
+
+UNIT_TEST(processStickMatchesTrig)
+{
+  AnalogThresholdConfig thr;
+  for (bool leftSide : { true, false }) {
+    StickParams params = StickParams::forStick(thr, leftSide);
+    std::vector<SHORT> xs, ys;
+    testPositions(params, xs, ys);
+
+    float maxError = 0;
+    bool flagsMatch = true;
+    for (std::size_t i=0; i < xs.size(); ++i) {
+      StickResult k = processStick(xs[i], ys[i], params);
+      StickResult t = trigStick(xs[i], ys[i], params);
+      flagsMatch = flagsMatch &&
+                   k.m_beyondDeadZone == t.m_beyondDeadZone &&
+                   k.m_speed == t.m_speed;
+      for (float e : { k.m_dirX - t.m_dirX, k.m_dirY - t.m_dirY,
+                       k.m_deflectX - t.m_deflectX,
+                       k.m_deflectY - t.m_deflectY }) {
+        maxError = std::max(maxError, std::abs(e));
+      }
+    }
+
+    // The flags and tiers are exact; the vectors are within rounding.
+    EXPECT(flagsMatch);
+    EXPECT(maxError <= c_trigTolerance);
+  }
+}
+
+
+UNIT_TEST(processStickBatchMatchesScalar)
+{
+  AnalogThresholdConfig thr;
+  for (bool leftSide : { true, false }) {
+    StickParams params = StickParams::forStick(thr, leftSide);
+    std::vector<SHORT> xs, ys;
+    testPositions(params, xs, ys);
+
+    // An odd count, so the SIMD path also has a partial group.
+    if (xs.size() % 2 == 0) {
+      xs.pop_back();
+      ys.pop_back();
+    }
+
+    StickBatch batch, scalar;
+    processStickBatch(xs.data(), ys.data(), xs.size(), params, batch);
+    processStickBatchScalar(xs.data(), ys.data(), xs.size(), params,
+                            scalar);
+    EXPECT_EQ(batch.size(), xs.size());
+    EXPECT_EQ(scalar.size(), xs.size());
+
+    // Both must be bit-identical to each other and to `processStick`.
+    std::size_t floatBytes = xs.size() * sizeof(float);
+    EXPECT(batch.m_beyondDeadZone == scalar.m_beyondDeadZone);
+    EXPECT(batch.m_speed == scalar.m_speed);
+    EXPECT(!std::memcmp(batch.m_dirX.data(), scalar.m_dirX.data(),
+                        floatBytes));
+    EXPECT(!std::memcmp(batch.m_dirY.data(), scalar.m_dirY.data(),
+                        floatBytes));
+    EXPECT(!std::memcmp(batch.m_deflectX.data(), scalar.m_deflectX.data(),
+                        floatBytes));
+    EXPECT(!std::memcmp(batch.m_deflectY.data(), scalar.m_deflectY.data(),
+                        floatBytes));
+
+    bool matchesOne = true;
+    for (std::size_t i=0; i < xs.size(); ++i) {
+      StickResult a = scalar.at(i);
+      StickResult b = processStick(xs[i], ys[i], params);
+      matchesOne = matchesOne &&
+                   a.m_beyondDeadZone == b.m_beyondDeadZone &&
+                   a.m_speed == b.m_speed &&
+                   !std::memcmp(&a.m_dirX, &b.m_dirX, sizeof(float)) &&
+                   !std::memcmp(&a.m_dirY, &b.m_dirY, sizeof(float)) &&
+                   !std::memcmp(&a.m_deflectX, &b.m_deflectX,
+                                sizeof(float)) &&
+                   !std::memcmp(&a.m_deflectY, &b.m_deflectY,
+                                sizeof(float));
+    }
+    EXPECT(matchesOne);
+  }
+}
+
+
+UNIT_TEST(stickNormBatchMatchesScalar)
+{
+  AnalogThresholdConfig thr;
+  StickParams params = StickParams::forStick(thr, true /*leftSide*/);
+  std::vector<SHORT> xs, ys;
+  testPositions(params, xs, ys);
+  xs.pop_back();
+  ys.pop_back();
+
+  for (DeadZoneShape shape : { DZS_SQUARE, DZS_OCTAGON, DZS_CIRCLE }) {
+    std::vector<float> norms(xs.size());
+    stickNormBatch(xs.data(), ys.data(), xs.size(), shape, norms.data());
+
+    bool matches = true;
+    bool consistent = true;
+    StickParams shaped(params.m_deadZone, shape,
+                       params.m_runThreshold, params.m_sprintThreshold);
+    for (std::size_t i=0; i < xs.size(); ++i) {
+      float n = stickNorm(xs[i], ys[i], shape);
+      matches = matches && !std::memcmp(&n, &norms[i], sizeof(float));
+
+      // The norm agrees with the dead zone test, except that the
+      // octagon's is subject to rounding.
+      if (shape != DZS_OCTAGON) {
+        bool beyond = processStick(xs[i], ys[i], shaped).m_beyondDeadZone;
+        consistent = consistent && (beyond == (n > shaped.m_deadZone));
+      }
+    }
+    EXPECT(matches);
+    EXPECT(consistent);
+  }
+}
+
+
+// EOF
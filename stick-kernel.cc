@@ -0,0 +1,352 @@
+// stick-kernel.cc
+// Code for `stick-kernel` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "stick-kernel.h"              // this module
+
+#include <algorithm>                   // std::max
+#include <cmath>                       // std::sqrt
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define STICK_KERNEL_SSE2 1
+  #include <emmintrin.h>               // SSE2 intrinsics
+#else
+  #define STICK_KERNEL_SSE2 0
+#endif
+
+
+// Largest raw magnitude; anything beyond is treated as this.
+static float const c_maxMagnitude = 32767;
+
+
+// ---------------------------- StickParams ----------------------------
+StickParams::StickParams(float deadZone, DeadZoneShape deadZoneShape,
+                         float runThreshold, float sprintThreshold)
+  : m_deadZone(deadZone),
+    m_deadZoneShape(deadZoneShape),
+    m_runThreshold(runThreshold),
+    m_sprintThreshold(sprintThreshold)
+{}
+
+
+/*static*/ StickParams StickParams::forStick(
+  AnalogThresholdConfig const &thr, bool leftSide)
+{
+  // The speed tiers only mean something for the left stick, but are
+  // computed the same way for both.
+  return StickParams(
+    leftSide? thr.m_leftStickWalkThreshold : thr.m_rightStickDeadZone,
+    leftSide? DZS_OCTAGON : DZS_SQUARE,
+    thr.m_leftStickRunThreshold,
+    thr.m_leftStickSprintThreshold);
+}
+
+
+// ---------------------------- StickBatch -----------------------------
+StickBatch::StickBatch()
+  : m_beyondDeadZone(),
+    m_speed(),
+    m_dirX(),
+    m_dirY(),
+    m_deflectX(),
+    m_deflectY()
+{}
+
+
+void StickBatch::resize(std::size_t n)
+{
+  m_beyondDeadZone.resize(n);
+  m_speed.resize(n);
+  m_dirX.resize(n);
+  m_dirY.resize(n);
+  m_deflectX.resize(n);
+  m_deflectY.resize(n);
+}
+
+
+StickResult StickBatch::at(std::size_t i) const
+{
+  StickResult r;
+  r.m_beyondDeadZone = m_beyondDeadZone[i];
+  r.m_speed = m_speed[i];
+  r.m_dirX = m_dirX[i];
+  r.m_dirY = m_dirY[i];
+  r.m_deflectX = m_deflectX[i];
+  r.m_deflectY = m_deflectY[i];
+  return r;
+}
+
+
+// ------------------------------ kernels ------------------------------
+StickResult processStick(SHORT rawX, SHORT rawY, StickParams const &params)
+{
+  // The SIMD version below must do the same operations in the same
+  // order so the results are identical.
+  float x = rawX;
+  float y = rawY;
+  float absX = std::abs(x);
+  float absY = std::abs(y);
+
+  // Magnitude of deflection in the raw units.
+  float magnitude = std::sqrt(absX*absX + absY*absY);
+
+  StickResult r;
+
+  r.m_speed =
+    magnitude > params.m_sprintThreshold? 3 :
+    magnitude > params.m_runThreshold?    2 :
+                                          1 ;
+
+  float deadZone = params.m_deadZone;
+  switch (params.m_deadZoneShape) {
+    case DZS_SQUARE:
+      r.m_beyondDeadZone = std::max(absX, absY) > deadZone;
+      break;
+
+    case DZS_OCTAGON:
+      r.m_beyondDeadZone = std::max(absX, absY) > deadZone ||
+                           (absX + absY) > deadZone * 1.5f;
+      break;
+
+    case DZS_CIRCLE:
+      r.m_beyondDeadZone = magnitude > deadZone;
+      break;
+  }
+
+  if (r.m_beyondDeadZone) {
+    // Being beyond the dead zone implies `magnitude` is not zero.  Flip
+    // Y to point down.
+    r.m_dirX = x / magnitude;
+    r.m_dirY = -y / magnitude;
+
+    // Truncate anything outside the circle, remove the dead zone, and
+    // scale what remains to [0,1].
+    //
+    // This is probably not correct for Elden Ring.
+    //
+    float scaled = (std::min(magnitude, c_maxMagnitude) - deadZone) /
+                   (c_maxMagnitude - deadZone);
+
+    r.m_deflectX = scaled * r.m_dirX;
+    r.m_deflectY = scaled * r.m_dirY;
+  }
+
+  return r;
+}
+
+
+float stickNorm(SHORT rawX, SHORT rawY, DeadZoneShape shape)
+{
+  // Same operations as `stickNormBatch`.
+  float absX = std::abs((float)rawX);
+  float absY = std::abs((float)rawY);
+
+  switch (shape) {
+    case DZS_SQUARE:
+      return std::max(absX, absY);
+
+    case DZS_OCTAGON:
+      return std::max(std::max(absX, absY), (absX + absY) / 1.5f);
+
+    case DZS_CIRCLE:
+      return std::sqrt(absX*absX + absY*absY);
+  }
+  return 0;                            // Not reached.
+}
+
+
+// Store sample `i` of `r` into `out`.
+static void storeResult(StickBatch &out, std::size_t i, StickResult const &r)
+{
+  out.m_beyondDeadZone[i] = r.m_beyondDeadZone;
+  out.m_speed[i] = r.m_speed;
+  out.m_dirX[i] = r.m_dirX;
+  out.m_dirY[i] = r.m_dirY;
+  out.m_deflectX[i] = r.m_deflectX;
+  out.m_deflectY[i] = r.m_deflectY;
+}
+
+
+void processStickBatchScalar(SHORT const *rawX, SHORT const *rawY,
+                             std::size_t n, StickParams const &params,
+                             StickBatch &out)
+{
+  out.resize(n);
+  for (std::size_t i=0; i < n; ++i) {
+    storeResult(out, i, processStick(rawX[i], rawY[i], params));
+  }
+}
+
+
+#if STICK_KERNEL_SSE2
+
+// Load four SHORTs and convert them to floats.
+static inline __m128 loadShorts(SHORT const *p)
+{
+  __m128i v = _mm_loadl_epi64((__m128i const *)p);
+
+  // Put each value in the top half of a 32-bit lane, then shift it
+  // back down with sign extension.
+  v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+  return _mm_cvtepi32_ps(v);
+}
+
+
+// Per lane, `mask? a : b`, where `mask` lanes are all ones or zeroes.
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+
+static inline __m128i selectInt(__m128 mask, __m128i a, __m128i b)
+{
+  __m128i m = _mm_castps_si128(mask);
+  return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+
+// Store the low byte of each 32-bit lane of `v`, which must be in
+// [0,255], to `dest[0..3]`.
+static inline void storeBytes(unsigned char *dest, __m128i v)
+{
+  v = _mm_packs_epi32(v, v);
+  v = _mm_packus_epi16(v, v);
+  int four = _mm_cvtsi128_si32(v);
+  for (int k=0; k < 4; ++k) {
+    dest[k] = (unsigned char)(four >> (k*8));
+  }
+}
+
+
+void processStickBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                       StickParams const &params, StickBatch &out)
+{
+  out.resize(n);
+
+  __m128 const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 const signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  __m128 const zero = _mm_setzero_ps();
+  __m128 const one = _mm_set1_ps(1.0f);
+  __m128 const deadZone = _mm_set1_ps(params.m_deadZone);
+  __m128 const octagonCut = _mm_set1_ps(params.m_deadZone * 1.5f);
+  __m128 const runThreshold = _mm_set1_ps(params.m_runThreshold);
+  __m128 const sprintThreshold = _mm_set1_ps(params.m_sprintThreshold);
+  __m128 const maxMagnitude = _mm_set1_ps(c_maxMagnitude);
+  __m128 const scaleRange = _mm_set1_ps(c_maxMagnitude - params.m_deadZone);
+  DeadZoneShape const shape = params.m_deadZoneShape;
+
+  std::size_t i = 0;
+  for (; i+4 <= n; i += 4) {
+    __m128 x = loadShorts(rawX + i);
+    __m128 y = loadShorts(rawY + i);
+    __m128 absX = _mm_and_ps(x, absMask);
+    __m128 absY = _mm_and_ps(y, absMask);
+
+    __m128 magnitude = _mm_sqrt_ps(
+      _mm_add_ps(_mm_mul_ps(absX, absX), _mm_mul_ps(absY, absY)));
+
+    // Speed tier, with the same precedence as the scalar version.
+    __m128i speed = _mm_set1_epi32(1);
+    speed = selectInt(_mm_cmpgt_ps(magnitude, runThreshold),
+                      _mm_set1_epi32(2), speed);
+    speed = selectInt(_mm_cmpgt_ps(magnitude, sprintThreshold),
+                      _mm_set1_epi32(3), speed);
+
+    __m128 beyond;
+    if (shape == DZS_CIRCLE) {
+      beyond = _mm_cmpgt_ps(magnitude, deadZone);
+    }
+    else {
+      beyond = _mm_cmpgt_ps(_mm_max_ps(absX, absY), deadZone);
+      if (shape == DZS_OCTAGON) {
+        beyond = _mm_or_ps(beyond,
+          _mm_cmpgt_ps(_mm_add_ps(absX, absY), octagonCut));
+      }
+    }
+
+    // Lanes inside the dead zone may have a zero magnitude, so divide
+    // by 1 there instead, and zero the results afterward.
+    __m128 divisor = select(beyond, magnitude, one);
+    __m128 dirX = _mm_div_ps(x, divisor);
+    __m128 dirY = _mm_div_ps(_mm_xor_ps(y, signMask), divisor);
+
+    __m128 scaled = _mm_div_ps(
+      _mm_sub_ps(_mm_min_ps(magnitude, maxMagnitude), deadZone),
+      scaleRange);
+
+    __m128 deflectX = _mm_mul_ps(scaled, dirX);
+    __m128 deflectY = _mm_mul_ps(scaled, dirY);
+
+    _mm_storeu_ps(&out.m_dirX[i],     select(beyond, dirX, zero));
+    _mm_storeu_ps(&out.m_dirY[i],     select(beyond, dirY, zero));
+    _mm_storeu_ps(&out.m_deflectX[i], select(beyond, deflectX, zero));
+    _mm_storeu_ps(&out.m_deflectY[i], select(beyond, deflectY, zero));
+
+    storeBytes(&out.m_speed[i], speed);
+    storeBytes(&out.m_beyondDeadZone[i],
+      _mm_and_si128(_mm_castps_si128(beyond), _mm_set1_epi32(1)));
+  }
+
+  // Leftovers.
+  for (; i < n; ++i) {
+    storeResult(out, i, processStick(rawX[i], rawY[i], params));
+  }
+}
+
+
+void stickNormBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                    DeadZoneShape shape, float *out)
+{
+  __m128 const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 const octagonScale = _mm_set1_ps(1.5f);
+
+  std::size_t i = 0;
+  for (; i+4 <= n; i += 4) {
+    __m128 absX = _mm_and_ps(loadShorts(rawX + i), absMask);
+    __m128 absY = _mm_and_ps(loadShorts(rawY + i), absMask);
+
+    __m128 norm;
+    if (shape == DZS_CIRCLE) {
+      norm = _mm_sqrt_ps(
+        _mm_add_ps(_mm_mul_ps(absX, absX), _mm_mul_ps(absY, absY)));
+    }
+    else {
+      norm = _mm_max_ps(absX, absY);
+      if (shape == DZS_OCTAGON) {
+        norm = _mm_max_ps(norm,
+          _mm_div_ps(_mm_add_ps(absX, absY), octagonScale));
+      }
+    }
+    _mm_storeu_ps(out + i, norm);
+  }
+
+  // Leftovers.
+  for (; i < n; ++i) {
+    out[i] = stickNorm(rawX[i], rawY[i], shape);
+  }
+}
+
+#else // !STICK_KERNEL_SSE2
+
+void processStickBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                       StickParams const &params, StickBatch &out)
+{
+  processStickBatchScalar(rawX, rawY, n, params, out);
+}
+
+
+void stickNormBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                    DeadZoneShape shape, float *out)
+{
+  for (std::size_t i=0; i < n; ++i) {
+    out[i] = stickNorm(rawX[i], rawY[i], shape);
+  }
+}
+
+#endif // !STICK_KERNEL_SSE2
+
+
+// EOF
@@ -0,0 +1,158 @@
+// stick-kernel.h
+// Conversion of raw thumbstick positions to display quantities.
+
+// See license.txt for copyright and terms of use.
+
+// For each raw stick position this computes whether it is beyond the
+// dead zone, the left stick speed tier, the unit direction, and the
+// deflection with the dead zone removed, all without trigonometry: the
+// direction is just the raw vector divided by its length, where the
+// original code went through `atan2` and then `cos` and `sin`.
+//
+// There is a scalar entry point for drawing one stick, and a batch
+// entry point over structure-of-arrays data that uses SSE2, when
+// available, to process four samples at a time, for tools that go
+// through long recordings.  There are also batch and scalar versions
+// of the per-shape distance from the center, used for calibration.
+//
+// Accuracy: the SSE2 and scalar paths perform the same IEEE single
+// precision operations in the same order, so they agree exactly, as
+// long as the compiler is not allowed to contract multiply-adds
+// (the default without `-mfma` or `-march=native`).  The dead zone
+// flag and speed tier are computed exactly as the `atan2` formulation
+// did.  The direction and deflection differ from the `cos(atan2(..))`
+// values by rounding only, at most 3e-7 in absolute terms (a few ulps
+// of 1.0), far below a pixel at any window size.
+
+#ifndef STICK_KERNEL_H
+#define STICK_KERNEL_H
+
+#include "gpv-config.h"                // AnalogThresholdConfig
+#include "windows-compat.h"            // SHORT
+
+#include <cstddef>                     // std::size_t
+#include <vector>                      // std::vector
+
+
+// Shape of the region around the center where stick input is ignored.
+enum DeadZoneShape {
+  // |x| and |y| both at most the dead zone size.
+  DZS_SQUARE,
+
+  // Square, but also cut at the corners where |x|+|y| exceeds 1.5
+  // times the size.
+  DZS_OCTAGON,
+
+  // Magnitude at most the size.  This is the shape of the speed tier
+  // boundaries.
+  DZS_CIRCLE,
+};
+
+
+// Thresholds applied to one stick.
+class StickParams {
+public:      // data
+  // Dead zone size, in raw units.
+  float m_deadZone;
+
+  // Dead zone shape.
+  DeadZoneShape m_deadZoneShape;
+
+  // Deflection magnitudes, in raw units, above which the speed tier is
+  // 2 and 3, respectively.
+  float m_runThreshold;
+  float m_sprintThreshold;
+
+public:      // methods
+  StickParams(float deadZone, DeadZoneShape deadZoneShape,
+              float runThreshold, float sprintThreshold);
+
+  // Parameters for the left or right stick per `thr`.
+  static StickParams forStick(AnalogThresholdConfig const &thr,
+                              bool leftSide);
+};
+
+
+// What to display for one stick position.
+class StickResult {
+public:      // data
+  // True if the position is beyond the dead zone.  If not, the vectors
+  // are all zero.
+  bool m_beyondDeadZone;
+
+  // Speed tier, 1 (walk) to 3 (sprint), based on the raw magnitude
+  // regardless of the dead zone.
+  int m_speed;
+
+  // Unit vector in the direction of deflection, with Y pointing down
+  // as on the screen.
+  float m_dirX;
+  float m_dirY;
+
+  // Deflection with the dead zone removed, scaled so that full
+  // deflection has length 1, with Y pointing down.
+  float m_deflectX;
+  float m_deflectY;
+
+public:      // methods
+  StickResult()
+    : m_beyondDeadZone(false),
+      m_speed(1),
+      m_dirX(0),
+      m_dirY(0),
+      m_deflectX(0),
+      m_deflectY(0)
+  {}
+};
+
+
+// Results for many samples, as one array per field.
+class StickBatch {
+public:      // data
+  // Each has one element per sample; see `StickResult`.
+  std::vector<unsigned char> m_beyondDeadZone;
+  std::vector<unsigned char> m_speed;
+  std::vector<float> m_dirX;
+  std::vector<float> m_dirY;
+  std::vector<float> m_deflectX;
+  std::vector<float> m_deflectY;
+
+public:      // methods
+  StickBatch();
+
+  // Set the number of samples.
+  void resize(std::size_t n);
+
+  std::size_t size() const
+    { return m_speed.size(); }
+
+  // Get sample `i` as a `StickResult`.
+  StickResult at(std::size_t i) const;
+};
+
+
+// Analyze one position, with `rawX` and `rawY` in [-32768,32767] and
+// positive Y being up, as XInput reports them.
+StickResult processStick(SHORT rawX, SHORT rawY, StickParams const &params);
+
+// Analyze `n` positions into `out`, resizing it to `n`.
+void processStickBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                       StickParams const &params, StickBatch &out /*OUT*/);
+
+// Same, but without SIMD, for checking `processStickBatch`.
+void processStickBatchScalar(SHORT const *rawX, SHORT const *rawY,
+                             std::size_t n, StickParams const &params,
+                             StickBatch &out /*OUT*/);
+
+
+// Return the size of the smallest dead zone of `shape` that contains
+// the position, so it is beyond a dead zone of size `d` exactly when
+// this exceeds `d` (up to rounding for the octagon).
+float stickNorm(SHORT rawX, SHORT rawY, DeadZoneShape shape);
+
+// Compute `stickNorm` of `n` positions into `out[0..n-1]`.
+void stickNormBatch(SHORT const *rawX, SHORT const *rawY, std::size_t n,
+                    DeadZoneShape shape, float *out /*OUT*/);
+
+
+#endif // STICK_KERNEL_H
@@ -0,0 +1,73 @@
+// synthetic-input.cc
+// Code for `synthetic-input` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "synthetic-input.h"           // this module
+
+#include <cmath>                       // std::{cos, sin}
+
+
+static float const c_pi = 3.1415926535897932384626433832795;
+
+
+SyntheticInput::SyntheticInput()
+  : m_sampleCount(0)
+{}
+
+
+void SyntheticInput::next(ControllerState &state, DWORD nowMS)
+{
+  DWORD n = m_sampleCount++;
+
+  state.m_hasInputState = true;
+  state.m_pollTimeMS = nowMS;
+
+  XINPUT_STATE &is = state.m_inputState;
+  XINPUT_GAMEPAD &g = is.Gamepad;
+
+  // A real controller increments this whenever anything changes.
+  is.dwPacketNumber = n+1;
+
+  // Left stick goes around once every two seconds, right stick twice
+  // as fast in the other direction, at varying radii so the dead zone
+  // and speed tiers are all visited.
+  float t = (nowMS % 2000) / 2000.0f * 2 * c_pi;
+  float radius = 0.5f + 0.5f * std::sin(t * 0.5f);
+  g.sThumbLX = (SHORT)(32767 * radius * std::cos(t));
+  g.sThumbLY = (SHORT)(32767 * radius * std::sin(t));
+  g.sThumbRX = (SHORT)(32767 * radius * std::cos(-2*t));
+  g.sThumbRY = (SHORT)(32767 * radius * std::sin(-2*t));
+
+  // Triggers ramp over about a second.
+  g.bLeftTrigger = (BYTE)(nowMS / 4);
+  g.bRightTrigger = (BYTE)(255 - nowMS / 4);
+
+  // Hold each face and shoulder button in turn for a quarter second.
+  static WORD const held[] = {
+    XINPUT_GAMEPAD_A,
+    XINPUT_GAMEPAD_B,
+    XINPUT_GAMEPAD_Y,
+    XINPUT_GAMEPAD_X,
+    XINPUT_GAMEPAD_LEFT_SHOULDER,
+    XINPUT_GAMEPAD_RIGHT_SHOULDER,
+  };
+  int const numHeld = sizeof(held) / sizeof(held[0]);
+  g.wButtons = held[(nowMS / 250) % numHeld];
+
+  // Tap the dpad directions for exactly one sample each, every 37
+  // samples, to check that short presses are not lost when the
+  // display updates less often than the input.
+  static WORD const tapped[] = {
+    XINPUT_GAMEPAD_DPAD_UP,
+    XINPUT_GAMEPAD_DPAD_RIGHT,
+    XINPUT_GAMEPAD_DPAD_DOWN,
+    XINPUT_GAMEPAD_DPAD_LEFT,
+  };
+  if (n % 37 == 0) {
+    g.wButtons |= tapped[(n / 37) % 4];
+  }
+}
+
+
+// EOF
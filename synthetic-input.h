@@ -0,0 +1,34 @@
+// synthetic-input.h
+// Generated controller input for exercising the display without a
+// controller.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef SYNTHETIC_INPUT_H
+#define SYNTHETIC_INPUT_H
+
+#include "controller-state.h"          // ControllerState
+#include "windows-compat.h"            // DWORD
+
+
+// Produces a stream of changing controller states: the sticks trace
+// circles, the triggers ramp up and down, and buttons are pressed in
+// sequence, including very short presses that last only one sample.
+//
+// Every sample differs from the previous one, so the stream is as
+// demanding as a real controller reporting at the same rate.
+//
+class SyntheticInput {
+public:      // data
+  // Number of samples generated so far.
+  DWORD m_sampleCount;
+
+public:      // methods
+  SyntheticInput();
+
+  // Set `state` to the next sample, taken at `nowMS`.
+  void next(ControllerState &state /*OUT*/, DWORD nowMS);
+};
+
+
+#endif // SYNTHETIC_INPUT_H
@@ -0,0 +1,45 @@
+// text-format.cc
+// Code for `text-format` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "text-format.h"               // this module
+
+#include <cstdarg>                     // va_list, etc.
+#include <cstdio>                      // std::vsnprintf
+#include <vector>                      // std::vector
+
+
+void appendFormat(std::wstring &out, char const *format, ...)
+{
+  // Enough for any line of the display.
+  char buf[200];
+
+  va_list args;
+  va_start(args, format);
+  int len = std::vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) {
+    return;
+  }
+
+  char const *text = buf;
+  std::vector<char> bigBuf;
+  if ((std::size_t)len >= sizeof(buf)) {
+    // Rare, so allocating is fine.
+    bigBuf.resize(len+1);
+    va_start(args, format);
+    std::vsnprintf(bigBuf.data(), bigBuf.size(), format, args);
+    va_end(args);
+    text = bigBuf.data();
+  }
+
+  // Widen one character at a time, since appending the range would
+  // make a temporary string.
+  for (int i=0; i < len; ++i) {
+    out.push_back((wchar_t)(unsigned char)text[i]);
+  }
+}
+
+
+// EOF
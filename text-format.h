@@ -0,0 +1,26 @@
+// text-format.h
+// Formatting into existing wide strings.
+
+// See license.txt for copyright and terms of use.
+
+// The display text is rebuilt every frame.  Formatting it with
+// `std::wostringstream` allocates each time, whereas appending to a
+// `std::wstring` that is cleared and reused allocates only until its
+// capacity has grown to fit.
+
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <string>                      // std::wstring
+
+
+// Append `format`, formatted as by `printf`, to `out`.  Each `char` of
+// the result becomes one `wchar_t`, so it should be ASCII.
+void appendFormat(std::wstring &out, char const *format, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 2, 3)))
+#endif
+  ;
+
+
+#endif // TEXT_FORMAT_H
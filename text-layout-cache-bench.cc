@@ -0,0 +1,146 @@
+// text-layout-cache-bench.cc
+// Benchmarks for `text-layout-cache` module.
+
+// See license.txt for copyright and terms of use.
+
+// This uses Direct2D and DirectWrite, so unlike the other benchmarks,
+// it is only built on Windows.
+
+#include "text-layout-cache.h"         // module under test
+
+#include "bench.h"                     // BENCHMARK, benchFrameModels, etc.
+#include "controller-painter.h"        // ControllerPainter
+#include "d2d-canvas.h"                // D2DCanvas
+#include "winapi-util.h"               // CALL_HR_WINAPI, SafeReleaseOnLeave
+
+#include <d2d1.h>                      // Direct2D
+#include <dwrite.h>                    // DirectWrite
+#include <wincodec.h>                  // IWICImagingFactory
+#include <windows.h>                   // CoInitializeEx
+
+#include <cstdio>                      // std::snprintf
+#include <vector>                      // std::vector
+
+
+// Frame time with and without the text layout cache, drawing the whole
+// display, with the text shown, into an offscreen Direct2D target the
+// size of the default window.  This is the drawing the viewer does
+// for each frame when it does not use the static layer.
+BENCHMARK(textLayoutCacheFrameTime)
+{
+  CALL_HR_WINAPI(CoInitializeEx, nullptr, COINIT_MULTITHREADED);
+
+  GPVConfig config;
+  config.m_showText = true;
+  std::vector<InputModel> models = benchFrameModels(&config, 256);
+
+  ID2D1Factory *d2dFactory = nullptr;
+  CALL_HR_WINAPI(D2D1CreateFactory,
+    D2D1_FACTORY_TYPE_SINGLE_THREADED,
+    &d2dFactory);
+  SafeReleaseOnLeave releaseD2DFactory(d2dFactory);
+
+  IDWriteFactory *writeFactory = nullptr;
+  CALL_HR_WINAPI(DWriteCreateFactory,
+    DWRITE_FACTORY_TYPE_SHARED,
+    __uuidof(writeFactory),
+    reinterpret_cast<IUnknown **>(&writeFactory));
+  SafeReleaseOnLeave releaseWriteFactory(writeFactory);
+
+  // Same format as `GVMainWindow::createTextFormat`.
+  IDWriteTextFormat *textFormat = nullptr;
+  CALL_HR_WINAPI(writeFactory->CreateTextFormat,
+    L"Verdana",                        // fontFamilyName
+    nullptr,                           // fontCollection
+    DWRITE_FONT_WEIGHT_NORMAL,         // fontWeight
+    DWRITE_FONT_STYLE_NORMAL,          // fontStyle
+    DWRITE_FONT_STRETCH_NORMAL,        // fontStretch
+    config.m_layoutParams.m_textFontSizeDIPs, // fontSize
+    L"",                               // localeName
+    &textFormat                        // textFormat
+  );
+  SafeReleaseOnLeave releaseTextFormat(textFormat);
+
+  IWICImagingFactory *wicFactory = nullptr;
+  CALL_HR_WINAPI(CoCreateInstance,
+    CLSID_WICImagingFactory,
+    nullptr,
+    CLSCTX_INPROC_SERVER,
+    IID_PPV_ARGS(&wicFactory));
+  SafeReleaseOnLeave releaseWICFactory(wicFactory);
+
+  int const width = config.m_windowWidth;
+  int const height = config.m_windowHeight;
+  IWICBitmap *bitmap = nullptr;
+  CALL_HR_WINAPI(wicFactory->CreateBitmap,
+    width,
+    height,
+    GUID_WICPixelFormat32bppPBGRA,
+    WICBitmapCacheOnDemand,
+    &bitmap);
+  SafeReleaseOnLeave releaseBitmap(bitmap);
+
+  ID2D1RenderTarget *target = nullptr;
+  CALL_HR_WINAPI(d2dFactory->CreateWicBitmapRenderTarget,
+    bitmap,
+    D2D1::RenderTargetProperties(),
+    &target);
+  SafeReleaseOnLeave releaseTarget(target);
+
+  // The colors do not matter here, so every role gets the same brush.
+  // The default stroke style is also fine.
+  ID2D1SolidColorBrush *brush = nullptr;
+  CALL_HR_WINAPI(target->CreateSolidColorBrush,
+    D2D1::ColorF(1.0f, 1.0f, 1.0f),
+    &brush);
+  SafeReleaseOnLeave releaseBrush(brush);
+
+  D2DCanvas canvas;
+  canvas.m_renderTarget = target;
+  for (int i=0; i < NUM_GV_COLOR_ROLES; ++i) {
+    canvas.m_brushes[i] = (i == GVCR_NONE? nullptr : brush);
+  }
+  canvas.m_textBrush = brush;
+  canvas.m_writeFactory = writeFactory;
+  canvas.m_textFormat = textFormat;
+
+  float dpiX, dpiY;
+  target->GetDpi(&dpiX, &dpiY);
+  D2D1_SIZE_F size = target->GetSize();
+
+  for (bool useCache : { false, true }) {
+    // Same capacity as the viewer's cache.
+    TextLayoutCache cache(32 /*capacity*/);
+    cache.setContext(textFormat, dpiX, dpiY);
+    canvas.m_textLayoutCache = useCache? &cache : nullptr;
+
+    ControllerPainter painter(&config, &models[0]);
+    painter.m_canvas = &canvas;
+
+    std::size_t i = 0;
+    double ns = benchTimeNS([&] {
+      painter.m_inputModel = &models[i++ % models.size()];
+      target->BeginDraw();
+      target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f));
+      target->SetTransform(D2D1::Matrix3x2F::Identity());
+      painter.drawControllerState(PP_ALL,
+                                  Point2F(size.width, size.height));
+      target->EndDraw();
+    });
+
+    char what[80];
+    std::snprintf(what, sizeof(what), "%dx%d %s",
+                  width, height, useCache? "cached layouts" : "uncached");
+    char note[80] = "per frame";
+    if (useCache) {
+      std::snprintf(note, sizeof(note), "per frame, %.0f%% hits",
+                    cache.hitRate() * 100);
+    }
+    benchReport(what, ns, note);
+  }
+
+  CoUninitialize();
+}
+
+
+// EOF
@@ -0,0 +1,141 @@
+// text-layout-cache.cc
+// Code for `text-layout-cache` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "text-layout-cache.h"         // this module
+
+#include "winapi-util.h"               // CALL_HR_WINAPI, safeRelease
+
+#include <cassert>                     // assert
+
+
+TextLayoutCache::TextLayoutCache(std::size_t capacity)
+  : m_capacity(capacity),
+    m_entries(),
+    m_useClock(0),
+    m_textFormat(nullptr),
+    m_fontSize(0),
+    m_dpiX(0),
+    m_dpiY(0),
+    m_hits(0),
+    m_misses(0)
+{
+  assert(capacity > 0);
+  m_entries.reserve(capacity);
+}
+
+
+TextLayoutCache::~TextLayoutCache()
+{
+  clear();
+}
+
+
+/*static*/ void TextLayoutCache::releaseEntry(Entry &entry)
+{
+  safeRelease(entry.m_layout);
+}
+
+
+void TextLayoutCache::setContext(IDWriteTextFormat *textFormat,
+                                 float dpiX, float dpiY)
+{
+  float fontSize = textFormat? textFormat->GetFontSize() : 0;
+
+  if (textFormat != m_textFormat ||
+      fontSize != m_fontSize ||
+      dpiX != m_dpiX ||
+      dpiY != m_dpiY) {
+    clear();
+    m_textFormat = textFormat;
+    m_fontSize = fontSize;
+    m_dpiX = dpiX;
+    m_dpiY = dpiY;
+  }
+}
+
+
+void TextLayoutCache::clear()
+{
+  for (Entry &entry : m_entries) {
+    releaseEntry(entry);
+  }
+  m_entries.clear();
+}
+
+
+TextLayoutCache::Entry const &TextLayoutCache::get(
+  IDWriteFactory *writeFactory,
+  std::wstring const &text,
+  float maxWidth,
+  float maxHeight)
+{
+  assert(m_textFormat);
+  ++m_useClock;
+
+  // With only a handful of entries, a linear search is fine.
+  Entry *victim = nullptr;
+  for (Entry &entry : m_entries) {
+    if (entry.m_maxWidth == maxWidth &&
+        entry.m_maxHeight == maxHeight &&
+        entry.m_text == text) {
+      ++m_hits;
+      entry.m_lastUse = m_useClock;
+      return entry;
+    }
+
+    if (!victim || entry.m_lastUse < victim->m_lastUse) {
+      victim = &entry;
+    }
+  }
+
+  ++m_misses;
+
+  IDWriteTextLayout *layout = nullptr;
+  CALL_HR_WINAPI(writeFactory->CreateTextLayout,
+    text.data(),
+    text.size(),
+    m_textFormat,
+    maxWidth,
+    maxHeight,
+    &layout);
+  assert(layout);
+
+  DWRITE_TEXT_METRICS tm{};
+  CALL_HR_WINAPI(layout->GetMetrics,
+    &tm);
+
+  // The measured width is just a bit tight on the right side.
+  tm.width += 1;
+
+  Entry *entry;
+  if (m_entries.size() < m_capacity) {
+    m_entries.push_back(Entry());
+    entry = &m_entries.back();
+  }
+  else {
+    // Evict the least recently used.
+    entry = victim;
+    releaseEntry(*entry);
+  }
+
+  entry->m_text = text;
+  entry->m_maxWidth = maxWidth;
+  entry->m_maxHeight = maxHeight;
+  entry->m_layout = layout;
+  entry->m_bounds = RectF(tm.left,            tm.top,
+                          tm.left + tm.width, tm.top + tm.height);
+  entry->m_lastUse = m_useClock;
+  return *entry;
+}
+
+
+float TextLayoutCache::hitRate() const
+{
+  long total = m_hits + m_misses;
+  return total? (float)m_hits / total : 0;
+}
+
+
+// EOF
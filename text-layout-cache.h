@@ -0,0 +1,102 @@
+// text-layout-cache.h
+// `TextLayoutCache`, which keeps recently used DirectWrite text layouts.
+
+// See license.txt for copyright and terms of use.
+
+#ifndef TEXT_LAYOUT_CACHE_H
+#define TEXT_LAYOUT_CACHE_H
+
+#include "geometry.h"                  // RectF
+
+#include <dwrite.h>                    // IDWriteFactory, IDWriteTextLayout
+
+#include <cstddef>                     // std::size_t
+#include <string>                      // std::wstring
+#include <vector>                      // std::vector
+
+
+// Small least-recently-used cache of text layouts and their measured
+// extents.
+//
+// Making a layout and measuring it is comparatively expensive, and
+// the display draws the same few labels ("2 early", "A 3+", ...) over
+// and over, so both measuring and drawing a string look here first.
+//
+// Entries are keyed on the string and the size of the box it is laid
+// out in.  Everything else that affects the layout (text format, font
+// size, and DPI) is the same for all entries; `setContext` discards
+// them all when any of it changes.
+//
+class TextLayoutCache {
+public:      // types
+  class Entry {
+  public:    // data
+    // The key.
+    std::wstring m_text;
+    float m_maxWidth;
+    float m_maxHeight;
+
+    // Owned layout.
+    IDWriteTextLayout *m_layout;
+
+    // Area the text occupies, relative to the upper-left corner of the
+    // layout box.
+    RectF m_bounds;
+
+    // Value of `m_useClock` when this entry was last used.
+    unsigned long m_lastUse;
+  };
+
+public:      // data
+  // Maximum number of entries.
+  std::size_t m_capacity;
+
+  // Current entries, in no particular order.
+  std::vector<Entry> m_entries;
+
+  // Incremented on every lookup, to order entries by recency.
+  unsigned long m_useClock;
+
+  // What the entries were made with.  The format is not owned.
+  IDWriteTextFormat *m_textFormat;
+  float m_fontSize;
+  float m_dpiX;
+  float m_dpiY;
+
+  // Number of lookups that found, or did not find, an entry, since
+  // construction.
+  long m_hits;
+  long m_misses;
+
+private:     // methods
+  // Release the layout of `entry`.
+  static void releaseEntry(Entry &entry);
+
+public:      // methods
+  explicit TextLayoutCache(std::size_t capacity);
+  ~TextLayoutCache();
+
+  TextLayoutCache(TextLayoutCache const &obj) = delete;
+  TextLayoutCache &operator=(TextLayoutCache const &obj) = delete;
+
+  // Discard all entries if any of the arguments differ from what the
+  // current entries were made with.
+  void setContext(IDWriteTextFormat *textFormat, float dpiX, float dpiY);
+
+  // Release all of the layouts.
+  void clear();
+
+  // Get the entry for laying out `text` in a box of the given size,
+  // creating it with `writeFactory` if needed.  The result remains
+  // valid until the next call to `get`, `setContext`, or `clear`.
+  Entry const &get(IDWriteFactory *writeFactory,
+                   std::wstring const &text,
+                   float maxWidth,
+                   float maxHeight);
+
+  // Fraction of lookups that were hits, or 0 if there have been none.
+  float hitRate() const;
+};
+
+
+#endif // TEXT_LAYOUT_CACHE_H
@@ -0,0 +1,40 @@
+// trace-ring-bench.cc
+// Benchmarks for `trace-ring` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "trace-ring.h"                // module under test
+
+#include "bench.h"                     // BENCHMARK, benchTimeNS, etc.
+
+#include <chrono>                      // std::chrono
+
+
+// Cost of one `traceEvent` call, with tracing disabled and enabled,
+// compared with just reading the clock, which each record does.
+BENCHMARK(traceEventCost)
+{
+  std::int32_t n = 0;
+
+  traceRingInit(0);
+  benchReport("traceEvent, disabled", benchTimeNS([&] {
+    traceEvent(TE_POLL, n++, 1, 2);
+  }), "per call");
+
+  // The viewer's default capacity.  The ring wraps many times.
+  traceRingInit(8192);
+  benchReport("traceEvent, enabled", benchTimeNS([&] {
+    traceEvent(TE_POLL, n++, 1, 2);
+  }), "per record");
+
+  benchReport("steady_clock::now", benchTimeNS([&] {
+    auto t = std::chrono::steady_clock::now();
+    benchKeep(t);
+  }));
+
+  // Do not slow down the benchmarks that run after this one.
+  traceRingInit(0);
+}
+
+
+// EOF
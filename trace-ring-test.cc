@@ -0,0 +1,80 @@
+// trace-ring-test.cc
+// Tests for `trace-ring` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "trace-ring.h"                // module under test
+
+#include "unit-test.h"                 // UNIT_TEST, EXPECT, EXPECT_EQ
+
+#include <atomic>                      // std::atomic
+#include <cstdio>                      // std::sscanf
+#include <sstream>                     // std::istringstream
+#include <thread>                      // std::thread
+
+
+// Check every "poll" end record in `dump` for the argument pattern
+// written by `traceRingDumpDuringWrites`.  Return the number checked.
+static int checkPollRecords(std::string const &dump)
+{
+  std::istringstream in(dump);
+  std::string line;
+  int checked = 0;
+  while (std::getline(in, line)) {
+    std::size_t pos = line.find(" samples=");
+    if (pos == std::string::npos) {
+      continue;
+    }
+    int samples, packet, buttons;
+    EXPECT_EQ(std::sscanf(line.c_str() + pos,
+                          " samples=%d packet=%d buttons=%d",
+                          &samples, &packet, &buttons), 3);
+    EXPECT_EQ(packet, -samples);
+    EXPECT_EQ(buttons, samples ^ 0x5a5a);
+    ++checked;
+  }
+  return checked;
+}
+
+
+// A thread traces as fast as it can, lapping its small ring many times,
+// while this one dumps.  Every record in a dump must be whole.
+UNIT_TEST(traceRingDumpDuringWrites)
+{
+  traceRingInit(64);
+
+  std::atomic<bool> stop(false);
+  std::atomic<std::int32_t> written(0);
+  std::thread writer([&] {
+    traceSetThreadName("writer");
+    for (std::int32_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+      traceEvent(TE_POLL, i, -i, i ^ 0x5a5a);
+      written.store(i+1, std::memory_order_relaxed);
+    }
+  });
+
+  // Let it lap the ring first, and keep dumping until it has lapped it
+  // many more times, which with one CPU needs it to be preempted.
+  while (written.load(std::memory_order_relaxed) < 1000) {
+    std::this_thread::yield();
+  }
+  int checked = 0;
+  std::int32_t const start = written.load(std::memory_order_relaxed);
+  for (int d = 0;
+       d < 200 || written.load(std::memory_order_relaxed) < start + 10000;
+       ++d) {
+    checked += checkPollRecords(traceRingDump());
+  }
+  stop = true;
+  writer.join();
+
+  // Once the writer has stopped, its ring is intact, but a dump still
+  // leaves out the oldest slot, which might be getting overwritten.
+  EXPECT_EQ(checkPollRecords(traceRingDump()), 63);
+  EXPECT(checked > 0);
+
+  traceRingInit(0);
+}
+
+
+// EOF
@@ -0,0 +1,436 @@
+// trace-ring.cc
+// Code for `trace-ring` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "trace-ring.h"                // this module
+
+#include <algorithm>                   // std::{find, min, stable_sort}
+#include <cerrno>                      // errno
+#include <csignal>                     // std::raise
+#include <cstdio>                      // std::{fopen, fputs, snprintf}
+#include <cstring>                     // std::strerror
+#include <memory>                      // std::unique_ptr
+#include <mutex>                       // std::mutex, etc.
+
+#ifdef _WIN32
+  #include <windows.h>                 // SetUnhandledExceptionFilter
+#else
+  #include <signal.h>                  // sigaction
+#endif
+
+
+std::size_t g_traceRingCapacity = 0;
+
+thread_local TraceRing *t_traceRing = nullptr;
+
+
+// How to print one kind of event.
+class TraceEventInfo {
+public:      // data
+  char const *m_name;
+
+  // Chrome trace-event phase: 'B' for the start of a span, 'E' for its
+  // end, or 'i' for an instant.
+  char m_phase;
+
+  // Names of the arguments that are used, followed by nulls.
+  char const *m_argNames[TRACE_MAX_ARGS];
+};
+
+
+// Indexed by `TraceEvent`.
+static TraceEventInfo const s_traceEventInfo[NUM_TRACE_EVENTS] = {
+  { "poll",          'B', { } },
+  { "poll",          'E', { "samples", "packet", "buttons" } },
+  { "timerStart",    'i', { "timer", "startMS" } },
+  { "timerExpire",   'i', { "timer" } },
+  { "present",       'i', { "latched", "leftTrigger", "rightTrigger" } },
+  { "invalidate",    'i', { } },
+  { "paint",         'B', { } },
+  { "paint",         'E', { "us", "primitives", "cpuRaster",
+                            "latencyUS" } },
+  { "EndDraw",       'B', { } },
+  { "EndDraw",       'E', { "hr" } },
+  { "configReload",  'i', { "reloads" } },
+  { "configSubmit",  'i', { } },
+  { "configWrite",   'i', { "us", "ok" } },
+  { "recording",     'i', { "on", "samples" } },
+  { "profile",       'i', { "index" } },
+  { "calibration",   'i', { "step" } },
+  { "dump",          'i', { } },
+};
+
+
+// Every thread's ring.  They are never destroyed, since a dump may
+// want them after their thread has exited.
+static std::mutex s_ringsMutex;
+static std::vector<std::unique_ptr<TraceRing>> s_rings;
+
+
+// ----------------------------- TraceSlot -----------------------------
+TraceRecord TraceSlot::load() const
+{
+  std::uint64_t w[4];
+  for (int i=0; i < 4; ++i) {
+    w[i] = m_words[i].load(std::memory_order_relaxed);
+  }
+
+  TraceRecord r;
+  r.m_timeNS = w[0];
+  r.m_event = (std::uint32_t)w[1];
+  r.m_args[0] = (std::int32_t)(std::uint32_t)(w[1] >> 32);
+  r.m_args[1] = (std::int32_t)(std::uint32_t)w[2];
+  r.m_args[2] = (std::int32_t)(std::uint32_t)(w[2] >> 32);
+  r.m_args[3] = (std::int32_t)(std::uint32_t)w[3];
+  r.m_args[4] = (std::int32_t)(std::uint32_t)(w[3] >> 32);
+  return r;
+}
+
+
+// ----------------------------- TraceRing -----------------------------
+TraceRing::TraceRing(std::size_t capacity, std::string const &threadName)
+  : m_records(capacity),
+    m_mask(capacity - 1),
+    m_count(0),
+    m_threadName(threadName)
+{}
+
+
+// ------------------------------ global -------------------------------
+void traceRingInit(std::size_t capacity)
+{
+  std::size_t rounded = 0;
+  if (capacity > 0) {
+    rounded = 1;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+  }
+  g_traceRingCapacity = rounded;
+}
+
+
+TraceRing *traceRingForThisThread()
+{
+  if (g_traceRingCapacity == 0) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(s_ringsMutex);
+  s_rings.emplace_back(new TraceRing(g_traceRingCapacity,
+    "thread" + std::to_string(s_rings.size())));
+  t_traceRing = s_rings.back().get();
+  return t_traceRing;
+}
+
+
+void traceSetThreadName(char const *name)
+{
+  TraceRing *ring = t_traceRing;
+  if (!ring) {
+    ring = traceRingForThisThread();
+  }
+  if (ring) {
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    ring->m_threadName = name;
+  }
+}
+
+
+// A record and the ring it came from.
+class DumpedRecord {
+public:      // data
+  TraceRecord m_record;
+  TraceRing const *m_ring;
+};
+
+
+// Append the records of `ring` that are still intact to `out`.
+static void copyRing(TraceRing const &ring, std::vector<DumpedRecord> &out)
+{
+  std::uint64_t const capacity = ring.m_records.size();
+  std::uint64_t end = ring.m_count.load(std::memory_order_acquire);
+  std::uint64_t begin = end > capacity? end - capacity : 0;
+
+  std::size_t const first = out.size();
+  for (std::uint64_t i = begin; i < end; ++i) {
+    out.push_back(DumpedRecord{ring.m_records[i & ring.m_mask].load(),
+                               &ring});
+  }
+
+  // The writer may have lapped the oldest records while they were
+  // being copied, so drop any that it could have overwritten,
+  // including the one in the slot it may be writing right now.  The
+  // fence pairs with the one in `TraceRing::add`: if any word copied
+  // above came from record `m`, this load sees at least `m`.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  std::uint64_t newEnd = ring.m_count.load(std::memory_order_relaxed) + 1;
+  std::uint64_t newBegin = newEnd > capacity? newEnd - capacity : 0;
+  if (newBegin > begin) {
+    std::size_t drop = (std::size_t)std::min(newBegin - begin, end - begin);
+    out.erase(out.begin() + first, out.begin() + first + drop);
+  }
+}
+
+
+// Get the records of every ring, merged in time order, into
+// `records`.  If `mayBlock` is false and another thread is registering
+// or naming a ring, return false instead of waiting for it.
+static bool copyAllRings(std::vector<DumpedRecord> &records /*OUT*/,
+                         bool mayBlock)
+{
+  {
+    std::unique_lock<std::mutex> lock(s_ringsMutex, std::defer_lock);
+    if (mayBlock) {
+      lock.lock();
+    }
+    else if (!lock.try_lock()) {
+      return false;
+    }
+    for (auto const &ring : s_rings) {
+      copyRing(*ring, records);
+    }
+  }
+
+  // Each ring is already in order, and stability keeps it that way for
+  // records with equal times, so spans stay properly nested.
+  std::stable_sort(records.begin(), records.end(),
+    [](DumpedRecord const &a, DumpedRecord const &b) {
+      return a.m_record.m_timeNS < b.m_record.m_timeNS;
+    });
+
+  return true;
+}
+
+
+// Return the description of `event`, or null if it is out of range.
+static TraceEventInfo const *traceEventInfo(std::uint32_t event)
+{
+  return event < NUM_TRACE_EVENTS? &s_traceEventInfo[event] : nullptr;
+}
+
+
+static std::string dumpText(std::vector<DumpedRecord> const &records)
+{
+  std::string ret;
+  char buf[200];
+  std::snprintf(buf, sizeof(buf),
+    "# %zu trace records; times are in ms after the first\n",
+    records.size());
+  ret += buf;
+
+  std::uint64_t const startNS =
+    records.empty()? 0 : records.front().m_record.m_timeNS;
+  for (DumpedRecord const &dr : records) {
+    TraceRecord const &r = dr.m_record;
+    TraceEventInfo const *info = traceEventInfo(r.m_event);
+
+    int len = std::snprintf(buf, sizeof(buf), "%12.3f %-10s %c %-13s",
+      (r.m_timeNS - startNS) / 1e6,
+      dr.m_ring->m_threadName.c_str(),
+      info? info->m_phase : '?',
+      info? info->m_name : "?");
+    for (int a=0; a < TRACE_MAX_ARGS && len < (int)sizeof(buf); ++a) {
+      char const *argName = info? info->m_argNames[a] : "arg";
+      if (argName) {
+        len += std::snprintf(buf+len, sizeof(buf)-len, " %s=%d",
+                             argName, (int)r.m_args[a]);
+      }
+    }
+    ret += buf;
+    ret += "\n";
+  }
+
+  return ret;
+}
+
+
+// Append `str` to `out` as a JSON string literal.
+static void appendJSONString(std::string &out, std::string const &str)
+{
+  out += '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      out += ' ';
+    }
+    else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+
+static std::string dumpChromeJSON(std::vector<DumpedRecord> const &records)
+{
+  // Thread IDs are the indices of the rings in `s_rings`, which also
+  // gives their metadata records a stable order.
+  std::vector<TraceRing const *> rings;
+  {
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    for (auto const &ring : s_rings) {
+      rings.push_back(ring.get());
+    }
+  }
+  auto tidOf = [&rings](TraceRing const *ring) {
+    return (int)(std::find(rings.begin(), rings.end(), ring) -
+                 rings.begin());
+  };
+
+  std::string ret = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  char buf[200];
+  bool first = true;
+
+  for (std::size_t tid=0; tid < rings.size(); ++tid) {
+    std::snprintf(buf, sizeof(buf),
+      "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+      "\"name\":\"thread_name\",\"args\":{\"name\":",
+      first? "" : ",\n", (int)tid);
+    ret += buf;
+    appendJSONString(ret, rings[tid]->m_threadName);
+    ret += "}}";
+    first = false;
+  }
+
+  // Times are microseconds, which is what the format requires, after
+  // the first record, since the steady clock's epoch is arbitrary.
+  std::uint64_t const startNS =
+    records.empty()? 0 : records.front().m_record.m_timeNS;
+  for (DumpedRecord const &dr : records) {
+    TraceRecord const &r = dr.m_record;
+    TraceEventInfo const *info = traceEventInfo(r.m_event);
+    if (!info) {
+      continue;
+    }
+
+    int len = std::snprintf(buf, sizeof(buf),
+      "%s{\"ph\":\"%c\",%s\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+      "\"cat\":\"gpv\",\"name\":\"%s\",\"args\":{",
+      first? "" : ",\n",
+      info->m_phase,
+      info->m_phase == 'i'? "\"s\":\"t\"," : "",
+      tidOf(dr.m_ring),
+      (r.m_timeNS - startNS) / 1e3,
+      info->m_name);
+    char const *sep = "";
+    for (int a=0; a < TRACE_MAX_ARGS && len < (int)sizeof(buf); ++a) {
+      if (char const *argName = info->m_argNames[a]) {
+        len += std::snprintf(buf+len, sizeof(buf)-len, "%s\"%s\":%d",
+                             sep, argName, (int)r.m_args[a]);
+        sep = ",";
+      }
+    }
+    ret += buf;
+    ret += "}}";
+    first = false;
+  }
+
+  ret += "\n]}\n";
+  return ret;
+}
+
+
+std::string traceRingDump(TraceDumpFormat format)
+{
+  std::vector<DumpedRecord> records;
+  copyAllRings(records, true /*mayBlock*/);
+  switch (format) {
+    default:
+    case TDF_TEXT:
+      return dumpText(records);
+
+    case TDF_CHROME_JSON:
+      return dumpChromeJSON(records);
+  }
+}
+
+
+// Write `text` to `fname`.  Return an error message, or "" on success.
+static std::string writeDumpFile(std::string const &fname,
+                                 std::string const &text)
+{
+  std::FILE *fp = std::fopen(fname.c_str(), "w");
+  if (!fp) {
+    return std::strerror(errno);
+  }
+  bool ok = std::fputs(text.c_str(), fp) >= 0;
+  ok = std::fclose(fp) == 0 && ok;
+  return ok? "" : std::strerror(errno);
+}
+
+
+std::string traceRingDumpToFile(std::string const &fname,
+                                TraceDumpFormat format)
+{
+  // Record the dump itself, which also shows how long it took relative
+  // to the events before it.
+  traceEvent(TE_DUMP);
+  return writeDumpFile(fname, traceRingDump(format));
+}
+
+
+// Where `traceRingInstallCrashDump` writes.
+static std::string s_crashDumpFname;
+
+
+// Dump for a crash.  The crash may have happened while some thread
+// held `s_ringsMutex`, even this one, in which case waiting for it
+// would hang instead of terminating, so then there is no dump.
+static void crashDump()
+{
+  std::vector<DumpedRecord> records;
+  if (copyAllRings(records, false /*mayBlock*/)) {
+    writeDumpFile(s_crashDumpFname, dumpText(records));
+  }
+}
+
+
+#ifdef _WIN32
+
+static LONG WINAPI crashDumpFilter(EXCEPTION_POINTERS *)
+{
+  crashDump();
+  return EXCEPTION_CONTINUE_SEARCH;
+}
+
+
+void traceRingInstallCrashDump(std::string const &fname)
+{
+  s_crashDumpFname = fname;
+  SetUnhandledExceptionFilter(&crashDumpFilter);
+}
+
+#else // !_WIN32
+
+// This is not async-signal-safe, since it allocates and formats, but
+// the process is going down anyway, and usually the dump works.
+static void crashDumpHandler(int sig)
+{
+  crashDump();
+
+  // The handler was reset to the default, so this terminates as the
+  // original signal would have.
+  std::raise(sig);
+}
+
+
+void traceRingInstallCrashDump(std::string const &fname)
+{
+  s_crashDumpFname = fname;
+  for (int sig : { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS }) {
+    struct sigaction sa = {};
+    sa.sa_handler = &crashDumpHandler;
+    sa.sa_flags = SA_RESETHAND;
+    sigaction(sig, &sa, nullptr);
+  }
+}
+
+#endif // !_WIN32
+
+
+// EOF
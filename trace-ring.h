@@ -0,0 +1,208 @@
+// trace-ring.h
+// Per-thread ring buffers of binary trace records.
+
+// See license.txt for copyright and terms of use.
+
+// `TRACE` writes formatted text to stderr, which costs microseconds per
+// message and goes nowhere when the viewer is linked with `-mwindows`.
+// This is a flight recorder for timing problems instead: `traceEvent`
+// stores a fixed-size record (timestamp, event, and a few integers) in
+// a ring buffer owned by the calling thread, with no locking and no
+// formatting, and the text is only produced when the rings are dumped,
+// on demand or when the program crashes.
+//
+// Each ring has a single writer, its thread.  Dumping from another
+// thread copies the records and then discards any that the writer may
+// have overwritten during the copy, so a dump never blocks tracing.
+// The slots are atomic words so that reading one while it is being
+// overwritten is not a data race, only a record that gets discarded.
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <atomic>                      // std::atomic
+#include <chrono>                      // std::chrono
+#include <cstdint>                     // std::{int32_t, uint32_t, uint64_t}
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+// Things that can be traced.  The names and argument names used when
+// dumping are in `s_traceEventInfo` in trace-ring.cc.
+//
+// A `_BEGIN` event and the one after it are the start and end of a
+// span.  Spans on one thread must nest.
+enum TraceEvent {
+  TE_POLL_BEGIN,             // Controller poll starting.
+  TE_POLL,                   // Controller polled.
+  TE_TIMER_START,            // Button timer started.
+  TE_TIMER_EXPIRE,           // Button timer expired.
+  TE_PRESENT,                // Input snapshot taken for drawing.
+  TE_INVALIDATE,             // Window invalidated, requesting a paint.
+  TE_PAINT_BEGIN,            // Frame paint starting.
+  TE_PAINT,                  // Frame painted.
+  TE_END_DRAW_BEGIN,         // Direct2D `EndDraw` starting.
+  TE_END_DRAW,               // Direct2D `EndDraw` returned.
+  TE_CONFIG_RELOAD,          // Edited configuration file applied.
+  TE_CONFIG_SUBMIT,          // Configuration handed to the saver.
+  TE_CONFIG_WRITE,           // Configuration file written.
+  TE_RECORDING,              // Recording started or stopped.
+  TE_PROFILE,                // Timing profile selected.
+  TE_CALIBRATION,            // Calibration step started.
+  TE_DUMP,                   // Trace dumped.
+
+  NUM_TRACE_EVENTS
+};
+
+
+// Number of integer arguments per record.
+int const TRACE_MAX_ARGS = 5;
+
+
+// One traced event, as copied out of a ring.
+class TraceRecord {
+public:      // data
+  // Nanoseconds on `std::chrono::steady_clock`.
+  std::uint64_t m_timeNS;
+
+  // A `TraceEvent`.
+  std::uint32_t m_event;
+
+  // Meaning depends on `m_event`.
+  std::int32_t m_args[TRACE_MAX_ARGS];
+};
+
+
+// Storage for one `TraceRecord` in a ring.  This is 32 bytes, so two
+// fit in a cache line.
+class TraceSlot {
+public:      // data
+  // Word 0 is the time, and the rest are the event and the arguments,
+  // two 32-bit values per word, low half first.
+  std::atomic<std::uint64_t> m_words[4];
+
+public:      // methods
+  // Store a record.  The stores are relaxed; see `TraceRing::add`.
+  void store(std::uint64_t timeNS, std::uint32_t event,
+             std::int32_t a0, std::int32_t a1, std::int32_t a2,
+             std::int32_t a3, std::int32_t a4)
+  {
+    m_words[0].store(timeNS, std::memory_order_relaxed);
+    m_words[1].store(pack(event, (std::uint32_t)a0),
+                     std::memory_order_relaxed);
+    m_words[2].store(pack((std::uint32_t)a1, (std::uint32_t)a2),
+                     std::memory_order_relaxed);
+    m_words[3].store(pack((std::uint32_t)a3, (std::uint32_t)a4),
+                     std::memory_order_relaxed);
+  }
+
+  // Read the record with relaxed loads.
+  TraceRecord load() const;
+
+  // Combine two 32-bit values into a word.
+  static std::uint64_t pack(std::uint32_t lo, std::uint32_t hi)
+    { return lo | ((std::uint64_t)hi << 32); }
+};
+
+
+// The records of one thread.
+class TraceRing {
+public:      // data
+  // Slots, a power of two of them.
+  std::vector<TraceSlot> m_records;
+
+  // `m_records.size() - 1`.
+  std::uint64_t m_mask;
+
+  // Number of records ever written.  Record `i` is in slot
+  // `i & m_mask` until it is overwritten by record `i + size`.
+  std::atomic<std::uint64_t> m_count;
+
+  // Name given by `traceSetThreadName`, or a number.
+  std::string m_threadName;
+
+public:      // methods
+  TraceRing(std::size_t capacity, std::string const &threadName);
+
+  // Append a record.  Only the owning thread may call this.
+  void add(TraceEvent event, std::int32_t a0, std::int32_t a1,
+           std::int32_t a2, std::int32_t a3, std::int32_t a4)
+  {
+    std::uint64_t n = m_count.load(std::memory_order_relaxed);
+    std::uint64_t timeNS =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // A dumping thread that reads any word stored below will, after
+    // its acquire fence, see `m_count` at least `n`, and so knows that
+    // the slot of record `n - size` may be torn.  See `copyRing`.
+    std::atomic_thread_fence(std::memory_order_release);
+    m_records[n & m_mask].store(timeNS, event, a0, a1, a2, a3, a4);
+
+    // Publish the record to dumping threads.
+    m_count.store(n+1, std::memory_order_release);
+  }
+};
+
+
+// Records per thread, or 0 if tracing is disabled.  Set by
+// `traceRingInit`.
+extern std::size_t g_traceRingCapacity;
+
+// This thread's ring, or null if it does not have one yet.
+extern thread_local TraceRing *t_traceRing;
+
+// Enable tracing with `capacity` records per thread, rounded up to a
+// power of two, or disable it if `capacity` is 0.  Call this before
+// any thread traces.
+void traceRingInit(std::size_t capacity);
+
+// Create and register this thread's ring.  Return null if disabled.
+TraceRing *traceRingForThisThread();
+
+// Name this thread in dumps.
+void traceSetThreadName(char const *name);
+
+// Record `event` with up to five integer arguments.
+inline void traceEvent(TraceEvent event,
+                       std::int32_t a0 = 0, std::int32_t a1 = 0,
+                       std::int32_t a2 = 0, std::int32_t a3 = 0,
+                       std::int32_t a4 = 0)
+{
+  if (g_traceRingCapacity == 0) {
+    return;
+  }
+
+  TraceRing *ring = t_traceRing;
+  if (!ring) {
+    ring = traceRingForThisThread();
+  }
+  ring->add(event, a0, a1, a2, a3, a4);
+}
+
+
+// Ways to format a dump.
+enum TraceDumpFormat {
+  // One record per line.
+  TDF_TEXT,
+
+  // The Chrome trace-event JSON format, which can be loaded into
+  // chrome://tracing or https://ui.perfetto.dev to see the spans of
+  // each thread on a timeline.
+  TDF_CHROME_JSON,
+};
+
+// Format the records of every thread, merged in time order.
+std::string traceRingDump(TraceDumpFormat format = TDF_TEXT);
+
+// Write `traceRingDump(format)` to `fname`.  Return an error message,
+// or "" on success.
+std::string traceRingDumpToFile(std::string const &fname,
+                                TraceDumpFormat format = TDF_TEXT);
+
+// Arrange for the rings to be dumped to `fname` if the program
+// crashes.
+void traceRingInstallCrashDump(std::string const &fname);
+
+
+#endif // TRACE_RING_H
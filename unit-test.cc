@@ -0,0 +1,130 @@
+// unit-test.cc
+// Code for `unit-test` module, including `main` for `gpv-test`.
+
+// See license.txt for copyright and terms of use.
+
+#include "unit-test.h"                 // this module
+
+#include <cstring>                     // std::strstr
+#include <filesystem>                  // std::filesystem
+#include <iostream>                    // std::{cerr, cout}
+#include <random>                      // std::random_device
+#include <system_error>                // std::error_code
+#include <vector>                      // std::vector
+
+namespace fs = std::filesystem;
+
+
+// A registered test.
+class UnitTest {
+public:      // data
+  char const *m_name;
+  char const *m_file;
+  UnitTestFunction m_func;
+};
+
+
+// All tests, in registration order.  This is a function-local static
+// so that it exists before the first registration, whichever file that
+// comes from.
+static std::vector<UnitTest> &allTests()
+{
+  static std::vector<UnitTest> tests;
+  return tests;
+}
+
+
+// Failures in the test now running.
+static int s_failures = 0;
+
+// Scratch directory, or empty if not made yet.
+static std::string s_tempDir;
+
+
+UnitTestRegistration::UnitTestRegistration(char const *name,
+                                           char const *file,
+                                           UnitTestFunction func)
+{
+  allTests().push_back(UnitTest{name, file, func});
+}
+
+
+void unitTestFail(char const *file, int line, std::string const &what)
+{
+  std::cout << file << ":" << line << ": failed: " << what << "\n";
+  s_failures++;
+}
+
+
+std::string unitTestTempDir()
+{
+  if (s_tempDir.empty()) {
+    fs::path dir = fs::temp_directory_path() /
+                   ("gpv-test-" + std::to_string(std::random_device()()));
+    fs::create_directories(dir);
+    s_tempDir = dir.string();
+  }
+  return s_tempDir;
+}
+
+
+void unitTestPrint(std::ostream &os, std::wstring const &value)
+{
+  os << '"';
+  for (wchar_t c : value) {
+    os << (char)c;
+  }
+  os << '"';
+}
+
+
+void unitTestPrint(std::ostream &os, wchar_t const *value)
+{
+  unitTestPrint(os, std::wstring(value));
+}
+
+
+// True if test `t` was selected by the command line.
+static bool isSelected(UnitTest const &t, int argc, char **argv)
+{
+  if (argc <= 1) {
+    return true;
+  }
+  for (int i=1; i < argc; ++i) {
+    if (std::strstr(t.m_name, argv[i]) || std::strstr(t.m_file, argv[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+int main(int argc, char **argv)
+{
+  int run = 0;
+  int failed = 0;
+  for (UnitTest const &t : allTests()) {
+    if (!isSelected(t, argc, argv)) {
+      continue;
+    }
+
+    s_failures = 0;
+    t.m_func();
+    run++;
+    if (s_failures) {
+      std::cout << "FAIL: " << t.m_name << "\n";
+      failed++;
+    }
+  }
+
+  if (!s_tempDir.empty()) {
+    std::error_code ec;
+    fs::remove_all(s_tempDir, ec);
+  }
+
+  std::cout << (run - failed) << " of " << run << " tests passed\n";
+  return failed? 1 : 0;
+}
+
+
+// EOF
@@ -0,0 +1,101 @@
+// unit-test.h
+// Minimal framework for the tests that `make test` runs.
+
+// See license.txt for copyright and terms of use.
+
+// Each `*-test.cc` file defines tests for one module:
+//
+//   UNIT_TEST(parryTimerStartsOnTriggerPress)
+//   {
+//     ...
+//     EXPECT(model.m_parryTimer.isRunning());
+//     EXPECT_EQ(model.parryTimerElapsedMS(), 100);
+//   }
+//
+// They are linked together into `gpv-test`, whose `main`, in
+// unit-test.cc, runs every test, or with arguments, those whose names
+// contain one of them.  A failed expectation is reported with its
+// location and the test continues; `gpv-test` exits with status 1 if
+// any failed.
+//
+// The tests only use the portable modules, so they run on Linux.
+
+#ifndef UNIT_TEST_H
+#define UNIT_TEST_H
+
+#include <ostream>                     // std::ostream
+#include <sstream>                     // std::ostringstream
+#include <string>                      // std::string, std::wstring
+
+
+// Signature of a test.
+typedef void (*UnitTestFunction)();
+
+
+// Adds a test to the list `main` runs.  `UNIT_TEST` makes one of these
+// for each test, as a static object.
+class UnitTestRegistration {
+public:      // methods
+  UnitTestRegistration(char const *name, char const *file,
+                       UnitTestFunction func);
+};
+
+
+// Record the failure of an expectation, described by `what`, at
+// `file:line`.
+void unitTestFail(char const *file, int line, std::string const &what);
+
+// Directory, created on first use, where tests can make scratch files.
+// It is removed when `gpv-test` exits.
+std::string unitTestTempDir();
+
+
+// Write `value` for a failure message.  Wide strings are narrowed,
+// which is fine for the ASCII the display uses.
+template <class T>
+void unitTestPrint(std::ostream &os, T const &value)
+{
+  os << value;
+}
+
+void unitTestPrint(std::ostream &os, std::wstring const &value);
+void unitTestPrint(std::ostream &os, wchar_t const *value);
+
+
+template <class A, class B>
+void unitTestCheckEqual(char const *file, int line,
+                        char const *aText, char const *bText,
+                        A const &a, B const &b)
+{
+  if (!(a == b)) {
+    std::ostringstream oss;
+    oss << aText << " == " << bText << ": ";
+    unitTestPrint(oss, a);
+    oss << " != ";
+    unitTestPrint(oss, b);
+    unitTestFail(file, line, oss.str());
+  }
+}
+
+
+// Define a test called `name`.
+#define UNIT_TEST(name)                                        \
+  static void name();                                          \
+  static UnitTestRegistration name##_registration(             \
+    #name, __FILE__, &name);                                   \
+  static void name()
+
+// Check that `cond` is true.
+#define EXPECT(cond)                                           \
+  do {                                                         \
+    if (!(cond)) {                                             \
+      unitTestFail(__FILE__, __LINE__, #cond);                 \
+    }                                                          \
+  } while (0)
+
+// Check that `a == b`, printing both if not.
+#define EXPECT_EQ(a, b) \
+  unitTestCheckEqual(__FILE__, __LINE__, #a, #b, (a), (b))
+
+
+#endif // UNIT_TEST_H
@@ -0,0 +1,51 @@
+// varint.cc
+// Code for `varint` module.
+
+// See license.txt for copyright and terms of use.
+
+#include "varint.h"                    // this module
+
+
+void appendVarint(std::string &dest, std::uint64_t v)
+{
+  while (v >= 0x80) {
+    dest.push_back((char)((v & 0x7F) | 0x80));
+    v >>= 7;
+  }
+  dest.push_back((char)v);
+}
+
+
+bool readVarint(char const *&p, char const *end, std::uint64_t &v /*OUT*/)
+{
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p == end) {
+      return false;
+    }
+
+    unsigned char b = (unsigned char)*(p++);
+    v |= (std::uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+
+  // Too many continuation bytes.
+  return false;
+}
+
+
+bool readSignedVarint(char const *&p, char const *end,
+                      std::int64_t &v /*OUT*/)
+{
+  std::uint64_t u;
+  if (!readVarint(p, end, u)) {
+    return false;
+  }
+  v = zigzagDecode(u);
+  return true;
+}
+
+
+// EOF
@@ -0,0 +1,52 @@
+// varint.h
+// Variable-length integer encoding for the binary file formats.
+
+// See license.txt for copyright and terms of use.
+
+// Unsigned values are written 7 bits at a time, least significant
+// first, with the high bit of each byte set if more bytes follow (the
+// "LEB128" scheme).  Signed values are first mapped to unsigned with
+// the "zigzag" mapping (0, -1, 1, -2, ... become 0, 1, 2, 3, ...) so
+// that small magnitudes of either sign stay short.
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstdint>                     // std::{uint64_t, int64_t}
+#include <string>                      // std::string
+
+
+// Map a signed value to an unsigned one for `appendVarint`.
+inline std::uint64_t zigzagEncode(std::int64_t v)
+{
+  return ((std::uint64_t)v << 1) ^ (std::uint64_t)(v >> 63);
+}
+
+// Inverse of `zigzagEncode`.
+inline std::int64_t zigzagDecode(std::uint64_t u)
+{
+  return (std::int64_t)(u >> 1) ^ -(std::int64_t)(u & 1);
+}
+
+
+// Append the encoding of `v` to `dest`.
+void appendVarint(std::string &dest, std::uint64_t v);
+
+// Append the encoding of signed `v` to `dest`.
+inline void appendSignedVarint(std::string &dest, std::int64_t v)
+{
+  appendVarint(dest, zigzagEncode(v));
+}
+
+
+// Decode a value starting at `p`, which must be before `end`, and
+// advance `p` past it.  Return false if the encoding runs past `end` or
+// is longer than any 64-bit value needs, leaving `p` unspecified.
+bool readVarint(char const *&p, char const *end, std::uint64_t &v /*OUT*/);
+
+// Signed version of `readVarint`.
+bool readSignedVarint(char const *&p, char const *end,
+                      std::int64_t &v /*OUT*/);
+
+
+#endif // VARINT_H
@@ -0,0 +1,82 @@
+// windows-compat.h
+// The few Windows and XInput declarations the portable modules use.
+
+// See license.txt for copyright and terms of use.
+
+// On Windows, this just includes the real headers.  Elsewhere, it
+// declares compatible substitutes so that the configuration, input
+// model, and drawing code can be compiled into command-line tools that
+// run on, e.g., Linux.
+//
+// Only what is actually needed is declared here.  Anything that talks
+// to the OS (window management, XInput polling, etc.) stays in modules
+// that are only built on Windows.
+
+#ifndef WINDOWS_COMPAT_H
+#define WINDOWS_COMPAT_H
+
+#ifdef _WIN32
+
+#include <windows.h>                   // COLORREF, RGB, WORD, etc.
+#include <xinput.h>                    // XINPUT_STATE, XINPUT_GAMEPAD_*
+
+#else // !_WIN32
+
+#include <cstdint>                     // std::{uint8_t, uint16_t, ...}
+
+
+// Integer types.  The sizes match those on Windows.
+typedef std::uint8_t  BYTE;
+typedef std::uint16_t WORD;
+typedef std::int16_t  SHORT;
+typedef std::uint32_t DWORD;
+
+
+// Colors.  The layout is 0x00BBGGRR.
+typedef DWORD COLORREF;
+
+#define RGB(r,g,b) \
+  ((COLORREF)(((BYTE)(r)) | ((WORD)((BYTE)(g)) << 8) | (((DWORD)(BYTE)(b)) << 16)))
+
+#define GetRValue(rgb) ((BYTE)(rgb))
+#define GetGValue(rgb) ((BYTE)(((WORD)(rgb)) >> 8))
+#define GetBValue(rgb) ((BYTE)((rgb) >> 16))
+
+
+// XInput controller state, with the same layout as in `xinput.h`.
+typedef struct _XINPUT_GAMEPAD {
+  WORD  wButtons;
+  BYTE  bLeftTrigger;
+  BYTE  bRightTrigger;
+  SHORT sThumbLX;
+  SHORT sThumbLY;
+  SHORT sThumbRX;
+  SHORT sThumbRY;
+} XINPUT_GAMEPAD;
+
+typedef struct _XINPUT_STATE {
+  DWORD          dwPacketNumber;
+  XINPUT_GAMEPAD Gamepad;
+} XINPUT_STATE;
+
+
+// Button bits in `XINPUT_GAMEPAD::wButtons`.
+#define XINPUT_GAMEPAD_DPAD_UP          0x0001
+#define XINPUT_GAMEPAD_DPAD_DOWN        0x0002
+#define XINPUT_GAMEPAD_DPAD_LEFT        0x0004
+#define XINPUT_GAMEPAD_DPAD_RIGHT       0x0008
+#define XINPUT_GAMEPAD_START            0x0010
+#define XINPUT_GAMEPAD_BACK             0x0020
+#define XINPUT_GAMEPAD_LEFT_THUMB       0x0040
+#define XINPUT_GAMEPAD_RIGHT_THUMB      0x0080
+#define XINPUT_GAMEPAD_LEFT_SHOULDER    0x0100
+#define XINPUT_GAMEPAD_RIGHT_SHOULDER   0x0200
+#define XINPUT_GAMEPAD_A                0x1000
+#define XINPUT_GAMEPAD_B                0x2000
+#define XINPUT_GAMEPAD_X                0x4000
+#define XINPUT_GAMEPAD_Y                0x8000
+
+
+#endif // !_WIN32
+
+#endif // WINDOWS_COMPAT_H